@@ -38,6 +38,8 @@
 */
 
 static uint32_t timerStopwatchTick;
+static uint32_t timerNext;                  /* First expiry of the running timers checked */
+static bool     timerNextValid;
 
 /*
 ******************************************************************************
@@ -73,6 +75,13 @@ bool timerIsExpired( uint32_t timer )
     return true;
   }
   
+  /* Keep the timer which expires first for timerNextExpiry() */
+  if( (!timerNextValid) || ((int32_t)(timer - timerNext) < 0) )
+  {
+    timerNext      = timer;
+    timerNextValid = true;
+  }
+  
   return false;
 }
 
@@ -101,3 +110,26 @@ uint32_t timerStopwatchMeasure( void )
   return (uint32_t)(platformGetSysTick() - timerStopwatchTick);
 }
 
+
+/*******************************************************************************/
+void timerNextClear( void )
+{
+  timerNextValid = false;
+}
+
+
+/*******************************************************************************/
+bool timerNextExpiry( uint32_t *time )
+{
+  int32_t sDiff;
+  
+  if( !timerNextValid )
+  {
+    return false;
+  }
+  
+  sDiff = (int32_t)(timerNext - platformGetSysTick());
+  *time = (sDiff < 0) ? 0U : (uint32_t)sDiff;
+  
+  return true;
+}
@@ -114,4 +114,35 @@ void timerStopwatchStart( void );
  */
 uint32_t timerStopwatchMeasure( void );
 
+
+/*! 
+ *****************************************************************************
+ * \brief  Clear the next expiry
+ *  
+ * This method forgets the running timers checked so far. Together with
+ * timerNextExpiry() it tells how long the caller of timerIsExpired() may
+ * sleep, e.g. across one run of the RFAL worker
+ * 
+ * \see timerNextExpiry
+ *
+ *****************************************************************************
+ */
+void timerNextClear( void );
+
+
+/*! 
+ *****************************************************************************
+ * \brief  Get the next expiry
+ *  
+ * This method returns the time until the first expiry of the timers found
+ * running by timerIsExpired() since timerNextClear()
+ * 
+ * \param[out]  time : time in Milliseconds, 0 if already expired
+ *
+ * \return true  : a running timer was checked
+ * \return false : no running timer was checked
+ *****************************************************************************
+ */
+bool timerNextExpiry( uint32_t *time );
+
 #endif /* TIMER_H */
@@ -0,0 +1,165 @@
+/* See COPYING.txt for license details. */
+
+/*
+ ******************************************************************************
+ * nfc_crypto1.c - Crypto1 stream cipher of MIFARE Classic
+ ******************************************************************************
+ *
+ * [Purpose]
+ * - Keystream generation for the reader and for the card model
+ * - Card nonce PRNG (16-bit LFSR x^16 + x^14 + x^13 + x^11 + 1)
+ *
+ * [Structure]
+ * - LFSR feedback x0^x5^x9^x10^x12^x14^x15^x17^x19^x24^x25^x27^x29^x35
+ *   ^x39^x41^x42^x43, as masks of the odd and even halves
+ * - Filter fc(fa(x9..x15), fb(x17..x23), fb(x25..x31), fa(x33..x39),
+ *   fb(x41..x47)), fa/fb as 16-bit truth tables indexed by a nibble of the
+ *   odd half, fc as a 32-bit truth table
+ *
+ ******************************************************************************
+ */
+
+#include "nfc_crypto1.h"
+
+#define CRYPTO1_POLY_ODD    0x29CE5CU   /* x43 x41 x39 x35 x29 x27 x25 x19 x17 x15 x9 x5 */
+#define CRYPTO1_POLY_EVEN   0x870804U   /* x42 x24 x14 x12 x10 x0 */
+
+#define CRYPTO1_FA          0xD938U     /* fa(y0..y3), index y0 y1 y2 y3 from the MSB */
+#define CRYPTO1_FB          0xF22CU     /* fb(y0..y3), same index */
+#define CRYPTO1_FC          0xEC57E80AU /* fc(y0..y4), index y4..y0 from the MSB */
+
+#define CRYPTO1_BIT(x, n)   (((x) >> (n)) & 1U)
+
+/*============================================================================*/
+/**
+ * @brief Parity of a 32-bit word
+ */
+/*============================================================================*/
+static inline uint32_t crypto1_parity32(uint32_t x)
+{
+    x ^= x >> 16;
+    x ^= x >> 8;
+    x ^= x >> 4;
+    return (0x6996U >> (x & 0x0FU)) & 1U;
+}
+
+/*============================================================================*/
+/**
+ * @brief Filter function
+ * @param odd Odd half of the LFSR
+ * @return Keystream bit
+ */
+/*============================================================================*/
+uint8_t crypto1_filter(uint32_t odd)
+{
+    uint32_t f;
+
+    f  = CRYPTO1_BIT(CRYPTO1_FB, odd & 0x0FU) << 4;
+    f |= CRYPTO1_BIT(CRYPTO1_FA, (odd >> 4) & 0x0FU) << 3;
+    f |= CRYPTO1_BIT(CRYPTO1_FB, (odd >> 8) & 0x0FU) << 2;
+    f |= CRYPTO1_BIT(CRYPTO1_FB, (odd >> 12) & 0x0FU) << 1;
+    f |= CRYPTO1_BIT(CRYPTO1_FA, (odd >> 16) & 0x0FU);
+    return (uint8_t)CRYPTO1_BIT(CRYPTO1_FC, f);
+}
+
+/*============================================================================*/
+/**
+ * @brief Load a key into the LFSR
+ * @param s Cipher state
+ * @param key Key, 6 bytes as stored on the card
+ */
+/*============================================================================*/
+void crypto1_init(crypto1_t *s, const uint8_t key[6])
+{
+    uint8_t i, j, b;
+
+    s->odd = 0;
+    s->even = 0;
+    /* x0 is the LSB of key[0], x47 the MSB of key[5] */
+    for (i = 0; i < 6; i++) {
+        b = key[i];
+        for (j = 0; j < 8; j += 2) {
+            s->even = (s->even << 1) | ((b >> j) & 1U);
+            s->odd = (s->odd << 1) | ((b >> (j + 1)) & 1U);
+        }
+    }
+    s->odd &= 0xFFFFFFU;
+    s->even &= 0xFFFFFFU;
+}
+
+/*============================================================================*/
+/**
+ * @brief Shift the LFSR by one bit
+ * @param s Cipher state
+ * @param in Input bit, fed into the LFSR
+ * @param in_encrypted true if in is encrypted: the keystream bit is added to it
+ * @return Keystream bit
+ */
+/*============================================================================*/
+uint8_t crypto1_bit(crypto1_t *s, uint8_t in, bool in_encrypted)
+{
+    uint32_t ks, fb, t;
+
+    ks = crypto1_filter(s->odd);
+    fb = (in_encrypted ? ks : 0U) ^ (in & 1U);
+    fb ^= crypto1_parity32((s->odd & CRYPTO1_POLY_ODD) ^ (s->even & CRYPTO1_POLY_EVEN));
+
+    t = ((s->even << 1) | fb) & 0xFFFFFFU;
+    s->even = s->odd;
+    s->odd = t;
+    return (uint8_t)ks;
+}
+
+/*============================================================================*/
+/**
+ * @brief Shift the LFSR by one byte
+ * @param s Cipher state
+ * @param in Input byte, LSB first
+ * @param in_encrypted true if in is encrypted
+ * @return Keystream byte
+ */
+/*============================================================================*/
+uint8_t crypto1_byte(crypto1_t *s, uint8_t in, bool in_encrypted)
+{
+    uint8_t i, ks = 0;
+
+    for (i = 0; i < 8; i++)
+        ks |= (uint8_t)(crypto1_bit(s, (uint8_t)(in >> i), in_encrypted) << i);
+    return ks;
+}
+
+/*============================================================================*/
+/**
+ * @brief Shift the LFSR by four bytes
+ * @param s Cipher state
+ * @param in Input word, first byte in bits 24..31
+ * @param in_encrypted true if in is encrypted
+ * @return Keystream word, same byte order
+ */
+/*============================================================================*/
+uint32_t crypto1_word(crypto1_t *s, uint32_t in, bool in_encrypted)
+{
+    uint32_t ks = 0;
+    int8_t shift;
+
+    for (shift = 24; shift >= 0; shift -= 8)
+        ks |= (uint32_t)crypto1_byte(s, (uint8_t)(in >> shift), in_encrypted) << shift;
+    return ks;
+}
+
+/*============================================================================*/
+/**
+ * @brief Successor of a card nonce
+ * @param x Nonce, first byte in bits 24..31
+ * @param n Number of PRNG shifts
+ * @return Nonce after n shifts
+ */
+/*============================================================================*/
+uint32_t crypto1_prng_successor(uint32_t x, uint32_t n)
+{
+    /* The PRNG shifts the bits in transmission order */
+    x = (x >> 24) | ((x >> 8) & 0xFF00U) | ((x << 8) & 0xFF0000U) | (x << 24);
+    while (n--)
+        x = (x >> 1) | (((x >> 16) ^ (x >> 18) ^ (x >> 19) ^ (x >> 21)) << 31);
+    return (x >> 24) | ((x >> 8) & 0xFF00U) | ((x << 8) & 0xFF0000U) | (x << 24);
+}
@@ -0,0 +1,66 @@
+/* See COPYING.txt for license details. */
+
+#ifndef NFC_DRV_NFC_CRYPTO1_H_
+#define NFC_DRV_NFC_CRYPTO1_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Crypto1 stream cipher of MIFARE Classic
+ *
+ * The 48-bit LFSR x0..x47 (x0 shifted out first) is kept as two 24-bit
+ * halves: odd holds x47, x45, .., x1 and even holds x46, x44, .., x0, most
+ * recent bit in bit 0. The filter function reads the 20 low bits of odd,
+ * one nibble lookup per sub-function. Shifting the LFSR by one bit only
+ * shifts the even half and swaps the halves.
+ *
+ * Bits go LSB first within a byte and bytes in transmission order, so a
+ * 32-bit word holds its first byte in bits 24..31.
+ */
+typedef struct {
+    uint32_t odd;
+    uint32_t even;
+} crypto1_t;
+
+void     crypto1_init(crypto1_t *s, const uint8_t key[6]);
+uint8_t  crypto1_bit(crypto1_t *s, uint8_t in, bool in_encrypted);
+uint8_t  crypto1_byte(crypto1_t *s, uint8_t in, bool in_encrypted);
+uint32_t crypto1_word(crypto1_t *s, uint32_t in, bool in_encrypted);
+uint8_t  crypto1_filter(uint32_t odd);
+uint32_t crypto1_prng_successor(uint32_t x, uint32_t n);
+
+/*============================================================================*/
+/**
+ * @brief Next keystream bit, without shifting. Encrypts the parity bit of
+ *        the byte just processed.
+ * @param s Cipher state
+ * @return Keystream bit
+ */
+/*============================================================================*/
+static inline uint8_t crypto1_peek(const crypto1_t *s)
+{
+    return crypto1_filter(s->odd);
+}
+
+/*============================================================================*/
+/**
+ * @brief ISO14443A odd parity bit of a byte
+ * @param b Byte
+ * @return Parity bit
+ */
+/*============================================================================*/
+static inline uint8_t crypto1_parity8(uint8_t b)
+{
+    return (uint8_t)((0x9669U >> ((b ^ (b >> 4)) & 0x0FU)) & 1U);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NFC_DRV_NFC_CRYPTO1_H_ */
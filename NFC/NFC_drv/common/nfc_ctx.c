@@ -12,22 +12,26 @@
 #include "rfal_nfc.h"
 #include "legacy/nfc_driver.h"   // Use Emu_SetNfcA, Emu_Clear
 
-/* --------- (Optional) Mutex usage setting ---------
- * If needed, define NFC_CTX_USE_MUTEX in project settings and
- * include FreeRTOS header, then create with xSemaphoreCreateMutex().
- */
-//#define NFC_CTX_USE_MUTEX 1
-
-#if defined(NFC_CTX_USE_MUTEX)
-#include "FreeRTOS.h"
-#include "semphr.h"
-static SemaphoreHandle_t s_ctx_mtx = NULL;  
-static inline void nfc_ctx_lock(void)   { xSemaphoreTake(s_ctx_mtx, portMAX_DELAY); }
-static inline void nfc_ctx_unlock(void) { xSemaphoreGive(s_ctx_mtx); }
-#else
-static inline void nfc_ctx_lock(void)   {}
-static inline void nfc_ctx_unlock(void) {}
-#endif
+/* --------- Snapshot publication ---------
+ * Writers (poller and listener in the NFC worker, file load and edits in the
+ * UI, never at the same time) change g_nfc_ctx and publish its header and dump
+ * binding into one of two snapshot slots: the slot readers are not pointed at
+ * is marked busy, filled, stamped with the new sequence number, and then
+ * s_snap_seq moves to it. Readers copy the slot of s_snap_seq with no lock
+ * and start over if its stamp changed meanwhile, which takes two publications
+ * during one copy. A reader never waits for a writer.
+ *
+ * Dump data is filled while no dump is published (nfc_ctx_clear_dump() ...
+ * nfc_ctx_set_dump()); a T2T page written in place is stored as one word.
+ * A page read from the workspace starts over if anything was published during
+ * the read.
+ */
+#define NFC_CTX_SEQ_BUSY    0xFFFFFFFFU
+
+static nfc_ctx_snapshot_t s_snap[2];
+static volatile uint32_t  s_snap_seq = 0;
+
+uint32_t g_nfc_ctx_read_retries = 0; // Snapshot copies started over
 
 
 /* --------- Internal global variables --------- */
@@ -38,7 +42,7 @@ static nfc_run_ctx_t g_nfc_ctx;
 
 uint16_t g_nfc_ntag_page_count = 0; // NTAG total page count
 
-uint8_t g_nfc_dump_buf[NFC_DUMP_BUF_SIZE];
+uint8_t g_nfc_dump_buf[NFC_DUMP_BUF_SIZE] __attribute__((aligned(4))); // Word access to T2T pages
 uint8_t g_nfc_valid_bits[NFC_VALID_BITS_SIZE];
 
 /* --------- Internal utilities --------- */
@@ -99,31 +103,83 @@ static void make_uid_text(char* out, size_t outsz, const uint8_t* uid, uint8_t u
     if (p < outsz) out[p] = '\0';
 }
 
+/*============================================================================*/
+/**
+ * @brief nfc_ctx_snapshot_begin - Start reading the published snapshot
+ * 
+ * @param[out] seq Sequence number of the snapshot
+ * @retval Snapshot slot to read
+ */
+/*============================================================================*/
+static const nfc_ctx_snapshot_t* nfc_ctx_snapshot_begin(uint32_t* seq)
+{
+    *seq = s_snap_seq;
+    __DMB(); // Read the slot only after the publication that filled it
+    return &s_snap[*seq & 1U];
+}
+
+/*============================================================================*/
+/**
+ * @brief nfc_ctx_snapshot_end - Check the snapshot slot was not refilled while being read
+ * 
+ * @param[in] snap Snapshot slot from nfc_ctx_snapshot_begin()
+ * @param[in] seq Sequence number from nfc_ctx_snapshot_begin()
+ * @retval true The copy is consistent
+ * @retval false The copy must start over
+ */
+/*============================================================================*/
+static bool nfc_ctx_snapshot_end(const nfc_ctx_snapshot_t* snap, uint32_t seq)
+{
+    __DMB(); // Finish reading the slot before checking its stamp
+    if (((const volatile nfc_ctx_snapshot_t*)snap)->seq == seq) {
+        return true;
+    }
+    g_nfc_ctx_read_retries++;
+    return false;
+}
+
+/*============================================================================*/
+/**
+ * @brief nfc_ctx_snapshot_latest - Check no snapshot was published since nfc_ctx_snapshot_begin()
+ * 
+ * Dump data is read from the workspace, not from the slot: nfc_ctx_clear_dump()
+ * publishes into the other slot and the workspace is refilled meanwhile.
+ * 
+ * @param[in] seq Sequence number from nfc_ctx_snapshot_begin()
+ * @retval true No newer publication
+ * @retval false The read must start over
+ */
+/*============================================================================*/
+static bool nfc_ctx_snapshot_latest(uint32_t seq)
+{
+    __DMB(); // Finish reading the workspace before checking the sequence number
+    if (s_snap_seq == seq) {
+        return true;
+    }
+    g_nfc_ctx_read_retries++;
+    return false;
+}
+
 /* --------- API functions --------- */
 
 /*============================================================================*/
 /**
- * @brief nfc_ctx_module_init - Initialize module: prepare global context/mutex
+ * @brief nfc_ctx_module_init - Initialize module: prepare global context/snapshot
  * 
- * Initializes the NFC context module by creating mutex (if enabled)
- * and initializing the global context structure.
+ * Initializes the global context structure and publishes it empty.
  * 
  * @retval None
  */
 /*============================================================================*/
 void nfc_ctx_module_init(void)
 {
-
-#if defined(NFC_CTX_USE_MUTEX)
-    if (!s_ctx_mtx) s_ctx_mtx = xSemaphoreCreateMutex();
-#endif
-
     nfc_run_ctx_init(&g_nfc_ctx);
 
     memset(&g_nfc_ctx, 0, sizeof(g_nfc_ctx)); // Initialize NDEF memory
     g_nfc_ctx.t2t.valid    = false;
     g_nfc_ctx.t2t.ndef_len = 0;
 
+    nfc_ctx_publish();
 }
 
 /*============================================================================*/
@@ -140,6 +196,64 @@ nfc_run_ctx_t* nfc_ctx_get(void)
     return &g_nfc_ctx;
 }
 
+/*============================================================================*/
+/**
+ * @brief nfc_ctx_publish - Publish header and dump binding of the context
+ * 
+ * Copies the file state, the header, the family title and the dump metadata of the working
+ * context into the snapshot slot readers are not using, then points readers
+ * at it. Called by the context setters; writers changing the context through
+ * nfc_ctx_get() call it once their change is complete.
+ * 
+ * @retval None
+ */
+/*============================================================================*/
+void nfc_ctx_publish(void)
+{
+    uint32_t seq = s_snap_seq + 1U;
+    if (seq == NFC_CTX_SEQ_BUSY) {
+        seq += 2U; // Keep the slot parity
+    }
+
+    nfc_ctx_snapshot_t* snap = &s_snap[seq & 1U];
+    ((volatile nfc_ctx_snapshot_t*)snap)->seq = NFC_CTX_SEQ_BUSY;
+    __DMB(); // Readers left in the slot see it busy before it changes
+
+    snap->file = g_nfc_ctx.file;
+    snap->head = g_nfc_ctx.head;
+    snap->dump = g_nfc_ctx.dump;
+    memcpy(snap->title_text, g_nfc_ctx.ui.title_text, sizeof(snap->title_text));
+
+    __DMB(); // The slot is complete before it gets its stamp
+    ((volatile nfc_ctx_snapshot_t*)snap)->seq = seq;
+    __DMB(); // and before readers are pointed at it
+    s_snap_seq = seq;
+}
+
+/*============================================================================*/
+/**
+ * @brief nfc_ctx_get_snapshot - Copy the published header and dump binding
+ * 
+ * Lock-free: the copy starts over if a writer refilled the slot meanwhile.
+ * The dump data stays in the workspace; read units with the getters below.
+ * 
+ * @param[out] out Snapshot copy
+ * @retval None
+ */
+/*============================================================================*/
+void nfc_ctx_get_snapshot(nfc_ctx_snapshot_t* out)
+{
+    const nfc_ctx_snapshot_t* snap;
+    uint32_t seq;
+
+    if (!out) return;
+    do {
+        snap = nfc_ctx_snapshot_begin(&seq);
+        *out = *snap;
+    } while (!nfc_ctx_snapshot_end(snap, seq));
+    out->seq = seq;
+}
+
 /*============================================================================*/
 /**
  * @brief nfc_run_ctx_init - Initialize context with default values (prototype addition in header recommended)
@@ -205,12 +319,10 @@ void nfc_run_ctx_init(nfc_run_ctx_t* c)
 /*============================================================================*/
 void nfc_ctx_begin_live(void)
 {
-    nfc_ctx_lock();
     g_nfc_ctx.file.source_kind = LIVE_CARD;
     g_nfc_ctx.file.path[0]     = '\0';    /* No file path */
     g_nfc_ctx.file.sys_error   = 0;       /* Valid state */
     nfc_ctx_clear_dump();   // Clear previously loaded dump
-    nfc_ctx_unlock();
 }
 
 /*============================================================================*/
@@ -219,6 +331,8 @@ void nfc_ctx_begin_live(void)
  * 
  * Starts a file loading session by setting source kind to LOAD_FILE
  * and storing the file path.
+ * The file state is published with the next
+ * nfc_ctx_clear_dump(), together with the header of the new file.
  * 
  * @param[in] fullpath Full path to the NFC file (NULL to clear)
  * @retval None
@@ -226,7 +340,6 @@ void nfc_ctx_begin_live(void)
 /*============================================================================*/
 void nfc_ctx_begin_file(const char* fullpath)
 {
-    nfc_ctx_lock();
     g_nfc_ctx.file.source_kind = LOAD_FILE;
     if (fullpath) {
         strncpy(g_nfc_ctx.file.path, fullpath, sizeof(g_nfc_ctx.file.path)-1);
@@ -235,28 +348,27 @@ void nfc_ctx_begin_file(const char* fullpath)
         g_nfc_ctx.file.path[0] = '\0';
     }
     g_nfc_ctx.file.sys_error = 0;
-    nfc_ctx_unlock();
 }
 
 /*============================================================================*/
 /**
  * @brief nfc_ctx_refresh_ui - Refresh UI text fields (title/UID)
  * 
- * Updates UI text fields based on current context family and UID.
+ * Updates UI text fields based on current context family and UID,
+ * then publishes the header.
  * 
  * @retval None
  */
 /*============================================================================*/
 void nfc_ctx_refresh_ui(void)
 {
-    nfc_ctx_lock();
     const char* t = family_to_title(g_nfc_ctx.head.family);
     strncpy(g_nfc_ctx.ui.title_text, t, sizeof(g_nfc_ctx.ui.title_text)-1);
     g_nfc_ctx.ui.title_text[sizeof(g_nfc_ctx.ui.title_text)-1] = '\0';
 
     make_uid_text(g_nfc_ctx.ui.uid_text, sizeof(g_nfc_ctx.ui.uid_text),
                   g_nfc_ctx.head.uid, g_nfc_ctx.head.uid_len);
-    nfc_ctx_unlock();
+    nfc_ctx_publish();
 }
 
 /*============================================================================*/
@@ -264,14 +376,14 @@ void nfc_ctx_refresh_ui(void)
  * @brief nfc_ctx_clear_dump - Clear entire dump (reset type/pointer/length)
  * 
  * Clears all dump metadata including unit size, count, origin,
- * data pointer, valid bits, and flags.
+ * data pointer, valid bits, and flags, and publishes the context without dump.
+ * The workspace may be refilled from then on.
  * 
  * @retval None
  */
 /*============================================================================*/
 void nfc_ctx_clear_dump(void)
 {
-    nfc_ctx_lock();
     g_nfc_ctx.dump.unit_size     = 0;
     g_nfc_ctx.dump.unit_count    = 0;
     g_nfc_ctx.dump.origin        = 0;
@@ -279,14 +391,15 @@ void nfc_ctx_clear_dump(void)
     g_nfc_ctx.dump.valid_bits    = NULL;
     g_nfc_ctx.dump.max_seen_unit = 0;
     g_nfc_ctx.dump.has_dump      = false;
-    nfc_ctx_unlock();
+    nfc_ctx_publish();
 }
 
 /*============================================================================*/
 /**
  * @brief nfc_ctx_set_dump - Set dump metadata/pointer (bind workspace pointer)
  * 
- * Sets dump metadata and binds workspace pointers for dump data and valid bits.
+ * Sets dump metadata and binds workspace pointers for dump data and valid bits,
+ * then publishes them. The workspace must be filled before.
  * 
  * @param[in] unit_size Size of each unit (e.g., 4 for T2T page, 16 for MFC block)
  * @param[in] unit_count Total number of units allocated
@@ -301,7 +414,6 @@ void nfc_ctx_clear_dump(void)
 void nfc_ctx_set_dump(uint16_t unit_size, uint32_t unit_count, uint32_t origin,
                       uint8_t* data, uint8_t* valid_bits, uint32_t max_seen_unit, bool has_dump)
 {
-    nfc_ctx_lock();
     g_nfc_ctx.dump.unit_size     = unit_size;
     g_nfc_ctx.dump.unit_count    = unit_count;
     g_nfc_ctx.dump.origin        = origin;
@@ -309,7 +421,7 @@ void nfc_ctx_set_dump(uint16_t unit_size, uint32_t unit_count, uint32_t origin,
     g_nfc_ctx.dump.valid_bits    = valid_bits;
     g_nfc_ctx.dump.max_seen_unit = max_seen_unit;
     g_nfc_ctx.dump.has_dump      = has_dump;
-    nfc_ctx_unlock();
+    nfc_ctx_publish();
 }
 
 
@@ -396,6 +508,7 @@ uint8_t FillNfcContextFromDevice(const rfalNfcDevice* dev)
         case RFAL_NFC_LISTEN_TYPE_NFCF:
         case RFAL_NFC_LISTEN_TYPE_NFCV:
         default:
+            nfc_ctx_publish(); /* No identity for this type */
             return 2;
     }
 
@@ -707,20 +820,19 @@ void nfc_ctx_dump_t2t_pages(void)
 
 /*============================================================================*/
 /**
- * @brief nfc_ctx_get_t2t_page_count - Return Type 2 / NTAG page count (0 if none)
- * 
- * Returns the number of pages in T2T dump.
+ * @brief nfc_ctx_t2t_pages - Type 2 / NTAG page count of a snapshot
  * 
+ * @param[in] snap Snapshot
  * @retval Page count, or 0 if not T2T or dump invalid
  */
 /*============================================================================*/
-uint16_t nfc_ctx_get_t2t_page_count(void)
+static uint32_t nfc_ctx_t2t_pages(const nfc_ctx_snapshot_t* snap)
 {
-    const nfc_dump_meta_t *d = &g_nfc_ctx.dump;
+    const nfc_dump_meta_t *d = &snap->dump;
 
     /* If not Type 2 / NTAG or no dump */
-    if ( (g_nfc_ctx.head.tech   != M1NFC_TECH_A) ||
-         (g_nfc_ctx.head.family != M1NFC_FAM_ULTRALIGHT) ||
+    if ( (snap->head.tech   != M1NFC_TECH_A) ||
+         (snap->head.family != M1NFC_FAM_ULTRALIGHT) ||
          (!d->has_dump) || (d->data == NULL) || (d->unit_size != 4) ) {
         return 0;
     }
@@ -730,6 +842,51 @@ uint16_t nfc_ctx_get_t2t_page_count(void)
         pages = d->unit_count;
     }
 
+    return pages;
+}
+
+/*============================================================================*/
+/**
+ * @brief nfc_ctx_get_t2t_page_count - Return Type 2 / NTAG page count (0 if none)
+ * 
+ * Returns the number of pages in the published T2T dump, without locking.
+ * 
+ * @retval Page count, or 0 if not T2T or dump invalid
+ */
+/*============================================================================*/
+uint16_t nfc_ctx_get_t2t_page_count(void)
+{
+    const nfc_ctx_snapshot_t *snap;
+    uint32_t seq, pages;
+
+    do {
+        snap  = nfc_ctx_snapshot_begin(&seq);
+        pages = nfc_ctx_t2t_pages(snap);
+    } while (!nfc_ctx_snapshot_end(snap, seq));
+
+    return (uint16_t)pages;
+}
+
+/*============================================================================*/
+/**
+ * @brief nfc_ctx_get_t2t_page_capacity - Return the pages the T2T dump buffer holds
+ * 
+ * A page written with nfc_ctx_set_t2t_page() past the page count but below
+ * this one extends the dump.
+ * 
+ * @retval Page count, or 0 if not T2T or dump invalid
+ */
+/*============================================================================*/
+uint16_t nfc_ctx_get_t2t_page_capacity(void)
+{
+    const nfc_ctx_snapshot_t *snap;
+    uint32_t seq, pages;
+
+    do {
+        snap  = nfc_ctx_snapshot_begin(&seq);
+        pages = nfc_ctx_t2t_pages(snap) ? snap->dump.unit_count : 0U;
+    } while (!nfc_ctx_snapshot_end(snap, seq));
+
     return (uint16_t)pages;
 }
 
@@ -737,7 +894,7 @@ uint16_t nfc_ctx_get_t2t_page_count(void)
 /**
  * @brief nfc_ctx_get_t2t_page - Copy pageIndex-th T2T page to out[4] (returns true on success)
  * 
- * Retrieves a specific T2T page from dump data.
+ * Retrieves a specific T2T page from the published dump, without locking.
  * 
  * @param[in] pageIndex Page index to retrieve
  * @param[out] out Output buffer (4 bytes)
@@ -747,29 +904,30 @@ uint16_t nfc_ctx_get_t2t_page_count(void)
 /*============================================================================*/
 bool nfc_ctx_get_t2t_page(uint16_t pageIndex, uint8_t out[4])
 {
-    const nfc_dump_meta_t *d = &g_nfc_ctx.dump;
+    const nfc_ctx_snapshot_t *snap;
+    const uint8_t *page_ptr;
+    uint32_t seq, word;
 
     if (!out) return false;
 
-    if ( (g_nfc_ctx.head.tech   != M1NFC_TECH_A) ||
-         (g_nfc_ctx.head.family != M1NFC_FAM_ULTRALIGHT) ||
-         (!d->has_dump) || (d->data == NULL) || (d->unit_size != 4) ) {
-        return false;
-    }
+    for (;;) {
+        snap     = nfc_ctx_snapshot_begin(&seq);
+        page_ptr = (pageIndex < nfc_ctx_t2t_pages(snap)) ? &snap->dump.data[(uint32_t)pageIndex * 4U] : NULL;
 
-    uint32_t pages = d->max_seen_unit + 1U;
-    if ((pages == 0U) || (pages > d->unit_count)) {
-        pages = d->unit_count;
-    }
+        /* Never follow a data pointer read from a slot being refilled */
+        if (!nfc_ctx_snapshot_end(snap, seq)) continue;
+        if (page_ptr == NULL) return false;
 
-    if (pageIndex >= pages) {
-        return false;
-    }
-
-    const uint8_t *page_ptr = &d->data[ (uint32_t)pageIndex * d->unit_size ];
-    memcpy(out, page_ptr, 4);
+        if (((uintptr_t)page_ptr & 3U) == 0U) {
+            word = *(const volatile uint32_t *)page_ptr; // One load, pages are written as one word
+            memcpy(out, &word, 4);
+        } else {
+            memcpy(out, page_ptr, 4);
+        }
 
-    return true;
+        /* The dump may have been dropped and its workspace refilled meanwhile */
+        if (nfc_ctx_snapshot_end(snap, seq) && nfc_ctx_snapshot_latest(seq)) return true;
+    }
 }
 
 /*============================================================================*/
@@ -875,8 +1033,6 @@ uint8_t nfc_ctx_get_t2t_version(uint8_t out[8])
 /*============================================================================*/
 void nfc_ctx_set_t2t_page(uint16_t page, const uint8_t data[4])
 {
-    nfc_ctx_lock();
-
     nfc_dump_meta_t *d = &g_nfc_ctx.dump;
 
     /* Ignore if not Type 2 / NTAG */
@@ -887,7 +1043,6 @@ void nfc_ctx_set_t2t_page(uint16_t page, const uint8_t data[4])
         d->unit_size != 4      ||
         d->unit_count == 0)
     {
-        nfc_ctx_unlock();
         return;
     }
 
@@ -895,13 +1050,11 @@ void nfc_ctx_set_t2t_page(uint16_t page, const uint8_t data[4])
 
     /* Ignore if page number is outside dump range */
     if (page < origin) {
-        nfc_ctx_unlock();
         return;
     }
 
     uint32_t idx = (uint32_t)page - origin;
     if (idx >= d->unit_count) {
-        nfc_ctx_unlock();
         return;
     }
 
@@ -909,7 +1062,14 @@ void nfc_ctx_set_t2t_page(uint16_t page, const uint8_t data[4])
     uint8_t *dump_buf = d->data;
     uint8_t *page_ptr = &dump_buf[idx * d->unit_size];
 
-    memcpy(page_ptr, data, 4);
+    /* The dump is published: store the page as one word so readers never see half of it */
+    if (((uintptr_t)page_ptr & 3U) == 0U) {
+        uint32_t word;
+        memcpy(&word, data, 4);
+        *(volatile uint32_t *)page_ptr = word;
+    } else {
+        memcpy(page_ptr, data, 4);
+    }
 
     /* If valid_bits exists, mark this page as valid */
     if (d->valid_bits != NULL) {
@@ -923,9 +1083,8 @@ void nfc_ctx_set_t2t_page(uint16_t page, const uint8_t data[4])
     /* Update max_seen_unit (maximum page actually used in dump) */
     if (idx > d->max_seen_unit) {
         d->max_seen_unit = idx;
+        nfc_ctx_publish();
     }
-
-    nfc_ctx_unlock();
 }
 
 
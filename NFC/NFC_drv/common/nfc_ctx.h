@@ -137,9 +137,22 @@ typedef struct {
     nfc_t2t_info_t    t2t;   // Type 2 Tag (NTAG, etc.) related information
 } nfc_run_ctx_t;
 
+/* ======================= Published Snapshot ======================= */
+/* Card identity, source file and dump binding as last published by a writer, read without locking.
+ * data/valid_bits still point to the workspace: read units through the getters. */
+typedef struct {
+    uint32_t         seq;                        /* Publication number, changes with each publication */
+    nfc_file_state_t file;                       /* Source kind and path of nfc_ctx_begin_live()/_file() */
+    nfc_header_t     head;
+    nfc_dump_meta_t  dump;
+    char             title_text[NFC_TITLE_MAX];  /* Family title of nfc_ctx_refresh_ui() */
+} nfc_ctx_snapshot_t;
+
+extern uint32_t g_nfc_ctx_read_retries;
+
 
 /**
- * @brief nfc_ctx_module_init - Initialize module: prepare global context/mutex
+ * @brief nfc_ctx_module_init - Initialize module: prepare global context/snapshot
  * 
  * @retval None
  */
@@ -152,6 +165,24 @@ void nfc_ctx_module_init(void);
  */
 nfc_run_ctx_t* nfc_ctx_get(void);
 
+/**
+ * @brief nfc_ctx_publish - Publish header and dump binding for lock-free readers
+ * 
+ * Writers changing the context through nfc_ctx_get() call it when done.
+ * Only one writer may run at a time.
+ * 
+ * @retval None
+ */
+void nfc_ctx_publish(void);
+
+/**
+ * @brief nfc_ctx_get_snapshot - Copy the last published header and dump binding
+ * 
+ * @param[out] out Snapshot copy
+ * @retval None
+ */
+void nfc_ctx_get_snapshot(nfc_ctx_snapshot_t* out);
+
 /**
  * @brief nfc_run_ctx_init - Reset context to default values
  * 
@@ -276,6 +307,13 @@ void nfc_ctx_dump_t2t_pages(void);
  */
 uint16_t nfc_ctx_get_t2t_page_count(void);
 
+/**
+ * @brief nfc_ctx_get_t2t_page_capacity - Return the pages the T2T dump buffer holds
+ * 
+ * @retval Page count nfc_ctx_set_t2t_page() accepts, or 0 if not T2T or dump invalid
+ */
+uint16_t nfc_ctx_get_t2t_page_capacity(void);
+
 /**
  * @brief nfc_ctx_get_t2t_page - Get T2T page data
  * 
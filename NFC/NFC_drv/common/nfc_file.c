@@ -1,5 +1,6 @@
 /* See COPYING.txt for license details. */
 
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,6 +27,17 @@
 #define NFC_FILE_EXTENSION_TMP		"nfc"
 #define NFC_FILE_PREFIX			"nfc_"
 #define NFC_FILE_EXTENSION		".nfc"
+#define NFC_FILE_EXTENSION_SAVE_TMP	".tmp"
+
+#define NFC_SAVE_CHUNK_SIZE		4096 // Multiple of the sector size
+#define NFC_SAVE_LINE_MAX		128 // Longest formatted line, including the terminating null
+
+typedef struct
+{
+	FIL      file;
+	uint32_t len;   // Bytes in nfc_save_buf
+	bool     error;
+} nfc_save_writer_t;
 
 #define CONCAT_FILEPATH_FILENAME(fpath, fname) fpath fname
 
@@ -33,6 +45,9 @@
 extern uint8_t g_nfc_dump_buf[];
 extern uint8_t g_nfc_valid_bits[];
 
+// Save buffer with room for one line past the chunk, word aligned for the SD card DMA
+static uint32_t nfc_save_buf[(NFC_SAVE_CHUNK_SIZE + NFC_SAVE_LINE_MAX) / sizeof(uint32_t)];
+
 /*============================================================================*/
 /**
  * @brief Load NFC profile from file
@@ -66,6 +81,7 @@ bool nfc_profile_load(const S_M1_file_info *f, const char* ext)
 			if (c) {
 				strncpy(c->file.path, file_path, sizeof(c->file.path) - 1);
 				c->file.path[sizeof(c->file.path) - 1] = '\0';
+				nfc_ctx_publish();
 			}
 			return true;
 		}
@@ -78,11 +94,120 @@ bool nfc_profile_load(const S_M1_file_info *f, const char* ext)
 	return false;
 }
 
+/*============================================================================*/
+/**
+ * @brief Add a formatted line to the save buffer
+ *
+ * Lines are formatted in place at the end of the buffer, which has room for
+ * one line past the chunk size. Once a whole chunk is buffered it is written
+ * and the overflow moved to the start, so every chunk but the last starts and
+ * ends on a sector boundary of the file and FatFs writes it straight to the
+ * card without going through its sector window.
+ *
+ * @param w Save writer
+ * @param len Length of the line formatted at nfc_save_buf + w->len
+ */
+/*============================================================================*/
+static void nfc_save_commit(nfc_save_writer_t *w, uint32_t len)
+{
+	char *buf = (char *)nfc_save_buf;
+
+	w->len += len;
+	if (w->len < NFC_SAVE_CHUNK_SIZE)
+		return;
+
+	if (m1_fb_write_to_file(&w->file, buf, NFC_SAVE_CHUNK_SIZE) != NFC_SAVE_CHUNK_SIZE)
+	{
+		w->error = true;
+		return;
+	}
+	w->len -= NFC_SAVE_CHUNK_SIZE;
+	memmove(buf, buf + NFC_SAVE_CHUNK_SIZE, w->len);
+}
+
+/*============================================================================*/
+/**
+ * @brief Append a formatted line to the save buffer
+ * @param w Save writer
+ * @param fmt printf format of the line, at most NFC_SAVE_LINE_MAX - 1 characters
+ */
+/*============================================================================*/
+static void nfc_save_printf(nfc_save_writer_t *w, const char *fmt, ...)
+{
+	va_list args;
+	char *p;
+	int n;
+
+	if (w->error)
+		return;
+
+	p = (char *)nfc_save_buf + w->len;
+	va_start(args, fmt);
+	n = vsnprintf(p, NFC_SAVE_LINE_MAX, fmt, args);
+	va_end(args);
+
+	if (n > 0)
+		nfc_save_commit(w, (n < NFC_SAVE_LINE_MAX) ? n : NFC_SAVE_LINE_MAX - 1);
+}
+
+/*============================================================================*/
+/**
+ * @brief Append one "Page NNN: XX XX .." or "Block N: XX XX .." line
+ *
+ * Formats the hex bytes without going through snprintf, this is the only
+ * part of the file which grows with the size of the dump.
+ *
+ * @param w Save writer
+ * @param label "Page " or "Block "
+ * @param min_digits Minimum number of digits of the unit number
+ * @param unit_no Unit number
+ * @param data Unit data
+ * @param unit_size Unit size in bytes, at most 16
+ */
+/*============================================================================*/
+static void nfc_save_unit_line(nfc_save_writer_t *w, const char *label, uint8_t min_digits,
+							   uint32_t unit_no, const uint8_t *data, uint16_t unit_size)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	char digits[10];
+	uint8_t n_digits = 0;
+	char *p, *line;
+
+	do {
+		digits[n_digits++] = '0' + (unit_no % 10);
+		unit_no /= 10;
+	} while (unit_no && n_digits < sizeof(digits));
+	while (n_digits < min_digits)
+		digits[n_digits++] = '0';
+
+	if (w->error)
+		return;
+
+	line = p = (char *)nfc_save_buf + w->len;
+	while (*label)
+		*p++ = *label++;
+	while (n_digits)
+		*p++ = digits[--n_digits];
+	*p++ = ':';
+	for (uint16_t i = 0; i < unit_size; i++)
+	{
+		*p++ = ' ';
+		*p++ = hex[data[i] >> 4];
+		*p++ = hex[data[i] & 0x0F];
+	}
+	*p++ = '\r';
+	*p++ = '\n';
+	nfc_save_commit(w, p - line);
+}
+
 /*============================================================================*/
 /**
  * @brief Save NFC profile to file
  * 
  * Saves NFC card context data to file in M1 NFC device format.
+ * The file is formatted into a 4 KB buffer and written in whole chunks to
+ * a temporary file, which replaces the destination only once it is
+ * complete. A failed save leaves an existing file untouched.
  * 
  * @param fp Full file path to save to
  * @param ctx NFC context containing card data
@@ -91,25 +216,31 @@ bool nfc_profile_load(const S_M1_file_info *f, const char* ext)
 /*============================================================================*/
 bool nfc_profile_save(const char *fp, PCNFC_RUN_CTX ctx)
 {
-	FIL nfc_file;
-	char line[128];
-	uint8_t ret;
+	nfc_save_writer_t w;
+	char tmp_path[NFC_PATH_MAX + sizeof(NFC_FILE_EXTENSION_SAVE_TMP)];
+	FRESULT fres;
 
 	if (!fp || !ctx) {
 		return false;
 	}
 
-	ret = m1_fb_open_new_file(&nfc_file, fp);
-	if (ret) {
-		platformLog("nfc_profile_save: Error creating file '%s'\r\n", fp);
+	if (strlen(fp) + sizeof(NFC_FILE_EXTENSION_SAVE_TMP) > sizeof(tmp_path)) {
+		platformLog("nfc_profile_save: Path too long '%s'\r\n", fp);
 		return false;
 	}
+	strcpy(tmp_path, fp);
+	strcat(tmp_path, NFC_FILE_EXTENSION_SAVE_TMP);
+
+	if (m1_fb_open_new_file(&w.file, tmp_path)) {
+		platformLog("nfc_profile_save: Error creating file '%s'\r\n", tmp_path);
+		return false;
+	}
+	w.len = 0;
+	w.error = false;
 
 	// Write header
-	strcpy(line, "Filetype: M1 NFC device\r\n");
-	m1_fb_write_to_file(&nfc_file, line, strlen(line));
-	strcpy(line, "Version: 4\r\n");
-	m1_fb_write_to_file(&nfc_file, line, strlen(line));
+	nfc_save_printf(&w, "Filetype: M1 NFC device\r\n");
+	nfc_save_printf(&w, "Version: 4\r\n");
 
 	// Device type
 	const char* devtype = "NFC";
@@ -126,73 +257,95 @@ bool nfc_profile_save(const char *fp, PCNFC_RUN_CTX ctx)
 	case NFC_TX_V:  devtype = "ISO15693";    break;
 	default:        devtype = "NFC";         break;
 	}
-	snprintf(line, sizeof(line), "Device type: %s\r\n", devtype);
-	m1_fb_write_to_file(&nfc_file, line, strlen(line));
+	nfc_save_printf(&w, "Device type: %s\r\n", devtype);
 
 	// Format UID with spaces (like RFID does) for proper parsing
 	char uid_str[32];
 	int pos = 0;
+	uid_str[0] = '\0';
 	for (uint8_t i = 0; i < ctx->head.uid_len && pos < (int)sizeof(uid_str) - 3; i++) {
 		pos += snprintf(uid_str + pos, sizeof(uid_str) - pos,
 						(i + 1 < ctx->head.uid_len) ? "%02X " : "%02X",
 						ctx->head.uid[i]);
 	}
-	snprintf(line, sizeof(line), "UID: %s\r\n", uid_str);
-	m1_fb_write_to_file(&nfc_file, line, strlen(line));
+	nfc_save_printf(&w, "UID: %s\r\n", uid_str);
 
 	// ATQA and SAK (for Tech A)
 	if (ctx->head.tech == NFC_TX_A) {
-		snprintf(line, sizeof(line), "ATQA: %02X %02X\r\n",
+		nfc_save_printf(&w, "ATQA: %02X %02X\r\n",
 				ctx->head.a.atqa[0], ctx->head.a.atqa[1]);
-		m1_fb_write_to_file(&nfc_file, line, strlen(line));
+		nfc_save_printf(&w, "SAK: %02X\r\n", ctx->head.a.sak);
+	}
 
-		snprintf(line, sizeof(line), "SAK: %02X\r\n", ctx->head.a.sak);
-		m1_fb_write_to_file(&nfc_file, line, strlen(line));
+	// Save Ultralight (NTAG) page dumps and Classic block dumps if available
+	const char *unit_label = NULL;
+	uint8_t unit_digits = 0;
+	if ((ctx->head.tech == NFC_TX_A) && ctx->dump.has_dump && ctx->dump.data != NULL &&
+		ctx->dump.unit_count > 0)
+	{
+		if ((ctx->head.family == M1NFC_FAM_ULTRALIGHT) && (ctx->dump.unit_size == 4))
+		{
+			unit_label = "Page ";
+			unit_digits = 3;
+		}
+		else if ((ctx->head.family == M1NFC_FAM_CLASSIC) && (ctx->dump.unit_size == 16))
+		{
+			unit_label = "Block ";
+			unit_digits = 1;
+		}
 	}
 
-	// Save Ultralight (NTAG) page dumps if available
-	if ((ctx->head.tech == NFC_TX_A) && (ctx->head.family == M1NFC_FAM_ULTRALIGHT) &&
-		ctx->dump.has_dump && ctx->dump.data != NULL &&
-		ctx->dump.unit_size == 4 && ctx->dump.unit_count > 0)
+	if (unit_label)
 	{
-		uint32_t page_cnt  = ctx->dump.unit_count;
-		uint32_t page_base = ctx->dump.origin;
+		uint32_t unit_cnt  = ctx->dump.unit_count;
+		uint32_t unit_base = ctx->dump.origin;
 		const uint8_t *dump = ctx->dump.data;
 		const uint8_t *valid = ctx->dump.valid_bits;
 
-		snprintf(line, sizeof(line), "Pages: %lu\r\n", (unsigned long)page_cnt);
-		m1_fb_write_to_file(&nfc_file, line, strlen(line));
+		if (unit_digits == 3)
+			nfc_save_printf(&w, "Pages: %lu\r\n", (unsigned long)unit_cnt);
 
-		for (uint32_t i = 0; i < page_cnt; i++)
+		for (uint32_t i = 0; i < unit_cnt && !w.error; i++)
 		{
-			uint8_t is_valid = 1;
 			if (valid != NULL)
 			{
 				uint32_t byte_idx = (i >> 3);        // i / 8
 				uint8_t  mask     = (1u << (i & 0x07)); // i % 8
 				if ((valid[byte_idx] & mask) == 0)
 				{
-					is_valid = 0;
+					continue;
 				}
 			}
 
-			if (!is_valid)
-			{
-				continue;
-			}
+			nfc_save_unit_line(&w, unit_label, unit_digits, unit_base + i,
+							   &dump[i * ctx->dump.unit_size], ctx->dump.unit_size);
+		}
+	}
+
+	// Write the last, partial chunk
+	if (!w.error && w.len)
+	{
+		if (m1_fb_write_to_file(&w.file, (const char *)nfc_save_buf, w.len) != w.len)
+			w.error = true;
+	}
 
-			const uint8_t *page = &dump[i * ctx->dump.unit_size];
-			uint32_t page_no = page_base + i;
+	if (m1_fb_close_file(&w.file))
+		w.error = true;
 
-			snprintf(line, sizeof(line),
-					"Page %03lu: %02X %02X %02X %02X\r\n",
-					(unsigned long)page_no,
-					page[0], page[1], page[2], page[3]);
-			m1_fb_write_to_file(&nfc_file, line, strlen(line));
-		}
+	if (w.error) {
+		platformLog("nfc_profile_save: Error writing file '%s'\r\n", tmp_path);
+		m1_fb_delete_file(tmp_path);
+		return false;
+	}
+
+	// Replace the destination with the complete file, the previous save is kept until then
+	fres = m1_fb_replace_file(tmp_path, fp);
+	if (fres != FR_OK) {
+		platformLog("nfc_profile_save: Error renaming '%s' (%d)\r\n", tmp_path, fres);
+		m1_fb_delete_file(tmp_path);
+		return false;
 	}
 
-	m1_fb_close_file(&nfc_file);
 	return true;
 }
 
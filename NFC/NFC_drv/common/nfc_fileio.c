@@ -105,6 +105,44 @@ int nfcfio_getline(nfcfio_t* io, char* out, size_t outsz) {
     }
 }
 
+/*============================================================================*/
+/**
+ * @brief Read a line without copying it when it lies within the read buffer
+ * @param io Pointer to the nfcfio context
+ * @param scratch Buffer used for lines which continue in the next read block
+ * @param scratchsz Size of the scratch buffer, also the line length limit as for nfcfio_getline()
+ * @param line Set to the line, which is not null terminated
+ * @return >=0: line length (includes '\n'), -1: EOF (no more data), -2: error
+ * @note Returns the same lines as nfcfio_getline() with the same buffer size
+ */
+/*============================================================================*/
+int nfcfio_getline_ref(nfcfio_t* io, char* scratch, size_t scratchsz, const char** line) {
+    if (!io || !scratch || scratchsz == 0 || !line) return -2;
+
+    if (io->rpos >= io->rlen && !nfcfio_refill(io)) return -1;
+
+    const char* s   = (const char*)io->rbuf + io->rpos;
+    size_t avail    = io->rlen - io->rpos;
+    size_t max      = scratchsz - 1;
+    const char* nl  = memchr(s, '\n', (avail < max) ? avail : max);
+
+    if (nl) {
+        size_t n = (size_t)(nl - s) + 1;
+        io->rpos += n;
+        *line = s;
+        return (int)n;
+    }
+    if (avail >= max) { /* Truncated, as nfcfio_getline() does */
+        io->rpos += max;
+        *line = s;
+        return (int)max;
+    }
+
+    /* Line continues in the next read block */
+    *line = scratch;
+    return nfcfio_getline(io, scratch, scratchsz);
+}
+
 /*============================================================================*/
 /**
  * @brief Write a string to file (no newline appended)
@@ -117,7 +155,7 @@ int nfcfio_getline(nfcfio_t* io, char* out, size_t outsz) {
 int nfcfio_puts(nfcfio_t* io, const char* s) {
     if (!io || !s) return 0;
     size_t n = strlen(s);
-    return (m1_fb_write_to_file(&io->fh, s, (uint16_t)n) == (uint16_t)n);
+    return (m1_fb_write_to_file(&io->fh, s, (uint32_t)n) == n);
 }
 
 /*============================================================================*/
@@ -81,6 +81,16 @@ static inline void nfcfio_set_crlf(nfcfio_t* io, int on) { if (io) io->eol_crlf
  */
 int  nfcfio_getline(nfcfio_t* io, char* out, size_t outsz);
 
+/**
+ * @brief Read a line without copying it when it lies within the read buffer
+ * @param io Pointer to the nfcfio context
+ * @param scratch Buffer used for lines which continue in the next read block
+ * @param scratchsz Size of the scratch buffer, also the line length limit as for nfcfio_getline()
+ * @param line Set to the line, which is not null terminated
+ * @return >=0: line length (includes '\n'), -1: EOF (no more data), -2: error
+ */
+int  nfcfio_getline_ref(nfcfio_t* io, char* scratch, size_t scratchsz, const char** line);
+
 /**
  * @brief Write a string to file (no newline appended)
  * @param io Pointer to the nfcfio context
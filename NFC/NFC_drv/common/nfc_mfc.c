@@ -0,0 +1,418 @@
+/* See COPYING.txt for license details. */
+
+/*
+ ******************************************************************************
+ * nfc_mfc.c - MIFARE Classic reader
+ ******************************************************************************
+ *
+ * [Purpose]
+ * - Three pass authentication, plain or nested in a running session
+ * - Encrypted block reads
+ * - Whole card read with the key dictionary (mfc_read_card())
+ *
+ * [Authentication]
+ * 1. Reader: AUTH(type, block)       Card: nT (encrypted when nested)
+ * 2. Reader: {nR}{aR}, aR = suc64(nT) Card: {aT}, aT = suc96(nT)
+ * A card which rejects the key does not answer and must be selected again.
+ * A nested authentication skips that selection after a success.
+ *
+ ******************************************************************************
+ */
+
+#include <string.h>
+
+#include "nfc_mfc.h"
+#include "logger.h"
+
+/*============================================================================*/
+/**
+ * @brief Compute the CRC_A of ISO14443A
+ * @param data Data
+ * @param len Data length
+ * @param crc CRC, LSB first as sent
+ */
+/*============================================================================*/
+void mfc_crc_a(const uint8_t *data, uint16_t len, uint8_t crc[2])
+{
+    uint16_t c = 0x6363U;
+    uint8_t b;
+
+    while (len--) {
+        b = (uint8_t)(*data++ ^ (uint8_t)c);
+        b = (uint8_t)(b ^ (b << 4));
+        c = (uint16_t)((c >> 8) ^ ((uint16_t)b << 8) ^ ((uint16_t)b << 3) ^ (b >> 4));
+    }
+    crc[0] = (uint8_t)c;
+    crc[1] = (uint8_t)(c >> 8);
+}
+
+/*============================================================================*/
+/**
+ * @brief Set the plain parity bits of a frame
+ * @param frame Frame
+ */
+/*============================================================================*/
+void mfc_frame_parity(mfc_frame_t *frame)
+{
+    uint8_t i;
+
+    frame->par = 0;
+    for (i = 0; i < frame->len; i++)
+        frame->par |= (uint32_t)crypto1_parity8(frame->data[i]) << i;
+}
+
+/*============================================================================*/
+/**
+ * @brief Check the plain parity bits of a frame
+ * @param frame Frame
+ * @return true if all parity bits are right
+ */
+/*============================================================================*/
+bool mfc_frame_check_parity(const mfc_frame_t *frame)
+{
+    uint8_t i;
+
+    for (i = 0; i < frame->len; i++) {
+        if (((frame->par >> i) & 1U) != crypto1_parity8(frame->data[i])) return false;
+    }
+    return true;
+}
+
+/*============================================================================*/
+/**
+ * @brief Build a command frame: data and CRC_A
+ */
+/*============================================================================*/
+static void mfc_frame_command(mfc_frame_t *frame, uint8_t cmd, uint8_t arg)
+{
+    frame->data[0] = cmd;
+    frame->data[1] = arg;
+    mfc_crc_a(frame->data, 2, &frame->data[2]);
+    frame->len = 4;
+    frame->bits = 0;
+    mfc_frame_parity(frame);
+}
+
+/*============================================================================*/
+/**
+ * @brief Encrypt a frame with the session keystream, parity bits included
+ * @param cs Cipher state
+ * @param frame Frame
+ */
+/*============================================================================*/
+void mfc_frame_encrypt(crypto1_t *cs, mfc_frame_t *frame)
+{
+    uint8_t i, plain;
+
+    if (frame->bits) {
+        /* 4-bit ACK/NAK */
+        for (i = 0; i < frame->bits; i++)
+            frame->data[0] ^= (uint8_t)(crypto1_bit(cs, 0, false) << i);
+        return;
+    }
+
+    frame->par = 0;
+    for (i = 0; i < frame->len; i++) {
+        plain = frame->data[i];
+        frame->data[i] = plain ^ crypto1_byte(cs, 0, false);
+        frame->par |= (uint32_t)(crypto1_parity8(plain) ^ crypto1_peek(cs)) << i;
+    }
+}
+
+/*============================================================================*/
+/**
+ * @brief Decrypt a frame with the session keystream
+ * @param cs Cipher state
+ * @param frame Frame
+ * @return true if the parity bits are right
+ */
+/*============================================================================*/
+bool mfc_frame_decrypt(crypto1_t *cs, mfc_frame_t *frame)
+{
+    bool ok = true;
+    uint8_t i;
+
+    if (frame->bits) {
+        /* 4-bit ACK/NAK */
+        for (i = 0; i < frame->bits; i++)
+            frame->data[0] ^= (uint8_t)(crypto1_bit(cs, 0, false) << i);
+        return true;
+    }
+
+    for (i = 0; i < frame->len; i++) {
+        frame->data[i] ^= crypto1_byte(cs, 0, false);
+        if (((frame->par >> i) & 1U) != (crypto1_parity8(frame->data[i]) ^ crypto1_peek(cs)))
+            ok = false;
+    }
+    return ok;
+}
+
+/*============================================================================*/
+/**
+ * @brief Big endian word of 4 bytes, the Crypto1 word order
+ */
+/*============================================================================*/
+static uint32_t mfc_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/*============================================================================*/
+/**
+ * @brief Set up a reader for a selected card
+ * @param rd Reader
+ * @param link Link to the card
+ * @param uid UID of the card
+ * @param uid_len 4 or 7
+ * @param seed Seed of the reader nonces
+ */
+/*============================================================================*/
+void mfc_reader_init(mfc_reader_t *rd, const mfc_link_t *link, const uint8_t *uid, uint8_t uid_len, uint32_t seed)
+{
+    memset(rd, 0, sizeof(*rd));
+    rd->link = link;
+    rd->cuid = mfc_be32(&uid[uid_len - 4]);
+    rd->nr_rng = seed ? seed : 1;
+    rd->selected = true;
+    rd->nested = true;
+}
+
+/*============================================================================*/
+/**
+ * @brief Drop the session after a failure, the card must be selected again
+ */
+/*============================================================================*/
+static bool mfc_reader_fail(mfc_reader_t *rd)
+{
+    rd->authed = false;
+    rd->selected = false;
+    return false;
+}
+
+/*============================================================================*/
+/**
+ * @brief Authenticate a block with a key
+ *
+ * Within a running session and with rd->nested set, the authentication is
+ * nested: the command and the card nonce are encrypted and the card needs
+ * no new selection. Otherwise the card is selected again first.
+ *
+ * @param rd Reader
+ * @param block Block number
+ * @param type Key A or B
+ * @param key Key
+ * @return true if the card accepted the key
+ */
+/*============================================================================*/
+bool mfc_reader_auth(mfc_reader_t *rd, uint8_t block, mfc_key_type_t type, const uint8_t key[MFC_KEY_LEN])
+{
+    mfc_frame_t tx, rx;
+    uint32_t nt, nr, ar;
+    uint8_t i, b;
+    bool nested;
+
+    if (!rd->selected || (rd->authed && !rd->nested)) {
+        rd->reselects++;
+        rd->authed = false;
+        rd->selected = rd->link->reselect(rd->link->ctx);
+        if (!rd->selected) return false;
+    }
+    nested = rd->authed;
+
+    /* 1) AUTH, card nonce */
+    mfc_frame_command(&tx, (uint8_t)type, block);
+    if (nested) mfc_frame_encrypt(&rd->cs, &tx);
+    rd->auths++;
+    if (!rd->link->xfer(rd->link->ctx, &tx, &rx) || rx.len != 4 || rx.bits)
+        return mfc_reader_fail(rd);
+
+    crypto1_init(&rd->cs, key);
+    if (nested) {
+        nt = mfc_be32(rx.data);
+        nt ^= crypto1_word(&rd->cs, nt ^ rd->cuid, true);
+    } else {
+        if (!mfc_frame_check_parity(&rx)) return mfc_reader_fail(rd);
+        nt = mfc_be32(rx.data);
+        crypto1_word(&rd->cs, nt ^ rd->cuid, false);
+    }
+
+    /* 2) {nR}{aR}, card answer {aT} */
+    rd->nr_rng ^= rd->nr_rng << 13;
+    rd->nr_rng ^= rd->nr_rng >> 17;
+    rd->nr_rng ^= rd->nr_rng << 5;
+    nr = rd->nr_rng;
+    ar = crypto1_prng_successor(nt, 64);
+    tx.par = 0;
+    for (i = 0; i < 8; i++) {
+        if (i < 4) {
+            b = (uint8_t)(nr >> (24 - 8 * i));
+            tx.data[i] = b ^ crypto1_byte(&rd->cs, b, false);
+        } else {
+            b = (uint8_t)(ar >> (24 - 8 * (i - 4)));
+            tx.data[i] = b ^ crypto1_byte(&rd->cs, 0, false);
+        }
+        tx.par |= (uint32_t)(crypto1_parity8(b) ^ crypto1_peek(&rd->cs)) << i;
+    }
+    tx.len = 8;
+    tx.bits = 0;
+    if (!rd->link->xfer(rd->link->ctx, &tx, &rx) || rx.len != 4 || rx.bits)
+        return mfc_reader_fail(rd);
+
+    if ((mfc_be32(rx.data) ^ crypto1_word(&rd->cs, 0, false)) != crypto1_prng_successor(nt, 96))
+        return mfc_reader_fail(rd);
+
+    rd->authed = true;
+    return true;
+}
+
+/*============================================================================*/
+/**
+ * @brief mfc_auth_fn_t of the reader: authenticate the first block of a sector
+ * @param ctx Reader
+ * @param sector Sector number
+ * @param type Key A or B
+ * @param key Key
+ * @return true if the card accepted the key
+ */
+/*============================================================================*/
+bool mfc_reader_auth_sector(void *ctx, uint16_t sector, mfc_key_type_t type, const uint8_t key[MFC_KEY_LEN])
+{
+    return mfc_reader_auth((mfc_reader_t *)ctx, (uint8_t)mfc_sector_to_first_block(sector), type, key);
+}
+
+/*============================================================================*/
+/**
+ * @brief Read a block of the authenticated sector
+ * @param rd Reader
+ * @param block Block number
+ * @param out Block data
+ * @return true on success, false on failure
+ */
+/*============================================================================*/
+bool mfc_reader_read(mfc_reader_t *rd, uint8_t block, uint8_t out[MFC_BLOCK_SIZE])
+{
+    mfc_frame_t tx, rx;
+    uint8_t crc[2];
+
+    if (!rd->authed) return false;
+
+    mfc_frame_command(&tx, MFC_CMD_READ, block);
+    mfc_frame_encrypt(&rd->cs, &tx);
+    if (!rd->link->xfer(rd->link->ctx, &tx, &rx))
+        return mfc_reader_fail(rd);
+    if (rx.bits) {
+        mfc_frame_decrypt(&rd->cs, &rx);    /* NAK, the card leaves the session */
+        return mfc_reader_fail(rd);
+    }
+    if (rx.len != MFC_BLOCK_SIZE + 2 || !mfc_frame_decrypt(&rd->cs, &rx))
+        return mfc_reader_fail(rd);
+
+    mfc_crc_a(rx.data, MFC_BLOCK_SIZE, crc);
+    if (crc[0] != rx.data[MFC_BLOCK_SIZE] || crc[1] != rx.data[MFC_BLOCK_SIZE + 1])
+        return mfc_reader_fail(rd);
+
+    memcpy(out, rx.data, MFC_BLOCK_SIZE);
+    return true;
+}
+
+/*============================================================================*/
+/**
+ * @brief Estimate Mifare Classic capacity from SAK value
+ * @param sak SAK value
+ * @param sectors Sector count
+ * @param blocks Block count
+ */
+/*============================================================================*/
+void mfc_get_layout_from_sak(uint8_t sak, uint16_t *sectors, uint16_t *blocks)
+{
+    uint8_t base = sak & 0x1F;
+
+    if (base == 0x08) {
+        /* Mifare Classic 1K */
+        *sectors = 16;
+        *blocks  = 64;
+    } else if (base == 0x18) {
+        /* Mifare Classic 4K */
+        *sectors = 40;
+        *blocks  = 256;
+    } else {
+        /* If ambiguous, treat as 1K for now */
+        platformLog("[MFC] unknown SAK 0x%02X, fallback to 1K layout\r\n", sak);
+        *sectors = 16;
+        *blocks  = 64;
+    }
+}
+
+/*============================================================================*/
+/**
+ * @brief Convert sector number to first block number
+ * @param sector Sector number
+ * @return First block number of the sector
+ */
+/*============================================================================*/
+uint16_t mfc_sector_to_first_block(uint16_t sector)
+{
+    if (sector < 32) {
+        /* Sectors 0~31 have 4 blocks per sector */
+        return (uint16_t)(sector * 4);
+    } else {
+        /* Sectors 32~39 have 16 blocks per sector */
+        return (uint16_t)(128 + (sector - 32) * 16);
+    }
+}
+
+/*============================================================================*/
+/**
+ * @brief Read a whole card with the key dictionary
+ *
+ * Each sector is authenticated with mfc_find_sector_key(), keys already
+ * found on the card first, then all its blocks are read.
+ *
+ * @param rd Reader of the selected card
+ * @param dict Open key dictionary
+ * @param sectors Sector count
+ * @param blocks Block count, the size of dump in blocks
+ * @param dump Block data
+ * @param valid_bits Set for each block read
+ * @param attempts Incremented on every authentication
+ * @return Number of blocks up to the last one read
+ */
+/*============================================================================*/
+uint16_t mfc_read_card(mfc_reader_t *rd, mfc_dict_t *dict, uint16_t sectors, uint16_t blocks,
+                       uint8_t *dump, uint8_t *valid_bits, uint32_t *attempts)
+{
+    mfc_found_keys_t found;
+    mfc_key_type_t type;
+    uint8_t key[MFC_KEY_LEN];
+    uint16_t sector, first, count, block, last_seen = 0;
+
+    found.count = 0;
+
+    for (sector = 0; sector < sectors; sector++) {
+        first = mfc_sector_to_first_block(sector);
+        count = (sector < 32) ? 4 : 16;
+        if (first >= blocks) break;
+
+        /* Keys of the card first, then the dictionary, both A/B */
+        if (!mfc_find_sector_key(dict, &found, sector, mfc_reader_auth_sector, rd, key, &type, attempts)) {
+            platformLog("[MFC] sector %u auth FAILED\r\n", sector);
+            continue;
+        }
+        platformLog("[MFC] sector %u auth OK as Key%c (%lu attempts so far)\r\n",
+                    sector, (type == MFC_KEYTYPE_A) ? 'A' : 'B', *attempts);
+
+        for (block = first; block < first + count && block < blocks; block++) {
+            /* A failed read ends the session, authenticate again with the key found */
+            if (!rd->authed && !mfc_reader_auth(rd, (uint8_t)first, type, key)) break;
+            if (!mfc_reader_read(rd, (uint8_t)block, &dump[block * MFC_BLOCK_SIZE])) {
+                platformLog("[MFC] read block %u failed\r\n", block);
+                continue;
+            }
+            /* Set flag that this block is valid */
+            valid_bits[block >> 3] |= (uint8_t)(1U << (block & 0x7));
+            if (block + 1 > last_seen) last_seen = block + 1;
+        }
+    }
+
+    return last_seen;
+}
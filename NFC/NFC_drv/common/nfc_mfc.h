@@ -0,0 +1,92 @@
+/* See COPYING.txt for license details. */
+
+#ifndef NFC_DRV_NFC_MFC_H_
+#define NFC_DRV_NFC_MFC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "nfc_crypto1.h"
+#include "nfc_mfc_dict.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * MIFARE Classic reader
+ *
+ * The reader exchanges frames with the card through an mfc_link_t: the RF
+ * front end on the target, the card model of tests/host/nfc_mfc_sim.c in
+ * the host tests. Frames carry their parity bits, which Crypto1 encrypts, and
+ * their CRC_A.
+ */
+#define MFC_BLOCK_SIZE          16
+#define MFC_FRAME_MAX           18      /* Block and CRC_A */
+#define MFC_FWT_US              1000    /* Wait for an answer, also after a failed authentication */
+
+#define MFC_CMD_AUTH_A          0x60
+#define MFC_CMD_AUTH_B          0x61
+#define MFC_CMD_READ            0x30
+#define MFC_CMD_HALT            0x50
+
+#define MFC_ACK                 0x0A    /* 4-bit answers */
+
+typedef struct {
+    uint8_t  data[MFC_FRAME_MAX];
+    uint8_t  len;                       /* Bytes, 0 if no answer */
+    uint8_t  bits;                      /* Bits of a short frame (ACK/NAK), 0 for whole bytes */
+    uint32_t par;                       /* Parity bit of data[i] in bit i */
+} mfc_frame_t;
+
+typedef struct {
+    /**
+     * @brief Send a frame and receive the answer
+     * @param ctx Link context
+     * @param tx Frame sent
+     * @param rx Answer, len 0 if none within MFC_FWT_US
+     * @return false on a link error
+     */
+    bool (*xfer)(void *ctx, const mfc_frame_t *tx, mfc_frame_t *rx);
+    /**
+     * @brief Wake up and select the card again (WUPA, SELECT)
+     * @param ctx Link context
+     * @return true if the card answered
+     */
+    bool (*reselect)(void *ctx);
+    void *ctx;
+} mfc_link_t;
+
+typedef struct {
+    const mfc_link_t *link;
+    uint32_t  cuid;                     /* UID used by Crypto1: the last 4 bytes */
+    crypto1_t cs;
+    uint32_t  nr_rng;                   /* Reader nonce generator */
+    bool      authed;                   /* Crypto1 session running */
+    bool      selected;                 /* Card selected, false after a failed command */
+    bool      nested;                   /* Authenticate within the running session */
+    uint32_t  auths;                    /* Authentications sent */
+    uint32_t  reselects;                /* Card selections */
+} mfc_reader_t;
+
+void mfc_crc_a(const uint8_t *data, uint16_t len, uint8_t crc[2]);
+void mfc_frame_parity(mfc_frame_t *frame);
+bool mfc_frame_check_parity(const mfc_frame_t *frame);
+void mfc_frame_encrypt(crypto1_t *cs, mfc_frame_t *frame);
+bool mfc_frame_decrypt(crypto1_t *cs, mfc_frame_t *frame);
+
+void mfc_reader_init(mfc_reader_t *rd, const mfc_link_t *link, const uint8_t *uid, uint8_t uid_len, uint32_t seed);
+bool mfc_reader_auth(mfc_reader_t *rd, uint8_t block, mfc_key_type_t type, const uint8_t key[MFC_KEY_LEN]);
+bool mfc_reader_auth_sector(void *ctx, uint16_t sector, mfc_key_type_t type, const uint8_t key[MFC_KEY_LEN]);
+bool mfc_reader_read(mfc_reader_t *rd, uint8_t block, uint8_t out[MFC_BLOCK_SIZE]);
+
+void mfc_get_layout_from_sak(uint8_t sak, uint16_t *sectors, uint16_t *blocks);
+uint16_t mfc_sector_to_first_block(uint16_t sector);
+uint16_t mfc_read_card(mfc_reader_t *rd, mfc_dict_t *dict, uint16_t sectors, uint16_t blocks,
+                       uint8_t *dump, uint8_t *valid_bits, uint32_t *attempts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NFC_DRV_NFC_MFC_H_ */
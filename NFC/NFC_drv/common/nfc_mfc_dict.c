@@ -0,0 +1,432 @@
+/* See COPYING.txt for license details. */
+
+/*
+ ******************************************************************************
+ * nfc_mfc_dict.c - MIFARE Classic key dictionary
+ ******************************************************************************
+ *
+ * [Purpose]
+ * - Compiles the text key dictionary into a deduplicated binary key file
+ * - Streams the binary key file
+ * - Searches the key of a sector, trying the keys already found on the card
+ *   first
+ *
+ ******************************************************************************
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "nfc_fileio.h"
+#include "nfc_mfc_dict.h"
+#include "m1_file_browser.h"
+#include "logger.h"
+
+#define MFC_DICT_EXTENSION_TMP  ".tmp"
+#define MFC_DICT_KEYS_GROW      512     /* Keys added to the compile table at a time */
+#define MFC_DICT_LINE_MAX       64
+
+/* Key (48 bits) in the high bits, line index in the low 16 bits */
+#define MFC_DICT_ENTRY_INDEX(e) ((uint32_t)((e) & 0xFFFFU))
+#define MFC_DICT_ENTRY_KEY(e)   ((e) >> 16)
+
+/*============================================================================*/
+/**
+ * @brief Parse one line of the text dictionary
+ * @param line Line, null terminated
+ * @param key Key, big endian as written
+ * @return true if the line holds a key
+ */
+/*============================================================================*/
+static bool mfc_dict_parse_line(const char *line, uint64_t *key)
+{
+    const char *p = line;
+    uint64_t k = 0;
+    uint8_t digits = 0;
+
+    while (*p == ' ' || *p == '\t') p++;
+
+    for (; digits < 2 * MFC_KEY_LEN; p++, digits++) {
+        char c = *p;
+        if (c >= '0' && c <= '9') k = (k << 4) | (uint64_t)(c - '0');
+        else if (c >= 'a' && c <= 'f') k = (k << 4) | (uint64_t)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') k = (k << 4) | (uint64_t)(c - 'A' + 10);
+        else return false;      /* Comment, empty or short line */
+    }
+
+    /* Trailing spaces or a comment only */
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    if (*p != '\0' && *p != '#') return false;
+
+    *key = k;
+    return true;
+}
+
+/*============================================================================*/
+/**
+ * @brief Order compile entries by key, then by line
+ */
+/*============================================================================*/
+static int mfc_dict_compare_key(const void *pa, const void *pb)
+{
+    uint64_t a = *(const uint64_t *)pa;
+    uint64_t b = *(const uint64_t *)pb;
+
+    return (a > b) - (a < b);
+}
+
+/*============================================================================*/
+/**
+ * @brief Order compile entries by line
+ */
+/*============================================================================*/
+static int mfc_dict_compare_index(const void *pa, const void *pb)
+{
+    uint32_t a = MFC_DICT_ENTRY_INDEX(*(const uint64_t *)pa);
+    uint32_t b = MFC_DICT_ENTRY_INDEX(*(const uint64_t *)pb);
+
+    return (a > b) - (a < b);
+}
+
+/*============================================================================*/
+/**
+ * @brief Compile a text dictionary into a binary key file
+ *
+ * Duplicate keys are removed, the first line of a key gives its place.
+ * The file is written to "<dst_path>.tmp" and replaces the binary key file
+ * once complete, see m1_fb_replace_file().
+ *
+ * @param src_path Text dictionary
+ * @param dst_path Binary key file
+ * @return true on success, false on failure
+ */
+/*============================================================================*/
+bool mfc_dict_compile(const char *src_path, const char *dst_path)
+{
+    nfcfio_t *io;
+    FILINFO fno;
+    FIL fh;
+    mfc_dict_hdr_t hdr;
+    char line[MFC_DICT_LINE_MAX];
+    char tmp_path[64];
+    uint64_t *entries = NULL, *grown, key;
+    uint32_t count = 0, capacity = 0, i, n;
+    uint8_t out[MFC_DICT_READ_KEYS * MFC_KEY_LEN];
+    bool ok = false, oom = false;
+    FRESULT fres;
+
+    if (!src_path || !dst_path) return false;
+    if (strlen(dst_path) + sizeof(MFC_DICT_EXTENSION_TMP) > sizeof(tmp_path)) return false;
+
+    if (f_stat(src_path, &fno) != FR_OK) {
+        platformLog("MFC dict not found: %s\r\n", src_path);
+        return false;
+    }
+
+    /* The read context holds a 1 KB buffer, keep it off the stack */
+    io = malloc(sizeof(nfcfio_t));
+    if (!io) return false;
+    if (!nfcfio_open_read(io, src_path)) {
+        free(io);
+        return false;
+    }
+
+    /* 1) Collect the keys with their line */
+    while (nfcfio_getline(io, line, sizeof(line)) >= 0) {
+        if (!mfc_dict_parse_line(line, &key)) continue;
+        if (count >= MFC_DICT_KEYS_MAX) {
+            platformLog("MFC dict key overflow (>%d)\r\n", MFC_DICT_KEYS_MAX);
+            break;
+        }
+        if (count == capacity) {
+            grown = realloc(entries, (capacity + MFC_DICT_KEYS_GROW) * sizeof(uint64_t));
+            if (!grown) {
+                oom = true;
+                break;
+            }
+            entries = grown;
+            capacity += MFC_DICT_KEYS_GROW;
+        }
+        entries[count] = (key << 16) | count;
+        count++;
+    }
+    nfcfio_close(io);
+    free(io);
+
+    if (oom || count == 0) {
+        free(entries);
+        return false;
+    }
+
+    /* 2) Remove the duplicates, keeping the first line of each key */
+    qsort(entries, count, sizeof(uint64_t), mfc_dict_compare_key);
+    for (i = 1, n = 1; i < count; i++) {
+        if (MFC_DICT_ENTRY_KEY(entries[i]) != MFC_DICT_ENTRY_KEY(entries[n - 1]))
+            entries[n++] = entries[i];
+    }
+
+    /* 3) Back to the order of the text file */
+    qsort(entries, n, sizeof(uint64_t), mfc_dict_compare_index);
+
+    /* 4) Write the binary file */
+    strcpy(tmp_path, dst_path);
+    strcat(tmp_path, MFC_DICT_EXTENSION_TMP);
+    if (m1_fb_open_new_file(&fh, tmp_path)) {
+        free(entries);
+        return false;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = MFC_DICT_MAGIC;
+    hdr.version = MFC_DICT_VERSION;
+    hdr.key_size = MFC_KEY_LEN;
+    hdr.count = n;
+    hdr.src_size = (uint32_t)fno.fsize;
+    hdr.src_date = fno.fdate;
+    hdr.src_time = fno.ftime;
+    ok = (m1_fb_write_to_file(&fh, (const char *)&hdr, sizeof(hdr)) == sizeof(hdr));
+
+    for (i = 0; ok && i < n; ) {
+        uint32_t len = 0;
+        for (; i < n && len < sizeof(out); i++) {
+            key = MFC_DICT_ENTRY_KEY(entries[i]);
+            for (int b = MFC_KEY_LEN - 1; b >= 0; b--) {
+                out[len + b] = (uint8_t)key;
+                key >>= 8;
+            }
+            len += MFC_KEY_LEN;
+        }
+        ok = (m1_fb_write_to_file(&fh, (const char *)out, len) == len);
+    }
+    free(entries);
+
+    if (m1_fb_close_file(&fh)) ok = false;
+    if (!ok) {
+        platformLog("MFC dict write failed: %s\r\n", tmp_path);
+        m1_fb_delete_file(tmp_path);
+        return false;
+    }
+
+    /* The previous key file stays in place until the new one replaces it */
+    fres = m1_fb_replace_file(tmp_path, dst_path);
+    if (fres != FR_OK) {
+        platformLog("MFC dict replace failed (%d)\r\n", fres);
+        m1_fb_delete_file(tmp_path);
+        return false;
+    }
+
+    platformLog("MFC dict compiled: %lu keys, %lu unique\r\n", count, n);
+    return true;
+}
+
+/*============================================================================*/
+/**
+ * @brief Open the binary key file
+ *
+ * The text dictionary is compiled first if the binary file is missing or
+ * was compiled from another version of it. Without a text dictionary an
+ * existing binary file is used as it is.
+ *
+ * @param dict Dictionary reader (will be initialized)
+ * @return true on success, false on failure
+ */
+/*============================================================================*/
+bool mfc_dict_open(mfc_dict_t *dict)
+{
+    mfc_dict_hdr_t hdr;
+    FILINFO fno;
+    bool has_src, compiled = false;
+
+    if (!dict) return false;
+    memset(dict, 0, sizeof(*dict));
+
+    has_src = (f_stat(MFC_DICT_PATH, &fno) == FR_OK);
+
+    while (1) {
+        if (m1_fb_open_file(&dict->fh, MFC_DICT_BIN_PATH) == 0) {
+            if (m1_fb_read_from_file(&dict->fh, (char *)&hdr, sizeof(hdr)) == sizeof(hdr)
+                && hdr.magic == MFC_DICT_MAGIC && hdr.version == MFC_DICT_VERSION
+                && hdr.key_size == MFC_KEY_LEN
+                && f_size(&dict->fh) == sizeof(hdr) + (FSIZE_t)hdr.count * MFC_KEY_LEN
+                && (!has_src || (hdr.src_size == fno.fsize && hdr.src_date == fno.fdate
+                                 && hdr.src_time == fno.ftime))) {
+                dict->count = hdr.count;
+                return true;
+            }
+            m1_fb_close_file(&dict->fh);
+        }
+
+        if (!has_src || compiled) break;
+        if (!mfc_dict_compile(MFC_DICT_PATH, MFC_DICT_BIN_PATH)) break;
+        compiled = true;
+    }
+
+    platformLog("MFC dict missing or invalid\r\n");
+    return false;
+}
+
+/*============================================================================*/
+/**
+ * @brief Restart reading at the first key
+ * @param dict Dictionary reader
+ * @return true on success, false on failure
+ */
+/*============================================================================*/
+bool mfc_dict_rewind(mfc_dict_t *dict)
+{
+    dict->next = 0;
+    dict->buf_keys = 0;
+    dict->buf_pos = 0;
+    return (f_lseek(&dict->fh, sizeof(mfc_dict_hdr_t)) == FR_OK);
+}
+
+/*============================================================================*/
+/**
+ * @brief Read the next key
+ * @param dict Dictionary reader
+ * @param key Key
+ * @return true if a key was read, false at the end or on error
+ */
+/*============================================================================*/
+bool mfc_dict_next(mfc_dict_t *dict, uint8_t key[MFC_KEY_LEN])
+{
+    if (dict->buf_pos >= dict->buf_keys) {
+        uint32_t left = dict->count - dict->next;
+        uint16_t n = (left < MFC_DICT_READ_KEYS) ? (uint16_t)left : MFC_DICT_READ_KEYS;
+
+        if (n == 0) return false;
+        if (m1_fb_read_from_file(&dict->fh, (char *)dict->buf, n * MFC_KEY_LEN) != n * MFC_KEY_LEN)
+            return false;
+        dict->buf_keys = n;
+        dict->buf_pos = 0;
+    }
+
+    memcpy(key, &dict->buf[dict->buf_pos * MFC_KEY_LEN], MFC_KEY_LEN);
+    dict->buf_pos++;
+    dict->next++;
+    return true;
+}
+
+/*============================================================================*/
+/**
+ * @brief Read a key by its index. Reading continues after it.
+ * @param dict Dictionary reader
+ * @param index Key index
+ * @param key Key
+ * @return true on success, false on failure
+ */
+/*============================================================================*/
+bool mfc_dict_get(mfc_dict_t *dict, uint32_t index, uint8_t key[MFC_KEY_LEN])
+{
+    if (index >= dict->count) return false;
+    if (f_lseek(&dict->fh, sizeof(mfc_dict_hdr_t) + (FSIZE_t)index * MFC_KEY_LEN) != FR_OK)
+        return false;
+    dict->next = index;
+    dict->buf_keys = 0;
+    dict->buf_pos = 0;
+    return mfc_dict_next(dict, key);
+}
+
+/*============================================================================*/
+/**
+ * @brief Close the binary key file
+ * @param dict Dictionary reader
+ */
+/*============================================================================*/
+void mfc_dict_close(mfc_dict_t *dict)
+{
+    if (!dict) return;
+    (void)m1_fb_close_file(&dict->fh);
+}
+
+/*============================================================================*/
+/**
+ * @brief Move a key found on the card to the front of the found keys
+ * @param found Keys found on the card
+ * @param key Key
+ */
+/*============================================================================*/
+void mfc_found_keys_promote(mfc_found_keys_t *found, const uint8_t key[MFC_KEY_LEN])
+{
+    uint8_t i;
+
+    for (i = 0; i < found->count; i++) {
+        if (memcmp(found->keys[i], key, MFC_KEY_LEN) == 0) break;
+    }
+    if (i == found->count) {
+        if (found->count < MFC_FOUND_KEYS_MAX) found->count++;
+        else i--;               /* Drop the least recent key */
+    }
+
+    memmove(found->keys[1], found->keys[0], (size_t)i * MFC_KEY_LEN);
+    memcpy(found->keys[0], key, MFC_KEY_LEN);
+}
+
+/*============================================================================*/
+/**
+ * @brief Search the key of a sector
+ *
+ * The keys already found on the card are tried first, as key A and key B,
+ * then the rest of the dictionary. The key found is promoted to the front
+ * of the found keys for the next sectors.
+ *
+ * @param dict Dictionary reader
+ * @param found Keys found on the card, NULL to try the dictionary only
+ * @param sector Sector number
+ * @param auth Authentication function
+ * @param ctx Context of the authentication function
+ * @param key Key found
+ * @param type Type of the key found
+ * @param attempts Incremented on every authentication
+ * @return true if a key was found
+ */
+/*============================================================================*/
+bool mfc_find_sector_key(mfc_dict_t *dict, mfc_found_keys_t *found, uint16_t sector,
+                         mfc_auth_fn_t auth, void *ctx,
+                         uint8_t key[MFC_KEY_LEN], mfc_key_type_t *type, uint32_t *attempts)
+{
+    uint8_t cand[MFC_KEY_LEN];
+    uint8_t i, nfound = found ? found->count : 0;
+    bool known;
+
+    /* 1) Keys of the previous sectors */
+    for (i = 0; i < nfound; i++) {
+        memcpy(cand, found->keys[i], MFC_KEY_LEN);
+        (*attempts)++;
+        if (auth(ctx, sector, MFC_KEYTYPE_A, cand)) {
+            *type = MFC_KEYTYPE_A;
+            goto key_found;
+        }
+        (*attempts)++;
+        if (auth(ctx, sector, MFC_KEYTYPE_B, cand)) {
+            *type = MFC_KEYTYPE_B;
+            goto key_found;
+        }
+    }
+
+    /* 2) The rest of the dictionary */
+    if (!mfc_dict_rewind(dict)) return false;
+    while (mfc_dict_next(dict, cand)) {
+        known = false;
+        for (i = 0; i < nfound && !known; i++)
+            known = (memcmp(found->keys[i], cand, MFC_KEY_LEN) == 0);
+        if (known) continue;
+
+        (*attempts)++;
+        if (auth(ctx, sector, MFC_KEYTYPE_A, cand)) {
+            *type = MFC_KEYTYPE_A;
+            goto key_found;
+        }
+        (*attempts)++;
+        if (auth(ctx, sector, MFC_KEYTYPE_B, cand)) {
+            *type = MFC_KEYTYPE_B;
+            goto key_found;
+        }
+    }
+    return false;
+
+key_found:
+    memcpy(key, cand, MFC_KEY_LEN);
+    if (found) mfc_found_keys_promote(found, cand);
+    return true;
+}
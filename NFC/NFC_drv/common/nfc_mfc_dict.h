@@ -0,0 +1,94 @@
+/* See COPYING.txt for license details. */
+
+#ifndef NFC_DRV_NFC_MFC_DICT_H_
+#define NFC_DRV_NFC_MFC_DICT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "main.h"
+#include "m1_sdcard.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * MIFARE Classic key dictionary
+ *
+ * The text dictionary (one 12 hex digit key per line, '#' comments) is
+ * compiled into a binary key file the first time it is needed and again
+ * whenever the text file changes:
+ *  - mfc_dict_hdr_t, little endian
+ *  - count keys of MFC_KEY_LEN bytes, duplicates removed, in the order of
+ *    their first line in the text file (the dictionaries list the common
+ *    keys first)
+ * The binary file is read MFC_DICT_READ_KEYS keys at a time.
+ */
+#define MFC_DICT_PATH           "NFC/system/mf_classic_dict.nfc"
+#define MFC_DICT_BIN_PATH       "NFC/system/mf_classic_dict.bin"
+#define MFC_DICT_MAGIC          0x4B43464DU /* "MFCK" */
+#define MFC_DICT_VERSION        1
+
+#define MFC_KEY_LEN             6
+#define MFC_DICT_KEYS_MAX       4096    /* Keys accepted from the text file */
+#define MFC_DICT_READ_KEYS      64      /* Keys read from the binary file at a time */
+#define MFC_FOUND_KEYS_MAX      16      /* Keys of the card being read, tried first */
+
+typedef enum {
+    MFC_KEYTYPE_A = 0x60,
+    MFC_KEYTYPE_B = 0x61,
+} mfc_key_type_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t key_size;      /* MFC_KEY_LEN */
+    uint32_t count;         /* Keys in the file */
+    uint32_t src_size;      /* Size of the text file compiled */
+    uint16_t src_date;      /* FatFs date of the text file */
+    uint16_t src_time;      /* FatFs time of the text file */
+} mfc_dict_hdr_t;
+
+typedef struct {
+    FIL      fh;
+    uint32_t count;         /* Keys in the dictionary */
+    uint32_t next;          /* Index of the next key read */
+    uint16_t buf_keys;      /* Keys in buf */
+    uint16_t buf_pos;       /* Next key in buf */
+    uint8_t  buf[MFC_DICT_READ_KEYS * MFC_KEY_LEN];
+} mfc_dict_t;
+
+/* Keys found on the card being read, most recent first */
+typedef struct {
+    uint8_t keys[MFC_FOUND_KEYS_MAX][MFC_KEY_LEN];
+    uint8_t count;
+} mfc_found_keys_t;
+
+/**
+ * @brief Authenticates a sector with a key
+ * @param ctx Caller context
+ * @param sector Sector number
+ * @param type Key A or B
+ * @param key Key
+ * @return true if the card accepted the key
+ */
+typedef bool (*mfc_auth_fn_t)(void *ctx, uint16_t sector, mfc_key_type_t type, const uint8_t key[MFC_KEY_LEN]);
+
+bool mfc_dict_compile(const char *src_path, const char *dst_path);
+bool mfc_dict_open(mfc_dict_t *dict);
+bool mfc_dict_rewind(mfc_dict_t *dict);
+bool mfc_dict_next(mfc_dict_t *dict, uint8_t key[MFC_KEY_LEN]);
+bool mfc_dict_get(mfc_dict_t *dict, uint32_t index, uint8_t key[MFC_KEY_LEN]);
+void mfc_dict_close(mfc_dict_t *dict);
+
+void mfc_found_keys_promote(mfc_found_keys_t *found, const uint8_t key[MFC_KEY_LEN]);
+bool mfc_find_sector_key(mfc_dict_t *dict, mfc_found_keys_t *found, uint16_t sector,
+                         mfc_auth_fn_t auth, void *ctx,
+                         uint8_t key[MFC_KEY_LEN], mfc_key_type_t *type, uint32_t *attempts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NFC_DRV_NFC_MFC_DICT_H_ */
@@ -3,7 +3,6 @@
 
 #include <string.h>
 #include <stdio.h>
-#include <ctype.h>
 #include "nfc_storage.h"
 #include "m1_sdcard.h"
 #include "nfc_fileio.h"
@@ -13,6 +12,10 @@
 #include "logger.h"     /* platformLog */
 
 #define NFC_STORAGE_MIN_DUMP_UNITS  1
+#define NFC_STORAGE_UNIT_BYTES_MAX  32      /* Longest unit data accepted on a line */
+
+#define NFC_STORAGE_CHR_SPACE       0x10
+#define NFC_STORAGE_CHR_OTHER       0xFF
 
 typedef struct {
     uint8_t  tech;      /* M1NFC_TECH_* */
@@ -21,126 +24,29 @@ typedef struct {
 } nfc_family_info_t;
 
 
-/*============================================================================*/
-/**
- * @brief Remove leading whitespace from string
- * @param s String to trim (modified in place)
- * @return Pointer to trimmed string
- */
-/*============================================================================*/
-static char* str_ltrim(char* s)
-{
-    while (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n') s++;
-    return s;
-}
-
-/*============================================================================*/
-/**
- * @brief Remove trailing whitespace from string
- * @param s String to trim (modified in place)
- * @return Pointer to trimmed string
- */
-/*============================================================================*/
-static char* str_rtrim(char* s)
-{
-    size_t len = strlen(s);
-    while (len > 0 &&
-           (s[len-1] == ' ' || s[len-1] == '\t' ||
-            s[len-1] == '\r' || s[len-1] == '\n')) {
-        s[--len] = '\0';
-    }
-    return s;
-}
-
-/*============================================================================*/
-/**
- * @brief Remove leading and trailing whitespace from string
- * @param s String to trim (modified in place)
- * @return Pointer to trimmed string
- */
-/*============================================================================*/
-static char* str_trim(char* s)
-{
-    return str_ltrim(str_rtrim(s));
-}
-
-/*============================================================================*/
-/**
- * @brief Convert a single character to 0~15 hex value
- * @param c Character to convert
- * @return Hex value (0-15) on success, -1 on failure
- */
-/*============================================================================*/
-static int hex_nibble(char c)
-{
-    if (c >= '0' && c <= '9') return c - '0';
-    if (c >= 'a' && c <= 'f') return 10 + (c - 'a');
-    if (c >= 'A' && c <= 'F') return 10 + (c - 'A');
-    return -1;
-}
-
-/*============================================================================*/
-/**
- * @brief Parse HEX byte sequence from string (supports "AA BB CC" or "AABBCC" format)
- * @param s Input string containing hex bytes
- * @param out Output buffer for parsed bytes
- * @param max Maximum number of bytes to parse
- * @param out_len Pointer to store actual parsed length
- * @return 0 on success, 1 if second digit missing, 2 if invalid char/hex, 3 if buffer full
- */
-/*============================================================================*/
-static int parse_hex_bytes(char *s, uint8_t *out, size_t max, size_t *out_len)
-{
-    size_t      n        = 0;
-    int         have_hi  = 0;
-    uint8_t     hi_nib   = 0;
-    unsigned char *p     = (unsigned char *)str_trim(s);
-
-    while (*p)
-    {
-        /* Skip all whitespace */
-        if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
-            p++;
-            continue;
-        }
-
-        /* Non-hex character is treated as error */
-        if (!isxdigit(*p)) {
-            return 2;   // invalid char
-        }
-
-        int v = hex_nibble(*p);
-        if (v < 0) {
-            return 2;   // invalid hex
-        }
-
-        if (!have_hi) {
-            /* Store upper nibble */
-            hi_nib  = (uint8_t)v;
-            have_hi = 1;
-        } else {
-            /* Combine with lower nibble to complete 1 byte */
-            if (n >= max) {
-                return 3;   // out buffer full
-            }
-            out[n++] = (uint8_t)((hi_nib << 4) | (uint8_t)v);
-            have_hi  = 0;
-        }
-
-        p++;
-    }
-
-    /* Error if hex string has odd number of characters */
-    if (have_hi) {
-        return 1;   // second digit missing
-    }
-
-    if (out_len) {
-        *out_len = n;
-    }
-    return 0;
-}
-
+/* Character classes of the body tokenizer: hex digit value, whitespace or other */
+#define HS  NFC_STORAGE_CHR_SPACE
+#define HX  NFC_STORAGE_CHR_OTHER
+static const uint8_t nfc_storage_chr_class[256] = {
+      HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HS,   HS,   HX,   HX,   HS,   HX,   HX,
+      HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,
+      HS,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09,   HX,   HX,   HX,   HX,   HX,   HX,
+      HX, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,
+      HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,
+      HX, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,
+      HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,
+      HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,
+      HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,
+      HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,
+      HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,
+      HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,
+      HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,
+      HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,
+      HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,   HX,
+};
+#undef HS
+#undef HX
 
 /*============================================================================*/
 /**
@@ -234,18 +140,20 @@ static int parse_device_type(const char* s, nfc_family_info_t* out)
 
 /*============================================================================*/
 /**
- * @brief Parse header section using INI style parsing (hybrid approach)
+ * @brief Parse the header fields from a profile session
  * 
  * Uses privateprofilestring.c for header fields (Filetype, Version, Device type, UID, ATQA, SAK, ATS)
  * This provides consistency with RFID parsing and better maintainability.
  * 
+ * @param ps Profile session of the NFC file
  * @param c Pointer to NFC context
  * @param faminfo Pointer to output family info structure
  * @param file_path Full path to the NFC file
  * @return NFC_STORAGE_OK on success, error code on failure
  */
 /*============================================================================*/
-static nfc_storage_result_t nfc_storage_parse_header_ini(
+static nfc_storage_result_t nfc_storage_parse_header_fields(
+        ProfileSession* ps,
         nfc_run_ctx_t* c,
         nfc_family_info_t* faminfo,
         const char* file_path)
@@ -260,7 +168,7 @@ static nfc_storage_result_t nfc_storage_parse_header_ini(
     /* 1) Validate Filetype and Version */
     data.buf = buf;
     data.max_len = sizeof(buf);
-    if (!isValidHeaderField(&data, "M1 NFC device", "4", file_path)) {
+    if (!profile_is_valid_header(ps, &data, "M1 NFC device", "4")) {
         platformLog("Filetype/Version Parsing Fail\r\n");
         return NFC_STORAGE_ERR_FORMAT;
     }
@@ -270,7 +178,7 @@ static nfc_storage_result_t nfc_storage_parse_header_ini(
     data.buf = buf;
     data.max_len = sizeof(buf);
     data.type = VALUE_TYPE_STRING;
-    if (!GetPrivateProfileString(&data, "Device type", file_path)) {
+    if (!profile_get_string(ps, &data, "Device type")) {
         platformLog("Device type not found\r\n");
         return NFC_STORAGE_ERR_FORMAT;
     }
@@ -293,7 +201,7 @@ static nfc_storage_result_t nfc_storage_parse_header_ini(
     // Debug: Check what we're trying to parse
     platformLog("[NFC Storage] Parsing UID from file: %s\r\n", file_path);
     
-    if (!GetPrivateProfileHex(&data, "UID", file_path)) {
+    if (!profile_get_hex(ps, &data, "UID")) {
         platformLog("UID not found\r\n");
         return NFC_STORAGE_ERR_FORMAT;
     }
@@ -317,7 +225,7 @@ static nfc_storage_result_t nfc_storage_parse_header_ini(
         data.buf = c->head.a.atqa;
         data.max_len = 2;
         data.type = VALUE_TYPE_HEX_ARRAY;
-        if (GetPrivateProfileHex(&data, "ATQA", file_path) && data.v.hex.out_len == 2) {
+        if (profile_get_hex(ps, &data, "ATQA") && data.v.hex.out_len == 2) {
             c->head.a.has_atqa = true;
         }
     }
@@ -328,7 +236,7 @@ static nfc_storage_result_t nfc_storage_parse_header_ini(
         data.buf = tmp_sak;
         data.max_len = 1;
         data.type = VALUE_TYPE_HEX_ARRAY;
-        if (GetPrivateProfileHex(&data, "SAK", file_path) && data.v.hex.out_len == 1) {
+        if (profile_get_hex(ps, &data, "SAK") && data.v.hex.out_len == 1) {
             c->head.a.sak = tmp_sak[0];
             c->head.a.has_sak = true;
         }
@@ -339,7 +247,7 @@ static nfc_storage_result_t nfc_storage_parse_header_ini(
         data.buf = c->head.a.ats;
         data.max_len = sizeof(c->head.a.ats);
         data.type = VALUE_TYPE_HEX_ARRAY;
-        if (GetPrivateProfileHex(&data, "ATS", file_path) && data.v.hex.out_len > 0) {
+        if (profile_get_hex(ps, &data, "ATS") && data.v.hex.out_len > 0) {
             c->head.a.ats_len = (uint8_t)data.v.hex.out_len;
         }
     }
@@ -353,51 +261,180 @@ static nfc_storage_result_t nfc_storage_parse_header_ini(
 
 /*============================================================================*/
 /**
- * @brief Store unit data from "Page N:" / "Block N:" line into dump buffer
- * @param dump_buf Dump buffer to store data
+ * @brief Parse header section using INI style parsing (hybrid approach)
+ *
+ * All header fields are read through one profile session, which reads the
+ * file once and only as far as the last header field.
+ *
+ * @param c Pointer to NFC context
+ * @param faminfo Pointer to output family info structure
+ * @param file_path Full path to the NFC file
+ * @return NFC_STORAGE_OK on success, error code on failure
+ */
+/*============================================================================*/
+static nfc_storage_result_t nfc_storage_parse_header_ini(
+        nfc_run_ctx_t* c,
+        nfc_family_info_t* faminfo,
+        const char* file_path)
+{
+    ProfileSession ps;
+    nfc_storage_result_t ret;
+
+    if (!profile_open(&ps, file_path)) {
+        return NFC_STORAGE_ERR_IO;
+    }
+    ret = nfc_storage_parse_header_fields(&ps, c, faminfo, file_path);
+    profile_close(&ps);
+
+    return ret;
+}
+
+/*============================================================================*/
+/**
+ * @brief Test for the whitespace which is trimmed from the lines
+ * @param ch Character to test
+ * @return true for ' ', '\t', '\r', '\n'
+ */
+/*============================================================================*/
+static inline bool nfc_storage_is_trim(char ch)
+{
+    return nfc_storage_chr_class[(uint8_t)ch] == NFC_STORAGE_CHR_SPACE;
+}
+
+/*============================================================================*/
+/**
+ * @brief Parse the unit number of a "Page N" / "Block N" label
+ *
+ * Accepts what sscanf("%lu") accepts on the 32-bit target: leading
+ * whitespace, an optional sign, decimal digits up to the first other
+ * character, saturating at 0xFFFFFFFF.
+ *
+ * @param p Text following the label
+ * @param end End of the label (the colon)
+ * @param idx Parsed unit number
+ * @return true if at least one digit was found
+ */
+/*============================================================================*/
+static bool nfc_storage_parse_index(const char* p, const char* end, uint32_t* idx)
+{
+    bool neg = false, digits = false, overflow = false;
+    uint32_t v = 0;
+
+    while (p < end && (*p == ' ' || (*p >= '\t' && *p <= '\r'))) p++;
+    if (p < end && (*p == '+' || *p == '-')) neg = (*p++ == '-');
+
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        uint32_t d = (uint32_t)(*p - '0');
+        digits = true;
+        if (v > (UINT32_MAX - d) / 10) overflow = true;
+        else v = v * 10 + d;
+    }
+
+    if (overflow) v = UINT32_MAX;
+    else if (neg) v = (uint32_t)0 - v;
+    *idx = v;
+
+    return digits;
+}
+
+/*============================================================================*/
+/**
+ * @brief Parse one body line straight into the dump buffer
+ *
+ * Same rules as the header-less line format has always had:
+ * - Whitespace (' ', '\t', '\r', '\n') is trimmed, empty and '#' lines are skipped
+ * - "Block N:" and "Page N:" are both stored with the unit size of the family
+ * - Other lines, lines without a colon and labels without a number are skipped
+ * - The data is hex digits in pairs, whitespace may appear anywhere;
+ *   short data is padded with zeros, long data is truncated to the unit size
+ * - An invalid character, an odd digit count or more than
+ *   NFC_STORAGE_UNIT_BYTES_MAX bytes fails the whole load
+ * The hex digits are decoded through a lookup table and written directly to
+ * the unit in the dump buffer. Units beyond the buffer are checked but ignored.
+ *
+ * @param line Line as returned by nfcfio_getline_ref()
+ * @param len Line length
+ * @param dump_buf Dump buffer
  * @param unit_size Size of each unit (page/block)
- * @param unit_count Total number of units
+ * @param unit_count Number of units in the dump buffer
  * @param valid_bits Valid bits bitmap (optional)
  * @param valid_bits_bytes Size of valid_bits buffer
- * @param max_seen_unit Pointer to update maximum seen unit index
- * @param idx Unit index to store
- * @param src_bytes Source data bytes
- * @param src_len Length of source data
+ * @param max_seen_unit Updated with the highest unit index stored
+ * @return NFC_STORAGE_OK if the line was stored or skipped, NFC_STORAGE_ERR_FORMAT on bad data
  */
 /*============================================================================*/
-static void nfc_storage_store_unit(
+static nfc_storage_result_t nfc_storage_parse_unit_line(
+        const char* line,
+        size_t      len,
         uint8_t*    dump_buf,
         uint16_t    unit_size,
         uint32_t    unit_count,
         uint8_t*    valid_bits,
         uint32_t    valid_bits_bytes,
-        uint32_t*   max_seen_unit,
-        uint32_t    idx,
-        const uint8_t* src_bytes,
-        size_t      src_len)
+        uint32_t*   max_seen_unit)
 {
-    if (!dump_buf || unit_size == 0 || unit_count == 0) return;
-
-    if (src_len < unit_size) {
-        /* Pad remaining part with 0 if insufficient */
-        uint8_t tmp[32] = {0};
-        size_t copy = src_len;
-        if (copy > sizeof(tmp)) copy = sizeof(tmp);
-        memcpy(tmp, src_bytes, copy);
-
-        if (idx < unit_count) {
-            memcpy(dump_buf + idx * unit_size, tmp, unit_size);
-            mark_unit_valid(valid_bits, valid_bits_bytes, idx);
-            if (max_seen_unit && idx > *max_seen_unit) *max_seen_unit = idx;
+    const char* p   = line;
+    const char* end = memchr(line, '\0', len);   /* The line ends at a null byte */
+    const char* colon;
+    const char* label;
+    uint32_t idx, n = 0;
+    uint8_t  hi = 0, cls;
+    bool     have_hi = false;
+    uint8_t* dst;
+
+    if (!end) end = line + len;
+    while (p < end && nfc_storage_is_trim(*p)) p++;
+    while (end > p && nfc_storage_is_trim(end[-1])) end--;
+    if (p == end || *p == '#') return NFC_STORAGE_OK;
+
+    if ((end - p) >= 6 && memcmp(p, "Block ", 6) == 0) {
+        label = "Block";
+        p += 6;
+    } else if ((end - p) >= 5 && memcmp(p, "Page ", 5) == 0) {
+        label = "Page";
+        p += 5;
+    } else {
+        return NFC_STORAGE_OK;
+    }
+
+    colon = memchr(p, ':', (size_t)(end - p));
+    if (!colon) return NFC_STORAGE_OK;
+    if (!nfc_storage_parse_index(p, colon, &idx)) return NFC_STORAGE_OK;
+
+    dst = (idx < unit_count) ? dump_buf + idx * unit_size : NULL;
+
+    for (p = colon + 1; p < end; p++) {
+        cls = nfc_storage_chr_class[(uint8_t)*p];
+        if (cls == NFC_STORAGE_CHR_SPACE) continue;
+        if (cls == NFC_STORAGE_CHR_OTHER) {
+            platformLog("%s Parsing Fail [%d]\r\n", label, 2);
+            return NFC_STORAGE_ERR_FORMAT;
         }
-        return;
+        if (!have_hi) {
+            hi = cls;
+            have_hi = true;
+            continue;
+        }
+        if (n >= NFC_STORAGE_UNIT_BYTES_MAX) {
+            platformLog("%s Parsing Fail [%d]\r\n", label, 3);
+            return NFC_STORAGE_ERR_FORMAT;
+        }
+        if (dst && n < unit_size) dst[n] = (uint8_t)((hi << 4) | cls);
+        n++;
+        have_hi = false;
+    }
+    if (have_hi) {
+        platformLog("%s Parsing Fail [%d]\r\n", label, 1);
+        return NFC_STORAGE_ERR_FORMAT;
     }
 
-    if (idx >= unit_count) return; /* Buffer overflow → clip */
+    if (dst) {
+        if (n < unit_size) memset(dst + n, 0, unit_size - n);
+        mark_unit_valid(valid_bits, valid_bits_bytes, idx);
+        if (max_seen_unit && idx > *max_seen_unit) *max_seen_unit = idx;
+    }
 
-    memcpy(dump_buf + idx * unit_size, src_bytes, unit_size);
-    mark_unit_valid(valid_bits, valid_bits_bytes, idx);
-    if (max_seen_unit && idx > *max_seen_unit) *max_seen_unit = idx;
+    return NFC_STORAGE_OK;
 }
 
 /*============================================================================*/
@@ -439,63 +476,15 @@ static nfc_storage_result_t nfc_storage_parse_body(
     uint32_t max_seen = 0;
 
     while (1) {
-        int n = nfcfio_getline(&ps->io, ps->line, sizeof(ps->line));
+        const char* line;
+        int n = nfcfio_getline_ref(&ps->io, ps->line, sizeof(ps->line), &line);
         if (n == -1) break;          /* EOF */
         if (n < 0)  return NFC_STORAGE_ERR_IO;
 
-        char* line = str_trim(ps->line);
-        if (line[0] == '\0') continue;
-        if (line[0] == '#')  continue;
-
-        /* Classic: "Block N:" */
-        if (strncmp(line, "Block ", 6) == 0) {
-            unsigned long idx = 0;
-            char* colon = strchr(line, ':');
-            if (!colon) continue;
-            *colon = '\0';
-            if (sscanf(line, "Block %lu", &idx) != 1) continue;
-
-            char* data_str = str_trim(colon + 1);
-            uint8_t bytes[32];
-            size_t  len = 0;
-            uint8_t b = parse_hex_bytes(data_str, bytes, sizeof(bytes), &len);
-            if (b != 0)
-            {
-                platformLog("Block Parsing Fail [%d]\r\n",b);
-                return NFC_STORAGE_ERR_FORMAT;
-            }
-            nfc_storage_store_unit(dump_buf, unit_size, unit_count,
-                                   valid_bits, valid_bits_bytes,
-                                   &max_seen, (uint32_t)idx,
-                                   bytes, len);
-            continue;
-        }
-
-        /* Type2: "Page N:" */
-        if (strncmp(line, "Page ", 5) == 0) {
-            unsigned long idx = 0;
-            char* colon = strchr(line, ':');
-            if (!colon) continue;
-            *colon = '\0';
-            if (sscanf(line, "Page %lu", &idx) != 1) continue;
-
-            char* data_str = str_trim(colon + 1);
-            uint8_t bytes[32];
-            size_t  len = 0;
-            uint8_t b = parse_hex_bytes(data_str, bytes, sizeof(bytes), &len);
-            if (b != 0)
-            {
-                platformLog("Page Parsing Fail [%d]\r\n",b);
-                return NFC_STORAGE_ERR_FORMAT;
-            }
-            nfc_storage_store_unit(dump_buf, unit_size, unit_count,
-                                   valid_bits, valid_bits_bytes,
-                                   &max_seen, (uint32_t)idx,
-                                   bytes, len);
-            continue;
-        }
-
-        /* Felica/ISO15693, etc. can add separate processing here */
+        /* Felica/ISO15693, etc. can add separate processing in the line parser */
+        if (nfc_storage_parse_unit_line(line, (size_t)n, dump_buf, unit_size, unit_count,
+                                        valid_bits, valid_bits_bytes, &max_seen) != NFC_STORAGE_OK)
+            return NFC_STORAGE_ERR_FORMAT;
     }
 
     /* Parsing complete → set nfc_ctx.dump metadata */
@@ -0,0 +1,173 @@
+/* See COPYING.txt for license details. */
+
+/*
+ ******************************************************************************
+ * nfc_t2t_cache.c - Type 2 Tag emulation response cache
+ ******************************************************************************
+ *
+ * [Purpose]
+ * - Materializes the memory image of an emulated Type 2 Tag once
+ * - Keeps the READ (0x30) response of every start page ready with its
+ *   CRC_A, so the listener only points the transmitter at it
+ * - Serves FAST_READ (0x3A) from the contiguous image and GET_VERSION
+ *   (0x60) from its stored response
+ *
+ * [Write]
+ * A WRITE (0xA2) changes one page of the image and the READ responses of
+ * the four start pages which hold it. A page past the dump but inside the
+ * dump buffer extends the dump to it, the pages in between stay zeros.
+ *
+ ******************************************************************************
+ */
+
+#include <string.h>
+
+#include "nfc_t2t_cache.h"
+#include "nfc_mfc.h"
+
+/*============================================================================*/
+/**
+ * @brief Compose the READ response of a start page from the image
+ * @param cache Cache
+ * @param page Start page
+ */
+/*============================================================================*/
+static void t2t_cache_read_update(t2t_cache_t *cache, uint16_t page)
+{
+    uint8_t *resp = cache->read[page];
+    uint16_t i, cur;
+
+    for (i = 0; i < T2T_CACHE_READ_PAGES; i++) {
+        cur = (uint16_t)(page + i);
+        if (cur < cache->pages)
+            memcpy(&resp[i * T2T_CACHE_PAGE_SIZE], &cache->image[cur * T2T_CACHE_PAGE_SIZE], T2T_CACHE_PAGE_SIZE);
+        else
+            memset(&resp[i * T2T_CACHE_PAGE_SIZE], 0x00, T2T_CACHE_PAGE_SIZE);
+    }
+    mfc_crc_a(resp, T2T_CACHE_READ_LEN, &resp[T2T_CACHE_READ_LEN]);
+}
+
+/*============================================================================*/
+/**
+ * @brief Build the cache
+ * @param cache Cache
+ * @param pages Pages of the dump
+ * @param capacity Pages of the dump buffer, at least pages
+ * @param get_page Reads a page of the dump, the page reads as zeros on failure
+ * @param version GET_VERSION response, NULL if none
+ * @param version_len Length of the GET_VERSION response
+ */
+/*============================================================================*/
+void t2t_cache_build(t2t_cache_t *cache, uint16_t pages, uint16_t capacity, t2t_cache_page_fn_t get_page,
+                     const uint8_t *version, uint8_t version_len)
+{
+    uint16_t page;
+    uint8_t *dst;
+
+    if (pages > T2T_CACHE_PAGES_MAX)
+        pages = T2T_CACHE_PAGES_MAX;
+    if (capacity > T2T_CACHE_PAGES_MAX)
+        capacity = T2T_CACHE_PAGES_MAX;
+    cache->pages = pages;
+    cache->capacity = (capacity > pages) ? capacity : pages;
+
+    memset(cache->image, 0x00, sizeof(cache->image));
+    for (page = 0; page < pages; page++) {
+        dst = &cache->image[page * T2T_CACHE_PAGE_SIZE];
+        if (!get_page || !get_page(page, dst))
+            memset(dst, 0x00, T2T_CACHE_PAGE_SIZE);
+    }
+
+    for (page = 0; page < T2T_CACHE_PAGES_MAX; page++)
+        t2t_cache_read_update(cache, page);
+
+    cache->version_len = 0;
+    if (version && version_len && version_len <= T2T_CACHE_VERSION_LEN) {
+        memcpy(cache->version, version, version_len);
+        mfc_crc_a(cache->version, version_len, &cache->version[version_len]);
+        cache->version_len = (uint8_t)(version_len + T2T_CACHE_CRC_LEN);
+    }
+}
+
+/*============================================================================*/
+/**
+ * @brief Get the READ response of a start page
+ * @param cache Cache
+ * @param page Start page
+ * @return T2T_CACHE_READ_LEN bytes of data followed by the CRC_A
+ */
+/*============================================================================*/
+const uint8_t *t2t_cache_read(const t2t_cache_t *cache, uint8_t page)
+{
+    return cache->read[page];
+}
+
+/*============================================================================*/
+/**
+ * @brief Get the FAST_READ response of a page range
+ * @param cache Cache
+ * @param start First page
+ * @param end Last page, clamped to the dump
+ * @param len Response length without CRC_A, at most T2T_CACHE_FAST_READ_MAX
+ * @return Response, NULL if the range is invalid or outside the dump
+ */
+/*============================================================================*/
+const uint8_t *t2t_cache_fast_read(const t2t_cache_t *cache, uint8_t start, uint8_t end, uint16_t *len)
+{
+    uint16_t last;
+
+    if (end < start || start >= cache->pages)
+        return NULL;
+
+    last = (end < cache->pages) ? end : (uint16_t)(cache->pages - 1U);
+    *len = (uint16_t)((last - start + 1U) * T2T_CACHE_PAGE_SIZE);
+    if (*len > T2T_CACHE_FAST_READ_MAX)
+        *len = T2T_CACHE_FAST_READ_MAX;
+
+    return &cache->image[start * T2T_CACHE_PAGE_SIZE];
+}
+
+/*============================================================================*/
+/**
+ * @brief Get the GET_VERSION response
+ * @param cache Cache
+ * @param len Response length with CRC_A
+ * @return Response, NULL if the dump has no version
+ */
+/*============================================================================*/
+const uint8_t *t2t_cache_version(const t2t_cache_t *cache, uint16_t *len)
+{
+    if (!cache->version_len)
+        return NULL;
+
+    *len = cache->version_len;
+    return cache->version;
+}
+
+/*============================================================================*/
+/**
+ * @brief Write a page of the image
+ * @param cache Cache
+ * @param page Page
+ * @param data Page data
+ * @return true on success, false if the page is outside the dump buffer
+ */
+/*============================================================================*/
+bool t2t_cache_write(t2t_cache_t *cache, uint8_t page, const uint8_t data[T2T_CACHE_PAGE_SIZE])
+{
+    uint16_t first, start;
+
+    if (page >= cache->capacity)
+        return false;
+
+    /* The image past the dump is all zeros, so are the responses over it */
+    if (page >= cache->pages)
+        cache->pages = (uint16_t)(page + 1U);
+    memcpy(&cache->image[page * T2T_CACHE_PAGE_SIZE], data, T2T_CACHE_PAGE_SIZE);
+
+    first = (page >= T2T_CACHE_READ_PAGES - 1) ? (uint16_t)(page - (T2T_CACHE_READ_PAGES - 1)) : 0U;
+    for (start = first; start <= page; start++)
+        t2t_cache_read_update(cache, start);
+
+    return true;
+}
@@ -0,0 +1,56 @@
+/* See COPYING.txt for license details. */
+
+#ifndef NFC_DRV_NFC_T2T_CACHE_H_
+#define NFC_DRV_NFC_T2T_CACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Type 2 Tag emulation response cache
+ *
+ * Built once when emulation starts: the memory image of the tag, the READ
+ * response of every start page with its CRC_A and the GET_VERSION response
+ * with its CRC_A. READ, FAST_READ and GET_VERSION are then answered with a
+ * pointer into the cache, without going through nfc_ctx. WRITE updates the
+ * image and the READ responses holding the page.
+ *
+ * READ and FAST_READ address a page with one byte, pages beyond the dump
+ * read as zeros as before. A WRITE may reach any page of the dump buffer,
+ * a page beyond the dump extends it as nfc_ctx_set_t2t_page() does.
+ */
+#define T2T_CACHE_PAGE_SIZE     4
+#define T2T_CACHE_PAGES_MAX     256
+#define T2T_CACHE_READ_PAGES    4
+#define T2T_CACHE_READ_LEN      (T2T_CACHE_READ_PAGES * T2T_CACHE_PAGE_SIZE)
+#define T2T_CACHE_CRC_LEN       2
+#define T2T_CACHE_VERSION_LEN   8
+#define T2T_CACHE_FAST_READ_MAX 192     /* Longest FAST_READ response */
+
+typedef bool (*t2t_cache_page_fn_t)(uint16_t page, uint8_t out[T2T_CACHE_PAGE_SIZE]);
+
+typedef struct {
+    uint16_t pages;                     /* Pages of the dump, 0 if none */
+    uint16_t capacity;                  /* Pages of the dump buffer, the last page a WRITE reaches + 1 */
+    uint8_t  version_len;               /* GET_VERSION response with CRC_A, 0 if none */
+    uint8_t  version[T2T_CACHE_VERSION_LEN + T2T_CACHE_CRC_LEN];
+    uint8_t  image[T2T_CACHE_PAGES_MAX * T2T_CACHE_PAGE_SIZE];
+    uint8_t  read[T2T_CACHE_PAGES_MAX][T2T_CACHE_READ_LEN + T2T_CACHE_CRC_LEN];
+} t2t_cache_t;
+
+void t2t_cache_build(t2t_cache_t *cache, uint16_t pages, uint16_t capacity, t2t_cache_page_fn_t get_page,
+                     const uint8_t *version, uint8_t version_len);
+const uint8_t *t2t_cache_read(const t2t_cache_t *cache, uint8_t page);
+const uint8_t *t2t_cache_fast_read(const t2t_cache_t *cache, uint8_t start, uint8_t end, uint16_t *len);
+const uint8_t *t2t_cache_version(const t2t_cache_t *cache, uint16_t *len);
+bool t2t_cache_write(t2t_cache_t *cache, uint8_t page, const uint8_t data[T2T_CACHE_PAGE_SIZE]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NFC_DRV_NFC_T2T_CACHE_H_ */
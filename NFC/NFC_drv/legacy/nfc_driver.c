@@ -16,7 +16,7 @@
  * NFC_STATE_INITIALIZE
  *   ↓ (NfcRole.nfc_init_func() called)
  * NFC_STATE_PROCESS
- *   ↓ (NfcRole.nfc_process_func() called periodically)
+ *   ↓ (NfcRole.nfc_process_func() called on ST25R IRQs and RFAL timers)
  * NFC_STATE_DONE
  *   ↓ (NfcRole.nfc_deinit_func() called)
  * NFC_STATE_WAIT (loop)
@@ -28,9 +28,13 @@
  *   → Uses NFC_Listening_Init/Process/DeInit functions
  * 
  * [Worker Task]
- * - nfc_worker_task(): FreeRTOS task running periodically
+ * - nfc_worker_task(): FreeRTOS task driven by the ST25R IRQ
  * - Receives events via queue (nfc_worker_q_hdl)
  * - Calls appropriate NFC functions based on current state
+ * - Between process calls it blocks on a task notification given by
+ *   nfc_worker_irq_handler(), until the first RFAL software timer checked
+ *   by the process call expires (guard time, discovery duration) or at
+ *   most NFC_WORKER_WAIT_MAX_MS.
  * 
  ******************************************************************************
  */
@@ -44,6 +48,10 @@
 #include "app_x-cube-nfcx.h"
 #include "m1_log_debug.h"
 #include "rfal_platform.h"
+#include "rfal_rf.h"
+#include "rfal_nfc.h"
+#include "st25r3916_irq.h"
+#include "timer.h"
 #include "m1_tasks.h"
 #include "uiView.h"
 
@@ -62,6 +70,9 @@ EmuNfcA_t g_emuA = {0};
 
 TaskHandle_t nfc_worker_task_hdl = NULL;
 QueueHandle_t nfc_worker_q_hdl = NULL;
+nfc_worker_stats_t nfc_worker_stats;
+
+static volatile uint32_t nfc_worker_irq_cycles; // DWT cycle count of the last IRQ
 
 
 /*============================================================================*/
@@ -241,6 +252,78 @@ bool NFC_SwitchRole(NfcRole_e role)
 
 
 
+/*============================================================================*/
+/**
+ * @brief nfc_worker_irq_handler - ST25R IRQ line callback
+ * 
+ * Registered on the EXTI line of the ST25R IRQ in place of st25r3916Isr().
+ * Services the interrupt, then wakes the worker task so that the RFAL
+ * worker runs right after the chip has work.
+ * 
+ * @retval None
+ */
+/*============================================================================*/
+void nfc_worker_irq_handler(void)
+{
+    BaseType_t woken = pdFALSE;
+
+    st25r3916Isr();
+
+    nfc_worker_irq_cycles = DWT->CYCCNT;
+    nfc_worker_stats.irqs++;
+    if (nfc_worker_task_hdl != NULL) {
+        vTaskNotifyGiveFromISR(nfc_worker_task_hdl, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+/*============================================================================*/
+/**
+ * @brief nfc_worker_wait - Block the worker between two process calls
+ * 
+ * Runs the process function again at once while RFAL makes progress (its
+ * state or the transceive state changed), up to NFC_WORKER_RERUN_MAX times.
+ * Otherwise blocks until the next ST25R IRQ or the expiry of the first RFAL
+ * timer the process call found running, at most NFC_WORKER_WAIT_MAX_MS.
+ * 
+ * @param[in] nfcState RFAL state before the process call
+ * @param[in] trxState Transceive state before the process call
+ * @param[in,out] reruns Process calls in a row without blocking
+ * @retval None
+ */
+/*============================================================================*/
+static void nfc_worker_wait(rfalNfcState nfcState, rfalTransceiveState trxState, uint8_t *reruns)
+{
+    uint32_t wait_ms;
+    uint32_t latency_us;
+
+    if (((rfalNfcGetState() != nfcState) || (rfalGetTransceiveState() != trxState)) &&
+        (*reruns < NFC_WORKER_RERUN_MAX)) {
+        (*reruns)++;
+        nfc_worker_stats.reruns++;
+        return;
+    }
+    *reruns = 0;
+
+    /* timerIsExpired() turns true in the tick after the expiry */
+    if (timerNextExpiry(&wait_ms) && (wait_ms < NFC_WORKER_WAIT_MAX_MS)) {
+        wait_ms++;
+    } else {
+        wait_ms = NFC_WORKER_WAIT_MAX_MS;
+    }
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms)) == 0U) {
+        nfc_worker_stats.wakeups_timer++;
+        return;
+    }
+
+    latency_us = (DWT->CYCCNT - nfc_worker_irq_cycles) / (SystemCoreClock / 1000000U);
+    nfc_worker_stats.wakeups_irq++;
+    nfc_worker_stats.latency_us_sum += latency_us;
+    if (latency_us > nfc_worker_stats.latency_us_max) {
+        nfc_worker_stats.latency_us_max = latency_us;
+    }
+}
+
 /*============================================================================*/
 /**
  * @brief nfc_worker_task - NFC worker task main function
@@ -263,10 +346,17 @@ void nfc_worker_task(void *arg)
 {
     S_M1_Main_Q_t q_item;
 	BaseType_t ret;
+    rfalNfcState nfcState;
+    rfalTransceiveState trxState;
+    uint8_t reruns = 0;
 
 	platformLog("NFC Worker Task Started!\r\n");
     nfc_ctx_module_init(); // NFC context initialization
 
+    /* Cycle counter for the IRQ latency */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
 	for(;;)
 	{
         m1_wdt_reset();
@@ -297,6 +387,9 @@ void nfc_worker_task(void *arg)
 
             case NFC_STATE_INITIALIZE:
                 //platformLog("NFC Worker Task: rfal_init, moving to Process state\r\n");
+                memset(&nfc_worker_stats, 0, sizeof(nfc_worker_stats));
+                reruns = 0;
+                (void)ulTaskNotifyTake(pdTRUE, 0); // Drop IRQs of the last session
                 NfcRole.nfc_init_func();
                 NfcState = NFC_STATE_PROCESS;
                 vTaskDelay(5);
@@ -305,8 +398,11 @@ void nfc_worker_task(void *arg)
             case NFC_STATE_PROCESS:
                 //platformLog("NFC Worker Task: Processing\r\n");
                 m1_wdt_reset();
+                nfcState = rfalNfcGetState();
+                trxState = rfalGetTransceiveState();
+                timerNextClear(); // Timers running after the call bound the wait
                 NfcRole.nfc_process_func();
-                ret = xQueueReceive(nfc_worker_q_hdl, &q_item, 0);//worker tick delay & Q wait
+                ret = xQueueReceive(nfc_worker_q_hdl, &q_item, 0);//Q check, the worker blocks below
                 if (ret==pdTRUE)
                 {
                     if ( q_item.q_evt_type==Q_EVENT_NFC_READ_COMPLETE )
@@ -323,7 +419,9 @@ void nfc_worker_task(void *arg)
                     }                    
                     
                 }
-                vTaskDelay(5);
+                if (NfcState == NFC_STATE_PROCESS) {
+                    nfc_worker_wait(nfcState, trxState, &reruns);
+                }
                 break;
 
             case NFC_STATE_DONE:
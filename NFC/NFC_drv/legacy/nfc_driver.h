@@ -7,6 +7,10 @@
 
 #define FUNCTION_TITLE_LEN    64
 
+/* Worker blocking in NFC_STATE_PROCESS, woken by the ST25R IRQ */
+#define NFC_WORKER_WAIT_MAX_MS      100 /* Longest block without an IRQ or an RFAL timer expiry */
+#define NFC_WORKER_RERUN_MAX        32  /* Process calls in a row without blocking while RFAL makes progress */
+
 
 typedef enum
 {
@@ -43,12 +47,24 @@ typedef struct {
 
 
 
+typedef struct {
+    uint32_t irqs;              /* ST25R IRQs */
+    uint32_t wakeups_irq;       /* Blocks ended by an IRQ */
+    uint32_t wakeups_timer;     /* Blocks ended by the timeout */
+    uint32_t reruns;            /* Process calls repeated without blocking */
+    uint32_t latency_us_max;    /* IRQ to worker run */
+    uint32_t latency_us_sum;
+} nfc_worker_stats_t;
+
+
+
 extern EmuNfcA_t g_emuA;
 
 extern S_M1_NfcFunc_t NfcRole;
 
 extern TaskHandle_t nfc_worker_task_hdl;
 extern QueueHandle_t nfc_worker_q_hdl;
+extern nfc_worker_stats_t nfc_worker_stats;
 
 
 /**
@@ -94,6 +110,15 @@ void Emu_Clear(void);
  */
 void nfc_worker_task(void *arg);
 
+/**
+ * @brief nfc_worker_irq_handler - ST25R IRQ line callback
+ * 
+ * Services the ST25R interrupt and wakes the worker task.
+ * 
+ * @retval None
+ */
+void nfc_worker_irq_handler(void);
+
 /**
  * @brief NFC_SetRole - Set NFC role (simple pointer replacement only)
  * 
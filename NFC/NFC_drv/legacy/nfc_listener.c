@@ -17,6 +17,7 @@
  * 1. ListenIni(): Initialize RFAL in listener mode
  *    - Configure discovery parameters (LISTEN_TECH_A only)
  *    - Set UID, ATQA, SAK for emulation
+ *    - Build the T2T response cache from the dump (nfc_t2t_cache.c)
  *    - Start rfalNfcDiscover()
  * 
  * 2. ListenerCycle(): Main processing loop
@@ -31,10 +32,10 @@
  *    - Transition to DATAEXCHANGE state
  * 
  * 4. T2T Command Processing (CeHandleT2TCmdRx()):
- *    - 0x30 (READ): Build page response, sync TX (500μs FWT)
- *    - 0x3A (FAST_READ): Build multi-page response, sync TX
- *    - 0x60 (GET_VERSION): Send version info, sync TX
- *    - 0xA2 (WRITE): Save page data, send ACK
+ *    - 0x30 (READ): Cached response with CRC_A, sync TX (500μs FWT)
+ *    - 0x3A (FAST_READ): Cached page range, sync TX
+ *    - 0x60 (GET_VERSION): Cached version info with CRC_A, sync TX
+ *    - 0xA2 (WRITE): Save page data to context and cache, send ACK
  *    - After TX: Re-arm RX for next command
  * 
  * [Timing Critical]
@@ -65,6 +66,7 @@
 #include "nfc_driver.h"
 #include "nfc_listener.h"
 #include "common/nfc_ctx.h"
+#include "common/nfc_t2t_cache.h"
 #include "lfrfid.h"
 #include "rfal_nfc.h"
 
@@ -118,6 +120,8 @@ static bool          s_firstRxPending = false;
 static uint16_t s_lastRxBits;
 static uint8_t  s_lastRxBuf[32]; /* As needed length */
 
+static t2t_cache_t s_t2tCache;   /* T2T responses, built by ListenIni() */
+
 
 __attribute__((weak)) void Listener_OnActivated(const rfalNfcDevice* dev) { (void)dev; }
 __attribute__((weak)) void Listener_OnDeactivated(void) {}
@@ -288,48 +292,6 @@ bool SendGetVersion(const uint8_t *rx, uint16_t rxLenB)
     return true;
 }
 
-/*============================================================================*/
-/**
- * @brief CeBuildT2TReadResp - Build T2T READ response
- * 
- * Builds response for T2T READ command (0x30) by reading 4 pages from context.
- * 
- * @param[in] rx Received data buffer
- * @param[in] rxBits Received data length in bits
- * @retval RFAL_ERR_NONE Success
- * @retval RFAL_ERR_PARAM Invalid parameters
- */
-/*============================================================================*/
-static ReturnCode CeBuildT2TReadResp(const uint8_t *rx, uint16_t rxBits)
-{
-    if (!rx || rxBits < 16) return RFAL_ERR_PARAM;
-
-    uint16_t rxBytes = rfalConvBitsToBytes(rxBits);
-    if (rxBytes < 2) return RFAL_ERR_PARAM;
-
-    uint8_t startPage = rx[1];
-    uint16_t txLen = 0;
-
-    /* Prepare 4 pages of data (g_ceTxBuf is already initialized externally) */
-    for (uint8_t i = 0; i < 4; i++) {
-        uint16_t page = (uint16_t)startPage + i;
-        uint16_t bufOffset = txLen;
-        
-        if (!nfc_ctx_get_t2t_page(page, &g_ceTxBuf[bufOffset])) {
-            /* Fill with 0 if page doesn't exist */
-            g_ceTxBuf[bufOffset]     = 0x00;
-            g_ceTxBuf[bufOffset + 1] = 0x00;
-            g_ceTxBuf[bufOffset + 2] = 0x00;
-            g_ceTxBuf[bufOffset + 3] = 0x00;
-        }
-        txLen += 4;
-    }
-
-    g_ceTxLenBytes = (uint16_t)txLen;
-    return RFAL_ERR_NONE;
-}
-
-
 /*============================================================================*/
 /**
  * @brief CeHandleT2TCmdRx - Dispatch T2T commands
@@ -360,21 +322,22 @@ static bool CeHandleT2TCmdRx(const uint8_t *rx, uint16_t rxBits)
     
     switch (cmd) {
         case 0x30: {
-            /* READ command: Prepare response then start TX immediately */
-            uint8_t startPage = (rxBytes >= 2) ? rx[1] : 0;
-            
-            err = CeBuildT2TReadResp(rx, rxBits);
-            if (err != RFAL_ERR_NONE || g_ceTxLenBytes == 0U) {
+            /* READ command: Cached 4 pages with CRC_A, start TX immediately */
+            if (rxBytes < 2) {
                 return false;
             }
             
+            uint8_t startPage = rx[1];
+            const uint8_t *resp = t2t_cache_read(&s_t2tCache, startPage);
+            
             /* Log only critical page reads (0, 4, 8, etc.) */
             if ((startPage % 8) == 0) {
-                //platformLog("[CE] READ p%u: %s\r\n", startPage, hex2Str(g_ceTxBuf, 8));
+                //platformLog("[CE] READ p%u: %s\r\n", startPage, hex2Str(resp, 8));
             }
             
             /* Immediate synchronous transmission: Meet T2T FDT 86~177μs requirement */
-            err = rfalTransceiveBlockingTx(g_ceTxBuf, g_ceTxLenBytes, NULL, 0, NULL, RFAL_TXRX_FLAGS_DEFAULT, rfalConvUsTo1fc(500U));
+            err = rfalTransceiveBlockingTx((uint8_t *)resp, T2T_CACHE_READ_LEN + T2T_CACHE_CRC_LEN, NULL, 0, NULL,
+                                           (uint32_t)RFAL_TXRX_FLAGS_CRC_TX_MANUAL, rfalConvUsTo1fc(500U));
             if (err != RFAL_ERR_NONE && err != RFAL_ERR_LINK_LOSS) {
                 platformLog("[CE] READ TX err=%d\r\n", err);
                 return false;
@@ -395,35 +358,14 @@ static bool CeHandleT2TCmdRx(const uint8_t *rx, uint16_t rxBits)
                 return false;
             }
             
-            uint8_t startPage = rx[1];
-            uint8_t endPage   = rx[2];
-            uint16_t pageCnt = nfc_ctx_get_t2t_page_count();
-            
-            if (endPage < startPage) {
-                return false;
-            }
-            
-            if (endPage >= pageCnt) {
-                endPage = (uint8_t)(pageCnt - 1);
-            }
-            
-            uint16_t numPages = (uint16_t)(endPage - startPage + 1);
             uint16_t txLen = 0;
-            uint8_t pageBuf[4];
-            
-            for (uint16_t i = 0; i < numPages; i++) {
-                uint16_t page = (uint16_t)startPage + i;
-                if (!nfc_ctx_get_t2t_page(page, pageBuf)) {
-                    pageBuf[0] = pageBuf[1] = pageBuf[2] = pageBuf[3] = 0x00;
-                }
-                
-                if (txLen + 4U > sizeof(g_ceTxBuf)) break;
-                memcpy(&g_ceTxBuf[txLen], pageBuf, 4);
-                txLen += 4;
+            const uint8_t *resp = t2t_cache_fast_read(&s_t2tCache, rx[1], rx[2], &txLen);
+            if (resp == NULL) {
+                return false;
             }
             
-            /* Immediate synchronous transmission */
-            err = rfalTransceiveBlockingTx(g_ceTxBuf, txLen, NULL, 0, NULL, RFAL_TXRX_FLAGS_DEFAULT, rfalConvUsTo1fc(500U));
+            /* Immediate synchronous transmission straight from the cached image */
+            err = rfalTransceiveBlockingTx((uint8_t *)resp, txLen, NULL, 0, NULL, RFAL_TXRX_FLAGS_DEFAULT, rfalConvUsTo1fc(500U));
             if (err != RFAL_ERR_NONE && err != RFAL_ERR_LINK_LOSS) {
                 return false;
             }
@@ -439,16 +381,16 @@ static bool CeHandleT2TCmdRx(const uint8_t *rx, uint16_t rxBits)
         
         case 0x60: {
             /* GET_VERSION command: NTAG/Ultralight-C series */
-            uint8_t ver[8];
-            if (!nfc_ctx_get_t2t_version(ver)) {
+            uint16_t verLen = 0;
+            const uint8_t *ver = t2t_cache_version(&s_t2tCache, &verLen);
+            if (ver == NULL) {
                 platformLog("[CE] GET_VER: no data\r\n");
                 return false;
             }
             
-            platformLog("[CE] GET_VER TX: %s\r\n", hex2Str(ver, 8));
-            
             /* Immediate synchronous transmission: Meet T2T FDT 86~177μs requirement */
-            err = rfalTransceiveBlockingTx(ver, sizeof(ver), NULL, 0, NULL, RFAL_TXRX_FLAGS_DEFAULT, rfalConvUsTo1fc(500U));
+            err = rfalTransceiveBlockingTx((uint8_t *)ver, verLen, NULL, 0, NULL,
+                                           (uint32_t)RFAL_TXRX_FLAGS_CRC_TX_MANUAL, rfalConvUsTo1fc(500U));
             if (err != RFAL_ERR_NONE) {
                 platformLog("[CE] GET_VER TX err=%d\r\n", err);
                 return false;
@@ -473,8 +415,9 @@ static bool CeHandleT2TCmdRx(const uint8_t *rx, uint16_t rxBits)
             uint8_t data[4];
             memcpy(data, &rx[2], 4);
             
-            /* Save page data */
+            /* Save page data, the cache answers the next READ with it */
             nfc_ctx_set_t2t_page(page, data);
+            t2t_cache_write(&s_t2tCache, page, data);
             
             /* WRITE response: ACK (0x0A), immediate synchronous transmission */
             g_ceTxBuf[0] = 0x0A;
@@ -659,14 +602,22 @@ bool ListenIni(void)
     }
 
 
-    /* Check if T2T dump is ready */
+    /* Check if T2T dump is ready and build the response cache from it */
     {
         uint16_t t2_pages = nfc_ctx_get_t2t_page_count();
+        uint8_t  ver[8];
+        uint8_t  verLen = nfc_ctx_get_t2t_version(ver);
+
+        /* WRITE reaches the whole dump buffer, as nfc_ctx_set_t2t_page() does */
+        t2t_cache_build(&s_t2tCache, t2_pages, nfc_ctx_get_t2t_page_capacity(), nfc_ctx_get_t2t_page, ver, verLen);
         if (t2_pages == 0) {
             platformLog("[CE] WARNING: T2T dump is empty. Only UID will be emulated.\r\n");
         } else {
             platformLog("[CE] T2T dump ready: %u pages\r\n", t2_pages);
         }
+        if (verLen) {
+            platformLog("[CE] GET_VER rsp: %s\r\n", hex2Str(ver, verLen));
+        }
     }
     state = IDLE;
     platformLog("ListenIni() OK, state=%d, uid=%s\r\n", state, hex2Str(discParam.lmConfigPA.nfcid, (discParam.lmConfigPA.nfcidLen == RFAL_LM_NFCID_LEN_07) ? 7 : 4));
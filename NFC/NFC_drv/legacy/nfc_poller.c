@@ -61,6 +61,7 @@
 #include "m1_sdcard.h"
 #include "m1_storage.h"
 #include "common/nfc_fileio.h"  
+#include "common/nfc_mfc.h"
 #include "logger.h"
 #include <stdio.h>  
 
@@ -74,31 +75,10 @@
  ******************************************************************************
  */
 
-#define MFC_DICT_PATH   "NFC/system/mf_classic_dict.nfc"   // Adjust to actual path
-#define MFC_MAX_DICT_KEYS   2042
-#define MFC_KEY_LEN         6
-#define MFC_BLOCK_SIZE      16
-
-typedef struct {
-    uint8_t keys[MFC_MAX_DICT_KEYS][MFC_KEY_LEN];
-    uint16_t count;
-} mfc_key_dict_t;
-
-typedef enum {
-    MFC_KEYTYPE_A = 0x60,
-    MFC_KEYTYPE_B = 0x61,
-} mfc_key_type_t;
-
-static bool mfc_load_key_dict(mfc_key_dict_t *dict);
-
 #ifdef MIFARE_CLASSIC_AUTH_TEST
-/* Low-level Mifare Classic authentication/read functions should be implemented in a separate file (only prototypes declared here) */
-static ReturnCode mfc_authenticate_block(const rfalNfcDevice *dev, uint8_t blockNo, mfc_key_type_t keyType, const uint8_t key[6]);
-static ReturnCode mfc_read_block(const rfalNfcDevice *dev, uint8_t blockNo, uint8_t out[MFC_BLOCK_SIZE]);
-/* Key dictionary loading, sector/block layout helper functions */
-static bool mfc_load_key_dict(mfc_key_dict_t *dict);
-static void mfc_get_layout_from_sak(uint8_t sak, uint16_t *outSectors, uint16_t *outBlocks);
-static uint16_t mfc_sector_to_first_block(uint16_t sector);
+/* mfc_link_t of the RF front end: raw ISO14443A frames, parity bits and CRC_A set by nfc_mfc.c */
+static bool mfc_rfal_xfer(void *ctx, const mfc_frame_t *tx, mfc_frame_t *rx);
+static bool mfc_rfal_reselect(void *ctx);
 #endif
 
 extern uint8_t g_nfc_dump_buf[NFC_DUMP_BUF_SIZE];
@@ -113,6 +93,7 @@ extern uint8_t g_nfc_valid_bits[NFC_VALID_BITS_SIZE];
 static rfalNfcDiscoverParam discParam;
 static uint8_t              state = NOTINIT;
 static bool                 multiSel;
+static mfc_dict_t           mfcDict;    /* Holds a FatFs file, kept off the worker stack */
 
 
 /* NFC-A CE config */
@@ -323,9 +304,9 @@ void ReadCycle(void)
                         SET_FAMILY("MIFARE Classic %s (%s)", memSizeStr, uidTypeStr);
                         //m1_read_mifareclassic(nfcDevice);
                             /* Step 1: Check only if system key dictionary exists */
-                        mfc_key_dict_t dict;
-                        if (mfc_load_key_dict(&dict)) {
-                            platformLog("[MFC] system key dict OK (%u keys)\r\n", dict.count);
+                        if (mfc_dict_open(&mfcDict)) {
+                            platformLog("[MFC] system key dict OK (%lu keys)\r\n", mfcDict.count);
+                            mfc_dict_close(&mfcDict);
                         } else {
                             platformLog("[MFC] system key dict missing or invalid\r\n");
                         }
@@ -921,65 +902,6 @@ static void m1_t2t_read_ntag(const rfalNfcDevice *dev)
  ******************************************************************************
 */
 
-/*============================================================================*/
-/**
- * @brief mfc_load_key_dict - Load key list from mf_classic_dict.nfc file
- * 
- * Loads MIFARE Classic key dictionary from SD card file.
- * Currently only validates file format and counts keys.
- * 
- * @param[out] dict Pointer to key dictionary structure
- * @retval true If dictionary loaded successfully
- * @retval false If file not found or invalid
- */
-/*============================================================================*/
-static bool mfc_load_key_dict(mfc_key_dict_t *dict)
-{
-    nfcfio_t io;
-    char line[64];
-    int  n;
-
-    if (!dict) return false;
-    dict->count = 0;
-
-    /* 1) Open key dictionary file from SD card */
-    if (!nfcfio_open_read(&io, MFC_DICT_PATH)) {
-        platformLog("MFC dict open failed: %s\r\n", MFC_DICT_PATH);
-        return false;
-    }
-
-    platformLog("MFC dict opened: %s\r\n", MFC_DICT_PATH);
-
-    /* 2) Read and parse line by line (currently only validates format, key application later) */
-    while ((n = nfcfio_getline(&io, line, sizeof(line))) >= 0) {
-        char *p = line;
-
-        /* Skip whitespace/newlines */
-        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
-        if (*p == '\0') continue;      // Empty line
-        if (*p == '#')  continue;      // Comment
-
-        /* From here, parse hex keys according to mf_classic_dict.nfc actual format
-           and put them in dict->keys[dict->count].
-           In this step, we only check "if file reads correctly",
-           so simply increment line count. */
-
-        if (dict->count < MFC_MAX_DICT_KEYS) {
-            dict->count++;
-        } else {
-            platformLog("MFC dict key overflow (>%d)\r\n", MFC_MAX_DICT_KEYS);
-            break;
-        }
-    }
-
-    nfcfio_close(&io);
-
-    platformLog("MFC dict loaded, lines(keys)=%u\r\n", dict->count);
-    return (dict->count > 0);
-}
-
-
-
 #ifdef MIFARE_CLASSIC_AUTH_TEST
 /*============================================================================*/
 /**
@@ -987,6 +909,9 @@ static bool mfc_load_key_dict(mfc_key_dict_t *dict)
  * 
  * Reads MIFARE Classic card using key dictionary attack.
  * Authenticates sectors with dictionary keys and reads all blocks.
+ * The keys found on the card are tried first on the next sectors.
+ * Crypto1 and the card protocol are in common/nfc_mfc.c, this file
+ * provides the raw frame link of the RF front end.
  * 
  * @param[in] dev Pointer to NFC device
  * @retval None
@@ -999,9 +924,10 @@ static void m1_read_mifareclassic(const rfalNfcDevice *dev)
     uint16_t totalBlocks  = 0;
     uint16_t maxBlocks    = NFC_DUMP_MAX_UNITS;
 
-    mfc_key_dict_t dict;
+    mfc_link_t   link = { mfc_rfal_xfer, mfc_rfal_reselect, (void *)dev };
+    mfc_reader_t reader;
+    uint32_t attempts = 0;
     uint16_t lastSeenBlock = 0;
-    uint16_t successSectors = 0;
 
     /* Determine card capacity (sector/block count) */
     mfc_get_layout_from_sak(nfca->selRes.sak, &totalSectors, &totalBlocks);
@@ -1012,8 +938,8 @@ static void m1_read_mifareclassic(const rfalNfcDevice *dev)
         totalBlocks = maxBlocks;
     }
 
-    /* Load key dictionary */
-    if (!mfc_load_key_dict(&dict)) {
+    /* Open key dictionary */
+    if (!mfc_dict_open(&mfcDict)) {
         platformLog("[MFC] no key dict, skip MFC dump\r\n");
         return;
     }
@@ -1025,80 +951,10 @@ static void m1_read_mifareclassic(const rfalNfcDevice *dev)
     platformLog("[MFC] start dump: sectors=%u blocks=%u\r\n",
                 totalSectors, totalBlocks);
 
-    for (uint16_t sector = 0; sector < totalSectors; sector++) {
-
-        uint16_t firstBlock = mfc_sector_to_first_block(sector);
-        uint16_t blocksInSector =
-            (sector < 32 || totalSectors <= 16) ? 4 : 16;
-
-        if (firstBlock >= totalBlocks) {
-            break;
-        }
-
-        bool sectorAuthed = false;
-        mfc_key_type_t usedType = MFC_KEYTYPE_A;
-        uint8_t usedKey[MFC_KEY_LEN];
-
-        /* ---------- Sector authentication: Try all dictionary keys for both A/B ---------- */
-        for (uint16_t ki = 0; ki < dict.count && !sectorAuthed; ki++) {
-
-            const uint8_t *key = dict.keys[ki];
-
-            /* Key A */
-            if (mfc_authenticate_block(dev, (uint8_t)firstBlock,
-                                       MFC_KEYTYPE_A, key) == RFAL_ERR_NONE) {
-
-                sectorAuthed = true;
-                usedType = MFC_KEYTYPE_A;
-                memcpy(usedKey, key, MFC_KEY_LEN);
-                platformLog("[MFC] sector %u auth OK with dict[%u] as KeyA\r\n",
-                            sector, ki);
-                break;
-            }
-
-            /* Key B */
-            if (mfc_authenticate_block(dev, (uint8_t)firstBlock,
-                                       MFC_KEYTYPE_B, key) == RFAL_ERR_NONE) {
-
-                sectorAuthed = true;
-                usedType = MFC_KEYTYPE_B;
-                memcpy(usedKey, key, MFC_KEY_LEN);
-                platformLog("[MFC] sector %u auth OK with dict[%u] as KeyB\r\n",
-                            sector, ki);
-                break;
-            }
-        }
-
-        if (!sectorAuthed) {
-            platformLog("[MFC] sector %u auth FAILED\r\n", sector);
-            continue;
-        }
-
-        successSectors++;
-
-        /* ---------- Read all blocks of successfully authenticated sector ---------- */
-        for (uint16_t bi = 0; bi < blocksInSector; bi++) {
-
-            uint16_t blockNo = firstBlock + bi;
-            if (blockNo >= totalBlocks) {
-                break;
-            }
-
-            uint8_t *dst = &g_nfc_dump_buf[blockNo * MFC_BLOCK_SIZE];
-
-            ReturnCode rc = mfc_read_block(dev, (uint8_t)blockNo, dst);
-            if (rc == RFAL_ERR_NONE) {
-                /* Set flag that this block is valid */
-                g_nfc_valid_bits[blockNo >> 3] |= (uint8_t)(1u << (blockNo & 0x7));
-
-                if (blockNo + 1 > lastSeenBlock) {
-                    lastSeenBlock = blockNo + 1;
-                }
-            } else {
-                platformLog("[MFC] read block %u failed: %d\r\n", blockNo, rc);
-            }
-        }
-    }
+    /* Card selected by the discovery, sectors after the first use nested authentication */
+    mfc_reader_init(&reader, &link, dev->nfcid, dev->nfcidLen, HAL_GetTick());
+    lastSeenBlock = mfc_read_card(&reader, &mfcDict, totalSectors, totalBlocks,
+                                  g_nfc_dump_buf, g_nfc_valid_bits, &attempts);
 
     /* Register dump metadata in NFC context */
     nfc_ctx_set_dump(
@@ -1111,112 +967,117 @@ static void m1_read_mifareclassic(const rfalNfcDevice *dev)
         (lastSeenBlock > 0)      /* has_dump */
     );
 
-    platformLog("[MFC] dump done: successSectors=%u lastBlock=%u\r\n",
-                successSectors, lastSeenBlock);
+    mfc_dict_close(&mfcDict);
+
+    platformLog("[MFC] dump done: lastBlock=%u attempts=%lu auths=%lu selects=%lu\r\n",
+                lastSeenBlock, attempts, reader.auths, reader.reselects);
 }
 
 /*============================================================================*/
 /**
- * @brief mfc_hex_nibble - Convert one character to 0~15 nibble, return -1 on failure
+ * @brief mfc_rfal_xfer - Exchange a raw frame with the card, mfc_link_t of the reader
  * 
- * @param[in] c Character to convert
- * @retval 0-15 Nibble value
- * @retval -1 Conversion failed
- */
-/*============================================================================*/
-static int mfc_hex_nibble(char c)
-{
-    if (c >= '0' && c <= '9') return c - '0';
-    if (c >= 'a' && c <= 'f') return 10 + (c - 'a');
-    if (c >= 'A' && c <= 'F') return 10 + (c - 'A');
-    return -1;
-}
-/*============================================================================*/
-/**
- * @brief mfc_get_layout_from_sak - Estimate Mifare Classic capacity from SAK value
+ * Parity and CRC are not handled by the ST25R3916: each byte goes with its
+ * parity bit, 9 bits LSB first, as Crypto1 encrypts the parity bits too.
  * 
- * @param[in] sak SAK value
- * @param[out] outSectors Pointer to store sector count
- * @param[out] outBlocks Pointer to store block count
- * @retval None
+ * @param[in] ctx Pointer to NFC device
+ * @param[in] tx Frame to send
+ * @param[out] rx Answer, len 0 if none
+ * @retval false Link error
  */
 /*============================================================================*/
-static void mfc_get_layout_from_sak(uint8_t sak, uint16_t *outSectors, uint16_t *outBlocks)
+static bool mfc_rfal_xfer(void *ctx, const mfc_frame_t *tx, mfc_frame_t *rx)
 {
-    uint8_t base = sak & 0x1F;
-
-    if (base == 0x08) {
-        /* Mifare Classic 1K */
-        *outSectors = 16;
-        *outBlocks  = 64;
-    } else if (base == 0x18) {
-        /* Mifare Classic 4K */
-        *outSectors = 40;
-        *outBlocks  = 256;
+    uint8_t txBuf[(MFC_FRAME_MAX * 9 + 7) / 8];
+    uint8_t rxBuf[(MFC_FRAME_MAX * 9 + 7) / 8];
+    uint16_t txBits = 0, rxBits = 0, pos, i;
+    rfalTransceiveContext trx;
+    ReturnCode ret;
+
+    (void)ctx;
+    memset(txBuf, 0x00, sizeof(txBuf));
+    if (tx->bits) {
+        txBuf[0] = tx->data[0];
+        txBits = tx->bits;
     } else {
-        /* If ambiguous, treat as 1K for now */
-        platformLog("[MFC] unknown SAK 0x%02X, fallback to 1K layout\r\n", sak);
-        *outSectors = 16;
-        *outBlocks  = 64;
+        for (i = 0; i < tx->len; i++) {
+            for (pos = 0; pos < 9; pos++, txBits++) {
+                uint8_t bit = (pos < 8) ? ((tx->data[i] >> pos) & 1U) : ((tx->par >> i) & 1U);
+                txBuf[txBits >> 3] |= (uint8_t)(bit << (txBits & 7));
+            }
+        }
     }
-}
 
-/*============================================================================*/
-/**
- * @brief mfc_sector_to_first_block - Convert sector number to first block number
- * 
- * @param[in] sector Sector number
- * @retval First block number of the sector
- */
-/*============================================================================*/
-static uint16_t mfc_sector_to_first_block(uint16_t sector)
-{
-    if (sector < 32) {
-        /* Sectors 0~31 have 4 blocks per sector */
-        return (uint16_t)(sector * 4);
-    } else {
-        /* Sectors 32~39 have 16 blocks per sector */
-        return (uint16_t)(128 + (sector - 32) * 16);
+    trx.txBuf     = txBuf;
+    trx.txBufLen  = txBits;
+    trx.rxBuf     = rxBuf;
+    trx.rxBufLen  = (uint16_t)(sizeof(rxBuf) * 8U);
+    trx.rxRcvdLen = &rxBits;
+    trx.flags     = (uint32_t)RFAL_TXRX_FLAGS_CRC_TX_MANUAL | (uint32_t)RFAL_TXRX_FLAGS_CRC_RX_KEEP |
+                    (uint32_t)RFAL_TXRX_FLAGS_CRC_RX_MANUAL | (uint32_t)RFAL_TXRX_FLAGS_PAR_TX_NONE |
+                    (uint32_t)RFAL_TXRX_FLAGS_PAR_RX_KEEP;
+    trx.fwt       = rfalConvUsTo1fc(MFC_FWT_US);
+
+    rx->len  = 0;
+    rx->bits = 0;
+    rx->par  = 0;
+
+    ret = rfalStartTransceive(&trx);
+    if (ret != RFAL_ERR_NONE) {
+        return false;
     }
-}
+    rfalRunBlocking(ret, rfalGetTransceiveStatus());
 
-/* --- MIFARE Classic low-level stubs (Step 1: Not actually used) --- */
-/*============================================================================*/
-/**
- * @brief mfc_authenticate_block - Authenticate MIFARE Classic block (stub)
- * 
- * @param[in] dev Pointer to NFC device
- * @param[in] blockNo Block number
- * @param[in] keyType Key type (A or B)
- * @param[in] key Key data (6 bytes)
- * @retval RFAL_ERR_NOTSUPP Not supported (stub)
- */
-/*============================================================================*/
-static ReturnCode mfc_authenticate_block(const rfalNfcDevice *dev,
-                                         uint8_t blockNo,
-                                         mfc_key_type_t keyType,
-                                         const uint8_t key[6])
-{
-    (void)dev; (void)blockNo; (void)keyType; (void)key;
-    return RFAL_ERR_NOTSUPP;
+    /* 9 bits per byte are rarely byte aligned */
+    if ((ret >= RFAL_ERR_INCOMPLETE_BYTE) && (ret <= RFAL_ERR_INCOMPLETE_BYTE_07)) {
+        ret = RFAL_ERR_NONE;
+    }
+    if (ret == RFAL_ERR_TIMEOUT) {
+        return true;    /* No answer */
+    }
+    if (ret != RFAL_ERR_NONE) {
+        return false;
+    }
+
+    if (rxBits < 9U) {
+        /* ACK/NAK */
+        rx->data[0] = (uint8_t)(rxBuf[0] & ((1U << rxBits) - 1U));
+        rx->bits = (uint8_t)rxBits;
+        return true;
+    }
+
+    for (i = 0, pos = 0; (i < MFC_FRAME_MAX) && (pos + 9U <= rxBits); i++, pos += 9U) {
+        uint16_t k;
+        rx->data[i] = 0;
+        for (k = 0; k < 8; k++) {
+            rx->data[i] |= (uint8_t)(((rxBuf[(pos + k) >> 3] >> ((pos + k) & 7)) & 1U) << k);
+        }
+        rx->par |= (uint32_t)((rxBuf[(pos + 8) >> 3] >> ((pos + 8) & 7)) & 1U) << i;
+    }
+    rx->len = (uint8_t)i;
+    return true;
 }
 
 /*============================================================================*/
 /**
- * @brief mfc_read_block - Read MIFARE Classic block (stub)
+ * @brief mfc_rfal_reselect - Select the card again after a failed command, mfc_link_t of the reader
  * 
- * @param[in] dev Pointer to NFC device
- * @param[in] blockNo Block number
- * @param[out] out Output buffer (16 bytes)
- * @retval RFAL_ERR_NOTSUPP Not supported (stub)
+ * @param[in] ctx Pointer to NFC device
+ * @retval true Card selected
  */
 /*============================================================================*/
-static ReturnCode mfc_read_block(const rfalNfcDevice *dev,
-                                 uint8_t blockNo,
-                                 uint8_t out[MFC_BLOCK_SIZE])
+static bool mfc_rfal_reselect(void *ctx)
 {
-    (void)dev; (void)blockNo;
-    memset(out, 0x00, MFC_BLOCK_SIZE);
-    return RFAL_ERR_NOTSUPP;
+    const rfalNfcDevice *dev = (const rfalNfcDevice *)ctx;
+    rfalNfcaSensRes sensRes;
+    rfalNfcaSelRes  selRes;
+
+    /* A card in a session ignores WUPA, send it to HALT first */
+    rfalNfcaPollerSleep();
+
+    if (rfalNfcaPollerCheckPresence(RFAL_14443A_SHORTFRAME_CMD_WUPA, &sensRes) != RFAL_ERR_NONE) {
+        return false;
+    }
+    return (rfalNfcaPollerSelect(dev->nfcid, dev->nfcidLen, &selRes) == RFAL_ERR_NONE);
 }
 #endif
@@ -29,6 +29,7 @@
 #include "m1_nfc.h"
 #include "NFC_drv/legacy/nfc_poller.h"
 #include "NFC_drv/legacy/nfc_listener.h"
+#include "NFC_drv/legacy/nfc_driver.h"
 #include "uiView.h"                    // ← 추가: m1_app_send_q_message() 선언
 #include "st25r3916.h"                 // ← 추가: st25r3916Deinitialize() 선언
 #include "rfal_platform.h"
@@ -76,7 +77,7 @@ void NFC_Polling_Init(void)
   //platformLog("NFC Polling Init\r\n");
 
    USR_INT_LINE.Line = USR_INT_LINE_NUM;
-   USR_INT_LINE.RisingCallback = st25r3916Isr;
+   USR_INT_LINE.RisingCallback = nfc_worker_irq_handler; // st25r3916Isr() and worker wakeup
 
    /* Configure interrupt callback */
   (void)HAL_EXTI_GetHandle(&USR_INT_LINE, USR_INT_LINE.Line);
@@ -105,7 +106,7 @@ void NFC_Listening_Init(void)
   platformLog("NFC Listening Init\r\n");
 
   USR_INT_LINE.Line = USR_INT_LINE_NUM;
-  USR_INT_LINE.RisingCallback = st25r3916Isr;
+  USR_INT_LINE.RisingCallback = nfc_worker_irq_handler; // st25r3916Isr() and worker wakeup
 
    /* Configure interrupt callback */
   (void)HAL_EXTI_GetHandle(&USR_INT_LINE, USR_INT_LINE.Line);
@@ -13,8 +13,11 @@
 /*************************** I N C L U D E S **********************************/
 
 #include <stdint.h>
+#include <string.h>
 #include "stm32h5xx_hal.h"
 #include "main.h"
+#include "app_freertos.h"
+#include "semphr.h"
 #include "m1_compile_cfg.h"
 #include "m1_sub_ghz_api.h"
 #include "m1_rf_spi.h"
@@ -36,6 +39,7 @@
 #define M1_LOGDB_TAG	"SUB_GHZ"
 
 #define SI4463_CTS_TIMEOUT    		12000	// Number of SPI retries to read the CTS ready status
+#define SI4463_CTS_PIN_TIMEOUT		20		// ms, for the CTS pin to go high
 #define SPI_DUMMY_CMD_DATA			0xFF
 #define SI4463_CTS_READY        	0xFF
 
@@ -45,6 +49,17 @@
 
 #define RADIO_COMM_BUFFER_MAX          30
 
+#define SI446X_SET_PROPERTY_MAX			(SI446X_CMD_ARG_COUNT_SET_PROPERTY - 4) // Properties of one SET_PROPERTY command
+#define SI446X_QUEUE_RESERVED			(SI446X_CMD_ARG_COUNT_GPIO_PIN_CFG + 1) // Room for the command restoring the nIRQ pin
+#define SI446X_QUEUE_NONE				0xFFFF
+#define SI4463_nINT_EXTI_IRQn			EXTI12_IRQn
+
+#define SI446X_QUEUE_STATE_IDLE			0 // Commands are being queued
+#define SI446X_QUEUE_STATE_TX			1 // DMA transfer of a command
+#define SI446X_QUEUE_STATE_CTS			2 // Waiting for the CTS of the last command
+#define SI446X_QUEUE_STATE_DONE			3
+#define SI446X_QUEUE_STATE_ERROR		4
+
 
 //************************** C O N S T A N T **********************************/
 
@@ -60,6 +75,21 @@ static uint8_t si446x_CTS_ready = FALSE;
 static uint8_t si446x_got_reset = FALSE;
 static union si446x_cmd_reply_union si446x_cmd;
 
+static uint8_t si446x_queue_buffer[SI446X_QUEUE_SIZE]; // Commands, each one preceded by its length
+static uint16_t si446x_queue_len = 0;
+static uint16_t si446x_queue_pos; // Command being sent
+static uint16_t si446x_queue_barrier = 0; // Properties are not merged into the commands before this offset
+static uint8_t si446x_queue_nirq_mode = SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_NIRQ_MODE_ENUM_NIRQ;
+static volatile uint8_t si446x_queue_state = SI446X_QUEUE_STATE_IDLE;
+static uint32_t si446x_queue_exti_rising;
+static uint32_t si446x_queue_exti_falling;
+static uint8_t si446x_queue_irq_enabled;
+static uint8_t si446x_queue_bus_locked = FALSE;
+static SemaphoreHandle_t si446x_queue_sem = NULL;
+static uint8_t si446x_queue_locked = FALSE; // The queue holds the radio until it is sent
+static SemaphoreHandle_t si446x_radio_mutex = NULL;
+static S_SI446x_Queue_Stats_t si446x_queue_stats;
+
 /*! Si446x configuration array */
 
 const uint8_t Radio_300_Configuration_Data_Array[] = RADIO_300_CONFIGURATION_DATA_ARRAY;
@@ -121,19 +151,42 @@ static S_M1_SPI_Trans_Inf radio_spi_trans_inf = {
 
 /********************* F U N C T I O N   P R O T O T Y P E S ******************/
 
-void SI446x_Wait_CTS(void);
+static uint8_t si446x_wait_cts_pin(void);
+static uint8_t si446x_poll_cts(void);
+static uint8_t si446x_write_cmd(uint8_t byteCount, uint8_t *pData);
+static uint8_t si446x_read_resp(uint8_t byteCount, uint8_t *pData);
 void SI446x_PowerUp(void);
 void SI446x_Reset(void);
 uint8_t SI446x_Send_Cmd(uint8_t byteCount, uint8_t *pData);
 uint8_t SI446x_Get_Resp(uint8_t byteCount, uint8_t *pData);
 uint8_t SI446x_Poll_CTS(void);
+static uint8_t si446x_queue_append(uint8_t byteCount, const uint8_t *pData);
+static uint8_t si446x_queue_start(void);
+static void si446x_queue_send_next(void);
+static void si446x_queue_tx_done(HAL_StatusTypeDef stat);
+static void si446x_queue_stop(uint8_t state);
+static void si446x_queue_reset(void);
+uint8_t SI446x_Queue_Cmd(uint8_t byteCount, const uint8_t *pData);
+uint8_t SI446x_Queue_Property(uint8_t group, uint8_t count, uint8_t start, const uint8_t *pvalues);
+uint8_t SI446x_Queue_Flush(void);
+uint8_t SI446x_Queue_Wait(void);
+uint8_t SI446x_Queue_Busy(void);
+void SI446x_Queue_CTS_Callback(void);
+void SI446x_Queue_Get_Stats(S_SI446x_Queue_Stats_t *pstats);
 uint8_t SI446x_Get_Reset_Stat(void);
+void SI446x_Lock_Init(void);
+void SI446x_Lock(void);
+uint8_t SI446x_Try_Lock(uint32_t timeout);
+void SI446x_Unlock(void);
 void SI446x_Get_IntStatus(uint8_t PH_CLR_PEND, uint8_t MODEM_CLR_PEND, uint8_t CHIP_CLR_PEND);
 struct si446x_reply_GET_MODEM_STATUS_map *SI446x_Get_ModemStatus( uint8_t MODEM_CLR_PEND);
 void SI446x_Get_ChipStatus( uint8_t CHIP_CLR_PEND);
 struct si446x_reply_PART_INFO_map *SI446x_PartInfo(void);
 struct si446x_reply_REQUEST_DEVICE_STATE_map *SI446x_Request_DeviceState(void);
 uint8_t SI446x_ConfigInit(const uint8_t* pSetPropCmd);
+uint8_t SI446x_ConfigQueue(const uint8_t* pSetPropCmd);
+void SI446x_Set_Property(uint8_t group, uint8_t count, uint8_t start, const uint8_t *pvalues);
+void SI446x_Frr_Read(uint8_t count, uint8_t *pdata);
 void Radio_Start_Rx(uint8_t CHANNEL, uint8_t CONDITION, uint16_t RX_LEN, uint8_t NEXT_STATE1, uint8_t NEXT_STATE2, uint8_t NEXT_STATE3);
 void SI446x_Start_Rx(uint8_t channel);
 void Radio_Start_Tx(uint8_t CHANNEL, uint8_t CONDITION, uint16_t TX_LEN);
@@ -160,19 +213,25 @@ void radio_set_antenna_mode(tRadioAntennaMode mode);
 
 /******************************************************************************/
 /*
- * This function checks the CTS status and waits until the CTS gets ready
- *
+ * This function checks the CTS pin and waits until the CTS gets ready
+ * return TRUE if ready
 */
 /******************************************************************************/
-#ifdef M1_APP_RADIO_POLL_CTS_ON_GPIO
-void SI446x_Wait_CTS(void)
+static uint8_t si446x_wait_cts_pin(void)
 {
-	// Check CTS pin
-	// GPIO1 is CTS by default after a POR
+#ifdef M1_APP_RADIO_POLL_CTS_ON_GPIO
+	uint32_t t_start;
+
+	// GPIO1 is CTS by default after a POR, and all configurations keep it
+	t_start = HAL_GetTick();
 	while ( HAL_GPIO_ReadPin(SI4463_GPIO1_GPIO_Port, SI4463_GPIO1_Pin)==GPIO_PIN_RESET )
-		; // Let wait here until CTS getting ready
-} // void SI446x_Wait_CTS(void)
+	{
+		if ( (HAL_GetTick() - t_start) > SI4463_CTS_PIN_TIMEOUT )
+			return FALSE;
+	}
 #endif // #ifdef M1_APP_RADIO_POLL_CTS_ON_GPIO
+	return TRUE;
+} // static uint8_t si446x_wait_cts_pin(void)
 
 
 
@@ -183,15 +242,37 @@ void SI446x_Wait_CTS(void)
  *
 */
 /******************************************************************************/
-uint8_t SI446x_Poll_CTS(void)
+static uint8_t si446x_poll_cts(void)
 {
 #ifdef M1_APP_RADIO_POLL_CTS_ON_GPIO
-    SI446x_Wait_CTS(); // wait here
+    if ( !si446x_wait_cts_pin() )
+    	return 0x00;
     si446x_CTS_ready = TRUE;
     return SI4463_CTS_READY;
 #else
-    return SI446x_Get_Resp(0, NULL);
+    return si446x_read_resp(0, NULL);
 #endif // #ifdef M1_APP_RADIO_POLL_CTS_ON_GPIO
+} // static uint8_t si446x_poll_cts(void)
+
+
+
+/******************************************************************************/
+/*
+ * Waits for CTS to be high, after the queued commands
+ * return CTS value
+ *
+*/
+/******************************************************************************/
+uint8_t SI446x_Poll_CTS(void)
+{
+	uint8_t cts;
+
+	SI446x_Lock();
+	SI446x_Queue_Wait();
+	cts = si446x_poll_cts();
+	SI446x_Unlock();
+
+	return cts;
 } // uint8_t SI446x_Poll_CTS(void)
 
 
@@ -208,6 +289,68 @@ uint8_t SI446x_Get_Reset_Stat(void)
 } // uint8_t SI446x_Get_Reset_Stat(void)
 
 
+/******************************************************************************/
+/*
+ * Creates the radio mutex, once the scheduler is running.
+ * The radio is used by the Sub-GHz task, the RSSI worker and the CLI.
+ * Before that, SI446x_Lock() and SI446x_Unlock() do nothing.
+ */
+/******************************************************************************/
+void SI446x_Lock_Init(void)
+{
+	if ( si446x_radio_mutex==NULL )
+	{
+		si446x_radio_mutex = xSemaphoreCreateRecursiveMutex();
+		assert(si446x_radio_mutex!=NULL);
+	}
+} // void SI446x_Lock_Init(void)
+
+
+
+/******************************************************************************/
+/*
+ * Takes the radio. A command, its CTS and its response must not be interleaved
+ * with the ones of another task. Calls can be nested.
+ */
+/******************************************************************************/
+void SI446x_Lock(void)
+{
+	if ( si446x_radio_mutex==NULL )
+		return;
+	xSemaphoreTakeRecursive(si446x_radio_mutex, portMAX_DELAY);
+} // void SI446x_Lock(void)
+
+
+
+/******************************************************************************/
+/*
+ * Takes the radio, unless another task keeps it longer than the timeout
+ * timeout: ms
+ * return TRUE if taken
+ */
+/******************************************************************************/
+uint8_t SI446x_Try_Lock(uint32_t timeout)
+{
+	if ( si446x_radio_mutex==NULL )
+		return TRUE;
+	return (xSemaphoreTakeRecursive(si446x_radio_mutex, pdMS_TO_TICKS(timeout))==pdTRUE)?TRUE:FALSE;
+} // uint8_t SI446x_Try_Lock(uint32_t timeout)
+
+
+
+/******************************************************************************/
+/*
+ * Releases the radio taken by SI446x_Lock() or SI446x_Try_Lock()
+ */
+/******************************************************************************/
+void SI446x_Unlock(void)
+{
+	if ( si446x_radio_mutex==NULL )
+		return;
+	xSemaphoreGiveRecursive(si446x_radio_mutex);
+} // void SI446x_Unlock(void)
+
+
 
 /******************************************************************************/
 /*
@@ -217,16 +360,18 @@ uint8_t SI446x_Get_Reset_Stat(void)
 /******************************************************************************/
 void SI446x_PowerUp(void)
 {
+    SI446x_Lock();
     /* Hardware reset the chip */
     SI446x_Reset();
 
     radio_patch_init();
 
 #ifdef M1_APP_RADIO_POLL_CTS_ON_GPIO
-    SI446x_Wait_CTS();
+    si446x_wait_cts_pin();
 #else
     HAL_Delay(15); // Delay 15ms for the CTS to get ready
 #endif // #ifdef M1_APP_RADIO_POLL_CTS_ON_GPIO
+    SI446x_Unlock();
 } // void SI446x_PowerUp(void)
 
 
@@ -255,19 +400,18 @@ void SI446x_Reset(void)
 
 /******************************************************************************/
 /*
- * Sends a command to the radio chip
+ * Writes a command to the radio chip once it is ready
  * byteCount:     Number of bytes in the command to send to the radio device
  * pData:         Pointer to the command to send.
  */
 /******************************************************************************/
-uint8_t SI446x_Send_Cmd(uint8_t byteCount, uint8_t *pData)
+static uint8_t si446x_write_cmd(uint8_t byteCount, uint8_t *pData)
 {
 	uint8_t reset_cnt = 0;
 
     while ( !si446x_CTS_ready )
     {
-        //SI446x_Poll_CTS();
-        if (SI446x_Get_Resp(0, NULL) != SI4463_CTS_READY )
+        if ( si446x_poll_cts()!=SI4463_CTS_READY )
         {
         	HAL_Delay(50); // 15
         	reset_cnt++;
@@ -287,6 +431,27 @@ uint8_t SI446x_Send_Cmd(uint8_t byteCount, uint8_t *pData)
     si446x_CTS_ready = FALSE;
 
     return 0;
+} // static uint8_t si446x_write_cmd(uint8_t byteCount, uint8_t *pData)
+
+
+
+/******************************************************************************/
+/*
+ * Sends a command to the radio chip, after the queued commands
+ * byteCount:     Number of bytes in the command to send to the radio device
+ * pData:         Pointer to the command to send.
+ */
+/******************************************************************************/
+uint8_t SI446x_Send_Cmd(uint8_t byteCount, uint8_t *pData)
+{
+	uint8_t ret;
+
+	SI446x_Lock();
+	SI446x_Queue_Wait();
+	ret = si446x_write_cmd(byteCount, pData);
+	SI446x_Unlock();
+
+	return ret;
 } // uint8_t SI446x_Send_Cmd(uint8_t byteCount, uint8_t *pData)
 
 
@@ -299,9 +464,47 @@ uint8_t SI446x_Send_Cmd(uint8_t byteCount, uint8_t *pData)
  * Return CTS value
  */
 /******************************************************************************/
-uint8_t SI446x_Get_Resp(uint8_t byteCount, uint8_t *pData)
+static uint8_t si446x_read_resp(uint8_t byteCount, uint8_t *pData)
 {
     uint16_t errCnt;
+#ifdef M1_APP_RADIO_POLL_CTS_ON_GPIO
+    uint8_t tx_buffer[RADIO_COMM_BUFFER_MAX + 2], rx_buffer[RADIO_COMM_BUFFER_MAX + 2];
+
+    // The CTS pin saves polling the command buffer over SPI.
+    // READ_CMD_BUFF is still checked, the pin may not have dropped yet right after a command.
+    if ( byteCount > RADIO_COMM_BUFFER_MAX )
+    	byteCount = RADIO_COMM_BUFFER_MAX;
+    memset(tx_buffer, SPI_DUMMY_CMD_DATA, byteCount + 2);
+    tx_buffer[0] = SI446X_CMD_ID_READ_CMD_BUFF;
+    radio_spi_trans_inf.pdata_tx = tx_buffer;
+    radio_spi_trans_inf.pdata_rx = rx_buffer;
+    radio_spi_trans_inf.data_len = byteCount + 2;
+    radio_spi_trans_inf.trans_type = SPI_TRANS_WRITEREAD_DATA;
+    errCnt = SI4463_CTS_TIMEOUT;
+    si446x_CTS_ready = FALSE;
+    rx_buffer[1] = 0x00;
+    while ( errCnt != 0 )
+    {
+    	if ( !si446x_wait_cts_pin() )
+    		break;
+    	m1_spi_hal_trans_req(&radio_spi_trans_inf);
+    	if ( rx_buffer[1]==SI4463_CTS_READY )
+    	{
+    		if ( byteCount )
+    			memcpy(pData, &rx_buffer[2], byteCount);
+    		si446x_CTS_ready = TRUE;
+    		break;
+    	} // if ( rx_buffer[1]==SI4463_CTS_READY )
+    	errCnt--;
+    } // while ( errCnt != 0 )
+
+    if ( !si446x_CTS_ready )
+    {
+    	M1_LOG_E(M1_LOGDB_TAG, "Error with CTS!\r\n");
+    }
+
+    return rx_buffer[1];
+#else
     uint8_t cmd_buffer, rsp_buffer;
 
     cmd_buffer = SI446X_CMD_ID_READ_CMD_BUFF;
@@ -347,6 +550,29 @@ uint8_t SI446x_Get_Resp(uint8_t byteCount, uint8_t *pData)
     } // if (errCnt == 0)
 
     return rsp_buffer;
+#endif // #ifdef M1_APP_RADIO_POLL_CTS_ON_GPIO
+} // static uint8_t si446x_read_resp(uint8_t byteCount, uint8_t *pData)
+
+
+
+/******************************************************************************/
+/*
+ * Gets a command response from the radio chip, after the queued commands
+ * byteCount     Number of bytes to get from the radio chip
+ * pData         Pointer to where to put the data
+ * Return CTS value
+ */
+/******************************************************************************/
+uint8_t SI446x_Get_Resp(uint8_t byteCount, uint8_t *pData)
+{
+	uint8_t cts;
+
+	SI446x_Lock();
+	SI446x_Queue_Wait();
+	cts = si446x_read_resp(byteCount, pData);
+	SI446x_Unlock();
+
+	return cts;
 } // uint8_t SI446x_Get_Resp(uint8_t byteCount, uint8_t *pData)
 
 
@@ -361,6 +587,7 @@ uint8_t SI446x_Get_Resp(uint8_t byteCount, uint8_t *pData)
 /******************************************************************************/
 void SI446x_Get_IntStatus(uint8_t PH_CLR_PEND, uint8_t MODEM_CLR_PEND, uint8_t CHIP_CLR_PEND)
 {
+    SI446x_Lock();
     si446x_cmd_buffer[0] = SI446X_CMD_ID_GET_INT_STATUS;
     si446x_cmd_buffer[1] = PH_CLR_PEND;
     si446x_cmd_buffer[2] = MODEM_CLR_PEND;
@@ -377,6 +604,7 @@ void SI446x_Get_IntStatus(uint8_t PH_CLR_PEND, uint8_t MODEM_CLR_PEND, uint8_t C
     si446x_cmd.GET_INT_STATUS.MODEM_STATUS   = si446x_cmd_buffer[5];
     si446x_cmd.GET_INT_STATUS.CHIP_PEND      = si446x_cmd_buffer[6];
     si446x_cmd.GET_INT_STATUS.CHIP_STATUS    = si446x_cmd_buffer[7];
+    SI446x_Unlock();
 } // void SI446x_Get_IntStatus(uint8_t PH_CLR_PEND, uint8_t MODEM_CLR_PEND, uint8_t CHIP_CLR_PEND)
 
 
@@ -385,10 +613,13 @@ void SI446x_Get_IntStatus(uint8_t PH_CLR_PEND, uint8_t MODEM_CLR_PEND, uint8_t C
 /*
  * Gets the Modem status flags. Optionally clears them.
  * MODEM_CLR_PEND: Flags to clear.
+ * The reply is shared with the other commands, a task other than the Sub-GHz one
+ * reads it before releasing the radio, see SI446x_Lock().
  */
 /******************************************************************************/
 struct si446x_reply_GET_MODEM_STATUS_map *SI446x_Get_ModemStatus( uint8_t MODEM_CLR_PEND )
 {
+    SI446x_Lock();
     si446x_cmd_buffer[0] = SI446X_CMD_ID_GET_MODEM_STATUS;
     si446x_cmd_buffer[1] = MODEM_CLR_PEND;
 
@@ -404,6 +635,8 @@ struct si446x_reply_GET_MODEM_STATUS_map *SI446x_Get_ModemStatus( uint8_t MODEM_
     si446x_cmd.GET_MODEM_STATUS.AFC_FREQ_OFFSET =  ((uint16_t)si446x_cmd_buffer[6] << 8) & 0xFF00;
     si446x_cmd.GET_MODEM_STATUS.AFC_FREQ_OFFSET |= (uint16_t)si446x_cmd_buffer[7] & 0x00FF;
 
+    SI446x_Unlock();
+
     return &si446x_cmd.GET_MODEM_STATUS;
 } // struct si446x_reply_GET_MODEM_STATUS_map *SI446x_Get_ModemStatus( uint8_t MODEM_CLR_PEND )
 
@@ -417,6 +650,7 @@ struct si446x_reply_GET_MODEM_STATUS_map *SI446x_Get_ModemStatus( uint8_t MODEM_
 /******************************************************************************/
 void SI446x_Get_ChipStatus( uint8_t CHIP_CLR_PEND )
 {
+    SI446x_Lock();
     si446x_cmd_buffer[0] = SI446X_CMD_ID_GET_CHIP_STATUS;
     si446x_cmd_buffer[1] = CHIP_CLR_PEND;
 
@@ -426,6 +660,7 @@ void SI446x_Get_ChipStatus( uint8_t CHIP_CLR_PEND )
     si446x_cmd.GET_CHIP_STATUS.CHIP_PEND         = si446x_cmd_buffer[0];
     si446x_cmd.GET_CHIP_STATUS.CHIP_STATUS       = si446x_cmd_buffer[1];
     si446x_cmd.GET_CHIP_STATUS.CMD_ERR_STATUS    = si446x_cmd_buffer[2];
+    SI446x_Unlock();
 } // void SI446x_Get_ChipStatus( uint8_t CHIP_CLR_PEND )
 
 
@@ -437,6 +672,7 @@ void SI446x_Get_ChipStatus( uint8_t CHIP_CLR_PEND )
 /******************************************************************************/
 struct si446x_reply_PART_INFO_map *SI446x_PartInfo(void)
 {
+    SI446x_Lock();
     si446x_cmd_buffer[0] = SI446X_CMD_ID_PART_INFO;
     //si446x_cmd_buffer[0] = 0x00;
 
@@ -452,6 +688,8 @@ struct si446x_reply_PART_INFO_map *SI446x_PartInfo(void)
     si446x_cmd.PART_INFO.CUSTOMER        = si446x_cmd_buffer[6];
     si446x_cmd.PART_INFO.ROMID           = si446x_cmd_buffer[7];
 
+    SI446x_Unlock();
+
     return &si446x_cmd.PART_INFO;
 } // struct si446x_reply_PART_INFO_map *(void)
 
@@ -464,6 +702,7 @@ struct si446x_reply_PART_INFO_map *SI446x_PartInfo(void)
 /******************************************************************************/
 struct si446x_reply_REQUEST_DEVICE_STATE_map *SI446x_Request_DeviceState(void)
 {
+    SI446x_Lock();
     si446x_cmd_buffer[0] = SI446X_CMD_ID_REQUEST_DEVICE_STATE;
 
     SI446x_Send_Cmd(SI446X_CMD_ARG_COUNT_REQUEST_DEVICE_STATE, si446x_cmd_buffer);
@@ -472,6 +711,8 @@ struct si446x_reply_REQUEST_DEVICE_STATE_map *SI446x_Request_DeviceState(void)
     si446x_cmd.REQUEST_DEVICE_STATE.CURR_STATE       = si446x_cmd_buffer[0];
     si446x_cmd.REQUEST_DEVICE_STATE.CURRENT_CHANNEL  = si446x_cmd_buffer[1];
 
+    SI446x_Unlock();
+
     return &si446x_cmd.REQUEST_DEVICE_STATE;
 } // struct si446x_reply_REQUEST_DEVICE_STATE_map *SI446x_Request_DeviceState(void)
 
@@ -489,7 +730,9 @@ uint8_t SI446x_ConfigInit(const uint8_t* pSetPropCmd)
 {
     uint8_t col;
     uint8_t numOfBytes;
+    uint8_t ret = SI446X_SUCCESS;
 
+    SI446x_Lock();
     /* While cycle as far as the pointer points to a command */
     while (*pSetPropCmd != 0x00)
     {
@@ -498,7 +741,8 @@ uint8_t SI446x_ConfigInit(const uint8_t* pSetPropCmd)
         if (numOfBytes > RADIO_COMM_BUFFER_MAX)
         {
             /* Number of command bytes exceeds maximal allowable length */
-            return SI446X_COMMAND_ERROR;
+            ret = SI446X_COMMAND_ERROR;
+            break;
         }
 
         for (col = 0; col < numOfBytes; col++)
@@ -511,7 +755,8 @@ uint8_t SI446x_ConfigInit(const uint8_t* pSetPropCmd)
         if (SI446x_Get_Resp(0, NULL) != SI4463_CTS_READY )
         {
             /* Timeout occurred */
-            return SI446X_CTS_TIMEOUT;
+            ret = SI446X_CTS_TIMEOUT;
+            break;
         }
 
         if ( HAL_GPIO_ReadPin(SI4463_nINT_GPIO_Port, SI4463_nINT_Pin)==GPIO_PIN_RESET )
@@ -526,12 +771,559 @@ uint8_t SI446x_ConfigInit(const uint8_t* pSetPropCmd)
 */
         }
   } // while (*pSetPropCmd != 0x00)
+  SI446x_Unlock();
 
-  return SI446X_SUCCESS;
+  return ret;
 } // uint8_t SI446x_ConfigInit(const uint8_t* pSetPropCmd)
 
 
 
+/******************************************************************************/
+/*
+ * Sets consecutive properties of a group.
+ * The properties are added to the command queue if it holds commands not sent yet,
+ * so they are merged with the queued properties.
+ * group:   Property group ID
+ * count:   Number of properties, up to 12
+ * start:   ID of the first property
+ * pvalues: Property values
+ */
+/******************************************************************************/
+void SI446x_Set_Property(uint8_t group, uint8_t count, uint8_t start, const uint8_t *pvalues)
+{
+    if ( count > SI446X_SET_PROPERTY_MAX )
+        count = SI446X_SET_PROPERTY_MAX;
+    SI446x_Lock();
+    if ( (si446x_queue_state==SI446X_QUEUE_STATE_IDLE) && si446x_queue_len )
+    {
+    	SI446x_Queue_Property(group, count, start, pvalues);
+    }
+    else
+    {
+    	si446x_cmd_buffer[0] = SI446X_CMD_ID_SET_PROPERTY;
+    	si446x_cmd_buffer[1] = group; // group ID
+    	si446x_cmd_buffer[2] = count; // Number of properties
+    	si446x_cmd_buffer[3] = start; // start ID
+    	memcpy(&si446x_cmd_buffer[4], pvalues, count); // Values
+    	SI446x_Send_Cmd(count + 4, si446x_cmd_buffer);
+    }
+    SI446x_Unlock();
+} // void SI446x_Set_Property(uint8_t group, uint8_t count, uint8_t start, const uint8_t *pvalues)
+
+
+
+/******************************************************************************/
+/*
+ * Adds a command at the end of the command queue
+ * byteCount:     Number of bytes in the command
+ * pData:         Command
+ * return 0 if added
+ */
+/******************************************************************************/
+static uint8_t si446x_queue_append(uint8_t byteCount, const uint8_t *pData)
+{
+	if ( (si446x_queue_len + byteCount + 1) > (SI446X_QUEUE_SIZE - SI446X_QUEUE_RESERVED) )
+		return 1;
+	if ( !si446x_queue_locked )
+	{
+		SI446x_Lock(); // Released by SI446x_Queue_Wait(), once the queue has been sent
+		si446x_queue_locked = TRUE;
+	}
+	si446x_queue_buffer[si446x_queue_len++] = byteCount;
+	memcpy(&si446x_queue_buffer[si446x_queue_len], pData, byteCount);
+	si446x_queue_len += byteCount;
+	si446x_queue_stats.cmds_queued++;
+
+	return 0;
+} // static uint8_t si446x_queue_append(uint8_t byteCount, const uint8_t *pData)
+
+
+
+/******************************************************************************/
+/*
+ * Adds a command to the command queue. The queue is sent by SI446x_Queue_Flush(),
+ * or before the next command sent with SI446x_Send_Cmd().
+ * Commands are sent in order, SET_PROPERTY commands are merged by SI446x_Queue_Property().
+ * byteCount:     Number of bytes in the command, up to 16
+ * pData:         Command
+ * return SI446X_SUCCESS or SI446X_COMMAND_ERROR
+ */
+/******************************************************************************/
+uint8_t SI446x_Queue_Cmd(uint8_t byteCount, const uint8_t *pData)
+{
+	uint8_t cmd[SI446X_CMD_ARG_COUNT_SET_PROPERTY];
+
+	if ( (byteCount==0) || (byteCount > SI446X_CMD_ARG_COUNT_SET_PROPERTY) )
+		return SI446X_COMMAND_ERROR;
+
+	if ( (pData[0]==SI446X_CMD_ID_SET_PROPERTY) && (byteCount > 4) && (pData[2]==byteCount - 4) )
+		return SI446x_Queue_Property(pData[1], pData[2], pData[3], &pData[4]);
+
+	SI446x_Lock();
+	if ( si446x_queue_state!=SI446X_QUEUE_STATE_IDLE )
+		SI446x_Queue_Wait();
+
+	memcpy(cmd, pData, byteCount);
+	if ( (cmd[0]==SI446X_CMD_ID_GPIO_PIN_CFG) && (byteCount > SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_INDEX) )
+	{
+		// The nIRQ pin reports CTS while the queue is sent, its new mode is set at the end
+		if ( cmd[SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_INDEX] )
+			si446x_queue_nirq_mode = cmd[SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_INDEX];
+		cmd[SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_INDEX] = SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_NIRQ_MODE_ENUM_CTS;
+	} // if ( (cmd[0]==SI446X_CMD_ID_GPIO_PIN_CFG) && (byteCount > SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_INDEX) )
+
+	if ( si446x_queue_append(byteCount, cmd) )
+	{
+		SI446x_Queue_Wait(); // Queue full, send it
+		si446x_queue_append(byteCount, cmd);
+	}
+	// Properties set after this command are not merged with the ones set before
+	si446x_queue_barrier = si446x_queue_len;
+	SI446x_Unlock();
+
+	return SI446X_SUCCESS;
+} // uint8_t SI446x_Queue_Cmd(uint8_t byteCount, const uint8_t *pData)
+
+
+
+/******************************************************************************/
+/*
+ * Adds properties to the command queue.
+ * A property already queued since the last command other than SET_PROPERTY is overwritten,
+ * properties following the last queued ones in the same group extend its SET_PROPERTY,
+ * so a configuration takes one SET_PROPERTY per contiguous group of up to 12 properties.
+ * group:   Property group ID
+ * count:   Number of properties, up to 12
+ * start:   ID of the first property
+ * pvalues: Property values
+ * return SI446X_SUCCESS or SI446X_COMMAND_ERROR
+ */
+/******************************************************************************/
+uint8_t SI446x_Queue_Property(uint8_t group, uint8_t count, uint8_t start, const uint8_t *pvalues)
+{
+	uint16_t pos, found, last;
+	uint8_t *pcmd, len, cmd[SI446X_CMD_ARG_COUNT_SET_PROPERTY];
+
+	if ( (count==0) || (count > SI446X_SET_PROPERTY_MAX) )
+		return SI446X_COMMAND_ERROR;
+
+	SI446x_Lock();
+	if ( si446x_queue_state!=SI446X_QUEUE_STATE_IDLE )
+		SI446x_Queue_Wait();
+
+	found = SI446X_QUEUE_NONE;
+	last = SI446X_QUEUE_NONE;
+	for (pos = si446x_queue_barrier; pos < si446x_queue_len; pos += len + 1)
+	{
+		len = si446x_queue_buffer[pos];
+		pcmd = &si446x_queue_buffer[pos + 1];
+		last = pos;
+		if ( pcmd[1]!=group )
+			continue;
+		if ( (start >= pcmd[3]) && ((start + count) <= (pcmd[3] + pcmd[2])) )
+		{
+			found = pos; // The last write of these properties
+		}
+		else if ( (start < (pcmd[3] + pcmd[2])) && ((start + count) > pcmd[3]) )
+		{
+			found = SI446X_QUEUE_NONE; // Partly overwritten by a later write, keep the order
+		}
+	} // for (pos = si446x_queue_barrier; pos < si446x_queue_len; pos += len + 1)
+
+	if ( found!=SI446X_QUEUE_NONE )
+	{
+		pcmd = &si446x_queue_buffer[found + 1];
+		memcpy(&pcmd[4 + start - pcmd[3]], pvalues, count);
+		si446x_queue_stats.props_merged += count;
+		SI446x_Unlock();
+		return SI446X_SUCCESS;
+	} // if ( found!=SI446X_QUEUE_NONE )
+
+	if ( last!=SI446X_QUEUE_NONE )
+	{
+		pcmd = &si446x_queue_buffer[last + 1];
+		if ( (pcmd[1]==group) && (start==(pcmd[3] + pcmd[2])) && ((pcmd[2] + count) <= SI446X_SET_PROPERTY_MAX)
+			&& ((si446x_queue_len + count) <= (SI446X_QUEUE_SIZE - SI446X_QUEUE_RESERVED)) )
+		{
+			memcpy(&pcmd[4 + pcmd[2]], pvalues, count);
+			pcmd[2] += count;
+			si446x_queue_buffer[last] += count;
+			si446x_queue_len += count;
+			si446x_queue_stats.props_merged += count;
+			SI446x_Unlock();
+			return SI446X_SUCCESS;
+		}
+	} // if ( last!=SI446X_QUEUE_NONE )
+
+	cmd[0] = SI446X_CMD_ID_SET_PROPERTY;
+	cmd[1] = group;
+	cmd[2] = count;
+	cmd[3] = start;
+	memcpy(&cmd[4], pvalues, count);
+	if ( si446x_queue_append(count + 4, cmd) )
+	{
+		SI446x_Queue_Wait(); // Queue full, send it
+		si446x_queue_append(count + 4, cmd);
+	}
+	SI446x_Unlock();
+
+	return SI446X_SUCCESS;
+} // uint8_t SI446x_Queue_Property(uint8_t group, uint8_t count, uint8_t start, const uint8_t *pvalues)
+
+
+
+/******************************************************************************/
+/*
+ * Starts sending the command queue, see si446x_queue_start()
+ * return SI446X_SUCCESS, or SI446X_CTS_TIMEOUT if the radio did not respond
+ */
+/******************************************************************************/
+uint8_t SI446x_Queue_Flush(void)
+{
+	uint8_t ret;
+
+	SI446x_Lock();
+	ret = si446x_queue_start();
+	SI446x_Unlock();
+
+	return ret;
+} // uint8_t SI446x_Queue_Flush(void)
+
+
+
+/******************************************************************************/
+/*
+ * Starts sending the command queue.
+ * Once the scheduler is running, the commands are sent by the DMA, and the nIRQ pin
+ * is set to report CTS so the next command is sent from its rising edge.
+ * Before that, the commands are sent here.
+ * return SI446X_SUCCESS, or SI446X_CTS_TIMEOUT if the radio did not respond
+ */
+/******************************************************************************/
+static uint8_t si446x_queue_start(void)
+{
+	uint8_t cmd[SI446X_CMD_ARG_COUNT_GPIO_PIN_CFG];
+	uint16_t pos;
+
+	if ( (si446x_queue_state!=SI446X_QUEUE_STATE_IDLE) || (si446x_queue_len==0) )
+		return SI446X_SUCCESS;
+
+	si446x_queue_stats.flushes++;
+	if ( si446x_queue_sem==NULL && xTaskGetSchedulerState()==taskSCHEDULER_RUNNING )
+	{
+		si446x_queue_sem = xSemaphoreCreateBinary();
+	}
+
+	// Restore the mode of the nIRQ pin after the queue, the GPIO_PIN_CFG commands set it to CTS
+	memset(cmd, 0, sizeof(cmd));
+	cmd[0] = SI446X_CMD_ID_GPIO_PIN_CFG;
+	cmd[SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_INDEX] = si446x_queue_nirq_mode;
+	si446x_queue_buffer[si446x_queue_len++] = sizeof(cmd);
+	memcpy(&si446x_queue_buffer[si446x_queue_len], cmd, sizeof(cmd));
+	si446x_queue_len += sizeof(cmd);
+
+	if ( (si446x_queue_sem==NULL) || (hdma_rf_spi_tx.Instance==NULL) )
+	{
+		si446x_queue_state = SI446X_QUEUE_STATE_DONE;
+		for (pos = 0; pos < si446x_queue_len; pos += si446x_queue_buffer[pos] + 1)
+		{
+			si446x_write_cmd(si446x_queue_buffer[pos], &si446x_queue_buffer[pos + 1]);
+			si446x_queue_stats.cmds_sent++;
+			if ( si446x_read_resp(0, NULL)!=SI4463_CTS_READY )
+			{
+				si446x_queue_state = SI446X_QUEUE_STATE_ERROR;
+				break;
+			}
+		} // for (pos = 0; pos < si446x_queue_len; pos += si446x_queue_buffer[pos] + 1)
+		return (si446x_queue_state==SI446X_QUEUE_STATE_DONE)?SI446X_SUCCESS:SI446X_CTS_TIMEOUT;
+	} // if ( (si446x_queue_sem==NULL) || (hdma_rf_spi_tx.Instance==NULL) )
+
+	// Set the nIRQ pin to CTS, the CTS of this command confirms the radio is ready
+	cmd[SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_INDEX] = SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_NIRQ_MODE_ENUM_CTS;
+	si446x_write_cmd(sizeof(cmd), cmd);
+	if ( si446x_read_resp(0, NULL)!=SI4463_CTS_READY )
+	{
+		si446x_queue_state = SI446X_QUEUE_STATE_ERROR;
+		return SI446X_CTS_TIMEOUT;
+	}
+
+	m1_spi_hal_lock();
+	si446x_queue_bus_locked = TRUE;
+	xSemaphoreTake(si446x_queue_sem, 0); // Clear any old event
+
+	taskENTER_CRITICAL();
+	si446x_queue_exti_rising = EXTI->RTSR1 & SI4463_nINT_Pin;
+	si446x_queue_exti_falling = EXTI->FTSR1 & SI4463_nINT_Pin;
+	SET_BIT(EXTI->RTSR1, SI4463_nINT_Pin);
+	CLEAR_BIT(EXTI->FTSR1, SI4463_nINT_Pin);
+	__HAL_GPIO_EXTI_CLEAR_FALLING_IT(SI4463_nINT_Pin);
+	si446x_queue_irq_enabled = NVIC_GetEnableIRQ(SI4463_nINT_EXTI_IRQn);
+	if ( !si446x_queue_irq_enabled )
+	{
+		HAL_NVIC_SetPriority(SI4463_nINT_EXTI_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY + 1, 0);
+		HAL_NVIC_EnableIRQ(SI4463_nINT_EXTI_IRQn);
+	}
+	si446x_queue_pos = 0;
+	si446x_queue_send_next();
+	taskEXIT_CRITICAL();
+
+	return SI446X_SUCCESS;
+} // static uint8_t si446x_queue_start(void)
+
+
+
+/******************************************************************************/
+/*
+ * Starts the DMA transfer of the next command of the queue
+ */
+/******************************************************************************/
+static void si446x_queue_send_next(void)
+{
+	si446x_queue_state = SI446X_QUEUE_STATE_TX;
+	__HAL_GPIO_EXTI_CLEAR_RISING_IT(SI4463_nINT_Pin);
+	if ( m1_spi_hal_write_dma(SPI_DEVICE_SUBGHZ, &si446x_queue_buffer[si446x_queue_pos + 1],
+			si446x_queue_buffer[si446x_queue_pos], si446x_queue_tx_done)!=HAL_OK )
+	{
+		si446x_queue_stop(SI446X_QUEUE_STATE_ERROR);
+	}
+} // static void si446x_queue_send_next(void)
+
+
+
+/******************************************************************************/
+/*
+ * End of the DMA transfer of a command, called from the SPI interrupt.
+ * The radio drops CTS at the end of the command, and the next command is sent
+ * from the rising edge of the nIRQ pin.
+ */
+/******************************************************************************/
+static void si446x_queue_tx_done(HAL_StatusTypeDef stat)
+{
+	if ( si446x_queue_state!=SI446X_QUEUE_STATE_TX )
+		return;
+	if ( stat!=HAL_OK )
+	{
+		si446x_queue_stop(SI446X_QUEUE_STATE_ERROR);
+		return;
+	}
+
+	si446x_queue_stats.cmds_sent++;
+	si446x_queue_pos += si446x_queue_buffer[si446x_queue_pos] + 1;
+	if ( si446x_queue_pos >= si446x_queue_len )
+	{
+		// The last command restores the nIRQ pin, its CTS is checked by the next command
+		si446x_queue_stop(SI446X_QUEUE_STATE_DONE);
+		return;
+	}
+	si446x_queue_state = SI446X_QUEUE_STATE_CTS;
+} // static void si446x_queue_tx_done(HAL_StatusTypeDef stat)
+
+
+
+/******************************************************************************/
+/*
+ * Rising edge of the nIRQ pin while the command queue is sent
+ */
+/******************************************************************************/
+void SI446x_Queue_CTS_Callback(void)
+{
+	if ( si446x_queue_state!=SI446X_QUEUE_STATE_CTS )
+		return;
+	if ( HAL_GPIO_ReadPin(SI4463_nINT_GPIO_Port, SI4463_nINT_Pin)==GPIO_PIN_RESET )
+		return;
+	si446x_queue_send_next();
+} // void SI446x_Queue_CTS_Callback(void)
+
+
+
+/******************************************************************************/
+/*
+ * Stops sending the command queue, restores the nIRQ interrupt and wakes up SI446x_Queue_Wait().
+ * Called from an interrupt, or from a critical section.
+ * state: SI446X_QUEUE_STATE_DONE or SI446X_QUEUE_STATE_ERROR
+ */
+/******************************************************************************/
+static void si446x_queue_stop(uint8_t state)
+{
+	BaseType_t task_woken = pdFALSE;
+
+	MODIFY_REG(EXTI->RTSR1, SI4463_nINT_Pin, si446x_queue_exti_rising);
+	MODIFY_REG(EXTI->FTSR1, SI4463_nINT_Pin, si446x_queue_exti_falling);
+	if ( !si446x_queue_irq_enabled )
+		HAL_NVIC_DisableIRQ(SI4463_nINT_EXTI_IRQn);
+	__HAL_GPIO_EXTI_CLEAR_RISING_IT(SI4463_nINT_Pin);
+	__HAL_GPIO_EXTI_CLEAR_FALLING_IT(SI4463_nINT_Pin);
+	si446x_queue_state = state;
+	if ( xPortIsInsideInterrupt() )
+	{
+		xSemaphoreGiveFromISR(si446x_queue_sem, &task_woken);
+		portYIELD_FROM_ISR(task_woken);
+	}
+	else
+	{
+		xSemaphoreGive(si446x_queue_sem);
+	}
+} // static void si446x_queue_stop(uint8_t state)
+
+
+
+/******************************************************************************/
+/*
+ * Empties the command queue
+ */
+/******************************************************************************/
+static void si446x_queue_reset(void)
+{
+	si446x_queue_len = 0;
+	si446x_queue_barrier = 0;
+	si446x_queue_nirq_mode = SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_NIRQ_MODE_ENUM_NIRQ;
+	si446x_queue_state = SI446X_QUEUE_STATE_IDLE;
+} // static void si446x_queue_reset(void)
+
+
+
+/******************************************************************************/
+/*
+ * Sends the command queue, if not started yet, and waits until all commands have been sent.
+ * return SI446X_SUCCESS, or SI446X_CTS_TIMEOUT if the radio did not respond
+ */
+/******************************************************************************/
+uint8_t SI446x_Queue_Wait(void)
+{
+	uint8_t ret;
+	uint8_t cmd[SI446X_CMD_ARG_COUNT_GPIO_PIN_CFG];
+
+	SI446x_Lock(); // Waits for the queue of another task to be sent
+	if ( si446x_queue_state==SI446X_QUEUE_STATE_IDLE )
+	{
+		if ( si446x_queue_len==0 )
+		{
+			SI446x_Unlock();
+			return SI446X_SUCCESS;
+		}
+		si446x_queue_start();
+	} // if ( si446x_queue_state==SI446X_QUEUE_STATE_IDLE )
+
+	if ( si446x_queue_bus_locked )
+	{
+		if ( xSemaphoreTake(si446x_queue_sem, pdMS_TO_TICKS(SI446X_QUEUE_TIMEOUT))!=pdTRUE )
+		{
+			taskENTER_CRITICAL();
+			if ( si446x_queue_state!=SI446X_QUEUE_STATE_DONE )
+				si446x_queue_stop(SI446X_QUEUE_STATE_ERROR);
+			taskEXIT_CRITICAL();
+			m1_spi_hal_abort_dma();
+			si446x_queue_stats.timeouts++;
+			M1_LOG_E(M1_LOGDB_TAG, "Command queue timeout!\r\n");
+		} // if ( xSemaphoreTake(si446x_queue_sem, pdMS_TO_TICKS(SI446X_QUEUE_TIMEOUT))!=pdTRUE )
+		si446x_queue_bus_locked = FALSE;
+		m1_spi_hal_unlock();
+	} // if ( si446x_queue_bus_locked )
+
+	ret = (si446x_queue_state==SI446X_QUEUE_STATE_DONE)?SI446X_SUCCESS:SI446X_CTS_TIMEOUT;
+	si446x_queue_reset();
+	si446x_CTS_ready = FALSE;
+	if ( ret!=SI446X_SUCCESS )
+	{
+		// Put the nIRQ pin back to its default mode
+		memset(cmd, 0, sizeof(cmd));
+		cmd[0] = SI446X_CMD_ID_GPIO_PIN_CFG;
+		cmd[SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_INDEX] = SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_NIRQ_MODE_ENUM_NIRQ;
+		si446x_write_cmd(sizeof(cmd), cmd);
+	} // if ( ret!=SI446X_SUCCESS )
+	if ( si446x_queue_locked )
+	{
+		si446x_queue_locked = FALSE;
+		SI446x_Unlock(); // Taken by si446x_queue_append()
+	}
+	SI446x_Unlock();
+
+	return ret;
+} // uint8_t SI446x_Queue_Wait(void)
+
+
+
+/******************************************************************************/
+/*
+ * Return TRUE while the command queue is being sent by the DMA
+ */
+/******************************************************************************/
+uint8_t SI446x_Queue_Busy(void)
+{
+	return (si446x_queue_state==SI446X_QUEUE_STATE_TX) || (si446x_queue_state==SI446X_QUEUE_STATE_CTS);
+} // uint8_t SI446x_Queue_Busy(void)
+
+
+
+/******************************************************************************/
+/*
+ * Copies the command queue statistics
+ */
+/******************************************************************************/
+void SI446x_Queue_Get_Stats(S_SI446x_Queue_Stats_t *pstats)
+{
+	*pstats = si446x_queue_stats;
+} // void SI446x_Queue_Get_Stats(S_SI446x_Queue_Stats_t *pstats)
+
+
+
+/******************************************************************************/
+/*
+ * Adds a list of NULL terminated commands to the command queue, see SI446x_ConfigInit().
+ * The queue is sent by SI446x_Queue_Wait(), or before the next command.
+ */
+/******************************************************************************/
+uint8_t SI446x_ConfigQueue(const uint8_t* pSetPropCmd)
+{
+    uint8_t numOfBytes;
+
+    while (*pSetPropCmd != 0x00)
+    {
+        numOfBytes = *pSetPropCmd++;
+        if ( SI446x_Queue_Cmd(numOfBytes, pSetPropCmd)!=SI446X_SUCCESS )
+        {
+            /* Number of command bytes exceeds maximal allowable length */
+            return SI446X_COMMAND_ERROR;
+        }
+        pSetPropCmd += numOfBytes;
+    } // while (*pSetPropCmd != 0x00)
+
+    return SI446X_SUCCESS;
+} // uint8_t SI446x_ConfigQueue(const uint8_t* pSetPropCmd)
+
+
+
+/******************************************************************************/
+/*
+ * Reads the Fast Response Registers, starting with FRR A.
+ * FRRs are read in a single SPI transaction, without waiting for CTS,
+ * so they can be polled while the radio is processing a command.
+ * count: Number of registers to read, up to 4
+ * pdata: Register values, A first
+ */
+/******************************************************************************/
+void SI446x_Frr_Read(uint8_t count, uint8_t *pdata)
+{
+    uint8_t tx_buffer[5], rx_buffer[5];
+
+    SI446x_Lock();
+    SI446x_Queue_Wait();
+    if ( count > SI446X_CMD_REPLY_COUNT_FRR_A_READ )
+        count = SI446X_CMD_REPLY_COUNT_FRR_A_READ;
+    memset(tx_buffer, SPI_DUMMY_CMD_DATA, sizeof(tx_buffer));
+    tx_buffer[0] = SI446X_CMD_ID_FRR_A_READ;
+    radio_spi_trans_inf.pdata_tx = tx_buffer;
+    radio_spi_trans_inf.pdata_rx = rx_buffer;
+    radio_spi_trans_inf.data_len = count + 1;
+    radio_spi_trans_inf.trans_type = SPI_TRANS_WRITEREAD_DATA;
+    m1_spi_hal_trans_req(&radio_spi_trans_inf);
+
+    memcpy(pdata, &rx_buffer[1], count);
+    SI446x_Unlock();
+} // void SI446x_Frr_Read(uint8_t count, uint8_t *pdata)
+
+
+
 /******************************************************************************/
 /*
  * Sends START_RX command to the radio.
@@ -545,6 +1337,7 @@ uint8_t SI446x_ConfigInit(const uint8_t* pSetPropCmd)
 /******************************************************************************/
 void Radio_Start_Rx(uint8_t CHANNEL, uint8_t CONDITION, uint16_t RX_LEN, uint8_t NEXT_STATE1, uint8_t NEXT_STATE2, uint8_t NEXT_STATE3)
 {
+    SI446x_Lock();
     si446x_cmd_buffer[0] = SI446X_CMD_ID_START_RX;
     si446x_cmd_buffer[1] = CHANNEL;
     si446x_cmd_buffer[2] = CONDITION;
@@ -555,6 +1348,7 @@ void Radio_Start_Rx(uint8_t CHANNEL, uint8_t CONDITION, uint16_t RX_LEN, uint8_t
     si446x_cmd_buffer[7] = NEXT_STATE3;
 
     SI446x_Send_Cmd(SI446X_CMD_ARG_COUNT_START_RX, si446x_cmd_buffer);
+    SI446x_Unlock();
 } // void Radio_Start_Rx(uint8_t CHANNEL, uint8_t CONDITION, uint16_t RX_LEN, uint8_t NEXT_STATE1, uint8_t NEXT_STATE2, uint8_t NEXT_STATE3)
 
 
@@ -568,6 +1362,7 @@ void Radio_Start_Rx(uint8_t CHANNEL, uint8_t CONDITION, uint16_t RX_LEN, uint8_t
 /******************************************************************************/
 void SI446x_Start_Rx(uint8_t channel)
 {
+    SI446x_Lock();
     // Read INTs, clear pending ones
     SI446x_Get_IntStatus(0, 0, 0);
 /*
@@ -590,6 +1385,7 @@ void SI446x_Start_Rx(uint8_t channel)
 #else
     SI446x_Change_State(SI446X_CMD_CHANGE_STATE_ARG_NEXT_STATE1_NEW_STATE_ENUM_SPI_ACTIVE);
 #endif // #ifndef DEBUG_SI4463_SPISTATE
+    SI446x_Unlock();
 } // void SI446x_Start_Rx(uint8_t channel)
 
 
@@ -604,6 +1400,7 @@ void SI446x_Start_Rx(uint8_t channel)
 /******************************************************************************/
 void Radio_Start_Tx(uint8_t CHANNEL, uint8_t CONDITION, uint16_t TX_LEN)
 {
+    SI446x_Lock();
     si446x_cmd_buffer[0] = SI446X_CMD_ID_START_TX;
     si446x_cmd_buffer[1] = CHANNEL;
     si446x_cmd_buffer[2] = CONDITION;
@@ -616,6 +1413,7 @@ void Radio_Start_Tx(uint8_t CHANNEL, uint8_t CONDITION, uint16_t TX_LEN)
     si446x_cmd_buffer[6] = 0x00;
 
     SI446x_Send_Cmd(SI446X_CMD_ARG_COUNT_START_TX, si446x_cmd_buffer);
+    SI446x_Unlock();
 } // void Radio_Start_Tx(uint8_t CHANNEL, uint8_t CONDITION, uint16_t TX_LEN)
 
 
@@ -631,6 +1429,7 @@ void SI446x_Start_Tx(uint8_t channel, uint8_t *pradio_tx_buffer, uint8_t length)
 {
     uint8_t tx_channel;
 
+    SI446x_Lock();
     tx_channel = channel;
     if ( tx_channel==0x00 )
         tx_channel = pradioconfig->Radio_ChannelNumber;
@@ -649,6 +1448,7 @@ void SI446x_Start_Tx(uint8_t channel, uint8_t *pradio_tx_buffer, uint8_t length)
 
     /* Start sending packet, channel 0, START immediately */
     Radio_Start_Tx(tx_channel, START_TX_COMPLETE_STATE_READY, length); // Enter the Ready state after completion of the packet transmission
+    SI446x_Unlock();
 } // void SI446x_Start_Tx(uint8_t channel, uint8_t *pradio_tx_buffer, uint8_t length)
 
 
@@ -678,6 +1478,7 @@ void SI446x_Calibrate_IR(void)
 /******************************************************************************/
 void SI446x_GPIO_Config(uint8_t GPIO0, uint8_t GPIO1, uint8_t GPIO2, uint8_t GPIO3, uint8_t NIRQ, uint8_t SDO, uint8_t GEN_CONFIG)
 {
+    SI446x_Lock();
     si446x_cmd_buffer[0] = SI446X_CMD_ID_GPIO_PIN_CFG;
     si446x_cmd_buffer[1] = GPIO0;
     si446x_cmd_buffer[2] = GPIO1;
@@ -697,6 +1498,7 @@ void SI446x_GPIO_Config(uint8_t GPIO0, uint8_t GPIO1, uint8_t GPIO2, uint8_t GPI
     si446x_cmd.GPIO_PIN_CFG.NIRQ         = si446x_cmd_buffer[4];
     si446x_cmd.GPIO_PIN_CFG.SDO          = si446x_cmd_buffer[5];
     si446x_cmd.GPIO_PIN_CFG.GEN_CONFIG   = si446x_cmd_buffer[6];
+    SI446x_Unlock();
 } // void SI446x_GPIO_Config(uint8_t GPIO0, uint8_t GPIO1, uint8_t GPIO2, uint8_t GPIO3, uint8_t NIRQ, uint8_t SDO, uint8_t GEN_CONFIG)
 
 
@@ -708,6 +1510,7 @@ void SI446x_GPIO_Config(uint8_t GPIO0, uint8_t GPIO1, uint8_t GPIO2, uint8_t GPI
 /******************************************************************************/
 void SI446x_GPIO_ConfigFast(void)
 {
+    SI446x_Lock();
     si446x_cmd_buffer[0] = SI446X_CMD_ID_GPIO_PIN_CFG;
 
     SI446x_Send_Cmd(1, si446x_cmd_buffer);
@@ -720,6 +1523,7 @@ void SI446x_GPIO_ConfigFast(void)
     si446x_cmd.GPIO_PIN_CFG.NIRQ         = si446x_cmd_buffer[4];
     si446x_cmd.GPIO_PIN_CFG.SDO          = si446x_cmd_buffer[5];
     si446x_cmd.GPIO_PIN_CFG.GEN_CONFIG   = si446x_cmd_buffer[6];
+    SI446x_Unlock();
 } // void SI446x_GPIO_Config(uint8_t GPIO0, uint8_t GPIO1, uint8_t GPIO2, uint8_t GPIO3, uint8_t NIRQ, uint8_t SDO, uint8_t GEN_CONFIG)
 
 
@@ -732,10 +1536,12 @@ void SI446x_GPIO_ConfigFast(void)
 /******************************************************************************/
 void SI446x_Change_State(uint8_t NEXT_STATE1)
 {
+    SI446x_Lock();
     si446x_cmd_buffer[0] = SI446X_CMD_ID_CHANGE_STATE;
     si446x_cmd_buffer[1] = NEXT_STATE1;
 
     SI446x_Send_Cmd(SI446X_CMD_ARG_COUNT_CHANGE_STATE, si446x_cmd_buffer);
+    SI446x_Unlock();
 } // void SI446x_Change_State(uint8_t NEXT_STATE1)
 
 
@@ -748,6 +1554,7 @@ void SI446x_Change_State(uint8_t NEXT_STATE1)
 /******************************************************************************/
 void SI446x_FiFoInfo(uint8_t FIFO)
 {
+    SI446x_Lock();
     si446x_cmd_buffer[0] = SI446X_CMD_ID_FIFO_INFO;
     si446x_cmd_buffer[1] = FIFO;
 
@@ -756,6 +1563,7 @@ void SI446x_FiFoInfo(uint8_t FIFO)
 
     si446x_cmd.FIFO_INFO.RX_FIFO_COUNT   = si446x_cmd_buffer[0];
     si446x_cmd.FIFO_INFO.TX_FIFO_SPACE   = si446x_cmd_buffer[1];
+    SI446x_Unlock();
 } // void SI446x_FiFoInfo(uint8_t FIFO)
 
 
@@ -791,12 +1599,7 @@ void SI446x_Write_TxFiFo(uint8_t numBytes, uint8_t *pTxData)
 /******************************************************************************/
 void SI446x_Change_ModType(uint8_t NEW_MOD_TYPE)
 {
-    si446x_cmd_buffer[0] = SI446X_CMD_ID_SET_PROPERTY;
-    si446x_cmd_buffer[1] = SI446X_GROUP_MODEM; // group ID
-    si446x_cmd_buffer[2] = 0x01; // Number of properties
-    si446x_cmd_buffer[3] = SI446X_GROUP_MODEM_PROPERTY_MODEM_MOD_TYPE; // start ID
-    si446x_cmd_buffer[4] = NEW_MOD_TYPE; // Values
-    SI446x_Send_Cmd(5, si446x_cmd_buffer);
+    SI446x_Set_Property(SI446X_GROUP_MODEM, 1, SI446X_GROUP_MODEM_PROPERTY_MODEM_MOD_TYPE, &NEW_MOD_TYPE);
 } // void SI446x_Change_ModType(uint8_t NEW_MOD_TYPE)
 
 
@@ -808,12 +1611,7 @@ void SI446x_Change_ModType(uint8_t NEW_MOD_TYPE)
  */
 void SI446x_Change_Modem_OOK_PDTC(uint8_t NEW_PDTC)
 {
-    si446x_cmd_buffer[0] = SI446X_CMD_ID_SET_PROPERTY;
-    si446x_cmd_buffer[1] = SI446X_GROUP_MODEM; // group ID
-    si446x_cmd_buffer[2] = 0x01; // Number of properties
-    si446x_cmd_buffer[3] = SI446X_GROUP_MODEM_PROPERTY_MODEM_OOK_PDTC; // start ID
-    si446x_cmd_buffer[4] = NEW_PDTC; // Values
-    SI446x_Send_Cmd(5, si446x_cmd_buffer);
+    SI446x_Set_Property(SI446X_GROUP_MODEM, 1, SI446X_GROUP_MODEM_PROPERTY_MODEM_OOK_PDTC, &NEW_PDTC);
 } // void SI446x_Change_Modem_OOK_PDTC(uint8_t NEW_PDTC)
 
 
@@ -827,16 +1625,15 @@ void SI446x_Change_Modem_OOK_PDTC(uint8_t NEW_PDTC)
 /******************************************************************************/
 void SI446x_Change_Radio_Setting(uint8_t mode, uint8_t pa_power)
 {
+    uint8_t pa_values[2];
+
+    SI446x_Lock();
     switch (mode)
     {
         case RADIO_SETTING_MODE_PAPOWER:
-            si446x_cmd_buffer[0] = SI446X_CMD_ID_SET_PROPERTY; // 0x11
-            si446x_cmd_buffer[1] = SI446X_GRP_ID_0x22;
-            si446x_cmd_buffer[2] = 2; // number of properties
-            si446x_cmd_buffer[3] = SI446X_GRP_ID_0x22_PA_PWR_LVL; // first property index in the group
-            si446x_cmd_buffer[4] = pa_power; // for PA_PWR_LVL, 7 bits
-            si446x_cmd_buffer[5] = 0;
-            SI446x_Send_Cmd(6, si446x_cmd_buffer);
+            pa_values[0] = pa_power; // for PA_PWR_LVL, 7 bits
+            pa_values[1] = 0;
+            SI446x_Set_Property(SI446X_GRP_ID_0x22, 2, SI446X_GRP_ID_0x22_PA_PWR_LVL, pa_values);
             break;
 
         case RADIO_SETTING_MODE_CLEAR_INT:
@@ -866,6 +1663,7 @@ void SI446x_Change_Radio_Setting(uint8_t mode, uint8_t pa_power)
         default: // unknown mode
             break;
     } // switch (mode)
+    SI446x_Unlock();
 } // void SI446x_Change_Radio_Setting(uint8_t mode, uint8_t pa_power)
 
 
@@ -953,9 +1751,11 @@ void SI446x_Start_Tx_CW(uint16_t channel, uint8_t radio_mod_type)
 /******************************************************************************/
 void SI446x_Set_Tx_Power(uint8_t power)
 {
+    SI446x_Lock();
     // Read INTs, clear pending ones
     SI446x_Get_IntStatus(0, 0, 0);
     SI446x_Change_Radio_Setting(RADIO_SETTING_MODE_PAPOWER, power);
+    SI446x_Unlock();
 } // void SI446x_Set_Tx_Power(uint8_t power)
 
 
@@ -1015,6 +1815,7 @@ void radio_init_rx_tx(S_M1_SubGHz_Band freq, uint8_t mod_type, bool do_reset)
 	if ( freq >= SUB_GHZ_BAND_EOL )
 		return;
 
+	SI446x_Lock();
 	if ( do_reset )
 	{
 		SI446x_PowerUp();
@@ -1023,18 +1824,25 @@ void radio_init_rx_tx(S_M1_SubGHz_Band freq, uint8_t mod_type, bool do_reset)
 	assert(pradioconfig!=NULL);
 	radio_mod_type = mod_type & MODEM_MOD_TYPE_MASK;
     /* Load radio configuration */
-    while (SI446X_SUCCESS != SI446x_ConfigInit(pradioconfig->Radio_ConfigurationArray) )
+    while ( 1 )
     {
+        SI446x_ConfigQueue(pradioconfig->Radio_ConfigurationArray);
+        // TX direct mode settings are merged with the configuration
+        if ( mod_type & ~MODEM_MOD_TYPE_MASK )
+            SI446x_Change_ModType(mod_type);
+        if ( SI446x_Queue_Wait()==SI446X_SUCCESS )
+            break;
         HAL_Delay(1); // 10
         /* Power Up the radio chip */
         SI446x_PowerUp();
-    } // while (SI446X_SUCCESS != SI446x_ConfigInit(pradioconfig->Radio_ConfigurationArray) )
+    } // while ( 1 )
 
     // Read INTs, clear pending ones
     SI446x_Get_IntStatus(0, 0, 0);
 
     radio_init_done = TRUE;
     radio_state_flag = RADIO_STATE_IDLE;
+    SI446x_Unlock();
 } // void radio_init_rx_tx(S_M1_SubGHz_Band freq, uint8_t mod_type, bool do_reset)
 
 
@@ -1048,6 +1856,7 @@ void radio_init_rx_tx(S_M1_SubGHz_Band freq, uint8_t mod_type, bool do_reset)
 /******************************************************************************/
 void radio_patch_init(void)
 {
+	SI446x_Lock();
 	pradioconfig = &RadioConfiguration_Patch;
 	assert(pradioconfig!=NULL);
 
@@ -1059,6 +1868,7 @@ void radio_patch_init(void)
 
     // Read INTs, clear pending ones
     SI446x_Get_IntStatus(0, 0, 0);
+    SI446x_Unlock();
 } // void radio_patch_init(void)
 
 
@@ -20,6 +20,17 @@
 #define SI446X_GRP_ID_0x22_PA_PWR_LVL           0x01 // PA output power level.
 #define SI446X_GRP_ID_0x22_PA_BIAS_CLKDUTY      0x02 // PA bias and duty cycle of the Tx clock source.
 
+#define SI446X_GRP_ID_0x02                      0x02
+#define SI446X_GRP_ID_0x02_FRR_CTL_A_MODE       0x00 // Fast Response Register A configuration.
+#define SI446X_GRP_ID_0x02_FRR_CTL_B_MODE       0x01 // Fast Response Register B configuration.
+#define SI446X_FRR_MODE_CURRENT_STATE           0x09
+#define SI446X_FRR_MODE_LATCHED_RSSI            0x0A
+
+#define SI446X_GRP_ID_0x20                      0x20
+#define SI446X_GRP_ID_0x20_MODEM_RSSI_CONTROL   0x4C // RSSI averaging and latching.
+#define SI446X_RSSI_CONTROL_LATCH_MASK          0x07
+#define SI446X_RSSI_CONTROL_LATCH_RX_STATE1     0x03 // Latch after the first RSSI update in RX
+
 #define RADIO_SETTING_MODE_IDLE         0x00
 #define RADIO_SETTING_MODE_PAPOWER      0x01
 #define RADIO_SETTING_MODE_TX     		0x02
@@ -57,6 +68,9 @@
 #define RF_PACKET_LEN_MAX				40
 #define RADIO_XX_CONFIGURATION_DATA_RADIO_PACKET_LENGTH		RADIO_PACKET_LEN_MAX
 
+#define SI446X_QUEUE_SIZE				512 // Bytes, holds the largest band configuration
+#define SI446X_QUEUE_TIMEOUT			100 // ms
+
 typedef struct
 {
     const uint8_t   *Radio_ConfigurationArray;
@@ -83,13 +97,27 @@ typedef enum
 	RADIO_ANTENNA_MODE_TX,
 } tRadioAntennaMode;
 
+typedef struct
+{
+	uint32_t cmds_queued;
+	uint32_t cmds_sent;
+	uint32_t props_merged; // Properties merged with a queued SET_PROPERTY
+	uint32_t flushes;
+	uint32_t timeouts;
+} S_SI446x_Queue_Stats_t;
+
 void radio_init_rx_tx(S_M1_SubGHz_Band, uint8_t mod_type, bool do_reset);
 void radio_patch_reinit(void);
 uint8_t radio_get_init_state(void);
 void radio_set_antenna_mode(tRadioAntennaMode mode);
+void Radio_Start_Rx(uint8_t CHANNEL, uint8_t CONDITION, uint16_t RX_LEN, uint8_t NEXT_STATE1, uint8_t NEXT_STATE2, uint8_t NEXT_STATE3);
 void Radio_Start_Tx(uint8_t CHANNEL, uint8_t CONDITION, uint16_t TX_LEN);
 void SI446x_PowerUp(void);
 uint8_t SI446x_Get_Reset_Stat(void);
+void SI446x_Lock_Init(void);
+void SI446x_Lock(void);
+uint8_t SI446x_Try_Lock(uint32_t timeout);
+void SI446x_Unlock(void);
 void SI446x_Change_ModType(uint8_t NEW_MOD_TYPE);
 void SI446x_Change_Modem_OOK_PDTC(uint8_t NEW_PDTC);
 void SI446x_Get_IntStatus(uint8_t PH_CLR_PEND, uint8_t MODEM_CLR_PEND, uint8_t CHIP_CLR_PEND);
@@ -102,6 +130,21 @@ void SI446x_Start_Tx_CW(uint16_t channel, uint8_t radio_mod_type);
 struct si446x_reply_PART_INFO_map *SI446x_PartInfo(void);
 struct si446x_reply_REQUEST_DEVICE_STATE_map *SI446x_Request_DeviceState(void);
 struct si446x_reply_GET_MODEM_STATUS_map *SI446x_Get_ModemStatus( uint8_t MODEM_CLR_PEND);
+uint8_t SI446x_Send_Cmd(uint8_t byteCount, uint8_t *pData);
+uint8_t SI446x_Get_Resp(uint8_t byteCount, uint8_t *pData);
+void SI446x_Set_Property(uint8_t group, uint8_t count, uint8_t start, const uint8_t *pvalues);
+void SI446x_Frr_Read(uint8_t count, uint8_t *pdata);
+uint8_t SI446x_Poll_CTS(void);
+uint8_t SI446x_Queue_Cmd(uint8_t byteCount, const uint8_t *pData);
+uint8_t SI446x_Queue_Property(uint8_t group, uint8_t count, uint8_t start, const uint8_t *pvalues);
+uint8_t SI446x_Queue_Flush(void);
+uint8_t SI446x_Queue_Wait(void);
+uint8_t SI446x_Queue_Busy(void);
+void SI446x_Queue_CTS_Callback(void);
+void SI446x_Queue_Get_Stats(S_SI446x_Queue_Stats_t *pstats);
+uint8_t SI446x_ConfigQueue(const uint8_t* pSetPropCmd);
+
+extern const tRadioConfiguration *RadioConfigList[SUB_GHZ_BAND_EOL];
 
 extern volatile uint8_t radio_state_flag;
 extern volatile uint8_t si446x_nIRQ_active;
@@ -21,6 +21,7 @@
 #include "si446x_cmd.h"
 #include "m1_io_defs.h" // Test only
 #include "m1_log_debug.h"
+#include "m1_tasks.h"
 
 /*************************** D E F I N E S ************************************/
 
@@ -31,8 +32,10 @@
 const SubGHz_protocol_t subghz_protocols_list[] =
 {
 	/*{160, 470, PACKET_PULSE_TIME_TOLERANCE20, 0, 24}, // Princeton: bit 0 |^|___, bit 1 |^^^|_*/
-	{370, 1140, PACKET_PULSE_TIME_TOLERANCE20, 0, 24}, // Princeton: bit 0 |^|___, bit 1 |^^^|_
-	{250, 500, PACKET_PULSE_TIME_TOLERANCE20, 16, 46} // Security+ 2.0: bit 0 |^|___, bit 1 |^|_
+	{370, 1140, PACKET_PULSE_TIME_TOLERANCE20, 0, 24,
+		subghz_decode_princeton_reset, subghz_decode_princeton_feed}, // Princeton: bit 0 |^|___, bit 1 |^^^|_
+	{250, 500, PACKET_PULSE_TIME_TOLERANCE20, 16, 46,
+		subghz_decode_security_plus_20_reset, subghz_decode_security_plus_20_feed} // Security+ 2.0: bit 0 |^|___, bit 1 |^|_
 };
 
 const char *protocol_text[] =
@@ -49,15 +52,29 @@ enum {
 
 //************************** S T R U C T U R E S *******************************
 
+typedef struct
+{
+	uint32_t tick; // HAL tick
+	int16_t rssi; // dBm
+} S_SubGHz_Rssi_Sample_t;
+
 /***************************** V A R I A B L E S ******************************/
 
 SubGHz_DecEnc_t subghz_decenc_ctl;
+SubGHz_Dec_Stats_t subghz_dec_stats;
+static uint32_t subghz_decoders_active; // One bit per protocol still matching the current packet
+
+static S_SubGHz_Rssi_Sample_t subghz_rssi_history[SUBGHZ_RSSI_HISTORY_SIZE];
+static volatile uint32_t subghz_rssi_count; // Samples taken so far, the last one is at (count - 1)
+static TaskHandle_t subghz_rssi_task_hdl = NULL; // Created at the first start, never deleted
+static volatile bool subghz_rssi_run;
 
 /********************* F U N C T I O N   P R O T O T Y P E S ******************/
 
 inline uint16_t get_diff(uint16_t n_a, uint16_t n_b);
 uint8_t subghz_pulse_handler(uint16_t duration);
-static bool subghz_decode_protocol(uint16_t p, uint16_t pulsecount);
+static void subghz_decoders_reset(void);
+static void subghz_decoders_feed(uint16_t duration);
 bool subghz_decenc_read(SubGHz_Dec_Info_t *received, bool raw);
 
 /*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
@@ -178,6 +195,41 @@ uint16_t subghz_get_decoded_protocol()
 /*============================================================================*/
 int16_t subghz_get_decoded_rssi()
 {
+	uint32_t count, n, dt, dt_min;
+	int16_t rssi_max;
+	bool in_packet;
+	S_SubGHz_Rssi_Sample_t *psample;
+
+	// Attach the RSSI sampled while the packet was received, or the nearest one
+	count = subghz_rssi_count;
+	n = (count < SUBGHZ_RSSI_HISTORY_SIZE)?count:SUBGHZ_RSSI_HISTORY_SIZE;
+	in_packet = false;
+	rssi_max = INT16_MIN;
+	dt_min = UINT32_MAX;
+	while ( n-- )
+	{
+		psample = &subghz_rssi_history[--count & (SUBGHZ_RSSI_HISTORY_SIZE - 1)];
+		if ( (psample->tick - subghz_decenc_ctl.ndecodedstarttick) <= (subghz_decenc_ctl.ndecodedendtick - subghz_decenc_ctl.ndecodedstarttick) )
+		{
+			in_packet = true;
+			if ( psample->rssi > rssi_max )
+				rssi_max = psample->rssi;
+			continue;
+		}
+		if ( in_packet )
+			continue;
+		dt = psample->tick - subghz_decenc_ctl.ndecodedendtick; // Sample after the packet?
+		if ( dt > INT32_MAX )
+			dt = subghz_decenc_ctl.ndecodedstarttick - psample->tick; // Sample before the packet
+		if ( dt < dt_min )
+		{
+			dt_min = dt;
+			subghz_decenc_ctl.ndecodedrssi = psample->rssi;
+		}
+	} // while ( n-- )
+	if ( in_packet )
+		subghz_decenc_ctl.ndecodedrssi = rssi_max;
+
 	return subghz_decenc_ctl.ndecodedrssi;
 }
 
@@ -198,31 +250,55 @@ uint16_t *subghz_get_rawdata()
 
 /*============================================================================*/
 /**
-  * @brief
+  * @brief  Restarts all registered decoders for a new packet
   * @param  None
   * @retval None
   */
 /*============================================================================*/
-bool subghz_decode_protocol(uint16_t p, uint16_t pulsecount)
+static void subghz_decoders_reset(void)
 {
-    uint8_t ret = false;
+	uint8_t i;
 
-    switch ( p )
-    {
-    	case PRINCETON:
-    		ret = subghz_decode_princeton(p, pulsecount);
-    		break;
+	for (i=0; i<n_protocol; i++)
+		subghz_protocols_list[i].decode_reset(i);
+	subghz_decoders_active = (1UL << n_protocol) - 1;
+} // static void subghz_decoders_reset(void)
 
-    	case SECURITY_PLUS_20:
-    		ret = subghz_decode_security_plus_20(p, pulsecount);
-    		break;
 
-    	default:
-    		break;
-    } // switch ( p )
 
-    return ret;
-} // bool subghz_decode_protocol(uint16_t p, uint16_t subghz_decenc_ctl.npulsecount)
+/*============================================================================*/
+/**
+  * @brief  Feeds one pulse to every decoder still matching the current packet.
+  *         A decoder drops out at its first mismatching pulse, and the first one
+  *         to complete a packet ends the decoding of this packet.
+  * @param  duration pulse duration in uS
+  * @retval None
+  */
+/*============================================================================*/
+static void subghz_decoders_feed(uint16_t duration)
+{
+	uint32_t active;
+	uint8_t i, ret;
+
+	active = subghz_decoders_active;
+	for (i=0; active; i++, active >>= 1)
+	{
+		if ( !(active & 0x01) )
+			continue;
+		ret = subghz_protocols_list[i].decode_feed(i, duration);
+		if ( ret==SUBGHZ_DECODE_PENDING )
+			continue;
+		if ( ret==SUBGHZ_DECODE_DONE )
+		{
+			subghz_decenc_ctl.ndecodedstarttick = subghz_decenc_ctl.npacketstarttick;
+			subghz_decenc_ctl.ndecodedendtick = HAL_GetTick();
+			subghz_dec_stats.decoded++;
+			subghz_decoders_active = 0;
+			break;
+		} // if ( ret==SUBGHZ_DECODE_DONE )
+		subghz_decoders_active &= ~(1UL << i);
+	} // for (i=0; active; i++, active >>= 1)
+} // static void subghz_decoders_feed(uint16_t duration)
 
 
 /*============================================================================*/
@@ -235,37 +311,33 @@ bool subghz_decode_protocol(uint16_t p, uint16_t pulsecount)
 uint8_t subghz_pulse_handler(uint16_t duration)
 {
 	  static uint32_t interpacket_gap = 0;
-	  uint8_t i;
-	  int16_t rssi;
-	  struct si446x_reply_GET_MODEM_STATUS_map *pmodemstat;
 
 	  if (duration >= PACKET_PULSE_TIME_MIN)
 	  {
 		  if (duration >= INTERPACKET_GAP_MIN) // Possible gap between packets?
 		  {
 			  subghz_decenc_ctl.pulse_times[subghz_decenc_ctl.npulsecount++] = duration; // End bit
+			  subghz_decoders_feed(duration); // Some protocols end their packet with the gap
 
 			  M1_LOG_D(M1_LOGDB_TAG, "Valid gap: %d, pulses:%d\r\n", duration, subghz_decenc_ctl.npulsecount);
 			  if ( subghz_decenc_ctl.npulsecount >= PACKET_PULSE_COUNT_MIN ) // Potential packet received?
 			  {
-				  for(i = 0; i < n_protocol; i++)
-				  {
-					  if ( !subghz_decode_protocol(i, subghz_decenc_ctl.npulsecount) )
-					  {
-						  // receive successfully for protocol i
-						  break;
-					  }
-				  } // for(i = 0; i < n_protocol; i++)
-			  } // if ( subghz_decenc_ctl.npulsecount >= PACKET_PULSE_COUNT_MIN )
+				  subghz_dec_stats.packets++;
+			  }
 			  interpacket_gap = duration; // update
 			  subghz_decenc_ctl.npulsecount = 0;
+			  subghz_decoders_reset();
 			  // A potential interpacket gap has been detected, so it's not required to check for this condition for the next packet, if any.
 			  return PULSE_DET_EOP; // error or end of packet has been met
 		  } // if (duration >= INTERPACKET_GAP_MIN)
 	  } // if (duration >= PACKET_PULSE_TIME_MIN)
 	  else
 	  {
-		  subghz_decenc_ctl.npulsecount = 0; // reset
+		  if ( subghz_decenc_ctl.npulsecount )
+		  {
+			  subghz_decenc_ctl.npulsecount = 0; // reset
+			  subghz_decoders_reset();
+		  }
 		  interpacket_gap += duration;
 		  // Interpacket gap has been timeout for a potential packet
 		  if ( interpacket_gap > INTERPACKET_GAP_MAX )
@@ -282,19 +354,15 @@ uint8_t subghz_pulse_handler(uint16_t duration)
 	  if (subghz_decenc_ctl.npulsecount >= PACKET_PULSE_COUNT_MAX)
 	  {
 		  subghz_decenc_ctl.npulsecount = 0; // Reset rx buffer
+		  subghz_decoders_reset();
 		  return PULSE_DET_IDLE; // error
 	  }
+	  // RSSI is sampled by subghz_rssi_worker_task() and matched to the packet by time
+	  if ( !subghz_decenc_ctl.npulsecount )
+		  subghz_decenc_ctl.npacketstarttick = HAL_GetTick();
 	  subghz_decenc_ctl.pulse_times[subghz_decenc_ctl.npulsecount++] = duration;
-	  // Read RSSI when half of this potential packet has been received
-	  if ( subghz_decenc_ctl.npulsecount==PACKET_PULSE_COUNT_MIN/2 )
-	  {
-		  // Read INTs, clear pending ones
-		  SI446x_Get_IntStatus(0, 0, 0);
-		  pmodemstat = SI446x_Get_ModemStatus(0x00);
-		  // RF_Input_Level_dBm = (RSSI_value / 2) – MODEM_RSSI_COMP – 70
-		  rssi = pmodemstat->CURR_RSSI/2 - MODEM_RSSI_COMP - 70;
-		  subghz_decenc_ctl.ndecodedrssi = rssi;
-	  } // if ( subghz_decenc_ctl.npulsecount==PACKET_PULSE_COUNT_MIN/2 )
+	  if ( subghz_decoders_active )
+		  subghz_decoders_feed(duration);
 
 	  return PULSE_DET_NORMAL;
 } // uint8_t subghz_pulse_handler(uint16_t duration)
@@ -368,6 +436,101 @@ void subghz_decenc_init(void)
 	subghz_decenc_ctl.ndecodedprotocol = 0;
 	subghz_decenc_ctl.npulsecount = 0;
 	subghz_decenc_ctl.pulse_det_stat = PULSE_DET_IDLE;
+	subghz_decoders_reset();
 	memset(subghz_decenc_ctl.pulse_times, 0, sizeof(subghz_decenc_ctl.pulse_times));
 	subghz_decenc_ctl.n64_decodedvalue = 0;
 } // void subghz_decenc_init(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Samples the RSSI of the radio periodically while the receiver runs,
+  *         so that the pulse handler never waits for the SPI bus. The task
+  *         sleeps on its notification while the receiver is stopped.
+  * @param  argument not used
+  * @retval None
+  */
+/*============================================================================*/
+static void subghz_rssi_worker_task(void *argument)
+{
+	struct si446x_reply_GET_MODEM_STATUS_map *pmodemstat;
+	S_SubGHz_Rssi_Sample_t *psample;
+
+	(void)argument;
+
+	for (;;)
+	{
+		if ( !subghz_rssi_run )
+		{
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // Until subghz_rssi_worker_start()
+			continue;
+		}
+		// The sample is skipped while the Sub-GHz task keeps the radio
+		if ( SI446x_Try_Lock(SUBGHZ_RSSI_SAMPLE_PERIOD) )
+		{
+			// Checked with the radio taken, see subghz_rssi_worker_stop()
+			if ( subghz_rssi_run )
+			{
+				pmodemstat = SI446x_Get_ModemStatus(0x00); // Process time: ~99.7us
+				psample = &subghz_rssi_history[subghz_rssi_count & (SUBGHZ_RSSI_HISTORY_SIZE - 1)];
+				psample->tick = HAL_GetTick();
+				// RF_Input_Level_dBm = (RSSI_value / 2) – MODEM_RSSI_COMP – 70
+				psample->rssi = pmodemstat->CURR_RSSI/2 - MODEM_RSSI_COMP - 70;
+				subghz_rssi_count++;
+			} // if ( subghz_rssi_run )
+			SI446x_Unlock(); // The reply is shared with the other commands
+		} // if ( SI446x_Try_Lock(SUBGHZ_RSSI_SAMPLE_PERIOD) )
+		vTaskDelay(pdMS_TO_TICKS(SUBGHZ_RSSI_SAMPLE_PERIOD));
+	} // for (;;)
+} // static void subghz_rssi_worker_task(void *argument)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Starts sampling the RSSI for the decoded packets.
+  *         Call after the radio has been put in RX mode.
+  * @param  None
+  * @retval None
+  */
+/*============================================================================*/
+void subghz_rssi_worker_start(void)
+{
+	BaseType_t ret;
+
+	if ( subghz_rssi_run )
+		return;
+
+	subghz_rssi_count = 0;
+	subghz_rssi_run = true;
+	if ( subghz_rssi_task_hdl==NULL )
+	{
+		ret = xTaskCreate(subghz_rssi_worker_task, "subghz_rssi_task", M1_TASK_STACK_SIZE_DEFAULT, NULL, TASK_PRIORITY_SUBGHZ_RSSI_WORKER, &subghz_rssi_task_hdl);
+		assert(ret==pdPASS);
+		assert(subghz_rssi_task_hdl!=NULL);
+		return;
+	} // if ( subghz_rssi_task_hdl==NULL )
+	xTaskNotifyGive(subghz_rssi_task_hdl);
+} // void subghz_rssi_worker_start(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Stops sampling the RSSI. When this function returns, the worker
+  *         does not access the radio any more: it checks the run flag with
+  *         the radio taken, so taking the radio here once is enough.
+  * @param  None
+  * @retval None
+  */
+/*============================================================================*/
+void subghz_rssi_worker_stop(void)
+{
+	if ( !subghz_rssi_run )
+		return;
+
+	subghz_rssi_run = false;
+	SI446x_Lock(); // Waits for a sample being taken
+	SI446x_Unlock();
+} // void subghz_rssi_worker_stop(void)
@@ -28,6 +28,15 @@
 #define PACKET_PULSE_TIME_TOLERANCE25		25
 #define PACKET_PULSE_TIME_TOLERANCE30		30
 
+#define SUBGHZ_RSSI_SAMPLE_PERIOD			4 // ms
+#define SUBGHZ_RSSI_HISTORY_SIZE			32 // Power of two, covers SUBGHZ_RSSI_SAMPLE_PERIOD*SUBGHZ_RSSI_HISTORY_SIZE ms
+
+enum {
+	SUBGHZ_DECODE_PENDING = 0, // Pulses match so far, more are needed
+	SUBGHZ_DECODE_DONE, // Packet decoded
+	SUBGHZ_DECODE_FAILED // Pulse does not match, drop out until the next packet
+};
+
 typedef struct SubGHz_protocol
 {
     uint16_t te_short;
@@ -35,6 +44,8 @@ typedef struct SubGHz_protocol
     uint8_t te_tolerance;
     uint8_t preamble_bits;
     uint16_t data_bits;
+    void (*decode_reset)(uint16_t p); // Called at the start of every packet
+    uint8_t (*decode_feed)(uint16_t p, uint16_t duration); // Called for every pulse, returns SUBGHZ_DECODE_xxx
 } SubGHz_protocol_t;
 
 
@@ -50,7 +61,6 @@ typedef struct
     int16_t (*subghz_get_decoded_rssi)(void);
     uint16_t *(*subghz_get_rawdata)(void);
     uint8_t (*subghz_pulse_handler)(uint16_t duration);
-    bool (*subghz_decode_protocol)(const uint16_t p, uint16_t changeCount);
 
     uint64_t n64_decodedvalue;
     uint32_t n32_serialnumber;
@@ -67,9 +77,18 @@ typedef struct
     uint32_t ntx_raw_dest;
     volatile uint8_t pulse_det_stat; // Updated in interrupt
     volatile uint8_t pulse_det_pol; // Updated in interrupt
+    uint32_t npacketstarttick; // HAL tick of the first pulse of the current packet
+    uint32_t ndecodedstarttick; // HAL ticks of the first and last pulses of the decoded packet
+    uint32_t ndecodedendtick;
     uint16_t pulse_times[PACKET_PULSE_COUNT_MAX];
 } SubGHz_DecEnc_t;
 
+typedef struct
+{
+    uint32_t packets; // Pulse trains long enough to be passed to the decoders
+    uint32_t decoded;
+} SubGHz_Dec_Stats_t;
+
 typedef struct
 {
     uint32_t frequency;
@@ -88,14 +107,19 @@ enum {
 };
 
 extern SubGHz_DecEnc_t subghz_decenc_ctl;
+extern SubGHz_Dec_Stats_t subghz_dec_stats;
 extern const char *protocol_text[];
 extern const SubGHz_protocol_t subghz_protocols_list[];
 
 void subghz_decenc_init(void);
+void subghz_rssi_worker_start(void);
+void subghz_rssi_worker_stop(void);
 bool subghz_decenc_read(SubGHz_Dec_Info_t *received, bool raw);
 uint16_t get_diff(uint16_t n_a, uint16_t n_b);
-uint8_t subghz_decode_princeton(uint16_t p, uint16_t pulsecount);
-uint8_t subghz_decode_security_plus_20(uint16_t p, uint16_t pulsecount);
+void subghz_decode_princeton_reset(uint16_t p);
+uint8_t subghz_decode_princeton_feed(uint16_t p, uint16_t duration);
+void subghz_decode_security_plus_20_reset(uint16_t p);
+uint8_t subghz_decode_security_plus_20_feed(uint16_t p, uint16_t duration);
 uint8_t m1_secplus_v2_decode(uint32_t fixed[], uint8_t half_codes[][10], uint32_t *rolling_code, uint64_t *out_bits);
 uint8_t m1_secplus_v2_decode_half(uint64_t in_bits, uint8_t *half_code, uint32_t *out_bits);
 
@@ -0,0 +1,192 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  m1_sub_ghz_rawfile.c
+*
+*  M1 sub-ghz binary raw data format
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+#include <string.h>
+#include "m1_sub_ghz_rawfile.h"
+
+/*************************** D E F I N E S ************************************/
+
+//************************** C O N S T A N T **********************************/
+
+//************************** S T R U C T U R E S *******************************
+
+/***************************** V A R I A B L E S ******************************/
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+void subghz_rawfile_header_init(S_SubGHz_RawFile_Header_t *phdr, uint32_t frequency, uint8_t modulation, uint8_t fw_major, uint8_t fw_minor);
+bool subghz_rawfile_is_binary(const uint8_t *pbuffer, uint16_t size);
+uint8_t subghz_rawfile_header_check(const uint8_t *pbuffer, uint16_t size, S_SubGHz_RawFile_Header_t *phdr);
+uint16_t subghz_rawfile_encode(const uint16_t *psamples, uint16_t count, uint8_t *pdst);
+uint8_t subghz_rawfile_decode(const uint8_t **ppsrc, const uint8_t *pend, uint16_t *pdst, uint16_t max_samples, uint16_t *pcount);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+/*============================================================================*/
+/**
+  * @brief  Fills in the header of a binary raw data file
+  * @param  phdr header to fill in
+  * @param  frequency in Hz
+  * @param  modulation S_M1_SubGHz_Modulation
+  * @param  fw_major, fw_minor firmware version of the recorder
+  * @retval None
+  */
+/*============================================================================*/
+void subghz_rawfile_header_init(S_SubGHz_RawFile_Header_t *phdr, uint32_t frequency, uint8_t modulation, uint8_t fw_major, uint8_t fw_minor)
+{
+	memset(phdr, 0, sizeof(S_SubGHz_RawFile_Header_t));
+	memcpy(phdr->magic, SUBGHZ_RAWFILE_MAGIC, SUBGHZ_RAWFILE_MAGIC_LEN);
+	phdr->version = SUBGHZ_RAWFILE_VERSION;
+	phdr->header_size = sizeof(S_SubGHz_RawFile_Header_t);
+	phdr->modulation = modulation;
+	phdr->fw_version_major = fw_major;
+	phdr->fw_version_minor = fw_minor;
+	phdr->frequency = frequency;
+} // void subghz_rawfile_header_init(S_SubGHz_RawFile_Header_t *phdr, uint32_t frequency, uint8_t modulation, uint8_t fw_major, uint8_t fw_minor)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Checks whether the beginning of a raw data file is in binary format
+  * @param  pbuffer first bytes of the file
+  * @param  size number of bytes in the buffer
+  * @retval true if binary
+  */
+/*============================================================================*/
+bool subghz_rawfile_is_binary(const uint8_t *pbuffer, uint16_t size)
+{
+	if ( size < SUBGHZ_RAWFILE_MAGIC_LEN )
+		return false;
+
+	return (memcmp(pbuffer, SUBGHZ_RAWFILE_MAGIC, SUBGHZ_RAWFILE_MAGIC_LEN)==0);
+} // bool subghz_rawfile_is_binary(const uint8_t *pbuffer, uint16_t size)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Validates the header of a binary raw data file
+  * @param  pbuffer first bytes of the file
+  * @param  size number of bytes in the buffer
+  * @param  phdr copy of the header, if the header is valid
+  * @retval 0 if valid
+  */
+/*============================================================================*/
+uint8_t subghz_rawfile_header_check(const uint8_t *pbuffer, uint16_t size, S_SubGHz_RawFile_Header_t *phdr)
+{
+	if ( size < sizeof(S_SubGHz_RawFile_Header_t) )
+		return 1;
+	if ( !subghz_rawfile_is_binary(pbuffer, size) )
+		return 1;
+
+	memcpy(phdr, pbuffer, sizeof(S_SubGHz_RawFile_Header_t));
+	if ( phdr->version > SUBGHZ_RAWFILE_VERSION ) // Newer format is not supported
+		return 2;
+	// Later versions may only grow the header
+	if ( (phdr->header_size < sizeof(S_SubGHz_RawFile_Header_t)) || (phdr->header_size > size) )
+		return 3;
+
+	return 0;
+} // uint8_t subghz_rawfile_header_check(const uint8_t *pbuffer, uint16_t size, S_SubGHz_RawFile_Header_t *phdr)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Encodes samples to the binary sample stream
+  * @param  psamples pulse durations
+  * @param  count number of samples
+  * @param  pdst output, at least count*SUBGHZ_RAWFILE_SAMPLE_BYTES_MAX bytes
+  * @retval number of bytes written to pdst
+  */
+/*============================================================================*/
+uint16_t subghz_rawfile_encode(const uint16_t *psamples, uint16_t count, uint8_t *pdst)
+{
+	uint8_t *pstart;
+	uint16_t value;
+
+	pstart = pdst;
+	while ( count-- )
+	{
+		value = *psamples++;
+		while ( value >= 0x80 )
+		{
+			*pdst++ = (value & 0x7F) | 0x80;
+			value >>= 7;
+		}
+		*pdst++ = value;
+	} // while ( count-- )
+
+	return (pdst - pstart);
+} // uint16_t subghz_rawfile_encode(const uint16_t *psamples, uint16_t count, uint8_t *pdst)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Decodes samples from the binary sample stream.
+  *         Decoding stops before a sample split at the end of the input,
+  *         so the remaining bytes can be carried over to the next block.
+  *         A sample longer than SUBGHZ_RAWFILE_SAMPLE_BYTES_MAX bytes or
+  *         out of the 16-bit range ends decoding with an error.
+  * @param  ppsrc input pointer, updated to the first byte not decoded
+  * @param  pend end of the input
+  * @param  pdst output samples
+  * @param  max_samples size of the output
+  * @param  pcount number of samples decoded
+  * @retval 0 if no error, 1 if the stream is corrupt
+  */
+/*============================================================================*/
+uint8_t subghz_rawfile_decode(const uint8_t **ppsrc, const uint8_t *pend, uint16_t *pdst, uint16_t max_samples, uint16_t *pcount)
+{
+	const uint8_t *psrc, *pnext, *plast;
+	uint32_t value;
+	uint16_t count;
+	uint8_t shift, error;
+
+	psrc = *ppsrc;
+	count = 0;
+	error = 0;
+	while ( (count < max_samples) && (psrc < pend) )
+	{
+		if ( !(*psrc & 0x80) ) // Single byte sample
+		{
+			pdst[count++] = *psrc++;
+			continue;
+		}
+		pnext = psrc;
+		plast = psrc + SUBGHZ_RAWFILE_SAMPLE_BYTES_MAX - 1; // Last byte a sample may take
+		value = 0;
+		shift = 0;
+		while ( (pnext < pend) && (pnext < plast) && (*pnext & 0x80) )
+		{
+			value |= (uint32_t)(*pnext++ & 0x7F) << shift;
+			shift += 7;
+		}
+		if ( pnext >= pend ) // Sample split at the end of the input
+			break;
+		value |= (uint32_t)*pnext++ << shift;
+		if ( value > UINT16_MAX ) // Too many bytes or out of range
+		{
+			error = 1;
+			break;
+		}
+		pdst[count++] = value;
+		psrc = pnext;
+	} // while ( (count < max_samples) && (psrc < pend) )
+	*ppsrc = psrc;
+	*pcount = count;
+
+	return error;
+} // uint8_t subghz_rawfile_decode(const uint8_t **ppsrc, const uint8_t *pend, uint16_t *pdst, uint16_t max_samples, uint16_t *pcount)
@@ -0,0 +1,48 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  m1_sub_ghz_rawfile.h
+*
+*  M1 sub-ghz binary raw data format
+*
+* M1 Project
+*
+*/
+#ifndef _M1_SUB_GHZ_RAWFILE_H
+#define _M1_SUB_GHZ_RAWFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Binary raw data file
+ * | header (S_SubGHz_RawFile_Header_t) | sample stream |
+ * Each sample is a pulse duration in uS, alternating mark and space, starting with a mark.
+ * Samples are stored as unsigned LEB128 varints: 7 bits per byte, LSB first,
+ * bit 7 set on every byte except the last one.
+ */
+#define SUBGHZ_RAWFILE_MAGIC				"SGHB"
+#define SUBGHZ_RAWFILE_MAGIC_LEN			4
+#define SUBGHZ_RAWFILE_VERSION				1
+#define SUBGHZ_RAWFILE_SAMPLE_BYTES_MAX		3 // Varint size of a 16-bit sample
+
+typedef struct __attribute__((packed))
+{
+	char magic[SUBGHZ_RAWFILE_MAGIC_LEN];
+	uint8_t version;
+	uint8_t header_size; // Sample stream starts at this offset
+	uint8_t modulation; // S_M1_SubGHz_Modulation
+	uint8_t fw_version_major;
+	uint8_t fw_version_minor;
+	uint8_t reserved[3];
+	uint32_t frequency; // Hz, little endian
+} S_SubGHz_RawFile_Header_t;
+
+void subghz_rawfile_header_init(S_SubGHz_RawFile_Header_t *phdr, uint32_t frequency, uint8_t modulation, uint8_t fw_major, uint8_t fw_minor);
+bool subghz_rawfile_is_binary(const uint8_t *pbuffer, uint16_t size);
+uint8_t subghz_rawfile_header_check(const uint8_t *pbuffer, uint16_t size, S_SubGHz_RawFile_Header_t *phdr);
+uint16_t subghz_rawfile_encode(const uint16_t *psamples, uint16_t count, uint8_t *pdst);
+uint8_t subghz_rawfile_decode(const uint8_t **ppsrc, const uint8_t *pend, uint16_t *pdst, uint16_t max_samples, uint16_t *pcount);
+
+#endif // #ifndef _M1_SUB_GHZ_RAWFILE_H
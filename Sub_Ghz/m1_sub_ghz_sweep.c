@@ -0,0 +1,524 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  m1_sub_ghz_sweep.c
+*
+*  M1 sub-ghz multi-channel RSSI sweep
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+#include <string.h>
+#include "stm32h5xx_hal.h"
+#include "m1_sub_ghz_api.h"
+#include "m1_sub_ghz_sweep.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define SUBGHZ_SWEEP_BAND_NONE			0xFF
+#define SUBGHZ_SWEEP_FRR_COUNT			2 // FRR A: latched RSSI, FRR B: current state
+#define SUBGHZ_SWEEP_STATE_MASK			0x0F
+#define SUBGHZ_SWEEP_SET_PROPERTY_MAX	12 // Properties per SET_PROPERTY command
+#define SUBGHZ_SWEEP_PROP_GAP_MAX		4 // Common properties sent to merge two SET_PROPERTY commands
+
+//************************** C O N S T A N T **********************************/
+
+//************************** S T R U C T U R E S *******************************
+
+typedef struct
+{
+	uint8_t band; // S_M1_SubGHz_Band
+	uint8_t channels;
+	uint8_t rssi_control; // MODEM_RSSI_CONTROL with the latch enabled
+	uint8_t prop_values[SUBGHZ_SWEEP_PROP_MAX]; // Values of the properties in subghz_sweep_prop_ids
+	uint8_t prop_defined[SUBGHZ_SWEEP_PROP_MAX/8]; // Bit set if the band configuration sets the property
+} S_SubGHz_Sweep_Band_Inf_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+static S_SubGHz_Sweep_Band_Inf_t subghz_sweep_bands[SUB_GHZ_BAND_EOL];
+static uint8_t subghz_sweep_n_bands = 0;
+static uint16_t subghz_sweep_prop_ids[SUBGHZ_SWEEP_PROP_MAX]; // group << 8 | property, sorted
+static uint8_t subghz_sweep_n_props;
+static uint8_t subghz_sweep_loaded_band = SUBGHZ_SWEEP_BAND_NONE; // Index in subghz_sweep_bands
+static S_SubGHz_Sweep_Stats_t subghz_sweep_stats;
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+uint8_t subghz_sweep_init(const S_SubGHz_Sweep_Band_t *pbands, uint8_t n_bands);
+uint8_t subghz_sweep_run(S_SubGHz_Sweep_Frame_t *pframe);
+void subghz_sweep_get_stats(S_SubGHz_Sweep_Stats_t *pstats);
+int16_t subghz_sweep_rssi_to_dbm(uint8_t rssi_raw);
+static bool subghz_sweep_find_prop(const uint8_t *pconfig, uint16_t prop_id, uint8_t *pvalue);
+static uint8_t subghz_sweep_compare_cmds(const uint8_t *pbase, const uint8_t *pconfig);
+static uint8_t subghz_sweep_add_props(uint8_t index);
+static uint8_t subghz_sweep_fill_prop_gaps(void);
+static uint8_t subghz_sweep_get_rssi_control(const uint8_t *pconfig);
+static void subghz_sweep_load_props(const S_SubGHz_Sweep_Band_Inf_t *pband);
+static void subghz_sweep_load_cmds(const uint8_t *pconfig);
+static void subghz_sweep_load_band(uint8_t index);
+static int16_t subghz_sweep_measure(uint8_t channel);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+/*============================================================================*/
+/**
+  * @brief  Finds the value a configuration array sets to a property
+  * @param  pconfig configuration array
+  * @param  prop_id group << 8 | property
+  * @param  pvalue property value, if found
+  * @retval true if found
+  */
+/*============================================================================*/
+static bool subghz_sweep_find_prop(const uint8_t *pconfig, uint16_t prop_id, uint8_t *pvalue)
+{
+	uint8_t group, prop;
+	bool found;
+
+	group = prop_id >> 8;
+	prop = prop_id & 0xFF;
+	found = false;
+	while ( *pconfig )
+	{
+		// LEN | SET_PROPERTY | group | count | start | values
+		if ( (pconfig[1]==SI446X_CMD_ID_SET_PROPERTY) && (pconfig[2]==group)
+				&& (pconfig[4] <= prop) && (prop < pconfig[4] + pconfig[3]) )
+		{
+			*pvalue = pconfig[5 + prop - pconfig[4]];
+			found = true; // Keep looking, a later command would overwrite it
+		}
+		pconfig += *pconfig + 1;
+	} // while ( *pconfig )
+
+	return found;
+} // static bool subghz_sweep_find_prop(const uint8_t *pconfig, uint16_t prop_id, uint8_t *pvalue)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Compares the commands other than SET_PROPERTY of two configuration arrays
+  * @param  pbase configuration of the loaded band
+  * @param  pconfig configuration to compare
+  * @retval 0 if they are the same
+  */
+/*============================================================================*/
+static uint8_t subghz_sweep_compare_cmds(const uint8_t *pbase, const uint8_t *pconfig)
+{
+	while ( true )
+	{
+		while ( *pbase && (pbase[1]==SI446X_CMD_ID_SET_PROPERTY) )
+			pbase += *pbase + 1;
+		while ( *pconfig && (pconfig[1]==SI446X_CMD_ID_SET_PROPERTY) )
+			pconfig += *pconfig + 1;
+		if ( !*pbase || !*pconfig )
+			break;
+		if ( (*pbase != *pconfig) || memcmp(&pbase[1], &pconfig[1], *pbase) )
+			return 1;
+		pbase += *pbase + 1;
+		pconfig += *pconfig + 1;
+	} // while ( true )
+
+	return (*pbase || *pconfig);
+} // static uint8_t subghz_sweep_compare_cmds(const uint8_t *pbase, const uint8_t *pconfig)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Adds the properties of a band which are not the same in all bands
+  *         of the sweep to the property list
+  * @param  index band index in the sweep
+  * @retval 0 if OK, 1 if the list is full
+  */
+/*============================================================================*/
+static uint8_t subghz_sweep_add_props(uint8_t index)
+{
+	const uint8_t *pconfig;
+	uint16_t prop_id;
+	uint8_t i, j, k, value, other_value;
+	bool varies;
+
+	pconfig = RadioConfigList[subghz_sweep_bands[index].band]->Radio_ConfigurationArray;
+	while ( *pconfig )
+	{
+		if ( pconfig[1] != SI446X_CMD_ID_SET_PROPERTY )
+		{
+			pconfig += *pconfig + 1;
+			continue;
+		}
+		for (i=0; i<pconfig[3]; i++)
+		{
+			prop_id = ((uint16_t)pconfig[2] << 8) | (uint8_t)(pconfig[4] + i);
+			for (j=0; j<subghz_sweep_n_props; j++)
+			{
+				if ( subghz_sweep_prop_ids[j] >= prop_id )
+					break;
+			}
+			if ( (j < subghz_sweep_n_props) && (subghz_sweep_prop_ids[j]==prop_id) ) // Already listed
+				continue;
+
+			subghz_sweep_find_prop(pconfig, prop_id, &value); // Last value set from here on
+			varies = false;
+			for (k=0; k<subghz_sweep_n_bands; k++)
+			{
+				if ( !subghz_sweep_find_prop(RadioConfigList[subghz_sweep_bands[k].band]->Radio_ConfigurationArray, prop_id, &other_value)
+						|| (other_value != value) )
+				{
+					varies = true;
+					break;
+				}
+			} // for (k=0; k<subghz_sweep_n_bands; k++)
+			if ( !varies )
+				continue;
+
+			if ( subghz_sweep_n_props >= SUBGHZ_SWEEP_PROP_MAX )
+				return 1;
+			// Keep the list sorted
+			memmove(&subghz_sweep_prop_ids[j + 1], &subghz_sweep_prop_ids[j], (subghz_sweep_n_props - j)*sizeof(uint16_t));
+			subghz_sweep_prop_ids[j] = prop_id;
+			subghz_sweep_n_props++;
+		} // for (i=0; i<pconfig[3]; i++)
+		pconfig += *pconfig + 1;
+	} // while ( *pconfig )
+
+	return 0;
+} // static uint8_t subghz_sweep_add_props(uint8_t index)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Adds the properties found in short gaps of the property list.
+  *         They have the same value in all bands, and sending them costs less
+  *         than one more SET_PROPERTY command.
+  * @param  None
+  * @retval 0 if OK, 1 if the list is full
+  */
+/*============================================================================*/
+static uint8_t subghz_sweep_fill_prop_gaps(void)
+{
+	const uint8_t *pconfig;
+	uint16_t gap;
+	uint8_t i, k, value;
+
+	pconfig = RadioConfigList[subghz_sweep_bands[0].band]->Radio_ConfigurationArray;
+	for (i=0; i+1<subghz_sweep_n_props; i++)
+	{
+		gap = subghz_sweep_prop_ids[i + 1] - subghz_sweep_prop_ids[i] - 1;
+		if ( !gap || (gap > SUBGHZ_SWEEP_PROP_GAP_MAX) || ((subghz_sweep_prop_ids[i] >> 8) != (subghz_sweep_prop_ids[i + 1] >> 8)) )
+			continue;
+		for (k=1; k<=gap; k++)
+		{
+			if ( !subghz_sweep_find_prop(pconfig, subghz_sweep_prop_ids[i] + k, &value) )
+				break;
+		}
+		if ( k <= gap ) // Not set by the configurations
+			continue;
+		if ( subghz_sweep_n_props + gap > SUBGHZ_SWEEP_PROP_MAX )
+			return 1;
+		memmove(&subghz_sweep_prop_ids[i + 1 + gap], &subghz_sweep_prop_ids[i + 1], (subghz_sweep_n_props - i - 1)*sizeof(uint16_t));
+		for (k=1; k<=gap; k++)
+			subghz_sweep_prop_ids[i + k] = subghz_sweep_prop_ids[i] + k;
+		subghz_sweep_n_props += gap;
+		i += gap;
+	} // for (i=0; i+1<subghz_sweep_n_props; i++)
+
+	return 0;
+} // static uint8_t subghz_sweep_fill_prop_gaps(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Finds MODEM_RSSI_CONTROL in a configuration array and enables the
+  *         RSSI latch in it
+  * @param  pconfig configuration array
+  * @retval property value
+  */
+/*============================================================================*/
+static uint8_t subghz_sweep_get_rssi_control(const uint8_t *pconfig)
+{
+	uint8_t value;
+
+	if ( !subghz_sweep_find_prop(pconfig, ((uint16_t)SI446X_GRP_ID_0x20 << 8) | SI446X_GRP_ID_0x20_MODEM_RSSI_CONTROL, &value) )
+		value = 0x00; // Default
+
+	return (value & ~SI446X_RSSI_CONTROL_LATCH_MASK) | SI446X_RSSI_CONTROL_LATCH_RX_STATE1;
+} // static uint8_t subghz_sweep_get_rssi_control(const uint8_t *pconfig)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Prepares a sweep over a list of bands and loads the first band.
+  *         The radio is left in RX mode.
+  * @param  pbands bands to scan
+  * @param  n_bands number of bands
+  * @retval 0 if OK
+  */
+/*============================================================================*/
+uint8_t subghz_sweep_init(const S_SubGHz_Sweep_Band_t *pbands, uint8_t n_bands)
+{
+	S_SubGHz_Sweep_Band_Inf_t *pband;
+	const uint8_t *pconfig;
+	uint16_t channels;
+	uint8_t i, j;
+
+	subghz_sweep_n_bands = 0;
+	subghz_sweep_n_props = 0;
+	subghz_sweep_loaded_band = SUBGHZ_SWEEP_BAND_NONE;
+	memset(&subghz_sweep_stats, 0, sizeof(subghz_sweep_stats));
+
+	channels = 0;
+	for (i=0; i<n_bands; i++)
+	{
+		if ( !pbands[i].channels ) // Band disabled
+			continue;
+		if ( (pbands[i].band >= SUB_GHZ_BAND_EOL) || (subghz_sweep_n_bands >= SUB_GHZ_BAND_EOL) )
+			return 1;
+		channels += pbands[i].channels;
+		if ( channels > SUBGHZ_SWEEP_CHANNELS_MAX )
+			return 1;
+		subghz_sweep_bands[subghz_sweep_n_bands].band = pbands[i].band;
+		subghz_sweep_bands[subghz_sweep_n_bands].channels = pbands[i].channels;
+		subghz_sweep_n_bands++;
+	} // for (i=0; i<n_bands; i++)
+
+	if ( !subghz_sweep_n_bands )
+		return 1;
+
+	for (i=0; i<subghz_sweep_n_bands; i++)
+	{
+		if ( subghz_sweep_add_props(i) )
+			return 1;
+	}
+	if ( subghz_sweep_fill_prop_gaps() )
+		return 1;
+
+	for (i=0; i<subghz_sweep_n_bands; i++)
+	{
+		pband = &subghz_sweep_bands[i];
+		pconfig = RadioConfigList[pband->band]->Radio_ConfigurationArray;
+		pband->rssi_control = subghz_sweep_get_rssi_control(pconfig);
+		memset(pband->prop_defined, 0, sizeof(pband->prop_defined));
+		for (j=0; j<subghz_sweep_n_props; j++)
+		{
+			if ( subghz_sweep_find_prop(pconfig, subghz_sweep_prop_ids[j], &pband->prop_values[j]) )
+				pband->prop_defined[j/8] |= 1 << (j % 8);
+		}
+	} // for (i=0; i<subghz_sweep_n_bands; i++)
+
+	subghz_sweep_load_band(0);
+	radio_set_antenna_mode(RADIO_ANTENNA_MODE_RX);
+
+	return 0;
+} // uint8_t subghz_sweep_init(const S_SubGHz_Sweep_Band_t *pbands, uint8_t n_bands)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Queues the properties which differ between the bands of the sweep.
+  *         Consecutive properties are grouped into one SET_PROPERTY command.
+  *         Properties the band configuration does not set are left unchanged,
+  *         as loading the whole configuration would.
+  * @param  pband band to load
+  * @retval None
+  */
+/*============================================================================*/
+static void subghz_sweep_load_props(const S_SubGHz_Sweep_Band_Inf_t *pband)
+{
+	uint8_t i, start, count;
+
+	count = 0;
+	start = 0;
+	for (i=0; i<=subghz_sweep_n_props; i++)
+	{
+		if ( count )
+		{
+			// End of the run?
+			if ( (i==subghz_sweep_n_props) || (count==SUBGHZ_SWEEP_SET_PROPERTY_MAX)
+					|| !(pband->prop_defined[i/8] & (1 << (i % 8)))
+					|| (subghz_sweep_prop_ids[i] != subghz_sweep_prop_ids[start] + count) )
+			{
+				SI446x_Queue_Property(subghz_sweep_prop_ids[start] >> 8, count, subghz_sweep_prop_ids[start] & 0xFF, &pband->prop_values[start]);
+				count = 0;
+			}
+		} // if ( count )
+		if ( i==subghz_sweep_n_props )
+			break;
+		if ( !(pband->prop_defined[i/8] & (1 << (i % 8))) )
+			continue;
+		if ( !count )
+			start = i;
+		count++;
+	} // for (i=0; i<=subghz_sweep_n_props; i++)
+} // static void subghz_sweep_load_props(const S_SubGHz_Sweep_Band_Inf_t *pband)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Queues the commands other than SET_PROPERTY of a configuration array.
+  *         The arrays generated by WDS only have GPIO_PIN_CFG, which can be
+  *         sent again at any time.
+  * @param  pconfig configuration array
+  * @retval None
+  */
+/*============================================================================*/
+static void subghz_sweep_load_cmds(const uint8_t *pconfig)
+{
+	while ( *pconfig )
+	{
+		if ( pconfig[1] != SI446X_CMD_ID_SET_PROPERTY )
+			SI446x_Queue_Cmd(*pconfig, &pconfig[1]);
+		pconfig += *pconfig + 1;
+	} // while ( *pconfig )
+} // static void subghz_sweep_load_cmds(const uint8_t *pconfig)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Loads the configuration of a band of the sweep
+  * @param  index band index in the sweep
+  * @retval None
+  */
+/*============================================================================*/
+static void subghz_sweep_load_band(uint8_t index)
+{
+	S_SubGHz_Sweep_Band_Inf_t *pband;
+	const uint8_t *pconfig;
+	uint8_t frr_modes[SUBGHZ_SWEEP_FRR_COUNT];
+
+	pband = &subghz_sweep_bands[index];
+	pconfig = RadioConfigList[pband->band]->Radio_ConfigurationArray;
+	if ( (subghz_sweep_loaded_band==SUBGHZ_SWEEP_BAND_NONE) || SI446x_Get_Reset_Stat() )
+	{
+		radio_init_rx_tx(pband->band, (pband->band==SUB_GHZ_BAND_915)?MODEM_MOD_TYPE_FSK:MODEM_MOD_TYPE_OOK, SI446x_Get_Reset_Stat());
+		frr_modes[0] = SI446X_FRR_MODE_LATCHED_RSSI;
+		frr_modes[1] = SI446X_FRR_MODE_CURRENT_STATE;
+		SI446x_Set_Property(SI446X_GRP_ID_0x02, SUBGHZ_SWEEP_FRR_COUNT, SI446X_GRP_ID_0x02_FRR_CTL_A_MODE, frr_modes);
+		subghz_sweep_stats.full_reloads++;
+	}
+	else
+	{
+		if ( subghz_sweep_compare_cmds(RadioConfigList[subghz_sweep_bands[subghz_sweep_loaded_band].band]->Radio_ConfigurationArray, pconfig) )
+			subghz_sweep_load_cmds(pconfig);
+		subghz_sweep_load_props(pband);
+	}
+	// The configuration has disabled the latch again
+	SI446x_Set_Property(SI446X_GRP_ID_0x20, 1, SI446X_GRP_ID_0x20_MODEM_RSSI_CONTROL, &pband->rssi_control);
+	// The queued commands are sent while the frontend is switched, the next command waits for them
+	SI446x_Queue_Flush();
+	SI446x_Select_Frontend(pband->band);
+
+	subghz_sweep_loaded_band = index;
+	subghz_sweep_stats.band_changes++;
+} // static void subghz_sweep_load_band(uint8_t index)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Tunes to a channel and waits for its RSSI to be latched
+  * @param  channel channel of the loaded band
+  * @retval RSSI in dBm, SUBGHZ_SWEEP_RSSI_INVALID if it was not latched in time
+  */
+/*============================================================================*/
+static int16_t subghz_sweep_measure(uint8_t channel)
+{
+	uint8_t frr[SUBGHZ_SWEEP_FRR_COUNT];
+	uint16_t polls;
+
+	Radio_Start_Rx(channel, 0, RADIO_XX_CONFIGURATION_DATA_RADIO_PACKET_LENGTH,
+			SI446X_CMD_CHANGE_STATE_ARG_NEXT_STATE1_NEW_STATE_ENUM_NOCHANGE,
+			SI446X_CMD_CHANGE_STATE_ARG_NEXT_STATE1_NEW_STATE_ENUM_RX,
+			SI446X_CMD_CHANGE_STATE_ARG_NEXT_STATE1_NEW_STATE_ENUM_RX);
+	// The latched RSSI is cleared once the command has been accepted
+	SI446x_Poll_CTS();
+
+	for (polls=0; polls<SUBGHZ_SWEEP_LATCH_POLL_MAX; polls++)
+	{
+		SI446x_Frr_Read(SUBGHZ_SWEEP_FRR_COUNT, frr);
+		if ( frr[0] && ((frr[1] & SUBGHZ_SWEEP_STATE_MASK)==SI446X_CMD_REQUEST_DEVICE_STATE_REP_CURR_STATE_MAIN_STATE_ENUM_RX) )
+			return subghz_sweep_rssi_to_dbm(frr[0]);
+	} // for (polls=0; polls<SUBGHZ_SWEEP_LATCH_POLL_MAX; polls++)
+
+	subghz_sweep_stats.latch_timeouts++;
+
+	return SUBGHZ_SWEEP_RSSI_INVALID;
+} // static int16_t subghz_sweep_measure(uint8_t channel)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Measures all channels of all bands of the sweep
+  * @param  pframe spectrum frame, channels in the order of the band list
+  * @retval 0 if OK
+  */
+/*============================================================================*/
+uint8_t subghz_sweep_run(S_SubGHz_Sweep_Frame_t *pframe)
+{
+	uint32_t t_start;
+	uint16_t n;
+	uint8_t i, ch;
+
+	if ( !subghz_sweep_n_bands )
+		return 1;
+
+	t_start = HAL_GetTick();
+	n = 0;
+	for (i=0; i<subghz_sweep_n_bands; i++)
+	{
+		if ( subghz_sweep_loaded_band != i )
+			subghz_sweep_load_band(i);
+		for (ch=0; ch<subghz_sweep_bands[i].channels; ch++)
+			pframe->rssi[n++] = subghz_sweep_measure(ch);
+	} // for (i=0; i<subghz_sweep_n_bands; i++)
+	// Read INTs, clear pending ones
+	SI446x_Get_IntStatus(0, 0, 0);
+
+	pframe->channels = n;
+	pframe->duration = HAL_GetTick() - t_start;
+	pframe->sequence = subghz_sweep_stats.frames++;
+	subghz_sweep_stats.channels += n;
+	if ( pframe->duration > subghz_sweep_stats.duration_max )
+		subghz_sweep_stats.duration_max = pframe->duration;
+
+	return 0;
+} // uint8_t subghz_sweep_run(S_SubGHz_Sweep_Frame_t *pframe)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Returns the sweep statistics since the last init
+  * @param  pstats statistics
+  * @retval None
+  */
+/*============================================================================*/
+void subghz_sweep_get_stats(S_SubGHz_Sweep_Stats_t *pstats)
+{
+	memcpy(pstats, &subghz_sweep_stats, sizeof(S_SubGHz_Sweep_Stats_t));
+} // void subghz_sweep_get_stats(S_SubGHz_Sweep_Stats_t *pstats)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Converts a raw RSSI value to dBm
+  * @param  rssi_raw value reported by the radio
+  * @retval dBm
+  */
+/*============================================================================*/
+int16_t subghz_sweep_rssi_to_dbm(uint8_t rssi_raw)
+{
+	// RF_Input_Level_dBm = (RSSI_value / 2) – MODEM_RSSI_COMP – 70
+	return (int16_t)(rssi_raw/2) - MODEM_RSSI_COMP - 70;
+} // int16_t subghz_sweep_rssi_to_dbm(uint8_t rssi_raw)
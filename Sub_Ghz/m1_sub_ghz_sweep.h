@@ -0,0 +1,65 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  m1_sub_ghz_sweep.h
+*
+*  M1 sub-ghz multi-channel RSSI sweep
+*
+* M1 Project
+*
+*/
+#ifndef _M1_SUB_GHZ_SWEEP_H
+#define _M1_SUB_GHZ_SWEEP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Measures the RSSI of every channel of a list of bands and returns one
+ * spectrum frame per sweep.
+ * - The band configurations generated by WDS only differ in some properties
+ *   (synthesizer, channel step, IF and filter settings). These properties are
+ *   found once at init, and a band change only sets them instead of loading
+ *   the whole configuration.
+ * - The radio latches the RSSI once it has settled on a new channel and
+ *   reports it in the Fast Response Register A, which is polled with single
+ *   SPI transactions instead of waiting for CTS on GET_MODEM_STATUS.
+ * - The START_RX of the next channel is sent as soon as the RSSI is latched,
+ *   without clearing the interrupts first.
+ */
+#define SUBGHZ_SWEEP_CHANNELS_MAX		128
+#define SUBGHZ_SWEEP_PROP_MAX			160 // Properties which differ between the bands of a sweep
+#define SUBGHZ_SWEEP_LATCH_POLL_MAX		400 // FRR reads before giving up on the RSSI latch of a channel
+#define SUBGHZ_SWEEP_RSSI_INVALID		-255
+
+typedef struct
+{
+	uint8_t band; // S_M1_SubGHz_Band
+	uint8_t channels; // Number of channels to scan, from channel 0
+} S_SubGHz_Sweep_Band_t;
+
+typedef struct
+{
+	int16_t rssi[SUBGHZ_SWEEP_CHANNELS_MAX]; // dBm, channels of all bands in the order of the band list
+	uint16_t channels;
+	uint32_t sequence;
+	uint32_t duration; // ms
+} S_SubGHz_Sweep_Frame_t;
+
+typedef struct
+{
+	uint32_t frames;
+	uint32_t channels;
+	uint32_t band_changes;
+	uint32_t full_reloads; // Band changes which loaded the whole configuration
+	uint32_t latch_timeouts;
+	uint32_t duration_max; // ms
+} S_SubGHz_Sweep_Stats_t;
+
+uint8_t subghz_sweep_init(const S_SubGHz_Sweep_Band_t *pbands, uint8_t n_bands);
+uint8_t subghz_sweep_run(S_SubGHz_Sweep_Frame_t *pframe);
+void subghz_sweep_get_stats(S_SubGHz_Sweep_Stats_t *pstats);
+int16_t subghz_sweep_rssi_to_dbm(uint8_t rssi_raw);
+
+#endif // #ifndef _M1_SUB_GHZ_SWEEP_H
@@ -0,0 +1,152 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  m1_sub_ghz_timing.c
+*
+*  M1 sub-ghz pulse timing estimation
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+#include "m1_sub_ghz_timing.h"
+
+/*************************** D E F I N E S ************************************/
+
+//************************** C O N S T A N T **********************************/
+
+//************************** S T R U C T U R E S *******************************
+
+/***************************** V A R I A B L E S ******************************/
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+void subghz_timing_seed(S_SubGHz_Timing_t *ptiming, uint16_t te_short, uint16_t te_long);
+uint8_t subghz_timing_estimate(S_SubGHz_Timing_t *ptiming, const uint16_t *pulses, uint8_t count);
+bool subghz_timing_check_ratio(const S_SubGHz_Timing_t *ptiming, uint16_t te_short, uint16_t te_long, uint8_t tolerance);
+uint8_t subghz_timing_classify(S_SubGHz_Timing_t *ptiming, uint16_t duration, uint8_t tolerance);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+/*============================================================================*/
+/**
+  * @brief  Starts the estimate from known symbol widths
+  * @param  ptiming estimator
+  * @param  te_short, te_long nominal widths in uS
+  * @retval None
+  */
+/*============================================================================*/
+void subghz_timing_seed(S_SubGHz_Timing_t *ptiming, uint16_t te_short, uint16_t te_long)
+{
+	ptiming->te[SUBGHZ_TE_SHORT] = te_short;
+	ptiming->te[SUBGHZ_TE_LONG] = te_long;
+} // void subghz_timing_seed(S_SubGHz_Timing_t *ptiming, uint16_t te_short, uint16_t te_long)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Estimates the symbol widths by 2-means clustering of a block of pulses.
+  *         The centers start at the shortest and longest pulses, then each
+  *         round splits the pulses at the midpoint and moves every center
+  *         to the mean of its pulses.
+  * @param  ptiming estimator
+  * @param  pulses pulse durations in uS
+  * @param  count number of pulses
+  * @retval 0 if two clusters were found
+  */
+/*============================================================================*/
+uint8_t subghz_timing_estimate(S_SubGHz_Timing_t *ptiming, const uint16_t *pulses, uint8_t count)
+{
+	uint32_t sum[2], n[2], threshold;
+	uint16_t te_short, te_long;
+	uint8_t i, round, c;
+
+	if ( count < 2 )
+		return 1;
+
+	te_short = UINT16_MAX;
+	te_long = 0;
+	for (i=0; i<count; i++)
+	{
+		if ( pulses[i] < te_short )
+			te_short = pulses[i];
+		if ( pulses[i] > te_long )
+			te_long = pulses[i];
+	} // for (i=0; i<count; i++)
+	if ( te_short==te_long ) // Single cluster
+		return 1;
+
+	for (round=0; round<SUBGHZ_TIMING_KMEANS_ROUNDS; round++)
+	{
+		threshold = ((uint32_t)te_short + te_long)/2;
+		sum[0] = sum[1] = 0;
+		n[0] = n[1] = 0;
+		for (i=0; i<count; i++)
+		{
+			c = (pulses[i] > threshold)?SUBGHZ_TE_LONG:SUBGHZ_TE_SHORT;
+			sum[c] += pulses[i];
+			n[c]++;
+		} // for (i=0; i<count; i++)
+		if ( !n[SUBGHZ_TE_SHORT] || !n[SUBGHZ_TE_LONG] )
+			return 1;
+		if ( (te_short==sum[SUBGHZ_TE_SHORT]/n[SUBGHZ_TE_SHORT]) && (te_long==sum[SUBGHZ_TE_LONG]/n[SUBGHZ_TE_LONG]) )
+			break; // Converged
+		te_short = sum[SUBGHZ_TE_SHORT]/n[SUBGHZ_TE_SHORT];
+		te_long = sum[SUBGHZ_TE_LONG]/n[SUBGHZ_TE_LONG];
+	} // for (round=0; round<SUBGHZ_TIMING_KMEANS_ROUNDS; round++)
+
+	subghz_timing_seed(ptiming, te_short, te_long);
+
+	return 0;
+} // uint8_t subghz_timing_estimate(S_SubGHz_Timing_t *ptiming, const uint16_t *pulses, uint8_t count)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Checks that the estimated widths have the ratio of a protocol
+  * @param  ptiming estimator
+  * @param  te_short, te_long nominal widths of the protocol in uS
+  * @param  tolerance percentage
+  * @retval true if the ratio matches
+  */
+/*============================================================================*/
+bool subghz_timing_check_ratio(const S_SubGHz_Timing_t *ptiming, uint16_t te_short, uint16_t te_long, uint8_t tolerance)
+{
+	uint32_t expected_long, diff;
+
+	expected_long = ((uint32_t)ptiming->te[SUBGHZ_TE_SHORT]*te_long)/te_short;
+	diff = (ptiming->te[SUBGHZ_TE_LONG] > expected_long)?(ptiming->te[SUBGHZ_TE_LONG] - expected_long):(expected_long - ptiming->te[SUBGHZ_TE_LONG]);
+
+	return (diff <= (expected_long*tolerance)/100);
+} // bool subghz_timing_check_ratio(const S_SubGHz_Timing_t *ptiming, uint16_t te_short, uint16_t te_long, uint8_t tolerance)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Classifies a pulse against the nearest cluster center and, if it
+  *         matches, moves the center towards it.
+  * @param  ptiming estimator
+  * @param  duration pulse duration in uS
+  * @param  tolerance percentage of the cluster center
+  * @retval SUBGHZ_TE_SHORT, SUBGHZ_TE_LONG or SUBGHZ_TE_INVALID
+  */
+/*============================================================================*/
+uint8_t subghz_timing_classify(S_SubGHz_Timing_t *ptiming, uint16_t duration, uint8_t tolerance)
+{
+	int32_t error;
+	uint8_t c;
+
+	c = ((uint32_t)duration*2 > (uint32_t)ptiming->te[SUBGHZ_TE_SHORT] + ptiming->te[SUBGHZ_TE_LONG])?SUBGHZ_TE_LONG:SUBGHZ_TE_SHORT;
+	error = (int32_t)duration - ptiming->te[c];
+	if ( (uint32_t)((error < 0)?-error:error)*100 >= (uint32_t)ptiming->te[c]*tolerance )
+		return SUBGHZ_TE_INVALID;
+
+	ptiming->te[c] += error/(1 << SUBGHZ_TIMING_TRACK_SHIFT);
+
+	return c;
+} // uint8_t subghz_timing_classify(S_SubGHz_Timing_t *ptiming, uint16_t duration, uint8_t tolerance)
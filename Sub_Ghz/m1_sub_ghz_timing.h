@@ -0,0 +1,45 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  m1_sub_ghz_timing.h
+*
+*  M1 sub-ghz pulse timing estimation
+*
+* M1 Project
+*
+*/
+#ifndef _M1_SUB_GHZ_TIMING_H
+#define _M1_SUB_GHZ_TIMING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Estimates the short and long symbol widths of the current packet.
+ * The estimate is either seeded with nominal widths or computed by 2-means
+ * clustering of the first pulses of a packet. It then follows the packet:
+ * every pulse that is accepted pulls its cluster center towards it, so a
+ * slowly drifting transmitter or a single jittery pulse does not break
+ * the decoding of the following pulses.
+ */
+#define SUBGHZ_TIMING_KMEANS_ROUNDS		4
+#define SUBGHZ_TIMING_TRACK_SHIFT		3 // Cluster centers move by 1/8 of the error of each pulse
+
+enum {
+	SUBGHZ_TE_SHORT = 0,
+	SUBGHZ_TE_LONG,
+	SUBGHZ_TE_INVALID
+};
+
+typedef struct
+{
+	uint16_t te[2]; // Cluster centers in uS, SUBGHZ_TE_SHORT and SUBGHZ_TE_LONG
+} S_SubGHz_Timing_t;
+
+void subghz_timing_seed(S_SubGHz_Timing_t *ptiming, uint16_t te_short, uint16_t te_long);
+uint8_t subghz_timing_estimate(S_SubGHz_Timing_t *ptiming, const uint16_t *pulses, uint8_t count);
+bool subghz_timing_check_ratio(const S_SubGHz_Timing_t *ptiming, uint16_t te_short, uint16_t te_long, uint8_t tolerance);
+uint8_t subghz_timing_classify(S_SubGHz_Timing_t *ptiming, uint16_t duration, uint8_t tolerance);
+
+#endif // #ifndef _M1_SUB_GHZ_TIMING_H
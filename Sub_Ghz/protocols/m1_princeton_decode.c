@@ -16,12 +16,15 @@
 #include "stm32h5xx_hal.h"
 #include "bit_util.h"
 #include "m1_sub_ghz_decenc.h"
+#include "m1_sub_ghz_timing.h"
 #include "m1_log_debug.h"
 
 /*************************** D E F I N E S ************************************/
 
 #define M1_LOGDB_TAG	"SUBGHZ_PRINCETON"
 
+#define PRINCETON_HEAD_PULSES	8 // First pulses buffered to estimate the bit timing
+
 
 
 //************************** C O N S T A N T **********************************/
@@ -30,120 +33,118 @@
 
 //************************** S T R U C T U R E S *******************************
 
+typedef struct
+{
+    uint16_t head[PRINCETON_HEAD_PULSES]; // First pulses, buffered until the bit timing is known
+    S_SubGHz_Timing_t timing;
+    uint16_t index;
+    uint32_t code;
+    uint8_t pre_bit_one;
+    uint8_t bits_count;
+} S_Princeton_Decoder_t;
+
 /***************************** V A R I A B L E S ******************************/
 
+static S_Princeton_Decoder_t princeton_dec;
 
 /********************* F U N C T I O N   P R O T O T Y P E S ******************/
 
-uint8_t subghz_decode_princeton(uint16_t p, uint16_t pulsecount);
+void subghz_decode_princeton_reset(uint16_t p);
+uint8_t subghz_decode_princeton_feed(uint16_t p, uint16_t duration);
+static uint8_t subghz_decode_princeton_pulse(uint16_t p, uint16_t duration, uint16_t index);
 
 /*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
 
 /*============================================================================*/
 /**
-  * @brief
-  * @param  None
+  * @brief  Prepares the decoder for a new packet
+  * @param  p protocol index
   * @retval None
   */
 /*============================================================================*/
-uint8_t subghz_decode_princeton(uint16_t p, uint16_t pulsecount)
+void subghz_decode_princeton_reset(uint16_t p)
 {
-    uint32_t code;
-    uint16_t te_long, te_short, tolerance_long, tolerance_short;
-    uint16_t i;
-    uint8_t tolerance, odd_bit, pre_bit_one, bits_count, max_bits;
-
-    tolerance = subghz_protocols_list[p].te_tolerance;
-    max_bits = subghz_protocols_list[p].data_bits;
-    //te_short = subghz_protocols_list[p].te_short;
-    //te_long = subghz_protocols_list[p].te_long;
-    te_short = subghz_decenc_ctl.pulse_times[2];
-    te_long = subghz_decenc_ctl.pulse_times[3];
-    if ( te_long < te_short )
-    {
-    	tolerance_long = te_short;
-    	te_short = te_long;
-    	te_long = tolerance_long; // Swap bits
-    } // if ( te_long < te_short )
-    tolerance_short = te_short*3; // Assuming this is a valid long bit
-    tolerance_long = (tolerance_short*tolerance)/100;
-    if ( get_diff(te_long, tolerance_short) > tolerance_long ) // Not a valid bit for this protocol?
-    {
-    	return 1;
-    }
-
-    tolerance_short = (te_short*tolerance)/100;
-    tolerance_long = (te_long*tolerance)/100;
-    code = 0;
-    odd_bit = 0;
-    pre_bit_one = 0;
-    bits_count = 0;
-
-    for (i = 0; i<pulsecount; i++)
-    {
-    	if ( !odd_bit )
-    	{
-    		if ( get_diff(subghz_decenc_ctl.pulse_times[i], te_short) < tolerance_short )
-    		{
-    			pre_bit_one = 0;
-    		}
-    		else if ( get_diff(subghz_decenc_ctl.pulse_times[i], te_long) < tolerance_long )
-    		{
-    			pre_bit_one = 1;
-    		}
-    		else
-    		{
-    			break;
-    		}
-    		if ( i >= 2*max_bits )
-    			break;
-    	} // if ( !odd_bit )
-    	else // odd bit
-    	{
-    		code <<= 1;
-    		if ( pre_bit_one )
-    		{
-    			if ( get_diff(subghz_decenc_ctl.pulse_times[i], te_short) < tolerance_short )
-    			{
-    				code |= 1; // Bit 1
-    			}
-    			else
-    			{
-    				break; // Error
-    			}
-    		} // if ( pre_bit_one )
-    		else
-    		{
-        		if ( get_diff(subghz_decenc_ctl.pulse_times[i], te_long) < tolerance_long )
-        		{
-        			; // Bit 0
-        		}
-        		else
-        		{
-        			break; // Error
-        		}
-    		} // else
-    		bits_count++;
-    	} // else
-        odd_bit ^= 1;
-    } // for (i = 0; i<pulsecount; i++)
-
-    if (bits_count >= max_bits ) // Let take this packet if all bits have been decoded
-    {
-        subghz_decenc_ctl.n64_decodedvalue = code;
-        subghz_decenc_ctl.ndecodedbitlength = bits_count;
-        subghz_decenc_ctl.ndecodeddelay = 0; //delay;
-        subghz_decenc_ctl.ndecodedprotocol = p;
-        return 0;
-    }
-    else
-    {
-        M1_LOG_E(M1_LOGDB_TAG, "E: rx:%d, decoded:%d, te[i] %d\r\n", pulsecount, bits_count, subghz_decenc_ctl.pulse_times[i]);
-    	for (i=0; i<10; i++)
-    		M1_LOG_N(M1_LOGDB_TAG, "%d ", subghz_decenc_ctl.pulse_times[i]);
-    	M1_LOG_N(M1_LOGDB_TAG, "\r\n");
-    }
-
-    return 1;
-} // uint8_t subghz_decode_princeton(uint16_t p, uint16_t pulsecount)
+	memset(&princeton_dec, 0, sizeof(princeton_dec));
+} // void subghz_decode_princeton_reset(uint16_t p)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Decodes one pulse pair half. Bit 0 is short-long, bit 1 is long-short.
+  * @param  p protocol index
+  * @param  duration pulse duration in uS
+  * @param  index position of the pulse in the packet
+  * @retval SUBGHZ_DECODE_xxx
+  */
+/*============================================================================*/
+static uint8_t subghz_decode_princeton_pulse(uint16_t p, uint16_t duration, uint16_t index)
+{
+	uint8_t te;
+
+	te = subghz_timing_classify(&princeton_dec.timing, duration, subghz_protocols_list[p].te_tolerance);
+	if ( te==SUBGHZ_TE_INVALID )
+		return SUBGHZ_DECODE_FAILED;
+
+	if ( !(index & 0x01) ) // First half of a bit
+	{
+		princeton_dec.pre_bit_one = (te==SUBGHZ_TE_LONG);
+		return SUBGHZ_DECODE_PENDING;
+	} // if ( !(index & 0x01) )
+
+	// The second half of a bit has the other width
+	if ( te==(princeton_dec.pre_bit_one?SUBGHZ_TE_LONG:SUBGHZ_TE_SHORT) )
+		return SUBGHZ_DECODE_FAILED;
+	princeton_dec.code <<= 1;
+	if ( princeton_dec.pre_bit_one )
+		princeton_dec.code |= 1; // Bit 1
+
+	if ( ++princeton_dec.bits_count < subghz_protocols_list[p].data_bits )
+		return SUBGHZ_DECODE_PENDING;
+
+	// Let take this packet as soon as all bits have been decoded
+	subghz_decenc_ctl.n64_decodedvalue = princeton_dec.code;
+	subghz_decenc_ctl.ndecodedbitlength = princeton_dec.bits_count;
+	subghz_decenc_ctl.ndecodeddelay = 0; //delay;
+	subghz_decenc_ctl.ndecodedprotocol = p;
+
+	return SUBGHZ_DECODE_DONE;
+} // static uint8_t subghz_decode_princeton_pulse(uint16_t p, uint16_t duration, uint16_t index)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Feeds one pulse of the current packet to the decoder.
+  *         The bit timing is estimated from the first bits of the packet,
+  *         then follows the packet as the bits are decoded.
+  * @param  p protocol index
+  * @param  duration pulse duration in uS
+  * @retval SUBGHZ_DECODE_xxx
+  */
+/*============================================================================*/
+uint8_t subghz_decode_princeton_feed(uint16_t p, uint16_t duration)
+{
+    const SubGHz_protocol_t *plist;
+    uint8_t i, ret;
+
+    if ( princeton_dec.index >= PRINCETON_HEAD_PULSES )
+    	return subghz_decode_princeton_pulse(p, duration, princeton_dec.index++);
+
+    princeton_dec.head[princeton_dec.index++] = duration;
+    if ( princeton_dec.index < PRINCETON_HEAD_PULSES )
+    	return SUBGHZ_DECODE_PENDING;
+
+    plist = &subghz_protocols_list[p];
+    if ( subghz_timing_estimate(&princeton_dec.timing, princeton_dec.head, PRINCETON_HEAD_PULSES) )
+    	return SUBGHZ_DECODE_FAILED;
+    // Long bit is about three times as long as the short one
+    if ( !subghz_timing_check_ratio(&princeton_dec.timing, plist->te_short, plist->te_long, plist->te_tolerance) )
+    	return SUBGHZ_DECODE_FAILED;
+
+    ret = SUBGHZ_DECODE_PENDING;
+    for (i=0; i<PRINCETON_HEAD_PULSES && ret==SUBGHZ_DECODE_PENDING; i++)
+    	ret = subghz_decode_princeton_pulse(p, princeton_dec.head[i], i);
 
+    return ret;
+} // uint8_t subghz_decode_princeton_feed(uint16_t p, uint16_t duration)
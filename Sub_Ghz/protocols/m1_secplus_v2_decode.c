@@ -17,6 +17,7 @@
 #include "stm32h5xx_hal.h"
 #include "bit_util.h"
 #include "m1_sub_ghz_decenc.h"
+#include "m1_sub_ghz_timing.h"
 #include "m1_log_debug.h"
 
 /*************************** D E F I N E S ************************************/
@@ -41,12 +42,27 @@
 
 //************************** S T R U C T U R E S *******************************
 
+typedef struct
+{
+    uint64_t code;
+    S_SubGHz_Timing_t timing;
+    uint8_t state; // 0: preamble, 1: data, 2: half of the code received
+    uint8_t preamble_count;
+    uint8_t data_count;
+    uint8_t odd_bit;
+    uint8_t prev_bit_high;
+    uint8_t bit_pulses;
+} S_SecPlusV2_Decoder_t;
+
 /***************************** V A R I A B L E S ******************************/
 
+static S_SecPlusV2_Decoder_t secplus_v2_dec;
 
 /********************* F U N C T I O N   P R O T O T Y P E S ******************/
 
-uint8_t subghz_decode_security_plus_20(uint16_t p, uint16_t pulsecount);
+void subghz_decode_security_plus_20_reset(uint16_t p);
+uint8_t subghz_decode_security_plus_20_feed(uint16_t p, uint16_t duration);
+static uint8_t subghz_decode_security_plus_20_packet(uint16_t p);
 uint8_t m1_secplus_v2_decode(uint32_t fixed[], uint8_t half_codes[][10], uint32_t *rolling_code, uint64_t *out_bits);
 uint8_t m1_secplus_v2_decode_half(uint64_t in_bits, uint8_t *half_code, uint32_t *out_bits);
 
@@ -54,131 +70,129 @@ uint8_t m1_secplus_v2_decode_half(uint64_t in_bits, uint8_t *half_code, uint32_t
 
 /*============================================================================*/
 /**
-  * @brief
-  * @param  None
-  * @retval None
-  */
+* @brief  Prepares the decoder for a new packet
+* @param  p protocol index
+* @retval None
+*/
 /*============================================================================*/
-uint8_t subghz_decode_security_plus_20(uint16_t p, uint16_t pulsecount)
+void subghz_decode_security_plus_20_reset(uint16_t p)
 {
-    uint64_t code;
-    static uint64_t prev_code;
-    uint16_t te_long, te_short, i;
-    uint16_t tolerance_long, tolerance_short;
-    uint8_t odd_bit, bit_pulses, prev_bit_high;
-    uint8_t ret, state, preamble_count, data_count;
-    uint8_t half_codes[2][10];
-    static uint8_t rx_packets = 0;
-    uint32_t fixed[2], rolling_code;
-    const SubGHz_protocol_t *plist;
-
-    plist = &subghz_protocols_list[p];
-
-    te_short = plist->te_short;
-    te_long = plist->te_long;
-    tolerance_short = (te_short*plist->te_tolerance)/100;
-    tolerance_long = (te_long*plist->te_tolerance)/100;
-
-    state = 0;
-    preamble_count = 0;
-    data_count = 0;
-    odd_bit = 0;
-    ret = 0;
-
-    for (i = 0; i<pulsecount; i++)
-    {
-    	if ( state==0 ) // Preamble bits?
-    	{
-            if ( get_diff(subghz_decenc_ctl.pulse_times[i], te_short) < tolerance_short )
-            {
-            	if ( odd_bit )
-            		preamble_count++;
-            } // if ( get_diff(subghz_decenc_ctl.pulse_times[i], te_short) < tolerance_short )
-            else if ( get_diff(subghz_decenc_ctl.pulse_times[i], te_long) < tolerance_long )
-            {
-            	// Bits 0 and half of bit 1 received
-            	if ( !odd_bit )
-            		break;
-            	preamble_count++;
-            	if ( preamble_count < (plist->preamble_bits/2) ) // Not enough preamble bits received?
-            		break;
-            	state = 1;
-            	prev_bit_high = 0;
-            	bit_pulses = 1;
-            	code = 0;
-            } // else if ( get_diff(subghz_decenc_ctl.pulse_times[i], te_long) < tolerance_long )
-            else // Error occurred
-            {
-            	if ( preamble_count ) // If no bit has been decoded, attempt to decode the remaining bits
-            		break;
-            } // else
-            odd_bit ^= 1;
-    	} // if ( state==0 )
-
-    	else // Data bits
-    	{
-    		if ( !prev_bit_high )
-    		{
-                if ( (get_diff(subghz_decenc_ctl.pulse_times[i], te_short) < tolerance_short) ||
-                		(get_diff(subghz_decenc_ctl.pulse_times[i], te_long) < tolerance_long) )
-                {
-                	// Bit 1 received, or bit 1 and half of bit 0 received
-                	bit_pulses++;
-                	if ( bit_pulses==2 )
-                	{
-                		data_count++;
-                		code <<= 1;
-                		code |= 0x01;
-                		bit_pulses = 0;
-                		if ( get_diff(subghz_decenc_ctl.pulse_times[i], te_long) < tolerance_long )
-                			bit_pulses = 1;
-                	} // if ( bit_pulses==2 )
-                } // if ( get_diff(subghz_decenc_ctl.pulse_times[i], te_short) < tolerance_short )
-                else // Error occurred
-                {
-                	break;
-                } // else
-    		} // if ( !prev_bit_high )
-    		else // Previous bit is high
-    		{
-                if ( (get_diff(subghz_decenc_ctl.pulse_times[i], te_short) < tolerance_short) ||
-                	(get_diff(subghz_decenc_ctl.pulse_times[i], te_long) < tolerance_long) )
-                {
-                	// Bit 0 received, or bit 0 and half of bit 1 received
-                	bit_pulses++;
-                	if ( bit_pulses==2 )
-                	{
-                    	data_count++;
-                    	code <<= 1;
-                    	bit_pulses = 0;
-                		if ( get_diff(subghz_decenc_ctl.pulse_times[i], te_long) < tolerance_long )
-                			bit_pulses = 1;
-                	} // if ( bit_pulses==2 )
-                } // if ( get_diff(subghz_decenc_ctl.pulse_times[i], te_short) < tolerance_short )
-                else if ( data_count >= (plist->data_bits-1) ) // Last bit 0?
-                {
-                	if ( bit_pulses ) // High pulse of the last bit 0 received?
-                	{
-                		data_count++;
-                		code <<= 1;
-                	}
-                	ret = 1;
-    			    break;
-                } // else if ( data_count >= (plist->data_bits-1) )
-                else // Error occurred
-                {
-                	break;
-                } // else
-    		} // else
-    		prev_bit_high ^= 1;
-    	} // else
-    } // for (i = 0; i<pulsecount; i++)
-
-    M1_LOG_D(M1_LOGDB_TAG, "Security+: E:%d pulses:%d, preamble:%d, data: %d\r\n", !ret, pulsecount, preamble_count, data_count);
-/*
-    M1_LOG_D(M1_LOGDB_TAG, "te[0,1,2,3]:%d %d %d %d\r\n", subghz_decenc_ctl.pulse_times[0], subghz_decenc_ctl.pulse_times[1],
-    														subghz_decenc_ctl.pulse_times[2], subghz_decenc_ctl.pulse_times[3]);
+	memset(&secplus_v2_dec, 0, sizeof(secplus_v2_dec));
+	// The widths are fixed by the protocol, the estimate follows the transmitter from there
+	subghz_timing_seed(&secplus_v2_dec.timing, subghz_protocols_list[p].te_short, subghz_protocols_list[p].te_long);
+} // void subghz_decode_security_plus_20_reset(uint16_t p)
+
+
+
+/*============================================================================*/
+/**
+* @brief  Feeds one pulse of the current packet to the decoder
+* @param  p protocol index
+* @param  duration pulse duration in uS
+* @retval SUBGHZ_DECODE_xxx
+*/
+/*============================================================================*/
+uint8_t subghz_decode_security_plus_20_feed(uint16_t p, uint16_t duration)
+{
+	const SubGHz_protocol_t *plist;
+	S_SecPlusV2_Decoder_t *pdec;
+	uint8_t te;
+	bool is_short, is_long;
+
+	plist = &subghz_protocols_list[p];
+	pdec = &secplus_v2_dec;
+
+	if ( pdec->state==2 ) // Rest of the packet ignored, the other half comes with the next one
+		return SUBGHZ_DECODE_PENDING;
+
+	te = subghz_timing_classify(&pdec->timing, duration, plist->te_tolerance);
+	is_short = (te==SUBGHZ_TE_SHORT);
+	is_long = (te==SUBGHZ_TE_LONG);
+
+	if ( pdec->state==0 ) // Preamble bits?
+	{
+		if ( is_short )
+		{
+			if ( pdec->odd_bit )
+				pdec->preamble_count++;
+		} // if ( is_short )
+		else if ( is_long )
+		{
+			// Bits 0 and half of bit 1 received
+			if ( !pdec->odd_bit )
+				return SUBGHZ_DECODE_FAILED;
+			pdec->preamble_count++;
+			if ( pdec->preamble_count < (plist->preamble_bits/2) ) // Not enough preamble bits received?
+				return SUBGHZ_DECODE_FAILED;
+			pdec->state = 1;
+			pdec->prev_bit_high = 0;
+			pdec->bit_pulses = 1;
+			pdec->code = 0;
+		} // else if ( is_long )
+		else // Error occurred
+		{
+			if ( pdec->preamble_count ) // If no bit has been decoded, attempt to decode the remaining bits
+				return SUBGHZ_DECODE_FAILED;
+		} // else
+		pdec->odd_bit ^= 1;
+		return SUBGHZ_DECODE_PENDING;
+	} // if ( pdec->state==0 )
+
+	// Data bits
+	if ( is_short || is_long )
+	{
+		// Bit 1 (previous bit low) or bit 0 (previous bit high) received, or one of them and half of the other bit
+		pdec->bit_pulses++;
+		if ( pdec->bit_pulses==2 )
+		{
+			pdec->data_count++;
+			pdec->code <<= 1;
+			if ( !pdec->prev_bit_high )
+				pdec->code |= 0x01;
+			pdec->bit_pulses = 0;
+			if ( is_long )
+				pdec->bit_pulses = 1;
+		} // if ( pdec->bit_pulses==2 )
+	} // if ( is_short || is_long )
+	else if ( pdec->prev_bit_high && pdec->data_count >= (plist->data_bits-1) ) // Last bit 0?
+	{
+		if ( pdec->bit_pulses ) // High pulse of the last bit 0 received?
+		{
+			pdec->data_count++;
+			pdec->code <<= 1;
+		}
+		M1_LOG_D(M1_LOGDB_TAG, "Security+: preamble:%d, data: %d\r\n", pdec->preamble_count, pdec->data_count);
+		return subghz_decode_security_plus_20_packet(p);
+	} // else if ( pdec->prev_bit_high && pdec->data_count >= (plist->data_bits-1) )
+	else // Error occurred
+	{
+		return SUBGHZ_DECODE_FAILED;
+	} // else
+	pdec->prev_bit_high ^= 1;
+
+	return SUBGHZ_DECODE_PENDING;
+} // uint8_t subghz_decode_security_plus_20_feed(uint16_t p, uint16_t duration)
+
+
+
+/*============================================================================*/
+/**
+* @brief  Pairs the received packet with the other half of the code
+*         and decodes the code once both packets have been received.
+* @param  p protocol index
+* @retval SUBGHZ_DECODE_PENDING while the other half is missing, SUBGHZ_DECODE_xxx otherwise
 */
+/*============================================================================*/
+static uint8_t subghz_decode_security_plus_20_packet(uint16_t p)
+{
+	uint64_t code;
+	static uint64_t prev_code;
+	uint8_t ret, i;
+	uint8_t half_codes[2][10];
+	static uint8_t rx_packets = 0;
+	uint32_t fixed[2], rolling_code;
+
+	code = secplus_v2_dec.code;
 /**
       * Packet:  | 001111 xx | xx xxxx xx|xx dddddd | dddddddd | dddddddd | dddddddd |
       * 				 Type  ID  ORD  INV  Data								   LSB
@@ -187,87 +201,76 @@ uint8_t subghz_decode_security_plus_20(uint16_t p, uint16_t pulsecount)
       * ORD: Order indicator
       * INV: Inversion indicator
 */
-    while (ret)
-    {
-    	ret = 0;
-        if ( code & SEC_PLUS_V2_ID_MASK ) // ID
-        {
-        	ret = 1;
-        	break;
-        }
-
-        if ( code & SEC_PLUS_V2_PACKET_X_MASK ) // Type
-        	i = 0x02;
-        else
-        	i = 0x01;
-    	if ( !(rx_packets & i) ) // This packet is not decoded yet?
-    	{
-    		rx_packets |= i;
-    		if ( i==0x01 )
-    			prev_code = code;
-    	} // if ( !(rx_packets & i) )
-    	else
-    	{
-    		ret = 1; // reset
-    	}
-    	if ( ret )
-    		break;
-
-    	if ( rx_packets==0x03 ) // Received enough 2 packets?
-    	{
-    		if ( i==0x01 ) // Wrong order? The last decoded packet should be 0x02
-    		{
-    			rx_packets = 0x01; // Restart
-    			M1_LOG_E(M1_LOGDB_TAG, "Wrong packet order\r\n");
-    			return 1;
-    		} // if ( i==0x01 )
-    		else
-    		{
-    			do
-    			{
-    				memset(&half_codes[0], 0, 10);
-    				memset(&half_codes[1], 0, 10);
-    				M1_LOG_D(M1_LOGDB_TAG, "Packet 1 0x%lX%lX\r\n", (uint32_t)(prev_code>>32), (uint32_t)prev_code);
-    				M1_LOG_D(M1_LOGDB_TAG, "Packet 2 0x%lX%lX\r\n", (uint32_t)(code>>32), (uint32_t)code);
-    				ret = m1_secplus_v2_decode_half(prev_code, (uint8_t *)&half_codes[0], &fixed[0]);
-    				if ( ret )
-    					break;
-    				ret = m1_secplus_v2_decode_half(code, (uint8_t *)&half_codes[1], &fixed[1]);
-    				if ( ret )
-    					break;
-    				ret = m1_secplus_v2_decode(fixed, half_codes, &rolling_code, &code);
-    			} while (false);
-    		} // else
-        	if ( ret )
-        		break;
-
-        	rx_packets = 0; // reset
-            // button-id = out_bits >> 32;
-            // remote-id = out_bits & 0xffffffff;
-            // rolling_code is a 28 bit unsigned number
-            // fixed is 40 bit in a uint64_t
-            subghz_decenc_ctl.n64_decodedvalue = code;
-            subghz_decenc_ctl.n32_serialnumber = (fixed[0] << 20) | fixed[1];
-            subghz_decenc_ctl.n32_rollingcode = rolling_code;
-            subghz_decenc_ctl.n8_buttonid = (uint8_t)(fixed[0] >> 12);
-            subghz_decenc_ctl.ndecodedbitlength = data_count;
-            subghz_decenc_ctl.ndecodeddelay = 0; //delay;
-            subghz_decenc_ctl.ndecodedprotocol = p;
-            // Packet 1 = prev_code
-            // Packet 2 = code
-    	    M1_LOG_I(M1_LOGDB_TAG, "Decoded 0x%lX%lX\r\n", (uint32_t)(code>>32), (uint32_t)code);
-    		M1_LOG_D(M1_LOGDB_TAG, "Button 0x%X\r\n", (uint8_t)(fixed[0] >> 12));
-    		M1_LOG_D(M1_LOGDB_TAG, "Serial 0x%lX\r\n", (fixed[0] << 20) | fixed[1]);
-    	} // if ( rx_packets==0x03 )
-    } // while (ret)
-
-    if ( ret )
-    {
-    	rx_packets = 0; // reset
-    }
-
-    return ret;
-} // uint8_t subghz_decode_security_plus_20(uint16_t p, uint16_t pulsecount)
+	do
+	{
+		ret = 1;
+		if ( code & SEC_PLUS_V2_ID_MASK ) // ID
+			break;
+
+		if ( code & SEC_PLUS_V2_PACKET_X_MASK ) // Type
+			i = 0x02;
+		else
+			i = 0x01;
+		if ( rx_packets & i ) // This packet has been decoded already?
+			break;
+		rx_packets |= i;
+		if ( i==0x01 )
+			prev_code = code;
+
+		if ( rx_packets!=0x03 ) // Wait for the other packet
+		{
+			secplus_v2_dec.state = 2;
+			return SUBGHZ_DECODE_PENDING;
+		}
+
+		if ( i==0x01 ) // Wrong order? The last decoded packet should be 0x02
+		{
+			rx_packets = 0x01; // Restart
+			M1_LOG_E(M1_LOGDB_TAG, "Wrong packet order\r\n");
+			return SUBGHZ_DECODE_FAILED;
+		} // if ( i==0x01 )
+
+		memset(&half_codes[0], 0, 10);
+		memset(&half_codes[1], 0, 10);
+		M1_LOG_D(M1_LOGDB_TAG, "Packet 1 0x%lX%lX\r\n", (uint32_t)(prev_code>>32), (uint32_t)prev_code);
+		M1_LOG_D(M1_LOGDB_TAG, "Packet 2 0x%lX%lX\r\n", (uint32_t)(code>>32), (uint32_t)code);
+		ret = m1_secplus_v2_decode_half(prev_code, (uint8_t *)&half_codes[0], &fixed[0]);
+		if ( ret )
+			break;
+		ret = m1_secplus_v2_decode_half(code, (uint8_t *)&half_codes[1], &fixed[1]);
+		if ( ret )
+			break;
+		ret = m1_secplus_v2_decode(fixed, half_codes, &rolling_code, &code);
+		if ( ret )
+			break;
+
+		rx_packets = 0; // reset
+		// button-id = out_bits >> 32;
+		// remote-id = out_bits & 0xffffffff;
+		// rolling_code is a 28 bit unsigned number
+		// fixed is 40 bit in a uint64_t
+		subghz_decenc_ctl.n64_decodedvalue = code;
+		subghz_decenc_ctl.n32_serialnumber = (fixed[0] << 20) | fixed[1];
+		subghz_decenc_ctl.n32_rollingcode = rolling_code;
+		subghz_decenc_ctl.n8_buttonid = (uint8_t)(fixed[0] >> 12);
+		subghz_decenc_ctl.ndecodedbitlength = secplus_v2_dec.data_count;
+		subghz_decenc_ctl.ndecodeddelay = 0; //delay;
+		subghz_decenc_ctl.ndecodedprotocol = p;
+		// Packet 1 = prev_code
+		// Packet 2 = code
+		M1_LOG_I(M1_LOGDB_TAG, "Decoded 0x%lX%lX\r\n", (uint32_t)(code>>32), (uint32_t)code);
+		M1_LOG_D(M1_LOGDB_TAG, "Button 0x%X\r\n", (uint8_t)(fixed[0] >> 12));
+		M1_LOG_D(M1_LOGDB_TAG, "Serial 0x%lX\r\n", (fixed[0] << 20) | fixed[1]);
+	} while (0);
+
+	if ( ret )
+	{
+		rx_packets = 0; // reset
+		return SUBGHZ_DECODE_FAILED;
+	}
+
+	return SUBGHZ_DECODE_DONE;
+} // static uint8_t subghz_decode_security_plus_20_packet(uint16_t p)
 
 
 
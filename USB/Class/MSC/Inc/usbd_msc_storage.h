@@ -75,6 +75,9 @@ extern USBD_StorageTypeDef  USBD_MSC_Interface_fops;
 /** @defgroup USBD_STORAGE_Exported_FunctionsPrototype
   * @{
   */
+void STORAGE_TaskInit(void);
+uint8_t STORAGE_DeferDataStage(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pdata);
+int8_t STORAGE_Sync(void);
 
 
 /**
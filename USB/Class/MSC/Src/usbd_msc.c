@@ -287,6 +287,13 @@ uint8_t USBD_MSC_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
   (void)USBD_LL_CloseEP(pdev, MSCInEpAdd);
   pdev->ep_in[MSCInEpAdd & 0xFU].is_used = 0U;
 
+  /* Write the blocks still cached by the storage */
+  if ((pdev->pUserData[pdev->classId] != NULL) &&
+      (((USBD_StorageTypeDef *)pdev->pUserData[pdev->classId])->Flush != NULL))
+  {
+    (void)((USBD_StorageTypeDef *)pdev->pUserData[pdev->classId])->Flush(0U);
+  }
+
   /* Free MSC Class Resources */
   if (pdev->pClassDataCmsit[pdev->classId] != NULL)
   {
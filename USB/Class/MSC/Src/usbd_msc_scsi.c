@@ -85,6 +85,7 @@ static int8_t SCSI_ReadCapacity16(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t
 static int8_t SCSI_RequestSense(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
 static int8_t SCSI_StartStopUnit(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
 static int8_t SCSI_AllowPreventRemovable(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
+static int8_t SCSI_SynchronizeCache10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
 static int8_t SCSI_ModeSense6(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
 static int8_t SCSI_ModeSense10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
 static int8_t SCSI_Write10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params);
@@ -128,6 +129,22 @@ int8_t SCSI_ProcessCmd(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *cmd)
     return -1;
   }
 
+  /* Write the blocks cached by previous write commands before any other command */
+  if ((cmd[0] != SCSI_WRITE10) && (cmd[0] != SCSI_WRITE12) && (cmd[0] != SCSI_REQUEST_SENSE) &&
+      (((USBD_StorageTypeDef *)pdev->pUserData[pdev->classId])->Flush != NULL))
+  {
+    if (((USBD_StorageTypeDef *)pdev->pUserData[pdev->classId])->Flush(lun) < 0)
+    {
+      /* The command fails with a CSW, after a stall if it has a data stage */
+      SCSI_SenseCode(pdev, lun, HARDWARE_ERROR, WRITE_FAULT);
+      if (hmsc->cbw.dDataLength == 0U)
+      {
+        hmsc->bot_state = USBD_BOT_NO_DATA;
+      }
+      return -1;
+    }
+  }
+
   switch (cmd[0])
   {
     case SCSI_TEST_UNIT_READY:
@@ -150,6 +167,10 @@ int8_t SCSI_ProcessCmd(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *cmd)
       ret = SCSI_AllowPreventRemovable(pdev, lun, cmd);
       break;
 
+    case SCSI_SYNCHRONIZE_CACHE10:
+      ret = SCSI_SynchronizeCache10(pdev, lun, cmd);
+      break;
+
     case SCSI_MODE_SENSE6:
       ret = SCSI_ModeSense6(pdev, lun, cmd);
       break;
@@ -650,6 +671,31 @@ static int8_t SCSI_StartStopUnit(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t
 }
 
 
+/**
+  * @brief  SCSI_SynchronizeCache10
+  *         Process Synchronize Cache (10) command, the cache is written by
+  *         SCSI_ProcessCmd before any command other than a write
+  * @param  lun: Logical unit number
+  * @param  params: Command parameters
+  * @retval status
+  */
+static int8_t SCSI_SynchronizeCache10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
+{
+  UNUSED(lun);
+  UNUSED(params);
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+  if (hmsc == NULL)
+  {
+    return -1;
+  }
+
+  hmsc->bot_data_length = 0U;
+
+  return 0;
+}
+
+
 /**
   * @brief  SCSI_AllowPreventRemovable
   *         Process Allow Prevent Removable medium command
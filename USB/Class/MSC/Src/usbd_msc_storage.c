@@ -26,6 +26,8 @@ EndBSPDependencies */
 #include <usbd_msc_storage.h>
 #include "m1_sdcard.h"
 #include "m1_usb_cdc_msc.h"
+#include "m1_tasks.h"
+#include <string.h>
 
 /* Private typedef -----------------------------------------------------------*/
 #define M1_LOGDB_TAG  "USB-MSC"
@@ -40,10 +42,60 @@ EndBSPDependencies */
 #define STORAGE_LUN_NBR             1U
 
 #define MSC_SD_DATATIMEOUT          100000
+#define MSC_SD_WRITE_RETRIES        3U
+
+#define MSC_EVENT_QUEUE_LEN         4U
 
 #define SDCARD_CB_READ_CPLT_MSG     1
 #define SDCARD_CB_WRITE_CPLT_MSG    2
 
+/*
+ * Block cache between the SCSI layer and the card.
+ * The SCSI layer hands over at most MSC_MEDIA_PACKET bytes per call. The cache
+ * holds MSC_CACHE_BLOCKS blocks, either:
+ * - read ahead: once two reads follow each other, the next read fetches a
+ *   whole cache in one multi-block command and the following requests are
+ *   served from it,
+ * - write behind: consecutive writes are merged and written in one multi-block
+ *   command when the cache is full, when a write is not contiguous, or when
+ *   the SCSI layer calls STORAGE_Flush() (any command other than a write,
+ *   e.g. READ, TEST UNIT READY, SYNCHRONIZE CACHE, START STOP UNIT) and when
+ *   the MSC class is de-initialized (USB reset, cable removal).
+ * A failed write behind is reported on the command that caused it. The blocks
+ * stay cached and the next command retries them, until the card is removed.
+ * If they are dropped without a command to report it, when the firmware takes
+ * the card back, the next command fails with a write fault.
+ *
+ * The data stages of the MSC endpoints are handed over by the USB interrupt
+ * to the MSC task, which runs the BOT and SCSI layers with the USB interrupt
+ * masked, as if it ran in it, and unmasks it while it waits for the card.
+ */
+#define MSC_BLOCK_SIZE              512U
+#define MSC_CACHE_BLOCKS            64U     /* 32 KB */
+
+typedef enum
+{
+  MSC_CACHE_EMPTY = 0,
+  MSC_CACHE_READ,                   /* Same blocks as on the card */
+  MSC_CACHE_WRITE                   /* Blocks not written to the card yet */
+} S_MSC_Cache_State;
+
+typedef struct
+{
+  S_MSC_Cache_State state;
+  uint32_t blk_addr;
+  uint32_t blk_len;
+  uint32_t next_read;               /* Block following the last read, to detect sequential reads */
+  uint8_t lost;                     /* Write behind blocks dropped and not reported yet */
+} S_MSC_Cache;
+
+typedef struct
+{
+  USBD_HandleTypeDef *pdev;         /* NULL to flush the cache */
+  uint8_t *pdata;
+  uint8_t ep_addr;
+} S_MSC_Event;
+
 extern SD_HandleTypeDef *phsd;
 extern S_M1_SDCard_Info sdcard_info;
 extern S_M1_SDCard_Hdl sdcard_ctl;
@@ -59,6 +111,18 @@ int8_t STORAGE_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr,
 int8_t STORAGE_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr,
                      uint16_t blk_len);
 int8_t STORAGE_GetMaxLun(void);
+int8_t STORAGE_Flush(uint8_t lun);
+
+static void msc_lock(void);
+static void msc_unlock(void);
+static void msc_task(void *argument);
+static uint8_t msc_sd_ready(void);
+static int8_t msc_sd_transfer(uint8_t write, uint8_t *buf, uint32_t blk_addr, uint32_t blk_len);
+static int8_t msc_cache_flush(void);
+static int8_t msc_flush(void);
+
+static S_MSC_Cache msc_cache = {MSC_CACHE_EMPTY, 0U, 0U, 0xFFFFFFFFU, 0U};
+static uint32_t msc_cache_buf[MSC_CACHE_BLOCKS * MSC_BLOCK_SIZE / sizeof(uint32_t)]; /* Word aligned for the SDMMC DMA */
 
 /* USB Mass storage Standard Inquiry Data */
 int8_t  STORAGE_Inquirydata[] =  /* 36 */
@@ -88,6 +152,7 @@ USBD_StorageTypeDef USBD_MSC_Interface_fops =
   STORAGE_Write,
   STORAGE_GetMaxLun,
   STORAGE_Inquirydata,
+  STORAGE_Flush,
 };
 
 /**
@@ -99,6 +164,7 @@ int8_t STORAGE_Init(uint8_t lun)
 {
   UNUSED(lun);
   //m1_sdcard_unmount();
+  /* The cache is kept, it may hold blocks written before a USB reset */
   return (0);
 }
 
@@ -169,59 +235,260 @@ int8_t  STORAGE_IsWriteProtected(uint8_t lun)
 uint32_t DBG_sd_rd_timeout_cnt = 0;
 uint32_t DBG_sd_wr_timeout_cnt = 0;
 uint8_t *DBG_sd_buf;
+uint32_t DBG_sd_rd_cmd_cnt = 0;
+uint32_t DBG_sd_wr_cmd_cnt = 0;
+uint32_t DBG_msc_cache_hit_cnt = 0;
+uint32_t DBG_msc_cache_lost_cnt = 0;
+
+static QueueHandle_t msc_event_q = NULL;
+static SemaphoreHandle_t msc_mutex = NULL;
+static TaskHandle_t msc_task_hdl = NULL;
+static USBD_HandleTypeDef *msc_pdev = NULL;   /* Device of the data stage being run */
+static uint32_t msc_usb_irq_enabled;
 
 /**
-  * @brief  Reads data from the medium.
-  * @param  lun: Logical unit number
+  * @brief  Creates the MSC task, before the USB device is started.
+  * @param  None
+  * @retval None
+  */
+void STORAGE_TaskInit(void)
+{
+  BaseType_t ret;
+
+  if (msc_task_hdl != NULL)
+  {
+    return;
+  }
+
+  msc_event_q = xQueueCreate(MSC_EVENT_QUEUE_LEN, sizeof(S_MSC_Event));
+  assert(msc_event_q != NULL);
+  msc_mutex = xSemaphoreCreateMutex();
+  assert(msc_mutex != NULL);
+  ret = xTaskCreate(msc_task, "usb_msc_task_n", M1_TASK_STACK_SIZE_1024, NULL, TASK_PRIORITY_USB_MSC_HANDLER, &msc_task_hdl);
+  assert(ret == pdPASS);
+  assert(msc_task_hdl != NULL);
+}
+
+/**
+  * @brief  Hands a data stage of the MSC endpoints over to the MSC task.
+  *         Called from the USB interrupt.
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  pdata: transfer buffer
+  * @retval 1 if the MSC task runs the data stage, 0 if it is not an MSC one
+  */
+uint8_t STORAGE_DeferDataStage(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pdata)
+{
+#if (M1_USB_MODE == M1_CFG_USB_CDC_MSC) || (M1_USB_MODE == M1_CFG_USB_MSC)
+  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+  S_MSC_Event event;
+
+  if ((msc_event_q == NULL) || ((ep_addr != MSC_IN_EP) && (ep_addr != MSC_OUT_EP)))
+  {
+    return 0;
+  }
+
+  /* One transfer at most is pending on each endpoint, the queue cannot be full */
+  event.pdev = pdev;
+  event.pdata = pdata;
+  event.ep_addr = ep_addr;
+  (void)xQueueSendFromISR(msc_event_q, &event, &xHigherPriorityTaskWoken);
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+
+  return 1;
+#else
+  UNUSED(pdev);
+  UNUSED(ep_addr);
+  UNUSED(pdata);
+  return 0;
+#endif
+}
+
+/**
+  * @brief  Gives the storage and the USB device to the calling task: the
+  *         other tasks wait, and the USB interrupt is masked.
+  * @param  None
+  * @retval None
+  */
+static void msc_lock(void)
+{
+  (void)xSemaphoreTake(msc_mutex, portMAX_DELAY);
+  msc_usb_irq_enabled = NVIC_GetEnableIRQ(USB_DRD_FS_IRQn);
+  HAL_NVIC_DisableIRQ(USB_DRD_FS_IRQn);
+}
+
+/**
+  * @brief  Releases what msc_lock() took.
+  * @param  None
+  * @retval None
+  */
+static void msc_unlock(void)
+{
+  if (msc_usb_irq_enabled)
+  {
+    HAL_NVIC_EnableIRQ(USB_DRD_FS_IRQn);
+  }
+  (void)xSemaphoreGive(msc_mutex);
+}
+
+/**
+  * @brief  MSC task: runs the data stages handed over by the USB interrupt
+  *         and the flushes requested from it.
+  * @param  argument: not used
+  * @retval None
+  */
+static void msc_task(void *argument)
+{
+  S_MSC_Event event;
+
+  UNUSED(argument);
+
+  for (;;)
+  {
+    if (xQueueReceive(msc_event_q, &event, portMAX_DELAY) != pdTRUE)
+    {
+      continue;
+    }
+
+    msc_lock();
+    msc_pdev = event.pdev;
+    if (event.pdev == NULL)
+    {
+      (void)msc_flush();
+    }
+    else if ((event.ep_addr & 0x80U) != 0U)
+    {
+      (void)USBD_LL_DataInStage(event.pdev, event.ep_addr & 0x7FU, event.pdata);
+    }
+    else
+    {
+      (void)USBD_LL_DataOutStage(event.pdev, event.ep_addr, event.pdata);
+    }
+    msc_pdev = NULL;
+    msc_unlock();
+  }
+}
+
+/**
+  * @brief  Checks whether the card can be accessed by the host. The write
+  *         behind blocks are dropped once the card is removed, they cannot
+  *         be written to the card inserted next.
+  * @retval 1 if the card is present and not mounted by the firmware
+  */
+static uint8_t msc_sd_ready(void)
+{
+  if (!m1_sd_detected())
+  {
+    if (msc_cache.state == MSC_CACHE_WRITE)
+    {
+      DBG_msc_cache_lost_cnt++;
+    }
+    msc_cache.state = MSC_CACHE_EMPTY;
+    msc_cache.next_read = 0xFFFFFFFFU;
+    return 0;
+  }
+
+  return (sdcard_ctl.status == SD_access_UnMounted) ? 1 : 0;
+}
+
+/**
+  * @brief  Transfers blocks between the card and memory with DMA.
+  *         The USB interrupt is unmasked until the transfer completes.
+  * @param  write: 1 to write to the card, 0 to read
   * @param  buf: data buffer
   * @param  blk_addr: Logical block address
   * @param  blk_len: Blocks number
   * @retval Status (0: OK / -1: Error)
   */
-int8_t STORAGE_Read(uint8_t lun, uint8_t *buf,
-                    uint32_t blk_addr, uint16_t blk_len)
+static int8_t msc_sd_transfer(uint8_t write, uint8_t *buf, uint32_t blk_addr, uint32_t blk_len)
 {
-  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
   int8_t res = -1;
   uint32_t timer;
+  uint8_t class_id = 0U;
   uint16_t event = 0;
-  BaseType_t status;
-
-  UNUSED(lun);
+  HAL_StatusTypeDef hal_res;
 
   DBG_sd_buf = buf;
 
-  if ((sdcard_ctl.status == SD_access_UnMounted) &&
-      (m1_sd_detected()))
+  /* Completion of a transfer that timed out */
+  (void)xQueueReset(sdcard_cb_q_hdl);
+
+  if (write)
   {
-    if (HAL_SD_ReadBlocks_DMA(phsd, buf, (uint32_t)blk_addr, blk_len)==HAL_OK)
+    DBG_sd_wr_cmd_cnt++;
+    hal_res = HAL_SD_WriteBlocks_DMA(phsd, buf, blk_addr, blk_len);
+  }
+  else
+  {
+    DBG_sd_rd_cmd_cnt++;
+    hal_res = HAL_SD_ReadBlocks_DMA(phsd, buf, blk_addr, blk_len);
+  }
+
+  if (hal_res==HAL_OK)
+  {
+    /* The interrupt selects the class of each event it handles */
+    if (msc_pdev != NULL)
     {
-      while(1)
-      {
-        status = xQueueReceiveFromISR(sdcard_cb_q_hdl, (void *)&event, &xHigherPriorityTaskWoken);
-        if (status==pdTRUE) break;
-        //if (res !=0) DBG_sd_rd_timeout_cnt++;
-        m1_wdt_reset();
-      }
-      portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+      class_id = msc_pdev->classId;
+    }
+    if (msc_usb_irq_enabled)
+    {
+      HAL_NVIC_EnableIRQ(USB_DRD_FS_IRQn);
+    }
 
-      if (event==SDCARD_CB_READ_CPLT_MSG)
+    if ((xQueueReceive(sdcard_cb_q_hdl, (void *)&event, MSC_SD_DATATIMEOUT) == pdTRUE) &&
+        (event==(write ? SDCARD_CB_WRITE_CPLT_MSG : SDCARD_CB_READ_CPLT_MSG)))
+    {
+      timer = osKernelGetTickCount();
+      while ( (osKernelGetTickCount() - timer) < MSC_SD_DATATIMEOUT )
       {
-        timer = osKernelGetTickCount();
-        while ( (osKernelGetTickCount() - timer) < MSC_SD_DATATIMEOUT )
+        if (HAL_SD_GetCardState(phsd) == HAL_SD_CARD_TRANSFER)
         {
-          if (HAL_SD_GetCardState(phsd) == HAL_SD_CARD_TRANSFER)
-          {
-            res = 0;
-            break;
-          }
-          m1_wdt_reset();
-          if (res !=0) DBG_sd_rd_timeout_cnt++;
-        } // while (...)
-      } // if (event==SDCARD_CB_READ_CPLT_MSG)
-      else
+          res = 0;
+          break;
+        }
+        osDelay(1);
+      } // while (...)
+    } // if (xQueueReceive(...)...)
+
+    HAL_NVIC_DisableIRQ(USB_DRD_FS_IRQn);
+    if (msc_pdev != NULL)
+    {
+      msc_pdev->classId = class_id;
+    }
+  } // if (hal_res==HAL_OK)
+
+  if (res !=0)
+  {
+    if (write)
+      DBG_sd_wr_timeout_cnt++;
+    else
+      DBG_sd_rd_timeout_cnt++;
+  }
+
+  return (res);
+}
+
+/**
+  * @brief  Writes the write behind blocks to the card.
+  *         The blocks stay cached as read blocks once written, and as write
+  *         behind blocks if every try fails.
+  * @retval Status (0: OK / -1: Error)
+  */
+static int8_t msc_cache_flush(void)
+{
+  uint32_t retry;
+  int8_t res = 0;
+
+  if (msc_cache.state == MSC_CACHE_WRITE)
+  {
+    for (retry = 0; retry < MSC_SD_WRITE_RETRIES; retry++)
+    {
+      res = msc_sd_transfer(1, (uint8_t *)msc_cache_buf, msc_cache.blk_addr, msc_cache.blk_len);
+      if (res == 0)
       {
-        if (res !=0) DBG_sd_rd_timeout_cnt++;
+        msc_cache.state = MSC_CACHE_READ;
+        break;
       }
     }
   }
@@ -229,6 +496,70 @@ int8_t STORAGE_Read(uint8_t lun, uint8_t *buf,
   return (res);
 }
 
+/**
+  * @brief  Reads data from the medium.
+  * @param  lun: Logical unit number
+  * @param  buf: data buffer
+  * @param  blk_addr: Logical block address
+  * @param  blk_len: Blocks number
+  * @retval Status (0: OK / -1: Error)
+  */
+int8_t STORAGE_Read(uint8_t lun, uint8_t *buf,
+                    uint32_t blk_addr, uint16_t blk_len)
+{
+  HAL_SD_CardInfoTypeDef cardinfo;
+  uint32_t sequential, n;
+
+  UNUSED(lun);
+
+  if (!msc_sd_ready())
+  {
+    return (-1);
+  }
+
+  if (msc_cache_flush() != 0)
+  {
+    return (-1);
+  }
+
+  sequential = (blk_addr == msc_cache.next_read);
+  msc_cache.next_read = blk_addr + blk_len;
+
+  if ((msc_cache.state != MSC_CACHE_EMPTY) && (blk_addr >= msc_cache.blk_addr) &&
+      ((blk_addr + blk_len) <= (msc_cache.blk_addr + msc_cache.blk_len)))
+  {
+    DBG_msc_cache_hit_cnt++;
+    memcpy(buf, (uint8_t *)msc_cache_buf + (blk_addr - msc_cache.blk_addr) * MSC_BLOCK_SIZE,
+           blk_len * MSC_BLOCK_SIZE);
+    return (0);
+  }
+
+  if (!sequential || (blk_len >= MSC_CACHE_BLOCKS))
+  {
+    return msc_sd_transfer(0, buf, blk_addr, blk_len);
+  }
+
+  /* Read ahead, up to the end of the card */
+  HAL_SD_GetCardInfo(phsd, &cardinfo);
+  n = MSC_CACHE_BLOCKS;
+  if ((blk_addr + n) > cardinfo.BlockNbr)
+  {
+    n = cardinfo.BlockNbr - blk_addr;
+  }
+
+  msc_cache.state = MSC_CACHE_EMPTY;
+  if (msc_sd_transfer(0, (uint8_t *)msc_cache_buf, blk_addr, n) != 0)
+  {
+    return (-1);
+  }
+  msc_cache.state = MSC_CACHE_READ;
+  msc_cache.blk_addr = blk_addr;
+  msc_cache.blk_len = n;
+  memcpy(buf, msc_cache_buf, blk_len * MSC_BLOCK_SIZE);
+
+  return (0);
+}
+
 /**
   * @brief  Writes data into the medium.
   * @param  lun: Logical unit number
@@ -240,52 +571,127 @@ int8_t STORAGE_Read(uint8_t lun, uint8_t *buf,
 int8_t STORAGE_Write(uint8_t lun, uint8_t *buf,
                      uint32_t blk_addr, uint16_t blk_len)
 {
-  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-  int8_t res = -1;
-  uint32_t timer;
-  uint16_t event = 0;
-  BaseType_t status;
-
   UNUSED(lun);
 
-  if ((sdcard_ctl.status == SD_access_UnMounted) &&
-      (m1_sd_detected()))
+  if (msc_cache.lost || !msc_sd_ready())
   {
-    if ( HAL_SD_WriteBlocks_DMA(phsd, buf, (uint32_t)blk_addr, blk_len)==HAL_OK )
+    msc_cache.lost = 0U;
+    return (-1);
+  }
+
+  if ((msc_cache.state != MSC_CACHE_WRITE) ||
+      (blk_addr != (msc_cache.blk_addr + msc_cache.blk_len)) ||
+      ((msc_cache.blk_len + blk_len) > MSC_CACHE_BLOCKS))
+  {
+    if (msc_cache_flush() != 0)
     {
-      while(1)
-      {
-        status = xQueueReceiveFromISR(sdcard_cb_q_hdl, (void *)&event, &xHigherPriorityTaskWoken);
-        if (status==pdTRUE) break;
+      return (-1);
+    }
 
-        //if (res !=0) DBG_sd_wr_timeout_cnt++;
-        m1_wdt_reset();
-      }
+    /* The read blocks are replaced, whether this write overlaps them or not */
+    msc_cache.state = MSC_CACHE_EMPTY;
+    if (blk_len >= MSC_CACHE_BLOCKS)
+    {
+      return msc_sd_transfer(1, buf, blk_addr, blk_len);
+    }
 
-      portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+    msc_cache.state = MSC_CACHE_WRITE;
+    msc_cache.blk_addr = blk_addr;
+    msc_cache.blk_len = 0;
+  }
 
-      if (event==SDCARD_CB_WRITE_CPLT_MSG)
-      {
-        timer = osKernelGetTickCount();
-        while ( (osKernelGetTickCount() - timer) < MSC_SD_DATATIMEOUT )
-        {
-          if (HAL_SD_GetCardState(phsd)==HAL_SD_CARD_TRANSFER)
-          {
-            res = 0;
-            break;
-          }
-          if (res !=0) DBG_sd_wr_timeout_cnt++;
-          m1_wdt_reset();
-        } // while (...)
-      }
-      else
-      {
-        if (res !=0) DBG_sd_rd_timeout_cnt++;
-      }
-    }
+  memcpy((uint8_t *)msc_cache_buf + msc_cache.blk_len * MSC_BLOCK_SIZE, buf,
+         blk_len * MSC_BLOCK_SIZE);
+  msc_cache.blk_len += blk_len;
+
+  if (msc_cache.blk_len == MSC_CACHE_BLOCKS)
+  {
+    return msc_cache_flush();
   }
 
-  if (res !=0) DBG_sd_wr_timeout_cnt++;
+  return (0);
+}
+
+/**
+  * @brief  Writes the write behind blocks to the card, reports the blocks
+  *         dropped since the last command.
+  * @retval Status (0 : OK / -1 : Error)
+  */
+static int8_t msc_flush(void)
+{
+  if (msc_cache.lost)
+  {
+    msc_cache.lost = 0U;
+    return (-1);
+  }
+
+  if (msc_cache.state != MSC_CACHE_WRITE)
+  {
+    return (0);
+  }
+
+  /* The blocks are kept while the firmware has the card */
+  if (!msc_sd_ready())
+  {
+    return (-1);
+  }
+
+  return msc_cache_flush();
+}
+
+/**
+  * @brief  Writes the write behind blocks to the medium.
+  *         From the USB interrupt (class de-initialization), the MSC task
+  *         writes them later.
+  * @param  lun: Logical unit number
+  * @retval Status (0 : OK / -1 : Error)
+  */
+int8_t STORAGE_Flush(uint8_t lun)
+{
+  S_MSC_Event event = {0};
+
+  UNUSED(lun);
+
+  if (xPortIsInsideInterrupt() && (msc_event_q != NULL))
+  {
+    (void)xQueueSendFromISR(msc_event_q, &event, NULL);
+    return (0);
+  }
+
+  return msc_flush();
+}
+
+/**
+  * @brief  Writes the write behind blocks and empties the cache, before the
+  *         firmware mounts the card. The blocks that cannot be written are
+  *         dropped, and the error reported to the host by its next command.
+  * @param  None
+  * @retval Status (0 : OK / -1 : Error)
+  */
+int8_t STORAGE_Sync(void)
+{
+  int8_t res;
+
+  /* Nothing is cached before the USB device starts */
+  if (msc_mutex == NULL)
+  {
+    return (0);
+  }
+
+  msc_lock();
+  res = 0;
+  if (msc_cache.state == MSC_CACHE_WRITE)
+  {
+    res = msc_sd_ready() ? msc_cache_flush() : -1;
+    if (res != 0)
+    {
+      DBG_msc_cache_lost_cnt++;
+      msc_cache.lost = 1U;
+    }
+  }
+  msc_cache.state = MSC_CACHE_EMPTY;
+  msc_cache.next_read = 0xFFFFFFFFU;
+  msc_unlock();
 
   return (res);
 }
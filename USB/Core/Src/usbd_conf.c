@@ -23,6 +23,7 @@
 #include "usbd_core.h"
 #include "usbd_cdc.h" 				/* Include class header file */
 #include "usbd_msc.h"         /* Include class header file */
+#include "usbd_msc_storage.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -41,11 +42,20 @@ void HAL_PCD_SetupStageCallback(PCD_HandleTypeDef *hpcd)
 
 void HAL_PCD_DataOutStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
 {
+  /* The MSC task runs the MSC data stages, they wait for the SD card */
+  if (STORAGE_DeferDataStage((USBD_HandleTypeDef*)hpcd->pData, epnum, hpcd->OUT_ep[epnum].xfer_buff))
+  {
+    return;
+  }
   USBD_LL_DataOutStage((USBD_HandleTypeDef*)hpcd->pData, epnum, hpcd->OUT_ep[epnum].xfer_buff);
 }
 
 void HAL_PCD_DataInStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
 {
+  if (STORAGE_DeferDataStage((USBD_HandleTypeDef*)hpcd->pData, epnum | 0x80U, hpcd->IN_ep[epnum].xfer_buff))
+  {
+    return;
+  }
   USBD_LL_DataInStage((USBD_HandleTypeDef*)hpcd->pData, epnum, hpcd->IN_ep[epnum].xfer_buff);
 }
 
@@ -405,22 +405,14 @@ void lfrfid_rxThread(void *param)
         }
 
         uint16_t total_events = n / LFR_ITEM_SIZE;
-        uint8_t CHUNK_SIZE = FRAME_CHUNK_SIZE>>1;
         lfrfid_evt_t* p = (lfrfid_evt_t*)batch_buf;
 
-        for (int i = 0; i < total_events; i += CHUNK_SIZE)
+        uint8_t protoIdx = lfrfid_demod_execute(p, total_events);
+        if(protoIdx != LFRFIDProtocolMax)
         {
-            uint16_t events_to_process = (total_events - i < CHUNK_SIZE) ? (total_events - i) : CHUNK_SIZE;
+        	lfrfid_tag_info.protocol = protoIdx;
 
-            for(int protoIdx=LFRFIDProtocolEM4100; protoIdx<LFRFIDProtocolMax; protoIdx++)
-            {
-             	if(lfrfid_decoder_execute(protoIdx, &p[i], events_to_process))
-               	{
-              		lfrfid_tag_info.protocol = protoIdx;
-
-               		m1_app_send_q_message(lfrfid_q_hdl, Q_EVENT_LFRFID_TAG_DETECTED);
-               	}
-            }
+        	m1_app_send_q_message(lfrfid_q_hdl, Q_EVENT_LFRFID_TAG_DETECTED);
         }
 
 	}
@@ -152,6 +152,8 @@ void lfrfid_DeInit(void);
 void bytes_to_u32_array(BitOrder order, const uint8_t in_data[], uint32_t out_data[], int size);
 
 #include "lfrfid_protocol.h"
+#include "lfrfid_demod.h"
+#include "lfrfid_emul.h"
 //#include "lfrfid_protocol_detect.h"
 #include "lfrfid_protocol_em4100.h"
 #include "lfrfid_protocol_h10301.h"
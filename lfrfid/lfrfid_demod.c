@@ -0,0 +1,548 @@
+/* See COPYING.txt for license details. */
+
+/*
+ * lfrfid_demod.c
+ *
+ * Shared LF RFID demodulation front end
+ *
+ * Every protocol used to take the raw capture events and run its own
+ * demodulation on them, so the three EM4100 bit rates each normalized and
+ * paired the same events. The events are now classified once per chunk, each
+ * modulation runs once, and the protocols only see the resulting bits.
+ */
+
+/*************************** I N C L U D E S **********************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "app_freertos.h"
+#include "cmsis_os.h"
+#include "main.h"
+
+#include "lfrfid.h"
+
+/*************************** D E F I N E S ************************************/
+
+/* Manchester, with T the half bit time:
+ *  - HALF: T/4 < t < 1.6T
+ *  - FULL: 1.6T < t < 2.6T, split into two halves of T
+ *  - a pair of halves of opposite levels is a bit when 1.2T < sum < 2.6T
+ */
+#define MANCHESTER_IS_HALF(t, T)	((4U * (t) > (T)) && (10U * (t) < 16U * (T)))
+#define MANCHESTER_IS_FULL(t, T)	((10U * (t) > 16U * (T)) && (10U * (t) < 26U * (T)))
+#define MANCHESTER_IS_PAIR(s, T)	((10U * (s) > 12U * (T)) && (10U * (s) < 26U * (T)))
+
+#define DEMOD_CLASS_OTHER			0
+#define DEMOD_CLASS_HALF			1
+#define DEMOD_CLASS_FULL			2
+#define DEMOD_CLASS_BITS			2 // Per Manchester rate in a class byte
+#define DEMOD_CLASS_MASK			0x03
+
+/* FSK2a periods, see protocol_h10301_encoder_begin() */
+#define PERIOD_ONE_US     80U   // (1,40)+(0,40)
+#define PERIOD_ZERO_US    64U   // (1,32)+(0,32)
+#define PERIOD_TOL_PCT    20U   // ±20%
+#define PERIOD_ZERO_MIN_US	(PERIOD_ZERO_US - PERIOD_ZERO_US * PERIOD_TOL_PCT / 100U)
+#define PERIOD_ZERO_MAX_US	(PERIOD_ZERO_US + PERIOD_ZERO_US * PERIOD_TOL_PCT / 100U)
+#define PERIOD_ONE_MIN_US	(PERIOD_ONE_US - PERIOD_ONE_US * PERIOD_TOL_PCT / 100U)
+#define PERIOD_ONE_MAX_US	(PERIOD_ONE_US + PERIOD_ONE_US * PERIOD_TOL_PCT / 100U)
+#define FSK_BIT_SYMBOLS_MAX	64 // Periods without a bit before the count restarts
+
+//************************** S T R U C T U R E S *******************************
+
+typedef struct
+{
+	uint16_t pending_us; // First half of the bit, 0 if none
+	uint8_t pending_edge;
+	bool in_sync; // A bit was published since the last LFRFID_DEMOD_BIT_RESYNC
+} manchester_state_t;
+
+typedef struct
+{
+	uint8_t protocol[LFRFIDProtocolMax];
+	uint8_t count;
+} demod_subscribers_t;
+
+//************************** C O N S T A N T **********************************/
+
+/* Half bit time per Manchester demodulator, the index of its class bits */
+static const uint16_t manchester_half_us[LFRFIDDemodFSK2a] = {
+	[LFRFIDDemodManchesterRF64] = 256,
+	[LFRFIDDemodManchesterRF32] = 128,
+	[LFRFIDDemodManchesterRF16] = 64,
+};
+
+static const char *const demod_names[LFRFIDDemodMax] = {
+	[LFRFIDDemodManchesterRF64] = "Manchester RF/64",
+	[LFRFIDDemodManchesterRF32] = "Manchester RF/32",
+	[LFRFIDDemodManchesterRF16] = "Manchester RF/16",
+	[LFRFIDDemodFSK2a] = "FSK2a",
+};
+
+/***************************** V A R I A B L E S ******************************/
+
+static uint8_t demod_class_lut[LFRFID_DEMOD_DURATION_MAX + 1];
+static bool demod_class_lut_ready = false;
+static uint8_t demod_class[FRAME_CHUNK_SIZE]; // Classes of the current chunk
+
+static demod_subscribers_t demod_subscribers[LFRFIDDemodMax];
+static manchester_state_t manchester_st[LFRFIDDemodFSK2a];
+static fsk_symbol_state_t fsk_sym_st;
+static fsk_bit_state_t fsk_bit_st;
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+static void demod_class_lut_init(void);
+static uint8_t demod_publish(uint8_t demod, uint8_t bit);
+static inline uint8_t manchester_half_feed(manchester_state_t *st, uint8_t demod, uint16_t t_us, uint8_t edge);
+static uint8_t manchester_run(uint8_t demod, const lfrfid_evt_t *evts, uint8_t count);
+static uint8_t fsk2a_run(const lfrfid_evt_t *evts, uint8_t count);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+/*============================================================================*/
+/**
+  * @brief  Fills the class table of the event durations, all Manchester rates
+  *         in one byte
+  * @param  None
+  * @retval None
+  */
+/*============================================================================*/
+static void demod_class_lut_init(void)
+{
+	for (uint16_t t = 0; t <= LFRFID_DEMOD_DURATION_MAX; t++)
+	{
+		uint8_t cls = 0;
+
+		for (uint8_t d = 0; d < LFRFIDDemodFSK2a; d++)
+		{
+			uint16_t T = manchester_half_us[d];
+			uint8_t c = DEMOD_CLASS_OTHER;
+
+			if (MANCHESTER_IS_HALF(t, T))
+				c = DEMOD_CLASS_HALF;
+			else if (MANCHESTER_IS_FULL(t, T))
+				c = DEMOD_CLASS_FULL;
+			cls |= c << (d * DEMOD_CLASS_BITS);
+		}
+		demod_class_lut[t] = cls;
+	}
+
+	demod_class_lut_ready = true;
+} // static void demod_class_lut_init(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Resets the demodulators and subscribes the protocol decoders to
+  *         their modulation
+  * @param  None
+  * @retval None
+  */
+/*============================================================================*/
+void lfrfid_demod_begin(void)
+{
+	if (!demod_class_lut_ready)
+		demod_class_lut_init();
+
+	memset(demod_subscribers, 0, sizeof(demod_subscribers));
+	for (uint8_t i = 0; i < LFRFIDProtocolMax; i++)
+	{
+		const LFRFIDProtocolBase *proto = lfrfid_protocols[i];
+
+		if (!proto || !proto->decoder.feed || proto->decoder.demod >= LFRFIDDemodMax)
+			continue;
+		demod_subscribers_t *sub = &demod_subscribers[proto->decoder.demod];
+		sub->protocol[sub->count++] = i;
+	}
+
+	memset(manchester_st, 0, sizeof(manchester_st));
+	fsk_symbol_state_init(&fsk_sym_st);
+	fsk_bit_state_init(&fsk_bit_st);
+} // void lfrfid_demod_begin(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Passes a bit to the decoders subscribed to a demodulator
+  * @param  demod demodulator
+  * @param  bit 0, 1 or LFRFID_DEMOD_BIT_RESYNC
+  * @retval Protocol which read a tag, LFRFIDProtocolMax otherwise
+  */
+/*============================================================================*/
+static uint8_t demod_publish(uint8_t demod, uint8_t bit)
+{
+	const demod_subscribers_t *sub = &demod_subscribers[demod];
+
+	for (uint8_t i = 0; i < sub->count; i++)
+	{
+		uint8_t protocol = sub->protocol[i];
+
+		if (lfrfid_protocols[protocol]->decoder.feed(NULL, bit))
+			return protocol;
+	}
+
+	return LFRFIDProtocolMax;
+} // static uint8_t demod_publish(uint8_t demod, uint8_t bit)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Pairs a Manchester half bit with the pending one
+  * @param  st demodulator state
+  * @param  demod Manchester demodulator
+  * @param  t_us duration of the half
+  * @param  edge level of the half
+  * @retval Protocol which read a tag, LFRFIDProtocolMax otherwise
+  */
+/*============================================================================*/
+static inline uint8_t manchester_half_feed(manchester_state_t *st, uint8_t demod, uint16_t t_us, uint8_t edge)
+{
+	if (!st->pending_us)
+	{
+		st->pending_us = t_us;
+		st->pending_edge = edge;
+		return LFRFIDProtocolMax;
+	}
+
+	if (st->pending_edge != edge && MANCHESTER_IS_PAIR(st->pending_us + t_us, manchester_half_us[demod]))
+	{
+		// Low then high is a 1, high then low a 0
+		st->pending_us = 0;
+		st->in_sync = true;
+		return demod_publish(demod, edge);
+	}
+
+	// Out of step: this half may start the next bit
+	st->pending_us = t_us;
+	st->pending_edge = edge;
+	if (!st->in_sync)
+		return LFRFIDProtocolMax; // The decoders have been reset already
+	st->in_sync = false;
+
+	return demod_publish(demod, LFRFID_DEMOD_BIT_RESYNC);
+} // static inline uint8_t manchester_half_feed(manchester_state_t *st, uint8_t demod, uint16_t t_us, uint8_t edge)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Runs a Manchester demodulator on the classified chunk
+  * @param  demod Manchester demodulator
+  * @param  evts events
+  * @param  count number of events
+  * @retval Protocol which read a tag, LFRFIDProtocolMax otherwise
+  */
+/*============================================================================*/
+static uint8_t manchester_run(uint8_t demod, const lfrfid_evt_t *evts, uint8_t count)
+{
+	manchester_state_t st = manchester_st[demod];
+	uint16_t T = manchester_half_us[demod];
+	uint8_t shift = demod * DEMOD_CLASS_BITS;
+	uint8_t protocol = LFRFIDProtocolMax;
+
+	for (uint8_t i = 0; i < count && protocol == LFRFIDProtocolMax; i++)
+	{
+		uint8_t cls = (demod_class[i] >> shift) & DEMOD_CLASS_MASK;
+
+		if (cls == DEMOD_CLASS_HALF)
+		{
+			protocol = manchester_half_feed(&st, demod, evts[i].t_us, evts[i].edge);
+		}
+		else if (cls == DEMOD_CLASS_FULL)
+		{
+			// Two halves of the same level
+			protocol = manchester_half_feed(&st, demod, T, evts[i].edge);
+			if (protocol == LFRFIDProtocolMax)
+				protocol = manchester_half_feed(&st, demod, T, evts[i].edge);
+		}
+		else
+		{
+			// Neither pairs with the pending half nor with the next one
+			st.pending_us = 0;
+			if (st.in_sync)
+			{
+				st.in_sync = false;
+				protocol = demod_publish(demod, LFRFID_DEMOD_BIT_RESYNC);
+			}
+		}
+	}
+
+	manchester_st[demod] = st;
+
+	return protocol;
+} // static uint8_t manchester_run(uint8_t demod, const lfrfid_evt_t *evts, uint8_t count)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Runs the FSK2a demodulator on a chunk
+  * @param  evts events
+  * @param  count number of events
+  * @retval Protocol which read a tag, LFRFIDProtocolMax otherwise
+  */
+/*============================================================================*/
+static uint8_t fsk2a_run(const lfrfid_evt_t *evts, uint8_t count)
+{
+	uint8_t symbol, bit;
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		if (!fsk_symbol_feed(&fsk_sym_st, &evts[i], &symbol))
+			continue;
+		if (!fsk_bit_feed(&fsk_bit_st, symbol, &bit))
+			continue;
+
+		uint8_t protocol = demod_publish(LFRFIDDemodFSK2a, bit);
+		if (protocol != LFRFIDProtocolMax)
+			return protocol;
+	}
+
+	return LFRFIDProtocolMax;
+} // static uint8_t fsk2a_run(const lfrfid_evt_t *evts, uint8_t count)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Classifies the durations of a chunk for all Manchester rates
+  * @param  evts events
+  * @param  count number of events, FRAME_CHUNK_SIZE at most
+  * @retval None
+  */
+/*============================================================================*/
+void lfrfid_demod_classify(const lfrfid_evt_t *evts, uint8_t count)
+{
+	for (uint8_t i = 0; i < count; i++)
+	{
+		uint16_t t = evts[i].t_us;
+
+		if (t > LFRFID_DEMOD_DURATION_MAX)
+			t = LFRFID_DEMOD_DURATION_MAX;
+		demod_class[i] = demod_class_lut[t];
+	}
+} // void lfrfid_demod_classify(const lfrfid_evt_t *evts, uint8_t count)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Runs a demodulator on the chunk given to lfrfid_demod_classify()
+  * @param  demod demodulator
+  * @param  evts events
+  * @param  count number of events
+  * @retval Protocol which read a tag, LFRFIDProtocolMax otherwise
+  */
+/*============================================================================*/
+uint8_t lfrfid_demod_run(uint8_t demod, const lfrfid_evt_t *evts, uint8_t count)
+{
+	if (demod >= LFRFIDDemodMax || !demod_subscribers[demod].count)
+		return LFRFIDProtocolMax;
+
+	if (demod == LFRFIDDemodFSK2a)
+		return fsk2a_run(evts, count);
+
+	return manchester_run(demod, evts, count);
+} // uint8_t lfrfid_demod_run(uint8_t demod, const lfrfid_evt_t *evts, uint8_t count)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Demodulates a batch of capture events for all subscribed protocols
+  * @param  evts events
+  * @param  count number of events
+  * @retval Protocol which read a tag, LFRFIDProtocolMax otherwise. The rest
+  *         of the batch is dropped after a read.
+  */
+/*============================================================================*/
+uint8_t lfrfid_demod_execute(const lfrfid_evt_t *evts, uint16_t count)
+{
+	for (uint16_t i = 0; i < count; i += FRAME_CHUNK_SIZE)
+	{
+		uint8_t n = (count - i < FRAME_CHUNK_SIZE) ? (count - i) : FRAME_CHUNK_SIZE;
+
+		lfrfid_demod_classify(&evts[i], n);
+		for (uint8_t d = 0; d < LFRFIDDemodMax; d++)
+		{
+			uint8_t protocol = lfrfid_demod_run(d, &evts[i], n);
+			if (protocol != LFRFIDProtocolMax)
+				return protocol;
+		}
+	}
+
+	return LFRFIDProtocolMax;
+} // uint8_t lfrfid_demod_execute(const lfrfid_evt_t *evts, uint16_t count)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Name of a demodulator
+  * @param  demod demodulator
+  * @retval Name, "?" when out of range
+  */
+/*============================================================================*/
+const char *lfrfid_demod_get_name(uint8_t demod)
+{
+	if (demod >= LFRFIDDemodMax)
+		return "?";
+
+	return demod_names[demod];
+} // const char *lfrfid_demod_get_name(uint8_t demod)
+
+
+
+/*============================================================================*/
+/*
+ * FSK2a half periods to symbols and bits, moved from the H10301 decoder
+ */
+/*============================================================================*/
+/*============================================================================*/
+/**
+  * @brief
+  * @param
+  * @retval
+  */
+/*============================================================================*/
+static uint16_t abs_u16(int32_t v)
+{
+    return (v < 0) ? -v : v;
+}
+
+
+/*============================================================================*/
+/**
+  * @brief
+  * @param
+  * @retval
+  */
+/*============================================================================*/
+void fsk_symbol_state_init(fsk_symbol_state_t *st)
+{
+    if (!st) return;
+    st->has_prev = false;
+}
+
+
+/*============================================================================*/
+/**
+  * @brief
+  * @param
+  * @retval
+  */
+/*============================================================================*/
+bool fsk_symbol_feed(fsk_symbol_state_t *st,
+                     const lfrfid_evt_t *half,
+                     uint8_t *out_symbol)
+{
+    if (!st || !half || !out_symbol) return false;
+
+    if (!st->has_prev) {
+
+        st->prev_half = *half;
+        st->has_prev = true;
+        return false;
+    }
+
+    lfrfid_evt_t h0 = st->prev_half;
+    lfrfid_evt_t h1 = *half;
+
+    if (h0.edge == h1.edge) {
+        st->prev_half = *half;
+        st->has_prev = true;
+        return false;
+    }
+
+    uint16_t dt0 = h0.t_us;
+    uint16_t dt1 = h1.t_us;
+    uint16_t period = (uint16_t)(dt0 + dt1);
+    bool near_zero = (period >= PERIOD_ZERO_MIN_US) && (period <= PERIOD_ZERO_MAX_US);
+    bool near_one  = (period >= PERIOD_ONE_MIN_US) && (period <= PERIOD_ONE_MAX_US);
+
+    if (!near_zero && !near_one) {
+        st->prev_half = *half;
+        st->has_prev  = true;
+        return false;
+    }
+
+    if (near_zero && near_one) {
+        uint16_t d0 = abs_u16(period - PERIOD_ZERO_US);
+        uint16_t d1 = abs_u16(period - PERIOD_ONE_US);
+        near_zero = (d0 <= d1);
+        near_one  = !near_zero;
+    }
+
+    *out_symbol = near_one ? 1 : 0;
+
+    st->has_prev = false;
+
+    return true;
+}
+
+/*============================================================================*/
+/**
+  * @brief
+  * @param
+  * @retval
+  */
+/*============================================================================*/
+void fsk_bit_state_init(fsk_bit_state_t *st)
+{
+    if (!st) return;
+    st->count = 0;
+    st->ones = 0;
+}
+
+
+/*============================================================================*/
+/**
+  * @brief
+  * @param
+  * @retval
+  */
+/*============================================================================*/
+bool fsk_bit_feed(fsk_bit_state_t *st,
+                  uint8_t symbol,
+                  uint8_t *out_bit)
+{
+    if (!st || !out_bit) return false;
+
+    if (st->count >= FSK_BIT_SYMBOLS_MAX) {
+        st->count = 0;
+        st->ones = 0;
+    }
+
+    st->count++;
+    if (symbol)
+        st->ones++;
+
+    uint8_t total = st->count;
+    uint8_t cnt1 = st->ones;
+    uint8_t cnt0 = total - cnt1;
+
+    if (cnt1 >= 5 ||
+        (total >= 5 && cnt1 >= 4 && cnt0 <= 1))
+    {
+        *out_bit = 1;
+        st->count = 0;
+        st->ones = 0;
+        return true;
+    }
+
+    if (cnt0 >= 6 ||
+        (total >= 6 && cnt0 >= 5 && cnt1 <= 1))
+    {
+        *out_bit = 0;
+        st->count = 0;
+        st->ones = 0;
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,53 @@
+/* See COPYING.txt for license details. */
+
+/*
+ * lfrfid_demod.h
+ *
+ * Shared LF RFID demodulation front end
+ */
+
+#ifndef LFRFID_DEMOD_H_
+#define LFRFID_DEMOD_H_
+
+/*
+ * The durations of a chunk of capture events are classified once, for all
+ * bit rates, with a lookup table. Each demodulator which has a subscribed
+ * protocol (decoder.demod) turns the classified events into bits, and passes
+ * every bit to the decoder.feed of its subscribers. Adding a protocol on an
+ * existing modulation only adds its feed per decoded bit.
+ */
+#define LFRFID_DEMOD_BIT_RESYNC		2 // Passed to decoder.feed when the bit stream lost sync
+#define LFRFID_DEMOD_DURATION_MAX	1023 // Longer durations are classified as this one
+
+/* ============================================================
+ * FSK2a
+ *  - two halves of opposite levels make a period of RF/8 (0) or RF/10 (1)
+ *  - runs of periods make a bit
+ * ============================================================ */
+typedef struct {
+    lfrfid_evt_t prev_half;
+    bool         has_prev;
+} fsk_symbol_state_t;
+
+void fsk_symbol_state_init(fsk_symbol_state_t *st);
+bool fsk_symbol_feed(fsk_symbol_state_t *st,
+                     const lfrfid_evt_t *half,
+                     uint8_t *out_symbol);
+
+typedef struct {
+    uint8_t count; // Periods since the last bit
+    uint8_t ones; // Periods of these at RF/10
+} fsk_bit_state_t;
+
+void fsk_bit_state_init(fsk_bit_state_t *st);
+bool fsk_bit_feed(fsk_bit_state_t *st,
+                  uint8_t symbol,
+                  uint8_t *out_bit);
+
+void lfrfid_demod_begin(void);
+void lfrfid_demod_classify(const lfrfid_evt_t *evts, uint8_t count);
+uint8_t lfrfid_demod_run(uint8_t demod, const lfrfid_evt_t *evts, uint8_t count);
+uint8_t lfrfid_demod_execute(const lfrfid_evt_t *evts, uint16_t count);
+const char *lfrfid_demod_get_name(uint8_t demod);
+
+#endif /* LFRFID_DEMOD_H_ */
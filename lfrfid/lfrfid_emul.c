@@ -0,0 +1,92 @@
+/* See COPYING.txt for license details. */
+
+/*
+ * lfrfid_emul.c
+ *
+ * LF RFID emulation tables for the TIM5 driven DMA
+ *
+ * The encoders write the waveform as steps of a GPIO level and its nominal
+ * duration. These steps are turned into the two word tables the DMA channels
+ * copy to the GPIO and to the timer, see lfrfid_emul.h.
+ */
+
+/*************************** I N C L U D E S **********************************/
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "app_freertos.h"
+#include "cmsis_os.h"
+#include "main.h"
+
+#include "lfrfid.h"
+
+/*************************** D E F I N E S ************************************/
+
+//************************** C O N S T A N T **********************************/
+
+//************************** S T R U C T U R E S *******************************
+
+/***************************** V A R I A B L E S ******************************/
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+/*============================================================================*/
+/**
+  * @brief  Builds the DMA tables of the encoded steps
+  * @param  enc encoder output, enc->length steps
+  * @param  dma tables, allocated here. Free them with lfrfid_emul_dma_free().
+  * @retval error code: 1 too few steps, 2 step too short, 3 out of memory
+  */
+/*============================================================================*/
+uint8_t lfrfid_emul_dma_build(const EncodedTx_Data_t *enc, lfrfid_emul_dma_t *dma)
+{
+	uint16_t i, count;
+
+	memset(dma, 0, sizeof(lfrfid_emul_dma_t));
+
+	count = enc->length;
+	if ( enc->data==NULL || count < 2 )
+		return 1;
+
+	for (i=0; i<count; i++)
+	{
+		if ( enc->data[i].time_us < LFRFID_EMUL_STEP_MIN_US )
+			return 2;
+	}
+
+	dma->bsrr = malloc(count*sizeof(uint32_t));
+	dma->arr = malloc(count*sizeof(uint32_t));
+	if ( dma->bsrr==NULL || dma->arr==NULL )
+	{
+		lfrfid_emul_dma_free(dma);
+		return 3;
+	}
+
+	for (i=0; i<count; i++)
+	{
+		dma->bsrr[i] = enc->data[i].bsrr;
+		dma->arr[i] = enc->data[(i + 2) % count].time_us - 1;
+	}
+	dma->count = count;
+
+	return 0;
+} // uint8_t lfrfid_emul_dma_build(const EncodedTx_Data_t *enc, lfrfid_emul_dma_t *dma)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Frees the DMA tables
+  * @param  dma tables
+  * @retval None
+  */
+/*============================================================================*/
+void lfrfid_emul_dma_free(lfrfid_emul_dma_t *dma)
+{
+	free(dma->bsrr);
+	free(dma->arr);
+	memset(dma, 0, sizeof(lfrfid_emul_dma_t));
+} // void lfrfid_emul_dma_free(lfrfid_emul_dma_t *dma)
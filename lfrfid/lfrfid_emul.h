@@ -0,0 +1,38 @@
+/* See COPYING.txt for license details. */
+
+/*
+ * lfrfid_emul.h
+ *
+ * LF RFID emulation tables for the TIM5 driven DMA
+ */
+
+#ifndef LFRFID_EMUL_H_
+#define LFRFID_EMUL_H_
+
+#include <stdint.h>
+
+/*
+ * Two circular DMA channels replay the encoder steps (lfrfid_encoded_data)
+ * without any interrupt:
+ *  - TIM5 update: arr[] to TIM5->ARR. With the auto-reload preload on, the
+ *    value written at the start of step k sets the length of step k+2, so
+ *    arr[k] = time_us[k+2] - 1. arr[count-2] and arr[count-1] are the lengths
+ *    of steps 0 and 1, loaded by lfrfid_emul_hw_init() before the start.
+ *  - TIM5 CC3, LFRFID_EMUL_DMA_CC_DELAY ticks after the update: bsrr[] to
+ *    GPIOA->BSRR. Every step is delayed by the same time, so the levels last
+ *    exactly time_us.
+ */
+#define LFRFID_EMUL_DMA_CC_DELAY	1 // TIM5 ticks (us) from the update event to the GPIO write
+#define LFRFID_EMUL_STEP_MIN_US		(LFRFID_EMUL_DMA_CC_DELAY + 1)
+
+typedef struct
+{
+	uint32_t *bsrr; // GPIOA->BSRR value of each step
+	uint32_t *arr; // TIM5->ARR preload, two steps ahead
+	uint16_t count; // Steps in one loop
+} lfrfid_emul_dma_t;
+
+uint8_t lfrfid_emul_dma_build(const EncodedTx_Data_t *enc, lfrfid_emul_dma_t *dma);
+void lfrfid_emul_dma_free(lfrfid_emul_dma_t *dma);
+
+#endif /* LFRFID_EMUL_H_ */
@@ -85,8 +85,9 @@ bool lfrfid_profile_load(const S_M1_file_info *f, const char* ext)
 {
 	char file_path[64];
 	char buf[200];
-
+	ProfileSession ps;
 	ParsedValue data;
+	bool ret;
 
 	if(IsValidFileSpec(f, ext))
 	{
@@ -95,29 +96,42 @@ bool lfrfid_profile_load(const S_M1_file_info *f, const char* ext)
 		data.buf = buf;
 		data.max_len = sizeof(buf);
 
-		if(!isValidHeaderField(&data, RFID_DATAFILE_FILETYPE, RFID_DATAFILE_VERSION, file_path))
+		// All entries are read in one pass over the file
+		if(!profile_open(&ps, file_path))
 			return false;
 
-		GetPrivateProfileString(&data,RFID_DATAFILE_PACKTYPE_KEYWORD, file_path);
-		lfrfid_tag_info.protocol = lfrfid_get_protocol_by_name(data.buf);
+		ret = false;
+		do
+		{
+			if(!profile_is_valid_header(&ps, &data, RFID_DATAFILE_FILETYPE, RFID_DATAFILE_VERSION))
+				break;
 
-		if(lfrfid_tag_info.protocol == (uint8_t)PROTOCOL_NO)
-			return false;
+			if(!profile_get_string(&ps, &data, RFID_DATAFILE_PACKTYPE_KEYWORD))
+				break;
+			lfrfid_tag_info.protocol = lfrfid_get_protocol_by_name(data.buf);
+
+			if(lfrfid_tag_info.protocol == (uint8_t)PROTOCOL_NO)
+				break;
+
+			data.v.hex.out_len = 0;
+			profile_get_hex(&ps, &data, RFID_DATAFILE_DATA_KEYWORD);
 
-		GetPrivateProfileHex(&data,RFID_DATAFILE_DATA_KEYWORD, file_path);
+			memcpy(lfrfid_tag_info.uid, data.buf, data.v.hex.out_len);
 
-		memcpy(lfrfid_tag_info.uid, data.buf, data.v.hex.out_len);
+			if(lfrfid_tag_info.protocol == 0)
+				lfrfid_tag_info.bitrate = 64;
+			else if(lfrfid_tag_info.protocol == 1)
+				lfrfid_tag_info.bitrate = 32;
+			else if(lfrfid_tag_info.protocol == 2)
+				lfrfid_tag_info.bitrate = 16;
 
-		if(lfrfid_tag_info.protocol == 0)
-			lfrfid_tag_info.bitrate = 64;
-		else if(lfrfid_tag_info.protocol == 1)
-			lfrfid_tag_info.bitrate = 32;
-		else if(lfrfid_tag_info.protocol == 2)
-			lfrfid_tag_info.bitrate = 16;
+			//fu_get_filename_without_ext(file_path, lfrfid_tag_info.filename, sizeof(lfrfid_tag_info.filename));
 
-		//fu_get_filename_without_ext(file_path, lfrfid_tag_info.filename, sizeof(lfrfid_tag_info.filename));
+			ret = true;
+		} while(0);
+		profile_close(&ps);
 
-		return true;
+		return ret;
 	}
 
 	return false;
@@ -134,31 +148,31 @@ bool lfrfid_profile_load(const S_M1_file_info *f, const char* ext)
 bool lfrfid_profile_save(const char *fp, const PLFRFID_TAG_INFO data)
 {
     char szString[32];
+    ProfileSession ps;
+    bool ret;
 
     int uid_size = protocol_get_data_size(data->protocol);
     const char *protocol = protocol_get_name(data->protocol);
     sprintf(szString, "%s", protocol);
 
-    /* Filetype */
-    if (write_private_profile_string(RFID_DATAFILE_FILETYPE_KEYWORD, RFID_DATAFILE_FILETYPE, fp) == 0)
+    // All entries are written in one rewrite of the file
+    if (!profile_open(&ps, fp))
         return false;
 
-    /* Version */
-    if (write_private_profile_string(RFID_DATAFILE_VERSION_KEYWORD, RFID_DATAFILE_VERSION, fp) == 0)
-        return false;
-
-    /* PackType (Protocol Name) */
-    if (write_private_profile_string(RFID_DATAFILE_PACKTYPE_KEYWORD, szString, fp) == 0)
-        return false;
+    /* Filetype, Version, PackType (Protocol Name) */
+    ret = profile_set(&ps, RFID_DATAFILE_FILETYPE_KEYWORD, RFID_DATAFILE_FILETYPE) &&
+          profile_set(&ps, RFID_DATAFILE_VERSION_KEYWORD, RFID_DATAFILE_VERSION) &&
+          profile_set(&ps, RFID_DATAFILE_PACKTYPE_KEYWORD, szString);
 
     /* UID → String*/
     uid_to_string(szString, sizeof(szString), data->uid, uid_size);
 
     /* Data */
-    if (write_private_profile_string(RFID_DATAFILE_DATA_KEYWORD, szString, fp) == 0)
-        return false;
+    ret = ret && profile_set(&ps, RFID_DATAFILE_DATA_KEYWORD, szString) &&
+          profile_commit(&ps);
+    profile_close(&ps);
 
-    return true;
+    return ret;
 }
 
 
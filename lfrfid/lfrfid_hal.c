@@ -31,6 +31,8 @@
 
 #define LFRFID_RFIN_PIN_MASK   (RFID_RF_IN_Pin)
 
+#define M1_LOGDB_TAG	"RFID"
+
 //************************** C O N S T A N T **********************************/
 
 //************************** S T R U C T U R E S *******************************
@@ -47,8 +49,25 @@ uint8_t rfid_rxtx_is_taking_this_irq; // Flag to use shared interrupt handler
 static lfrfid_evt_t isr_batch[LFR_BATCH_ITEMS];
 static uint16_t     isr_batch_index = 0;
 
+#if LFRFID_EMUL_DMA
+static lfrfid_emul_dma_t lfrfid_emul_dma;
+static DMA_HandleTypeDef hdma_lfrfid_arr;
+static DMA_HandleTypeDef hdma_lfrfid_bsrr;
+static DMA_QListTypeDef list_lfrfid_arr;
+static DMA_QListTypeDef list_lfrfid_bsrr;
+static DMA_NodeTypeDef node_lfrfid_arr;
+static DMA_NodeTypeDef node_lfrfid_bsrr;
+#endif // #if LFRFID_EMUL_DMA
+
 /********************* F U N C T I O N   P R O T O T Y P E S ******************/
 void LFRFID_Timebase_Init(uint32_t freq_hz, uint32_t period_us);
+#if LFRFID_EMUL_DMA
+static void lfrfid_emul_dma_channel_init(DMA_HandleTypeDef *hdma, DMA_QListTypeDef *list, DMA_NodeTypeDef *node,
+										DMA_Channel_TypeDef *instance, uint32_t request,
+										const uint32_t *src, volatile uint32_t *dst, uint16_t count);
+static void lfrfid_emul_dma_start(void);
+static void lfrfid_emul_dma_stop(void);
+#endif // #if LFRFID_EMUL_DMA
 
 
 /*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
@@ -185,7 +204,7 @@ void rfid_emul_handler(TIM_HandleTypeDef *htim)
 	{
 		GPIOA->BSRR = lfrfid_encoded_data.data[lfrfid_encoded_data.index].bsrr;
 
-		htim->Instance->ARR = lfrfid_encoded_data.data[lfrfid_encoded_data.index].time_us;
+		htim->Instance->ARR = lfrfid_encoded_data.data[lfrfid_encoded_data.index].time_us - LFRFID_EMUL_ISR_CORR_US;
 		__HAL_TIM_SET_COUNTER(htim, 0);	//htim->Instance->CNT = 0;
 
 		lfrfid_encoded_data.index++;
@@ -224,13 +243,175 @@ void lfrfid_emul_hw_init(void)
     HAL_GPIO_WritePin(RFID_PULL_GPIO_Port, RFID_PULL_Pin, GPIO_PIN_RESET);
     HAL_GPIO_WritePin(RFID_OUT_GPIO_Port, RFID_OUT_Pin, GPIO_PIN_RESET);
 
+#if LFRFID_EMUL_DMA
+    lfrfid_emul_dma_free(&lfrfid_emul_dma);
+    if (lfrfid_emul_dma_build(&lfrfid_encoded_data, &lfrfid_emul_dma))
+    {
+    	M1_LOG_E(M1_LOGDB_TAG, "Emulation: invalid encoded data\r\n");
+    	return;
+    }
+
+    LFRFID_Timebase_Init(1000000, 100);	// 1Mhz, 100us
+    lfrfid_emul_dma_start();
+#else
     // 100us
     LFRFID_Timebase_Init(1000000, 100);	// 1Mhz, 100us
 
     HAL_TIM_Base_Start_IT(&Timerhdl_RfIdTIM5);
+#endif // #if LFRFID_EMUL_DMA
 }
 
 
+#if LFRFID_EMUL_DMA
+/*============================================================================*/
+/**
+  * @brief  Configures a GPDMA channel to copy a word table to a register on
+  *         each request, in a loop
+  * @param  hdma channel handle
+  * @param  list queue of the channel
+  * @param  node single node of the queue
+  * @param  instance GPDMA channel
+  * @param  request TIM5 request
+  * @param  src table
+  * @param  dst register
+  * @param  count words in the table
+  * @retval None
+  */
+/*============================================================================*/
+static void lfrfid_emul_dma_channel_init(DMA_HandleTypeDef *hdma, DMA_QListTypeDef *list, DMA_NodeTypeDef *node,
+										DMA_Channel_TypeDef *instance, uint32_t request,
+										const uint32_t *src, volatile uint32_t *dst, uint16_t count)
+{
+	DMA_NodeConfTypeDef NodeConfig = {0};
+
+	memset(hdma, 0, sizeof(DMA_HandleTypeDef));
+	memset(list, 0, sizeof(DMA_QListTypeDef));
+	memset(node, 0, sizeof(DMA_NodeTypeDef));
+
+	NodeConfig.NodeType = DMA_GPDMA_LINEAR_NODE;
+	NodeConfig.Init.Request = request;
+	NodeConfig.Init.BlkHWRequest = DMA_BREQ_SINGLE_BURST;
+	NodeConfig.Init.Direction = DMA_MEMORY_TO_PERIPH;
+	NodeConfig.Init.SrcInc = DMA_SINC_INCREMENTED;
+	NodeConfig.Init.DestInc = DMA_DINC_FIXED;
+	NodeConfig.Init.SrcDataWidth = DMA_SRC_DATAWIDTH_WORD;
+	NodeConfig.Init.DestDataWidth = DMA_DEST_DATAWIDTH_WORD;
+	NodeConfig.Init.SrcBurstLength = 1;
+	NodeConfig.Init.DestBurstLength = 1;
+	NodeConfig.Init.TransferAllocatedPort = DMA_SRC_ALLOCATED_PORT0|DMA_DEST_ALLOCATED_PORT0;
+	NodeConfig.Init.TransferEventMode = DMA_TCEM_BLOCK_TRANSFER;
+	NodeConfig.Init.Mode = DMA_NORMAL;
+	NodeConfig.TriggerConfig.TriggerPolarity = DMA_TRIG_POLARITY_MASKED;
+	NodeConfig.DataHandlingConfig.DataExchange = DMA_EXCHANGE_NONE;
+	NodeConfig.DataHandlingConfig.DataAlignment = DMA_DATA_RIGHTALIGN_ZEROPADDED;
+	NodeConfig.SrcAddress = (uint32_t)src;
+	NodeConfig.DstAddress = (uint32_t)dst;
+	NodeConfig.DataSize = count*sizeof(uint32_t);
+	if (HAL_DMAEx_List_BuildNode(&NodeConfig, node) != HAL_OK)
+	{
+		Error_Handler();
+	}
+
+	if (HAL_DMAEx_List_InsertNode(list, NULL, node) != HAL_OK)
+	{
+		Error_Handler();
+	}
+
+	if (HAL_DMAEx_List_SetCircularMode(list) != HAL_OK)
+	{
+		Error_Handler();
+	}
+
+	hdma->Instance = instance;
+	hdma->InitLinkedList.Priority = DMA_HIGH_PRIORITY;
+	hdma->InitLinkedList.LinkStepMode = DMA_LSM_FULL_EXECUTION;
+	hdma->InitLinkedList.LinkAllocatedPort = DMA_LINK_ALLOCATED_PORT1;
+	hdma->InitLinkedList.TransferEventMode = DMA_TCEM_BLOCK_TRANSFER;
+	hdma->InitLinkedList.LinkedListMode = DMA_LINKEDLIST_CIRCULAR;
+	if (HAL_DMAEx_List_Init(hdma) != HAL_OK)
+	{
+		Error_Handler();
+	}
+
+	if (HAL_DMAEx_List_LinkQ(hdma, list) != HAL_OK)
+	{
+		Error_Handler();
+	}
+
+	if (HAL_DMA_ConfigChannelAttributes(hdma, DMA_CHANNEL_NPRIV) != HAL_OK)
+	{
+		Error_Handler();
+	}
+} // static void lfrfid_emul_dma_channel_init(...)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Starts TIM5 and the two DMA channels which replay lfrfid_emul_dma.
+  *         No interrupt is used, see lfrfid_emul.h.
+  * @param  None
+  * @retval None
+  */
+/*============================================================================*/
+static void lfrfid_emul_dma_start(void)
+{
+	TIM_TypeDef *tim = Timerhdl_RfIdTIM5.Instance;
+	uint16_t count = lfrfid_emul_dma.count;
+
+	__HAL_RCC_GPDMA1_CLK_ENABLE();
+
+	lfrfid_emul_dma_channel_init(&hdma_lfrfid_arr, &list_lfrfid_arr, &node_lfrfid_arr,
+								LFRFID_EMUL_DMA_ARR_CHANNEL, GPDMA1_REQUEST_TIM5_UP,
+								lfrfid_emul_dma.arr, &tim->ARR, count);
+	lfrfid_emul_dma_channel_init(&hdma_lfrfid_bsrr, &list_lfrfid_bsrr, &node_lfrfid_bsrr,
+								LFRFID_EMUL_DMA_BSRR_CHANNEL, GPDMA1_REQUEST_TIM5_CH3,
+								lfrfid_emul_dma.bsrr, &RFID_PULL_GPIO_Port->BSRR, count);
+
+	// CC3 in frozen mode only raises the DMA request of the GPIO write
+	tim->CCMR2 &= ~(TIM_CCMR2_CC3S | TIM_CCMR2_OC3M);
+	tim->CCR3 = LFRFID_EMUL_DMA_CC_DELAY;
+
+	// Step 0 length into the shadow register, step 1 length into the preload register
+	tim->CR1 |= TIM_CR1_ARPE;
+	tim->ARR = lfrfid_emul_dma.arr[count - 2];
+	tim->EGR = TIM_EGR_UG;
+	tim->ARR = lfrfid_emul_dma.arr[count - 1];
+	tim->SR = 0;
+
+	HAL_DMAEx_List_Start(&hdma_lfrfid_arr);
+	HAL_DMAEx_List_Start(&hdma_lfrfid_bsrr);
+
+	tim->DIER |= (TIM_DIER_UDE | TIM_DIER_CC3DE);
+	tim->CR1 |= TIM_CR1_CEN;
+} // static void lfrfid_emul_dma_start(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Stops the DMA channels of the emulation and frees their tables
+  * @param  None
+  * @retval None
+  */
+/*============================================================================*/
+static void lfrfid_emul_dma_stop(void)
+{
+	if (Timerhdl_RfIdTIM5.Instance != NULL)
+		Timerhdl_RfIdTIM5.Instance->DIER &= ~(TIM_DIER_UDE | TIM_DIER_CC3DE);
+
+	if (hdma_lfrfid_arr.Instance != NULL)
+		HAL_DMAEx_List_DeInit(&hdma_lfrfid_arr);
+	if (hdma_lfrfid_bsrr.Instance != NULL)
+		HAL_DMAEx_List_DeInit(&hdma_lfrfid_bsrr);
+	hdma_lfrfid_arr.Instance = NULL;
+	hdma_lfrfid_bsrr.Instance = NULL;
+
+	lfrfid_emul_dma_free(&lfrfid_emul_dma);
+} // static void lfrfid_emul_dma_stop(void)
+#endif // #if LFRFID_EMUL_DMA
+
+
 /*============================================================================*/
 /**
   * @brief
@@ -250,6 +431,11 @@ void lfrfid_emul_hw_deinit(void)
   /* Disable the Peripheral */
   __HAL_TIM_DISABLE(&Timerhdl_RfIdTIM5);
 
+#if LFRFID_EMUL_DMA
+  lfrfid_emul_dma_stop();
+  Timerhdl_RfIdTIM5.Instance->CR1 &= ~TIM_CR1_ARPE;
+#endif
+
   __HAL_RCC_TIM5_CLK_DISABLE();
 
   //HAL_GPIO_WritePin(GPIOA, RFID_PULL_Pin, GPIO_PIN_SET);
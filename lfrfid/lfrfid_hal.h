@@ -30,10 +30,15 @@ extern void lfrfid_isr_init(void);
 //***************************************************************************
 #define ENCODED_DATA_MAX 1200
 
+#define LFRFID_EMUL_DMA				1 // 0: TIM5 update interrupt per step, rfid_emul_handler()
+#define LFRFID_EMUL_ISR_CORR_US		3 // Interrupt latency taken off every step by rfid_emul_handler()
+#define LFRFID_EMUL_DMA_ARR_CHANNEL		GPDMA1_Channel6 // TIM5_UP -> TIM5->ARR
+#define LFRFID_EMUL_DMA_BSRR_CHANNEL	GPDMA1_Channel7 // TIM5_CH3 -> GPIOA->BSRR
+
 typedef struct
 {
     uint32_t bsrr;
-    uint16_t time_us;
+    uint16_t time_us; // Nominal duration of the level
 } Encoded_Data_t;
 
 typedef struct
@@ -74,25 +74,8 @@ void lfrfid_decoder_begin(void)
 			if(lfrfid_protocols[i]->decoder.begin)
 				lfrfid_protocols[i]->decoder.begin(NULL);
 	}
-}
-
 
-/*============================================================================*/
-/**
-  * @brief
-  * @param
-  * @retval
-  */
-/*============================================================================*/
-bool lfrfid_decoder_execute(uint16_t protocol_index, const lfrfid_evt_t* new_stream, uint8_t stream_count)
-{
-	if(protocol_index < LFRFIDProtocolMax)
-	{
-		if(lfrfid_protocols[protocol_index])
-			if(lfrfid_protocols[protocol_index]->decoder.execute)
-				return lfrfid_protocols[protocol_index]->decoder.execute((void*)new_stream, stream_count);
-	}
-	return false;
+	lfrfid_demod_begin();
 }
 
 
@@ -37,6 +37,14 @@ typedef enum {
     LFRFIDFeaturePSK = 1 << 1, /** PSK Demodulation */
 } LFRFIDFeature;
 
+typedef enum {
+    LFRFIDDemodManchesterRF64,
+    LFRFIDDemodManchesterRF32,
+    LFRFIDDemodManchesterRF16,
+    LFRFIDDemodFSK2a, /** RF/8 for 0, RF/10 for 1 */
+    LFRFIDDemodMax,
+} LFRFIDDemod;
+
 typedef enum {
     LFRFIDProtocolEM4100,
     LFRFIDProtocolEM4100_32,
@@ -51,7 +59,7 @@ typedef void (*ProtocolMemoryDestory)(void* protocol);
 typedef uint8_t* (*lfrfidProtocolGetData)(void* protocol);
 
 typedef void (*lfrfidProtocolDecoderBegin)(void* protocol);
-typedef bool (*lfrfidProtocolDecoderExecute)(void* protocol, int size);
+typedef bool (*lfrfidProtocolDecoderFeed)(void* protocol, uint8_t bit);
 
 typedef bool (*lfrfidProtocolEncoderBegin)(void* protocol);
 typedef void (*lfrfidProtocolEncoderSend)(void* protocol);
@@ -63,7 +71,8 @@ typedef void (*lfrfidProtocolRenderData)(void* protocol, char* result);
 
 typedef struct {
 	lfrfidProtocolDecoderBegin begin;
-	lfrfidProtocolDecoderExecute execute;
+	LFRFIDDemod demod; /** Bit stream the decoder subscribes to */
+	lfrfidProtocolDecoderFeed feed; /** Takes a bit, or LFRFID_DEMOD_BIT_RESYNC */
 } LFRFIDProtocolDecoder;
 
 typedef struct {
@@ -99,7 +108,6 @@ typedef struct {
 extern const LFRFIDProtocolBase* lfrfid_protocols[];
 
 void lfrfid_decoder_begin(void);
-bool lfrfid_decoder_execute(uint16_t protocol_index, const lfrfid_evt_t* new_stream, uint8_t stream_count);
 
 bool lfrfid_encoder_begin(uint16_t protocol_index, void* proto);
 void lfrfid_encoder_send(uint16_t protocol_index, void* proto);
@@ -41,38 +41,10 @@
 #include "lfrfid.h"
 
 /*************************** D E F I N E S ************************************/
-#define EMUL_EM4100_CORR	(3)
-
 #define OUTPUT_INVERT	0
 
 #define M1_LOGDB_TAG	"RFID"
 
-// --- 헬퍼 매크로 ---
-//HALF_LOW  ---- HALF ---- HALF_HIGH (= MID) ---- FULL ---- FULL_HIGH
-//                  \                     /
-//                   \                   /
-//                      MID_REFERENCE
-
-#define HALF_TOLERANCE_RATIO (1.0f - 0.75f)	// 30%
-#define FULL_TOLERANCE_RATIO (1.0f + 0.30f)	// 30%
-#define MID_TOLERANCE_RATIO  (1.0f + 0.60f) // 30%
-#define MID_TOLERANCE_RATIOx (1.0f + 0.20f) // 30%
-
-#define MID_REFERENCE_VALUE(t) 	(t * MID_TOLERANCE_RATIO)		// t*1.6
-#define HALF_LOWER_LIMIT(t)		(t * HALF_TOLERANCE_RATIO)		// t*0.7
-#define FULL_UPPER_LIMIT(t)		((2 * t) * FULL_TOLERANCE_RATIO)// 2t*1.3
-#define MID_REFERENCE_VALUEx(t) (t * MID_TOLERANCE_RATIOx)		// t*1.6
-
-#define IS_HALF_BIT(t_us, base_us) \
-		((t_us) > HALF_LOWER_LIMIT(base_us)) && ((t_us) < MID_REFERENCE_VALUE(base_us)) // ((t_us) > (base_us * HALF_TOLERANCE_RATIO)) && ((t_us) < (base_us / HALF_TOLERANCE_RATIO))
-
-#define IS_FULL_BIT(t_us, base_us) \
-		((t_us) > MID_REFERENCE_VALUE(base_us)) && ((t_us) < FULL_UPPER_LIMIT(base_us))//((t_us) > ((2 * base_us) * FULL_TOLERANCE_RATIO)) && ((t_us) < ((2 * base_us) / FULL_TOLERANCE_RATIO))
-
-#define IS_FULL_BITx(t_us, base_us) \
-		((t_us) > MID_REFERENCE_VALUEx(base_us)) && ((t_us) < FULL_UPPER_LIMIT(base_us))//((t_us) > ((2 * base_us) * FULL_TOLERANCE_RATIO)) && ((t_us) < ((2 * base_us) / FULL_TOLERANCE_RATIO))
-
-
 #define EM4100_MAX_STEPS   (64 * 2)
 
 //************************** C O N S T A N T **********************************/
@@ -95,20 +67,20 @@ static EM4100_Decoder_t g_em4100_16_dec;
 
 static bool Check_Even_Parity(const uint8_t* data_bits, uint8_t length);
 static uint8_t GetBitFromFrame(EM4100_Decoder_t* dec, uint8_t bit_index);
-static bool em4100_decoder_execute(void* proto, uint16_t size, void* dec);
+static bool em4100_decoder_feed(EM4100_Decoder_t* dec, uint8_t bit);
 
 static uint8_t* protocol_em4100_get_data(void* proto);
 void protocol_em4100_decoder_begin(void* proto);
-bool protocol_em4100_decoder_execute(void* proto, uint16_t size);
+bool protocol_em4100_decoder_feed(void* proto, uint8_t bit);
 bool protocol_em4100_encoder_begin(void* proto);
 void protocol_em4100_encoder_send(void* proto);
 void protocol_em4100_write_begin(void* protocol, void *data);
 void protocol_em4100_write_send(void* proto);
 void protocol_em4100_render_data(void* protocol, char *result);
 void protocol_em4100_32_decoder_begin(void* proto);
-bool protocol_em4100_32_decoder_execute(void* proto, uint16_t size);
+bool protocol_em4100_32_decoder_feed(void* proto, uint8_t bit);
 void protocol_em4100_16_decoder_begin(void* proto);
-bool protocol_em4100_16_decoder_execute(void* proto, uint16_t size);
+bool protocol_em4100_16_decoder_feed(void* proto, uint8_t bit);
 
 //************************** C O N S T A N T **********************************/
 
@@ -121,7 +93,8 @@ const LFRFIDProtocolBase protocol_em4100 = {
     .decoder =
     {
         .begin = (lfrfidProtocolDecoderBegin)protocol_em4100_decoder_begin,
-        .execute = (lfrfidProtocolDecoderExecute)protocol_em4100_decoder_execute,
+        .demod = LFRFIDDemodManchesterRF64,
+        .feed = protocol_em4100_decoder_feed,
     },
     .encoder =
     {
@@ -146,7 +119,8 @@ const LFRFIDProtocolBase protocol_em4100_32 = {
     .decoder =
     {
        .begin = (lfrfidProtocolDecoderBegin)protocol_em4100_32_decoder_begin,
-       .execute = (lfrfidProtocolDecoderExecute)protocol_em4100_32_decoder_execute,
+       .demod = LFRFIDDemodManchesterRF32,
+       .feed = protocol_em4100_32_decoder_feed,
     },
     .encoder =
     {
@@ -171,7 +145,8 @@ const LFRFIDProtocolBase protocol_em4100_16 = {
     .decoder =
     {
         .begin = (lfrfidProtocolDecoderBegin)protocol_em4100_16_decoder_begin,
-        .execute = (lfrfidProtocolDecoderExecute)protocol_em4100_16_decoder_execute,
+        .demod = LFRFIDDemodManchesterRF16,
+        .feed = protocol_em4100_16_decoder_feed,
     },
     .encoder =
     {
@@ -218,7 +193,6 @@ void EM4100_Decoder_Init_Full(EM4100_Decoder_t* dec)
 	//dec->state = DECODER_STATE_IDLE;
     //g_decoder.sync_bit_count = 0;
 	//dec->bit_test = 0;
-	dec->edge_count = 0;
 }
 
 
@@ -281,69 +255,6 @@ static bool em4100_extract_fields(EM4100_Decoder_t* dec)
 }
 
 
-/*============================================================================*/
-/**
-  * @brief
-  * @param
-  * @retval
-  */
-/*============================================================================*/
-static uint8_t manchester_symbol_feed(lfrfid_evt_t* stream, lfrfid_evt_t* stream2,uint8_t count, uint16_t Th_us)
-{
-    uint8_t output_count = 0;
-
-    for (uint8_t i = 0; i < count; ++i) {
-        lfrfid_evt_t current_evt = stream2[i];
-
-           if (IS_FULL_BIT(current_evt.t_us, Th_us)) {
-
-        	stream[output_count].t_us = Th_us;
-        	stream[output_count].edge = current_evt.edge;
-            output_count++;
-
-            stream[output_count].t_us = Th_us;
-            stream[output_count].edge = current_evt.edge;
-            output_count++;
-
-        } else {
-
-            //if (i != output_count) {
-            	stream[output_count] = current_evt;
-            //}
-            output_count++;
-        }
-    }
-    return output_count;
-}
-
-
-/*============================================================================*/
-/**
-  * @brief
-  * @param
-  * @retval
-  */
-/*============================================================================*/
-static void manchester_bit_feed(EM4100_Decoder_t* dec, lfrfid_evt_t* e1, lfrfid_evt_t* e2, uint8_t* bit)
-{
-	uint16_t T_h = dec->detected_half_bit_us;
-    //uint8_t bit = 2;
-
-    bool is_valid_pattern = IS_HALF_BIT(e1->t_us, T_h) && IS_HALF_BIT(e2->t_us, T_h);
-
-    if (is_valid_pattern) {
-        if (e1->edge == 0 && e2->edge == 1) {
-        	if(IS_FULL_BITx((e1->t_us+e2->t_us), T_h))
-        		*bit = 1;
-        }
-        else if (e1->edge == 1 && e2->edge == 0) {
-        	if(IS_FULL_BITx((e1->t_us+e2->t_us), T_h))
-        		*bit = 0;
-        }
-    }
-}
-
-
 /*============================================================================*/
 /**
   * @brief
@@ -463,94 +374,28 @@ bool em4100_is_valid(const EM4100_Decoder_t *dec)
 
 /*============================================================================*/
 /**
-  * @brief
-  * @param
-  * @retval
+  * @brief  Takes a bit of the Manchester demodulator and checks the last 64
+  *         bits for a valid frame.
+  * @param  dec decoder
+  * @param  bit 0, 1 or LFRFID_DEMOD_BIT_RESYNC
+  * @retval true when a tag has been read
   */
 /*============================================================================*/
-bool em4100_decoder_execute(void* proto, uint16_t size, void* dec)
+static bool em4100_decoder_feed(EM4100_Decoder_t* dec, uint8_t bit)
 {
-	lfrfid_evt_t temp_stream[FRAME_CHUNK_SIZE];
-    uint8_t normalized_count;
-    lfrfid_evt_t* new_stream = (lfrfid_evt_t*)proto;
-    EM4100_Decoder_t *pdec = (EM4100_Decoder_t*)dec;
-
-    //if (g_decoder.state != DECODER_STATE_IDLE && g_decoder.detected_half_bit_us != 0) {
-    normalized_count = manchester_symbol_feed(temp_stream, new_stream, size, pdec->detected_half_bit_us);
-    //}
-    //p = &temp_stream[0];
-
-    if (pdec->edge_count + normalized_count > sizeof(pdec->edge_buffer) / sizeof(lfrfid_evt_t)) {
-        EM4100_Decoder_Init_Full(pdec);
-        return false;
-    }
-
-    //if(g_decoder.edge_count > 1)
-    //	M1_LOG_I(M1_LOGDB_TAG,"g_decoder.edge_count=%d, %d\r\n",g_decoder.edge_count ,normalized_count);
-#if 1
-    memcpy(&pdec->edge_buffer[pdec->edge_count], temp_stream, normalized_count * sizeof(lfrfid_evt_t));
-    pdec->edge_count += normalized_count;
-#endif
-
-    uint8_t consumed_idx = 0;
-
-    while (pdec->edge_count - consumed_idx >= 2)
-    {
-        lfrfid_evt_t* e1 = &pdec->edge_buffer[consumed_idx];
-        lfrfid_evt_t* e2 = &pdec->edge_buffer[consumed_idx + 1];
-        consumed_idx += 2;
-
-       	uint8_t bit = 2;
-       	manchester_bit_feed(pdec, e1, e2, &bit);
-
-        if (bit != 2) {
-           	bit_stream_push(pdec,bit);
-
-           	if(decoder_is_full(pdec))
-          	{
-           		if(em4100_is_valid(pdec))
-           		{
-           			em4100_extract_fields(pdec);
-           			return true;
-           			//m1_app_send_q_message(lfrfid_q_hdl, Q_EVENT_LFRFID_TAG_DETECTED);
-           		}
-           	}
-        } else {
-
-          	//EM4100_Decoder_Init_Partial();
-
-            //if(bit == 2 && is_valid_pattern)
-           	if(bit == 2)
-           	{
-               	consumed_idx -= 1;
-               	EM4100_Decoder_Init_Partial(pdec);
-            }
-        }
-    } // end while
-
-#if 1
-    uint8_t remaining_edges;
-    if(pdec->edge_count && (pdec->edge_count >= consumed_idx))
-    {
-    	remaining_edges = pdec->edge_count - consumed_idx;
-
-		if (consumed_idx > 0) {
+	if (bit == LFRFID_DEMOD_BIT_RESYNC) {
+		EM4100_Decoder_Init_Partial(dec);
+		return false;
+	}
 
-			if((FRAME_CHUNK_SIZE-consumed_idx) > remaining_edges)
-			{
-				//M1_LOG_I(M1_LOGDB_TAG, "1->edge_count=%d, consumed_idx=%d, remaining_edges=%d normalized_count=%d\r\n", g_decoder.edge_count,consumed_idx,remaining_edges,normalized_count);
+	bit_stream_push(dec, bit);
 
-				memmove(pdec->edge_buffer, &pdec->edge_buffer[consumed_idx], remaining_edges * sizeof(lfrfid_evt_t));
-				pdec->edge_count = remaining_edges;
-			}
-		}
+	if (decoder_is_full(dec) && em4100_is_valid(dec)) {
+		em4100_extract_fields(dec);
+		return true;
 	}
-    else
-    {
-    	//M1_LOG_I(M1_LOGDB_TAG, "2->edge_count=%d, consumed_idx=%d, remaining_edges=%d normalized_count=%d\r\n", g_decoder.edge_count,consumed_idx,remaining_edges,normalized_count);
-    }
-#endif
-    return false;
+
+	return false;
 }
 
 
@@ -852,14 +697,9 @@ void protocol_em4100_16_decoder_begin(void* proto)
   * @retval
   */
 /*============================================================================*/
-bool protocol_em4100_decoder_execute(void* proto, uint16_t size)
+bool protocol_em4100_decoder_feed(void* proto, uint8_t bit)
 {
-	lfrfid_evt_t* p = (lfrfid_evt_t*)proto;
-
-   //if(lfrfidProtocolManager((const lfrfid_evt_t*)p, size) != LFRFIDStateActive)
-   // 	return false;
-
-	return em4100_decoder_execute(p, size, &g_em4100_dec);
+	return em4100_decoder_feed(&g_em4100_dec, bit);
 }
 
 
@@ -870,11 +710,9 @@ bool protocol_em4100_decoder_execute(void* proto, uint16_t size)
   * @retval
   */
 /*============================================================================*/
-bool protocol_em4100_32_decoder_execute(void* proto, uint16_t size)
+bool protocol_em4100_32_decoder_feed(void* proto, uint8_t bit)
 {
-	lfrfid_evt_t* p = (lfrfid_evt_t*)proto;
-
-	return em4100_decoder_execute(p, size, &g_em4100_32_dec);
+	return em4100_decoder_feed(&g_em4100_32_dec, bit);
 }
 
 
@@ -885,11 +723,9 @@ bool protocol_em4100_32_decoder_execute(void* proto, uint16_t size)
   * @retval
   */
 /*============================================================================*/
-bool protocol_em4100_16_decoder_execute(void* proto, uint16_t size)
+bool protocol_em4100_16_decoder_feed(void* proto, uint8_t bit)
 {
-	lfrfid_evt_t* p = (lfrfid_evt_t*)proto;
-
-	return em4100_decoder_execute(p, size, &g_em4100_16_dec);
+	return em4100_decoder_feed(&g_em4100_16_dec, bit);
 }
 
 
@@ -950,13 +786,15 @@ bool protocol_em4100_encoder_begin(void* proto)
 	    frame,
 		lfrfid_encoded_data.data,
 	    EM4100_MAX_STEPS,
-	    half_bit_us-EMUL_EM4100_CORR,
+	    half_bit_us,
 	    /* gpio_pin   */ 2,
 	    /* start_level*/ 0
 	);
 
     if (nsteps == 0)
         return false;
+
+    lfrfid_encoded_data.length = nsteps;
 #if 0
     WaveTx_Data_t data = {
         .steps  = gEncoded_data,
@@ -977,7 +815,6 @@ bool protocol_em4100_encoder_begin(void* proto)
 void protocol_em4100_encoder_send(void* proto)
 {
 	lfrfid_encoded_data.index = 0;
-	lfrfid_encoded_data.length = 128;
 	lfrfid_emul_hw_init();
 #if 0
 	App_WaveTx_Init();
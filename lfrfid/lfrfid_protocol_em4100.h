@@ -63,9 +63,6 @@ typedef struct {
     uint8_t bit_count;
    //uint32_t bit_test;
 
-    lfrfid_evt_t edge_buffer[FRAME_CHUNK_SIZE];
-    uint8_t edge_count;
-
     //uint8_t sync_bit_count;
     //uint8_t verify_edge_count;
 } EM4100_Decoder_t;
@@ -74,6 +71,7 @@ typedef struct {
 //void setEm4100_bitrate(int bitrate);
 void EM4100_Decoder_Init_Full(EM4100_Decoder_t* dec);
 void EM4100_Decoder_Init_Partial(EM4100_Decoder_t* dec);
+void em4100_build_frame8_from_uid(uint8_t frame8[8], const uint8_t *uid_bytes, uint8_t uid_len);
 
 extern const LFRFIDProtocolBase protocol_em4100;
 extern const LFRFIDProtocolBase protocol_em4100_32;
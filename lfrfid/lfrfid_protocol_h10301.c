@@ -44,39 +44,19 @@
 #define H10301_DECODED_DATA_SIZE     (3)
 
 static uint8_t* protocol_h10301_get_data(void* proto);
-static bool h10301_decoder_execute(void* proto, uint16_t size, void* dec);
-static bool protocol_h10301_decoder_execute(void* proto, uint16_t size);
+static bool h10301_decoder_feed(h10301_Decoder_t *dec, uint8_t bit);
+static bool protocol_h10301_decoder_feed(void* proto, uint8_t bit);
 
 /* ============================================================
  * HID H10301
  * ============================================================ */
 #define OUTPUT_INVERT	0
-/*(80/64) */
-#define PERIOD_ONE_US     80U   // (1,40)+(0,40)
-#define PERIOD_ZERO_US    64U   // (1,32)+(0,32)
-#define PERIOD_TOL_PCT    20U   // ±20%
-#define HALF_TOL_PCT      70U   // ±30% (half sanity)
-
 #define EMUL_HALF_ONE_CORR	(0)
 #define EMUL_HALF_ZERO_CORR	(0)
 #define EMUL_HALF_ONE_US  (40 - EMUL_HALF_ONE_CORR)
 #define EMUL_HALF_ZERO_US (32 - EMUL_HALF_ZERO_CORR)
-#define EMUL_PERIOD_ONE_US  (80-2) //(80)
-#define EMUL_PERIOD_ZERO_US (64-2) //(64)
-
-/* ───────── FSK half → symbol  ───────── */
-#define HALF_TOLERANCE_RATIO (1.0f - 0.35f)	// 30%
-#define FULL_TOLERANCE_RATIO (1.0f + 0.35f)	// 30%
-
-#define MID_REFERENCE_VALUE() 	(72)		// t*1.6
-#define HALF_LOWER_LIMIT(t)		(t * HALF_TOLERANCE_RATIO)
-#define FULL_UPPER_LIMIT(t)		(t * FULL_TOLERANCE_RATIO)
-
-#define ZERO_VALUE	(64)
-#define ONE_VALUE	(80)
-
-#define IS_FULL_BIT(t_us) \
-		((t_us) > HALF_LOWER_LIMIT(ZERO_VALUE)) && ((t_us) < FULL_UPPER_LIMIT(ONE_VALUE))
+#define EMUL_PERIOD_ONE_US  (80)
+#define EMUL_PERIOD_ZERO_US (64)
 
 //************************** C O N S T A N T **********************************/
 
@@ -85,14 +65,12 @@ static bool protocol_h10301_decoder_execute(void* proto, uint16_t size);
 /***************************** V A R I A B L E S ******************************/
 
 static h10301_Decoder_t g_h10301_dec;
-static fsk_symbol_state_t sym_st;
-static fsk_bit_state_t    bit_st;
 
 /********************* F U N C T I O N   P R O T O T Y P E S ******************/
 
 uint8_t* protocol_h10301_get_data(void* proto);
 void protocol_h10301_decoder_begin(void* proto);
-bool protocol_h10301_decoder_execute(void* proto, uint16_t size);
+bool protocol_h10301_decoder_feed(void* proto, uint8_t bit);
 bool protocol_h10301_encoder_begin(void* proto);
 void protocol_h10301encoder_send(void* proto);
 void protocol_h10301_write_begin(void* protocol, void *data);
@@ -110,7 +88,8 @@ const LFRFIDProtocolBase protocol_h10301 = {
     .decoder =
     {
         .begin = (lfrfidProtocolDecoderBegin)protocol_h10301_decoder_begin,
-        .execute = (lfrfidProtocolDecoderExecute)protocol_h10301_decoder_execute,
+        .demod = LFRFIDDemodFSK2a,
+        .feed = protocol_h10301_decoder_feed,
     },
     .encoder =
     {
@@ -168,176 +147,6 @@ void h10301_decoder_push_bit(h10301_Decoder_t *dec, uint8_t bit)
 }
 
 
-/*============================================================================*/
-/**
-  * @brief
-  * @param
-  * @retval
-  */
-/*============================================================================*/
-static uint16_t abs_u16(int32_t v)
-{
-    return (v < 0) ? -v : v;
-}
-
-
-/*============================================================================*/
-/**
-  * @brief
-  * @param
-  * @retval
-  */
-/*============================================================================*/
-static bool within_pct(uint16_t v, uint16_t target, uint16_t pct)
-{
-    uint16_t tol = target * pct / 100U;
-    return abs_u16((int32_t)v - target) <= tol;
-}
-
-
-/*============================================================================*/
-/**
-  * @brief
-  * @param
-  * @retval
-  */
-/*============================================================================*/
-void fsk_symbol_state_init(fsk_symbol_state_t *st)
-{
-    if (!st) return;
-    st->has_prev = false;
-}
-
-
-/*============================================================================*/
-/**
-  * @brief
-  * @param
-  * @retval
-  */
-/*============================================================================*/
-bool fsk_symbol_feed(fsk_symbol_state_t *st,
-                     const lfrfid_evt_t *half,
-                     uint8_t *out_symbol)
-{
-    if (!st || !half || !out_symbol) return false;
-
-    if (!st->has_prev) {
-
-        st->prev_half = *half;
-        st->has_prev = true;
-        return false;
-    }
-
-    lfrfid_evt_t h0 = st->prev_half;
-    lfrfid_evt_t h1 = *half;
-
-    if (h0.edge == h1.edge) {
-         st->prev_half = *half;
-        st->has_prev = true;
-        return false;
-    }
-
-    uint16_t dt0 = h0.t_us;
-    uint16_t dt1 = h1.t_us;
-    uint16_t period = (uint16_t)(dt0 + dt1);
-#if 1
-    bool near_zero = within_pct(period, PERIOD_ZERO_US, PERIOD_TOL_PCT);
-    bool near_one  = within_pct(period, PERIOD_ONE_US,  PERIOD_TOL_PCT);
-
-    if (!near_zero && !near_one) {
-        st->prev_half = *half;
-        st->has_prev  = true;
-        return false;
-    }
-
-    if (near_zero && near_one) {
-        uint16_t d0 = abs_u16(period - PERIOD_ZERO_US);
-        uint16_t d1 = abs_u16(period - PERIOD_ONE_US);
-        near_zero = (d0 <= d1);
-        near_one  = !near_zero;
-    }
-
-    *out_symbol = near_one ? 1 : 0;
-#else
-    st->prev_half = *half;
-
-    if(IS_FULL_BIT(period))
-    {
-    	if(period>MID_REFERENCE_VALUE())
-    		 *out_symbol = 1;
-    	else
-    		 *out_symbol = 0;
-    }
-#endif
-
-    st->has_prev = false;
-
-    return true;
-}
-
-/*============================================================================*/
-/**
-  * @brief
-  * @param
-  * @retval
-  */
-/*============================================================================*/
-void fsk_bit_state_init(fsk_bit_state_t *st)
-{
-    if (!st) return;
-    st->count = 0;
-}
-
-
-/*============================================================================*/
-/**
-  * @brief
-  * @param
-  * @retval
-  */
-/*============================================================================*/
-bool fsk_bit_feed(fsk_bit_state_t *st,
-                  uint8_t symbol,
-                  uint8_t *out_bit)
-{
-    if (!st || !out_bit) return false;
-
-    if (st->count >= sizeof(st->buf)) {
-        st->count = 0;
-    }
-
-    st->buf[st->count++] = (symbol ? 1 : 0);
-
-    uint8_t cnt1 = 0;
-    uint8_t cnt0 = 0;
-    for (uint8_t i = 0; i < st->count; i++) {
-        if (st->buf[i] == 1) cnt1++;
-        else                 cnt0++;
-    }
-
-    uint8_t total = st->count;
-
-    if (cnt1 >= 5 ||
-        (total >= 5 && cnt1 >= 4 && cnt0 <= 1))
-    {
-        *out_bit = 1;
-        st->count = 0;
-        return true;
-    }
-
-    if (cnt0 >= 6 ||
-        (total >= 6 && cnt0 >= 5 && cnt1 <= 1))
-    {
-        *out_bit = 0;
-        st->count = 0;
-        return true;
-    }
-
-    return false;
-}
-
-
 /*============================================================================*/
 /**
   * @brief
@@ -486,51 +295,36 @@ bool h10301_extract_fields(uint32_t raw26,
   * @retval
   */
 /*============================================================================*/
-bool h10301_decoder_execute(void* proto, uint16_t size, void* dec)
+static bool h10301_decoder_feed(h10301_Decoder_t *dec, uint8_t bit)
 {
-	lfrfid_evt_t* evt = (lfrfid_evt_t*)proto;
-
-    for (int i = 0; i < size; i++) {
-        uint8_t symbol;
-
-        if (fsk_symbol_feed(&sym_st, &evt[i], &symbol)) {
+    uint32_t raw26;
+    uint8_t  facility;
+    uint16_t card;
 
-            uint8_t bit;
-            if (fsk_bit_feed(&bit_st, symbol, &bit)) {
+    if (bit == LFRFID_DEMOD_BIT_RESYNC)
+        return false;
 
-            	h10301_decoder_push_bit(dec, bit);
+    h10301_decoder_push_bit(dec, bit);
 
-                 if (h10301_decoder_is_full(dec)) {
-                    const uint32_t *frame = h10301_decoder_frame(dec);
+    if (!h10301_decoder_is_full(dec))
+        return false;
 
-                    if (h10301_is_valid(frame)) {
-                        uint32_t raw26;
+    const uint32_t *frame = h10301_decoder_frame(dec);
 
-                        if (h10301_extract_raw26(frame, &raw26)) {
-                            uint8_t  facility;
-                            uint16_t card;
+    if (!h10301_is_valid(frame))
+        return false;
+    if (!h10301_extract_raw26(frame, &raw26))
+        return false;
+    if (!h10301_extract_fields(raw26, &facility, &card))
+        return false;
 
-                            if (h10301_extract_fields(raw26, &facility, &card)) {
+    //M1_LOG_I("RFID","HID H10301: FC=%u, Card=%u\n", facility, card);
 
-#if 1
-                                //M1_LOG_I("RFID","HID H10301: FC=%u, Card=%u\n", facility, card);
+    lfrfid_tag_info.uid[0] = facility;
+    lfrfid_tag_info.uid[1] = HIBYTE(card);
+    lfrfid_tag_info.uid[2] = LOBYTE(card);
 
-                                lfrfid_tag_info.uid[0] = facility;
-                                lfrfid_tag_info.uid[1] = HIBYTE(card);
-                                lfrfid_tag_info.uid[2] = LOBYTE(card);
-
-                        	  	//lfrfid_tag_info.bitrate = g_decoder.detected_half_bit_us/4;
-                                return true;
-                          	   	//m1_app_send_q_message(lfrfid_q_hdl, Q_EVENT_LFRFID_TAG_DETECTED);
-#endif
-                            }
-                        }
-                    }
-                }
-            }
-        }
-    }
-    return false;
+    return true;
 }
 
 
@@ -864,9 +658,6 @@ overflow:
 void protocol_h10301_decoder_begin(void* proto)
 {
 	h10301_decoder_init(&g_h10301_dec);
-
-    fsk_symbol_state_init(&sym_st);
-    fsk_bit_state_init(&bit_st);
 }
 
 
@@ -877,10 +668,9 @@ void protocol_h10301_decoder_begin(void* proto)
   * @retval
   */
 /*============================================================================*/
-bool protocol_h10301_decoder_execute(void* proto, uint16_t size)
+bool protocol_h10301_decoder_feed(void* proto, uint8_t bit)
 {
-	lfrfid_evt_t* p = (lfrfid_evt_t*)proto;
-	return h10301_decoder_execute(p, size, &g_h10301_dec);
+	return h10301_decoder_feed(&g_h10301_dec, bit);
 }
 
 
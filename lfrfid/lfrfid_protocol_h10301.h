@@ -32,30 +32,6 @@
 
 
 
-typedef struct {
-    lfrfid_evt_t prev_half;
-    bool         has_prev;
-} fsk_symbol_state_t;
-
-void fsk_symbol_state_init(fsk_symbol_state_t *st);
-
-bool fsk_symbol_feed(fsk_symbol_state_t *st,
-                     const lfrfid_evt_t *half,
-                     uint8_t *out_symbol);
-
-typedef struct {
-    uint8_t buf[64];
-    uint8_t count;
-} fsk_bit_state_t;
-
-void fsk_bit_state_init(fsk_bit_state_t *st);
-
-bool fsk_bit_feed(fsk_bit_state_t *st,
-                  uint8_t symbol,
-                  uint8_t *out_bit);
-
-
-
 /* ============================================================
  * H10301 Decoder
  *  - 96bit shift register buffer
@@ -106,6 +82,15 @@ bool h10301_extract_fields(uint32_t raw26,
                            uint8_t *facility_code,
                            uint16_t *card_number);
 
+/* ============================================================
+ * UID (facility code, card number) → 96bit raw frame
+ * ============================================================ */
+void uid_bytes_to_h10301_raw96_bytes(const uint8_t *uid_bytes, int uid_len,
+                                     uint8_t preamble8,
+                                     uint16_t company14,
+                                     uint32_t format22,
+                                     uint8_t raw96_12[12]);
+
 extern const LFRFIDProtocolBase protocol_h10301;
 
 
@@ -913,6 +913,23 @@ void cmd_m1_mtest_subghz(char *pconsole, char *input_params[], uint8_t n_params,
     		SI446x_Select_Frontend(input1_val);
     		break;
 
+    	case 66:
+    		M1_LOG_N(M1_LOGDB_TAG, "CLI mtest: Sub-GHz - convert raw data file\r\n");
+    		if ( n_params < 3 )
+    		{
+    			strcpy(pconsole, "Error: missing parameter(s)!\r\n");
+    			break;
+    		}
+    		if ( m1_sdcard_init_retry() != SD_RET_OK )
+    		{
+    			break;
+    		}
+    		if ( sub_ghz_raw_file_convert(input_params[1], input_params[2]) )
+    		{
+    			strcpy(pconsole, "Error!\r\n");
+    		}
+    		break;
+
     	case 68:
     		M1_LOG_N(M1_LOGDB_TAG, "CLI mtest: Sub-GHz - get RSSI\r\n");
 			pmodemstat = SI446x_Get_ModemStatus(0x00);
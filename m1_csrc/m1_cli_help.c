@@ -293,6 +293,12 @@ void cmd_m1_mtest_help_subghz(void)
 	M1_LOG_N(M1_LOGDB_TAG, "Syntax: mtest 64 network(0:315, 1:433, 2:915, 3:None)\r\n");
 	vTaskDelay(1); // Give the log task some time to do its job
 
+	vTaskDelay(1); // Give the log task some time to do its job
+
+	M1_LOG_N(M1_LOGDB_TAG, "\r\n- cmd_type 66: Sub-GHz - convert raw data file between text and binary formats\r\n");
+	M1_LOG_N(M1_LOGDB_TAG, "Syntax: mtest 66 source_filename destination_filename\r\n");
+	vTaskDelay(1); // Give the log task some time to do its job
+
 	M1_LOG_N(M1_LOGDB_TAG, "\r\n- cmd_type 68: Sub-GHz - get RSSI\r\n");
 	M1_LOG_N(M1_LOGDB_TAG, "Syntax: mtest 68 ref(0-255)\r\n");
 	vTaskDelay(1); // Give the log task some time to do its job
@@ -372,3 +378,4 @@ void cmd_m1_mtest_help_nfc(void)
 
 	M1_LOG_N(M1_LOGDB_TAG, "\r\n");
 } // void cmd_m1_mtest_help_nfc(void)
+
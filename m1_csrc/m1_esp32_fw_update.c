@@ -68,6 +68,7 @@ static size_t image_size = 0;
 static uint8_t progress_percent_count = 0;
 static 	S_M1_file_info *f_info = NULL;
 static FIL hfile_fw;
+static DWORD hfile_fw_clmt[M1_FB_CLMT_SIZE];
 
 /********************* F U N C T I O N   P R O T O T Y P E S ******************/
 
@@ -279,7 +280,7 @@ void setting_esp32_image_file(void)
         }
 
         uret = m1_fb_dyn_strcat(pfullpath, 2, "",  f_info->dir_name, f_info->file_name);
-        uret = m1_fb_open_file(&hfile_fw, pfullpath);
+        uret = m1_fb_open_file_fastseek(&hfile_fw, pfullpath, hfile_fw_clmt, M1_FB_CLMT_SIZE);
 		if ( !uret )
 		{
 			image_size = f_size(&hfile_fw);
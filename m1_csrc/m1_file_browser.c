@@ -25,9 +25,24 @@
 #define DISABLE_IRQ			__disable_irq(); __DSB(); __ISB();
 #define ENABLE_IRQ			__enable_irq();
 
-#define FILE_BROWSER_MAX_FILES			96
 #define DIRECTORY_MAX_DEPTH_LEVEL		32
 
+#define FB_CACHE_SLOTS					4 // Directories kept in the listing cache
+#define FB_CACHE_GROW					64 // Entries added to a listing at each allocation
+#define FB_CACHE_CHECKPOINT				8 // Entries between two saved directory read positions
+#define FB_CACHE_ENTRIES_MAX			0xFFFE // The listing index is 16-bit and ".." takes one row
+#define FB_DIR_GENERATIONS				16 // Directory change counters, shared by directories of equal hash
+
+#define FB_EXTENT_MAGIC					0x584D314D // "M1MX", valid extent record
+
+#if FF_MAX_SS != FF_MIN_SS
+#error "The listing cache needs a fixed sector size"
+#endif
+
+#if FF_DEFINED != 80286
+#error "m1_fb_dir_tell() and m1_fb_dir_seek() follow the DIR object of FatFs R0.15"
+#endif
+
 #define GUI_SCROLLBAR_WIDTH				4 // pixel
 
 #define FILENAME_LEN_ON_CLI_MAX			80 // Max filename length to display on console
@@ -40,6 +55,61 @@ const char m1_fb_data_types[]    = ".log.LOG.text.TEXT.txt.TXT";
 
 //************************* *S T R U C T U R E S *******************************
 
+/*
+ * Directory listing cache
+ * One pass over a directory stores a compact record of each entry shown.
+ * Names are not kept: the rows on screen are read again from the directory,
+ * starting at the read position saved every FB_CACHE_CHECKPOINT entries.
+ * A listing is valid until m1_fb_dir_changed() is called for its directory
+ * or the SD card is mounted again.
+ */
+typedef struct
+{
+	uint32_t size; // Saturated at 4 GB
+	uint32_t sort_key; // First four characters of the name, case folded
+	uint16_t name_hash;
+	uint8_t attrib;
+	uint8_t reserved;
+} S_M1_FB_Cache_Entry;
+
+typedef struct
+{
+	DWORD dptr;
+	DWORD clust;
+	LBA_t sect;
+} S_M1_FB_Cache_Pos;
+
+typedef struct
+{
+	char *dir_name; // NULL if the slot is free
+	DIR dir;
+	S_M1_FB_Cache_Entry *entry;
+	S_M1_FB_Cache_Pos *pos; // Read position before entry n*FB_CACHE_CHECKPOINT
+	uint16_t *order; // Entries in display order, NULL in directory order
+	uint16_t num_entries;
+	uint16_t capacity;
+	uint16_t next; // Entry returned by the next f_readdir()
+	S_M1_file_browser_sort sort;
+	uint32_t generation; // SD card mount generation the listing was read at
+	uint32_t dir_generation; // Change counter of the directory the listing was read at
+	uint8_t dir_slot; // Index of the change counter of the directory in fb_dir_generation[]
+	uint32_t last_use;
+} S_M1_FB_Dir_Cache;
+
+/*
+ * Extent record
+ * A preallocated file is as long as its extent until it is truncated at
+ * close. The record keeps its name and the size of the data synced to the
+ * card, for m1_fb_trim_expanded_file() after a reset or a card removal.
+ * It is smaller than a sector, so it is never written halfway.
+ */
+typedef struct
+{
+	uint32_t magic;
+	uint32_t size; // Data size at the last m1_fb_sync_expanded_file()
+	char filename[64];
+} S_M1_FB_Extent_Record;
+
 /**************************** *V A R I A B L E S ******************************/
 
 static S_M1_file_browser_hdl *pfb_hdl = NULL;
@@ -48,6 +118,15 @@ static u8g2_t *plcd_hdl;
 static bool fb_gui_check;
 FIL m1_log_file;
 
+static S_M1_FB_Dir_Cache fb_cache[FB_CACHE_SLOTS];
+static const S_M1_FB_Dir_Cache *pfb_sort_cache; // Listing being sorted by qsort()
+static const uint32_t *pfb_sort_tie_key; // Next four characters of the names tied in it
+static uint32_t fb_cache_use;
+static volatile uint32_t fb_dir_generation[FB_DIR_GENERATIONS];
+static S_M1_file_browser_sort fb_sort = FB_SORT_NONE;
+static FIL *pfb_extent_file; // Preallocated file being written, NULL if none
+static S_M1_FB_Extent_Record fb_extent_record;
+
 /******************** *F U N C T I O N   P R O T O T Y P E S ******************/
 
 extern void m1_u8g2_firstpage(void);
@@ -58,13 +137,39 @@ void m1_fb_deinit(void);
 uint8_t m1_fb_dyn_strcat(char *buffer, uint8_t num, const char *format, ...);
 uint8_t m1_fb_open_new_file(FIL *file, const char *filename);
 uint8_t m1_fb_open_file(FIL *file, const char *filename);
+uint8_t m1_fb_open_file_fastseek(FIL *file, const char *filename, DWORD *pclmt, UINT clmt_size);
+uint8_t m1_fb_expand_file(FIL *file, const char *filename, FSIZE_t size);
+uint8_t m1_fb_sync_expanded_file(FIL *file);
+uint8_t m1_fb_close_truncated_file(FIL *file);
+void m1_fb_trim_expanded_file(void);
 uint8_t m1_fb_close_file(FIL *file);
 uint8_t m1_fb_open_log_file(const char *filename);
 uint8_t m1_fb_close_log_file(void);
 uint8_t m1_fb_delete_file(const char *filename);
-uint16_t m1_fb_write_to_file(FIL *pfile, const char *buffer, uint16_t size);
+FRESULT m1_fb_replace_file(const char *tmp_name, const char *filename);
+FRESULT m1_fb_recover_file(const char *filename);
+static bool m1_fb_backup_name(char *bak_name, const char *filename);
+uint32_t m1_fb_write_to_file(FIL *pfile, const char *buffer, uint32_t size);
 uint16_t m1_fb_read_from_file(FIL *pfile, char *buffer, uint16_t size);
 uint8_t m1_fb_check_low_freespace(void);
+void m1_fb_set_sort(S_M1_file_browser_sort sort);
+void m1_fb_dir_changed(const char *path);
+static uint16_t m1_fb_name_hash(const char *name);
+static uint32_t m1_fb_sort_key(const char *name);
+static uint8_t m1_fb_dir_slot(const char *path, bool parent);
+static void m1_fb_dir_tell(const DIR *dir, S_M1_FB_Cache_Pos *ppos);
+static void m1_fb_dir_seek(DIR *dir, const S_M1_FB_Cache_Pos *ppos);
+static void m1_fb_cache_free(S_M1_FB_Dir_Cache *pcache);
+static bool m1_fb_cache_reclaim(const S_M1_FB_Dir_Cache *pkeep);
+static bool m1_fb_cache_grow(S_M1_FB_Dir_Cache *pcache);
+static FRESULT m1_fb_cache_build(S_M1_FB_Dir_Cache *pcache, const char *dir_name);
+static int m1_fb_cache_compare(const void *pa, const void *pb);
+static int m1_fb_cache_compare_tie(const void *pa, const void *pb);
+static void m1_fb_cache_sort(S_M1_FB_Dir_Cache *pcache, S_M1_file_browser_sort sort);
+static void m1_fb_cache_sort_ties(S_M1_FB_Dir_Cache *pcache);
+static S_M1_FB_Dir_Cache *m1_fb_cache_open(const char *dir_name);
+static FRESULT m1_fb_extent_record_write(void);
+static FRESULT m1_fb_cache_read(S_M1_FB_Dir_Cache *pcache, uint16_t index, FILINFO *pfile_info);
 
 /************** *F U N C T I O N   I M P L E M E N T A T I O N ****************/
 
@@ -193,6 +298,7 @@ uint8_t m1_fb_open_new_file(FIL *file, const char *filename)
 	{
 		return 1;
 	}
+	m1_fb_dir_changed(filename);
 
 	return 0;
 } // uint8_t m1_fb_open_new_file(FIL *file, const char *filename)
@@ -235,7 +341,7 @@ uint16_t m1_fb_read_from_file(FIL *pfile, char *buffer, uint16_t size)
   * @retval number of written bytes
   */
 /******************************************************************************/
-uint16_t m1_fb_write_to_file(FIL *pfile, const char *buffer, uint16_t size)
+uint32_t m1_fb_write_to_file(FIL *pfile, const char *buffer, uint32_t size)
 {
 	UINT byteswritten;
 
@@ -248,7 +354,7 @@ uint16_t m1_fb_write_to_file(FIL *pfile, const char *buffer, uint16_t size)
 	}
 
 	return byteswritten;
-} // uint8_t m1_fb_write_to_file(FIL *pfile, const char *buffer, uint16_t size)
+} // uint32_t m1_fb_write_to_file(FIL *pfile, const char *buffer, uint32_t size)
 
 
 
@@ -263,10 +369,16 @@ uint16_t m1_fb_write_to_file(FIL *pfile, const char *buffer, uint16_t size)
 /******************************************************************************/
 uint8_t m1_fb_open_file(FIL *file, const char *filename)
 {
+	FRESULT fr;
+
 	if ( file==NULL )
 		return 0;
 
-	if (f_open(file, filename, FA_OPEN_EXISTING | FA_READ) != FR_OK)
+	fr = f_open(file, filename, FA_OPEN_EXISTING | FA_READ);
+	// Missing after a replace cut short? The original is back in place if it was saved
+	if ( fr==FR_NO_FILE && m1_fb_recover_file(filename)==FR_OK )
+		fr = f_open(file, filename, FA_OPEN_EXISTING | FA_READ);
+	if (fr != FR_OK)
 	{
 		return 1;
 	}
@@ -276,6 +388,214 @@ uint8_t m1_fb_open_file(FIL *file, const char *filename)
 
 
 
+/******************************************************************************/
+/**
+  * @brief  Open an existing file for reading in fast-seek mode.
+  *         The cluster link map table lets FatFs find any cluster of the file
+  *         without reading the FAT. Files too fragmented for the table are
+  *         opened in normal mode.
+  * @param  filename: name of the file
+  * 		file: pointer to the FIL object
+  * 		pclmt: cluster link map table, must remain valid until the file is closed
+  * 		clmt_size: number of DWORDs in the table
+  * @retval 1 for f_open error, else 0
+  */
+/******************************************************************************/
+uint8_t m1_fb_open_file_fastseek(FIL *file, const char *filename, DWORD *pclmt, UINT clmt_size)
+{
+	if ( m1_fb_open_file(file, filename) )
+		return 1;
+
+	file->cltbl = pclmt;
+	pclmt[0] = clmt_size;
+	if ( f_lseek(file, CREATE_LINKMAP) != FR_OK ) // Table too small?
+	{
+		file->cltbl = NULL; // Fall back to the FAT
+		M1_LOG_D(M1_LOGDB_TAG, "Fast-seek off, %lu DWORDs needed\r\n", pclmt[0]);
+	}
+
+	return 0;
+} // uint8_t m1_fb_open_file_fastseek(FIL *file, const char *filename, DWORD *pclmt, UINT clmt_size)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Write the extent record in place
+  * @retval FRESULT
+  */
+/******************************************************************************/
+static FRESULT m1_fb_extent_record_write(void)
+{
+	FIL file;
+	UINT count;
+	FRESULT fr;
+	bool created;
+
+	fr = f_open(&file, M1_FB_EXTENT_FILENAME, FA_OPEN_ALWAYS | FA_WRITE);
+	if ( fr!=FR_OK )
+		return fr;
+
+	created = (f_size(&file)==0);
+	fr = f_write(&file, &fb_extent_record, sizeof(fb_extent_record), &count);
+	if ( (fr==FR_OK) && (count!=sizeof(fb_extent_record)) )
+		fr = FR_DENIED;
+	if ( f_close(&file)!=FR_OK && fr==FR_OK )
+		fr = FR_DISK_ERR;
+	if ( (fr==FR_OK) && created )
+		f_chmod(M1_FB_EXTENT_FILENAME, AM_HID, AM_HID); // Not listed by the file browser
+
+	return fr;
+} // static FRESULT m1_fb_extent_record_write(void)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Preallocate a contiguous extent to a new, empty file.
+  *         The file size is set to the extent, so writes within it never
+  *         update the FAT. The extent record is written first: if the file
+  *         is not closed with m1_fb_close_truncated_file(), the next mount
+  *         trims it to the data synced with m1_fb_sync_expanded_file().
+  *         One file at a time is preallocated.
+  * @param  file: pointer to the FIL object
+  * 		filename: name the file was opened with
+  * 		size: number of bytes to preallocate
+  * @retval 1 if the file is not preallocated, else 0
+  */
+/******************************************************************************/
+uint8_t m1_fb_expand_file(FIL *file, const char *filename, FSIZE_t size)
+{
+	if ( file==NULL || filename==NULL || pfb_extent_file!=NULL )
+		return 1;
+	if ( strlen(filename) >= sizeof(fb_extent_record.filename) )
+		return 1;
+
+	fb_extent_record.magic = FB_EXTENT_MAGIC;
+	fb_extent_record.size = f_tell(file);
+	strcpy(fb_extent_record.filename, filename);
+	if ( m1_fb_extent_record_write()!=FR_OK )
+		return 1;
+
+	// The directory entry is written with the FAT chain, so no cluster is ever lost
+	if ( f_expand(file, size, 1)!=FR_OK || f_sync(file)!=FR_OK )
+	{
+		f_truncate(file);
+		f_unlink(M1_FB_EXTENT_FILENAME);
+		return 1;
+	}
+	m1_fb_dir_changed(filename);
+	pfb_extent_file = file;
+
+	return 0;
+} // uint8_t m1_fb_expand_file(FIL *file, const char *filename, FSIZE_t size)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Sync a file. For a preallocated file, the extent record is then
+  *         updated with the size of the data written so far.
+  * @param  file: pointer to the FIL object
+  * @retval FRESULT of the first operation that fails, else 0
+  */
+/******************************************************************************/
+uint8_t m1_fb_sync_expanded_file(FIL *file)
+{
+	FRESULT fres;
+
+	fres = f_sync(file);
+	if ( fres!=FR_OK || file!=pfb_extent_file )
+		return fres;
+
+	fb_extent_record.size = f_tell(file); // Written sequentially
+	return m1_fb_extent_record_write();
+} // uint8_t m1_fb_sync_expanded_file(FIL *file)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Close a file written to a preallocated extent.
+  *         The unused part of the extent after the file pointer is released,
+  *         then the extent record is removed.
+  * @param  file: pointer to the FIL object
+  * @retval FRESULT of the first operation that fails, else 0
+  */
+/******************************************************************************/
+uint8_t m1_fb_close_truncated_file(FIL *file)
+{
+	FRESULT fres;
+
+	if ( file==NULL )
+		return 0;
+	if ( file!=pfb_extent_file )
+		return f_close(file);
+
+	pfb_extent_file = NULL;
+	fres = f_truncate(file);
+	if ( fres!=FR_OK )
+	{
+		f_close(file);
+		return fres; // The record stays, the next mount trims the file
+	}
+	fres = f_close(file);
+	m1_fb_dir_changed(fb_extent_record.filename);
+	if ( fres==FR_OK )
+		f_unlink(M1_FB_EXTENT_FILENAME);
+
+	return fres;
+} // uint8_t m1_fb_close_truncated_file(FIL *file)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Trim the file left preallocated by a reset or a card removal to
+  *         the data synced before it, and remove the extent record.
+  *         Called once the card is mounted: a file open before the mount
+  *         cannot be written anymore.
+  * @param  None
+  * @retval None
+  */
+/******************************************************************************/
+void m1_fb_trim_expanded_file(void)
+{
+	S_M1_FB_Extent_Record record;
+	FIL file;
+	UINT count;
+	FRESULT fr;
+
+	pfb_extent_file = NULL;
+	if ( f_open(&file, M1_FB_EXTENT_FILENAME, FA_READ)!=FR_OK )
+		return; // Nothing left preallocated
+	fr = f_read(&file, &record, sizeof(record), &count);
+	f_close(&file);
+	if ( fr!=FR_OK ) // Try again at the next mount
+		return;
+
+	if ( count==sizeof(record) && record.magic==FB_EXTENT_MAGIC && record.filename[sizeof(record.filename) - 1]==0x00 )
+	{
+		if ( f_open(&file, record.filename, FA_WRITE)==FR_OK )
+		{
+			fr = FR_OK;
+			if ( f_size(&file) > record.size )
+			{
+				fr = f_lseek(&file, record.size);
+				if ( fr==FR_OK )
+					fr = f_truncate(&file);
+			}
+			if ( f_close(&file)!=FR_OK || fr!=FR_OK )
+				return;
+			m1_fb_dir_changed(record.filename);
+			M1_LOG_I(M1_LOGDB_TAG, "%s trimmed to %lu bytes\r\n", record.filename, record.size);
+		} // if ( f_open(&file, record.filename, FA_WRITE)==FR_OK )
+	}
+	f_unlink(M1_FB_EXTENT_FILENAME);
+} // void m1_fb_trim_expanded_file(void)
+
+
+
 /******************************************************************************/
 /**
   * @brief  Open a directory
@@ -315,6 +635,7 @@ uint8_t m1_fb_make_dir(const char *directory)
 	{
 		return 1;
 	}
+	m1_fb_dir_changed(directory);
 
 	return 0;
 } // uint8_t m1_fb_make_dir(const char *directory)
@@ -361,7 +682,6 @@ uint8_t m1_fb_close_file(FIL *file)
 
 
 
-
 /******************************************************************************/
 /**
   * @brief  Open log file
@@ -415,12 +735,132 @@ uint8_t m1_fb_delete_file(const char *filename)
 		return 1;
 
 	ret = f_unlink(filename);
+	m1_fb_dir_changed(filename);
 
 	return ret;
 } // uint8_t m1_fb_delete_file(const char *filename)
 
 
 
+/******************************************************************************/
+/**
+  * @brief  Name of the backup of a file, with M1_FB_BACKUP_SUFFIX
+  * @param  bak_name: FF_MAX_LFN + 1 characters
+  * 		filename: name of the file
+  * @retval false if the name is too long
+  */
+/******************************************************************************/
+static bool m1_fb_backup_name(char *bak_name, const char *filename)
+{
+	if ( strlen(filename) + sizeof(M1_FB_BACKUP_SUFFIX) > FF_MAX_LFN + 1 )
+		return false;
+
+	strcpy(bak_name, filename);
+	strcat(bak_name, M1_FB_BACKUP_SUFFIX);
+
+	return true;
+} // static bool m1_fb_backup_name(char *bak_name, const char *filename)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Replace a file with a complete new version written to tmp_name.
+  *         The original is renamed to its backup before the new version takes
+  *         its name, and deleted after. At any point, the file or its backup
+  *         is complete: m1_fb_recover_file() puts the backup back in place if
+  *         the file is missing. If the replace fails, the original is left in
+  *         place and tmp_name is left to the caller.
+  * @param  tmp_name: complete new version, closed
+  * 		filename: file to replace, may not exist yet
+  * @retval FRESULT of the first operation that fails, else FR_OK
+  */
+/******************************************************************************/
+FRESULT m1_fb_replace_file(const char *tmp_name, const char *filename)
+{
+	char bak_name[FF_MAX_LFN + 1];
+	FRESULT fr;
+	bool backup;
+
+	if ( tmp_name==NULL || filename==NULL )
+		return FR_INVALID_PARAMETER;
+	if ( !m1_fb_backup_name(bak_name, filename) )
+		return FR_INVALID_NAME;
+
+	// A replace cut short leaves a backup, of the original or of a file replaced since
+	fr = m1_fb_recover_file(filename);
+	if ( fr!=FR_OK && fr!=FR_NO_FILE )
+		return fr;
+
+	fr = f_rename(filename, bak_name);
+	if ( fr!=FR_OK && fr!=FR_NO_FILE )
+		return fr;
+	backup = (fr==FR_OK);
+
+	fr = f_rename(tmp_name, filename);
+	if ( fr!=FR_OK )
+	{
+		if ( backup )
+			f_rename(bak_name, filename); // Else m1_fb_recover_file() does it
+		return fr;
+	}
+	m1_fb_dir_changed(filename);
+
+	if ( backup )
+	{
+		fr = f_unlink(bak_name);
+		if ( fr!=FR_OK ) // The new version is in place, the next replace deletes the backup
+			M1_LOG_W(M1_LOGDB_TAG, "%s not deleted (%d)\r\n", bak_name, fr);
+	}
+
+	return FR_OK;
+} // FRESULT m1_fb_replace_file(const char *tmp_name, const char *filename)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Finish a replace cut short by a reset or a card removal.
+  *         A missing file is restored from its backup, and the backup of a
+  *         file in place is deleted.
+  * @param  filename: file replaced by m1_fb_replace_file()
+  * @retval FR_OK if the file is in place, FR_NO_FILE if there is neither the
+  * 		file nor its backup, else FRESULT of the operation that fails
+  */
+/******************************************************************************/
+FRESULT m1_fb_recover_file(const char *filename)
+{
+	char bak_name[FF_MAX_LFN + 1];
+	FRESULT fr;
+
+	if ( filename==NULL )
+		return FR_INVALID_PARAMETER;
+	if ( !m1_fb_backup_name(bak_name, filename) )
+		return FR_INVALID_NAME;
+
+	fr = f_stat(filename, NULL);
+	if ( fr==FR_NO_FILE )
+	{
+		fr = f_rename(bak_name, filename);
+		if ( fr==FR_OK )
+		{
+			m1_fb_dir_changed(filename);
+			M1_LOG_I(M1_LOGDB_TAG, "%s restored from its backup\r\n", filename);
+		}
+		return fr;
+	} // if ( fr==FR_NO_FILE )
+	if ( fr!=FR_OK )
+		return fr;
+
+	fr = f_unlink(bak_name);
+	if ( fr==FR_OK )
+		m1_fb_dir_changed(bak_name);
+
+	return (fr==FR_NO_FILE) ? FR_OK:fr;
+} // FRESULT m1_fb_recover_file(const char *filename)
+
+
+
 /******************************************************************************/
 /**
   * @brief  Check for low free space on an SD card
@@ -475,6 +915,634 @@ uint8_t m1_fb_check_low_freespace(void)
 
 
 
+/******************************************************************************/
+/**
+  * @brief  Hash of a file name, to check that a listing is still up to date
+  * @param  name: file name
+  * @retval 16-bit FNV-1a hash
+  */
+/******************************************************************************/
+static uint16_t m1_fb_name_hash(const char *name)
+{
+	uint32_t hash;
+
+	hash = 2166136261UL;
+	while (*name)
+	{
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619UL;
+	}
+
+	return (uint16_t)(hash ^ (hash >> 16));
+} // static uint16_t m1_fb_name_hash(const char *name)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Sort key of a file name
+  * @param  name: file name
+  * @retval first four characters of the name in upper case, first one in the MSB
+  */
+/******************************************************************************/
+static uint32_t m1_fb_sort_key(const char *name)
+{
+	uint32_t key;
+	uint8_t i, c;
+
+	key = 0;
+	for (i=0; i<4; i++)
+	{
+		c = (uint8_t)*name;
+		if ( c )
+		{
+			name++;
+			if ( c >= 'a' && c <= 'z' )
+				c -= 'a' - 'A';
+		}
+		key = (key << 8) | c;
+	} // for (i=0; i<4; i++)
+
+	return key;
+} // static uint32_t m1_fb_sort_key(const char *name)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Change counter of a directory. The drive number, repeated and
+  * 		trailing slashes and the case of the letters are ignored.
+  * @param  path: path of the directory, or of a file or folder in it
+  * 		parent: true if path is a file or folder in the directory
+  * @retval index in fb_dir_generation[]
+  */
+/******************************************************************************/
+static uint8_t m1_fb_dir_slot(const char *path, bool parent)
+{
+	const char *p, *end;
+	uint32_t hash;
+	uint8_t c;
+
+	if ( path[0] && path[1]==':' ) // Drive number?
+		path += 2;
+	end = path + strlen(path);
+	while ( end > path && end[-1]=='/' )
+		end--;
+	if ( parent )
+	{
+		while ( end > path && end[-1]!='/' )
+			end--;
+		while ( end > path && end[-1]=='/' )
+			end--;
+	} // if ( parent )
+
+	hash = 2166136261UL;
+	for (p=path; p<end; p++)
+	{
+		c = (uint8_t)*p;
+		if ( c=='/' && (p==path || p[-1]=='/') )
+			continue;
+		if ( c >= 'a' && c <= 'z' )
+			c -= 'a' - 'A';
+		hash ^= c;
+		hash *= 16777619UL;
+	} // for (p=path; p<end; p++)
+
+	return (uint8_t)(hash % FB_DIR_GENERATIONS);
+} // static uint8_t m1_fb_dir_slot(const char *path, bool parent)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Save the read position of a directory, between two entries.
+  * 		FatFs has no f_telldir(): the position is the offset, cluster and
+  * 		sector of the next entry in the DIR object.
+  * @param  dir: directory being read with f_readdir()
+  * 		ppos: read position
+  * @retval None
+  */
+/******************************************************************************/
+static void m1_fb_dir_tell(const DIR *dir, S_M1_FB_Cache_Pos *ppos)
+{
+	ppos->dptr = dir->dptr;
+	ppos->clust = dir->clust;
+	ppos->sect = dir->sect;
+} // static void m1_fb_dir_tell(const DIR *dir, S_M1_FB_Cache_Pos *ppos)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Go back to a read position saved by m1_fb_dir_tell().
+  * 		dir_read() loads the sector of the position into the window of
+  * 		the volume before it reads the entry pointer set here.
+  * @param  dir: directory opened with f_opendir()
+  * 		ppos: read position
+  * @retval None
+  */
+/******************************************************************************/
+static void m1_fb_dir_seek(DIR *dir, const S_M1_FB_Cache_Pos *ppos)
+{
+	_Static_assert(sizeof(((FATFS *)0)->win)==FF_MAX_SS, "The sector window is one sector");
+
+	dir->dptr = ppos->dptr;
+	dir->clust = ppos->clust;
+	dir->sect = ppos->sect;
+	dir->dir = dir->obj.fs->win + ppos->dptr % FF_MAX_SS;
+} // static void m1_fb_dir_seek(DIR *dir, const S_M1_FB_Cache_Pos *ppos)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Release a directory listing
+  * @param  pcache: listing
+  * @retval None
+  */
+/******************************************************************************/
+static void m1_fb_cache_free(S_M1_FB_Dir_Cache *pcache)
+{
+	free(pcache->dir_name);
+	free(pcache->entry);
+	free(pcache->pos);
+	free(pcache->order);
+	memset(pcache, 0, sizeof(S_M1_FB_Dir_Cache));
+} // static void m1_fb_cache_free(S_M1_FB_Dir_Cache *pcache)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Release all directory listings but one, when memory runs low
+  * @param  pkeep: listing to keep
+  * @retval true if any listing was released
+  */
+/******************************************************************************/
+static bool m1_fb_cache_reclaim(const S_M1_FB_Dir_Cache *pkeep)
+{
+	uint8_t i;
+	bool freed;
+
+	freed = false;
+	for (i=0; i<FB_CACHE_SLOTS; i++)
+	{
+		if ( (&fb_cache[i] != pkeep) && fb_cache[i].dir_name )
+		{
+			m1_fb_cache_free(&fb_cache[i]);
+			freed = true;
+		}
+	} // for (i=0; i<FB_CACHE_SLOTS; i++)
+
+	return freed;
+} // static bool m1_fb_cache_reclaim(const S_M1_FB_Dir_Cache *pkeep)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Make room for FB_CACHE_GROW more entries in a listing
+  * @param  pcache: listing
+  * @retval false if out of memory
+  */
+/******************************************************************************/
+static bool m1_fb_cache_grow(S_M1_FB_Dir_Cache *pcache)
+{
+	S_M1_FB_Cache_Entry *pentry;
+	S_M1_FB_Cache_Pos *ppos;
+	uint32_t capacity;
+
+	capacity = pcache->capacity + FB_CACHE_GROW;
+	if ( capacity > FB_CACHE_ENTRIES_MAX )
+		capacity = FB_CACHE_ENTRIES_MAX;
+
+	do
+	{
+		pentry = realloc(pcache->entry, capacity*sizeof(S_M1_FB_Cache_Entry));
+		if ( pentry )
+		{
+			pcache->entry = pentry;
+			// One more position for the end of the listing
+			ppos = realloc(pcache->pos, (capacity/FB_CACHE_CHECKPOINT + 1)*sizeof(S_M1_FB_Cache_Pos));
+			if ( ppos )
+			{
+				pcache->pos = ppos;
+				pcache->capacity = capacity;
+				return true;
+			}
+		} // if ( pentry )
+	} while ( m1_fb_cache_reclaim(pcache) );
+
+	return false;
+} // static bool m1_fb_cache_grow(S_M1_FB_Dir_Cache *pcache)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Read a directory into a listing, in one pass
+  * @param  pcache: listing, released first
+  * 		dir_name: directory
+  * @retval FRESULT
+  */
+/******************************************************************************/
+static FRESULT m1_fb_cache_build(S_M1_FB_Dir_Cache *pcache, const char *dir_name)
+{
+	FILINFO file_info;
+	FRESULT res;
+	S_M1_FB_Cache_Entry *pentry;
+	uint16_t n_pos;
+
+	m1_fb_cache_free(pcache);
+
+	pcache->dir_name = malloc(strlen(dir_name) + 1);
+	if ( pcache->dir_name==NULL )
+		return FR_NOT_ENOUGH_CORE;
+	strcpy(pcache->dir_name, dir_name);
+
+	// Read before opening, a change during the pass makes the listing out of date
+	pcache->generation = m1_sdcard_get_mount_generation();
+	pcache->dir_slot = m1_fb_dir_slot(dir_name, false);
+	pcache->dir_generation = fb_dir_generation[pcache->dir_slot];
+	res = f_opendir(&pcache->dir, dir_name);
+	n_pos = 0;
+	while ( res==FR_OK )
+	{
+		if ( pcache->num_entries==pcache->capacity )
+		{
+			if ( (pcache->capacity==FB_CACHE_ENTRIES_MAX) || !m1_fb_cache_grow(pcache) )
+			{
+				M1_LOG_E(M1_LOGDB_TAG, "Listing of %s stopped at %u entries\r\n", dir_name, pcache->num_entries);
+				break;
+			}
+		} // if ( pcache->num_entries==pcache->capacity )
+
+		if ( n_pos==pcache->num_entries/FB_CACHE_CHECKPOINT && !(pcache->num_entries % FB_CACHE_CHECKPOINT) )
+			m1_fb_dir_tell(&pcache->dir, &pcache->pos[n_pos++]);
+
+		res = f_readdir(&pcache->dir, &file_info);
+		if ( res != FR_OK || !file_info.fname[0] )
+			break;
+		if ( file_info.fattrib & (AM_HID | AM_SYS) ) // Hidden or system file?
+			continue;
+
+		pentry = &pcache->entry[pcache->num_entries++];
+		pentry->size = (file_info.fsize > 0xFFFFFFFF) ? 0xFFFFFFFF : file_info.fsize;
+		pentry->sort_key = m1_fb_sort_key(file_info.fname);
+		pentry->name_hash = m1_fb_name_hash(file_info.fname);
+		pentry->attrib = file_info.fattrib;
+	} // while ( res==FR_OK )
+
+	if ( res != FR_OK )
+	{
+		m1_fb_cache_free(pcache);
+		return res;
+	}
+	pcache->next = pcache->num_entries; // Read position is unknown
+	pcache->sort = FB_SORT_NONE;
+
+	return FR_OK;
+} // static FRESULT m1_fb_cache_build(S_M1_FB_Dir_Cache *pcache, const char *dir_name)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  qsort() comparison of two entries of the listing being sorted
+  * @param  pa, pb: entry numbers
+  * @retval <0, 0 or >0
+  */
+/******************************************************************************/
+static int m1_fb_cache_compare(const void *pa, const void *pb)
+{
+	const S_M1_FB_Cache_Entry *pea, *peb;
+	uint16_t a, b;
+
+	a = *(const uint16_t *)pa;
+	b = *(const uint16_t *)pb;
+	pea = &pfb_sort_cache->entry[a];
+	peb = &pfb_sort_cache->entry[b];
+
+	if ( (pea->attrib ^ peb->attrib) & AM_DIR )
+		return (pea->attrib & AM_DIR) ? -1 : 1; // Directories first
+
+	if ( pfb_sort_cache->sort==FB_SORT_SIZE )
+	{
+		if ( pea->size != peb->size )
+			return (pea->size < peb->size) ? -1 : 1;
+	}
+	else if ( pea->sort_key != peb->sort_key )
+	{
+		return (pea->sort_key < peb->sort_key) ? -1 : 1;
+	}
+
+	return (int)a - (int)b; // Directory order for the rest, as qsort() is not stable
+} // static int m1_fb_cache_compare(const void *pa, const void *pb)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  qsort() comparison of two entries tied by the start of their
+  * 		names, by the next four characters
+  * @param  pa, pb: entry numbers
+  * @retval <0, 0 or >0
+  */
+/******************************************************************************/
+static int m1_fb_cache_compare_tie(const void *pa, const void *pb)
+{
+	uint16_t a, b;
+
+	a = *(const uint16_t *)pa;
+	b = *(const uint16_t *)pb;
+	if ( pfb_sort_tie_key[a] != pfb_sort_tie_key[b] )
+		return (pfb_sort_tie_key[a] < pfb_sort_tie_key[b]) ? -1 : 1;
+
+	return (int)a - (int)b;
+} // static int m1_fb_cache_compare_tie(const void *pa, const void *pb)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Sort a listing without reading the directory again
+  * @param  pcache: listing
+  * 		sort: new order
+  * @retval None
+  */
+/******************************************************************************/
+static void m1_fb_cache_sort(S_M1_FB_Dir_Cache *pcache, S_M1_file_browser_sort sort)
+{
+	uint16_t i;
+
+	if ( sort==FB_SORT_NONE || !pcache->num_entries )
+	{
+		free(pcache->order);
+		pcache->order = NULL;
+		pcache->sort = sort;
+		return;
+	}
+
+	if ( pcache->order==NULL )
+	{
+		pcache->order = malloc(pcache->num_entries*sizeof(uint16_t));
+		if ( pcache->order==NULL )
+		{
+			M1_LOG_E(M1_LOGDB_TAG, "No memory to sort %s\r\n", pcache->dir_name);
+			return; // Stay in directory order
+		}
+	} // if ( pcache->order==NULL )
+
+	for (i=0; i<pcache->num_entries; i++)
+		pcache->order[i] = i;
+	pcache->sort = sort;
+	pfb_sort_cache = pcache;
+	qsort(pcache->order, pcache->num_entries, sizeof(uint16_t), m1_fb_cache_compare);
+	if ( sort==FB_SORT_NAME )
+		m1_fb_cache_sort_ties(pcache);
+} // static void m1_fb_cache_sort(S_M1_FB_Dir_Cache *pcache, S_M1_file_browser_sort sort)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Order the entries of a listing sorted by name that have the same
+  * 		first four characters. Names are not kept, so each pass over the
+  * 		directory reads the next four characters of the entries still
+  * 		tied, until the names differ or end.
+  * @param  pcache: listing sorted by the sort keys
+  * @retval None
+  */
+/******************************************************************************/
+static void m1_fb_cache_sort_ties(S_M1_FB_Dir_Cache *pcache)
+{
+	FILINFO *pfile_info;
+	DIR dir;
+	FRESULT res;
+	uint32_t *pkey;
+	uint8_t *ptied; // Entries still tied, bit per entry in directory order
+	uint8_t *pgroup; // Bit set on the first entry of each group of ties, in display order
+	uint16_t n, i, j, k, offset;
+	bool tied;
+
+	n = pcache->num_entries;
+	pfile_info = malloc(sizeof(FILINFO) + n*sizeof(uint32_t) + 2*((n + 7)/8));
+	if ( pfile_info==NULL )
+	{
+		M1_LOG_E(M1_LOGDB_TAG, "No memory to sort %s\r\n", pcache->dir_name);
+		return; // Ties stay in directory order
+	}
+	pkey = (uint32_t *)(pfile_info + 1);
+	ptied = (uint8_t *)(pkey + n);
+	pgroup = ptied + (n + 7)/8;
+
+	memset(pgroup, 0, (n + 7)/8);
+	for (k=0; k<n; k++)
+		pkey[k] = pcache->entry[k].sort_key;
+	for (i=0; i<n; i++)
+	{
+		if ( !i || pkey[pcache->order[i - 1]]!=pkey[pcache->order[i]] ||
+			((pcache->entry[pcache->order[i - 1]].attrib ^ pcache->entry[pcache->order[i]].attrib) & AM_DIR) )
+			pgroup[i/8] |= 1 << (i % 8);
+	} // for (i=0; i<n; i++)
+
+	for (offset=4; offset<=FF_LFN_BUF; offset+=4)
+	{
+		// Groups of more than one entry whose names go on after the last characters compared
+		memset(ptied, 0, (n + 7)/8);
+		tied = false;
+		for (i=0; i<n; i=j)
+		{
+			for (j=i + 1; j<n && !(pgroup[j/8] & (1 << (j % 8))); j++)
+				;
+			if ( j - i < 2 || !(pkey[pcache->order[i]] & 0xFF) )
+				continue;
+			for (k=i; k<j; k++)
+				ptied[pcache->order[k]/8] |= 1 << (pcache->order[k] % 8);
+			tied = true;
+		} // for (i=0; i<n; i=j)
+		if ( !tied )
+			break;
+
+		res = f_opendir(&dir, pcache->dir_name);
+		k = 0;
+		while ( res==FR_OK && k<n )
+		{
+			res = f_readdir(&dir, pfile_info);
+			if ( res != FR_OK || !pfile_info->fname[0] )
+				break;
+			if ( pfile_info->fattrib & (AM_HID | AM_SYS) )
+				continue;
+			if ( ptied[k/8] & (1 << (k % 8)) )
+				pkey[k] = (strlen(pfile_info->fname) > offset) ? m1_fb_sort_key(pfile_info->fname + offset) : 0;
+			k++;
+		} // while ( res==FR_OK && k<n )
+		f_closedir(&dir);
+		if ( k<n ) // Changed since the listing was read, m1_fb_cache_read() finds it out
+			break;
+
+		pfb_sort_tie_key = pkey;
+		for (i=0; i<n; i=j)
+		{
+			for (j=i + 1; j<n && !(pgroup[j/8] & (1 << (j % 8))); j++)
+				;
+			if ( !(ptied[pcache->order[i]/8] & (1 << (pcache->order[i] % 8))) )
+				continue;
+			qsort(&pcache->order[i], j - i, sizeof(uint16_t), m1_fb_cache_compare_tie);
+			for (k=i + 1; k<j; k++)
+			{
+				if ( pkey[pcache->order[k - 1]]!=pkey[pcache->order[k]] )
+					pgroup[k/8] |= 1 << (k % 8);
+			}
+		} // for (i=0; i<n; i=j)
+	} // for (offset=4; offset<=FF_LFN_BUF; offset+=4)
+
+	free(pfile_info);
+} // static void m1_fb_cache_sort_ties(S_M1_FB_Dir_Cache *pcache)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Get the listing of a directory, reading the directory only if
+  * 		it is not cached, or has changed or the SD card has been mounted
+  * 		again since
+  * @param  dir_name: directory
+  * @retval listing, NULL for error
+  */
+/******************************************************************************/
+static S_M1_FB_Dir_Cache *m1_fb_cache_open(const char *dir_name)
+{
+	S_M1_FB_Dir_Cache *pcache, *plru;
+	uint8_t i;
+
+	pcache = NULL;
+	plru = &fb_cache[0];
+	for (i=0; i<FB_CACHE_SLOTS; i++)
+	{
+		if ( fb_cache[i].dir_name && !strcmp(fb_cache[i].dir_name, dir_name) )
+		{
+			pcache = &fb_cache[i];
+			break;
+		}
+		if ( fb_cache[i].last_use < plru->last_use ) // Free slots are never used
+			plru = &fb_cache[i];
+	} // for (i=0; i<FB_CACHE_SLOTS; i++)
+
+	if ( pcache==NULL || pcache->generation != m1_sdcard_get_mount_generation() ||
+		pcache->dir_generation != fb_dir_generation[pcache->dir_slot] )
+	{
+		if ( pcache==NULL )
+			pcache = plru;
+		if ( m1_fb_cache_build(pcache, dir_name) != FR_OK )
+			return NULL;
+	}
+
+	if ( pcache->sort != fb_sort )
+		m1_fb_cache_sort(pcache, fb_sort);
+	pcache->last_use = ++fb_cache_use;
+
+	return pcache;
+} // static S_M1_FB_Dir_Cache *m1_fb_cache_open(const char *dir_name)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Read an entry of a listing from the directory
+  * @param  pcache: listing
+  * 		index: entry in display order
+  * 		pfile_info: file information of the entry
+  * @retval FRESULT, FR_INT_ERR if the directory no longer matches the listing
+  */
+/******************************************************************************/
+static FRESULT m1_fb_cache_read(S_M1_FB_Dir_Cache *pcache, uint16_t index, FILINFO *pfile_info)
+{
+	const S_M1_FB_Cache_Entry *pentry;
+	FRESULT res;
+	uint16_t k, n_pos;
+
+	if ( index >= pcache->num_entries )
+		return FR_INVALID_PARAMETER;
+
+	k = pcache->order ? pcache->order[index] : index;
+	n_pos = k/FB_CACHE_CHECKPOINT;
+	// Read on from the current position if the entry is close ahead of it,
+	// else start again from the saved position before the entry
+	if ( k < pcache->next || n_pos > pcache->next/FB_CACHE_CHECKPOINT )
+	{
+		m1_fb_dir_seek(&pcache->dir, &pcache->pos[n_pos]);
+		pcache->next = n_pos*FB_CACHE_CHECKPOINT;
+	}
+
+	while (1)
+	{
+		res = f_readdir(&pcache->dir, pfile_info);
+		if ( res != FR_OK )
+			break;
+		if ( !pfile_info->fname[0] )
+		{
+			res = FR_INT_ERR; // End of directory before the entry
+			break;
+		}
+		if ( pfile_info->fattrib & (AM_HID | AM_SYS) ) // Hidden or system file?
+			continue;
+		if ( pcache->next++==k )
+			break;
+	} // while (1)
+
+	if ( res != FR_OK )
+	{
+		pcache->next = pcache->num_entries;
+		return res;
+	}
+
+	// A file written without m1_fb_dir_changed() shows up here by its size
+	pentry = &pcache->entry[k];
+	if ( pentry->name_hash != m1_fb_name_hash(pfile_info->fname) || pentry->attrib != pfile_info->fattrib ||
+		pentry->size != ((pfile_info->fsize > 0xFFFFFFFF) ? 0xFFFFFFFF : pfile_info->fsize) )
+		return FR_INT_ERR;
+
+	return FR_OK;
+} // static FRESULT m1_fb_cache_read(S_M1_FB_Dir_Cache *pcache, uint16_t index, FILINFO *pfile_info)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Set the order of the files and folders shown
+  * @param  sort: new order, applied to the listings as they are shown
+  * @retval None
+  */
+/******************************************************************************/
+void m1_fb_set_sort(S_M1_file_browser_sort sort)
+{
+	if ( sort < FB_SORT_EOL )
+		fb_sort = sort;
+} // void m1_fb_set_sort(S_M1_file_browser_sort sort)
+
+
+
+/******************************************************************************/
+/**
+  * @brief  Record a change in a directory: a file or folder created,
+  * 		deleted, renamed or written to. The listing of the directory is
+  * 		read again the next time it is shown. May be called from any task.
+  * @param  path: file or folder changed
+  * @retval None
+  */
+/******************************************************************************/
+void m1_fb_dir_changed(const char *path)
+{
+	if ( path==NULL )
+		return;
+
+	fb_dir_generation[m1_fb_dir_slot(path, true)]++;
+	fb_dir_generation[m1_fb_dir_slot(path, false)]++; // Listing of a deleted or renamed folder
+} // void m1_fb_dir_changed(const char *path)
+
+
+
 /******************************************************************************/
 /*
 *	This function displays files and folders on the LCD
@@ -485,19 +1553,18 @@ S_M1_file_info *m1_fb_display(S_M1_Buttons_Status *button_status)
 {
 	char name[FF_MAX_LFN + 1];
 	FRESULT res;
-	static DIR directory;
-	FILINFO file_info, this_file;
+	S_M1_FB_Dir_Cache *pcache;
+	FILINFO file_info;
 	const S_M1_menu_icon_data *fb_icon;
 	S_M1_file_browser_ext f_ext;
-	static uint16_t num_of_files;
+	uint16_t num_of_files;
 	static uint16_t gui_max_column, gui_max_row;
 	static uint16_t gui_width, gui_height;
-	static uint16_t scroll_h;
-	uint16_t scroll_y, count, len;
+	uint16_t scroll_h, scroll_y, count, first, len;
 	uint16_t l, k;
-	uint8_t y_offset, disp_max_column, ext_len;
+	uint8_t y_offset, disp_max_column, ext_len, attempt;
 	static uint8_t spacing;
-	static bool scroll_ok;
+	bool scroll_ok;
 	bool flag;
 
 	if (!fb_gui_check)
@@ -524,39 +1591,22 @@ S_M1_file_info *m1_fb_display(S_M1_Buttons_Status *button_status)
 
 	while (1) // Not an endless loop
 	{
-		if (button_status==NULL)
+		// Listing is read from the SD card only on the first visit or after a change
+		pcache = m1_fb_cache_open(pfb_hdl->info.dir_name);
+		if (pcache==NULL)
 		{
-			res = f_opendir(&directory, pfb_hdl->info.dir_name);
+			pfb_hdl->info.status = FB_ERR_SDCARD;
+			return &pfb_hdl->info;
+		}
+		num_of_files = pcache->num_entries + 1; // .. is the first row
 
-			if (res != FR_OK)
-			{
-				pfb_hdl->info.status = FB_ERR_SDCARD;
-				return &pfb_hdl->info;
-			}
+		if (button_status==NULL)
+		{
 			if (!pfb_hdl->info.file_is_selected)
 			{
 				pfb_hdl->listing_index = pfb_hdl->listing_index_buffer[pfb_hdl->dir_level];
 				pfb_hdl->row_index = pfb_hdl->row_index_buffer[pfb_hdl->dir_level];
 			}
-
-		    num_of_files = 1;
-		    while (num_of_files < FILE_BROWSER_MAX_FILES)
-		    {
-		    	res = f_readdir(&directory, &file_info);
-		    	if (res || !file_info.fname[0])
-		    		break;
-		    	if (!(file_info.fattrib & (AM_HID | AM_SYS))) // Not a system or hidden file?
-		    		num_of_files++;
-		    } // while (num_of_files < FILE_BROWSER_MAX_FILES)
-
-			scroll_h = gui_height / num_of_files;
-
-			if (scroll_h < pfb_hdl->font_h)
-				scroll_h = pfb_hdl->font_h;
-
-			scroll_ok = FALSE;
-			if ((num_of_files > gui_max_row) && (gui_max_column > 3))
-				scroll_ok = TRUE;
 		} // if (button_status==NULL)
 
 		// Reading keys from user
@@ -584,6 +1634,15 @@ S_M1_file_info *m1_fb_display(S_M1_Buttons_Status *button_status)
 	       		} // if ( pfb_hdl->listing_index > 0 )
 	       	} // else if ( button_status->event[BUTTON_UP_KP_ID]==BUTTON_EVENT_CLICK )
 
+	       	else if ( button_status->event[BUTTON_RIGHT_KP_ID]==BUTTON_EVENT_CLICK )
+	       	{
+	       		// Next order, the listing is sorted in memory
+	       		m1_fb_set_sort((fb_sort + 1) % FB_SORT_EOL);
+	       		m1_fb_cache_sort(pcache, fb_sort);
+	       		pfb_hdl->listing_index = 0;
+	       		pfb_hdl->row_index = 0;
+	       	} // else if ( button_status->event[BUTTON_RIGHT_KP_ID]==BUTTON_EVENT_CLICK )
+
 	       	else if ( button_status->event[BUTTON_OK_KP_ID]==BUTTON_EVENT_CLICK )
 	       	{
 	       		if (!pfb_hdl->listing_index) // Being at the .. directory
@@ -613,18 +1672,31 @@ S_M1_file_info *m1_fb_display(S_M1_Buttons_Status *button_status)
 	       			}
 	       			pfb_hdl->info.file_is_selected = FALSE;
 
-	       			f_closedir(&directory);
 	       			button_status = NULL; // Reset so that the conditional loop will be executed one more time
 	       			continue;
 	       		} // if (!pfb_hdl->listing_index)
 
-	       		if (this_file.fattrib & AM_DIR)
+	       		res = m1_fb_cache_read(pcache, pfb_hdl->listing_index - 1, &file_info);
+	       		if (res != FR_OK) // Directory changed without a write through this device?
+	       		{
+	       			m1_fb_cache_free(pcache);
+	       			pcache = m1_fb_cache_open(pfb_hdl->info.dir_name);
+	       			if (pcache != NULL)
+	       				res = m1_fb_cache_read(pcache, pfb_hdl->listing_index - 1, &file_info);
+	       			if (res != FR_OK)
+	       			{
+	       				pfb_hdl->info.status = FB_ERR_SDCARD;
+	       				break;
+	       			}
+	       		} // if (res != FR_OK)
+
+	       		if (file_info.fattrib & AM_DIR)
 	       		{
 	       			if ( pfb_hdl->dir_level >= DIRECTORY_MAX_DEPTH_LEVEL )
 	       				break; // Do nothing if it goes too deep
-	       			pfb_hdl->info.dir_name = (TCHAR *)realloc(pfb_hdl->info.dir_name, strlen(pfb_hdl->info.dir_name) + 1 + 1 + strlen(this_file.fname));
+	       			pfb_hdl->info.dir_name = (TCHAR *)realloc(pfb_hdl->info.dir_name, strlen(pfb_hdl->info.dir_name) + 1 + 1 + strlen(file_info.fname));
 	       			strcat(pfb_hdl->info.dir_name, "/");
-	       			strcat(pfb_hdl->info.dir_name, this_file.fname);
+	       			strcat(pfb_hdl->info.dir_name, file_info.fname);
 	       			pfb_hdl->listing_index_buffer[pfb_hdl->dir_level] = pfb_hdl->listing_index;
 	       			pfb_hdl->row_index_buffer[pfb_hdl->dir_level] = pfb_hdl->row_index;
 	       			pfb_hdl->dir_level++;
@@ -634,151 +1706,160 @@ S_M1_file_info *m1_fb_display(S_M1_Buttons_Status *button_status)
 	       			pfb_hdl->row_index_buffer[pfb_hdl->dir_level] = 0;
 	       			pfb_hdl->info.file_is_selected = FALSE;
 
-	       			f_closedir(&directory);
 	       			button_status = NULL; // Reset so that the conditional loop will be executed one more time
 	       			continue;
-	       		} // if (this_file.fattrib & AM_DIR)
+	       		} // if (file_info.fattrib & AM_DIR)
 
 	       		else
 	       		{
 	       		    if (pfb_hdl->info.file_name)
 	       		    	free(pfb_hdl->info.file_name);
-	       		    pfb_hdl->info.file_name = (char *)calloc(strlen(this_file.fname) + 1, 1);
+	       		    pfb_hdl->info.file_name = (char *)calloc(strlen(file_info.fname) + 1, 1);
 	       		    assert_param(pfb_hdl->info.file_name!=NULL);
 	       		    if ( pfb_hdl->info.file_name )
 	       		    {
-	       		    	strcpy(pfb_hdl->info.file_name, this_file.fname);
+	       		    	strcpy(pfb_hdl->info.file_name, file_info.fname);
 	       		    	pfb_hdl->info.status = FB_OK;
 	       		    	pfb_hdl->info.file_is_selected = TRUE;
 	       		    } // if ( pfb_hdl->info.file_name )
 
-	       		    f_closedir(&directory);
 	       			break;
 	       		}
 	       	} // else if ( button_status->event[BUTTON_OK_KP_ID]==BUTTON_EVENT_CLICK )
 		} // else
 		// if (button_status==NULL)
 
-    	res = f_readdir(&directory, 0);
-    	if ( res != FR_OK)
-    	{
-    		pfb_hdl->info.status = FB_ERR_SDCARD;
-    		break;
-    	} // if ( res != FR_OK)
+		for (attempt=0; attempt<2; attempt++)
+		{
+			// The listing may have shrunk since the position was saved
+			if ( pfb_hdl->listing_index >= num_of_files )
+				pfb_hdl->listing_index = num_of_files - 1;
+			if ( pfb_hdl->row_index > pfb_hdl->listing_index )
+				pfb_hdl->row_index = pfb_hdl->listing_index;
 
-    	// Clear GUI
-    	m1_u8g2_firstpage();
-    	//m1_lcd_cleardisplay();
+			scroll_h = gui_height / num_of_files;
+			if (scroll_h < pfb_hdl->font_h)
+				scroll_h = pfb_hdl->font_h;
 
-    	count = 0;
-    	y_offset = 0;
-       	while (count < num_of_files)
-       	{
-       		name[0] = 0;
-   			if (count)
-   			{
-   				res = f_readdir(&directory, &file_info);
-   				if (res || !file_info.fname[0])
-   					break;
-
-   				if ((file_info.fattrib & (AM_HID | AM_SYS))) // Hidden and System file?
-   					continue;
-   			}
-
-   			if ((count >= pfb_hdl->listing_index - pfb_hdl->row_index) &&
-   				(count < pfb_hdl->listing_index - pfb_hdl->row_index + gui_max_row))
-   			{
-   				if (!count)
-   				{
-   					strcpy(name, "..");
-   					fb_icon = &menu_fb_icon_prev;
-   				}
-   				else
-  				{
-   					len = strlen(file_info.fname);
-   					disp_max_column = gui_max_column - 1 - scroll_ok;
-   					if (len <= disp_max_column)
-   					{
-   						strcpy(name, file_info.fname);
-   					}
-   					else
-   					{
-   						if (file_info.fattrib & AM_DIR)
-   						{
-   							strncpy(name, file_info.fname, disp_max_column - 2);
-   							name[disp_max_column - 2] = 0;
-   							strcat(name, "..");
-   						}
-   						else
-   						{
-   							flag = FALSE;
-   							while (len)
-   							{
-   								if (file_info.fname[len-1]=='.')
-   								{
-   									flag = TRUE;
-   									break;
-   								}
-   								len--;
-   							}
-   							if (!flag) // filename without extension
-   							{
-   								strncpy(name, file_info.fname, disp_max_column - 2);
-   								name[disp_max_column - 2] = 0;
-   								strcat(name, "..");
-   							}
-   							else
-   							{
-   								ext_len = strlen(&file_info.fname[len - 1]);
-   								if ( ext_len > 4 ) // the dot (.) + extension
-   									ext_len = 4;
-   								if ( len > disp_max_column )
-   								{
-   	   								strncpy(name, file_info.fname, disp_max_column - 2 - ext_len);
-   	   								name[disp_max_column - 2 - ext_len] = 0;
-   	   								strcat(name, "..");
-   	   								strncat(name, &file_info.fname[len - 1], ext_len);
-   								}
-   								else
-   								{
-   	   								strncpy(name, file_info.fname, disp_max_column);
-   	   								name[disp_max_column] = 0;
-   								}
-   							} // else
-   						} // else
-   					} // else
-
-       				if (file_info.fattrib & AM_DIR)
-       				{
-       					fb_icon = &menu_fb_icon_dir;
-       				}
-       				else
-       				{
-       					f_ext = m1_fb_get_file_type(file_info.fname);
-       					if (f_ext==F_EXT_DATA)
-       						fb_icon = &menu_fb_icon_data;
-       					else
-       						fb_icon = &menu_fb_icon_other;
-       				}
-
-       				if (count==pfb_hdl->listing_index)
-       				{
-       					memcpy(&this_file, &file_info, sizeof(FILINFO));
-       				}
-       			} // else
-   					// if (!count)
-
-   				y_offset += spacing;
-   				// Draw icon of folder or file
-   				u8g2_DrawXBMP(plcd_hdl, pfb_hdl->x, pfb_hdl->y + y_offset + (pfb_hdl->font_h - fb_icon->icon_h), fb_icon->icon_w, fb_icon->icon_h, fb_icon->pdata);
-
-    			y_offset += pfb_hdl->font_h;
-    			// Draw text of file name or folder name
-   				u8g2_DrawStr(plcd_hdl, pfb_hdl->x + fb_icon->icon_w + 2, pfb_hdl->y + y_offset, name);
-       		} // if ((count >= pfb_hdl->listing_index - pfb_hdl->row_index) &&
-				// (count < pfb_hdl->listing_index - pfb_hdl->row_index + gui_max_row))
-   			count++;
-       	} // while (count < num_of_files)
+			scroll_ok = FALSE;
+			if ((num_of_files > gui_max_row) && (gui_max_column > 3))
+				scroll_ok = TRUE;
+
+			// Clear GUI
+			m1_u8g2_firstpage();
+			//m1_lcd_cleardisplay();
+
+			// Only the rows on screen are read from the directory
+			res = FR_OK;
+			y_offset = 0;
+			first = pfb_hdl->listing_index - pfb_hdl->row_index;
+			for (count = first; (count < num_of_files) && (count < first + gui_max_row); count++)
+			{
+				name[0] = 0;
+				if (!count)
+				{
+					strcpy(name, "..");
+					fb_icon = &menu_fb_icon_prev;
+				}
+				else
+				{
+					res = m1_fb_cache_read(pcache, count - 1, &file_info);
+					if (res != FR_OK)
+						break;
+
+					len = strlen(file_info.fname);
+					disp_max_column = gui_max_column - 1 - scroll_ok;
+					if (len <= disp_max_column)
+					{
+						strcpy(name, file_info.fname);
+					}
+					else
+					{
+						if (file_info.fattrib & AM_DIR)
+						{
+							strncpy(name, file_info.fname, disp_max_column - 2);
+							name[disp_max_column - 2] = 0;
+							strcat(name, "..");
+						}
+						else
+						{
+							flag = FALSE;
+							while (len)
+							{
+								if (file_info.fname[len-1]=='.')
+								{
+									flag = TRUE;
+									break;
+								}
+								len--;
+							}
+							if (!flag) // filename without extension
+							{
+								strncpy(name, file_info.fname, disp_max_column - 2);
+								name[disp_max_column - 2] = 0;
+								strcat(name, "..");
+							}
+							else
+							{
+								ext_len = strlen(&file_info.fname[len - 1]);
+								if ( ext_len > 4 ) // the dot (.) + extension
+									ext_len = 4;
+								if ( len > disp_max_column )
+								{
+									strncpy(name, file_info.fname, disp_max_column - 2 - ext_len);
+									name[disp_max_column - 2 - ext_len] = 0;
+									strcat(name, "..");
+									strncat(name, &file_info.fname[len - 1], ext_len);
+								}
+								else
+								{
+									strncpy(name, file_info.fname, disp_max_column);
+									name[disp_max_column] = 0;
+								}
+							} // else
+						} // else
+					} // else
+
+					if (file_info.fattrib & AM_DIR)
+					{
+						fb_icon = &menu_fb_icon_dir;
+					}
+					else
+					{
+						f_ext = m1_fb_get_file_type(file_info.fname);
+						if (f_ext==F_EXT_DATA)
+							fb_icon = &menu_fb_icon_data;
+						else
+							fb_icon = &menu_fb_icon_other;
+					}
+				} // else
+					// if (!count)
+
+				y_offset += spacing;
+				// Draw icon of folder or file
+				u8g2_DrawXBMP(plcd_hdl, pfb_hdl->x, pfb_hdl->y + y_offset + (pfb_hdl->font_h - fb_icon->icon_h), fb_icon->icon_w, fb_icon->icon_h, fb_icon->pdata);
+
+				y_offset += pfb_hdl->font_h;
+				// Draw text of file name or folder name
+				u8g2_DrawStr(plcd_hdl, pfb_hdl->x + fb_icon->icon_w + 2, pfb_hdl->y + y_offset, name);
+			} // for (count = first; (count < num_of_files) && (count < first + gui_max_row); count++)
+
+			if (res==FR_OK)
+				break;
+
+			// Directory changed without a write through this device, read it again
+			m1_fb_cache_free(pcache);
+			pcache = m1_fb_cache_open(pfb_hdl->info.dir_name);
+			if (pcache==NULL)
+				break;
+			num_of_files = pcache->num_entries + 1;
+		} // for (attempt=0; attempt<2; attempt++)
+
+		if (res != FR_OK)
+		{
+			pfb_hdl->info.status = FB_ERR_SDCARD;
+			break;
+		}
 
        	// Draw a frame around the selected file/sub-directory
        	u8g2_DrawFrame(plcd_hdl, pfb_hdl->x, pfb_hdl->y + pfb_hdl->row_index * (pfb_hdl->font_h + spacing) + spacing/2,
@@ -790,7 +1871,7 @@ S_M1_file_info *m1_fb_display(S_M1_Buttons_Status *button_status)
        	if (scroll_ok)
        	{
        		// Scroll bar position
-       		scroll_y = (pfb_hdl->listing_index - pfb_hdl->row_index) * (M1_LCD_DISPLAY_HEIGHT - scroll_h) / (num_of_files - gui_max_row);
+       		scroll_y = (uint32_t)(pfb_hdl->listing_index - pfb_hdl->row_index) * (M1_LCD_DISPLAY_HEIGHT - scroll_h) / (num_of_files - gui_max_row);
        		// Scroll bar
        		u8g2_DrawFrame(plcd_hdl, pfb_hdl->x + M1_LCD_DISPLAY_WIDTH - GUI_SCROLLBAR_WIDTH, pfb_hdl->y, GUI_SCROLLBAR_WIDTH, M1_LCD_DISPLAY_HEIGHT);
        		// Scroll bar slider
@@ -820,100 +1901,70 @@ FRESULT m1_fb_listing(const char *dir_name)
 	char name[FF_MAX_LFN + 1];
 	FRESULT res;
 	DIR directory;
-	FILINFO file_info, this_file;
-	uint16_t num_of_files;
-	uint16_t count, len;
+	FILINFO file_info;
+	uint16_t len;
 	bool flag;
 
-	while (1) // Not an endless loop
+	res = f_opendir(&directory, dir_name);
+	if (res != FR_OK)
 	{
-		res = f_opendir(&directory, dir_name);
-		if (res != FR_OK)
-		{
+		return res;
+	}
+
+	// Names are shown as they are read, in a single pass
+	M1_LOG_N(M1_LOGDB_TAG, "..\r\n");
+	while (1)
+	{
+		res = f_readdir(&directory, &file_info);
+		if (res || !file_info.fname[0])
 			break;
+
+		if ((file_info.fattrib & (AM_HID | AM_SYS))) // Hidden and System file?
+			continue;
+
+		if (strlen(file_info.fname) <= FILENAME_LEN_ON_CLI_MAX)
+		{
+			strcpy(name, file_info.fname);
 		}
-	    num_of_files = 1;
-	    while (num_of_files < FILE_BROWSER_MAX_FILES)
-	    {
-	    	res = f_readdir(&directory, &file_info);
-	    	if (res || !file_info.fname[0])
-	    		break;
-	    	if (!(file_info.fattrib & (AM_HID | AM_SYS))) // Not a system or hidden file?
-	    		num_of_files++;
-	    } // while (num_of_files < FILE_BROWSER_MAX_FILES)
-
-    	res = f_readdir(&directory, 0);
-    	if ( res != FR_OK)
-    	{
-    		break;
-    	} // if ( res != FR_OK)
-
-    	count = 0;
-       	while (count < num_of_files)
-       	{
-       		name[0] = 0;
-   			if (count)
-   			{
-   				res = f_readdir(&directory, &file_info);
-   				if (res || !file_info.fname[0])
-   					break;
-
-   				if ((file_info.fattrib & (AM_HID | AM_SYS))) // Hidden and System file?
-   					continue;
-   			} // if (count)
-
-			if (!count)
+		else
+		{
+			if (file_info.fattrib & AM_DIR)
 			{
-				strcpy(name, "..");
+				strncpy(name, file_info.fname, FILENAME_LEN_ON_CLI_MAX);
+				name[FILENAME_LEN_ON_CLI_MAX] = 0;
+				strcat(name, "..");
 			}
 			else
 			{
-				if (strlen(file_info.fname) <= FILENAME_LEN_ON_CLI_MAX)
+				len = strlen(file_info.fname);
+				flag = FALSE;
+				while (len)
 				{
-					strcpy(name, file_info.fname);
+					if (file_info.fname[len-1]=='.')
+					{
+						flag = TRUE;
+						break;
+					}
+					len--;
+				}
+				if (!flag || len==1)
+				{
+					strncpy(name, file_info.fname, FILENAME_LEN_ON_CLI_MAX);
+					name[FILENAME_LEN_ON_CLI_MAX] = 0;
+					strcat(name, "..");
 				}
 				else
 				{
-					if (file_info.fattrib & AM_DIR)
-					{
-						strncpy(name, file_info.fname, FILENAME_LEN_ON_CLI_MAX);
-						name[FILENAME_LEN_ON_CLI_MAX] = 0;
-						strcat(name, "..");
-					}
-					else
-					{
-						len = strlen(file_info.fname);
-						flag = FALSE;
-						while (len)
-						{
-							if (file_info.fname[len-1]=='.')
-							{
-								flag = TRUE;
-								break;
-							}
-							len--;
-						}
-						if (!flag || len==1)
-						{
-							strncpy(name, file_info.fname, FILENAME_LEN_ON_CLI_MAX);
-							name[FILENAME_LEN_ON_CLI_MAX] = 0;
-							strcat(name, "..");
-						}
-						else
-						{
-							strncpy(name, file_info.fname, FILENAME_LEN_ON_CLI_MAX - strlen(file_info.fname + len));
-							strncat(name, "..", FILENAME_LEN_ON_CLI_MAX - (strlen(name) + strlen(file_info.fname + len)));
-							strncat(name, file_info.fname + len, FILENAME_LEN_ON_CLI_MAX - strlen(name));
-						}
-					} // else
-				} // else
-   			} // else
-					// if (!count)
-			M1_LOG_N(M1_LOGDB_TAG, "%s\r\n", name);
-   			count++;
-       	} // while (count < num_of_files)
-       	break; // End this loop
-	} // while (1) // Not an endless loop
+					strncpy(name, file_info.fname, FILENAME_LEN_ON_CLI_MAX - strlen(file_info.fname + len));
+					strncat(name, "..", FILENAME_LEN_ON_CLI_MAX - (strlen(name) + strlen(file_info.fname + len)));
+					strncat(name, file_info.fname + len, FILENAME_LEN_ON_CLI_MAX - strlen(name));
+				}
+			} // else
+		} // else
+		M1_LOG_N(M1_LOGDB_TAG, "%s\r\n", name);
+	} // while (1)
+
+	f_closedir(&directory);
 
 	return res;
 } // FRESULT m1_fb_listing(const char *dir_name)
@@ -928,6 +1979,15 @@ FRESULT m1_fb_listing(const char *dir_name)
 /******************************************************************************/
 void m1_fb_deinit(void)
 {
+	uint8_t i;
+
+	// Keep only the listing of the root directory, where the browser starts
+	for (i=0; i<FB_CACHE_SLOTS; i++)
+	{
+		if ( fb_cache[i].dir_name && strcmp(fb_cache[i].dir_name, SDCARD_DEFAULT_DRIVE_PATH) )
+			m1_fb_cache_free(&fb_cache[i]);
+	}
+
 	if (pfb_hdl)
 	{
 		if (pfb_hdl->listing_index_buffer)
@@ -24,6 +24,14 @@ typedef enum
 	F_EXT_OTHER
 } S_M1_file_browser_ext;
 
+typedef enum
+{
+	FB_SORT_NONE = 0, // Directory order
+	FB_SORT_NAME, // Directories first, then by name
+	FB_SORT_SIZE, // Directories first, then by size
+	FB_SORT_EOL
+} S_M1_file_browser_sort;
+
 typedef enum
 {
 	FB_OK = 0,
@@ -50,14 +58,25 @@ typedef struct
 	uint8_t dir_level;
 } S_M1_file_browser_hdl;
 
+#define M1_FB_CLMT_SIZE		32 // Fast-seek cluster link map table in DWORDs, enough for 15 fragments
+#define M1_FB_EXTENT_FILENAME	"/.m1extent" // Record of the file being written to a preallocated extent
+#define M1_FB_BACKUP_SUFFIX		".bak" // Original of a file being replaced by m1_fb_replace_file()
+
 S_M1_file_browser_hdl *m1_fb_init(u8g2_t *lcd_hdl);
 void m1_fb_deinit(void);
 void m1_fb_popup(void);
 S_M1_file_info *m1_fb_display(S_M1_Buttons_Status *button_status);
 FRESULT m1_fb_listing(const char *dir_name);
+void m1_fb_set_sort(S_M1_file_browser_sort sort);
+void m1_fb_dir_changed(const char *path);
 uint8_t m1_fb_dyn_strcat(char *buffer, uint8_t num, const char *format, ...);
 uint8_t m1_fb_open_new_file(FIL *file, const char *filename);
 uint8_t m1_fb_open_file(FIL *file, const char *filename);
+uint8_t m1_fb_open_file_fastseek(FIL *file, const char *filename, DWORD *pclmt, UINT clmt_size);
+uint8_t m1_fb_expand_file(FIL *file, const char *filename, FSIZE_t size);
+uint8_t m1_fb_sync_expanded_file(FIL *file);
+uint8_t m1_fb_close_truncated_file(FIL *file);
+void m1_fb_trim_expanded_file(void);
 uint8_t m1_fb_open_dir(DIR *dir, const char *directory);
 uint8_t m1_fb_make_dir(const char *directory);
 uint8_t m1_fb_check_existence(const char *filedir);
@@ -65,7 +84,9 @@ uint8_t m1_fb_close_file(FIL *file);
 uint8_t m1_fb_open_log_file(const char *filename);
 uint8_t m1_fb_close_log_file(void);
 uint8_t m1_fb_delete_file(const char *filename);
-uint16_t m1_fb_write_to_file(FIL *pfile, const char *buffer, uint16_t size);
+FRESULT m1_fb_replace_file(const char *tmp_name, const char *filename);
+FRESULT m1_fb_recover_file(const char *filename);
+uint32_t m1_fb_write_to_file(FIL *pfile, const char *buffer, uint32_t size);
 uint16_t m1_fb_read_from_file(FIL *pfile, char *buffer, uint16_t size);
 
 #endif /* M1_FILE_BROWSER_H_ */
@@ -10,6 +10,7 @@
 #include "ff.h"
 #include "ff_gen_drv.h"
 #include "m1_file_util.h"
+#include "main.h"
 
 /*************************** D E F I N E S ************************************/
 
@@ -314,8 +315,11 @@ FRESULT fs_directory_ensure(const char *path)
     }
 
     /* 존재하지 않으면 생성 시도 */
-    if (fr == FR_NO_FILE || fr == FR_NO_PATH)
-        return f_mkdir(path);
+    if (fr == FR_NO_FILE || fr == FR_NO_PATH) {
+        fr = f_mkdir(path);
+        m1_fb_dir_changed(path);
+        return fr;
+    }
 
     /* 기타 오류 */
     return fr;
@@ -43,6 +43,7 @@ static char *pfullpath = NULL;
 static uint8_t fw_update_status = M1_FW_UPDATE_NOT_READY;
 static uint32_t fw_version_new;
 static FIL hfile_fw;
+static DWORD hfile_fw_clmt[M1_FB_CLMT_SIZE];
 static S_M1_file_info *f_info = NULL;
 
 /********************* F U N C T I O N   P R O T O T Y P E S ******************/
@@ -343,7 +344,7 @@ void firmware_update_get_image_file(void)
     	m1_u8g2_nextpage(); // Update display RAM
 
         uret = m1_fb_dyn_strcat(pfullpath, 2, "",  f_info->dir_name, f_info->file_name);
-        uret = m1_fb_open_file(&hfile_fw, pfullpath);
+        uret = m1_fb_open_file_fastseek(&hfile_fw, pfullpath, hfile_fw_clmt, M1_FB_CLMT_SIZE);
 		if ( !uret )
 		{
 			image_size = f_size(&hfile_fw);
@@ -15,6 +15,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "stm32h5xx_hal.h"
 #include "main.h"
 #include "m1_infrared.h"
@@ -34,8 +35,6 @@ TIM_HandleTypeDef   Timerhdl_IrTx;
 TIM_HandleTypeDef   Timerhdl_IrRx;
 IRMP_DATA 			irmp_data;
 
-volatile S_M1_IR_Det IrRx_Edge_Det; // Flag for first falling edge detected
-
 volatile uint8_t ir_ota_data_tx_active;
 uint8_t ir_ota_data_tx_len;
 volatile uint8_t ir_ota_data_tx_counter;
@@ -325,9 +324,8 @@ void infrared_learn_new_remote(void)
 		{
 			if ( q_item.q_evt_type==Q_EVENT_IRRED_RX )
 			{
-				irmp_data_sampler(q_item.q_data.ir_rx_data.ir_edge_te, q_item.q_data.ir_rx_data.ir_edge_dir);
-				/* Decode the Rx frame */
-				if (irmp_get_data(&irmp_data))
+				/* Decode the Rx frame(s) */
+				while ( infrared_rx_decode(&irmp_data) )
 				{
 					m1_buzzer_notification();
 					u8g2_SetDrawColor(&m1_u8g2, M1_DISP_DRAW_COLOR_BG);
@@ -343,7 +341,7 @@ void infrared_learn_new_remote(void)
 					memcpy(&irmp_loopback_data, &irmp_data, sizeof(IRMP_DATA));
 					new_remote_learned = 1;
 
-				} // if (irmp_get_data (&irmp_data))
+				} // while ( infrared_rx_decode(&irmp_data) )
 			} // if ( q_item.q_evt_type==Q_EVENT_IRRED_RX )
 			else if ( q_item.q_evt_type==Q_EVENT_KEYPAD )
 			{
@@ -594,6 +592,8 @@ static void infrared_decode_sys_init(void)
 		Error_Handler();
 	}
 
+	infrared_rx_stream_init(main_q_hdl);
+
 	/* Enable the TIMx global Interrupt */
 	HAL_NVIC_SetPriority(IR_DECODE_TIMER_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY, 0);
 	HAL_NVIC_EnableIRQ(IR_DECODE_TIMER_IRQn);
@@ -634,6 +634,7 @@ static void infrared_decode_sys_deinit(void)
 
 	IR_DECODE_TIMER_CLK_DIS();
 	HAL_NVIC_DisableIRQ(IR_DECODE_TIMER_IRQn);
+	infrared_rx_stream_deinit();
 
 	HAL_GPIO_DeInit(IR_GPIO_PORT, IR_RX_GPIO_PIN);
 
@@ -19,6 +19,7 @@
 #include "m1_compile_cfg.h"
 #include "queue.h"
 #include "irmp.h"
+#include "m1_infrared_rx.h"
 
 #define IR_DECODE_TIMER                 TIM2        /*!< Timer used for IR decoding */
 /* TIM prescaler is computed to have 1 μs as time base. TIM frequency (in MHz) / (prescaler+1) */
@@ -71,13 +72,6 @@
 #define IR_OTA_PULSE_BIT_MASK	0x0001 // LSB bit = 1 for Mark, using OR operator
 #define IR_OTA_SPACE_BIT_MASK	0xFFFE // LSB bit = 0 for Space, using AND operator
 
-typedef enum {
-	EDGE_DET_FALLING = 0,
-	EDGE_DET_RISING,
-	EDGE_DET_IDLE,
-	EDGE_DET_ACTIVE
-} S_M1_IR_Det;
-
 typedef enum
 {
 	IR_TX_INIT = 0,
@@ -100,7 +94,6 @@ S_M1_IR_Tx_States infrared_transmit(uint8_t init);
 extern uint32_t TIM_GetCounterCLKValue(uint16_t prescaler);
 extern void HAL_TIM_PeriodElapsedCallback_IR(TIM_HandleTypeDef *htim);
 
-extern volatile S_M1_IR_Det IrRx_Edge_Det;
 
 extern TIM_HandleTypeDef    Timerhdl_IrCarrier;
 extern TIM_HandleTypeDef    Timerhdl_IrTx;
@@ -0,0 +1,229 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  m1_infrared_rx.c
+*
+*  M1 Infrared Rx edges, from the capture interrupt to the decoder
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdint.h>
+#include <string.h>
+#include "main.h"
+#include "m1_tasks.h"
+#include "m1_infrared_rx.h"
+#include "stream_buffer.h"
+
+
+/*************************** D E F I N E S ************************************/
+
+
+//************************** S T R U C T U R E S *******************************
+
+/***************************** V A R I A B L E S ******************************/
+
+volatile S_M1_IR_Det IrRx_Edge_Det; // Flag for first falling edge detected
+
+S_M1_IR_Rx_Stats_t ir_rx_stats;
+
+static StaticStreamBuffer_t ir_rx_sbuf_ctrl;
+static uint8_t ir_rx_sbuf_storage[IR_RX_SBUF_EDGES*sizeof(S_M1_IR_Rx_Edge_t) + 1]; // One byte always stays free
+static StreamBufferHandle_t ir_rx_sbuf_hdl = NULL;
+static QueueHandle_t ir_rx_q_hdl; // Receives Q_EVENT_IRRED_RX
+static volatile uint8_t ir_rx_notify_pending; // Q_EVENT_IRRED_RX sent, decoder not run yet
+static uint8_t ir_rx_frame_open; // Edges since the last timer overflow
+static S_M1_IR_Rx_Edge_t ir_rx_batch[IR_RX_BATCH_EDGES];
+static uint16_t ir_rx_batch_len, ir_rx_batch_pos;
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+/*============================================================================*/
+/**
+  * @brief  Creates the stream buffer of the Rx edges
+  * @param  q_hdl queue receiving Q_EVENT_IRRED_RX when edges are ready to decode
+  * @retval None
+  */
+/*============================================================================*/
+void infrared_rx_stream_init(QueueHandle_t q_hdl)
+{
+	ir_rx_sbuf_hdl = xStreamBufferCreateStatic(sizeof(ir_rx_sbuf_storage), 1, ir_rx_sbuf_storage, &ir_rx_sbuf_ctrl);
+	configASSERT(ir_rx_sbuf_hdl);
+	ir_rx_q_hdl = q_hdl;
+	ir_rx_notify_pending = 0;
+	ir_rx_frame_open = 0;
+	ir_rx_batch_len = 0;
+	ir_rx_batch_pos = 0;
+	memset(&ir_rx_stats, 0, sizeof(ir_rx_stats));
+	IrRx_Edge_Det = EDGE_DET_IDLE;
+} // void infrared_rx_stream_init(QueueHandle_t q_hdl)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Deletes the stream buffer of the Rx edges. The capture interrupt
+  *         must be disabled.
+  * @param  None
+  * @retval None
+  */
+/*============================================================================*/
+void infrared_rx_stream_deinit(void)
+{
+	if ( ir_rx_sbuf_hdl!=NULL )
+	{
+		vStreamBufferDelete(ir_rx_sbuf_hdl);
+		ir_rx_sbuf_hdl = NULL;
+	}
+} // void infrared_rx_stream_deinit(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Tracks the level changes seen by the capture interrupt. The first
+  *         falling edge after an overflow starts the frame, the following
+  *         edges alternate.
+  * @param  cap_val timer counter at the edge, in us since the previous edge
+  * @param  level input level after the edge
+  * @param  pedge record for the decoder
+  * @retval TRUE if pedge has to be decoded
+  */
+/*============================================================================*/
+uint8_t infrared_rx_edge(uint32_t cap_val, uint8_t level, S_M1_IR_Rx_Edge_t *pedge)
+{
+	if ( IrRx_Edge_Det==EDGE_DET_IDLE )
+	{
+		if ( !level ) // A falling edge just happened?
+			IrRx_Edge_Det = EDGE_DET_FALLING; // Update current edge
+		return FALSE;
+	} // if ( IrRx_Edge_Det==EDGE_DET_IDLE )
+
+	if ( IrRx_Edge_Det==EDGE_DET_FALLING ) // Previous edge was falling?
+		IrRx_Edge_Det = EDGE_DET_RISING;
+	else // Previous edge was rising. This edge is falling
+		IrRx_Edge_Det = EDGE_DET_FALLING;
+	pedge->ir_edge_te = (uint16_t)cap_val;
+	pedge->ir_edge_dir = IrRx_Edge_Det; // '1' for Rising or '0' for falling edge
+	ir_rx_frame_open = 1;
+
+	return TRUE;
+} // uint8_t infrared_rx_edge(uint32_t cap_val, uint8_t level, S_M1_IR_Rx_Edge_t *pedge)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Ends the frame on a timer overflow, IRMP_TIMEOUT_TIME without edge
+  * @param  level input level
+  * @param  pedge record for the decoder
+  * @retval TRUE if pedge has to be decoded, for the first overflow after edges
+  */
+/*============================================================================*/
+uint8_t infrared_rx_overflow(uint8_t level, S_M1_IR_Rx_Edge_t *pedge)
+{
+	IrRx_Edge_Det = EDGE_DET_IDLE; // timeout case, let reset this flag
+	if ( !ir_rx_frame_open )
+		return FALSE;
+
+	ir_rx_frame_open = 0;
+	pedge->ir_edge_te = IRMP_TIMEOUT_TIME + 1; // Timer period plus 1 for the timeout condition to be met
+	pedge->ir_edge_dir = level | IR_RX_EDGE_TIMEOUT;
+
+	return TRUE;
+} // uint8_t infrared_rx_overflow(uint8_t level, S_M1_IR_Rx_Edge_t *pedge)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Puts a record into the stream buffer from the capture interrupt.
+  *         The decoder gets Q_EVENT_IRRED_RX at the end of the frame, or once
+  *         IR_RX_NOTIFY_EDGES are waiting in a long one. One message covers
+  *         all the records until the decoder runs.
+  * @param  pedge record, NULL on an overflow without record
+  * @param  pxHigherPriorityTaskWoken as for xQueueSendFromISR()
+  * @retval None
+  */
+/*============================================================================*/
+void infrared_rx_put_from_isr(const S_M1_IR_Rx_Edge_t *pedge, BaseType_t *pxHigherPriorityTaskWoken)
+{
+	S_M1_Main_Q_t q_item;
+	size_t waiting;
+
+	if ( ir_rx_sbuf_hdl==NULL )
+		return;
+
+	if ( pedge!=NULL )
+	{
+		// Records never get split, this is the only writer
+		if ( xStreamBufferSpacesAvailable(ir_rx_sbuf_hdl) >= sizeof(S_M1_IR_Rx_Edge_t) )
+		{
+			xStreamBufferSendFromISR(ir_rx_sbuf_hdl, pedge, sizeof(S_M1_IR_Rx_Edge_t), pxHigherPriorityTaskWoken);
+			ir_rx_stats.edges++;
+		}
+		else
+			ir_rx_stats.dropped++;
+	} // if ( pedge!=NULL )
+
+	if ( ir_rx_notify_pending )
+		return;
+	waiting = xStreamBufferBytesAvailable(ir_rx_sbuf_hdl);
+	if ( !waiting )
+		return;
+	if ( pedge!=NULL && !(pedge->ir_edge_dir & IR_RX_EDGE_TIMEOUT) && waiting < IR_RX_NOTIFY_EDGES*sizeof(S_M1_IR_Rx_Edge_t) )
+		return; // Frame not complete yet
+
+	q_item.q_evt_type = Q_EVENT_IRRED_RX;
+	if ( xQueueSendFromISR(ir_rx_q_hdl, &q_item, pxHigherPriorityTaskWoken)==pdPASS )
+	{
+		ir_rx_notify_pending = 1;
+		ir_rx_stats.notifications++;
+	}
+} // void infrared_rx_put_from_isr(const S_M1_IR_Rx_Edge_t *pedge, BaseType_t *pxHigherPriorityTaskWoken)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Decodes the records waiting in the stream buffer, in batches of
+  *         IR_RX_BATCH_EDGES. Call it on Q_EVENT_IRRED_RX until it returns
+  *         FALSE, the records after a decoded frame stay for the next call.
+  * @param  pirmp_data decoded frame
+  * @retval TRUE if a frame has been decoded
+  */
+/*============================================================================*/
+uint8_t infrared_rx_decode(IRMP_DATA *pirmp_data)
+{
+	const S_M1_IR_Rx_Edge_t *pedge;
+	size_t n;
+
+	if ( ir_rx_sbuf_hdl==NULL )
+		return FALSE;
+
+	while (1)
+	{
+		if ( ir_rx_batch_pos >= ir_rx_batch_len )
+		{
+			// Cleared before reading, so that records put from now on send a new message
+			ir_rx_notify_pending = 0;
+			n = xStreamBufferReceive(ir_rx_sbuf_hdl, ir_rx_batch, sizeof(ir_rx_batch), 0);
+			ir_rx_batch_len = n/sizeof(S_M1_IR_Rx_Edge_t);
+			ir_rx_batch_pos = 0;
+			if ( !ir_rx_batch_len )
+				return FALSE;
+		} // if ( ir_rx_batch_pos >= ir_rx_batch_len )
+
+		pedge = &ir_rx_batch[ir_rx_batch_pos++];
+		// The overflow only ends a frame the decoder has started
+		if ( (pedge->ir_edge_dir & IR_RX_EDGE_TIMEOUT) && !irmp_start_bit_is_detected() )
+			continue;
+		irmp_data_sampler(pedge->ir_edge_te, pedge->ir_edge_dir & ~IR_RX_EDGE_TIMEOUT);
+		if ( irmp_get_data(pirmp_data) )
+			return TRUE;
+	} // while (1)
+} // uint8_t infrared_rx_decode(IRMP_DATA *pirmp_data)
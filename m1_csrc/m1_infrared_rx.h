@@ -0,0 +1,58 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  m1_infrared_rx.h
+*
+*  M1 Infrared Rx edges, from the capture interrupt to the decoder
+*
+* M1 Project
+*
+*/
+
+#ifndef M1_INFRARED_RX_H_
+#define M1_INFRARED_RX_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "irmp.h"
+
+// Rx edges go from the capture interrupt to the decoder through a stream buffer
+#define IR_RX_EDGE_TIMEOUT		0x80 // Flag in ir_edge_dir: timer overflow, no edge
+#define IR_RX_SBUF_EDGES		512 // Edges held between two runs of the decoder
+#define IR_RX_NOTIFY_EDGES		128 // Edges which wake up the decoder before the end of the frame
+#define IR_RX_BATCH_EDGES		32 // Edges taken from the stream buffer at a time
+
+typedef enum {
+	EDGE_DET_FALLING = 0,
+	EDGE_DET_RISING,
+	EDGE_DET_IDLE,
+	EDGE_DET_ACTIVE
+} S_M1_IR_Det;
+
+typedef struct
+{
+	uint16_t ir_edge_te; // Time since the previous edge in us
+	uint8_t ir_edge_dir; // EDGE_DET_RISING or EDGE_DET_FALLING, with IR_RX_EDGE_TIMEOUT for an overflow
+	uint8_t reserved;
+} S_M1_IR_Rx_Edge_t;
+
+typedef struct
+{
+	uint32_t edges; // Records put into the stream buffer
+	uint32_t dropped; // Records lost to a full stream buffer
+	uint32_t notifications; // Q_EVENT_IRRED_RX sent
+} S_M1_IR_Rx_Stats_t;
+
+void infrared_rx_stream_init(QueueHandle_t q_hdl);
+void infrared_rx_stream_deinit(void);
+uint8_t infrared_rx_edge(uint32_t cap_val, uint8_t level, S_M1_IR_Rx_Edge_t *pedge);
+uint8_t infrared_rx_overflow(uint8_t level, S_M1_IR_Rx_Edge_t *pedge);
+void infrared_rx_put_from_isr(const S_M1_IR_Rx_Edge_t *pedge, BaseType_t *pxHigherPriorityTaskWoken);
+uint8_t infrared_rx_decode(IRMP_DATA *pirmp_data);
+
+extern volatile S_M1_IR_Det IrRx_Edge_Det;
+extern S_M1_IR_Rx_Stats_t ir_rx_stats;
+
+#endif /* M1_INFRARED_RX_H_ */
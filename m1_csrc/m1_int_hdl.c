@@ -24,6 +24,7 @@
 #include "m1_sub_ghz_api.h"
 //#include "spi_drv.h"
 #include "spi_master.h"
+#include "m1_rf_spi.h"
 #include "m1_rfid.h"
 #include "lfrfid.h"
 
@@ -193,6 +194,14 @@ void EXTI7_IRQHandler(void)
 /*============================================================================*/
 void EXTI12_IRQHandler(void)
 {
+	if ( SI446x_Queue_Busy() ) // The nIRQ pin reports CTS while the command queue is running
+	{
+		__HAL_GPIO_EXTI_CLEAR_RISING_IT(SI4463_nINT_Pin);
+		__HAL_GPIO_EXTI_CLEAR_FALLING_IT(SI4463_nINT_Pin);
+		SI446x_Queue_CTS_Callback();
+		return;
+	} // if ( SI446x_Queue_Busy() )
+
     if ( radio_state_flag & RADIO_STATE_TX )
     {
     	radio_state_flag = RADIO_STATE_IDLE;
@@ -408,6 +417,31 @@ void GPDMA1_Channel0_IRQHandler(void)
 
 
 
+/******************************************************************************/
+/*
+ * DMA for SPI2 Tx, Sub-GHz command queue
+ */
+/******************************************************************************/
+void GPDMA1_Channel3_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(&hdma_rf_spi_tx);
+} // void GPDMA1_Channel3_IRQHandler(void)
+
+
+
+/******************************************************************************/
+/*
+ * SPI2 Interrupt handler, end of the DMA transfers
+ */
+/******************************************************************************/
+void SPI2_IRQHandler(void)
+{
+	m1_spi_hal_irq_handler();
+} // void SPI2_IRQHandler(void)
+
+
+
+
 /******************************************************************************/
 /*
  * DMA for UART4 Interrupt handler, Tx for ESP32
@@ -486,6 +520,7 @@ void HAL_TIM_PeriodElapsedCallback_IR(TIM_HandleTypeDef *htim)
 {
 	uint32_t cap_val;
 	S_M1_Main_Q_t q_item;
+	S_M1_IR_Rx_Edge_t ir_edge;
 	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
 
 	if (htim == &Timerhdl_IrTx )
@@ -522,19 +557,13 @@ void HAL_TIM_PeriodElapsedCallback_IR(TIM_HandleTypeDef *htim)
 
 	else if (htim == &Timerhdl_IrRx )
 	{
-		cap_val = __HAL_TIM_GET_COUNTER(htim); // get the timeout counter
-		__HAL_TIM_SET_COUNTER(htim, 0); // reset counter after reading, htim->Instance->CNT = 0x00;
-		IrRx_Edge_Det = EDGE_DET_IDLE; // timeout case, let reset this flag
-		if ( irmp_start_bit_is_detected() )
-		{
-			//cap_val = IRMP_TIMEOUT_TIME + 1;
-			cap_val = Timerhdl_IrRx.Init.Period + 1; // Plus 1 for the timeout condition to be met
-			q_item.q_evt_type = Q_EVENT_IRRED_RX;
-			q_item.q_data.ir_rx_data.ir_edge_te = cap_val;
-			q_item.q_data.ir_rx_data.ir_edge_dir = (IR_RX_GPIO_Port->IDR & IR_RX_Pin)?1:0; // edge: '1' for Rising  or '0' for falling edge
-			xQueueSendFromISR(main_q_hdl, &q_item, &xHigherPriorityTaskWoken); // Send sample to queue, return: pdPASS or errQUEUE_FULL
-			portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
-		} // if ( irmp_start_bit_is_detected() )
+		__HAL_TIM_SET_COUNTER(htim, 0); // reset counter, htim->Instance->CNT = 0x00;
+		// End of frame: the decoder gets the timeout and the edges waiting in the stream buffer
+		if ( infrared_rx_overflow((IR_RX_GPIO_Port->IDR & IR_RX_Pin)?1:0, &ir_edge) )
+			infrared_rx_put_from_isr(&ir_edge, &xHigherPriorityTaskWoken);
+		else
+			infrared_rx_put_from_isr(NULL, &xHigherPriorityTaskWoken);
+		portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 	}
 } // void HAL_TIM_PeriodElapsedCallback_IR(TIM_HandleTypeDef *htim)
 
@@ -550,7 +579,7 @@ void HAL_TIM_PeriodElapsedCallback_IR(TIM_HandleTypeDef *htim)
 void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim)
 {
 	uint32_t cap_val;
-	S_M1_Main_Q_t q_item;
+	S_M1_IR_Rx_Edge_t ir_edge;
 	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
 
 	if (htim->Channel == IR_DECODE_TIMER_DEC_CH_ACTIV)
@@ -575,31 +604,12 @@ void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim)
 		//__HAL_TIM_SET_COMPARE(htim, IR_DECODE_TIMER_RX_CHANNEL, 0); // reset counter after reading, htim->Instance->CCR4 = 0x00;
 		cap_val =  __HAL_TIM_GET_COUNTER(htim);
 		__HAL_TIM_SET_COUNTER(htim, 0); // reset counter after reading, htim->Instance->CNT = 0x00;
-		if ( IrRx_Edge_Det==EDGE_DET_IDLE )
-		{
-			if ((IR_RX_GPIO_Port->IDR & IR_RX_Pin) == 0U) // A falling edge just happened?
-			{
-				IrRx_Edge_Det = EDGE_DET_FALLING; // Update current edge
-				q_item.q_data.ir_rx_data.ir_edge_te = 0;
-				q_item.q_data.ir_rx_data.ir_edge_dir = EDGE_DET_FALLING; // edge: '1' for Rising  or '0' for falling edge
-			}
-			return; // Do nothing
-		} // if ( IrRx_Edge_Det==EDGE_DET_IDLE )
-		if ( IrRx_Edge_Det==EDGE_DET_FALLING ) // Previous edge was falling?
+		// The edge goes to the stream buffer, the decoder is woken up once per frame
+		if ( infrared_rx_edge(cap_val, (IR_RX_GPIO_Port->IDR & IR_RX_Pin)?1:0, &ir_edge) )
 		{
-			IrRx_Edge_Det = EDGE_DET_RISING; // Update current edge
-			q_item.q_data.ir_rx_data.ir_edge_te = cap_val;
-			q_item.q_data.ir_rx_data.ir_edge_dir = EDGE_DET_RISING; // edge: '1' for Rising  or '0' for falling edge
-		} // if ( IrRx_Edge_Det==EDGE_DET_IDLE )
-		else // Previous edge was rising. This edge is falling
-		{
-			IrRx_Edge_Det = EDGE_DET_FALLING; // Update current edge
-			q_item.q_data.ir_rx_data.ir_edge_te = cap_val;
-			q_item.q_data.ir_rx_data.ir_edge_dir = EDGE_DET_FALLING; // edge: '1' for Rising  or '0' for falling edge
+			infrared_rx_put_from_isr(&ir_edge, &xHigherPriorityTaskWoken);
+			portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 		}
-		q_item.q_evt_type = Q_EVENT_IRRED_RX;
-		xQueueSendFromISR(main_q_hdl, &q_item, &xHigherPriorityTaskWoken); // Send sample to queue, return: pdPASS or errQUEUE_FULL
-		portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 	} // if (htim->Channel == IR_DECODE_TIMER_DEC_CH_ACTIV)
 } // void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim)
 
@@ -741,7 +751,7 @@ void TIM1_CC_IRQHandler(void)
 		if ( true )
 #endif // #ifdef M1_APP_SUB_GHZ_RAW_DATA_RX_NOISE_FILTER_ENABLE
 		{
-			m1_ringbuffer_insert(&subghz_rx_rawdata_rb, (uint8_t *)&cap_val);
+			m1_spsc_rb_put(&subghz_rx_rawdata_rb, &cap_val); // Lower 16 bits
 			pulse_counter++;
 			if ( pulse_counter >= SUBGHZ_RAW_DATA_SAMPLES_TO_RW )
 			{
@@ -586,8 +586,9 @@ static int nfc_read_more_kp_handler(void)
 {
 	S_M1_Buttons_Status this_button_status;
 	BaseType_t ret;
-	nfc_run_ctx_t* c = nfc_ctx_get();
-	bool is_load_file = (c && c->file.source_kind==LOAD_FILE);
+	nfc_ctx_snapshot_t snap;
+	nfc_ctx_get_snapshot(&snap);
+	bool is_load_file = (snap.file.source_kind==LOAD_FILE);
 	uint8_t menu_index, view_id;
 
 	ret = xQueueReceive(button_events_q_hdl, &this_button_status, 0);
@@ -749,8 +750,9 @@ static void nfc_read_more_gui_destroy(uint8_t param)
 /*============================================================================*/
 static void nfc_read_more_gui_update(uint8_t param)
 {
-	nfc_run_ctx_t* c = nfc_ctx_get();
-	bool is_load_file = (c && c->file.source_kind==LOAD_FILE);
+	nfc_ctx_snapshot_t snap;
+	nfc_ctx_get_snapshot(&snap);
+	bool is_load_file = (snap.file.source_kind==LOAD_FILE);
 
 	// Use different menu arrangements depending on source_kind 
 	const char **menu_options = is_load_file ? m1_nfc_more_options_file : m1_nfc_more_options;
@@ -1029,25 +1031,25 @@ static void nfc_emulate_gui_update(uint8_t param)
 {
     if ( param==0 )	// emulating
     {
-		nfc_run_ctx_t* c = nfc_ctx_get();
+		nfc_ctx_snapshot_t snap;
 		const char* emu_text = "Emulate UID";  // 기본값: UID만 에뮬레이션
+
+		nfc_ctx_get_snapshot(&snap); // The listener may publish page writes meanwhile
 		
 		// T2T (Ultralight/NTAG) + Page dump 데이터가 있는 경우
-		if (c && 
-			c->head.family==M1NFC_FAM_ULTRALIGHT &&
-			c->dump.has_dump && 
-			c->dump.data != NULL && 
-			c->dump.unit_size==4 &&
-			c->dump.unit_count > 0) {
+		if (snap.head.family==M1NFC_FAM_ULTRALIGHT &&
+			snap.dump.has_dump && 
+			snap.dump.data != NULL && 
+			snap.dump.unit_size==4 &&
+			snap.dump.unit_count > 0) {
 			emu_text = "Emulate";
 		}
 		// MFC (Classic) + Block dump 데이터가 있는 경우 (나중을 위해)
-		else if (c && 
-				 c->head.family==M1NFC_FAM_CLASSIC &&
-				 c->dump.has_dump && 
-				 c->dump.data != NULL && 
-				 c->dump.unit_size==16 &&
-				 c->dump.unit_count > 0) {
+		else if (snap.head.family==M1NFC_FAM_CLASSIC &&
+				 snap.dump.has_dump && 
+				 snap.dump.data != NULL && 
+				 snap.dump.unit_size==16 &&
+				 snap.dump.unit_count > 0) {
 			emu_text = "Emulate";
 		}
 		
@@ -1426,7 +1428,7 @@ void nfc_info_gui_init(void)
  */
 static void nfc_info_drawing(void)
 {
-    nfc_run_ctx_t* c = nfc_ctx_get();
+    nfc_ctx_snapshot_t snap;
 
     char type_str[32];
     char family_str[32];
@@ -1440,10 +1442,11 @@ static void nfc_info_drawing(void)
     strcpy(atqa_str, "-- --");
     strcpy(sak_str,  "--");
 
-    if (c && c->head.uid_len > 0)
+    nfc_ctx_get_snapshot(&snap);
+    if (snap.head.uid_len > 0)
     {
         /* 1) Tech → Type string */
-        switch (c->head.tech)
+        switch (snap.head.tech)
         {
         	case M1NFC_TECH_A: // enum value is based on nfc_ctx.h
         		strcpy(type_str, "ISO14443A / NFC-A");
@@ -1463,11 +1466,11 @@ static void nfc_info_drawing(void)
         }
 
 		/* 2) Family → title string
-         * Reuse the title_text created by nfc_ctx_refresh_ui()
+         * Reuse the title_text published by nfc_ctx_refresh_ui()
          */
-        if (c->ui.title_text[0] != '\0')
+        if (snap.title_text[0] != '\0')
         {
-            strncpy(family_str, c->ui.title_text, sizeof(family_str) - 1);
+            strncpy(family_str, snap.title_text, sizeof(family_str) - 1);
             family_str[sizeof(family_str) - 1] = '\0';
         }
         else
@@ -1477,18 +1480,18 @@ static void nfc_info_drawing(void)
 
         /* 3) UID: "AA BB CC ..." */
         snprintf(uid_str, sizeof(uid_str),
-                 "%s", hex2Str(c->head.uid, c->head.uid_len));
+                 "%s", hex2Str(snap.head.uid, snap.head.uid_len));
 
         /* 4) ATQA / SAK */
-        if (c->head.a.has_atqa)
+        if (snap.head.a.has_atqa)
         {
             snprintf(atqa_str, sizeof(atqa_str),
-                     "%02X %02X", c->head.a.atqa[0], c->head.a.atqa[1]);
+                     "%02X %02X", snap.head.a.atqa[0], snap.head.a.atqa[1]);
         }
-        if (c->head.a.has_sak)
+        if (snap.head.a.has_sak)
         {
             snprintf(sak_str, sizeof(sak_str),
-                     "%02X", c->head.a.sak);
+                     "%02X", snap.head.a.sak);
         }
     }
 
@@ -2175,13 +2178,14 @@ static void nfc_rename_gui_destroy(uint8_t param)
 /*============================================================================*/
 static void nfc_rename_gui_update(uint8_t param)
 {
-	nfc_run_ctx_t* c = nfc_ctx_get();
-	if (!c || c->file.source_kind != LOAD_FILE) {
+	nfc_ctx_snapshot_t snap;
+	nfc_ctx_get_snapshot(&snap);
+	if (snap.file.source_kind != LOAD_FILE) {
 		m1_uiView_display_switch(VIEW_MODE_NFC_READ_MORE, X_MENU_UPDATE_REFRESH);
 		return;
 	}
 
-	if (c->file.path[0]=='\0') {
+	if (snap.file.path[0]=='\0') {
 		m1_uiView_display_switch(VIEW_MODE_NFC_READ_MORE, X_MENU_UPDATE_REFRESH);
 		return;
 	}
@@ -2195,8 +2199,8 @@ static void nfc_rename_gui_update(uint8_t param)
 
 	// Extract current filename without extension
 	// fu_get_filename_without_ext takes full path and extracts filename without extension
-	if (c->file.path[0] != '\0') {
-		fu_get_filename_without_ext(c->file.path, dname, sizeof(dname));
+	if (snap.file.path[0] != '\0') {
+		fu_get_filename_without_ext(snap.file.path, dname, sizeof(dname));
 	} else {
 	    srand(HAL_GetTick());
 	    	sprintf((char*)dname, "nfc_%05u", rand() % 0xFFFFF);
@@ -2211,7 +2215,7 @@ static void nfc_rename_gui_update(uint8_t param)
 	}
 
 	// Build new file path
-	strcpy(old_file, c->file.path);
+	strcpy(old_file, snap.file.path);
 	
 	// Get directory path from old file
 	char dir_path[128];
@@ -2243,10 +2247,14 @@ static void nfc_rename_gui_update(uint8_t param)
 	pBitmap = micro_sd_card_error;
 	FRESULT res = f_rename(old_file, new_file);
 	if (res==FR_OK) {
+		m1_fb_dir_changed(old_file);
+		m1_fb_dir_changed(new_file);
 		pBitmap = nfc_saved_63_63;
 		// Update context with new path
+		nfc_run_ctx_t* c = nfc_ctx_get();
 		strncpy(c->file.path, new_file, sizeof(c->file.path) - 1);
 		c->file.path[sizeof(c->file.path) - 1] = '\0';
+		nfc_ctx_publish();
 	}
 
 	m1_draw_icon(M1_DISP_DRAW_COLOR_TXT, 32, 0, 63, 63, pBitmap);
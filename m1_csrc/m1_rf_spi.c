@@ -23,6 +23,9 @@ ESP32: 		GPDMA1_Channel4
 Log/Debug: 	GPDMA1_Channel1
 LCD: 		[GPDMA1_Channel0]
 Sub-GHz Tx:	GPDMA1_Channel0
+SPI2 Tx:	GPDMA1_Channel3
+LF RFID emulation:	GPDMA1_Channel6 (TIM5 ARR)
+			GPDMA1_Channel7 (GPIOA BSRR)
 */
 
 /*************************** I N C L U D E S **********************************/
@@ -42,6 +45,10 @@ Sub-GHz Tx:	GPDMA1_Channel0
 #define SPI_NUM_OF_DEVICES_MAX		2
 #define RF_SPI_RX_QUEUE_SIZE		2
 
+#define RF_SPI_DMA_TX_CHANNEL		GPDMA1_Channel3
+#define RF_SPI_DMA_TX_IRQn			GPDMA1_Channel3_IRQn
+#define RF_SPI_IRQn					SPI2_IRQn
+
 //************************** C O N S T A N T **********************************/
 
 static const S_M1_SPI_NSS spi_nss_port[SPI_DEVICE_END_OF_LIST] = {{NFC_CS_GPIO_Port, NFC_CS_Pin}, {SI4463_CS_GPIO_Port, SI4463_CS_Pin}};
@@ -51,16 +58,26 @@ static const S_M1_SPI_NSS spi_nss_port[SPI_DEVICE_END_OF_LIST] = {{NFC_CS_GPIO_P
 
 /***************************** V A R I A B L E S ******************************/
 
+DMA_HandleTypeDef hdma_rf_spi_tx;
+
 static SPI_HandleTypeDef *pspihdl;
 static SemaphoreHandle_t mutex_rf_spi_trans;
+static S_M1_SPI_DeviceId rf_spi_dma_dev_id;
+static void (*rf_spi_dma_callback)(HAL_StatusTypeDef stat) = NULL;
 
 /********************* F U N C T I O N   P R O T O T Y P E S ******************/
 
 HAL_StatusTypeDef m1_spi_hal_trans_req(S_M1_SPI_Trans_Inf *trans_inf);
+void m1_spi_hal_lock(void);
+void m1_spi_hal_unlock(void);
+HAL_StatusTypeDef m1_spi_hal_write_dma(S_M1_SPI_DeviceId dev_id, uint8_t *pdata, uint16_t len, void (*pcallback)(HAL_StatusTypeDef stat));
+void m1_spi_hal_abort_dma(void);
+void m1_spi_hal_irq_handler(void);
 uint32_t m1_spi_hal_get_error(void);
 
 void m1_spi_hal_init(SPI_HandleTypeDef *phspi);
 void m1_spi_hal_deinit(void);
+static void m1_spi_hal_dma_init(void);
 
 /*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
 
@@ -81,10 +98,59 @@ void m1_spi_hal_init(SPI_HandleTypeDef *phspi)
 	// https://community.st.com/t5/stm32-mcus-embedded-software/hal-tick-problem/td-p/598944
 	mutex_rf_spi_trans = xSemaphoreCreateMutex();
 	assert(mutex_rf_spi_trans!=NULL);
+
+	m1_spi_hal_dma_init();
 } // void m1_spi_hal_init(SPI_HandleTypeDef *phspi)
 
 
 
+/*============================================================================*/
+/**
+  * @brief  Initializes the DMA channel used by m1_spi_hal_write_dma()
+  * @param  None
+  * @retval None
+  */
+/*============================================================================*/
+static void m1_spi_hal_dma_init(void)
+{
+	/* Peripheral clock enable */
+	__HAL_RCC_GPDMA1_CLK_ENABLE();
+
+	/* GPDMA1_REQUEST_SPI2_TX Init */
+	hdma_rf_spi_tx.Instance = RF_SPI_DMA_TX_CHANNEL;
+	hdma_rf_spi_tx.Init.Request = GPDMA1_REQUEST_SPI2_TX;
+	hdma_rf_spi_tx.Init.BlkHWRequest = DMA_BREQ_SINGLE_BURST;
+	hdma_rf_spi_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+	hdma_rf_spi_tx.Init.SrcInc = DMA_SINC_INCREMENTED;
+	hdma_rf_spi_tx.Init.DestInc = DMA_DINC_FIXED;
+	hdma_rf_spi_tx.Init.SrcDataWidth = DMA_SRC_DATAWIDTH_BYTE;
+	hdma_rf_spi_tx.Init.DestDataWidth = DMA_DEST_DATAWIDTH_BYTE;
+	hdma_rf_spi_tx.Init.Priority = DMA_LOW_PRIORITY_HIGH_WEIGHT;
+	hdma_rf_spi_tx.Init.SrcBurstLength = 1;
+	hdma_rf_spi_tx.Init.DestBurstLength = 1;
+	hdma_rf_spi_tx.Init.TransferAllocatedPort = DMA_SRC_ALLOCATED_PORT0|DMA_DEST_ALLOCATED_PORT0;
+	hdma_rf_spi_tx.Init.TransferEventMode = DMA_TCEM_BLOCK_TRANSFER;
+	hdma_rf_spi_tx.Init.Mode = DMA_NORMAL;
+	if (HAL_DMA_Init(&hdma_rf_spi_tx) != HAL_OK)
+	{
+		Error_Handler();
+	}
+	__HAL_LINKDMA(pspihdl, hdmatx, hdma_rf_spi_tx);
+
+	if (HAL_DMA_ConfigChannelAttributes(&hdma_rf_spi_tx, DMA_CHANNEL_NPRIV) != HAL_OK)
+	{
+		Error_Handler();
+	}
+
+	// The end of a DMA transfer is reported by the SPI interrupt
+	HAL_NVIC_SetPriority(RF_SPI_DMA_TX_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(RF_SPI_DMA_TX_IRQn);
+	HAL_NVIC_SetPriority(RF_SPI_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(RF_SPI_IRQn);
+} // static void m1_spi_hal_dma_init(void)
+
+
+
 /*============================================================================*/
 /**
 * @brief SPI De-Initialization
@@ -109,6 +175,8 @@ void m1_spi_hal_deinit(void)
 		HAL_GPIO_DeInit(spi_nss_port[i].spi_nss_port, spi_nss_port[i].spi_nss_pin);
 	}
     HAL_NVIC_DisableIRQ(SPI2_IRQn);
+    HAL_NVIC_DisableIRQ(RF_SPI_DMA_TX_IRQn);
+    HAL_DMA_DeInit(&hdma_rf_spi_tx);
 
     if ( mutex_rf_spi_trans != NULL )
     	vSemaphoreDelete(mutex_rf_spi_trans);
@@ -197,6 +265,145 @@ HAL_StatusTypeDef m1_spi_hal_trans_req(S_M1_SPI_Trans_Inf *trans_inf)
 
 
 
+/*============================================================================*/
+/**
+  * @brief  Takes the bus for several transactions, e.g. a chain of DMA transfers.
+  *         m1_spi_hal_trans_req() must not be called by the owner until the bus is released.
+  * @param  None
+  * @retval None
+  */
+/*============================================================================*/
+void m1_spi_hal_lock(void)
+{
+	xSemaphoreTake(mutex_rf_spi_trans, portMAX_DELAY);
+} // void m1_spi_hal_lock(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Releases the bus taken by m1_spi_hal_lock(), from the task which took it
+  * @param  None
+  * @retval None
+  */
+/*============================================================================*/
+void m1_spi_hal_unlock(void)
+{
+	xSemaphoreGive(mutex_rf_spi_trans);
+} // void m1_spi_hal_unlock(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Starts writing data to a device with the DMA. The bus must be locked.
+  *         May be called from an interrupt handler.
+  * @param  dev_id device, NSS is asserted until the end of the transfer
+  * @param  pdata data, must remain valid until the end of the transfer
+  * @param  len number of bytes
+  * @param  pcallback called from the SPI interrupt at the end of the transfer
+  * @retval HAL status
+  */
+/*============================================================================*/
+HAL_StatusTypeDef m1_spi_hal_write_dma(S_M1_SPI_DeviceId dev_id, uint8_t *pdata, uint16_t len, void (*pcallback)(HAL_StatusTypeDef stat))
+{
+	HAL_StatusTypeDef stat;
+
+	assert(dev_id < SPI_NUM_OF_DEVICES_MAX);
+	rf_spi_dma_dev_id = dev_id;
+	rf_spi_dma_callback = pcallback;
+	HAL_GPIO_WritePin(spi_nss_port[dev_id].spi_nss_port , spi_nss_port[dev_id].spi_nss_pin, GPIO_PIN_RESET);
+	stat = HAL_SPI_Transmit_DMA(pspihdl, pdata, len);
+	if ( stat!=HAL_OK )
+	{
+		HAL_GPIO_WritePin(spi_nss_port[dev_id].spi_nss_port , spi_nss_port[dev_id].spi_nss_pin, GPIO_PIN_SET);
+		rf_spi_dma_callback = NULL;
+	} // if ( stat!=HAL_OK )
+
+	return stat;
+} // HAL_StatusTypeDef m1_spi_hal_write_dma(S_M1_SPI_DeviceId dev_id, uint8_t *pdata, uint16_t len, void (*pcallback)(HAL_StatusTypeDef stat))
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Aborts the DMA transfer started by m1_spi_hal_write_dma(), if any.
+  *         The callback is not called.
+  * @param  None
+  * @retval None
+  */
+/*============================================================================*/
+void m1_spi_hal_abort_dma(void)
+{
+	rf_spi_dma_callback = NULL;
+	if ( pspihdl->State!=HAL_SPI_STATE_BUSY_TX )
+		return;
+	HAL_SPI_Abort(pspihdl);
+	HAL_GPIO_WritePin(spi_nss_port[rf_spi_dma_dev_id].spi_nss_port , spi_nss_port[rf_spi_dma_dev_id].spi_nss_pin, GPIO_PIN_SET);
+} // void m1_spi_hal_abort_dma(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  SPI interrupt handler
+  * @param  None
+  * @retval None
+  */
+/*============================================================================*/
+void m1_spi_hal_irq_handler(void)
+{
+	HAL_SPI_IRQHandler(pspihdl);
+} // void m1_spi_hal_irq_handler(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  End of a DMA transfer started by m1_spi_hal_write_dma()
+  * @param  hspi SPI handle
+  * @retval None
+  */
+/*============================================================================*/
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+	void (*pcallback)(HAL_StatusTypeDef stat);
+
+	if ( hspi!=pspihdl )
+		return;
+
+	HAL_GPIO_WritePin(spi_nss_port[rf_spi_dma_dev_id].spi_nss_port , spi_nss_port[rf_spi_dma_dev_id].spi_nss_pin, GPIO_PIN_SET);
+	pcallback = rf_spi_dma_callback;
+	rf_spi_dma_callback = NULL;
+	if ( pcallback!=NULL )
+		pcallback(HAL_OK); // It may start the next transfer
+} // void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Error of a DMA transfer started by m1_spi_hal_write_dma()
+  * @param  hspi SPI handle
+  * @retval None
+  */
+/*============================================================================*/
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+	void (*pcallback)(HAL_StatusTypeDef stat);
+
+	if ( hspi!=pspihdl )
+		return;
+
+	HAL_GPIO_WritePin(spi_nss_port[rf_spi_dma_dev_id].spi_nss_port , spi_nss_port[rf_spi_dma_dev_id].spi_nss_pin, GPIO_PIN_SET);
+	pcallback = rf_spi_dma_callback;
+	rf_spi_dma_callback = NULL;
+	if ( pcallback!=NULL )
+		pcallback(HAL_ERROR);
+} // void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+
+
+
 /*============================================================================*/
 /**
   * @brief  Return the SPI error code.
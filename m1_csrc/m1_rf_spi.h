@@ -58,8 +58,15 @@ typedef struct
 } S_M1_SPI_Trans_Inf;
 
 
+extern DMA_HandleTypeDef hdma_rf_spi_tx;
+
 void m1_spi_hal_init(SPI_HandleTypeDef *phspi);
 HAL_StatusTypeDef m1_spi_hal_trans_req(S_M1_SPI_Trans_Inf *trans_inf);
+void m1_spi_hal_lock(void);
+void m1_spi_hal_unlock(void);
+HAL_StatusTypeDef m1_spi_hal_write_dma(S_M1_SPI_DeviceId dev_id, uint8_t *pdata, uint16_t len, void (*pcallback)(HAL_StatusTypeDef stat));
+void m1_spi_hal_abort_dma(void);
+void m1_spi_hal_irq_handler(void);
 uint32_t m1_i2c_hal_get_error(void);
 int32_t m1_spi_hal_wrapper(const uint8_t * const pTxData, uint8_t * const pRxData, uint16_t Length);
 #endif /* M1_RF_SPI_H_ */
@@ -1920,6 +1920,8 @@ static void lfrfid_saved_rename_update(uint8_t param)
 			fu_path_combine(old_file, sizeof(old_file), lfrfid_tag_info.filepath, lfrfid_tag_info.filename);
 			if(f_rename(old_file,new_file)==FR_OK)
 			{
+				m1_fb_dir_changed(old_file);
+				m1_fb_dir_changed(new_file);
 				pBitmap = nfc_saved_63_63;
 				fu_get_directory_path(new_file, lfrfid_tag_info.filepath, sizeof(lfrfid_tag_info.filepath));
 				const char *pbuff = fu_get_filename(new_file);
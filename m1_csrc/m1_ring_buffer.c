@@ -47,6 +47,12 @@ uint32_t ringbuffer_get_data_slots(S_M1_RingBuffer *prb_handle);
 uint16_t m1_ringbuffer_advance_read(S_M1_RingBuffer *prb_handle, uint16_t n_slots);
 uint16_t m1_ringbuffer_get_read_len(S_M1_RingBuffer *prb_handle);
 uint8_t *m1_ringbuffer_get_read_address(S_M1_RingBuffer *prb_handle);
+uint8_t m1_spsc_rb_init(S_M1_SpscRingBuffer *prb_handle, uint8_t *ring_buffer, uint32_t n_elements, uint8_t data_size);
+void m1_spsc_rb_reset(S_M1_SpscRingBuffer *prb_handle);
+uint8_t m1_spsc_rb_put(S_M1_SpscRingBuffer *prb_handle, const void *indata);
+uint32_t m1_spsc_rb_get_data_slots(S_M1_SpscRingBuffer *prb_handle);
+void *m1_spsc_rb_acquire_read_span(S_M1_SpscRingBuffer *prb_handle, uint32_t *pn_slots);
+void m1_spsc_rb_commit_read(S_M1_SpscRingBuffer *prb_handle, uint32_t n_slots);
 
 /*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
 
@@ -376,3 +382,127 @@ uint8_t m1_ringbuffer_check_empty_state(S_M1_RingBuffer *prb_handle)
 
 	return 0;
 } // uint8_t m1_ringbuffer_check_empty_state(S_M1_RingBuffer *prb_handle)
+
+
+
+/*============================================================================*/
+/*
+ * This function initializes the SPSC ring buffer.
+ * n_elements must be a power of two.
+ * Returns 0 if ok.
+ */
+/*============================================================================*/
+uint8_t m1_spsc_rb_init(S_M1_SpscRingBuffer *prb_handle, uint8_t *ring_buffer, uint32_t n_elements, uint8_t data_size)
+{
+	assert(prb_handle != NULL);
+	assert(ring_buffer != NULL);
+	assert(data_size != 0);
+
+	if ( (n_elements==0) || (n_elements & (n_elements - 1)) ) // Not a power of two?
+		return 1;
+
+	prb_handle->pdata = ring_buffer;
+	prb_handle->mask = n_elements - 1;
+	prb_handle->data_size = data_size;
+	prb_handle->head = 0;
+	prb_handle->tail = 0;
+	prb_handle->overruns = 0;
+
+	return 0;
+} // uint8_t m1_spsc_rb_init(S_M1_SpscRingBuffer *prb_handle, uint8_t *ring_buffer, uint32_t n_elements, uint8_t data_size)
+
+
+
+/*============================================================================*/
+/*
+ * This function discards all data in the SPSC ring buffer.
+ * It is called by the consumer and does not disturb a running producer.
+ */
+/*============================================================================*/
+void m1_spsc_rb_reset(S_M1_SpscRingBuffer *prb_handle)
+{
+	prb_handle->tail = prb_handle->head;
+	prb_handle->overruns = 0;
+} // void m1_spsc_rb_reset(S_M1_SpscRingBuffer *prb_handle)
+
+
+
+/*============================================================================*/
+/*
+ * This function copies one data item to the SPSC ring buffer.
+ * Called by the producer only. If the buffer is full, the new item is dropped,
+ * because the producer must not move the read index of the consumer.
+ * Returns 1 if the item was stored.
+ */
+/*============================================================================*/
+uint8_t m1_spsc_rb_put(S_M1_SpscRingBuffer *prb_handle, const void *indata)
+{
+	uint32_t head;
+
+	head = prb_handle->head;
+	if ( (head - prb_handle->tail) > prb_handle->mask ) // Full?
+	{
+		prb_handle->overruns++;
+		return 0;
+	}
+
+	memcpy(&prb_handle->pdata[(head & prb_handle->mask)*prb_handle->data_size], indata, prb_handle->data_size);
+	__DMB(); // The item must be in memory before the consumer can see the new head
+	prb_handle->head = head + 1;
+
+	return 1;
+} // uint8_t m1_spsc_rb_put(S_M1_SpscRingBuffer *prb_handle, const void *indata)
+
+
+
+/*============================================================================*/
+/*
+ * This function returns the data slots available in the SPSC ring buffer
+ */
+/*============================================================================*/
+uint32_t m1_spsc_rb_get_data_slots(S_M1_SpscRingBuffer *prb_handle)
+{
+	return (prb_handle->head - prb_handle->tail);
+} // uint32_t m1_spsc_rb_get_data_slots(S_M1_SpscRingBuffer *prb_handle)
+
+
+
+/*============================================================================*/
+/*
+ * This function returns the address of the linear block of data starting from
+ * the read index, and its number of slots in pn_slots.
+ * Called by the consumer only. The data can be used in place, e.g. by a DMA
+ * or an encoder, until it is released with m1_spsc_rb_commit_read().
+ * Data wrapping around the end of the buffer is returned by the next call.
+ */
+/*============================================================================*/
+void *m1_spsc_rb_acquire_read_span(S_M1_SpscRingBuffer *prb_handle, uint32_t *pn_slots)
+{
+	uint32_t tail, n_avail, n_linear;
+
+	tail = prb_handle->tail;
+	n_avail = prb_handle->head - tail;
+	__DMB(); // Read the items only after the head that covers them
+	n_linear = prb_handle->mask + 1 - (tail & prb_handle->mask);
+	*pn_slots = GET_MIN_NUM(n_avail, n_linear);
+
+	return &prb_handle->pdata[(tail & prb_handle->mask)*prb_handle->data_size];
+} // void *m1_spsc_rb_acquire_read_span(S_M1_SpscRingBuffer *prb_handle, uint32_t *pn_slots)
+
+
+
+/*============================================================================*/
+/*
+ * This function releases n_slots read through m1_spsc_rb_acquire_read_span()
+ * back to the producer. Called by the consumer only.
+ */
+/*============================================================================*/
+void m1_spsc_rb_commit_read(S_M1_SpscRingBuffer *prb_handle, uint32_t n_slots)
+{
+	uint32_t n_avail;
+
+	n_avail = prb_handle->head - prb_handle->tail;
+	n_slots = GET_MIN_NUM(n_slots, n_avail);
+	__DMB(); // Finish using the items before the producer may overwrite them
+	prb_handle->tail += n_slots;
+} // void m1_spsc_rb_commit_read(S_M1_SpscRingBuffer *prb_handle, uint32_t n_slots)
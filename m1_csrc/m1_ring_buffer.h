@@ -23,6 +23,22 @@ typedef struct
     volatile uint32_t head; // Index in the buffer for for writing to
 } S_M1_RingBuffer;
 
+/*
+ * Single-producer/single-consumer ring buffer.
+ * The producer (e.g. an ISR) only writes head and the consumer only writes tail,
+ * so neither side needs a critical section. Both indices run freely and are
+ * masked on access, which requires the number of elements to be a power of two.
+ */
+typedef struct
+{
+    uint8_t *pdata; // Pointer to the buffer
+    uint32_t mask; // Number of elements - 1
+    uint8_t data_size; // Data size
+    volatile uint32_t head; // Number of elements written, changed by the producer only
+    volatile uint32_t tail; // Number of elements read, changed by the consumer only
+    volatile uint32_t overruns; // Elements dropped by the producer because the buffer was full
+} S_M1_SpscRingBuffer;
+
 extern S_M1_RingBuffer esp32_rb_hdl;
 
 void m1_ringbuffer_init(S_M1_RingBuffer *prb_handle, uint8_t *ring_buffer, uint16_t n_elements, uint8_t data_size);
@@ -37,4 +53,11 @@ uint8_t m1_ringbuffer_check_empty_state(S_M1_RingBuffer *prb_handle);
 uint32_t ringbuffer_get_empty_slots(S_M1_RingBuffer *prb_handle);
 uint32_t ringbuffer_get_data_slots(S_M1_RingBuffer *prb_handle);
 
+uint8_t m1_spsc_rb_init(S_M1_SpscRingBuffer *prb_handle, uint8_t *ring_buffer, uint32_t n_elements, uint8_t data_size);
+void m1_spsc_rb_reset(S_M1_SpscRingBuffer *prb_handle);
+uint8_t m1_spsc_rb_put(S_M1_SpscRingBuffer *prb_handle, const void *indata);
+uint32_t m1_spsc_rb_get_data_slots(S_M1_SpscRingBuffer *prb_handle);
+void *m1_spsc_rb_acquire_read_span(S_M1_SpscRingBuffer *prb_handle, uint32_t *pn_slots);
+void m1_spsc_rb_commit_read(S_M1_SpscRingBuffer *prb_handle, uint32_t n_slots);
+
 #endif /* M1_RING_BUFFER_H_ */
@@ -22,6 +22,7 @@
 #include "app_freertos.h"
 #include "cmsis_os.h"
 #include "m1_sdcard.h"
+#include "m1_usb_cdc_msc.h"
 
 /*************************** D E F I N E S ************************************/
 
@@ -87,6 +88,7 @@ static uint32_t		sd_free_sectors;	// Free Sectors
 static uint32_t		sd_total_sectors;  	// Total Sectors
 static uint16_t 	sd_sector_size;		// Sector size
 static volatile DSTATUS sd_stat = STA_NOINIT;
+static volatile uint32_t sd_mount_generation; // Changed by every mount and unmount
 
 /********************* F U N C T I O N   P R O T O T Y P E S ******************/
 void sdcard_detection_task(void *param);
@@ -99,6 +101,7 @@ static void m1_sd_hardware_init(void);
 char *m1_sd_error_msg(S_M1_SDCard_Access_Status ferr);
 S_M1_SDCard_Info *m1_sdcard_get_info(void);
 FRESULT m1_sdcard_get_error_code(void);
+uint32_t m1_sdcard_get_mount_generation(void);
 uint32_t m1_sdcard_get_total_capacity(void);
 uint32_t m1_sdcard_get_free_capacity(void);
 S_M1_SDCard_Access_Status m1_sdcard_get_status(void);
@@ -525,6 +528,22 @@ FRESULT m1_sdcard_get_error_code(void)
 
 
 
+/******************************************************************************/
+/**
+*
+* This function returns a counter changed by every mount and unmount.
+* Data read from the card before the counter changed may come from
+* another card, or from a card the USB host has written to.
+*
+*/
+/******************************************************************************/
+uint32_t m1_sdcard_get_mount_generation(void)
+{
+	return sd_mount_generation;
+} // uint32_t m1_sdcard_get_mount_generation(void)
+
+
+
 /******************************************************************************/
 /**
 *
@@ -662,13 +681,19 @@ S_M1_SDCard_Access_Status m1_sdcard_get_status(void)
 /******************************************************************************/
 void m1_sdcard_mount(void)
 {
+	// Write what the USB host left in the MSC cache, and drop the blocks the firmware may change
+	m1_usb_msc_sync();
 	// Mount a Logical Drive
+	sd_mount_generation++;
 	sd_fres = f_mount(&sdcard_ctl.sdfs, sdcard_ctl.sdpath, 1);
 	if (sd_fres==FR_OK || sd_fres==FR_NO_FILESYSTEM)
 	{
 		sd_fres = f_getfree(sdcard_ctl.sdpath, &sd_free_clusters, &sd_pfatfs);
 		if(sd_fres==FR_OK)
+		{
 			sdcard_ctl.status = SD_access_OK;
+			m1_fb_trim_expanded_file(); // A recording cut short keeps its whole extent
+		}
 		else if(sd_fres==FR_NO_FILESYSTEM)
 			sdcard_ctl.status = SD_access_NoFS;
 		else
@@ -698,6 +723,7 @@ void m1_sdcard_unmount(void)
 {
 	// Unmount a Logical Drive
     f_mount(0, sdcard_ctl.sdpath, 0);
+    sd_mount_generation++;
     sdcard_ctl.status = SD_access_UnMounted;
 	M1_LOG_I(M1_LOGDB_TAG, "Card unmounted.\r\n");
 } // void m1_sdcard_unmount(void)
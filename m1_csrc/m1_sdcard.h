@@ -99,6 +99,7 @@ S_M1_SDCard_Info *m1_sdcard_get_info(void);
 uint32_t m1_sdcard_get_total_capacity(void);
 uint32_t m1_sdcard_get_free_capacity(void);
 FRESULT m1_sdcard_get_error_code(void);
+uint32_t m1_sdcard_get_mount_generation(void);
 
 extern EXTI_HandleTypeDef sdcard_exti_hdl;
 extern TaskHandle_t		sdcard_task_hdl;
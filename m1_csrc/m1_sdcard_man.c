@@ -16,6 +16,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stddef.h>
 #include "stm32h5xx_hal.h"
 //#include "main.h"
 #include "m1_sdcard.h"
@@ -30,6 +31,10 @@
 
 #define M1_LOGDB_TAG		"SDM"
 #define SD_CHECK_TIME     	30000 //ms
+#define SDM_FREE_BUFFER_TIMEOUT	1000 //ms, longest time a producer waits for a free buffer
+#define SDM_SYNC_SIZE			(64*1024) // Bytes written between two f_sync calls
+#define SDM_TASK_QUEUE_SIZE		(M1_SDM_BUFFER_ARRAY_SIZE + 2) // All buffers but the one being filled, plus commands
+#define SDM_NEW_FILE_RETRY		3 // Existing files skipped before the directory is scanned
 
 //************************** C O N S T A N T **********************************/
 
@@ -49,6 +54,10 @@ static TimerHandle_t s_xstoptimer = NULL;
 TaskHandle_t m1_sdm_task_hdl;
 TimerHandle_t m1_sdm_timer_hdl;
 QueueHandle_t sdmtaskqueue, sdiosem;
+// Buffers that are neither being filled by the producer nor waiting for the SD card
+static SemaphoreHandle_t sdm_free_buf_sem = NULL;
+static S_M1_SDM_Stats_t sdm_stats;
+static uint32_t sdm_unsynced_size;
 
 volatile uint8_t log_dev_status = M1_DATALOG_IDLE;
 
@@ -56,6 +65,7 @@ volatile uint8_t log_dev_status = M1_DATALOG_IDLE;
 static void m1_sdm_memory_timer_callback(TimerHandle_t xTimer);
 static void m1_sdm_main_task(void *argument);
 static void m1_sdm_dataready(S_M1_SdCardManager_Q_t evt);
+static void m1_sdm_discard(S_M1_SdCardManager_Q_t evt);
 static uint8_t m1_sdm_startstop_logging(void);
 static uint8_t m1_sdm_start_logging(void);
 static uint8_t m1_sdm_stop_logging(void);
@@ -66,11 +76,20 @@ void m1_sdm_task_stop(void);
 static uint8_t m1_sdm_memory_init(void);
 static uint8_t m1_sdm_memory_deinit(void);
 uint32_t m1_sdm_getlastfilenumber(char *dirname, char *prefix);
+static uint32_t m1_sdm_index_checksum(const uint8_t *pdata, uint32_t size);
+static void m1_sdm_index_load(S_M1_SDM_Index_t *pindex);
+static S_M1_SDM_Index_Entry_t *m1_sdm_index_find(S_M1_SDM_Index_t *pindex, const char *pkey);
+static uint8_t m1_sdm_index_make_key(char *pkey, const char *dirname, const char *prefix, const char *ext);
+uint32_t m1_sdm_index_get_next(const char *dirname, const char *prefix, const char *ext, bool rescan);
+uint8_t m1_sdm_index_update(const char *dirname, const char *prefix, const char *ext, uint32_t file_n);
 uint8_t m1_sdm_get_logging_error(void);
 uint8_t m1_sdm_file_init(S_M1_SDM_DatFileInfo_t *pfileinfo);
 uint8_t m1_sdm_write_buffer(uint8_t *buffer, uint32_t size);
 uint8_t m1_sdm_fill_buffer(uint8_t *src, uint16_t srcSize);
+static uint8_t m1_sdm_claim_next_buffer(void);
 uint8_t m1_sdm_flush_buffer(void);
+void m1_sdm_get_stats(S_M1_SDM_Stats_t *pstats);
+void m1_sdm_reset_stats(void);
 uint8_t m1_sdm_close_all_files(void);
 static uint8_t m1_sdm_close_datfile(void);
 static uint8_t m1_sdm_sync_datfile(void);
@@ -154,14 +173,21 @@ static void m1_sdm_main_task(void *argument)
 	        }
 	        else if (evt.cmd_opt & M1_SDM_DATA_READY_MASK)     /* transfer data to sd card command */
 	        {
-	        	M1_LOG_N(M1_LOGDB_TAG, "sdm_main_task DATA_READY\r\n");
-	        	m1_sdm_dataready(evt);
+	        	M1_LOG_D(M1_LOGDB_TAG, "sdm_main_task DATA_READY\r\n");
+	        	if ( sd_logging_active )
+	        		m1_sdm_dataready(evt);
+	        	else
+	        		m1_sdm_discard(evt); // No file open to write to
 	        }
 	        else
 	        {
 	        	;
 	        }
 	    } // if (log_dev_status==M1_DATALOG_IDLE || log_dev_status==M1_DATALOG_SD_STARTED)
+	    else
+	    {
+	    	m1_sdm_discard(evt);
+	    }
 	} // for (;;)
 } // static void m1_sdm_main_task(void *argument)
 
@@ -222,6 +248,8 @@ static uint8_t m1_sdm_stop_logging(void)
 
 	xTimerStop(m1_sdm_timer_hdl, 0);
 	ret = m1_sdm_close_all_files();
+	M1_LOG_I(M1_LOGDB_TAG, "Written: %lu bytes, %lu buffers in %lu writes, high water: %d, stalls: %lu\r\n", sdm_stats.bytes_written,
+			sdm_stats.buffers_written, sdm_stats.write_calls, sdm_stats.buffers_high_water, sdm_stats.producer_stalls);
 	sd_logging_active = 0;
 	log_dev_status = M1_DATALOG_IDLE;
 
@@ -231,38 +259,84 @@ static uint8_t m1_sdm_stop_logging(void)
 
 /*============================================================================*/
 /**
-  * @brief  Handle M1_SDM_DATA_READY_MASK task message
-  * @param  None
+  * @brief  Handle M1_SDM_DATA_READY_MASK task message.
+  *         Full buffers queued back to back are adjacent in memory up to the end
+  *         of the buffer array, so they are written with a single f_write call
+  *         and FatFs can transfer them to the card in one multi-sector write.
+  * @param  evt first data ready message
   * @retval None
   */
 /*============================================================================*/
 static void m1_sdm_dataready(S_M1_SdCardManager_Q_t evt)
 {
-	uint32_t buf_size;
-	uint16_t write_size;
+	S_M1_SdCardManager_Q_t next_evt;
+	uint32_t buf_size, write_size;
 	uint8_t *dst;
-	uint8_t sdwrite_buffer_id;
+	uint8_t buffer_id, n_buffers;
 
-	sdwrite_buffer_id = evt.cmd_opt & ~(M1_SDM_DATA_READY_MASK);
-	if ( sdwrite_buffer_id >= M1_SDM_BUFFER_ARRAY_SIZE )
-		sdwrite_buffer_id = 0;
+	buffer_id = evt.cmd_opt & ~(M1_SDM_DATA_READY_MASK);
+	if ( buffer_id >= M1_SDM_BUFFER_ARRAY_SIZE )
+		buffer_id = 0;
 	dst = dev_sd_hdl.buff_info.sd_write_buffer;
 	buf_size = dev_sd_hdl.sdWriteBufferSize;
-	dst += buf_size*sdwrite_buffer_id;
+	dst += buf_size*buffer_id;
 	write_size = evt.write_size;
+	n_buffers = 1;
 
-    m1_sdm_write_buffer(dst, write_size);
-    M1_LOG_N(M1_LOGDB_TAG, "m1_sdm_dataready %d\r\n", sdwrite_buffer_id);
-    vTaskDelay(1);
-    //m1_test_gpio_pull_high();
-	m1_sdm_sync_datfile();
-	//m1_test_gpio_pull_low();
-	M1_LOG_N(M1_LOGDB_TAG, "sdm_sync OK\r\n");
-	vTaskDelay(1);
+	while ( (write_size==n_buffers*buf_size) && ((buffer_id + n_buffers) < M1_SDM_BUFFER_ARRAY_SIZE) )
+	{
+		if ( xQueuePeek(sdmtaskqueue, &next_evt, 0)!=pdTRUE )
+			break; // Nothing else to write yet
+		if ( next_evt.cmd_opt!=(M1_SDM_DATA_READY_MASK | (buffer_id + n_buffers)) )
+			break; // Command or buffer not adjacent
+		xQueueReceive(sdmtaskqueue, &next_evt, 0);
+		write_size += next_evt.write_size;
+		n_buffers++;
+	} // while ( (write_size==n_buffers*buf_size) && ((buffer_id + n_buffers) < M1_SDM_BUFFER_ARRAY_SIZE) )
+
+	if ( m1_sdm_write_buffer(dst, write_size) )
+		sdm_stats.write_errors++;
+	M1_LOG_D(M1_LOGDB_TAG, "m1_sdm_dataready %d x%d\r\n", buffer_id, n_buffers);
+	sdm_stats.write_calls++;
+	sdm_stats.buffers_written += n_buffers;
+	sdm_stats.bytes_written += write_size;
+
+	while ( n_buffers-- )
+	{
+		xSemaphoreGive(sdm_free_buf_sem); // Return the buffers to the producer
+	}
+
+	// f_sync updates the FAT and the directory entry, do it only once in a while
+	sdm_unsynced_size += write_size;
+	if ( sdm_unsynced_size >= SDM_SYNC_SIZE )
+	{
+		m1_sdm_sync_datfile();
+		sdm_unsynced_size = 0;
+	}
 } // static void m1_sdm_dataready(S_M1_SdCardManager_Q_t evt)
 
 
 
+/*============================================================================*/
+/**
+  * @brief  Drops a task message that is not handled.
+  *         The buffer of a data ready message goes back to the producer,
+  *         which would otherwise wait for it until SDM_FREE_BUFFER_TIMEOUT.
+  * @param  evt message
+  * @retval None
+  */
+/*============================================================================*/
+static void m1_sdm_discard(S_M1_SdCardManager_Q_t evt)
+{
+	if ( evt.cmd_opt & M1_SDM_DATA_READY_MASK )
+	{
+		M1_LOG_D(M1_LOGDB_TAG, "m1_sdm_discard %d\r\n", evt.cmd_opt & ~(M1_SDM_DATA_READY_MASK));
+		xSemaphoreGive(sdm_free_buf_sem);
+	}
+} // static void m1_sdm_discard(S_M1_SdCardManager_Q_t evt)
+
+
+
 /*============================================================================*/
 /**
   * @brief  PWR PVD interrupt callback
@@ -351,9 +425,16 @@ void m1_sdm_task_init(void)
 {
 	BaseType_t ret;
 
-	sdmtaskqueue = xQueueCreate(M1_SDM_BUFFER_ARRAY_SIZE, sizeof(S_M1_SdCardManager_Q_t));
+	sdmtaskqueue = xQueueCreate(SDM_TASK_QUEUE_SIZE, sizeof(S_M1_SdCardManager_Q_t));
 	assert(sdmtaskqueue != NULL);
 
+	// The producer owns the buffer being filled, all others are free
+	sdm_free_buf_sem = xSemaphoreCreateCounting(M1_SDM_BUFFER_ARRAY_SIZE - 1, M1_SDM_BUFFER_ARRAY_SIZE - 1);
+	assert(sdm_free_buf_sem != NULL);
+	sdwrite_buffer_id = 0;
+	sdm_unsynced_size = 0;
+	m1_sdm_reset_stats();
+
 	/*
 	Note that binary semaphores created using
 	 * the vSemaphoreCreateBinary() macro are created in a state such that the
@@ -409,6 +490,12 @@ void m1_sdm_task_deinit(void)
 		sdiosem = NULL;
 	}
 
+	if ( sdm_free_buf_sem!=NULL )
+	{
+		vSemaphoreDelete(sdm_free_buf_sem);
+		sdm_free_buf_sem = NULL;
+	}
+
 	if ( sdmtaskqueue!=NULL )
 	{
 		vQueueDelete(sdmtaskqueue);
@@ -470,7 +557,7 @@ void m1_sdm_task_stop(void)
 /*============================================================================*/
 static uint8_t m1_sdm_close_datfile(void)
 {
-	return f_close(m1_pdatfile_hdl);
+	return m1_fb_close_truncated_file(m1_pdatfile_hdl); // Release the unused part of the extent
 } // static uint8_t m1_sdm_close_datfile(void)
 
 
@@ -485,7 +572,7 @@ static uint8_t m1_sdm_close_datfile(void)
 /*============================================================================*/
 static uint8_t m1_sdm_sync_datfile(void)
 {
-	return f_sync(m1_pdatfile_hdl);
+	return m1_fb_sync_expanded_file(m1_pdatfile_hdl);
 } // static uint8_t m1_sdm_sync_datfile(void)
 
 
@@ -543,6 +630,202 @@ uint32_t m1_sdm_getlastfilenumber(char *dirname, char *prefix)
 
 
 
+/*============================================================================*/
+/**
+  * @brief  Checksum of the file index
+  * @param  pdata data
+  * @param  size number of bytes
+  * @retval CRC-32
+  */
+/*============================================================================*/
+static uint32_t m1_sdm_index_checksum(const uint8_t *pdata, uint32_t size)
+{
+	uint32_t crc;
+	uint8_t i;
+
+	crc = 0xFFFFFFFF;
+	while ( size-- )
+	{
+		crc ^= *pdata++;
+		for (i=0; i<8; i++)
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+	}
+
+	return ~crc;
+} // static uint32_t m1_sdm_index_checksum(const uint8_t *pdata, uint32_t size)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Reads the file index
+  * @param  pindex index, emptied if the file is missing or corrupted
+  * @retval None
+  */
+/*============================================================================*/
+static void m1_sdm_index_load(S_M1_SDM_Index_t *pindex)
+{
+	FIL file;
+	UINT count;
+
+	count = 0;
+	if ( f_open(&file, M1_SDM_INDEX_FILENAME, FA_READ)==FR_OK )
+	{
+		if ( f_read(&file, pindex, sizeof(S_M1_SDM_Index_t), &count)!=FR_OK )
+			count = 0;
+		f_close(&file);
+	} // if ( f_open(&file, M1_SDM_INDEX_FILENAME, FA_READ)==FR_OK )
+
+	if ( (count!=sizeof(S_M1_SDM_Index_t)) || (pindex->magic!=M1_SDM_INDEX_MAGIC) || (pindex->version!=M1_SDM_INDEX_VERSION)
+			|| (pindex->checksum!=m1_sdm_index_checksum((const uint8_t *)pindex, offsetof(S_M1_SDM_Index_t, checksum))) )
+	{
+		memset(pindex, 0, sizeof(S_M1_SDM_Index_t));
+		pindex->magic = M1_SDM_INDEX_MAGIC;
+		pindex->version = M1_SDM_INDEX_VERSION;
+	}
+} // static void m1_sdm_index_load(S_M1_SDM_Index_t *pindex)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Finds the entry of a directory and file name prefix in the file index
+  * @param  pindex index
+  * @param  pkey directory, prefix and extension, as made by m1_sdm_index_make_key()
+  * @retval entry, NULL if not found
+  */
+/*============================================================================*/
+static S_M1_SDM_Index_Entry_t *m1_sdm_index_find(S_M1_SDM_Index_t *pindex, const char *pkey)
+{
+	uint8_t i;
+
+	for (i=0; i<M1_SDM_INDEX_ENTRIES; i++)
+	{
+		if ( pindex->entry[i].key[0] && !strncmp(pindex->entry[i].key, pkey, M1_SDM_INDEX_KEY_LEN) )
+			return &pindex->entry[i];
+	}
+
+	return NULL;
+} // static S_M1_SDM_Index_Entry_t *m1_sdm_index_find(S_M1_SDM_Index_t *pindex, const char *pkey)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Makes the key of a file index entry
+  * @param  pkey key, M1_SDM_INDEX_KEY_LEN bytes
+  * @param  dirname directory
+  * @param  prefix file name prefix
+  * @param  ext file name extension
+  * @retval 0 if OK, 1 if too long to be indexed
+  */
+/*============================================================================*/
+static uint8_t m1_sdm_index_make_key(char *pkey, const char *dirname, const char *prefix, const char *ext)
+{
+	return (snprintf(pkey, M1_SDM_INDEX_KEY_LEN, "%s/%s*%s", dirname, prefix, ext) >= M1_SDM_INDEX_KEY_LEN);
+} // static uint8_t m1_sdm_index_make_key(char *pkey, const char *dirname, const char *prefix, const char *ext)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Returns the number for the next file with the given prefix in a directory.
+  *         The number comes from the file index, the directory is only scanned
+  *         when it has no entry there.
+  * @param  dirname directory
+  * @param  prefix file name prefix, the number follows it
+  * @param  ext file name extension
+  * @param  rescan true to ignore the file index
+  * @retval number following the highest one given
+  */
+/*============================================================================*/
+uint32_t m1_sdm_index_get_next(const char *dirname, const char *prefix, const char *ext, bool rescan)
+{
+	S_M1_SDM_Index_t *pindex;
+	S_M1_SDM_Index_Entry_t *pentry;
+	char key[M1_SDM_INDEX_KEY_LEN];
+	uint32_t file_n;
+
+	file_n = 0;
+	if ( !rescan && !m1_sdm_index_make_key(key, dirname, prefix, ext) )
+	{
+		pindex = malloc(sizeof(S_M1_SDM_Index_t));
+		assert(pindex!=NULL);
+		m1_sdm_index_load(pindex);
+		pentry = m1_sdm_index_find(pindex, key);
+		if ( pentry!=NULL )
+			file_n = pentry->last_number + 1;
+		free(pindex);
+	} // if ( !rescan && !m1_sdm_index_make_key(key, dirname, prefix, ext) )
+
+	if ( !file_n ) // Not indexed
+	{
+		M1_LOG_I(M1_LOGDB_TAG, "Scanning %s for %s*\r\n", dirname, prefix);
+		file_n = m1_sdm_getlastfilenumber((char *)dirname, (char *)prefix) + 1;
+	}
+
+	return file_n;
+} // uint32_t m1_sdm_index_get_next(const char *dirname, const char *prefix, const char *ext, bool rescan)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Records the number of a new file in the file index
+  * @param  dirname directory
+  * @param  prefix file name prefix
+  * @param  ext file name extension
+  * @param  file_n number of the new file
+  * @retval 0 if OK
+  */
+/*============================================================================*/
+uint8_t m1_sdm_index_update(const char *dirname, const char *prefix, const char *ext, uint32_t file_n)
+{
+	S_M1_SDM_Index_t *pindex;
+	S_M1_SDM_Index_Entry_t *pentry;
+	char key[M1_SDM_INDEX_KEY_LEN];
+	FIL file;
+	UINT count;
+	FRESULT fr;
+	bool created;
+
+	if ( m1_sdm_index_make_key(key, dirname, prefix, ext) )
+		return 1; // Not indexed, the directory is scanned each time
+
+	pindex = malloc(sizeof(S_M1_SDM_Index_t));
+	assert(pindex!=NULL);
+	m1_sdm_index_load(pindex);
+	pentry = m1_sdm_index_find(pindex, key);
+	if ( pentry==NULL )
+	{
+		// Most recent entry first, the oldest one is dropped
+		memmove(&pindex->entry[1], &pindex->entry[0], (M1_SDM_INDEX_ENTRIES - 1)*sizeof(S_M1_SDM_Index_Entry_t));
+		pentry = &pindex->entry[0];
+		memset(pentry, 0, sizeof(S_M1_SDM_Index_Entry_t));
+		strcpy(pentry->key, key);
+	} // if ( pentry==NULL )
+	pentry->last_number = file_n;
+	pindex->checksum = m1_sdm_index_checksum((const uint8_t *)pindex, offsetof(S_M1_SDM_Index_t, checksum));
+
+	// Rewritten in place, the size of the file does not change
+	fr = f_open(&file, M1_SDM_INDEX_FILENAME, FA_OPEN_ALWAYS | FA_WRITE);
+	if ( fr==FR_OK )
+	{
+		created = (f_size(&file)==0);
+		fr = f_write(&file, pindex, sizeof(S_M1_SDM_Index_t), &count);
+		if ( (fr==FR_OK) && (count!=sizeof(S_M1_SDM_Index_t)) )
+			fr = FR_DENIED;
+		f_close(&file);
+		if ( (fr==FR_OK) && created )
+			f_chmod(M1_SDM_INDEX_FILENAME, AM_HID, AM_HID); // Not listed by the file browser
+	} // if ( fr==FR_OK )
+	free(pindex);
+
+	return (fr==FR_OK)?0:1;
+} // uint8_t m1_sdm_index_update(const char *dirname, const char *prefix, const char *ext, uint32_t file_n)
+
+
+
 /*============================================================================*/
 /**
   * @brief  Open file to store raw data and a JSON file with the device configuration
@@ -552,8 +835,10 @@ uint32_t m1_sdm_getlastfilenumber(char *dirname, char *prefix)
 /*============================================================================*/
 uint8_t m1_sdm_file_init(S_M1_SDM_DatFileInfo_t *pfileinfo)
 {
-	uint8_t ret;
+	uint8_t ret, retry;
 	uint32_t file_number;
+	char prefix[sizeof(pfileinfo->dat_filename)];
+	FRESULT fr;
 
 	if ( m1_sdcard_get_status()!=SD_access_OK )
 		return 1;
@@ -567,28 +852,42 @@ uint8_t m1_sdm_file_init(S_M1_SDM_DatFileInfo_t *pfileinfo)
 	    }
 	} // if (!m1_fb_check_existence(dir_name))
 
-	sprintf(pfileinfo->dat_filename, "%s%s%s_", pfileinfo->file_prefix, pfileinfo->file_infix, pfileinfo->file_suffix);
-	file_number = m1_sdm_getlastfilenumber(pfileinfo->dir_name, pfileinfo->dat_filename);
-	file_number++;
-    //srand(HAL_GetTick());
-    do
-    {
-    	sprintf(pfileinfo->dat_filename, "%s/%s%s%s_%d%s", pfileinfo->dir_name, pfileinfo->file_prefix, pfileinfo->file_infix, pfileinfo->file_suffix, file_number++, pfileinfo->file_ext);
-    } while (m1_fb_check_existence(pfileinfo->dat_filename));
-
+	sprintf(prefix, "%s%s%s_", pfileinfo->file_prefix, pfileinfo->file_infix, pfileinfo->file_suffix);
+	file_number = m1_sdm_index_get_next(pfileinfo->dir_name, prefix, pfileinfo->file_ext, false);
     m1_pdatfile_hdl = &pfileinfo->dat_file_hdl;
+    // FA_CREATE_NEW checks the existence of the file in the same directory lookup
+    retry = 0;
+    while ( true )
+    {
+    	sprintf(pfileinfo->dat_filename, "%s/%s%lu%s", pfileinfo->dir_name, prefix, file_number, pfileinfo->file_ext);
+    	fr = f_open(m1_pdatfile_hdl, pfileinfo->dat_filename, FA_CREATE_NEW | FA_WRITE);
+    	if ( fr!=FR_EXIST )
+    		break;
+    	if ( ++retry==SDM_NEW_FILE_RETRY ) // Files added by another device, the index is behind
+    		file_number = m1_sdm_index_get_next(pfileinfo->dir_name, prefix, pfileinfo->file_ext, true);
+    	else
+    		file_number++;
+    } // while ( true )
 
-    ret = m1_fb_open_new_file(m1_pdatfile_hdl, pfileinfo->dat_filename);
-    if (ret)
+    if ( fr!=FR_OK )
     {
     	M1_LOG_E(M1_LOGDB_TAG, "Error creating file on SD card!");
     	return 1;
     }
+    m1_fb_dir_changed((char *)pfileinfo->dat_filename);
+    m1_sdm_index_update(pfileinfo->dir_name, prefix, pfileinfo->file_ext, file_number);
+
+    // Writes to a contiguous extent do not grow the cluster chain on the fly.
+    // Without enough contiguous space, the file grows one cluster at a time.
+    if ( m1_fb_expand_file(m1_pdatfile_hdl, pfileinfo->dat_filename, M1_SDM_PREALLOC_SIZE) )
+    {
+    	M1_LOG_I(M1_LOGDB_TAG, "File not preallocated\r\n");
+    }
 
     ret = m1_sdm_memory_init();
     if ( ret )
     {
-    	m1_fb_close_file(m1_pdatfile_hdl);
+    	m1_fb_close_truncated_file(m1_pdatfile_hdl);
     	m1_fb_delete_file(pfileinfo->dat_filename);
     	return 2;
     }
@@ -671,119 +970,135 @@ uint8_t m1_sdm_flush_buffer(void)
 
 	dev_sd_hdl.buff_info.sd_write_buffer_idx = 0;
 	sdwrite_buffer_id = 0;
+	sdm_unsynced_size = 0; // f_close syncs the file
 
 	return ret;
 } // uint8_t m1_sdm_flush_buffer(void)
 
 
-#define SDM_FILL_BUFFER_VERSION	1
 /*============================================================================*/
 /**
-  * @brief  Fill SD buffer with new data
-  * @param
-  * @param  src: pointer to data buffer
-  * @param  srcSize: buffer size
-  * @retval 0: ok
+  * @brief  Hand the full buffer over to the SD card manager task and switch to the next one.
+  *         The caller blocks only if all other buffers are still waiting for the SD card.
+  * @param  None
+  * @retval 0: ok, 1: no free buffer within SDM_FREE_BUFFER_TIMEOUT
   */
 /*============================================================================*/
-#if SDM_FILL_BUFFER_VERSION==2
-uint8_t m1_sdm_fill_buffer(uint8_t *src, uint16_t srcSize)
+static uint8_t m1_sdm_claim_next_buffer(void)
 {
-	uint8_t *dst;
-	uint32_t n_copy;
-	uint32_t dstSize;
-	static uint8_t sdwrite_buffer_id = 0;
-	S_M1_SdCardManager_Q_t q_item;
+	S_M1_SdCardManager_Q_t q_item = {0};
+	TickType_t t_start, t_wait;
+	uint8_t n_pending;
 
-	vTaskDelay(10); // Give the SD main task some time to do its job
-	M1_LOG_I(M1_LOGDB_TAG, "m1_sdm_fill_buffer %d..\r\n", sdwrite_buffer_id);
-	if ( uxQueueSpacesAvailable(sdmtaskqueue)==0 ) // Queue is full?
+	if ( xSemaphoreTake(sdm_free_buf_sem, 0)!=pdTRUE ) // No free buffer?
 	{
-		M1_LOG_N(M1_LOGDB_TAG, "Full!\r\n"); // Skip this data block
-		return 1;
-	} // if ( uxQueueSpacesAvailable(sdmtaskqueue)==0 )
+		sdm_stats.producer_stalls++;
+		t_start = xTaskGetTickCount();
+		if ( xSemaphoreTake(sdm_free_buf_sem, pdMS_TO_TICKS(SDM_FREE_BUFFER_TIMEOUT))!=pdTRUE )
+		{
+			M1_LOG_N(M1_LOGDB_TAG, "No free buffer!\r\n");
+			return 1;
+		}
+		t_wait = xTaskGetTickCount() - t_start;
+		if ( t_wait > sdm_stats.stall_ticks_max )
+			sdm_stats.stall_ticks_max = t_wait;
+	} // if ( xSemaphoreTake(sdm_free_buf_sem, 0)!=pdTRUE )
+
+	n_pending = (M1_SDM_BUFFER_ARRAY_SIZE - 1) - uxSemaphoreGetCount(sdm_free_buf_sem);
+	if ( n_pending > sdm_stats.buffers_high_water )
+		sdm_stats.buffers_high_water = n_pending;
+
+	q_item.cmd_opt = M1_SDM_DATA_READY_MASK | sdwrite_buffer_id;
+	q_item.write_size = dev_sd_hdl.buff_info.sd_write_buffer_idx;
+	xQueueSend(sdmtaskqueue, &q_item, portMAX_DELAY); // The queue has room for all buffers
 
-	dstSize = dev_sd_hdl.sdWriteBufferSize;
-	dst = dev_sd_hdl.buff_info.sd_write_buffer;
-	dst += dstSize*sdwrite_buffer_id;
-    n_copy = (srcSize < dstSize )?srcSize:dstSize;
-    memcpy(dst, src, n_copy); // Copy to the destination buffer
-    q_item.cmd_opt = M1_SDM_DATA_READY_MASK | sdwrite_buffer_id;
-	q_item.write_size = n_copy;
 	sdwrite_buffer_id++;
 	if ( sdwrite_buffer_id >= M1_SDM_BUFFER_ARRAY_SIZE )
 		sdwrite_buffer_id = 0;
-	if ( xQueueSend(sdmtaskqueue, &q_item, 0) != pdPASS )
-	{
-		M1_LOG_N(M1_LOGDB_TAG, "Full!\r\n");
-		return 1;
-	}
+	dev_sd_hdl.buff_info.sd_write_buffer_idx = 0;
 
 	return 0;
-} // uint8_t m1_sdm_fill_buffer(uint8_t *src, uint16_t srcSize)
+} // static uint8_t m1_sdm_claim_next_buffer(void)
 
-#elif SDM_FILL_BUFFER_VERSION==1
 
+
+/*============================================================================*/
+/**
+  * @brief  Fill SD buffer with new data
+  * @param
+  * @param  src: pointer to data buffer
+  * @param  srcSize: buffer size
+  * @retval 0: ok, 1: data dropped, the SD card could not keep up
+  */
+/*============================================================================*/
 uint8_t m1_sdm_fill_buffer(uint8_t *src, uint16_t srcSize)
 {
 	uint8_t *dst;
-	uint32_t n_free, n_copy;
+	uint32_t n_copy;
 	uint32_t dstP, dstSize;
-	S_M1_SdCardManager_Q_t q_item = {0};
-
-	vTaskDelay(10); // Give the SD main task some time to do its job
-	M1_LOG_N(M1_LOGDB_TAG, "m1_sdm_fill_buffer %d..", sdwrite_buffer_id);
-	if ( uxQueueSpacesAvailable(sdmtaskqueue)==0 ) // Queue is full?
-	{
-		M1_LOG_N(M1_LOGDB_TAG, " Full!\r\n"); // Skip this data block
-		vTaskDelay(10); // Give the SD main task more time
-		return 1;
-	} // if ( uxQueueSpacesAvailable(sdmtaskqueue)==0 )
 
 	dstSize = dev_sd_hdl.sdWriteBufferSize;
-	dst = dev_sd_hdl.buff_info.sd_write_buffer;
-	dst += dstSize*sdwrite_buffer_id;
-	dstP = dev_sd_hdl.buff_info.sd_write_buffer_idx;
-
-	n_free = dstSize - dstP;
-    n_copy = (n_free < srcSize)?n_free:srcSize;
-    memcpy(&dst[dstP], src, n_copy); // Copy to the destination buffer
-    dstP += n_copy; // Update the destination index
-    srcSize -= n_copy; // Update the remainder
-    if (dstP >= dstSize) // Index got an overflow?
-    {
-    	dstP = 0; // Reset
-        q_item.cmd_opt = M1_SDM_DATA_READY_MASK | sdwrite_buffer_id;
-        q_item.write_size = dstSize;
-    	sdwrite_buffer_id++;
-    	if ( sdwrite_buffer_id >= M1_SDM_BUFFER_ARRAY_SIZE )
-    	{
-    		sdwrite_buffer_id = 0;
-    		dst = dev_sd_hdl.buff_info.sd_write_buffer;
-    	} // if ( sdwrite_buffer_id >= M1_SDM_BUFFER_ARRAY_SIZE )
-    	else
-    	{
-    		dst += dstSize;
-    	}
-    } // if (dstP >= dstSize)
-    if (srcSize > 0) // Remainder needs to be copied?
-    {
-        memcpy(&dst[dstP], &src[n_copy], srcSize); // Copy the remainder to the start of the buffer
-        dstP = srcSize; // Update the index
-    }
-	dev_sd_hdl.buff_info.sd_write_buffer_idx = dstP; // Update new write index
-
-	if ( q_item.cmd_opt & M1_SDM_DATA_READY_MASK )
+	while ( srcSize > 0 )
 	{
-		xQueueSend(sdmtaskqueue, &q_item, 0);
-		M1_LOG_N(M1_LOGDB_TAG, " queued OK!\r\n");
-	} // if ( q_item.cmd_opt & M1_SDM_DATA_READY_MASK )
+		if ( dev_sd_hdl.buff_info.sd_write_buffer_idx >= dstSize ) // Left full by a previous timeout?
+		{
+			if ( m1_sdm_claim_next_buffer() )
+			{
+				sdm_stats.dropped_bytes += srcSize;
+				return 1;
+			}
+		} // if ( dev_sd_hdl.buff_info.sd_write_buffer_idx >= dstSize )
+
+		dst = dev_sd_hdl.buff_info.sd_write_buffer;
+		dst += dstSize*sdwrite_buffer_id;
+		dstP = dev_sd_hdl.buff_info.sd_write_buffer_idx;
+		n_copy = dstSize - dstP;
+		if ( n_copy > srcSize )
+			n_copy = srcSize;
+		memcpy(&dst[dstP], src, n_copy); // Copy to the destination buffer
+		dev_sd_hdl.buff_info.sd_write_buffer_idx = dstP + n_copy; // Update new write index
+		src += n_copy;
+		srcSize -= n_copy;
+	} // while ( srcSize > 0 )
+
+	// Hand the buffer over as soon as it is full so that the SD card can start on it
+	if ( dev_sd_hdl.buff_info.sd_write_buffer_idx >= dstSize )
+		m1_sdm_claim_next_buffer(); // Retried on the next call if it times out
 
 	return 0;
 } // uint8_t m1_sdm_fill_buffer(uint8_t *src, uint16_t srcSize)
-#else
-#error "SDM_FILL_BUFFER_VERSION is not defined yet!"
-#endif // #elif SDM_FILL_BUFFER_VERSION==1
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Get the write-behind statistics of the current or last logging session
+  * @param  pstats copy of the statistics
+  * @retval None
+  */
+/*============================================================================*/
+void m1_sdm_get_stats(S_M1_SDM_Stats_t *pstats)
+{
+	taskENTER_CRITICAL();
+	*pstats = sdm_stats;
+	taskEXIT_CRITICAL();
+} // void m1_sdm_get_stats(S_M1_SDM_Stats_t *pstats)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Reset the write-behind statistics
+  * @param  None
+  * @retval None
+  */
+/*============================================================================*/
+void m1_sdm_reset_stats(void)
+{
+	taskENTER_CRITICAL();
+	memset(&sdm_stats, 0, sizeof(sdm_stats));
+	taskEXIT_CRITICAL();
+} // void m1_sdm_reset_stats(void)
 
 
 /*============================================================================*/
@@ -27,6 +27,7 @@
 #define M1_SDM_BUFFER_RAM_USAGE    	458752
 #define M1_SDM_MIN_BUFFER_SIZE     	4096//3072//10240//5120//2560//3072//3840
 #define M1_SDM_BUFFER_ARRAY_SIZE	7
+#define M1_SDM_PREALLOC_SIZE		(1024*1024) // Contiguous extent preallocated to a new data file
 
 #define NFC_FILEPATH				"/NFC"
 #define NFC_FILE_EXTENSION			".nfc"
@@ -42,6 +43,19 @@
 
 #define CONCAT_FILEPATH_FILENAME(fpath, fname) fpath fname
 
+/*
+ * File index
+ * Holds the number of the last file created in each data directory, for each
+ * file name prefix, so a new file does not need a scan of the whole directory.
+ * It is kept in the root directory, whose lookups stay short.
+ * A directory missing from the index, or a corrupted index, falls back to a scan.
+ */
+#define M1_SDM_INDEX_FILENAME		"/.m1index"
+#define M1_SDM_INDEX_MAGIC			0x5844494D // "MIDX"
+#define M1_SDM_INDEX_VERSION		1
+#define M1_SDM_INDEX_ENTRIES		10 // The index fits in one sector
+#define M1_SDM_INDEX_KEY_LEN		44 // "<directory>/<prefix>*<extension>"
+
 typedef struct
 {
 	const char *dir_name;
@@ -53,6 +67,21 @@ typedef struct
 	FIL dat_file_hdl;
 } S_M1_SDM_DatFileInfo_t;
 
+typedef struct
+{
+	char key[M1_SDM_INDEX_KEY_LEN];
+	uint32_t last_number;
+} S_M1_SDM_Index_Entry_t;
+
+typedef struct
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	S_M1_SDM_Index_Entry_t entry[M1_SDM_INDEX_ENTRIES]; // Most recently added first
+	uint32_t checksum; // CRC-32 of the fields above
+} S_M1_SDM_Index_t;
+
 typedef struct
 {
 	uint8_t *sd_write_buffer;
@@ -66,6 +95,18 @@ typedef struct
 	S_M1_SDM_Buffer_Info_t buff_info;
 } S_M1_SDM_Device_Info_t;
 
+typedef struct
+{
+	uint32_t bytes_written;
+	uint32_t buffers_written;
+	uint32_t write_calls; // f_write calls, each one may cover several adjacent buffers
+	uint32_t write_errors;
+	uint32_t producer_stalls; // Times the producer found no free buffer and had to wait
+	uint32_t stall_ticks_max; // Longest wait for a free buffer
+	uint32_t dropped_bytes; // Data discarded after waiting SDM_FREE_BUFFER_TIMEOUT
+	uint8_t buffers_high_water; // Most buffers waiting for the SD card at the same time
+} S_M1_SDM_Stats_t;
+
 void m1_sdm_task_init(void);
 void m1_sdm_task_deinit(void);
 void m1_sdm_task_start(void);
@@ -79,6 +120,10 @@ uint8_t m1_sdm_flush_buffer(void);
 uint8_t m1_sdm_fill_buffer(uint8_t *src, uint16_t srcSize);
 uint8_t m1_sdm_get_logging_error(void);
 uint32_t m1_sdm_getlastfilenumber(char *dirname, char *prefix);
+uint32_t m1_sdm_index_get_next(const char *dirname, const char *prefix, const char *ext, bool rescan);
+uint8_t m1_sdm_index_update(const char *dirname, const char *prefix, const char *ext, uint32_t file_n);
+void m1_sdm_get_stats(S_M1_SDM_Stats_t *pstats);
+void m1_sdm_reset_stats(void);
 
 #ifdef __cplusplus
 }
@@ -23,6 +23,8 @@
 #include "m1_sub_ghz_api.h"
 //#include "m1_sub_ghz.h"
 #include "m1_sub_ghz_decenc.h"
+#include "m1_sub_ghz_rawfile.h"
+#include "m1_sub_ghz_sweep.h"
 #include "m1_ring_buffer.h"
 #include "m1_storage.h"
 #include "m1_sdcard_man.h"
@@ -31,6 +33,7 @@
 /*************************** D E F I N E S ************************************/
 
 #define SUBGHZ_RAW_DATA_SAMPLES_MAX			64000 // data type of sample: uint16_t
+#define SUBGHZ_RAW_RING_SAMPLES_MAX			65536 // Capture ring, a power of two for the index masking
 
 #define SUBGHZ_TX_RAW_REPLAY_REPEAT_DEFAULT		0 // 2 plus the first transmit before repeating
 
@@ -39,7 +42,6 @@
 #define NOISE_FLOOR_RSSI_THRESHOLD		-110 //dBm
 #define SIGNAL_TO_NOISE_RATIO			20 //dB
 
-#define CHANNEL_STEPS_MAX				256
 #define CHANNEL_STEP					(float)0.25 // MHz
 
 #define SUB_GHZ_433_92_NEW_PDTC			0x6C // Attack and decay times of the OOK Peak Detector - Default: 0x28
@@ -56,6 +58,8 @@
 #define SUB_GHZ_DATAFILE_FILETYPE_NOISE		"NOISE"
 #define SUB_GHZ_DATAFILE_FILETYPE_PACKET	"PACKET"
 #define SUB_GHZ_DATAFILE_FILETYPE_KEYWORD	SUB_GHZ_DATAFILE_FILETYPE_NOISE
+#define SUB_GHZ_DATAFILE_LINE_MAX			64 // Header lines
+#define SUB_GHZ_RAW_FILE_BLOCK_SIZE			(M1_SDM_MIN_BUFFER_SIZE/4)
 
 #define SUB_GHZ_RAW_DATA_PARSER_ERROR_MASK	0x80
 #define SUB_GHZ_RAW_DATA_PARSER_ERROR_L1	0x81
@@ -234,6 +238,17 @@ typedef enum {
 	SUBGHZ_RECORD_DISPLAY_PARAM_SYS_ERROR
 } S_M1_SubGHz_Record_Display_Param_t;
 
+typedef struct
+{
+	FIL dst_file;
+	S_SubGHz_RawFile_Header_t header;
+	uint8_t *pbuffer;
+	bool src_binary;
+	bool header_written;
+	uint8_t sign;
+	uint8_t error;
+} S_M1_SubGHz_Raw_Convert_t;
+
 typedef enum {
 	SUBGHZ_REPLAY_DISPLAY_PARAM_ACTIVE = 0,
 	SUBGHZ_REPLAY_DISPLAY_PARAM_PLAY,
@@ -247,10 +262,9 @@ TIM_HandleTypeDef   timerhdl_subghz_rx;
 EXTI_HandleTypeDef 	si4463_exti_hdl;
 DMA_HandleTypeDef hdma_subghz_tx;
 
-S_M1_RingBuffer subghz_rx_rawdata_rb;
+S_M1_SpscRingBuffer subghz_rx_rawdata_rb;
 static uint16_t *subghz_front_buffer = NULL;
-static uint16_t subghz_front_buffer_size = 0;
-static uint8_t *subghz_ring_read_buffer = NULL;
+static uint32_t subghz_front_buffer_size = 0;
 static uint8_t *subghz_sdcard_write_buffer = NULL;
 static uint8_t *sdcard_dat_buffer = NULL;
 static uint8_t *sdcard_buffer_run_ptr = NULL;
@@ -271,6 +285,11 @@ static uint8_t subghz_replay_band, subghz_replay_channel;
 static float subghz_replay_freq;
 static S_M1_file_info *f_info = NULL;
 static S_M1_SDM_DatFileInfo_t datfile_info;
+static DWORD datfile_clmt[M1_FB_CLMT_SIZE]; // Keeps SD card reads short during replay
+static bool subghz_raw_file_binary = false;
+static S_SubGHz_RawFile_Header_t subghz_raw_file_header;
+static S_SubGHz_Sweep_Frame_t subghz_sweep_frame;
+static S_M1_SubGHz_Raw_Convert_t *pconvert = NULL;
 S_M1_Q_Union_t *subghz_rx_q = NULL;
 S_M1_SubGHz_Scan_Config subghz_scan_config =
 {
@@ -313,7 +332,14 @@ static uint8_t sub_ghz_replay_continue(uint8_t ret_code_in);
 static uint8_t sub_ghz_fcc_ism_band_check(uint8_t band, uint8_t channel);
 static void sub_ghz_buffer_rotate(S_M1_RingBuffer *prb_handle);
 static uint8_t sub_ghz_parse_raw_data(uint8_t buffer_ptr_id);
+static uint8_t sub_ghz_parse_raw_bin_data(uint8_t buffer_ptr_id);
 static uint8_t sub_ghz_file_load(void);
+static void sub_ghz_raw_text_header_line(char *line, S_SubGHz_RawFile_Header_t *phdr);
+static uint8_t sub_ghz_raw_file_scan(FIL *pfile, S_SubGHz_RawFile_Header_t *phdr, bool *pbinary,
+		void (*psample_handler)(const uint16_t *psamples, uint16_t count));
+static void sub_ghz_raw_convert_header(void);
+static void sub_ghz_raw_convert_samples(const uint16_t *psamples, uint16_t count);
+uint8_t sub_ghz_raw_file_convert(const char *src_filename, const char *dst_filename);
 
 static void subghz_record_gui_init(void);
 static void subghz_record_gui_create(uint8_t param);
@@ -457,6 +483,15 @@ static void sub_ghz_set_opmode(uint8_t opmode, uint8_t band, uint8_t channel, ui
 			break;
 	} // switch(band)
 
+	if ( opmode==SUB_GHZ_OPMODE_TX )
+	{
+		// Direct mode asynchronous mode, TX direct mode on GPIO2,  modulation is sourced in real-time, OOK
+		// Mode: TX_DIRECT_MODE_TYPE[7]	TX_DIRECT_MODE_GPIO[6:5]	MOD_SOURCE[4:3]	MOD_TYPE[2:0]
+		//					1					10						01				000
+		// The modulation type is loaded together with the configuration
+		mod_type |= 0xC8;
+	} // if ( opmode==SUB_GHZ_OPMODE_TX )
+	subghz_rssi_worker_stop(); // No RSSI sampling while the radio is reconfigured
 	radio_init_rx_tx(freq, mod_type, SI446x_Get_Reset_Stat());
 	SI446x_Select_Frontend(freq);
 
@@ -476,12 +511,6 @@ static void sub_ghz_set_opmode(uint8_t opmode, uint8_t band, uint8_t channel, ui
 			radio_set_antenna_mode(RADIO_ANTENNA_MODE_TX);
 			// Read INTs, clear pending ones
 			SI446x_Get_IntStatus(0, 0, 0);
-			// Direct mode asynchronous mode, TX direct mode on GPIO2,  modulation is sourced in real-time, OOK
-			// Mode: TX_DIRECT_MODE_TYPE[7]	TX_DIRECT_MODE_GPIO[6:5]	MOD_SOURCE[4:3]	MOD_TYPE[2:0]
-			//					1					10						01				000
-			SI446x_Change_ModType(0xC8 | mod_type);
-			// Read INTs, clear pending ones
-			SI446x_Get_IntStatus(0, 0, 0);
 			/* Start sending packet, channel 0, START immediately */
 			Radio_Start_Tx(channel, START_TX_COMPLETE_STATE_NOCHANGE, 0); // Do not change state after completion of the packet transmission
 			//SI446x_Start_Tx_CW(uint8_t channel);
@@ -725,7 +754,7 @@ static int subghz_record_gui_message(void)
 		{
 			//arrpush(subghz_rx_q, q_item);
 			//m1_buzzer_notification();
-			rcv_samples = ringbuffer_get_data_slots(&subghz_rx_rawdata_rb);
+			rcv_samples = m1_spsc_rb_get_data_slots(&subghz_rx_rawdata_rb);
 			if ( rcv_samples >= SUBGHZ_RAW_DATA_SAMPLES_TO_RW )
 			{
 				M1_LOG_N(M1_LOGDB_TAG, "Raw samples %d\r\n", rcv_samples);
@@ -831,7 +860,7 @@ static int subghz_record_kp_handler(void)
 					m1_sdm_task_start();
 					sub_ghz_rx_raw_save(true, false);
 					xQueueReset(main_q_hdl); // Reset old samples in the queue, if any
-					m1_ringbuffer_reset(&subghz_rx_rawdata_rb); // Reset sample ring buffer
+					m1_spsc_rb_reset(&subghz_rx_rawdata_rb); // Reset sample ring buffer
 					m1_led_fast_blink(LED_BLINK_ON_RGB, LED_FASTBLINK_PWM_M, LED_FASTBLINK_ONTIME_M); // Turn on
 					sub_ghz_tx_raw_deinit();
 					subghz_decenc_ctl.pulse_det_stat = PULSE_DET_ACTIVE;
@@ -1321,20 +1350,38 @@ static uint8_t sub_ghz_file_load(void)
 		if ( sys_error )
 			break;
 
-		token = strtok(sdcard_dat_buffer, "\r\n"); // Filetype
-		key_len = SUB_GHZ_DATAFILE_RAW_FORMAT_N;
-		if ( strstr(token, SUB_GHZ_DATAFILE_FILETYPE_PACKET) )
+		sys_error = 1;
+		if ( subghz_raw_file_binary )
 		{
-			key_len = SUB_GHZ_DATAFILE_RAW_FORMAT_N;
-			break; // Not support for now.
-		} // if ( strstr(token, SUB_GHZ_DATAFILE_FILETYPE_PACKET) )
-		token = strtok(NULL, "\r\n"); // Version
-		token = strtok(NULL, "\r\n"); // Frequency
-		str = strstr(token, ":");
-		str += 1; // Move to the frequency value
-		subghz_replay_freq = strtol(str, &end_ptr, 10);
+			subghz_replay_freq = subghz_raw_file_header.frequency;
+			subghz_replay_mod = subghz_raw_file_header.modulation;
+		} // if ( subghz_raw_file_binary )
+		else
+		{
+			token = strtok(sdcard_dat_buffer, "\r\n"); // Filetype
+			if ( strstr(token, SUB_GHZ_DATAFILE_FILETYPE_PACKET) )
+			{
+				break; // Not support for now.
+			} // if ( strstr(token, SUB_GHZ_DATAFILE_FILETYPE_PACKET) )
+			token = strtok(NULL, "\r\n"); // Version
+			token = strtok(NULL, "\r\n"); // Frequency
+			str = strstr(token, ":");
+			str += 1; // Move to the frequency value
+			subghz_replay_freq = strtol(str, &end_ptr, 10);
+
+			token = strtok(NULL, "\r\n"); // Modulation
+			m1_strtoupper(token);
+			for (subghz_replay_mod=0; subghz_replay_mod<SUBGHZ_MODULATION_LIST; subghz_replay_mod++)
+			{
+				if ( strstr(token, subghz_modulation_text[subghz_replay_mod]) )
+					break;
+			}
+		} // else
 		if ( subghz_replay_freq==0 )
 			break;
+		if ( subghz_replay_mod >= SUBGHZ_MODULATION_LIST ) // Not found?
+			break;
+
 		subghz_replay_freq /= 1000000; // Convert frequency from Hz to MHz
 		for (subghz_replay_band=0; subghz_replay_band<SUB_GHZ_BAND_EOL; subghz_replay_band++)
 		{
@@ -1353,15 +1400,6 @@ static uint8_t sub_ghz_file_load(void)
 			subghz_replay_channel++;
 		} // while ( subghz_replay_freq > freq_min )
 
-		token = strtok(NULL, "\r\n"); // Modulation
-		m1_strtoupper(token);
-		for (subghz_replay_mod=0; subghz_replay_mod<SUBGHZ_MODULATION_LIST; subghz_replay_mod++)
-		{
-			if ( strstr(token, subghz_modulation_text[subghz_replay_mod]) )
-				break;
-		}
-		if ( subghz_replay_mod >= SUBGHZ_MODULATION_LIST ) // Not found?
-			break;
 		sys_error = 0; // Reset, no error
 	} while (0);
 
@@ -1406,12 +1444,14 @@ void sub_ghz_frequency_reader(void)
 	S_M1_Buttons_Status this_button_status;
 	S_M1_Main_Q_t q_item;
 	BaseType_t ret;
-	int16_t rssi, rssi_max, rssi_avg, freq_step;
+	S_SubGHz_Sweep_Band_t sweep_bands[SUB_GHZ_BAND_EOL];
+	int16_t rssi, rssi_avg;
 	int16_t avg_noisefloor[SUB_GHZ_BAND_EOL][3];
-	uint8_t active_band_id, i, j, asf_sample_count, detection_count;
+	uint16_t n;
+	uint8_t active_band_id, i, j, freq_step, asf_sample_count, detection_count;
+	uint8_t sweep_error;
 	float freq_found;
 	uint8_t prn_buffer[30], float_buffer[10];
-	struct si446x_reply_GET_MODEM_STATUS_map *pmodemstat;
 
 	m1_u8g2_firstpage();
 	 // This call required for page drawing in mode 1
@@ -1436,97 +1476,87 @@ void sub_ghz_frequency_reader(void)
     		avg_noisefloor[i][j] = NOISE_FLOOR_RSSI_THRESHOLD;
     }
 
-    active_band_id = SUB_GHZ_BAND_300;
-    freq_step = CHANNEL_STEPS_MAX + 1;
     detection_count = 0;
     asf_sample_count = 0;
 
+    for (i=0; i<SUB_GHZ_BAND_EOL; i++)
+    {
+    	sweep_bands[i].band = i;
+    	sweep_bands[i].channels = (uint8_t)subghz_band_steps[i][1];
+    	if ( sweep_bands[i].channels ) // First and last channels included
+    		sweep_bands[i].channels++;
+    }
+
     menu_sub_ghz_init();
+    sweep_error = subghz_sweep_init(sweep_bands, SUB_GHZ_BAND_EOL);
 
     while (1 ) // Main loop of this task
 	{
 		;
 		; // Do other parts of this task here
 		;
-	    if ( freq_step <= subghz_band_steps[active_band_id][1] )
-	    {
-	    	SI446x_Start_Rx(freq_step); // Change channel
-	    } // if ( freq_step <= subghz_band_steps[active_band_id] )
-	    else
-	    {
-	    	sub_ghz_set_opmode(SUB_GHZ_OPMODE_RX, active_band_id, 0, 0); // Process time: ~27.57ms (with reset) - ~4.5ms (optimized)
-	    	if ( subghz_band_steps[active_band_id][1] > 1 ) // There're other channels to retry
-	    		freq_step = 0; // Let start with channel 1 in next round
-	    } // else
-		// Read INTs, clear pending ones
-		SI446x_Get_IntStatus(0, 0, 0);
-		rssi_max = -255;
-		for ( i=0; i<2; i++)
-		{
-			//vTaskDelay(3); // Give the radio chip some time to do its task
-			pmodemstat = SI446x_Get_ModemStatus(0x00); // Process time: ~99.7us
-			// RF_Input_Level_dBm = (RSSI_value / 2) – MODEM_RSSI_COMP – 70
-			// MODEM_RSSI_COMP = 0x40 = 64d is appropriate for most applications.
-			rssi = pmodemstat->CURR_RSSI/2 - MODEM_RSSI_COMP - 70;
-			if ( rssi > rssi_max )
-				rssi_max = rssi;
-			vTaskDelay(1);
-		} // for ( i=0; i<2; i++)
-
-		rssi_avg = 0;
-		for (i=0; i<3; i++)
-			rssi_avg += avg_noisefloor[active_band_id][i];
-		rssi_avg /= 3; // Get average noise floor of the current frequency
-		if ( rssi_max >= (rssi_avg + SIGNAL_TO_NOISE_RATIO) ) // SNR matches the condition?
+		if ( !sweep_error )
+			sweep_error = subghz_sweep_run(&subghz_sweep_frame); // Process time: RSSI latch time per channel + ~1ms per band change
+		if ( sweep_error ) // No RSSI measured, the frame would read 0dBm on every channel
 		{
-			m1_buzzer_notification();
-			freq_found = subghz_band_steps[active_band_id][0];
-			if ( freq_step <= CHANNEL_STEPS_MAX )
-				freq_found += freq_step*CHANNEL_STEP;
-			m1_float_to_string(float_buffer, freq_found, 3);
-
-			u8g2_SetDrawColor(&m1_u8g2, M1_DISP_DRAW_COLOR_BG);
-			u8g2_DrawBox(&m1_u8g2, 10, 14, 90, 17); // Clear old content
-			u8g2_SetDrawColor(&m1_u8g2, M1_DISP_DRAW_COLOR_TXT);
-			u8g2_SetFont(&m1_u8g2, M1_DISP_LARGE_FONT_2B);
-			u8g2_DrawStr(&m1_u8g2, 10, 30, float_buffer);
-			u8g2_SetDrawColor(&m1_u8g2, M1_DISP_DRAW_COLOR_BG);
-			u8g2_DrawBox(&m1_u8g2, 1, INFO_BOX_Y_POS_ROW_1 + detection_count*10 - 9, M1_LCD_DISPLAY_WIDTH, 10); // Clear old content
-			u8g2_SetDrawColor(&m1_u8g2, M1_DISP_DRAW_COLOR_TXT);
-			u8g2_SetFont(&m1_u8g2, M1_DISP_MAIN_MENU_FONT_N);
-			sprintf(prn_buffer, "%sMHz RSSI%ddBm", float_buffer, rssi);
-			u8g2_DrawStr(&m1_u8g2, 1, INFO_BOX_Y_POS_ROW_1 + detection_count*10, prn_buffer);
-			m1_u8g2_nextpage(); // Update display RAM
-
-			M1_LOG_N(M1_LOGDB_TAG, float_buffer);
-			M1_LOG_N(M1_LOGDB_TAG, " RSSI: %ddBm\r\n", rssi);
-			detection_count++;
-			if ( detection_count >= 3 )
-				detection_count = 0;
-		} // if ( rssi_max >= (rssi_avg + SIGNAL_TO_NOISE_RATIO) )
-		else
-		{
-			avg_noisefloor[active_band_id][asf_sample_count] = rssi_max;
-		}
+			m1_message_box(&m1_u8g2, "Radio error!", "", "", "BACK to exit");
+			sub_ghz_set_opmode(SUB_GHZ_OPMODE_ISOLATED, SUB_GHZ_BAND_300, 0, 0);
+			menu_sub_ghz_exit();
 
-		if ( ++freq_step > subghz_band_steps[active_band_id][1] ) // All channels have been completed?
+			xQueueReset(main_q_hdl); // Reset main q before return
+			break; // Exit and return to the calling task (subfunc_handler_task)
+		} // if ( sweep_error )
+		n = 0;
+		for (active_band_id=0; active_band_id<SUB_GHZ_BAND_EOL; active_band_id++)
 		{
-			freq_step = CHANNEL_STEPS_MAX + 1; // Reset
-			while (true)
+			for (freq_step=0; freq_step<sweep_bands[active_band_id].channels; freq_step++)
 			{
-				active_band_id++;
-				if ( active_band_id >= SUB_GHZ_BAND_EOL)
+				rssi = subghz_sweep_frame.rssi[n++];
+				if ( rssi==SUBGHZ_SWEEP_RSSI_INVALID )
+					continue;
+
+				rssi_avg = 0;
+				for (i=0; i<3; i++)
+					rssi_avg += avg_noisefloor[active_band_id][i];
+				rssi_avg /= 3; // Get average noise floor of the current frequency
+				if ( rssi >= (rssi_avg + SIGNAL_TO_NOISE_RATIO) ) // SNR matches the condition?
 				{
-					active_band_id = SUB_GHZ_BAND_300;
-					asf_sample_count++;
-					if ( asf_sample_count >= 3 )
-						asf_sample_count = 0;
-					vTaskDelay(20); // Return time to system to do its job
-				} // if ( active_band_id >= SUB_GHZ_BAND_EOL)
-				if ( subghz_band_steps[active_band_id][1] != 0 ) // Change to this band if it is not disabled
-					break;
-			} // while (true)
-		} // if ( ++freq_step > subghz_band_steps[active_band_id][1] )
+					m1_buzzer_notification();
+					freq_found = subghz_band_steps[active_band_id][0];
+					freq_found += freq_step*CHANNEL_STEP;
+					m1_float_to_string(float_buffer, freq_found, 3);
+
+					u8g2_SetDrawColor(&m1_u8g2, M1_DISP_DRAW_COLOR_BG);
+					u8g2_DrawBox(&m1_u8g2, 10, 14, 90, 17); // Clear old content
+					u8g2_SetDrawColor(&m1_u8g2, M1_DISP_DRAW_COLOR_TXT);
+					u8g2_SetFont(&m1_u8g2, M1_DISP_LARGE_FONT_2B);
+					u8g2_DrawStr(&m1_u8g2, 10, 30, float_buffer);
+					u8g2_SetDrawColor(&m1_u8g2, M1_DISP_DRAW_COLOR_BG);
+					u8g2_DrawBox(&m1_u8g2, 1, INFO_BOX_Y_POS_ROW_1 + detection_count*10 - 9, M1_LCD_DISPLAY_WIDTH, 10); // Clear old content
+					u8g2_SetDrawColor(&m1_u8g2, M1_DISP_DRAW_COLOR_TXT);
+					u8g2_SetFont(&m1_u8g2, M1_DISP_MAIN_MENU_FONT_N);
+					sprintf(prn_buffer, "%sMHz RSSI%ddBm", float_buffer, rssi);
+					u8g2_DrawStr(&m1_u8g2, 1, INFO_BOX_Y_POS_ROW_1 + detection_count*10, prn_buffer);
+					m1_u8g2_nextpage(); // Update display RAM
+
+					M1_LOG_N(M1_LOGDB_TAG, float_buffer);
+					M1_LOG_N(M1_LOGDB_TAG, " RSSI: %ddBm\r\n", rssi);
+					detection_count++;
+					if ( detection_count >= 3 )
+						detection_count = 0;
+				} // if ( rssi >= (rssi_avg + SIGNAL_TO_NOISE_RATIO) )
+				else
+				{
+					avg_noisefloor[active_band_id][asf_sample_count] = rssi;
+				}
+			} // for (freq_step=0; freq_step<sweep_bands[active_band_id].channels; freq_step++)
+		} // for (active_band_id=0; active_band_id<SUB_GHZ_BAND_EOL; active_band_id++)
+
+		asf_sample_count++;
+		if ( asf_sample_count >= 3 )
+			asf_sample_count = 0;
+		vTaskDelay(20); // Return time to system to do its job
+
 		// Wait for the notification from button_event_handler_task to subfunc_handler_task.
 		// This task is the sub-task of subfunc_handler_task.
 		// The notification is given in the form of an item in the main queue.
@@ -1796,6 +1826,7 @@ static void sub_ghz_rx_start(void)
 		//_Error_Handler(__FILE__, __LINE__);
 		Error_Handler();
 	}
+	subghz_rssi_worker_start(); // RSSI of the decoded packets
 } // static void sub_ghz_rx_start(void)
 
 
@@ -1809,6 +1840,7 @@ static void sub_ghz_rx_start(void)
 /*============================================================================*/
 static void sub_ghz_rx_pause(void)
 {
+	subghz_rssi_worker_stop();
 	if (HAL_TIM_IC_Stop_IT(&timerhdl_subghz_rx, SUBGHZ_RX_TIMER_RX_CHANNEL) != HAL_OK)
 	{
 		//_Error_Handler(__FILE__, __LINE__);
@@ -1828,6 +1860,7 @@ static void sub_ghz_rx_pause(void)
 /*============================================================================*/
 static void sub_ghz_rx_deinit(void)
 {
+	subghz_rssi_worker_stop();
 	if ( timerhdl_subghz_rx.State==HAL_TIM_STATE_READY ) // Make sure that the timer has been initialized!
 	{
 		HAL_TIM_IC_DeInit(&timerhdl_subghz_rx);
@@ -1859,7 +1892,8 @@ static void sub_ghz_rx_deinit(void)
 /*============================================================================*/
 static uint8_t sub_ghz_ring_buffers_init(void)
 {
-	subghz_front_buffer_size = SUBGHZ_RAW_DATA_SAMPLES_MAX;
+	// Halved on failure, so it stays a power of two
+	subghz_front_buffer_size = SUBGHZ_RAW_RING_SAMPLES_MAX;
 
 	while ( true )
 	{
@@ -1871,15 +1905,12 @@ static uint8_t sub_ghz_ring_buffers_init(void)
 
 	while ( subghz_front_buffer )
 	{
-		subghz_ring_read_buffer = malloc(SUBGHZ_RAW_DATA_SAMPLES_TO_RW*2); // Each sample has a 2-byte value
-		if ( !subghz_ring_read_buffer )
-			break;
-		subghz_sdcard_write_buffer = malloc(SUBGHZ_FORTMATTED_DATA_SAMPLES_TO_RW);
+		subghz_sdcard_write_buffer = malloc(SUBGHZ_ENCODED_DATA_BYTES_TO_RW);
 		if ( !subghz_sdcard_write_buffer )
 			break;
-		m1_ringbuffer_init(&subghz_rx_rawdata_rb, (uint8_t *)subghz_front_buffer, subghz_front_buffer_size, sizeof(uint16_t));
+		m1_spsc_rb_init(&subghz_rx_rawdata_rb, (uint8_t *)subghz_front_buffer, subghz_front_buffer_size, sizeof(uint16_t));
 
-		M1_LOG_I(M1_LOGDB_TAG, "sub_ghz_ring_buffers_init %d\r\n", subghz_front_buffer_size);
+		M1_LOG_I(M1_LOGDB_TAG, "sub_ghz_ring_buffers_init %lu\r\n", subghz_front_buffer_size);
 
 		return 0;
 	} // while ( subghz_front_buffer )
@@ -2044,12 +2075,6 @@ static void sub_ghz_ring_buffers_deinit(void)
 		subghz_front_buffer_size = 0;
 	} // if ( subghz_front_buffer )
 
-	if ( subghz_ring_read_buffer )
-	{
-		free(subghz_ring_read_buffer);
-		subghz_ring_read_buffer = NULL;
-	} // if ( subghz_ring_read_buffer )
-
 	if ( subghz_sdcard_write_buffer )
 	{
 		free(subghz_sdcard_write_buffer);
@@ -2174,7 +2199,7 @@ static uint8_t sub_ghz_raw_samples_init(void)
 		double_buffer_ptr[0] = subghz_front_buffer;
 		double_buffer_ptr[1] = subghz_back_buffer;
 
-		error = m1_fb_open_file(&datfile_info.dat_file_hdl, datfile_info.dat_filename);
+		error = m1_fb_open_file_fastseek(&datfile_info.dat_file_hdl, datfile_info.dat_filename, datfile_clmt, M1_FB_CLMT_SIZE);
 		if (error)
 			break;
 
@@ -2189,6 +2214,16 @@ static uint8_t sub_ghz_raw_samples_init(void)
 		}
 		sdcard_dat_buffer[sdcard_dat_read_size] = '\0'; // Add end of string to the buffer
 		sdcard_buffer_run_ptr = sdcard_dat_buffer;
+		sdcard_dat_buffer_end_pos = (uint32_t)sdcard_dat_buffer + sdcard_dat_read_size;
+
+		subghz_raw_file_binary = subghz_rawfile_is_binary(sdcard_dat_buffer, sdcard_dat_read_size);
+		if ( subghz_raw_file_binary )
+		{
+			error = subghz_rawfile_header_check(sdcard_dat_buffer, sdcard_dat_read_size, &subghz_raw_file_header);
+			if ( !error )
+				sdcard_buffer_run_ptr += subghz_raw_file_header.header_size; // Move to the sample stream
+			break;
+		} // if ( subghz_raw_file_binary )
 
 		psdcard_dat_buffer = malloc(sdcard_dat_read_size + 1);
 		if ( psdcard_dat_buffer==NULL )
@@ -2229,9 +2264,6 @@ static uint8_t sub_ghz_raw_samples_init(void)
 			error = 1;
 			break;
 		} // if ( i < SUB_GHZ_DATAFILE_KEY_FORMAT_N )
-
-		sdcard_dat_buffer_end_pos = (uint32_t)sdcard_dat_buffer + sdcard_dat_read_size;
-
 	} while(0); // while (0)
 
 	if ( psdcard_dat_buffer!=NULL )
@@ -2285,6 +2317,9 @@ static uint8_t sub_ghz_parse_raw_data(uint8_t buffer_ptr_id)
 	uint16_t rd_samples_count;
 	uint16_t sdcard_read_result, number;
 
+	if ( subghz_raw_file_binary )
+		return sub_ghz_parse_raw_bin_data(buffer_ptr_id);
+
 	rd_samples_count = 0;
 	raw_samples_count = 0;
 	error_code = 0;
@@ -2406,6 +2441,56 @@ static uint8_t sub_ghz_parse_raw_data(uint8_t buffer_ptr_id)
 
 
 
+/*============================================================================*/
+/**
+  * @brief  Decodes the sample stream of a binary data file to a raw samples buffer
+  * @param  buffer_ptr_id raw samples buffer to fill
+  * @retval SUB_GHZ_RAW_DATA_PARSER_xxx
+  */
+/*============================================================================*/
+static uint8_t sub_ghz_parse_raw_bin_data(uint8_t buffer_ptr_id)
+{
+	const uint8_t *psrc;
+	uint16_t sdcard_read_result, n_decoded;
+	uint32_t remainder;
+
+	raw_samples_count = 0;
+
+	while ( true )
+	{
+		psrc = sdcard_buffer_run_ptr;
+		if ( subghz_rawfile_decode(&psrc, (uint8_t *)sdcard_dat_buffer_end_pos,
+				&double_buffer_ptr[buffer_ptr_id][raw_samples_count], raw_samples_buffer_size - raw_samples_count, &n_decoded) )
+			return SUB_GHZ_RAW_DATA_PARSER_ERROR_L5; // Corrupt sample
+		raw_samples_count += n_decoded;
+		sdcard_buffer_run_ptr = (uint8_t *)psrc;
+		if ( raw_samples_count >= raw_samples_buffer_size )
+			return SUB_GHZ_RAW_DATA_PARSER_READY;
+
+		// Bytes of a sample split between this block and the next one, if any
+		remainder = sdcard_dat_buffer_end_pos - (uint32_t)sdcard_buffer_run_ptr;
+		sdcard_dat_file_size -= sdcard_dat_read_size; // Update the remainder
+		if ( sdcard_dat_file_size==0 ) // End of file?
+		{
+			if ( remainder )
+				return SUB_GHZ_RAW_DATA_PARSER_ERROR_L1; // Truncated sample
+			return SUB_GHZ_RAW_DATA_PARSER_COMPLETE;
+		} // if ( sdcard_dat_file_size==0 )
+
+		// Keep the read buffer aligned, see sub_ghz_parse_raw_data()
+		memcpy(sdcard_dat_buffer - remainder, sdcard_buffer_run_ptr, remainder);
+		if ( sdcard_dat_read_size > sdcard_dat_file_size ) // Last block to read from file?
+			sdcard_dat_read_size = sdcard_dat_file_size; // Adjust the read size
+		sdcard_read_result = m1_fb_read_from_file(&datfile_info.dat_file_hdl, sdcard_dat_buffer, sdcard_dat_read_size);
+		if ( sdcard_read_result!=sdcard_dat_read_size )
+			return SUB_GHZ_RAW_DATA_PARSER_ERROR_L2;
+		sdcard_buffer_run_ptr = sdcard_dat_buffer - remainder;
+		sdcard_dat_buffer_end_pos = (uint32_t)sdcard_dat_buffer + sdcard_dat_read_size;
+	} // while ( true )
+} // static uint8_t sub_ghz_parse_raw_bin_data(uint8_t buffer_ptr_id)
+
+
+
 /*============================================================================*/
 /**
   * @brief
@@ -2530,63 +2615,50 @@ static void sub_ghz_transmit_raw_restart(uint32_t source, uint32_t len)
 /*============================================================================*/
 static uint8_t sub_ghz_rx_raw_save(bool header_init, bool last_data)
 {
-	char *prn_buffer;
-	uint32_t freq32;
-	uint16_t count, n_samples_to_rw, *pdata;
-	char *sign_text[2] = {"+", ""};
+	uint32_t freq32, n_span;
+	uint16_t n_samples_to_rw, n_samples, *pdata, size, pad_sample;
 	uint8_t *pfillbuffer;
-	uint8_t sign;
 
-	prn_buffer = malloc(64);
-	assert(prn_buffer!=NULL);
 	pfillbuffer = subghz_sdcard_write_buffer;
 	if ( header_init )
 	{
-		sprintf(pfillbuffer, "%s M1 SubGHz %s\r\n", subghz_datfile_keywords[0], SUB_GHZ_DATAFILE_FILETYPE_KEYWORD);
-		sprintf(prn_buffer, "%s %d.%d\r\n", subghz_datfile_keywords[1], m1_device_stat.config.fw_version_major, m1_device_stat.config.fw_version_minor);
-		strcat(pfillbuffer, prn_buffer);
 		freq32 = subghz_band_steps[subghz_scan_config.band][0]*1000000; // Convert frequency from MHz to Hz
-		sprintf(prn_buffer, "%s %lu\r\n", subghz_datfile_keywords[2], freq32);
-		strcat(pfillbuffer, prn_buffer);
-		sprintf(prn_buffer, "%s %s\r\n", subghz_datfile_keywords[3], subghz_modulation_text[subghz_scan_config.modulation]);
-		strcat(pfillbuffer, prn_buffer);
-		m1_sdm_fill_buffer(pfillbuffer, strlen(pfillbuffer));
-		return 0;
+		subghz_rawfile_header_init((S_SubGHz_RawFile_Header_t *)pfillbuffer, freq32, subghz_scan_config.modulation,
+				m1_device_stat.config.fw_version_major, m1_device_stat.config.fw_version_minor);
+		return m1_sdm_fill_buffer(pfillbuffer, sizeof(S_SubGHz_RawFile_Header_t));
 	} // if ( header_init )
 
-	sprintf(pfillbuffer, "%s", SUB_GHZ_DATAFILE_DATA_KEYWORD);
-	//m1_test_gpio_pull_high();
-	//sub_ghz_rx_pause();
 	n_samples_to_rw = SUBGHZ_RAW_DATA_SAMPLES_TO_RW;
 	if ( last_data )
 	{
-		n_samples_to_rw = ringbuffer_get_data_slots(&subghz_rx_rawdata_rb);
+		n_samples_to_rw = m1_spsc_rb_get_data_slots(&subghz_rx_rawdata_rb);
 		if ( n_samples_to_rw > SUBGHZ_RAW_DATA_SAMPLES_TO_RW ) // This should never happen!
 			n_samples_to_rw = SUBGHZ_RAW_DATA_SAMPLES_TO_RW;
+		if ( subghz_rx_rawdata_rb.overruns )
+			M1_LOG_I(M1_LOGDB_TAG, "Samples dropped: %lu\r\n", subghz_rx_rawdata_rb.overruns);
 	} // if ( last_data )
-	m1_ringbuffer_read(&subghz_rx_rawdata_rb, subghz_ring_read_buffer, n_samples_to_rw);
-	//sub_ghz_rx_start();
-	//m1_test_gpio_pull_low();
-	pdata = (uint16_t *)subghz_ring_read_buffer;
-	if ( n_samples_to_rw & 0x01 ) // Odd number of samples?
-	{
-		pdata[n_samples_to_rw] = INTERPACKET_GAP_MIN; // Extra dummy data
-		n_samples_to_rw++; // Make even number
-	}
-	sign = 0;
-	for (count=0; count<n_samples_to_rw; count++)
+
+	// Samples are encoded straight from the ring buffer, see m1_sub_ghz_rawfile.h for the format
+	size = 0;
+	n_samples = 0;
+	while ( n_samples < n_samples_to_rw )
 	{
-		sprintf(prn_buffer, " %s%u", sign_text[sign], *pdata);
-		strcat(pfillbuffer, prn_buffer);
-		pdata++;
-		sign ^= 1;
+		pdata = m1_spsc_rb_acquire_read_span(&subghz_rx_rawdata_rb, &n_span);
+		if ( !n_span )
+			break;
+		if ( n_span > (n_samples_to_rw - n_samples) )
+			n_span = n_samples_to_rw - n_samples;
+		size += subghz_rawfile_encode(pdata, n_span, &pfillbuffer[size]);
+		m1_spsc_rb_commit_read(&subghz_rx_rawdata_rb, n_span);
+		n_samples += n_span;
+	} // while ( n_samples < n_samples_to_rw )
+	if ( n_samples & 0x01 ) // Odd number of samples?
+	{
+		pad_sample = INTERPACKET_GAP_MIN; // Extra dummy data to make an even number
+		size += subghz_rawfile_encode(&pad_sample, 1, &pfillbuffer[size]);
 	}
-	strcat(pfillbuffer, "\r\n");
-
-	m1_sdm_fill_buffer(pfillbuffer, strlen(pfillbuffer));
 
-	if ( prn_buffer!=NULL )
-		free(prn_buffer);
+	return m1_sdm_fill_buffer(pfillbuffer, size);
 } // static uint8_t sub_ghz_rx_raw_save(bool header_init, bool last_data)
 
 
@@ -2863,3 +2935,315 @@ void sub_ghz_display(SubGHz_Dec_Info_t decoded_data)
     subghz_decenc_ctl.subghz_reset_data();
 
 } // void sub_ghz_display(SubGHz_Dec_Info_t decoded_data)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Parses one header line of a text raw data file
+  * @param  line header line, null terminated
+  * @param  phdr file information
+  * @retval None
+  */
+/*============================================================================*/
+static void sub_ghz_raw_text_header_line(char *line, S_SubGHz_RawFile_Header_t *phdr)
+{
+	char *str;
+	uint8_t i;
+
+	str = strchr(line, ':');
+	if ( str==NULL )
+		return;
+	str++; // Move to the value
+
+	if ( strstr(line, subghz_datfile_keywords[1]) ) // Version
+	{
+		phdr->fw_version_major = strtol(str, &str, 10);
+		if ( *str=='.' )
+			phdr->fw_version_minor = strtol(str + 1, NULL, 10);
+	} // if ( strstr(line, subghz_datfile_keywords[1]) )
+	else if ( strstr(line, subghz_datfile_keywords[2]) ) // Frequency
+	{
+		phdr->frequency = strtoul(str, NULL, 10);
+	}
+	else if ( strstr(line, subghz_datfile_keywords[3]) ) // Modulation
+	{
+		m1_strtoupper(str);
+		for (i=0; i<SUBGHZ_MODULATION_LIST; i++)
+		{
+			if ( strstr(str, subghz_modulation_text[i]) )
+				break;
+		}
+		phdr->modulation = i;
+	} // else if ( strstr(line, subghz_datfile_keywords[3]) )
+} // static void sub_ghz_raw_text_header_line(char *line, S_SubGHz_RawFile_Header_t *phdr)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Reads a raw data file in text or binary format, and passes
+  *         its samples to the handler in blocks of up to SUBGHZ_RAW_DATA_SAMPLES_TO_RW.
+  *         The file information is complete before the handler is first called.
+  * @param  pfile opened raw data file
+  * @param  phdr file information
+  * @param  pbinary set to true if the file is in binary format
+  * @param  psample_handler called for every block of samples
+  * @retval error code
+  */
+/*============================================================================*/
+static uint8_t sub_ghz_raw_file_scan(FIL *pfile, S_SubGHz_RawFile_Header_t *phdr, bool *pbinary,
+		void (*psample_handler)(const uint16_t *psamples, uint16_t count))
+{
+	char *prd_buffer, line[SUB_GHZ_DATAFILE_LINE_MAX];
+	const uint8_t *psrc;
+	uint16_t *psamples;
+	uint16_t rd_size, remainder, n_samples, i;
+	uint8_t error, corrupt, line_len;
+	uint32_t number;
+	bool eof, data_line, digit;
+
+	prd_buffer = malloc(SUB_GHZ_RAW_FILE_BLOCK_SIZE + SUBGHZ_RAWFILE_SAMPLE_BYTES_MAX);
+	psamples = malloc(SUBGHZ_RAW_DATA_SAMPLES_TO_RW*sizeof(uint16_t));
+
+	error = 1;
+	do
+	{
+		if ( prd_buffer==NULL || psamples==NULL )
+			break;
+
+		rd_size = m1_fb_read_from_file(pfile, prd_buffer, SUB_GHZ_RAW_FILE_BLOCK_SIZE);
+		eof = (rd_size < SUB_GHZ_RAW_FILE_BLOCK_SIZE);
+		*pbinary = subghz_rawfile_is_binary((uint8_t *)prd_buffer, rd_size);
+		if ( *pbinary )
+		{
+			if ( subghz_rawfile_header_check((uint8_t *)prd_buffer, rd_size, phdr) )
+				break;
+			psrc = (uint8_t *)prd_buffer + phdr->header_size;
+			while ( true )
+			{
+				corrupt = subghz_rawfile_decode(&psrc, (uint8_t *)prd_buffer + rd_size, psamples, SUBGHZ_RAW_DATA_SAMPLES_TO_RW, &n_samples);
+				if ( corrupt )
+					break;
+				if ( n_samples )
+				{
+					psample_handler(psamples, n_samples);
+					continue;
+				}
+				// Bytes of a sample split between this block and the next one, if any
+				remainder = (uint8_t *)prd_buffer + rd_size - psrc;
+				if ( eof )
+					break;
+				memmove(prd_buffer, psrc, remainder);
+				rd_size = m1_fb_read_from_file(pfile, prd_buffer + remainder, SUB_GHZ_RAW_FILE_BLOCK_SIZE);
+				eof = (rd_size < SUB_GHZ_RAW_FILE_BLOCK_SIZE);
+				rd_size += remainder;
+				psrc = (uint8_t *)prd_buffer;
+			} // while ( true )
+			if ( !corrupt && !remainder ) // No corrupt or truncated sample?
+				error = 0;
+			break;
+		} // if ( *pbinary )
+
+		subghz_rawfile_header_init(phdr, 0, MODULATION_UNKNOWN, 0, 0);
+		n_samples = 0;
+		number = 0;
+		line_len = 0;
+		data_line = false;
+		digit = false;
+		while ( true )
+		{
+			for (i=0; i<rd_size; i++)
+			{
+				if ( prd_buffer[i]=='\r' || prd_buffer[i]=='\n' )
+				{
+					if ( line_len && !data_line ) // End of a header line?
+					{
+						line[line_len] = '\0';
+						sub_ghz_raw_text_header_line(line, phdr);
+					}
+					line_len = 0; // New line
+					data_line = false;
+				} // if ( prd_buffer[i]=='\r' || prd_buffer[i]=='\n' )
+				else if ( !data_line ) // Only the "Data:" lines carry samples
+				{
+					if ( line_len < (SUB_GHZ_DATAFILE_LINE_MAX - 1) )
+						line[line_len++] = prd_buffer[i];
+					if ( line_len==strlen(SUB_GHZ_DATAFILE_DATA_KEYWORD) && !strncmp(line, SUB_GHZ_DATAFILE_DATA_KEYWORD, line_len) )
+						data_line = true;
+					continue;
+				} // else if ( !data_line )
+				else if ( prd_buffer[i] >= '0' && prd_buffer[i] <= '9' )
+				{
+					number = number*10 + (prd_buffer[i] - '0');
+					digit = true;
+					continue;
+				}
+				// Any other character, including the +/- sign, ends the current number
+				if ( digit )
+				{
+					psamples[n_samples++] = (number > UINT16_MAX)?UINT16_MAX:number;
+					if ( n_samples >= SUBGHZ_RAW_DATA_SAMPLES_TO_RW )
+					{
+						psample_handler(psamples, n_samples);
+						n_samples = 0;
+					}
+					number = 0;
+					digit = false;
+				} // if ( digit )
+			} // for (i=0; i<rd_size; i++)
+
+			if ( eof )
+				break;
+			rd_size = m1_fb_read_from_file(pfile, prd_buffer, SUB_GHZ_RAW_FILE_BLOCK_SIZE);
+			eof = (rd_size < SUB_GHZ_RAW_FILE_BLOCK_SIZE);
+		} // while ( true )
+
+		if ( digit ) // Last number without trailing separator
+			psamples[n_samples++] = (number > UINT16_MAX)?UINT16_MAX:number;
+		if ( n_samples )
+			psample_handler(psamples, n_samples);
+		error = 0;
+	} while (0);
+
+	if ( prd_buffer )
+		free(prd_buffer);
+	if ( psamples )
+		free(psamples);
+
+	return error;
+} // static uint8_t sub_ghz_raw_file_scan(FIL *pfile, S_SubGHz_RawFile_Header_t *phdr, bool *pbinary, ...)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Writes the header of the converted file once, before the first samples
+  * @param  None
+  * @retval None
+  */
+/*============================================================================*/
+static void sub_ghz_raw_convert_header(void)
+{
+	char *pbuffer;
+	uint16_t size;
+
+	if ( pconvert->header_written || pconvert->error )
+		return;
+	pconvert->header_written = true;
+
+	if ( !pconvert->header.frequency || pconvert->header.modulation >= SUBGHZ_MODULATION_LIST )
+	{
+		pconvert->error = 1; // Incomplete file information
+		return;
+	}
+
+	pbuffer = (char *)pconvert->pbuffer;
+	if ( !pconvert->src_binary )
+	{
+		subghz_rawfile_header_init((S_SubGHz_RawFile_Header_t *)pbuffer, pconvert->header.frequency, pconvert->header.modulation,
+				pconvert->header.fw_version_major, pconvert->header.fw_version_minor);
+		size = sizeof(S_SubGHz_RawFile_Header_t);
+	} // if ( !pconvert->src_binary )
+	else
+	{
+		size = sprintf(pbuffer, "%s M1 SubGHz %s\r\n%s %d.%d\r\n%s %lu\r\n%s %s\r\n",
+				subghz_datfile_keywords[0], SUB_GHZ_DATAFILE_FILETYPE_KEYWORD,
+				subghz_datfile_keywords[1], pconvert->header.fw_version_major, pconvert->header.fw_version_minor,
+				subghz_datfile_keywords[2], pconvert->header.frequency,
+				subghz_datfile_keywords[3], subghz_modulation_text[pconvert->header.modulation]);
+	} // else
+	if ( m1_fb_write_to_file(&pconvert->dst_file, pbuffer, size)!=size )
+		pconvert->error = 1;
+} // static void sub_ghz_raw_convert_header(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Writes a block of samples to the converted file
+  * @param  psamples pulse durations
+  * @param  count number of samples
+  * @retval None
+  */
+/*============================================================================*/
+static void sub_ghz_raw_convert_samples(const uint16_t *psamples, uint16_t count)
+{
+	char *pbuffer;
+	uint16_t size;
+
+	sub_ghz_raw_convert_header();
+	if ( pconvert->error )
+		return;
+
+	pbuffer = (char *)pconvert->pbuffer;
+	if ( !pconvert->src_binary )
+	{
+		size = subghz_rawfile_encode(psamples, count, pconvert->pbuffer);
+	}
+	else
+	{
+		size = sprintf(pbuffer, "%s", SUB_GHZ_DATAFILE_DATA_KEYWORD);
+		while ( count-- )
+		{
+			size += sprintf(&pbuffer[size], " %s%u", (pconvert->sign)?"":"+", *psamples++);
+			pconvert->sign ^= 1;
+		}
+		size += sprintf(&pbuffer[size], "\r\n");
+	} // else
+	if ( m1_fb_write_to_file(&pconvert->dst_file, pbuffer, size)!=size )
+		pconvert->error = 1;
+} // static void sub_ghz_raw_convert_samples(const uint16_t *psamples, uint16_t count)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Converts a raw data file from text to binary format, or vice versa.
+  *         The samples and the file information are kept unchanged.
+  * @param  src_filename full path of the source file
+  * @param  dst_filename full path of the converted file, overwritten if it exists
+  * @retval error code
+  */
+/*============================================================================*/
+uint8_t sub_ghz_raw_file_convert(const char *src_filename, const char *dst_filename)
+{
+	FIL src_file;
+	uint8_t error;
+
+	if ( m1_fb_open_file(&src_file, src_filename) )
+		return 1;
+
+	error = 1;
+	do
+	{
+		pconvert = calloc(1, sizeof(S_M1_SubGHz_Raw_Convert_t));
+		if ( pconvert==NULL )
+			break;
+		pconvert->pbuffer = malloc(SUBGHZ_FORMATTED_DATA_BYTES_TO_RW);
+		if ( pconvert->pbuffer==NULL )
+			break;
+		if ( m1_fb_open_new_file(&pconvert->dst_file, dst_filename) )
+			break;
+
+		// The file information and the source format are known before any sample is passed to the converter
+		error = sub_ghz_raw_file_scan(&src_file, &pconvert->header, &pconvert->src_binary, sub_ghz_raw_convert_samples);
+		sub_ghz_raw_convert_header(); // In case there's no sample
+		m1_fb_close_file(&pconvert->dst_file);
+		if ( !error )
+			error = pconvert->error;
+		if ( error )
+			m1_fb_delete_file(dst_filename);
+	} while (0);
+
+	m1_fb_close_file(&src_file);
+	if ( pconvert )
+	{
+		if ( pconvert->pbuffer )
+			free(pconvert->pbuffer);
+		free(pconvert);
+		pconvert = NULL;
+	} // if ( pconvert )
+
+	return error;
+} // uint8_t sub_ghz_raw_file_convert(const char *src_filename, const char *dst_filename)
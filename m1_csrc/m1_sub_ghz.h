@@ -45,7 +45,8 @@
 #define SUBGHZ_TX_CARRIER_PRESCALE_FACTOR		10
 
 #define SUBGHZ_RAW_DATA_SAMPLES_TO_RW			512
-#define SUBGHZ_FORTMATTED_DATA_SAMPLES_TO_RW    3840//5120//2560//3072//3840
+#define SUBGHZ_ENCODED_DATA_BYTES_TO_RW			(SUBGHZ_RAW_DATA_SAMPLES_TO_RW*3) // Up to 3 bytes per encoded sample
+#define SUBGHZ_FORMATTED_DATA_BYTES_TO_RW		(SUBGHZ_RAW_DATA_SAMPLES_TO_RW*8 + 16) // Text form: " +65535" per sample and the line keyword
 
 #define SUBGHZ_MODULATION_LIST					3
 
@@ -139,12 +140,13 @@ void sub_ghz_replay(void);
 void sub_ghz_frequency_reader(void);
 void sub_ghz_regional_information(void);
 void sub_ghz_radio_settings(void);
+uint8_t sub_ghz_raw_file_convert(const char *src_filename, const char *dst_filename);
 
 extern EXTI_HandleTypeDef 	si4463_exti_hdl;
 extern TIM_HandleTypeDef   	timerhdl_subghz_tx;
 extern TIM_HandleTypeDef   	timerhdl_subghz_rx;
 extern DMA_HandleTypeDef	hdma_subghz_tx;
 extern uint8_t subghz_tx_tc_flag;
-extern S_M1_RingBuffer subghz_rx_rawdata_rb;
+extern S_M1_SpscRingBuffer subghz_rx_rawdata_rb;
 extern uint8_t subghz_record_mode_flag;
 #endif /* M1_SUB_GHZ_H_ */
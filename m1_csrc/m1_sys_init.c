@@ -22,6 +22,7 @@
 #include "m1_log_debug.h"
 #include "m1_i2c.h"
 #include "m1_rf_spi.h"
+#include "m1_sub_ghz_api.h"
 #include "m1_sdcard.h"
 #include "m1_esp32_hal.h"
 #include "battery.h"
@@ -169,6 +170,7 @@ void m1_system_init_task(void *param)
 			//  MX_X_CUBE_NFC6_Init();
 			m1_i2c_hal_init(&hi2c1);
 			m1_spi_hal_init(&hspi2);
+			SI446x_Lock_Init();
 
 			battery_service_init();
 			lp5814_init();
@@ -39,11 +39,13 @@
 #define TASK_PRIORITY_WDT_HANDLER				(tskIDLE_PRIORITY + 1)
 #define TASK_PRIORITY_RUNONCE_TASK_HANDLER		(tskIDLE_PRIORITY + 1)
 #define TASK_PRIORITY_IDLE_HANDLER				(tskIDLE_PRIORITY + 1)
+#define TASK_PRIORITY_SUBGHZ_RSSI_WORKER		(tskIDLE_PRIORITY + 2)
 #define TASK_PRIORITY_LOG_DB_HANDLER			(tskIDLE_PRIORITY + 3)
 #define TASK_PRIORITY_CLI_HANDLER				(tskIDLE_PRIORITY + 5)
 #define TASK_PRIORITY_MENU_MAIN_HANDLER			(tskIDLE_PRIORITY + 8)
 #define TASK_PRIORITY_SDCARD_HANDLER			(tskIDLE_PRIORITY + 10)
 #define TASK_PRIORITY_SDCARD_MANAGER            (tskIDLE_PRIORITY + 10)
+#define TASK_PRIORITY_USB_MSC_HANDLER			(tskIDLE_PRIORITY + 10)
 #define TASK_PRIORITY_ESP32_TASKS				(tskIDLE_PRIORITY + 10)
 #define TASK_PRIORITY_SYSTEM_TASK_HANDLER		(tskNORMAL_PRIORITY + 0) // Must be at this priority for the Sub-GHz samples recording to work properly!
 #define TASK_PRIORITY_SUBFUNC_HANDLER			(tskNORMAL_PRIORITY + 0)
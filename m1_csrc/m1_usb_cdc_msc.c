@@ -21,9 +21,12 @@
 #include "m1_cli.h"
 #include "m1_compile_cfg.h"
 #include "m1_sdcard.h"
+#include "m1_log_debug.h"
 
 /*************************** D E F I N E S ************************************/
 
+#define M1_LOGDB_TAG	"USB"
+
 #define CHUNK_SIZE		512
 
 
@@ -207,6 +210,26 @@ uint8_t m1_usb_msc_process(void)
 }
 
 
+
+/******************************************************************************/
+/*
+ * Write the blocks cached by the USB MSC storage and empty its cache.
+ * Called before the firmware mounts the SD card.
+ *
+ */
+/******************************************************************************/
+void m1_usb_msc_sync(void)
+{
+#if (M1_USB_MODE == M1_CFG_USB_CDC_MSC) || (M1_USB_MODE == M1_CFG_USB_MSC)
+  // The next command of the host fails if blocks are dropped
+  if (STORAGE_Sync() != 0)
+  {
+    M1_LOG_E(M1_LOGDB_TAG, "USB MSC cached blocks not written\r\n");
+  }
+#endif
+}
+
+
 /******************************************************************************/
 /*
  * Return TRUE if an SD card is detected (causing the Detect Switch to pull low)
@@ -738,6 +761,11 @@ void MX_USB_PCD_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN USB_Init 2 */
+#if (M1_USB_MODE == M1_CFG_USB_CDC_MSC) || (M1_USB_MODE == M1_CFG_USB_MSC)
+  /* Runs the MSC data stages once the device is started */
+  STORAGE_TaskInit();
+#endif
+
   if(USBD_Init(&hUsbDeviceFS, &Class_Desc, 0) != USBD_OK)
         Error_Handler();
 
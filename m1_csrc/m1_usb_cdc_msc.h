@@ -90,6 +90,7 @@ extern volatile int8_t m1_USB_MSC_ready;
 
 uint8_t m1_usb_msc_process(void);
 uint8_t m1_usb_msc_sd_detected(void);
+void m1_usb_msc_sync(void);
 
 #endif /* M1_USB_CDC_MSC_H_ */
 
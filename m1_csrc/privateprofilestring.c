@@ -70,13 +70,17 @@ char* ltrim(char *str);
 char* rtrim(char *str);
 char* trim(char *str);
 
-static int read_line(FIL *fp, char *buf, int size);
 
 static int stricmp_nocase(const char *a, const char *b);
 static int parse_hex_array_space(const char *str, uint8_t *out, int max_len);
 static bool parse_bool_text(const char *str, bool *out);
 static int parse_hex_count(const char *str);
 static bool parse_value(const char *text, ParsedValue *val);
+static int profile_read_chunk(ProfileSession *ps);
+static int profile_next_line(ProfileSession *ps);
+static int profile_find_line(ProfileSession *ps, const char *entry);
+static int profile_find_set(const ProfileSession *ps, const char *entry);
+static FRESULT profile_write_text(FIL *fp, char *buf, UINT *pos, const char *text, UINT len);
 
 /*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
 
@@ -190,64 +194,22 @@ bool IsValidFileSpec(const S_M1_file_info *f, const char* ext)
 /*============================================================================*/
 bool isValidHeaderField(ParsedValue *data, const char* filetype, const char* version, const char *file_path)
 {
+	ProfileSession ps;
+	bool ret;
+
 	if(data == NULL || filetype == NULL || version == NULL || file_path == NULL){
 		return false;
 	}
 
-	GetPrivateProfileString(data,"Filetype", file_path);
-	if(strcmp(data->buf, filetype))
-		return false;
-
-	GetPrivateProfileString(data,"Version", file_path);
-	//if(data->v.f != 0.8)
-	if(strcmp(data->buf, version))
+	if(!profile_open(&ps, file_path))
 		return false;
+	ret = profile_is_valid_header(&ps, data, filetype, version);
+	profile_close(&ps);
 
-	return true;
+	return ret;
 }
 
 
-/*============================================================================*/
- /**
-  * @brief Reads a single line from a file using FatFS f_gets (handles CR/LF/CRLF).
-  *
-  * This function reads one line of text from the specified FatFS file object.
-  * It supports line termination by '\n', '\r', or a combination of both ("\r\n").
-  * The resulting line is stored in the provided buffer without trailing
-  * newline characters.
-  *
-  * @param fp    Pointer to the FatFS file object.
-  * @param buf   Buffer to store the resulting line (null-terminated string).
-  * @param size  Size of the buffer in bytes.
-  *
-  * @return
-  * - 1 if a line was successfully read
-  * - 0 if end-of-file was reached or no more lines are available
-  */
-/*============================================================================*/
- int read_line(FIL *fp, char *buf, int size)
- {
-     char *p;
-
-     if (size <= 0) return 0;
-
-     p = f_gets(buf, size, fp);
-
-     if (p == NULL) {
-         return 0; // EOF or error
-     }
-
-     int len = strlen(buf);
-
-     if (len > 0)
-     {
-         if (buf[len-1] == '\n') buf[--len] = '\0';
-         if (len > 0 && buf[len-1] == '\r') buf[--len] = '\0';
-     }
-
-     return 1;
- }
-
 #define TOKEN_COLON ':'
 
  /*============================================================================*/
@@ -454,99 +416,585 @@ bool isValidHeaderField(ParsedValue *data, const char* filetype, const char* ver
  }
 
 
- /************************************************************************
- * Function:     get_private_profile()
- * Arguments:    <char *> section - the name of the section to search for
- *               <char *> entry - the name of the entry to find the value of
- *               <int> def - the default value in the event of a failed read
- *               <char *> file_name - the name of the .ini file to read from
- * Returns:      the value located at entry
- *************************************************************************/
- int get_private_profile(ParsedValue *val, const char *entry, const char *file_name)
+ /*============================================================================*/
+ /**
+   * @brief  Reads the next chunk of the file into the session data
+   * @param  ps  profile session
+   * @retval 1 if data was added, 0 at end of file or on error
+   */
+ /*============================================================================*/
+ static int profile_read_chunk(ProfileSession *ps)
  {
-	FIL fp;
-    //char buff[MAX_LINE_LENGTH];
-	char *line_buff;
-    char *ep;
-    //char value[6];
-    int len = strlen(entry);
-    //int i;
+     char *data;
+     UINT br;
+
+     if (ps->reload) {
+         ps->reload = false;
+         if (f_open(&ps->fp, ps->file_name, FA_READ) != FR_OK) {
+             ps->error = true;
+             return 0;
+         }
+         ps->fp_open = true;
+     }
+     if (!ps->fp_open)
+         return 0;
 
-    if( f_open(&fp, file_name,FA_READ) != FR_OK )
-		return(0);
-#if 1
-    line_buff = malloc(g_linebuf_size);
-    if(line_buff == NULL)
-    	return 0;
-#endif
-    /* Now that the section has been found, find the entry. */
-    do
-    {
-    	if( !read_line(&fp,line_buff,g_linebuf_size))
-        {
-#if 1
-    		safe_free((void*)&line_buff);
-#endif
-      		f_close(&fp);
-            return (0);
-        }
+     if (ps->data_size - ps->data_len < g_linebuf_size) {
+         data = realloc(ps->data, ps->data_size + g_linebuf_size);
+         if (data == NULL) {
+             ps->error = true;
+             return 0;
+         }
+         ps->data = data;
+         ps->data_size += g_linebuf_size;
+     }
+
+     if (f_read(&ps->fp, ps->data + ps->data_len, g_linebuf_size, &br) != FR_OK) {
+         ps->error = true;
+         br = 0;
+     }
+     ps->data_len += br;
+
+     if (br < g_linebuf_size) { // End of file
+         f_close(&ps->fp);
+         ps->fp_open = false;
+     }
+
+     return (br > 0);
+ }
+
+
+ /*============================================================================*/
+ /**
+   * @brief  Splits the next line of the file and finds its entry, if any.
+   *         Key and value are trimmed like in get_private_profile().
+   * @param  ps  profile session
+   * @retval index of the line, -1 at end of file
+   */
+ /*============================================================================*/
+ static int profile_next_line(ProfileSession *ps)
+ {
+     ProfileLine *line;
+     const char *text, *nl, *colon;
+     uint32_t end;
+     int i, k;
+
+     while (1) {
+         nl = memchr(ps->data + ps->parsed, '\n', ps->data_len - ps->parsed);
+         if (nl != NULL || !profile_read_chunk(ps))
+             break;
+     }
+     if (nl == NULL && ps->parsed >= ps->data_len)
+         return -1;
+
+     if (ps->lines == ps->max_lines) {
+         line = realloc(ps->line, (ps->max_lines + 32) * sizeof(ProfileLine));
+         if (line == NULL) {
+             ps->error = true;
+             return -1;
+         }
+         ps->line = line;
+         ps->max_lines += 32;
+     }
+
+     end = (nl != NULL) ? (uint32_t)(nl - ps->data) : ps->data_len;
+     line = &ps->line[ps->lines];
+     memset(line, 0, sizeof(ProfileLine));
+     line->set = -1;
+     line->text = ps->parsed;
+     text = ps->data + line->text;
+     line->text_len = end - ps->parsed;
+     if (line->text_len && text[line->text_len - 1] == '\r')
+         line->text_len--;
+     ps->parsed = (nl != NULL) ? end + 1 : end;
+
+     colon = (line->text_len && text[0] != '#') ? memchr(text, TOKEN_COLON, line->text_len) : NULL;
+     if (colon != NULL) {
+         // Key before the first colon
+         i = 0;
+         k = colon - text;
+         while (i < k && isspace((unsigned char)text[i])) i++;
+         while (k > i && isspace((unsigned char)text[k - 1])) k--;
+         line->key_ofs = i;
+         line->key_len = k - i;
+         // Value after the last colon
+         i = line->text_len;
+         while (text[i - 1] != TOKEN_COLON) i--;
+         k = line->text_len;
+         while (i < k && isspace((unsigned char)text[i])) i++;
+         while (k > i && isspace((unsigned char)text[k - 1])) k--;
+         line->value_ofs = i;
+         line->value_len = k - i;
+     }
+
+     return ps->lines++;
+ }
 
-        if (line_buff[0] == '#') {
-          	continue;
-        }
 
+ /*============================================================================*/
+ /**
+   * @brief  Finds the line of an entry, reading the file further if needed
+   * @param  ps     profile session
+   * @param  entry  key
+   * @retval index of the line, -1 if not found
+   */
+ /*============================================================================*/
+ static int profile_find_line(ProfileSession *ps, const char *entry)
+ {
+     const ProfileLine *line;
+     int i, len;
+
+     len = strlen(entry);
+     for (i = 0; i < ps->lines; i++) {
+         line = &ps->line[i];
+         if (line->key_len == len && !memcmp(ps->data + line->text + line->key_ofs, entry, len))
+             return i;
+     }
 
-        char *colon_pos = strchr(line_buff, TOKEN_COLON);
+     while ((i = profile_next_line(ps)) >= 0) {
+         line = &ps->line[i];
+         if (line->key_len == len && !memcmp(ps->data + line->text + line->key_ofs, entry, len))
+             return i;
+     }
 
-        if (colon_pos != NULL) {
+     return -1;
+ }
 
-        	*colon_pos = '\0';
 
-            char *current_key = trim(line_buff);
+ /*============================================================================*/
+ /**
+   * @brief  Finds the set of an entry made in this session
+   * @param  ps     profile session
+   * @param  entry  key
+   * @retval index of the set, -1 if not found
+   */
+ /*============================================================================*/
+ static int profile_find_set(const ProfileSession *ps, const char *entry)
+ {
+     int i;
 
-            if (strlen(current_key) == len && !strcmp(current_key, entry)) {
+     for (i = 0; i < ps->sets; i++) {
+         if (!strcmp(ps->set[i].key, entry))
+             return i;
+     }
 
-            	*colon_pos = TOKEN_COLON;
-                break;
-            }
+     return -1;
+ }
 
-            *colon_pos = TOKEN_COLON;
-        }
-    }while( 1 );
 
-    ep = strrchr(line_buff,TOKEN_COLON);
+ /*============================================================================*/
+ /**
+   * @brief  Starts a profile session. Nothing is read from the file yet.
+   *         A file which does not exist is created at commit.
+   * @param  ps         profile session
+   * @param  file_name  profile file
+   * @retval 1 if successful, otherwise 0
+   */
+ /*============================================================================*/
+ int profile_open(ProfileSession *ps, const char *file_name)
+ {
+     FRESULT fres;
 
-    if (ep == NULL) {
-#if 1
-    	safe_free((void*)&line_buff);
-#endif
-    	f_close(&fp);
-    	return 0;
-    }
+     memset(ps, 0, sizeof(ProfileSession));
+     ps->file_name = malloc(strlen(file_name) + 1);
+     if (ps->file_name == NULL)
+         return 0;
+     strcpy(ps->file_name, file_name);
+
+     fres = f_open(&ps->fp, file_name, FA_READ);
+     // A commit cut short may have left only the backup of the file
+     if (fres == FR_NO_FILE && m1_fb_recover_file(file_name) == FR_OK)
+         fres = f_open(&ps->fp, file_name, FA_READ);
+     if (fres == FR_OK) {
+         ps->fp_open = true;
+     }
+     else if (fres != FR_NO_FILE) {
+         profile_close(ps);
+         return 0;
+     }
 
-    ep++;
-    if( !strlen(ep) )
-    {
-#if 1
-    	safe_free((void*)&line_buff);
-#endif
-      	f_close(&fp);
-        return(0);
-    }
-    /* Copy only numbers fail on characters */
+     return 1;
+ }
 
-	char *psz = trim((char*)ep);
-	strcpy(line_buff,psz);
-	//safe_debugprintf("search value =%s\r\n", buff);
 
-	parse_value(line_buff, val);
+ /*============================================================================*/
+ /**
+   * @brief  Ends a profile session. Sets not committed are dropped.
+   * @param  ps  profile session
+   * @retval None
+   */
+ /*============================================================================*/
+ void profile_close(ProfileSession *ps)
+ {
+     int i;
 
-#if 1
-    safe_free((void*)&line_buff);
-#endif
-    f_close(&fp);                /* Clean up and return the value */
+     if (ps->fp_open)
+         f_close(&ps->fp);
+     for (i = 0; i < ps->sets; i++) {
+         free(ps->set[i].key);
+         free(ps->set[i].value);
+     }
+     free(ps->set);
+     free(ps->line);
+     free(ps->data);
+     free(ps->file_name);
+     memset(ps, 0, sizeof(ProfileSession));
+ }
+
+
+ /*============================================================================*/
+ /**
+   * @brief  Reads an entry and parses its value
+   * @param  ps     profile session
+   * @param  val    value type in, parsed value out
+   * @param  entry  key
+   * @retval 1 if found, otherwise 0
+   */
+ /*============================================================================*/
+ int profile_get(ProfileSession *ps, ParsedValue *val, const char *entry)
+ {
+     const ProfileLine *line;
+     char *value;
+     int i;
+
+     // Sets of this session are read back before the file is written
+     i = profile_find_set(ps, entry);
+     if (i >= 0) {
+         value = malloc(strlen(ps->set[i].value) + 1);
+         if (value == NULL)
+             return 0;
+         strcpy(value, ps->set[i].value);
+     }
+     else {
+         i = profile_find_line(ps, entry);
+         if (i < 0)
+             return 0;
+         line = &ps->line[i];
+         if (!line->value_len)
+             return 0;
+         value = malloc(line->value_len + 1);
+         if (value == NULL)
+             return 0;
+         memcpy(value, ps->data + line->text + line->value_ofs, line->value_len);
+         value[line->value_len] = '\0';
+     }
 
-	return 1;
+     parse_value(value, val);
+     free(value);
+
+     return 1;
+ }
+
+
+ /*============================================================================*/
+ /**
+   * @brief  Typed reads of an entry, see get_private_profile_*()
+   * @param  ps     profile session
+   * @param  val    parsed value
+   * @param  entry  key
+   * @retval 1 if found, otherwise 0
+   */
+ /*============================================================================*/
+ int profile_get_hex_count(ProfileSession *ps, ParsedValue *val, const char *entry)
+ {
+     val->type = VALUE_TYPE_COUNT;
+     return profile_get(ps, val, entry);
+ }
+
+ int profile_get_hex(ProfileSession *ps, ParsedValue *val, const char *entry)
+ {
+     val->type = VALUE_TYPE_HEX_ARRAY;
+     return profile_get(ps, val, entry);
+ }
+
+ int profile_get_uint(ProfileSession *ps, ParsedValue *val, const char *entry)
+ {
+     val->type = VALUE_TYPE_UINT32;
+     return profile_get(ps, val, entry);
+ }
+
+ int profile_get_int(ProfileSession *ps, ParsedValue *val, const char *entry)
+ {
+     val->type = VALUE_TYPE_INT;
+     return profile_get(ps, val, entry);
+ }
+
+ int profile_get_string(ProfileSession *ps, ParsedValue *val, const char *entry)
+ {
+     val->type = VALUE_TYPE_STRING;
+     return profile_get(ps, val, entry);
+ }
+
+ int profile_get_bool(ProfileSession *ps, ParsedValue *val, const char *entry)
+ {
+     val->type = VALUE_TYPE_BOOL;
+     return profile_get(ps, val, entry);
+ }
+
+ int profile_get_float(ProfileSession *ps, ParsedValue *val, const char *entry)
+ {
+     val->type = VALUE_TYPE_FLOAT;
+     return profile_get(ps, val, entry);
+ }
+
+
+ /*============================================================================*/
+ /**
+   * @brief  Checks the Filetype and Version entries of a profile
+   * @param  ps        profile session
+   * @param  data      string buffer for the values
+   * @param  filetype  expected file type
+   * @param  version   expected version
+   * @retval true if both match
+   */
+ /*============================================================================*/
+ bool profile_is_valid_header(ProfileSession *ps, ParsedValue *data, const char* filetype, const char* version)
+ {
+     if (ps == NULL || data == NULL || filetype == NULL || version == NULL)
+         return false;
+
+     if (!profile_get_string(ps, data, "Filetype") || strcmp(data->buf, filetype))
+         return false;
+
+     if (!profile_get_string(ps, data, "Version") || strcmp(data->buf, version))
+         return false;
+
+     return true;
+ }
+
+
+ /*============================================================================*/
+ /**
+   * @brief  Sets an entry. The file is written at commit.
+   * @param  ps     profile session
+   * @param  entry  key
+   * @param  value  new value
+   * @retval 1 if successful, otherwise 0
+   */
+ /*============================================================================*/
+ int profile_set(ProfileSession *ps, const char *entry, const char *value)
+ {
+     ProfileSet *set;
+     char *copy;
+     int i;
+
+     copy = malloc(strlen(value) + 1);
+     if (copy == NULL)
+         return 0;
+     strcpy(copy, value);
+
+     i = profile_find_set(ps, entry);
+     if (i >= 0) {
+         free(ps->set[i].value);
+         ps->set[i].value = copy;
+         return 1;
+     }
+
+     if (ps->sets == ps->max_sets) {
+         set = realloc(ps->set, (ps->max_sets + 8) * sizeof(ProfileSet));
+         if (set == NULL) {
+             free(copy);
+             return 0;
+         }
+         ps->set = set;
+         ps->max_sets += 8;
+     }
+
+     set = &ps->set[ps->sets];
+     set->key = malloc(strlen(entry) + 1);
+     if (set->key == NULL) {
+         free(copy);
+         return 0;
+     }
+     strcpy(set->key, entry);
+     set->value = copy;
+     set->line = profile_find_line(ps, entry);
+     if (set->line >= 0)
+         ps->line[set->line].set = ps->sets;
+     ps->sets++;
+
+     return 1;
+ }
+
+
+ /*============================================================================*/
+ /**
+   * @brief  Adds text to the commit buffer, writing the buffer when full
+   * @param  fp    temporary file
+   * @param  buf   commit buffer of PROFILE_WRITE_CHUNK bytes
+   * @param  pos   bytes in the buffer
+   * @param  text  text to add
+   * @param  len   length of the text
+   * @retval FRESULT
+   */
+ /*============================================================================*/
+ static FRESULT profile_write_text(FIL *fp, char *buf, UINT *pos, const char *text, UINT len)
+ {
+     FRESULT fres;
+     UINT n, bw;
+
+     while (len) {
+         n = PROFILE_WRITE_CHUNK - *pos;
+         if (n > len)
+             n = len;
+         memcpy(buf + *pos, text, n);
+         *pos += n;
+         text += n;
+         len -= n;
+         if (*pos == PROFILE_WRITE_CHUNK) {
+             fres = f_write(fp, buf, *pos, &bw);
+             if (fres != FR_OK || bw != *pos)
+                 return (fres != FR_OK) ? fres : FR_DENIED; // Disk full
+             *pos = 0;
+         }
+     }
+
+     return FR_OK;
+ }
+
+
+ /*============================================================================*/
+ /**
+   * @brief  Writes all sets of the session in one rewrite of the file.
+   *         Entries not in the file are added before its first empty line,
+   *         like write_private_profile_string() does.
+   * @param  ps  profile session
+   * @retval 1 if successful or nothing to write, otherwise 0
+   */
+ /*============================================================================*/
+ int profile_commit(ProfileSession *ps)
+ {
+     FIL wfp;
+     FRESULT fres;
+     const ProfileLine *line;
+     const ProfileSet *set;
+     char *tmp_name, *buf;
+     UINT pos, bw;
+     int i, k, insert_at;
+
+     if (!ps->sets)
+         return 1;
+
+     // The whole file is needed to rewrite it
+     while (profile_next_line(ps) >= 0)
+         ;
+     if (ps->error)
+         return 0;
+
+     insert_at = ps->lines;
+     for (i = 0; i < ps->lines; i++) {
+         if (!ps->line[i].text_len) {
+             insert_at = i;
+             break;
+         }
+     }
+
+     tmp_name = malloc(strlen(ps->file_name) + sizeof(PROFILE_TMP_SUFFIX));
+     buf = malloc(PROFILE_WRITE_CHUNK);
+     if (tmp_name == NULL || buf == NULL) {
+         free(tmp_name);
+         free(buf);
+         return 0;
+     }
+     strcpy(tmp_name, ps->file_name);
+     strcat(tmp_name, PROFILE_TMP_SUFFIX);
+
+     fres = f_open(&wfp, tmp_name, FA_CREATE_ALWAYS | FA_WRITE);
+     pos = 0;
+     for (i = 0; fres == FR_OK && i <= ps->lines; i++) {
+         if (i == insert_at) {
+             for (k = 0; fres == FR_OK && k < ps->sets; k++) {
+                 set = &ps->set[k];
+                 if (set->line >= 0)
+                     continue;
+                 fres = profile_write_text(&wfp, buf, &pos, set->key, strlen(set->key));
+                 if (fres == FR_OK)
+                     fres = profile_write_text(&wfp, buf, &pos, ": ", 2);
+                 if (fres == FR_OK)
+                     fres = profile_write_text(&wfp, buf, &pos, set->value, strlen(set->value));
+                 if (fres == FR_OK)
+                     fres = profile_write_text(&wfp, buf, &pos, "\n", 1);
+             }
+         }
+         if (i == ps->lines || fres != FR_OK)
+             break;
+
+         line = &ps->line[i];
+         if (line->set >= 0) {
+             set = &ps->set[line->set];
+             fres = profile_write_text(&wfp, buf, &pos, set->key, strlen(set->key));
+             if (fres == FR_OK)
+                 fres = profile_write_text(&wfp, buf, &pos, ": ", 2);
+             if (fres == FR_OK)
+                 fres = profile_write_text(&wfp, buf, &pos, set->value, strlen(set->value));
+         }
+         else {
+             fres = profile_write_text(&wfp, buf, &pos, ps->data + line->text, line->text_len);
+         }
+         if (fres == FR_OK)
+             fres = profile_write_text(&wfp, buf, &pos, "\n", 1);
+     }
+
+     if (fres == FR_OK && pos) {
+         fres = f_write(&wfp, buf, pos, &bw);
+         if (fres == FR_OK && bw != pos)
+             fres = FR_DENIED; // Disk full
+     }
+     if (fres == FR_OK)
+         fres = f_close(&wfp);
+     else
+         f_close(&wfp);
+
+     // The original file is left as it was if anything fails
+     if (fres == FR_OK)
+         fres = m1_fb_replace_file(tmp_name, ps->file_name);
+     if (fres != FR_OK)
+         f_unlink(tmp_name);
+     free(buf);
+     free(tmp_name);
+
+     if (fres != FR_OK)
+         return 0;
+
+     // The session goes on with the new contents
+     for (i = 0; i < ps->sets; i++) {
+         free(ps->set[i].key);
+         free(ps->set[i].value);
+     }
+     free(ps->set);
+     free(ps->line);
+     free(ps->data);
+     ps->set = NULL;
+     ps->line = NULL;
+     ps->data = NULL;
+     ps->sets = ps->max_sets = 0;
+     ps->lines = ps->max_lines = 0;
+     ps->data_len = ps->data_size = ps->parsed = 0;
+     ps->reload = true;
+
+     return 1;
+ }
+
+
+ /************************************************************************
+ * Function:     get_private_profile()
+ * Arguments:    <ParsedValue *> val - value type in, parsed value out
+ *               <char *> entry - the name of the entry to find the value of
+ *               <char *> file_name - the name of the .ini file to read from
+ * Returns:      1 if the entry was found, otherwise 0
+ * Use a profile session to read more than one entry of a file.
+ *************************************************************************/
+ int get_private_profile(ParsedValue *val, const char *entry, const char *file_name)
+ {
+    ProfileSession ps;
+    int ret;
+
+    if (!profile_open(&ps, file_name))
+        return 0;
+    ret = profile_get(&ps, val, entry);
+    profile_close(&ps);
+
+    return ret;
  }
 
 
@@ -657,112 +1105,21 @@ bool isValidHeaderField(ParsedValue *data, const char* filetype, const char* ver
   *              <char *> buffer - pointer to the buffer that holds the string
   *              <char *> file_name - the name of the .ini file to read from
   * Returns:     TRUE if successful, otherwise FALSE
+  * Each call rewrites the file, use a profile session to write more than
+  * one entry.
   *************************************************************************/
  int write_private_profile_string(const char *entry, const char *buffer, const char *file_name)
-{  
-	FIL rfp, wfp;
-    char tmp_name[] = "temp.rfid";
-    //char buff[MAX_LINE_LENGTH];
-    char *line_buff;
-    int len = strlen(entry);
-	
-	 if ((f_open(&rfp, file_name, FA_READ)) != FR_OK)	
-    {  
-		if ((f_open(&wfp, file_name, FA_CREATE_NEW|FA_WRITE)) != FR_OK)
-        {   return(0);   }
-		
-		f_printf(&wfp,"%s: %s\n",entry,buffer);
-		f_close(&wfp);
-		return(1);
-    }
-
-	if ((f_open(&wfp, tmp_name, FA_CREATE_ALWAYS|FA_WRITE)) != FR_OK)
-    {   
-		f_close(&rfp);	
-		return(0);   
-	}	
-     /* Move through the file one line at a time until a section is
-      * matched or until EOF. Copy to temp file as it is read. */
-	// serach key - write value
-     /* Now that the section has been found, find the entry. Stop searching
-      * upon leaving the section's area. Copy the file as it is read
-      * and create an entry if one is not found.  */
-#if 1
-    line_buff = malloc(g_linebuf_size);
-    if(line_buff == NULL)
-    	return 0;
-#endif
-
-     while( 1 )
-     {
-    	if( !read_line(&rfp,line_buff,g_linebuf_size) )
-        {   /* EOF without an entry so make one */
-            f_printf(&wfp,"%s: %s\n",entry,buffer);
-            /* Clean up and rename */
-#if 1
-            safe_free((void*)&line_buff);
-#endif
-            f_close(&rfp);
-            f_close(&wfp);
-            f_unlink(file_name);
-            f_rename(tmp_name,file_name);
-            return(1);
-        }
-  
-     	if (line_buff[0] == '#') {
-     		f_printf(&wfp, "%s\n", line_buff);
-            continue;
-        }
-
-     	char *colon_pos = strchr(line_buff, TOKEN_COLON);
-
-     	if (colon_pos != NULL) {
-
-     	    *colon_pos = '\0';
-
-     	    char *current_key = trim(line_buff);
-
-     	    if (strlen(current_key) == len && !strcmp(current_key, entry)) {
-
-     	    	*colon_pos = TOKEN_COLON;
-     	        break;
-     	    }
-
-     	    *colon_pos = TOKEN_COLON;
-     	}
+ {
+    ProfileSession ps;
+    int ret;
 
-     	if (line_buff[0] == '\0') {
-     		break;
-     	}
+    if (!profile_open(&ps, file_name))
+        return 0;
+    ret = profile_set(&ps, entry, buffer) && profile_commit(&ps);
+    profile_close(&ps);
 
-     	f_printf(&wfp,"%s\n",line_buff);
-    }
-  
-    if( line_buff[0] == '\0' )
-    {   f_printf(&wfp,"%s: %s\n",entry,buffer);
-        do
-        {
-            f_printf(&wfp,"%s\n",line_buff);
-        } while( read_line(&rfp,line_buff,g_linebuf_size) );
-    }
-    else
-    {   f_printf(&wfp,"%s: %s\n",entry,buffer);
-        while( read_line(&rfp,line_buff,g_linebuf_size) )
-        {
-            f_printf(&wfp,"%s\n",line_buff);
-        }
-    }
-
-    /* Clean up and rename */
-#if 1
-    safe_free((void*)&line_buff);
-#endif
-    f_close(&wfp);
-    f_close(&rfp);
-    f_unlink(file_name);
-    f_rename(tmp_name,file_name);
-    return(1);
+    return ret;
  }
-  
+
  #undef MAX_LINE_LENGTH
 
@@ -71,6 +71,50 @@
 
  } ParsedValue;
 
+ /* ================================
+  *  ProfileSession
+  * ================================ */
+
+ /*
+  * A profile session serves any number of gets and sets on one file:
+  * - the file is read once, and only as far as needed to find the entries
+  *   asked for so far,
+  * - sets are kept in memory and written in a single rewrite of the file
+  *   at commit, to a temporary file that replaces the original one with
+  *   m1_fb_replace_file().
+  */
+ #define PROFILE_WRITE_CHUNK		512 // Buffer of the rewrite at commit, the file is read in chunks of set_line_buffer_size()
+ #define PROFILE_TMP_SUFFIX		".tmp"
+
+ typedef struct {
+     uint32_t text;      // Offset of the line in the session data
+     uint16_t text_len;  // Without the line ending
+     uint16_t key_ofs, key_len; // Trimmed, key_len is 0 if the line has no entry
+     uint16_t value_ofs, value_len; // Trimmed, after the last colon
+     int16_t  set;       // Set of this session replacing the line, -1 if none
+ } ProfileLine;
+
+ typedef struct {
+     char *key;
+     char *value;
+     int   line;         // Line replaced, -1 for a new entry
+ } ProfileSet;
+
+ typedef struct {
+     char *file_name;
+     FIL fp;
+     bool fp_open;
+     bool reload;        // Committed, the file is opened again at the next read
+     bool error;         // Read error, the session cannot be committed
+     char *data;         // File contents read so far
+     uint32_t data_len, data_size;
+     uint32_t parsed;    // Offset of the first line not split yet
+     ProfileLine *line;
+     int lines, max_lines;
+     ProfileSet *set;
+     int sets, max_sets;
+ } ProfileSession;
+
  void set_line_buffer_size(size_t size);
 
  bool IsValidFileSpec(const S_M1_file_info *f, const char* ext);
@@ -85,6 +129,20 @@
  int get_private_profile_float(ParsedValue *val, const char *entry, const char *file_name);
  int write_private_profile_string(const char *entry, const char *buffer, const char *file_name);
 
+ int profile_open(ProfileSession *ps, const char *file_name);
+ void profile_close(ProfileSession *ps);
+ int profile_commit(ProfileSession *ps);
+ bool profile_is_valid_header(ProfileSession *ps, ParsedValue *data, const char* filetype, const char* version);
+ int profile_get(ProfileSession *ps, ParsedValue *val, const char *entry);
+ int profile_get_hex_count(ProfileSession *ps, ParsedValue *val, const char *entry);
+ int profile_get_hex(ProfileSession *ps, ParsedValue *val, const char *entry);
+ int profile_get_uint(ProfileSession *ps, ParsedValue *val, const char *entry);
+ int profile_get_int(ProfileSession *ps, ParsedValue *val, const char *entry);
+ int profile_get_string(ProfileSession *ps, ParsedValue *val, const char *entry);
+ int profile_get_bool(ProfileSession *ps, ParsedValue *val, const char *entry);
+ int profile_get_float(ProfileSession *ps, ParsedValue *val, const char *entry);
+ int profile_set(ProfileSession *ps, const char *entry, const char *value);
+
 #define GetPrivateProfileHexCount	get_private_profile_hex_count
 #define GetPrivateProfileHex 		get_private_profile_hex
 #define GetPrivateProfileUint 		get_private_profile_uint
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+# See COPYING.txt for license details.
+#
+# Generates the synthetic Sub-GHz raw data files replayed by the host tests.
+# The output is deterministic, run again after changing a generator:
+#   python3 gen_subghz_corpus.py
+
+import os
+import random
+import struct
+
+FREQUENCY = 433920000
+MODULATION_OOK = 0  # S_M1_SubGHz_Modulation
+PRINCETON_TE = 370
+PRINCETON_KEY = 0x35A5C3
+PRINCETON_BITS = 24
+SAMPLES_PER_LINE = 64
+
+OUT_DIR = os.path.dirname(os.path.abspath(__file__))
+
+
+def princeton_packet(key, te):
+    # Bit 0 |^|___, bit 1 |^^^|_, then the sync bit: short mark, long space
+    pulses = []
+    for i in reversed(range(PRINCETON_BITS)):
+        if (key >> i) & 1:
+            pulses += [3 * te, te]
+        else:
+            pulses += [te, 3 * te]
+    return pulses + [te, 31 * te]
+
+
+def jitter(pulses, rng, ratio):
+    return [max(1, int(round(p * rng.gauss(1.0, ratio)))) for p in pulses]
+
+
+def write_text(name, samples):
+    lines = ["Filetype: M1 SubGHz NOISE", "Version: 1.0",
+             "Frequency: %u" % FREQUENCY, "Modulation: OOK"]
+    for i in range(0, len(samples), SAMPLES_PER_LINE):
+        # Marks have a + sign, spaces none, as the recorder writes them
+        words = ["%s%u" % ("+" if (i + j) % 2 == 0 else "", s)
+                 for j, s in enumerate(samples[i:i + SAMPLES_PER_LINE])]
+        lines.append("Data: " + " ".join(words))
+    with open(os.path.join(OUT_DIR, name), "w", newline="") as f:
+        f.write("\r\n".join(lines) + "\r\n")
+
+
+def write_binary(name, samples):
+    # S_SubGHz_RawFile_Header_t, then LEB128 varints
+    data = bytearray(struct.pack("<4sBBBBB3sI", b"SGHB", 1, 16, MODULATION_OOK, 1, 0, b"\0\0\0", FREQUENCY))
+    for s in samples:
+        while s >= 0x80:
+            data.append((s & 0x7F) | 0x80)
+            s >>= 7
+        data.append(s)
+    with open(os.path.join(OUT_DIR, name), "wb") as f:
+        f.write(data)
+
+
+def main():
+    rng = random.Random(1)
+
+    clean = [PRINCETON_TE, 31 * PRINCETON_TE]  # Sync bit before the first packet
+    for _ in range(50):
+        clean += princeton_packet(PRINCETON_KEY, PRINCETON_TE)
+    write_text("princeton_clean.sgh", clean)
+    write_binary("princeton_clean.sghb", clean)
+
+    # 4% timing jitter, some packets with a glitch or a stretched pulse
+    noisy = [PRINCETON_TE, 31 * PRINCETON_TE]
+    for n in range(100):
+        packet = jitter(princeton_packet(PRINCETON_KEY, PRINCETON_TE), rng, 0.04)
+        if n % 10 == 3:
+            i = rng.randrange(1, 40)
+            packet[i:i + 1] = [packet[i] // 2, 60, packet[i] // 2]  # Glitch splits a pulse
+        elif n % 10 == 7:
+            packet[rng.randrange(8, 40)] *= 2
+        noisy += packet
+    write_text("princeton_noisy.sgh", noisy)
+
+    # Pulses of random widths, as received with no transmitter around
+    noise = [rng.randint(20, 4000) for _ in range(20000)]
+    write_text("noise.sgh", noise)
+
+
+if __name__ == "__main__":
+    main()
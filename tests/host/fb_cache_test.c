@@ -0,0 +1,352 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  fb_cache_test.c
+*
+*  Directory listing cache of the file browser, driven through
+*  m1_fb_display() as the keys do. A directory of 10000 data files is read
+*  in one pass, shown again and scrolled in a few sector reads, sorted by
+*  the whole name, and read again only after a change in it: a file added
+*  by the SD card manager or the file browser, a file deleted, a file
+*  written behind their back, or a new mount. A change in another directory
+*  leaves the listing cached.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "ff.h"
+#include "m1_sdcard.h"
+#include "m1_sdcard_man.h"
+#include "m1_file_browser.h"
+#include "host_port.h"
+#include "host_fatfs.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_DISK_SECTORS			(128*1024) // 64 MB
+#define TEST_FILES					10000
+#define TEST_PREFIX					DATA_FILE_PREFIX "_" // As m1_sdm_file_init() makes it
+#define TEST_DATA_INDEX				1 // Row of DATA_FILEPATH in the root directory, sorted by name
+#define TEST_SHOW_READS_MAX			12 // Sector reads to draw a cached listing, two for each row on screen
+#define TEST_OTHER_DIR				"/NFC" // Not sharing a change counter with DATA_FILEPATH
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+extern u8g2_t m1_u8g2;
+extern const uint8_t host_u8g2_font_blank[];
+
+static S_M1_file_browser_hdl *ptest_fb;
+static S_M1_Buttons_Status test_buttons;
+
+// Sorted by name, directories first. Ties on the first four characters.
+static const char *const test_tie_names[] =
+{
+	"abcdA", "ABCDZ", // Directories
+	"abcd", "ABCDE.txt", "abcdefghij0", "Abcdefghij1", "abcdefghij10.txt", "abcd_10", "abcd_2", "abce"
+};
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static void test_create(const char *filename)
+{
+	FIL file;
+
+	HOST_CHECK(f_open(&file, filename, FA_CREATE_NEW | FA_WRITE)==FR_OK);
+	f_close(&file);
+} // static void test_create(const char *filename)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  One key press, or a redraw if key is NUM_BUTTONS_MAX, and the
+  *         sector reads it took
+  */
+/*============================================================================*/
+static uint32_t test_key(uint8_t key)
+{
+	S_Host_Disk_Stats_t disk;
+
+	memset(&test_buttons, 0, sizeof(test_buttons));
+	if ( key < NUM_BUTTONS_MAX )
+		test_buttons.event[key] = BUTTON_EVENT_CLICK;
+	host_disk_stats_reset();
+	m1_fb_display((key < NUM_BUTTONS_MAX) ? &test_buttons:NULL);
+	host_disk_stats_get(&disk);
+
+	return disk.sectors_read;
+} // static uint32_t test_key(uint8_t key)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Name of the entry shown on row n of the listing, .. being row 0.
+  *         A directory is entered, and left again.
+  * @retval NULL past the end of the listing
+  */
+/*============================================================================*/
+static const char *test_select(uint16_t n, uint32_t *preads)
+{
+	static char name[FF_MAX_LFN + 1];
+	uint8_t level;
+
+	level = ptest_fb->dir_level;
+	ptest_fb->listing_index = n;
+	ptest_fb->row_index = 0;
+	ptest_fb->info.status = FB_OK;
+	*preads = test_key(BUTTON_OK_KP_ID);
+	if ( ptest_fb->info.status!=FB_OK )
+		return NULL;
+	if ( ptest_fb->dir_level==level )
+		return ptest_fb->info.file_name;
+
+	strcpy(name, strrchr(ptest_fb->info.dir_name, '/') + 1);
+	ptest_fb->listing_index = 0;
+	test_key(BUTTON_OK_KP_ID); // Back to ..
+
+	return name;
+} // static const char *test_select(uint16_t n, uint32_t *preads)
+
+
+
+static int test_name_compare(const char *a, const char *b)
+{
+	uint8_t ca, cb;
+
+	do
+	{
+		ca = (uint8_t)*a++;
+		cb = (uint8_t)*b++;
+		if ( ca >= 'a' && ca <= 'z' )
+			ca -= 'a' - 'A';
+		if ( cb >= 'a' && cb <= 'z' )
+			cb -= 'a' - 'A';
+	} while ( ca && ca==cb );
+
+	return (int)ca - (int)cb;
+} // static int test_name_compare(const char *a, const char *b)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Checks the order of the listing shown, sorted by name
+  * @retval number of entries
+  */
+/*============================================================================*/
+static uint16_t test_check_order(void)
+{
+	char previous[FF_MAX_LFN + 1];
+	const char *name;
+	uint32_t reads;
+	uint16_t n;
+
+	previous[0] = 0;
+	for (n=1; ; n++)
+	{
+		name = test_select(n, &reads);
+		if ( name==NULL )
+			break;
+		if ( n > 1 && test_name_compare(previous, name) >= 0 )
+		{
+			printf("  row %u: %s after %s\n", n, name, previous);
+			HOST_CHECK(false);
+		}
+		strcpy(previous, name);
+	} // for (n=1; ; n++)
+
+	return n - 1;
+} // static uint16_t test_check_order(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Files and folders that differ after the first four characters
+  */
+/*============================================================================*/
+static void test_ties(void)
+{
+	static const uint8_t create_order[] = {9, 5, 3, 8, 1, 4, 7, 2, 0, 6};
+	char path[64];
+	const char *name;
+	uint32_t reads;
+	uint8_t i, k;
+
+	HOST_CHECK(m1_fb_make_dir("/TIE")==0);
+	for (i=0; i<sizeof(create_order); i++)
+	{
+		k = create_order[i];
+		sprintf(path, "/TIE/%s", test_tie_names[k]);
+		if ( k < 2 )
+			HOST_CHECK(m1_fb_make_dir(path)==0);
+		else
+			test_create(path);
+	} // for (i=0; i<sizeof(create_order); i++)
+
+	// TIE comes after NFC and DATA in the root directory
+	name = test_select(TEST_DATA_INDEX + 2, &reads);
+	HOST_CHECK(name!=NULL && !strcmp(name, "TIE"));
+	ptest_fb->listing_index = TEST_DATA_INDEX + 2;
+	test_key(BUTTON_OK_KP_ID);
+	for (i=0; i<sizeof(create_order); i++)
+	{
+		name = test_select(i + 1, &reads);
+		HOST_CHECK(name!=NULL && !strcmp(name, test_tie_names[i]));
+	}
+	HOST_CHECK(test_select(i + 1, &reads)==NULL);
+	ptest_fb->listing_index = 0;
+	test_key(BUTTON_OK_KP_ID);
+} // static void test_ties(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Creates the next data file through m1_sdm_file_init() and closes it
+  */
+/*============================================================================*/
+static void test_file_init(char *filename)
+{
+	S_M1_SDM_DatFileInfo_t datfile;
+
+	memset(&datfile, 0, sizeof(datfile));
+	datfile.dir_name = DATA_FILEPATH;
+	datfile.file_prefix = DATA_FILE_PREFIX;
+	datfile.file_infix = "";
+	datfile.file_suffix = "";
+	datfile.file_ext = DATA_FILE_EXTENSION;
+	HOST_CHECK_EQ(m1_sdm_file_init(&datfile), 0);
+	strcpy(filename, strrchr((char *)datfile.dat_filename, '/') + 1);
+
+	m1_sdm_task_init();
+	m1_sdm_task_start();
+	m1_sdm_task_stop(); // Closes the file
+	m1_sdm_task_deinit();
+} // static void test_file_init(char *filename)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Row of a name in the listing shown, 0 if not found
+  */
+/*============================================================================*/
+static uint16_t test_find(const char *filename, uint16_t first)
+{
+	const char *name;
+	uint32_t reads;
+	uint16_t n;
+
+	for (n=first; ; n++)
+	{
+		name = test_select(n, &reads);
+		if ( name==NULL )
+			return 0;
+		if ( !strcmp(name, filename) )
+			return n;
+	} // for (n=first; ; n++)
+} // static uint16_t test_find(const char *filename, uint16_t first)
+
+
+
+int main(void)
+{
+	char filename[64];
+	FIL file;
+	UINT count;
+	uint32_t i, build_reads, show_reads, scroll_reads, reads;
+	uint16_t entries, n;
+
+	HOST_CHECK(host_fatfs_mount(TEST_DISK_SECTORS)!=NULL);
+	HOST_CHECK(f_mkdir(DATA_FILEPATH)==FR_OK);
+	HOST_CHECK(f_mkdir(TEST_OTHER_DIR)==FR_OK);
+	for (i=1; i<=TEST_FILES; i++)
+	{
+		sprintf(filename, "%s/%s%u%s", DATA_FILEPATH, TEST_PREFIX, i, DATA_FILE_EXTENSION);
+		test_create(filename);
+	}
+
+	m1_u8g2_firstpage();
+	u8g2_SetFont(&m1_u8g2, host_u8g2_font_blank);
+	ptest_fb = m1_fb_init(&m1_u8g2);
+	m1_fb_set_sort(FB_SORT_NAME);
+	test_key(NUM_BUTTONS_MAX);
+	test_ties();
+
+	// First visit: one pass over the directory, then one for each four characters of the tied names
+	ptest_fb->listing_index = TEST_DATA_INDEX;
+	build_reads = test_key(BUTTON_OK_KP_ID);
+	HOST_CHECK(!strcmp(strrchr(ptest_fb->info.dir_name, '/') + 1, DATA_FILEPATH + 1));
+	entries = test_check_order();
+	HOST_CHECK_EQ(entries, TEST_FILES);
+
+	// Shown again from the root directory, and scrolled
+	ptest_fb->listing_index = 0;
+	test_key(BUTTON_OK_KP_ID);
+	ptest_fb->listing_index = TEST_DATA_INDEX;
+	show_reads = test_key(BUTTON_OK_KP_ID);
+	HOST_CHECK(show_reads <= TEST_SHOW_READS_MAX);
+	scroll_reads = 0;
+	for (i=0; i<TEST_FILES; i++)
+	{
+		reads = test_key(BUTTON_DOWN_KP_ID);
+		if ( reads > scroll_reads )
+			scroll_reads = reads;
+	}
+	HOST_CHECK_EQ(ptest_fb->listing_index, TEST_FILES);
+	HOST_CHECK(scroll_reads <= TEST_SHOW_READS_MAX);
+	printf("%u files: listing read in %u sector reads, shown again in %u, scrolled in %u at most\n",
+			TEST_FILES, build_reads, show_reads, scroll_reads);
+
+	// A file in another directory
+	HOST_CHECK(m1_fb_open_new_file(&file, TEST_OTHER_DIR "/other.nfc")==0);
+	m1_fb_close_file(&file);
+	HOST_CHECK(test_key(NUM_BUTTONS_MAX) <= TEST_SHOW_READS_MAX);
+
+	// A file from the SD card manager
+	test_file_init(filename);
+	HOST_CHECK(test_key(NUM_BUTTONS_MAX) > TEST_SHOW_READS_MAX);
+	n = test_find(filename, 1);
+	HOST_CHECK(n > 0);
+	HOST_CHECK_EQ(test_check_order(), TEST_FILES + 1);
+
+	// A file from the file browser, then deleted
+	HOST_CHECK(m1_fb_open_new_file(&file, DATA_FILEPATH "/zzz.txt")==0);
+	m1_fb_close_file(&file);
+	HOST_CHECK(test_select(TEST_FILES + 2, &reads)!=NULL && !strcmp(ptest_fb->info.file_name, "zzz.txt"));
+	HOST_CHECK(reads > TEST_SHOW_READS_MAX);
+	HOST_CHECK(m1_fb_delete_file(DATA_FILEPATH "/zzz.txt")==FR_OK);
+	HOST_CHECK(test_select(TEST_FILES + 2, &reads)==NULL);
+
+	// A file written without m1_fb_dir_changed(): found out when its row is read
+	sprintf(filename, "%s/%s1%s", DATA_FILEPATH, TEST_PREFIX, DATA_FILE_EXTENSION);
+	HOST_CHECK(f_open(&file, filename, FA_OPEN_APPEND | FA_WRITE)==FR_OK);
+	f_write(&file, "data", 4, &count);
+	f_close(&file);
+	HOST_CHECK(test_key(NUM_BUTTONS_MAX) <= TEST_SHOW_READS_MAX); // Not on screen
+	n = test_find(strrchr(filename, '/') + 1, 1);
+	HOST_CHECK_EQ(n, 1);
+	HOST_CHECK(test_select(1, &reads)!=NULL);
+	HOST_CHECK(reads <= TEST_SHOW_READS_MAX); // Read again when it was found out
+
+	// A new mount
+	HOST_CHECK(host_fatfs_remount()!=NULL);
+	HOST_CHECK(test_key(NUM_BUTTONS_MAX) > TEST_SHOW_READS_MAX);
+	HOST_CHECK(test_key(NUM_BUTTONS_MAX) <= TEST_SHOW_READS_MAX);
+
+	m1_fb_deinit();
+
+	return host_test_result("fb_cache_test");
+} // int main(void)
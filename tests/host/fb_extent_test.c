@@ -0,0 +1,214 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  fb_extent_test.c
+*
+*  Preallocated files of the file browser on a FatFs RAM disk: FAT writes
+*  per MB of recording with and without an extent, FAT reads of random
+*  seeks with and without fast-seek, and the trim of a file left
+*  preallocated by a power cut.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "ff.h"
+#include "m1_sdcard.h"
+#include "m1_file_browser.h"
+#include "m1_sdcard_man.h"
+#include "host_fatfs.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_DISK_SECTORS			(128*1024) // 64 MB
+#define TEST_FILE_MB				4
+#define TEST_FILE_SIZE				(TEST_FILE_MB*1024*1024)
+#define TEST_CHUNK_SIZE				4096 // One SD card manager buffer
+#define TEST_SYNC_SIZE				(64*1024) // As the SD card manager
+#define TEST_SEEKS					500
+#define TEST_CUT_SYNCED				(200*1024) // Data synced before the power cut
+#define TEST_CUT_UNSYNCED			(20*1024) // Data written after it
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+static uint8_t test_chunk[TEST_CHUNK_SIZE];
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static void test_pattern(uint8_t *pbuffer, uint32_t offset, uint32_t size)
+{
+	while ( size-- )
+	{
+		*pbuffer++ = (uint8_t)(offset ^ (offset >> 9) ^ (offset >> 17));
+		offset++;
+	}
+} // static void test_pattern(uint8_t *pbuffer, uint32_t offset, uint32_t size)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Records size bytes as the SD card manager does, preallocated or
+  *         not, and returns the disk counters of the recording
+  */
+/*============================================================================*/
+static void test_record(const char *filename, uint32_t size, bool expand, S_Host_Disk_Stats_t *pstats)
+{
+	FIL file;
+	UINT count;
+	uint32_t offset;
+
+	HOST_CHECK(f_open(&file, filename, FA_CREATE_NEW | FA_WRITE)==FR_OK);
+	host_disk_stats_reset();
+	if ( expand )
+		HOST_CHECK(m1_fb_expand_file(&file, filename, size)==0);
+	for (offset=0; offset<size; offset+=TEST_CHUNK_SIZE)
+	{
+		test_pattern(test_chunk, offset, TEST_CHUNK_SIZE);
+		HOST_CHECK(f_write(&file, test_chunk, TEST_CHUNK_SIZE, &count)==FR_OK && count==TEST_CHUNK_SIZE);
+		if ( !((offset + TEST_CHUNK_SIZE) % TEST_SYNC_SIZE) )
+			HOST_CHECK(m1_fb_sync_expanded_file(&file)==FR_OK);
+	}
+	HOST_CHECK(m1_fb_close_truncated_file(&file)==FR_OK);
+	host_disk_stats_get(pstats);
+	HOST_CHECK(!m1_fb_check_existence(M1_FB_EXTENT_FILENAME));
+} // static void test_record(const char *filename, uint32_t size, bool expand, S_Host_Disk_Stats_t *pstats)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Reads a sector at random positions of the file and returns the
+  *         most disk reads and FAT sector reads a single seek and read took
+  */
+/*============================================================================*/
+static void test_seek(const char *filename, bool fastseek, uint32_t *preads_max, uint32_t *pfat_max)
+{
+	static DWORD clmt[M1_FB_CLMT_SIZE];
+	S_Host_Disk_Stats_t before, after;
+	uint8_t expected[FF_MIN_SS];
+	FIL file;
+	UINT count;
+	uint32_t i, offset, mismatch;
+
+	if ( fastseek )
+		HOST_CHECK(m1_fb_open_file_fastseek(&file, filename, clmt, M1_FB_CLMT_SIZE)==0 && file.cltbl!=NULL);
+	else
+		HOST_CHECK(m1_fb_open_file(&file, filename)==0);
+	*preads_max = 0;
+	*pfat_max = 0;
+	mismatch = 0;
+	srand(1);
+	for (i=0; i<TEST_SEEKS; i++)
+	{
+		offset = (rand() % (TEST_FILE_SIZE/FF_MIN_SS))*FF_MIN_SS;
+		host_disk_stats_get(&before);
+		HOST_CHECK(f_lseek(&file, offset)==FR_OK);
+		HOST_CHECK(f_read(&file, test_chunk, FF_MIN_SS, &count)==FR_OK && count==FF_MIN_SS);
+		host_disk_stats_get(&after);
+		if ( after.reads - before.reads > *preads_max )
+			*preads_max = after.reads - before.reads;
+		if ( after.fat_sectors_read - before.fat_sectors_read > *pfat_max )
+			*pfat_max = after.fat_sectors_read - before.fat_sectors_read;
+		test_pattern(expected, offset, FF_MIN_SS);
+		if ( memcmp(test_chunk, expected, FF_MIN_SS) )
+			mismatch++;
+	} // for (i=0; i<TEST_SEEKS; i++)
+	f_close(&file);
+	HOST_CHECK_EQ(mismatch, 0);
+} // static void test_seek(const char *filename, bool fastseek, uint32_t *preads_max, uint32_t *pfat_max)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Cuts the power in the middle of a preallocated recording. After
+  *         the mount, the file holds the data synced before the cut, and the
+  *         rest of the extent is free again.
+  */
+/*============================================================================*/
+static void test_power_cut(void)
+{
+	FIL file;
+	FATFS *pfs;
+	UINT count;
+	DWORD free_before, free_after;
+	uint32_t offset;
+
+	HOST_CHECK(f_getfree("", &free_before, &pfs)==FR_OK);
+	HOST_CHECK(f_open(&file, "/cut.sgh", FA_CREATE_NEW | FA_WRITE)==FR_OK);
+	HOST_CHECK(m1_fb_expand_file(&file, "/cut.sgh", M1_SDM_PREALLOC_SIZE)==0);
+	HOST_CHECK(m1_fb_check_existence(M1_FB_EXTENT_FILENAME));
+	for (offset=0; offset<TEST_CUT_SYNCED + TEST_CUT_UNSYNCED; offset+=TEST_CHUNK_SIZE)
+	{
+		test_pattern(test_chunk, offset, TEST_CHUNK_SIZE);
+		f_write(&file, test_chunk, TEST_CHUNK_SIZE, &count);
+		if ( offset + TEST_CHUNK_SIZE==TEST_CUT_SYNCED )
+			HOST_CHECK(m1_fb_sync_expanded_file(&file)==FR_OK);
+	}
+	host_disk_fail_writes_after(0);
+	f_close(&file); // Lost
+
+	m1_sdcard_mount(); // Trims the file
+	HOST_CHECK(!m1_fb_check_existence(M1_FB_EXTENT_FILENAME));
+	HOST_CHECK(m1_fb_open_file(&file, "/cut.sgh")==0);
+	HOST_CHECK_EQ(f_size(&file), TEST_CUT_SYNCED);
+	HOST_CHECK(f_read(&file, test_chunk, TEST_CHUNK_SIZE, &count)==FR_OK && count==TEST_CHUNK_SIZE);
+	f_close(&file);
+	test_pattern(test_chunk + TEST_CHUNK_SIZE/2, 0, TEST_CHUNK_SIZE/2);
+	HOST_CHECK(!memcmp(test_chunk, test_chunk + TEST_CHUNK_SIZE/2, TEST_CHUNK_SIZE/2));
+
+	HOST_CHECK(f_getfree("", &free_after, &pfs)==FR_OK);
+	HOST_CHECK_EQ((free_before - free_after)*pfs->csize*FF_MIN_SS, TEST_CUT_SYNCED);
+
+	// Nothing left to trim at the next mount
+	m1_sdcard_mount();
+	HOST_CHECK(m1_fb_open_file(&file, "/cut.sgh")==0);
+	HOST_CHECK_EQ(f_size(&file), TEST_CUT_SYNCED);
+	f_close(&file);
+} // static void test_power_cut(void)
+
+
+
+int main(void)
+{
+	S_Host_Disk_Stats_t plain, expanded;
+	FATFS *pfs;
+	uint32_t reads_max, fat_max;
+
+	pfs = host_fatfs_mount(TEST_DISK_SECTORS);
+	HOST_CHECK(pfs!=NULL);
+	printf("FAT%s, %u byte clusters\n", pfs->fs_type==FS_FAT12 ? "12":(pfs->fs_type==FS_FAT16 ? "16":"32"),
+			pfs->csize*FF_MIN_SS);
+
+	test_record("/plain.sgh", TEST_FILE_SIZE, false, &plain);
+	test_record("/extent.sgh", TEST_FILE_SIZE, true, &expanded);
+	printf("Recording, per MB:  FAT sectors written  sectors written  disk writes\n");
+	printf("  cluster by cluster %18u %16u %12u\n", plain.fat_sectors_written/TEST_FILE_MB,
+			plain.sectors_written/TEST_FILE_MB, plain.writes/TEST_FILE_MB);
+	printf("  preallocated       %18u %16u %12u\n", expanded.fat_sectors_written/TEST_FILE_MB,
+			expanded.sectors_written/TEST_FILE_MB, expanded.writes/TEST_FILE_MB);
+	// The chain is written once for the whole extent
+	HOST_CHECK(expanded.fat_sectors_written*4 < plain.fat_sectors_written);
+
+	test_seek("/extent.sgh", false, &reads_max, &fat_max);
+	printf("Random sector reads, worst case: FAT walk %u disk reads (%u FAT sectors)", reads_max, fat_max);
+	HOST_CHECK(fat_max > 0);
+	test_seek("/extent.sgh", true, &reads_max, &fat_max);
+	printf(", fast-seek %u disk reads (%u FAT sectors)\n", reads_max, fat_max);
+	HOST_CHECK_EQ(fat_max, 0);
+	HOST_CHECK_EQ(reads_max, 1);
+
+	test_power_cut();
+
+	return host_test_result("fb_extent_test");
+} // int main(void)
@@ -0,0 +1,153 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_port_test.c
+*
+*  Checks the host port layer itself: FreeRTOS services on pthreads and the
+*  FatFs RAM disk, so that a failing module test is not a port problem.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <string.h>
+#include "main.h"
+#include "semphr.h"
+#include "stream_buffer.h"
+#include "host_port.h"
+#include "host_fatfs.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_QUEUE_ITEMS		100
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+static QueueHandle_t test_queue;
+static TaskHandle_t test_main_task;
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static void test_producer_task(void *argument)
+{
+	uint32_t i;
+
+	(void)argument;
+	for (i=0; i<TEST_QUEUE_ITEMS; i++)
+		xQueueSend(test_queue, &i, portMAX_DELAY);
+	xTaskNotifyGive(test_main_task);
+	vTaskDelete(NULL);
+} // static void test_producer_task(void *argument)
+
+
+
+static void test_idle_task(void *argument)
+{
+	(void)argument;
+	for (;;)
+		vTaskDelay(1);
+} // static void test_idle_task(void *argument)
+
+
+
+static void test_rtos(void)
+{
+	TaskHandle_t idle_hdl;
+	SemaphoreHandle_t mutex;
+	StreamBufferHandle_t stream;
+	uint32_t i, item;
+	uint8_t bytes[8];
+	uint64_t t_start;
+
+	test_main_task = xTaskGetCurrentTaskHandle();
+	test_queue = xQueueCreate(4, sizeof(uint32_t));
+	HOST_CHECK(test_queue!=NULL);
+	HOST_CHECK(xTaskCreate(test_producer_task, "producer", 256, NULL, 10, NULL)==pdPASS);
+	for (i=0; i<TEST_QUEUE_ITEMS; i++)
+	{
+		HOST_CHECK(xQueueReceive(test_queue, &item, pdMS_TO_TICKS(1000))==pdTRUE);
+		HOST_CHECK_EQ(item, i);
+	}
+	HOST_CHECK_EQ(ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000)), 1);
+
+	// Timeout on an empty queue
+	t_start = host_time_us();
+	HOST_CHECK(xQueueReceive(test_queue, &item, pdMS_TO_TICKS(20))==pdFALSE);
+	HOST_CHECK(host_time_us() - t_start >= 20000);
+	vQueueDelete(test_queue);
+
+	mutex = xSemaphoreCreateRecursiveMutex();
+	HOST_CHECK(xSemaphoreTakeRecursive(mutex, 0)==pdTRUE);
+	HOST_CHECK(xSemaphoreTakeRecursive(mutex, 0)==pdTRUE);
+	HOST_CHECK(xSemaphoreGetMutexHolder(mutex)==test_main_task);
+	xSemaphoreGiveRecursive(mutex);
+	xSemaphoreGiveRecursive(mutex);
+	HOST_CHECK(xSemaphoreGetMutexHolder(mutex)==NULL);
+	vSemaphoreDelete(mutex);
+
+	stream = xStreamBufferCreate(sizeof(bytes), 1);
+	host_isr_enter();
+	HOST_CHECK_EQ(xStreamBufferSendFromISR(stream, "0123456789", 10, NULL), sizeof(bytes));
+	host_isr_exit();
+	HOST_CHECK_EQ(xStreamBufferReceive(stream, bytes, sizeof(bytes), 0), sizeof(bytes));
+	HOST_CHECK(!memcmp(bytes, "01234567", sizeof(bytes)));
+	vStreamBufferDelete(stream);
+
+	// A task blocked in the kernel can be deleted
+	HOST_CHECK(xTaskCreate(test_idle_task, "idle", 256, NULL, 1, &idle_hdl)==pdPASS);
+	vTaskDelay(5);
+	vTaskDelete(idle_hdl);
+} // static void test_rtos(void)
+
+
+
+static void test_fatfs(void)
+{
+	static uint8_t data[5000];
+	uint8_t rd[sizeof(data)];
+	S_Host_Disk_Stats_t stats;
+	FIL file;
+	UINT n;
+	uint32_t i;
+
+	for (i=0; i<sizeof(data); i++)
+		data[i] = i*7;
+
+	HOST_CHECK(host_fatfs_mount(8192)!=NULL);
+	HOST_CHECK(f_mkdir("/DIR")==FR_OK);
+	HOST_CHECK(f_open(&file, "/DIR/a.bin", FA_CREATE_ALWAYS | FA_WRITE)==FR_OK);
+	HOST_CHECK(f_write(&file, data, sizeof(data), &n)==FR_OK && n==sizeof(data));
+	HOST_CHECK(f_close(&file)==FR_OK);
+
+	HOST_CHECK(host_fatfs_remount()!=NULL);
+	host_disk_stats_reset();
+	HOST_CHECK(f_open(&file, "/DIR/a.bin", FA_READ)==FR_OK);
+	HOST_CHECK(f_read(&file, rd, sizeof(rd), &n)==FR_OK && n==sizeof(rd));
+	HOST_CHECK(!memcmp(rd, data, sizeof(data)));
+	f_close(&file);
+	host_disk_stats_get(&stats);
+	HOST_CHECK(stats.sectors_read >= sizeof(data)/512);
+
+	// Nothing reaches the disk after a power cut
+	host_disk_fail_writes_after(0);
+	HOST_CHECK(f_open(&file, "/DIR/b.bin", FA_CREATE_ALWAYS | FA_WRITE)!=FR_OK || f_close(&file)!=FR_OK);
+	HOST_CHECK(host_fatfs_remount()!=NULL);
+	HOST_CHECK(f_stat("/DIR/b.bin", NULL)==FR_NO_FILE);
+	HOST_CHECK(f_stat("/DIR/a.bin", NULL)==FR_OK);
+} // static void test_fatfs(void)
+
+
+
+int main(void)
+{
+	test_rtos();
+	test_fatfs();
+
+	return host_test_result("host_port_test");
+} // int main(void)
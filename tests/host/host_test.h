@@ -0,0 +1,39 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_test.h
+*
+*  Checks of the host tests. A failed check is reported with its location,
+*  and the test exits with a non-zero status from host_test_result().
+*
+* M1 Project
+*
+*/
+
+#ifndef HOST_TEST_H_
+#define HOST_TEST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+extern uint32_t host_test_failures;
+
+#define HOST_CHECK(cond)	do { if ( !(cond) ) { host_test_failures++; \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); } } while (0)
+
+#define HOST_CHECK_EQ(a, b)	do { long long va_ = (long long)(a), vb_ = (long long)(b); if ( va_!=vb_ ) { host_test_failures++; \
+		fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, va_, vb_); } } while (0)
+
+#define HOST_TEST_DEFINE	uint32_t host_test_failures
+
+static inline int host_test_result(const char *name)
+{
+	if ( host_test_failures )
+		fprintf(stderr, "%s: %u check(s) failed\n", name, host_test_failures);
+	else
+		printf("%s: passed\n", name);
+	return host_test_failures ? 1:0;
+} // static inline int host_test_result(const char *name)
+
+#endif /* HOST_TEST_H_ */
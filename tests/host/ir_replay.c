@@ -0,0 +1,416 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  ir_replay.c
+*
+*  Replays IR-Data logs (Infrared/irmp-irsnd/IR-Data) through a model of the
+*  IR Rx capture timer, then decodes the edges twice: one main queue message
+*  per edge, as the capture interrupt used to send them, and through the
+*  stream buffer of m1_infrared_rx.c. Both paths must decode the same frames
+*  and the stream buffer must not drop any edge. The decoder can be held back
+*  for a while after each message, like a busy UI would hold it.
+*
+*  ir_replay [--stall ms] [--min-frames n] file...
+*
+*  --stall       time the decoder is held back after a message, default 0
+*  --min-frames  fails if fewer frames than this are decoded
+*
+*  The stream buffer must also send fewer messages than the per edge queue.
+*
+*  A log holds one character per sample of the receiver output: '0' while
+*  the carrier is received, '1' otherwise. A line is a key press, '#' starts
+*  a comment line. Logs are sampled at 10kHz unless the file name tells
+*  another rate, as in "apple-15kHz.txt".
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "main.h"
+#include "m1_tasks.h"
+#include "m1_infrared_rx.h"
+#include "m1_log_debug.h"
+#include "host_port.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define REPLAY_RATE_DEFAULT			10000 // Samples per second
+#define REPLAY_Q_ITEMS				256 // MAIN_QUEUE_ITEMS_MAX_N
+#define REPLAY_LINE_GAP_US			100000 // Idle time after each line of a log
+#define REPLAY_NO_MESSAGE			0xFFFFFFFFU
+
+//************************** S T R U C T U R E S *******************************
+
+typedef enum
+{
+	REPLAY_PATH_QUEUE = 0, // One message per edge
+	REPLAY_PATH_STREAM, // Stream buffer, one message per frame
+	REPLAY_PATH_MAX
+} S_Replay_Path_t;
+
+typedef struct
+{
+	uint8_t path;
+	QueueHandle_t q_hdl; // Stands for main_q
+	uint32_t rate; // Samples per second
+	uint32_t sample; // Samples so far, line gaps included
+	uint32_t reset_us; // Last restart of the capture timer counter
+	uint32_t message_us; // Oldest message not serviced, REPLAY_NO_MESSAGE if none
+	uint8_t level; // Receiver output
+} S_Replay_Ctx_t;
+
+typedef struct
+{
+	uint32_t samples;
+	uint32_t edges; // Records made by the capture model, overflows included
+	uint32_t frames[REPLAY_PATH_MAX];
+	uint32_t hash[REPLAY_PATH_MAX]; // Of the decoded protocols, addresses and commands
+	uint32_t messages[REPLAY_PATH_MAX]; // Queue messages sent
+	uint32_t dropped[REPLAY_PATH_MAX]; // Records lost
+} S_Replay_Result_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+static uint32_t replay_stall_ms;
+static S_Replay_Result_t replay_result;
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+static uint32_t replay_rate(const char *filename);
+static uint32_t replay_sample_us(const S_Replay_Ctx_t *pctx, uint32_t sample);
+static void replay_frame(uint8_t path, const IRMP_DATA *pirmp_data);
+static void replay_service(S_Replay_Ctx_t *pctx);
+static void replay_put(S_Replay_Ctx_t *pctx, const S_M1_IR_Rx_Edge_t *pedge, uint32_t t_us);
+static void replay_advance(S_Replay_Ctx_t *pctx, uint32_t t_us);
+static void replay_level(S_Replay_Ctx_t *pctx, uint8_t level);
+static void replay_line_end(S_Replay_Ctx_t *pctx);
+static uint8_t replay_path(const char *filename, S_Replay_Ctx_t *pctx);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+/*============================================================================*/
+/**
+  * @brief  Sample rate told by the file name ("15kHz", "15khz"), else the
+  *         default one
+  */
+/*============================================================================*/
+static uint32_t replay_rate(const char *filename)
+{
+	const char *pname, *p;
+	uint32_t khz;
+
+	pname = strrchr(filename, '/');
+	pname = pname ? (pname + 1):filename;
+	for (p=pname; *p; p++)
+	{
+		if ( !isdigit((unsigned char)*p) || (p > pname && isdigit((unsigned char)p[-1])) )
+			continue;
+		khz = strtoul(p, (char **)&p, 10);
+		if ( !strncasecmp(p, "khz", 3) && khz )
+			return khz*1000;
+		p--;
+	} // for (p=pname; *p; p++)
+
+	return REPLAY_RATE_DEFAULT;
+} // static uint32_t replay_rate(const char *filename)
+
+
+
+static uint32_t replay_sample_us(const S_Replay_Ctx_t *pctx, uint32_t sample)
+{
+	return (uint32_t)(((uint64_t)sample*1000000U)/pctx->rate);
+} // static uint32_t replay_sample_us(const S_Replay_Ctx_t *pctx, uint32_t sample)
+
+
+
+static void replay_frame(uint8_t path, const IRMP_DATA *pirmp_data)
+{
+	uint32_t hash = replay_result.hash[path];
+
+	// FNV-1a over the fields both paths must agree on
+	hash = (hash ^ pirmp_data->protocol)*16777619U;
+	hash = (hash ^ pirmp_data->address)*16777619U;
+	hash = (hash ^ pirmp_data->command)*16777619U;
+	replay_result.hash[path] = hash;
+	replay_result.frames[path]++;
+} // static void replay_frame(uint8_t path, const IRMP_DATA *pirmp_data)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Decoder side: takes the messages waiting as the infrared task does
+  */
+/*============================================================================*/
+static void replay_service(S_Replay_Ctx_t *pctx)
+{
+	S_M1_Main_Q_t q_item;
+	IRMP_DATA irmp_data;
+	uint8_t dir;
+
+	while ( xQueueReceive(pctx->q_hdl, &q_item, 0)==pdTRUE )
+	{
+		if ( pctx->path==REPLAY_PATH_STREAM )
+		{
+			while ( infrared_rx_decode(&irmp_data) )
+				replay_frame(pctx->path, &irmp_data);
+			continue;
+		}
+
+		dir = q_item.q_data.ir_rx_data.ir_edge_dir;
+		if ( (dir & IR_RX_EDGE_TIMEOUT) && !irmp_start_bit_is_detected() )
+			continue;
+		irmp_data_sampler(q_item.q_data.ir_rx_data.ir_edge_te, dir & ~IR_RX_EDGE_TIMEOUT);
+		if ( irmp_get_data(&irmp_data) )
+			replay_frame(pctx->path, &irmp_data);
+	} // while ( xQueueReceive(pctx->q_hdl, &q_item, 0)==pdTRUE )
+
+	pctx->message_us = REPLAY_NO_MESSAGE;
+} // static void replay_service(S_Replay_Ctx_t *pctx)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Interrupt side: hands a record over, then lets the decoder run
+  *         once the stall time since the oldest waiting message has passed
+  */
+/*============================================================================*/
+static void replay_put(S_Replay_Ctx_t *pctx, const S_M1_IR_Rx_Edge_t *pedge, uint32_t t_us)
+{
+	S_M1_Main_Q_t q_item;
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	if ( pctx->path==REPLAY_PATH_STREAM )
+	{
+		infrared_rx_put_from_isr(pedge, &xHigherPriorityTaskWoken);
+	}
+	else if ( pedge!=NULL )
+	{
+		q_item.q_evt_type = Q_EVENT_IRRED_RX;
+		q_item.q_data.ir_rx_data.ir_edge_te = pedge->ir_edge_te;
+		q_item.q_data.ir_rx_data.ir_edge_dir = pedge->ir_edge_dir;
+		if ( xQueueSendFromISR(pctx->q_hdl, &q_item, &xHigherPriorityTaskWoken)==pdPASS )
+			replay_result.messages[pctx->path]++;
+		else
+			replay_result.dropped[pctx->path]++;
+		replay_result.edges++;
+	} // else if ( pedge!=NULL )
+
+	if ( pctx->message_us==REPLAY_NO_MESSAGE && uxQueueMessagesWaiting(pctx->q_hdl) )
+		pctx->message_us = t_us;
+	if ( pctx->message_us!=REPLAY_NO_MESSAGE && t_us - pctx->message_us >= replay_stall_ms*1000 )
+		replay_service(pctx);
+} // static void replay_put(S_Replay_Ctx_t *pctx, const S_M1_IR_Rx_Edge_t *pedge, uint32_t t_us)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Runs the capture timer up to a time, overflowing on the way
+  */
+/*============================================================================*/
+static void replay_advance(S_Replay_Ctx_t *pctx, uint32_t t_us)
+{
+	S_M1_IR_Rx_Edge_t ir_edge;
+
+	while ( t_us - pctx->reset_us > IRMP_TIMEOUT_TIME )
+	{
+		pctx->reset_us += IRMP_TIMEOUT_TIME + 1;
+		if ( infrared_rx_overflow(pctx->level, &ir_edge) )
+			replay_put(pctx, &ir_edge, pctx->reset_us);
+		else
+			replay_put(pctx, NULL, pctx->reset_us);
+	}
+} // static void replay_advance(S_Replay_Ctx_t *pctx, uint32_t t_us)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Next sample of the receiver output. The counter restarts on
+  *         every edge, as the capture interrupt restarts it.
+  */
+/*============================================================================*/
+static void replay_level(S_Replay_Ctx_t *pctx, uint8_t level)
+{
+	S_M1_IR_Rx_Edge_t ir_edge;
+	uint32_t t_us = replay_sample_us(pctx, pctx->sample++);
+
+	replay_advance(pctx, t_us);
+	if ( level==pctx->level )
+		return;
+
+	pctx->level = level;
+	if ( infrared_rx_edge(t_us - pctx->reset_us, level, &ir_edge) )
+		replay_put(pctx, &ir_edge, t_us);
+	pctx->reset_us = t_us;
+} // static void replay_level(S_Replay_Ctx_t *pctx, uint8_t level)
+
+
+
+static void replay_line_end(S_Replay_Ctx_t *pctx)
+{
+	replay_level(pctx, 1);
+	pctx->sample += (uint32_t)(((uint64_t)REPLAY_LINE_GAP_US*pctx->rate)/1000000U);
+	replay_advance(pctx, replay_sample_us(pctx, pctx->sample));
+} // static void replay_line_end(S_Replay_Ctx_t *pctx)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Replays a log through one path
+  */
+/*============================================================================*/
+static uint8_t replay_path(const char *filename, S_Replay_Ctx_t *pctx)
+{
+	FILE *pfile;
+	int c;
+	uint8_t comment = 0;
+
+	pfile = fopen(filename, "r");
+	if ( pfile==NULL )
+		return 1;
+
+	// Also restarts the capture model
+	infrared_rx_stream_init(pctx->q_hdl);
+	irmp_init();
+	xQueueReset(pctx->q_hdl);
+	pctx->sample = 0;
+	pctx->reset_us = 0;
+	pctx->message_us = REPLAY_NO_MESSAGE;
+	pctx->level = 1;
+
+	while ( (c = fgetc(pfile))!=EOF )
+	{
+		if ( comment )
+		{
+			comment = (c!='\n');
+			continue;
+		}
+		switch ( c )
+		{
+			case '#':
+				comment = 1;
+				break;
+
+			case '0':
+			case '1':
+				if ( pctx->path==REPLAY_PATH_QUEUE )
+					replay_result.samples++;
+				replay_level(pctx, c - '0');
+				break;
+
+			case '\n':
+				replay_line_end(pctx);
+				break;
+
+			default:
+				break;
+		} // switch ( c )
+	} // while ( (c = fgetc(pfile))!=EOF )
+	fclose(pfile);
+
+	replay_line_end(pctx); // The last line may have no line feed
+	if ( pctx->message_us!=REPLAY_NO_MESSAGE )
+		replay_service(pctx);
+
+	if ( pctx->path==REPLAY_PATH_STREAM )
+	{
+		replay_result.messages[pctx->path] += ir_rx_stats.notifications;
+		replay_result.dropped[pctx->path] += ir_rx_stats.dropped;
+	}
+	infrared_rx_stream_deinit();
+
+	return 0;
+} // static uint8_t replay_path(const char *filename, S_Replay_Ctx_t *pctx)
+
+
+
+int main(int argc, char *argv[])
+{
+	const char *path_names[REPLAY_PATH_MAX] = {"Queue per edge", "Stream buffer"};
+	S_Replay_Ctx_t ctx;
+	S_Replay_Result_t warmup;
+	uint32_t min_frames, files;
+	uint8_t path;
+	int i;
+
+	// The decoder logs each frame it gives up on, M1_HOST_LOG brings them back
+	if ( getenv("M1_HOST_LOG")==NULL )
+		host_log_set_level(LOG_DEBUG_LEVEL_NONE);
+	min_frames = 0;
+	files = 0;
+	memset(&replay_result, 0, sizeof(replay_result));
+	ctx.q_hdl = xQueueCreate(REPLAY_Q_ITEMS, sizeof(S_M1_Main_Q_t));
+	if ( ctx.q_hdl==NULL )
+		return 2;
+
+	for (i=1; i<argc; i++)
+	{
+		if ( !strcmp(argv[i], "--stall") && (i + 1) < argc )
+			replay_stall_ms = strtoul(argv[++i], NULL, 0);
+		else if ( !strcmp(argv[i], "--min-frames") && (i + 1) < argc )
+			min_frames = strtoul(argv[++i], NULL, 0);
+		else
+		{
+			ctx.rate = replay_rate(argv[i]);
+			// The decoder keeps state from frame to frame (repetitions). A
+			// first run, not counted, leaves it as each counted run will.
+			warmup = replay_result;
+			ctx.path = REPLAY_PATH_QUEUE;
+			if ( replay_path(argv[i], &ctx) )
+			{
+				fprintf(stderr, "%s: cannot read the log\n", argv[i]);
+				return 2;
+			}
+			replay_result = warmup;
+			for (ctx.path=0; ctx.path<REPLAY_PATH_MAX; ctx.path++)
+			{
+				if ( replay_path(argv[i], &ctx) )
+				{
+					fprintf(stderr, "%s: cannot read the log\n", argv[i]);
+					return 2;
+				}
+			}
+			files++;
+		}
+	} // for (i=1; i<argc; i++)
+	vQueueDelete(ctx.q_hdl);
+
+	if ( !replay_result.samples )
+	{
+		fprintf(stderr, "No samples\n");
+		return 2;
+	}
+
+	printf("%u logs: %u samples, %u edges, decoder stall %ums\n", files, replay_result.samples, replay_result.edges,
+			replay_stall_ms);
+	for (path=0; path<REPLAY_PATH_MAX; path++)
+		printf("%s: %u frames, %u messages, %u edges dropped\n", path_names[path], replay_result.frames[path],
+				replay_result.messages[path], replay_result.dropped[path]);
+
+	// Frames cut short by dropped edges decode differently
+	if ( !replay_result.dropped[REPLAY_PATH_QUEUE]
+			&& (replay_result.frames[REPLAY_PATH_QUEUE]!=replay_result.frames[REPLAY_PATH_STREAM]
+			|| replay_result.hash[REPLAY_PATH_QUEUE]!=replay_result.hash[REPLAY_PATH_STREAM]) )
+	{
+		fprintf(stderr, "Decoded frames: different\n");
+		return 1;
+	}
+	if ( replay_result.dropped[REPLAY_PATH_STREAM] || replay_result.frames[REPLAY_PATH_STREAM] < min_frames )
+		return 1;
+	if ( replay_result.messages[REPLAY_PATH_STREAM] >= replay_result.messages[REPLAY_PATH_QUEUE] )
+		return 1;
+
+	return 0;
+} // int main(int argc, char *argv[])
@@ -0,0 +1,386 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  lfrfid_demod_test.c
+*
+*  Shared LF RFID demodulation front end. The capture events of a tag are
+*  made from the steps of its emulation encoder, so that the reader and the
+*  emulator are checked against each other. Each tag must be read by the
+*  demodulator of its protocol only, at the same event whatever the batches
+*  are, and the Manchester and FSK2a timing limits must hold.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "lfrfid.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_FRAMES					4
+#define TEST_EVENTS_MAX				(TEST_FRAMES*ENCODED_DATA_MAX)
+#define TEST_GPIO_SET_MASK			0x0000FFFFU // Lower half of BSRR sets the pin
+
+//************************** S T R U C T U R E S *******************************
+
+typedef struct
+{
+	uint8_t protocol;
+	uint16_t bitrate; // RF/n of the EM4100 encoder
+	uint8_t uid[5];
+} S_Test_Tag_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+static const S_Test_Tag_t test_tags[] =
+{
+	{LFRFIDProtocolEM4100, 64, {0x01, 0x02, 0x03, 0x04, 0x05}},
+	{LFRFIDProtocolEM4100_32, 32, {0xA1, 0xB2, 0xC3, 0xD4, 0xE5}},
+	{LFRFIDProtocolEM4100_16, 16, {0x00, 0xFF, 0x00, 0xFF, 0x00}},
+	{LFRFIDProtocolH10301, 0, {0x7B, 0x30, 0x39}},
+};
+
+// Batch sizes of the chunking check, the last one is that of lfrfid_rxThread()
+static const uint8_t test_chunks[] = {1, 7, 33, LFR_BATCH_ITEMS};
+
+static lfrfid_evt_t test_evts[TEST_EVENTS_MAX];
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+static uint32_t test_encode(const S_Test_Tag_t *ptag, lfrfid_evt_t *pevts);
+static void test_scale(lfrfid_evt_t *pevts, uint32_t count, uint16_t percent);
+static uint8_t test_run(int16_t demod, const lfrfid_evt_t *pevts, uint32_t count, uint8_t chunk, uint32_t *pevent);
+static void test_routing(void);
+static void test_chunking(void);
+static void test_manchester_limits(void);
+static void test_fsk_symbols(void);
+static void test_fsk_bits(void);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+/*============================================================================*/
+/**
+  * @brief  Turns TEST_FRAMES frames of the emulation steps of a tag into the
+  *         events the TIM5 capture interrupt would queue for them
+  * @retval number of events
+  */
+/*============================================================================*/
+static uint32_t test_encode(const S_Test_Tag_t *ptag, lfrfid_evt_t *pevts)
+{
+	uint32_t count, level_us;
+	uint16_t i, frame;
+	uint8_t level, step_level;
+
+	memset(&lfrfid_tag_info, 0, sizeof(lfrfid_tag_info));
+	memcpy(lfrfid_tag_info.uid, ptag->uid, sizeof(ptag->uid));
+	lfrfid_tag_info.protocol = ptag->protocol;
+	lfrfid_tag_info.bitrate = ptag->bitrate;
+	lfrfid_encoded_data.length = 0;
+	if ( !lfrfid_encoder_begin(ptag->protocol, &lfrfid_tag_info) || !lfrfid_encoded_data.length )
+		return 0;
+
+	count = 0;
+	level = (lfrfid_encoded_data.data[0].bsrr & TEST_GPIO_SET_MASK) ? 1:0;
+	level_us = 0;
+	for (frame=0; frame<TEST_FRAMES; frame++)
+	{
+		for (i=0; i<lfrfid_encoded_data.length; i++)
+		{
+			step_level = (lfrfid_encoded_data.data[i].bsrr & TEST_GPIO_SET_MASK) ? 1:0;
+			if ( step_level!=level )
+			{
+				// t_us is the level before the edge, edge the level after it
+				pevts[count].t_us = level_us;
+				pevts[count].edge = step_level;
+				count++;
+				level = step_level;
+				level_us = 0;
+			}
+			level_us += lfrfid_encoded_data.data[i].time_us;
+		} // for (i=0; i<lfrfid_encoded_data.length; i++)
+	} // for (frame=0; frame<TEST_FRAMES; frame++)
+
+	return count;
+} // static uint32_t test_encode(const S_Test_Tag_t *ptag, lfrfid_evt_t *pevts)
+
+
+
+static void test_scale(lfrfid_evt_t *pevts, uint32_t count, uint16_t percent)
+{
+	uint32_t i;
+
+	for (i=0; i<count; i++)
+		pevts[i].t_us = (uint16_t)((uint32_t)pevts[i].t_us*percent/100);
+} // static void test_scale(lfrfid_evt_t *pevts, uint32_t count, uint16_t percent)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Feeds events in batches to one demodulator, or to all of them
+  *         through lfrfid_demod_execute(), from restarted decoders
+  * @param  demod demodulator, -1 for lfrfid_demod_execute()
+  * @param  chunk batch size
+  * @param  pevent first event after the batch of the read
+  * @retval Protocol which read a tag, LFRFIDProtocolMax otherwise
+  */
+/*============================================================================*/
+static uint8_t test_run(int16_t demod, const lfrfid_evt_t *pevts, uint32_t count, uint8_t chunk, uint32_t *pevent)
+{
+	uint32_t i;
+	uint8_t n, protocol;
+
+	lfrfid_decoder_begin();
+	memset(lfrfid_tag_info.uid, 0, sizeof(lfrfid_tag_info.uid));
+	protocol = LFRFIDProtocolMax;
+	for (i=0; i<count && protocol==LFRFIDProtocolMax; i+=n)
+	{
+		n = (count - i < chunk) ? (count - i):chunk;
+		if ( demod < 0 )
+		{
+			protocol = lfrfid_demod_execute(&pevts[i], n);
+		}
+		else
+		{
+			lfrfid_demod_classify(&pevts[i], n);
+			protocol = lfrfid_demod_run((uint8_t)demod, &pevts[i], n);
+		}
+	} // for (i=0; i<count && protocol==LFRFIDProtocolMax; i+=n)
+	if ( pevent )
+		*pevent = i;
+
+	return protocol;
+} // static uint8_t test_run(int16_t demod, const lfrfid_evt_t *pevts, uint32_t count, uint8_t chunk, uint32_t *pevent)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Every tag is read by the demodulator its protocol subscribes to,
+  *         and by no other one
+  */
+/*============================================================================*/
+static void test_routing(void)
+{
+	const S_Test_Tag_t *ptag;
+	uint32_t count;
+	uint8_t t, d, own, protocol;
+
+	for (t=0; t<sizeof(test_tags)/sizeof(test_tags[0]); t++)
+	{
+		ptag = &test_tags[t];
+		count = test_encode(ptag, test_evts);
+		HOST_CHECK(count > 0);
+		own = lfrfid_protocols[ptag->protocol]->decoder.demod;
+
+		for (d=0; d<LFRFIDDemodMax; d++)
+		{
+			protocol = test_run(d, test_evts, count, LFR_BATCH_ITEMS, NULL);
+			if ( d==own )
+			{
+				HOST_CHECK_EQ(protocol, ptag->protocol);
+				HOST_CHECK(!memcmp(lfrfid_tag_info.uid, ptag->uid, protocol_get_data_size(ptag->protocol)));
+			}
+			else if ( protocol!=LFRFIDProtocolMax )
+			{
+				HOST_CHECK_EQ(protocol, LFRFIDProtocolMax);
+				fprintf(stderr, "%s read by %s\n", protocol_get_name(ptag->protocol), lfrfid_demod_get_name(d));
+			}
+		} // for (d=0; d<LFRFIDDemodMax; d++)
+
+		HOST_CHECK_EQ(test_run(-1, test_evts, count, LFR_BATCH_ITEMS, NULL), ptag->protocol);
+	} // for (t=0; t<sizeof(test_tags)/sizeof(test_tags[0]); t++)
+} // static void test_routing(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  The demodulator states carry over from batch to batch, so the
+  *         batch size does not change where a tag is read. With a batch of
+  *         one event, the event of the read is exact.
+  */
+/*============================================================================*/
+static void test_chunking(void)
+{
+	const S_Test_Tag_t *ptag;
+	uint32_t count, exact, event;
+	uint8_t t, c;
+
+	for (t=0; t<sizeof(test_tags)/sizeof(test_tags[0]); t++)
+	{
+		ptag = &test_tags[t];
+		count = test_encode(ptag, test_evts);
+
+		HOST_CHECK_EQ(test_run(-1, test_evts, count, 1, &exact), ptag->protocol);
+		for (c=1; c<sizeof(test_chunks); c++)
+		{
+			HOST_CHECK_EQ(test_run(-1, test_evts, count, test_chunks[c], &event), ptag->protocol);
+			HOST_CHECK(!memcmp(lfrfid_tag_info.uid, ptag->uid, protocol_get_data_size(ptag->protocol)));
+			// The read is in the batch holding the exact event
+			HOST_CHECK_EQ((event - 1)/test_chunks[c], (exact - 1)/test_chunks[c]);
+		}
+	} // for (t=0; t<sizeof(test_tags)/sizeof(test_tags[0]); t++)
+} // static void test_chunking(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Levels are halves up to 1.6 T and full bits up to 2.6 T, two
+  *         halves pair from 1.2 T to 2.6 T. A tag runs from 0.8 T to 1.3 T
+  *         of its rate, an RF/64 tag at half speed is a valid RF/32 tag.
+  */
+/*============================================================================*/
+static void test_manchester_limits(void)
+{
+	const S_Test_Tag_t *ptag = &test_tags[0];
+	uint32_t count;
+
+	// Full bits of 1.7 T are still FULL
+	count = test_encode(ptag, test_evts);
+	test_scale(test_evts, count, 85);
+	HOST_CHECK_EQ(test_run(LFRFIDDemodManchesterRF64, test_evts, count, LFR_BATCH_ITEMS, NULL), ptag->protocol);
+
+	// 1.25 T halves pair at 2.5 T, and full bits of 2.5 T are FULL
+	count = test_encode(ptag, test_evts);
+	test_scale(test_evts, count, 125);
+	HOST_CHECK_EQ(test_run(LFRFIDDemodManchesterRF64, test_evts, count, LFR_BATCH_ITEMS, NULL), ptag->protocol);
+
+	// Full bits of 1.5 T are taken for halves
+	count = test_encode(ptag, test_evts);
+	test_scale(test_evts, count, 75);
+	HOST_CHECK_EQ(test_run(LFRFIDDemodManchesterRF64, test_evts, count, LFR_BATCH_ITEMS, NULL), LFRFIDProtocolMax);
+
+	// Full bits of 3 T are neither FULL nor a pair
+	count = test_encode(ptag, test_evts);
+	test_scale(test_evts, count, 150);
+	HOST_CHECK_EQ(test_run(-1, test_evts, count, LFR_BATCH_ITEMS, NULL), LFRFIDProtocolMax);
+
+	count = test_encode(ptag, test_evts);
+	test_scale(test_evts, count, 50);
+	HOST_CHECK_EQ(test_run(-1, test_evts, count, LFR_BATCH_ITEMS, NULL), LFRFIDProtocolEM4100_32);
+	HOST_CHECK(!memcmp(lfrfid_tag_info.uid, ptag->uid, EM4100_DECODED_DATA_SIZE));
+} // static void test_manchester_limits(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Periods of 64 us and 80 us within 20 %, made of two halves of
+  *         opposite levels. Where the ranges overlap the nearer one wins.
+  */
+/*============================================================================*/
+static void test_fsk_symbols(void)
+{
+	static const struct
+	{
+		uint16_t first_us;
+		uint16_t second_us;
+		uint8_t symbol; // 0xFF: no symbol
+	} periods[] =
+	{
+		{32, 32, 0},
+		{26, 26, 0},
+		{35, 35, 0},
+		{38, 38, 1}, // Nearer to 80 us
+		{40, 40, 1},
+		{33, 47, 1},
+		{48, 48, 1},
+		{25, 25, 0xFF},
+		{52, 52, 0xFF},
+		{20, 100, 0xFF},
+	};
+	fsk_symbol_state_t st;
+	lfrfid_evt_t half;
+	uint8_t i, symbol;
+	bool ready;
+
+	for (i=0; i<sizeof(periods)/sizeof(periods[0]); i++)
+	{
+		fsk_symbol_state_init(&st);
+		half.t_us = periods[i].first_us;
+		half.edge = 1;
+		HOST_CHECK(!fsk_symbol_feed(&st, &half, &symbol));
+		half.t_us = periods[i].second_us;
+		half.edge = 0;
+		symbol = 0xFF;
+		ready = fsk_symbol_feed(&st, &half, &symbol);
+		if ( periods[i].symbol==0xFF )
+		{
+			HOST_CHECK(!ready);
+		}
+		else
+		{
+			HOST_CHECK(ready);
+			HOST_CHECK_EQ(symbol, periods[i].symbol);
+		}
+	} // for (i=0; i<sizeof(periods)/sizeof(periods[0]); i++)
+
+	// Two halves of the same level are not a period
+	fsk_symbol_state_init(&st);
+	half.t_us = 32;
+	half.edge = 1;
+	HOST_CHECK(!fsk_symbol_feed(&st, &half, &symbol));
+	HOST_CHECK(!fsk_symbol_feed(&st, &half, &symbol));
+} // static void test_fsk_symbols(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Five periods of RF/10 make a 1, six of RF/8 a 0
+  */
+/*============================================================================*/
+static void test_fsk_bits(void)
+{
+	fsk_bit_state_t st;
+	uint8_t i, bit;
+
+	fsk_bit_state_init(&st);
+	for (i=0; i<4; i++)
+		HOST_CHECK(!fsk_bit_feed(&st, 1, &bit));
+	HOST_CHECK(fsk_bit_feed(&st, 1, &bit));
+	HOST_CHECK_EQ(bit, 1);
+
+	for (i=0; i<5; i++)
+		HOST_CHECK(!fsk_bit_feed(&st, 0, &bit));
+	HOST_CHECK(fsk_bit_feed(&st, 0, &bit));
+	HOST_CHECK_EQ(bit, 0);
+
+	// One RF/8 period among the RF/10 ones still makes a 1
+	HOST_CHECK(!fsk_bit_feed(&st, 1, &bit));
+	HOST_CHECK(!fsk_bit_feed(&st, 0, &bit));
+	HOST_CHECK(!fsk_bit_feed(&st, 1, &bit));
+	HOST_CHECK(!fsk_bit_feed(&st, 1, &bit));
+	HOST_CHECK(fsk_bit_feed(&st, 1, &bit));
+	HOST_CHECK_EQ(bit, 1);
+} // static void test_fsk_bits(void)
+
+
+
+int main(void)
+{
+	lfrfid_encoded_data.data = malloc(sizeof(Encoded_Data_t)*ENCODED_DATA_MAX);
+	if ( lfrfid_encoded_data.data==NULL )
+		return 1;
+
+	test_routing();
+	test_chunking();
+	test_manchester_limits();
+	test_fsk_symbols();
+	test_fsk_bits();
+
+	free(lfrfid_encoded_data.data);
+
+	return host_test_result("lfrfid_demod_test");
+} // int main(void)
@@ -0,0 +1,257 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  lfrfid_emul_test.c
+*
+*  Emulation DMA tables of lfrfid_emul_dma_build(), played through a model
+*  of TIM5 and its two DMA channels: step 0 in the ARR shadow register and
+*  step 1 in the preload register at the start, then one arr[] and one
+*  bsrr[] transfer per step. The GPIO writes must be exactly the encoder
+*  steps apart, the levels must have the lengths of the protocol and the
+*  decoders must read the output back as the same tag.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "lfrfid.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_LOOPS					4 // Loops of the tables played
+#define TEST_EVENTS_MAX				(TEST_LOOPS*ENCODED_DATA_MAX)
+#define TEST_H10301_HALF_ONE_US		40
+#define TEST_H10301_HALF_ZERO_US	32
+
+//************************** S T R U C T U R E S *******************************
+
+typedef struct
+{
+	uint8_t protocol;
+	uint16_t bitrate; // RF/n of the EM4100 encoder
+	uint8_t uid[5];
+} S_Test_Tag_t;
+
+typedef struct
+{
+	uint32_t steps;
+	uint32_t step_errors; // GPIO writes not one encoder step apart
+	uint32_t level_errors; // Levels the protocol does not send
+	uint32_t events;
+} S_Test_Play_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+static const S_Test_Tag_t test_tags[] =
+{
+	{LFRFIDProtocolEM4100, 64, {0x01, 0x02, 0x03, 0x04, 0x05}},
+	{LFRFIDProtocolEM4100_32, 32, {0xA1, 0xB2, 0xC3, 0xD4, 0xE5}},
+	{LFRFIDProtocolEM4100_16, 16, {0x00, 0xFF, 0x00, 0xFF, 0x00}},
+	{LFRFIDProtocolH10301, 0, {0x7B, 0x30, 0x39}},
+};
+
+static lfrfid_evt_t test_evts[TEST_EVENTS_MAX];
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+static bool test_encode(const S_Test_Tag_t *ptag);
+static bool test_level_valid(const S_Test_Tag_t *ptag, uint32_t level_us);
+static void test_play(const S_Test_Tag_t *ptag, const lfrfid_emul_dma_t *pdma, S_Test_Play_t *pplay);
+static void test_tag(const S_Test_Tag_t *ptag);
+static void test_build_errors(void);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static bool test_encode(const S_Test_Tag_t *ptag)
+{
+	memset(&lfrfid_tag_info, 0, sizeof(lfrfid_tag_info));
+	memcpy(lfrfid_tag_info.uid, ptag->uid, sizeof(ptag->uid));
+	lfrfid_tag_info.protocol = ptag->protocol;
+	lfrfid_tag_info.bitrate = ptag->bitrate;
+	lfrfid_encoded_data.length = 0;
+
+	return lfrfid_encoder_begin(ptag->protocol, &lfrfid_tag_info) && lfrfid_encoded_data.length;
+} // static bool test_encode(const S_Test_Tag_t *ptag)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Checks the length of an emulated level against the protocol:
+  *         a half bit or a full bit of one level for EM4100, a half period
+  *         of RF/8 or RF/10 for H10301
+  */
+/*============================================================================*/
+static bool test_level_valid(const S_Test_Tag_t *ptag, uint32_t level_us)
+{
+	if ( ptag->protocol==LFRFIDProtocolH10301 )
+		return ( level_us==TEST_H10301_HALF_ONE_US || level_us==TEST_H10301_HALF_ZERO_US );
+
+	return ( level_us==ptag->bitrate*4U || level_us==ptag->bitrate*8U );
+} // static bool test_level_valid(const S_Test_Tag_t *ptag, uint32_t level_us)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Plays TEST_LOOPS loops of the tables. On every update event the
+  *         shadow register takes the preload and DMA writes the next
+  *         preload; LFRFID_EMUL_DMA_CC_DELAY later compare 3 writes BSRR.
+  *         The output levels go to test_evts[] as capture events.
+  */
+/*============================================================================*/
+static void test_play(const S_Test_Tag_t *ptag, const lfrfid_emul_dma_t *pdma, S_Test_Play_t *pplay)
+{
+	uint32_t shadow, preload, t_us, write_us, level_start_us, step;
+	uint16_t count, ia, ib;
+	uint8_t level, next_level;
+
+	memset(pplay, 0, sizeof(S_Test_Play_t));
+	count = pdma->count;
+
+	// lfrfid_emul_hw_init() loads steps 0 and 1 and sets the output low
+	shadow = pdma->arr[count - 2];
+	preload = pdma->arr[count - 1];
+	ia = ib = 0;
+	t_us = 0;
+	level = 0;
+	level_start_us = LFRFID_EMUL_DMA_CC_DELAY;
+	write_us = 0;
+	for (step=0; step<TEST_LOOPS*(uint32_t)count; step++)
+	{
+		// Compare 3: GPIO write
+		if ( step && (t_us + LFRFID_EMUL_DMA_CC_DELAY - write_us)!=lfrfid_encoded_data.data[(step - 1) % count].time_us )
+			pplay->step_errors++;
+		write_us = t_us + LFRFID_EMUL_DMA_CC_DELAY;
+		next_level = level;
+		if ( pdma->bsrr[ib] & RFID_PULL_Pin )
+			next_level = 1;
+		else if ( pdma->bsrr[ib] & (RFID_PULL_Pin << 16) )
+			next_level = 0;
+		ib = (ib + 1) % count;
+
+		if ( next_level!=level )
+		{
+			// The first level depends on the start, not on the tag
+			if ( pplay->events && !test_level_valid(ptag, write_us - level_start_us) )
+				pplay->level_errors++;
+			if ( pplay->events < TEST_EVENTS_MAX )
+			{
+				test_evts[pplay->events].t_us = (uint16_t)(write_us - level_start_us);
+				test_evts[pplay->events].edge = next_level;
+				pplay->events++;
+			}
+			level = next_level;
+			level_start_us = write_us;
+		} // if ( next_level!=level )
+
+		// Update event
+		t_us += shadow + 1;
+		shadow = preload;
+		preload = pdma->arr[ia];
+		ia = (ia + 1) % count;
+		pplay->steps++;
+	} // for (step=0; step<TEST_LOOPS*(uint32_t)count; step++)
+} // static void test_play(const S_Test_Tag_t *ptag, const lfrfid_emul_dma_t *pdma, S_Test_Play_t *pplay)
+
+
+
+static void test_tag(const S_Test_Tag_t *ptag)
+{
+	lfrfid_emul_dma_t dma;
+	S_Test_Play_t play;
+	uint8_t protocol;
+
+	HOST_CHECK(test_encode(ptag));
+	HOST_CHECK_EQ(lfrfid_emul_dma_build(&lfrfid_encoded_data, &dma), 0);
+	if ( dma.count==0 )
+		return;
+	HOST_CHECK_EQ(dma.count, lfrfid_encoded_data.length);
+
+	test_play(ptag, &dma, &play);
+	HOST_CHECK_EQ(play.steps, TEST_LOOPS*(uint32_t)dma.count);
+	HOST_CHECK_EQ(play.step_errors, 0);
+	HOST_CHECK_EQ(play.level_errors, 0);
+	HOST_CHECK(play.events > 1);
+
+	// The first event is the start of the output, not an edge of the tag
+	lfrfid_decoder_begin();
+	memset(lfrfid_tag_info.uid, 0, sizeof(lfrfid_tag_info.uid));
+	protocol = LFRFIDProtocolMax;
+	for (uint32_t i=1; i<play.events && protocol==LFRFIDProtocolMax; i+=LFR_BATCH_ITEMS)
+		protocol = lfrfid_demod_execute(&test_evts[i], (play.events - i < LFR_BATCH_ITEMS) ? (play.events - i):LFR_BATCH_ITEMS);
+	HOST_CHECK_EQ(protocol, ptag->protocol);
+	HOST_CHECK(!memcmp(lfrfid_tag_info.uid, ptag->uid, protocol_get_data_size(ptag->protocol)));
+
+	lfrfid_emul_dma_free(&dma);
+	HOST_CHECK(dma.bsrr==NULL && dma.arr==NULL && dma.count==0);
+} // static void test_tag(const S_Test_Tag_t *ptag)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Steps the tables cannot play are refused, with no tables left
+  */
+/*============================================================================*/
+static void test_build_errors(void)
+{
+	EncodedTx_Data_t enc;
+	lfrfid_emul_dma_t dma;
+	Encoded_Data_t steps[3];
+
+	memset(&enc, 0, sizeof(enc));
+	HOST_CHECK_EQ(lfrfid_emul_dma_build(&enc, &dma), 1);
+
+	steps[0].bsrr = RFID_PULL_Pin;
+	steps[0].time_us = 256;
+	steps[1].bsrr = RFID_PULL_Pin << 16;
+	steps[1].time_us = 256;
+	steps[2].bsrr = RFID_PULL_Pin;
+	steps[2].time_us = LFRFID_EMUL_STEP_MIN_US - 1;
+	enc.data = steps;
+	enc.length = 1;
+	HOST_CHECK_EQ(lfrfid_emul_dma_build(&enc, &dma), 1);
+	HOST_CHECK(dma.bsrr==NULL && dma.arr==NULL && dma.count==0);
+
+	enc.length = 3;
+	HOST_CHECK_EQ(lfrfid_emul_dma_build(&enc, &dma), 2);
+	HOST_CHECK(dma.bsrr==NULL && dma.arr==NULL && dma.count==0);
+
+	// Two steps are enough, each reloads the other one
+	enc.length = 2;
+	HOST_CHECK_EQ(lfrfid_emul_dma_build(&enc, &dma), 0);
+	HOST_CHECK_EQ(dma.count, 2);
+	HOST_CHECK_EQ(dma.arr[0], steps[0].time_us - 1);
+	HOST_CHECK_EQ(dma.arr[1], steps[1].time_us - 1);
+	lfrfid_emul_dma_free(&dma);
+} // static void test_build_errors(void)
+
+
+
+int main(void)
+{
+	uint8_t t;
+
+	lfrfid_encoded_data.data = malloc(sizeof(Encoded_Data_t)*ENCODED_DATA_MAX);
+	if ( lfrfid_encoded_data.data==NULL )
+		return 1;
+
+	for (t=0; t<sizeof(test_tags)/sizeof(test_tags[0]); t++)
+		test_tag(&test_tags[t]);
+	free(lfrfid_encoded_data.data);
+	lfrfid_encoded_data.data = NULL;
+
+	test_build_errors();
+
+	return host_test_result("lfrfid_emul_test");
+} // int main(void)
@@ -0,0 +1,709 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  lfrfid_replay.c
+*
+*  Feeds LF RFID capture events through the protocol decoders, in the
+*  batches lfrfid_rxThread() takes from the stream buffer, and reports the
+*  read success and the decode time per batch. The events come from edge
+*  stream files or from synthetic tags with timing errors.
+*
+*  lfrfid_replay [options] file...
+*  lfrfid_replay --generate protocol:data|noise [options]
+*
+*  --expect       every read must be this protocol and data, e.g. EM4100:0102030405
+*  --min-reads    fails if fewer reads than this, for files
+*  --max-reads    fails if more reads than this, for noise
+*  --min-rate     fails if fewer generated tags than this percentage are read
+*  --repeat       replays of the events for the time per batch
+*
+*  --generate     tag of the synthetic events, the random phase and errors
+*                 change from trial to trial; noise is random levels
+*  --trials       tags generated, each read by restarted decoders
+*  --frames       tag frames sent in a trial
+*  --jitter       edges move by up to +/- this many us
+*  --noise        chance of a glitch pulse within a level, per mille
+*  --glitch       longest glitch pulse, us
+*  --seed         first seed of the generator
+*  --save         writes the generated events to an edge stream file
+*
+*  Edge stream file (.lfe), little endian:
+*   - S_Replay_File_Header_t
+*   - lfrfid_evt_t records as the TIM5 capture interrupt queues them: t_us
+*     is the time since the previous edge, edge the input level after it
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <time.h>
+#include "main.h"
+#include "lfrfid.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define REPLAY_FILE_MAGIC			0x4546524CU // "LRFE"
+#define REPLAY_FILE_VERSION			1
+
+#define REPLAY_REPEAT_DEFAULT		10
+#define REPLAY_TRIALS_DEFAULT		100
+#define REPLAY_FRAMES_DEFAULT		3
+#define REPLAY_GLITCH_US_DEFAULT	20
+#define REPLAY_NOISE_EVENTS			20000
+
+// Capture filter of rfid_read_handler()
+#define REPLAY_CAPTURE_MIN_US		7
+#define REPLAY_CAPTURE_MAX_US		1000
+
+#define REPLAY_EM4100_FRAME_BITS	64
+
+// Header of the H10301 frame, as sent by protocol_h10301_encoder_begin()
+#define REPLAY_H10301_FRAME_BITS	96
+#define REPLAY_H10301_PREAMBLE		0x1D
+#define REPLAY_H10301_COMPANY		0x1556
+#define REPLAY_H10301_CARD_FORMAT	0x155556
+#define REPLAY_H10301_HALF_ONE_US	40 // 5 periods of 80us per bit 1
+#define REPLAY_H10301_HALF_ZERO_US	32 // 6 periods of 64us per bit 0
+
+#define REPLAY_PROTOCOL_NOISE		LFRFIDProtocolMax
+
+//************************** S T R U C T U R E S *******************************
+
+typedef struct
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t item_size; // sizeof(lfrfid_evt_t)
+	uint32_t count; // Number of records
+	uint32_t reserved;
+} S_Replay_File_Header_t;
+
+typedef struct
+{
+	lfrfid_evt_t *evts;
+	uint32_t count;
+	uint32_t size;
+} S_Replay_Events_t;
+
+typedef struct
+{
+	uint16_t jitter_us;
+	uint16_t noise_permille;
+	uint16_t glitch_us_max;
+	uint8_t frames;
+} S_Replay_Gen_Cfg_t;
+
+typedef struct
+{
+	const S_Replay_Gen_Cfg_t *cfg;
+	S_Replay_Events_t *pevents;
+	uint8_t level; // Input level
+	uint32_t level_us; // Time since the last edge seen by the capture timer
+	int16_t jitter_us; // Offset of the last edge
+	uint32_t rng;
+} S_Replay_Gen_t;
+
+typedef struct
+{
+	uint32_t events;
+	uint64_t air_us;
+	uint32_t trials;
+	uint32_t reads;
+	uint32_t wrong;
+	uint64_t latency_us; // Air time until the read, summed over the read trials
+	uint32_t batches; // Timed replays only
+	uint64_t ns_total;
+	uint32_t ns_max;
+} S_Replay_Result_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+static bool replay_expect_set;
+static uint8_t replay_expect_protocol;
+static uint8_t replay_expect_data[EM4100_DECODED_DATA_SIZE];
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+static uint64_t replay_now_ns(void);
+static uint32_t replay_rand(uint32_t *state);
+static uint8_t replay_events_add(S_Replay_Events_t *pevents, uint16_t t_us, uint8_t edge);
+static uint8_t replay_parse_tag(const char *ptag, uint8_t *pprotocol, uint8_t *pdata);
+static void replay_gen_edge(S_Replay_Gen_t *pgen, uint8_t level);
+static void replay_gen_level(S_Replay_Gen_t *pgen, uint8_t level, uint16_t duration_us);
+static void replay_gen_em4100(S_Replay_Gen_t *pgen, const uint8_t *data, uint16_t half_bit_us);
+static void replay_gen_h10301(S_Replay_Gen_t *pgen, const uint8_t *data);
+static void replay_generate(uint8_t protocol, const uint8_t *data, const S_Replay_Gen_Cfg_t *cfg, uint32_t seed,
+		S_Replay_Events_t *pevents);
+static uint8_t replay_load(const char *filename, S_Replay_Events_t *pevents);
+static uint8_t replay_save(const char *filename, const S_Replay_Events_t *pevents);
+static bool replay_check_read(uint8_t protocol, uint32_t event);
+static uint32_t replay_feed(const lfrfid_evt_t *evts, uint32_t count, bool first_read, S_Replay_Result_t *presult);
+static void replay_time(const S_Replay_Events_t *pevents, uint32_t repeat, S_Replay_Result_t *presult);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static uint64_t replay_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+} // static uint64_t replay_now_ns(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  xorshift32, so that a seed gives the same events on every host
+  */
+/*============================================================================*/
+static uint32_t replay_rand(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+
+	return x;
+} // static uint32_t replay_rand(uint32_t *state)
+
+
+
+static uint8_t replay_events_add(S_Replay_Events_t *pevents, uint16_t t_us, uint8_t edge)
+{
+	lfrfid_evt_t *pnew;
+
+	if ( pevents->count==pevents->size )
+	{
+		pevents->size = pevents->size ? pevents->size*2:4096;
+		pnew = realloc(pevents->evts, pevents->size*sizeof(lfrfid_evt_t));
+		if ( pnew==NULL )
+			return 1;
+		pevents->evts = pnew;
+	}
+	pevents->evts[pevents->count].t_us = t_us;
+	pevents->evts[pevents->count].edge = edge;
+	pevents->count++;
+
+	return 0;
+} // static uint8_t replay_events_add(S_Replay_Events_t *pevents, uint16_t t_us, uint8_t edge)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Reads "protocol:data", the protocol by its name and the data as
+  *         protocol_get_data_size() bytes in hex, or "noise"
+  */
+/*============================================================================*/
+static uint8_t replay_parse_tag(const char *ptag, uint8_t *pprotocol, uint8_t *pdata)
+{
+	const char *pdata_hex;
+	char hex_byte[3] = {0};
+	uint8_t protocol, i;
+
+	if ( !strcasecmp(ptag, "noise") )
+	{
+		*pprotocol = REPLAY_PROTOCOL_NOISE;
+		return 0;
+	}
+
+	pdata_hex = strrchr(ptag, ':');
+	if ( pdata_hex==NULL )
+		return 1;
+	for (protocol=0; protocol<LFRFIDProtocolMax; protocol++)
+	{
+		if ( strlen(protocol_get_name(protocol))==(size_t)(pdata_hex - ptag)
+				&& !strncasecmp(ptag, protocol_get_name(protocol), pdata_hex - ptag) )
+			break;
+	}
+	pdata_hex++;
+	if ( protocol==LFRFIDProtocolMax || strlen(pdata_hex)!=2*protocol_get_data_size(protocol) )
+		return 1;
+
+	for (i=0; i<protocol_get_data_size(protocol); i++)
+	{
+		memcpy(hex_byte, &pdata_hex[2*i], 2);
+		pdata[i] = strtoul(hex_byte, NULL, 16);
+	}
+	*pprotocol = protocol;
+
+	return 0;
+} // static uint8_t replay_parse_tag(const char *ptag, uint8_t *pprotocol, uint8_t *pdata)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Changes the input level and queues the event the capture interrupt
+  *         would queue for this edge. Edges out of the capture filter are
+  *         dropped together with the time they took, as on the target.
+  */
+/*============================================================================*/
+static void replay_gen_edge(S_Replay_Gen_t *pgen, uint8_t level)
+{
+	int32_t t_us;
+	int16_t jitter_us = 0;
+
+	if ( pgen->cfg->jitter_us )
+		jitter_us = (int16_t)(replay_rand(&pgen->rng) % (2*pgen->cfg->jitter_us + 1)) - pgen->cfg->jitter_us;
+
+	// Moving an edge lengthens one level and shortens the next one
+	t_us = (int32_t)pgen->level_us + jitter_us - pgen->jitter_us;
+	pgen->jitter_us = jitter_us;
+	pgen->level = level;
+	pgen->level_us = 0;
+
+	// The counter restarts on every edge, also on those dropped by the filter
+	if ( t_us < REPLAY_CAPTURE_MIN_US || t_us > REPLAY_CAPTURE_MAX_US )
+		return;
+	if ( replay_events_add(pgen->pevents, (uint16_t)t_us, level) )
+		abort();
+} // static void replay_gen_edge(S_Replay_Gen_t *pgen, uint8_t level)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Holds the input at a level, possibly with a glitch of the other
+  *         level in the middle of it
+  */
+/*============================================================================*/
+static void replay_gen_level(S_Replay_Gen_t *pgen, uint8_t level, uint16_t duration_us)
+{
+	uint16_t glitch_us, before_us;
+
+	if ( level!=pgen->level )
+		replay_gen_edge(pgen, level);
+
+	if ( pgen->cfg->noise_permille && (replay_rand(&pgen->rng) % 1000) < pgen->cfg->noise_permille )
+	{
+		glitch_us = 2;
+		if ( pgen->cfg->glitch_us_max > 2 )
+			glitch_us += replay_rand(&pgen->rng) % (pgen->cfg->glitch_us_max - 1);
+		if ( glitch_us + 2 < duration_us )
+		{
+			before_us = 1 + replay_rand(&pgen->rng) % (duration_us - glitch_us - 1);
+			pgen->level_us += before_us;
+			replay_gen_edge(pgen, level ^ 1);
+			pgen->level_us += glitch_us;
+			replay_gen_edge(pgen, level);
+			duration_us -= before_us + glitch_us;
+		}
+	} // if ( pgen->cfg->noise_permille && ... )
+
+	pgen->level_us += duration_us;
+} // static void replay_gen_level(S_Replay_Gen_t *pgen, uint8_t level, uint16_t duration_us)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Manchester coded EM4100 frames, bit 1 is high then low. The half
+  *         bit is 256, 128 or 64 us for RF/64, RF/32 and RF/16.
+  */
+/*============================================================================*/
+static void replay_gen_em4100(S_Replay_Gen_t *pgen, const uint8_t *data, uint16_t half_bit_us)
+{
+	uint8_t frame[8];
+	uint32_t i, start;
+	uint8_t bit;
+
+	em4100_build_frame8_from_uid(frame, data, EM4100_DECODED_DATA_SIZE);
+
+	start = replay_rand(&pgen->rng) % REPLAY_EM4100_FRAME_BITS;
+	for (i=start; i<start + pgen->cfg->frames*REPLAY_EM4100_FRAME_BITS; i++)
+	{
+		bit = (frame[(i % REPLAY_EM4100_FRAME_BITS)/8] >> (7 - i%8)) & 1;
+		replay_gen_level(pgen, bit, half_bit_us);
+		replay_gen_level(pgen, bit ^ 1, half_bit_us);
+	}
+	replay_gen_edge(pgen, pgen->level ^ 1); // Ends the last level
+} // static void replay_gen_em4100(S_Replay_Gen_t *pgen, const uint8_t *data, uint16_t half_bit_us)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  FSK coded H10301 frames, RF/8 for 0 and RF/10 for 1. The data is
+  *         the facility code and the card number, high byte first.
+  */
+/*============================================================================*/
+static void replay_gen_h10301(S_Replay_Gen_t *pgen, const uint8_t *data)
+{
+	uint8_t frame[12];
+	uint32_t i, start;
+	uint8_t bit, n;
+	uint16_t half_us;
+
+	uid_bytes_to_h10301_raw96_bytes(data, 3, REPLAY_H10301_PREAMBLE, REPLAY_H10301_COMPANY,
+			REPLAY_H10301_CARD_FORMAT, frame);
+
+	start = replay_rand(&pgen->rng) % REPLAY_H10301_FRAME_BITS;
+	for (i=start; i<start + pgen->cfg->frames*REPLAY_H10301_FRAME_BITS; i++)
+	{
+		bit = (frame[(i % REPLAY_H10301_FRAME_BITS)/8] >> (7 - i%8)) & 1;
+		half_us = bit ? REPLAY_H10301_HALF_ONE_US:REPLAY_H10301_HALF_ZERO_US;
+		for (n=bit ? 5:6; n; n--)
+		{
+			replay_gen_level(pgen, 1, half_us);
+			replay_gen_level(pgen, 0, half_us);
+		}
+	}
+	replay_gen_edge(pgen, pgen->level ^ 1);
+} // static void replay_gen_h10301(S_Replay_Gen_t *pgen, const uint8_t *data)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Appends the capture events of a tag in front of the reader, or of
+  *         random levels within the capture filter
+  */
+/*============================================================================*/
+static void replay_generate(uint8_t protocol, const uint8_t *data, const S_Replay_Gen_Cfg_t *cfg, uint32_t seed,
+		S_Replay_Events_t *pevents)
+{
+	S_Replay_Gen_t gen;
+	uint32_t i;
+
+	memset(&gen, 0, sizeof(gen));
+	gen.cfg = cfg;
+	gen.pevents = pevents;
+	gen.rng = seed ? seed:1;
+
+	switch (protocol)
+	{
+		case LFRFIDProtocolEM4100:
+			replay_gen_em4100(&gen, data, T_256_US);
+			break;
+
+		case LFRFIDProtocolEM4100_32:
+			replay_gen_em4100(&gen, data, T_128_US);
+			break;
+
+		case LFRFIDProtocolEM4100_16:
+			replay_gen_em4100(&gen, data, T_64_US);
+			break;
+
+		case LFRFIDProtocolH10301:
+			replay_gen_h10301(&gen, data);
+			break;
+
+		default:
+			for (i=0; i<REPLAY_NOISE_EVENTS; i++)
+			{
+				if ( replay_events_add(pevents, REPLAY_CAPTURE_MIN_US
+						+ replay_rand(&gen.rng) % (REPLAY_CAPTURE_MAX_US - REPLAY_CAPTURE_MIN_US + 1), i & 1) )
+					abort();
+			}
+			break;
+	} // switch (protocol)
+} // static void replay_generate(...)
+
+
+
+static uint8_t replay_load(const char *filename, S_Replay_Events_t *pevents)
+{
+	S_Replay_File_Header_t hdr;
+	FILE *pfile;
+	uint8_t error;
+
+	pfile = fopen(filename, "rb");
+	if ( pfile==NULL )
+		return 1;
+	error = 1;
+	if ( fread(&hdr, sizeof(hdr), 1, pfile)==1 && hdr.magic==REPLAY_FILE_MAGIC
+			&& hdr.version==REPLAY_FILE_VERSION && hdr.item_size==sizeof(lfrfid_evt_t) )
+	{
+		pevents->evts = malloc(((size_t)hdr.count + 1)*sizeof(lfrfid_evt_t));
+		pevents->size = hdr.count + 1;
+		if ( pevents->evts && fread(pevents->evts, sizeof(lfrfid_evt_t), hdr.count, pfile)==hdr.count )
+		{
+			pevents->count = hdr.count;
+			error = 0;
+		}
+	}
+	fclose(pfile);
+
+	return error;
+} // static uint8_t replay_load(const char *filename, S_Replay_Events_t *pevents)
+
+
+
+static uint8_t replay_save(const char *filename, const S_Replay_Events_t *pevents)
+{
+	S_Replay_File_Header_t hdr;
+	FILE *pfile;
+	uint8_t error;
+
+	pfile = fopen(filename, "wb");
+	if ( pfile==NULL )
+		return 1;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = REPLAY_FILE_MAGIC;
+	hdr.version = REPLAY_FILE_VERSION;
+	hdr.item_size = sizeof(lfrfid_evt_t);
+	hdr.count = pevents->count;
+	error = 0;
+	if ( fwrite(&hdr, sizeof(hdr), 1, pfile)!=1 )
+		error = 1;
+	else if ( fwrite(pevents->evts, sizeof(lfrfid_evt_t), pevents->count, pfile)!=pevents->count )
+		error = 1;
+	if ( fclose(pfile) )
+		error = 1;
+
+	return error;
+} // static uint8_t replay_save(const char *filename, const S_Replay_Events_t *pevents)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Compares a read with --expect, the decoders leave the data in
+  *         lfrfid_tag_info
+  */
+/*============================================================================*/
+static bool replay_check_read(uint8_t protocol, uint32_t event)
+{
+	char szdata[2*EM4100_DECODED_DATA_SIZE + 1];
+	uint8_t i;
+
+	if ( !replay_expect_set )
+		return true;
+	if ( protocol==replay_expect_protocol
+			&& !memcmp(lfrfid_tag_info.uid, replay_expect_data, protocol_get_data_size(protocol)) )
+		return true;
+
+	for (i=0; i<protocol_get_data_size(protocol); i++)
+		sprintf(&szdata[2*i], "%02X", lfrfid_tag_info.uid[i]);
+	fprintf(stderr, "Unexpected read %s:%s at event %u\n", protocol_get_name(protocol), szdata, event);
+
+	return false;
+} // static bool replay_check_read(uint8_t protocol, uint32_t event)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Passes events to lfrfid_demod_execute() in the batches of
+  *         lfrfid_rxThread(). The rest of a batch is dropped after a read,
+  *         then the decoders restart for the next one.
+  * @param  first_read stops at the first read, for a generated tag
+  * @retval event after the first read, count if none
+  */
+/*============================================================================*/
+static uint32_t replay_feed(const lfrfid_evt_t *evts, uint32_t count, bool first_read, S_Replay_Result_t *presult)
+{
+	uint64_t air_us;
+	uint32_t i, k, n;
+	uint8_t protocol;
+
+	lfrfid_decoder_begin();
+	air_us = 0;
+	for (i=0; i<count; i+=n)
+	{
+		n = (count - i < LFR_BATCH_ITEMS) ? (count - i):LFR_BATCH_ITEMS;
+		for (k=i; k<i + n; k++)
+			air_us += evts[k].t_us;
+		presult->events += n;
+
+		memset(lfrfid_tag_info.uid, 0, sizeof(lfrfid_tag_info.uid));
+		protocol = lfrfid_demod_execute(&evts[i], n);
+		if ( protocol==LFRFIDProtocolMax )
+			continue;
+
+		if ( replay_check_read(protocol, i) )
+		{
+			presult->reads++;
+			presult->latency_us += air_us;
+		}
+		else
+		{
+			presult->wrong++;
+		}
+		if ( first_read )
+		{
+			i += n;
+			break;
+		}
+		lfrfid_decoder_begin();
+		presult->air_us += air_us;
+		air_us = 0;
+	} // for (i=0; i<count; i+=n)
+	presult->air_us += air_us;
+
+	return i;
+} // static uint32_t replay_feed(const lfrfid_evt_t *evts, uint32_t count, bool first_read, S_Replay_Result_t *presult)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Replays the events for the time per batch, reads included
+  */
+/*============================================================================*/
+static void replay_time(const S_Replay_Events_t *pevents, uint32_t repeat, S_Replay_Result_t *presult)
+{
+	uint64_t t_start;
+	uint32_t i, n, ns;
+
+	while ( repeat-- )
+	{
+		lfrfid_decoder_begin();
+		for (i=0; i<pevents->count; i+=n)
+		{
+			n = (pevents->count - i < LFR_BATCH_ITEMS) ? (pevents->count - i):LFR_BATCH_ITEMS;
+			t_start = replay_now_ns();
+			if ( lfrfid_demod_execute(&pevents->evts[i], n)!=LFRFIDProtocolMax )
+				lfrfid_decoder_begin();
+			ns = replay_now_ns() - t_start;
+			presult->ns_total += ns;
+			if ( ns > presult->ns_max )
+				presult->ns_max = ns;
+			presult->batches++;
+		}
+	} // while ( repeat-- )
+} // static void replay_time(const S_Replay_Events_t *pevents, uint32_t repeat, S_Replay_Result_t *presult)
+
+
+
+int main(int argc, char *argv[])
+{
+	S_Replay_Events_t events, trial;
+	S_Replay_Result_t result;
+	S_Replay_Gen_Cfg_t gen_cfg;
+	const char *psave;
+	uint8_t gen_data[EM4100_DECODED_DATA_SIZE];
+	uint8_t gen_protocol;
+	bool generate;
+	uint32_t repeat, min_rate, min_reads, max_reads, trials, seed, rate, n;
+	int i;
+
+	repeat = REPLAY_REPEAT_DEFAULT;
+	min_rate = 0;
+	min_reads = 0;
+	max_reads = UINT32_MAX;
+	trials = REPLAY_TRIALS_DEFAULT;
+	seed = 1;
+	psave = NULL;
+	generate = false;
+	gen_protocol = REPLAY_PROTOCOL_NOISE;
+	memset(&gen_cfg, 0, sizeof(gen_cfg));
+	gen_cfg.frames = REPLAY_FRAMES_DEFAULT;
+	gen_cfg.glitch_us_max = REPLAY_GLITCH_US_DEFAULT;
+	memset(&events, 0, sizeof(events));
+	memset(&result, 0, sizeof(result));
+	for (i=1; i<argc; i++)
+	{
+		if ( !strcmp(argv[i], "--expect") && (i + 1) < argc )
+		{
+			if ( replay_parse_tag(argv[++i], &replay_expect_protocol, replay_expect_data)
+					|| replay_expect_protocol==REPLAY_PROTOCOL_NOISE )
+			{
+				fprintf(stderr, "%s: not a tag\n", argv[i]);
+				return 2;
+			}
+			replay_expect_set = true;
+		}
+		else if ( !strcmp(argv[i], "--generate") && (i + 1) < argc )
+		{
+			if ( replay_parse_tag(argv[++i], &gen_protocol, gen_data) )
+			{
+				fprintf(stderr, "%s: not a tag\n", argv[i]);
+				return 2;
+			}
+			generate = true;
+		}
+		else if ( !strcmp(argv[i], "--min-rate") && (i + 1) < argc )
+			min_rate = strtoul(argv[++i], NULL, 0);
+		else if ( !strcmp(argv[i], "--min-reads") && (i + 1) < argc )
+			min_reads = strtoul(argv[++i], NULL, 0);
+		else if ( !strcmp(argv[i], "--max-reads") && (i + 1) < argc )
+			max_reads = strtoul(argv[++i], NULL, 0);
+		else if ( !strcmp(argv[i], "--repeat") && (i + 1) < argc )
+			repeat = strtoul(argv[++i], NULL, 0);
+		else if ( !strcmp(argv[i], "--trials") && (i + 1) < argc )
+			trials = strtoul(argv[++i], NULL, 0);
+		else if ( !strcmp(argv[i], "--frames") && (i + 1) < argc )
+			gen_cfg.frames = strtoul(argv[++i], NULL, 0);
+		else if ( !strcmp(argv[i], "--jitter") && (i + 1) < argc )
+			gen_cfg.jitter_us = strtoul(argv[++i], NULL, 0);
+		else if ( !strcmp(argv[i], "--noise") && (i + 1) < argc )
+			gen_cfg.noise_permille = strtoul(argv[++i], NULL, 0);
+		else if ( !strcmp(argv[i], "--glitch") && (i + 1) < argc )
+			gen_cfg.glitch_us_max = strtoul(argv[++i], NULL, 0);
+		else if ( !strcmp(argv[i], "--seed") && (i + 1) < argc )
+			seed = strtoul(argv[++i], NULL, 0);
+		else if ( !strcmp(argv[i], "--save") && (i + 1) < argc )
+			psave = argv[++i];
+		else
+		{
+			memset(&trial, 0, sizeof(trial));
+			if ( replay_load(argv[i], &trial) )
+			{
+				fprintf(stderr, "%s: not an edge stream file\n", argv[i]);
+				return 2;
+			}
+			replay_feed(trial.evts, trial.count, false, &result);
+			for (n=0; n<trial.count; n++)
+				replay_events_add(&events, trial.evts[n].t_us, trial.evts[n].edge);
+			free(trial.evts);
+		}
+	} // for (i=1; i<argc; i++)
+
+	if ( generate )
+	{
+		// Every trial is a tag coming into the field with other errors
+		if ( gen_protocol==REPLAY_PROTOCOL_NOISE )
+			trials = 1;
+		for (n=0; n<trials; n++)
+		{
+			memset(&trial, 0, sizeof(trial));
+			replay_generate(gen_protocol, gen_data, &gen_cfg, replay_rand(&seed), &trial);
+			replay_feed(trial.evts, trial.count, gen_protocol!=REPLAY_PROTOCOL_NOISE, &result);
+			result.trials++;
+			for (i=0; (uint32_t)i<trial.count; i++)
+				replay_events_add(&events, trial.evts[i].t_us, trial.evts[i].edge);
+			free(trial.evts);
+		}
+		if ( psave && replay_save(psave, &events) )
+		{
+			fprintf(stderr, "%s: cannot write the events\n", psave);
+			return 2;
+		}
+	} // if ( generate )
+
+	if ( !events.count )
+	{
+		fprintf(stderr, "No events\n");
+		return 2;
+	}
+	replay_time(&events, repeat, &result);
+
+	rate = (generate && gen_protocol!=REPLAY_PROTOCOL_NOISE) ? result.reads*100/result.trials:100;
+	printf("Events: %u (%" PRIu64 "ms) Reads: %u Wrong: %u", result.events, result.air_us/1000, result.reads, result.wrong);
+	if ( generate && gen_protocol!=REPLAY_PROTOCOL_NOISE )
+		printf(" Tags: %u (%u%% read)", result.trials, rate);
+	printf("\n");
+	printf("Time to read: %" PRIu64 "ms avg\n", result.reads ? result.latency_us/result.reads/1000:0);
+	printf("Time per batch of %u events: %" PRIu64 "ns avg, %uns max\n", LFR_BATCH_ITEMS,
+			result.batches ? result.ns_total/result.batches:0, result.ns_max);
+	free(events.evts);
+
+	if ( result.wrong || rate < min_rate || result.reads < min_reads || result.reads > max_reads )
+		return 1;
+
+	return 0;
+} // int main(int argc, char *argv[])
@@ -0,0 +1,467 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  msc_scsi_test.c
+*
+*  SCSI command streams through the USB MSC class, from the bulk transfers
+*  of the host to the SD card model: SD commands of sequential writes and
+*  reads, random commands against a reference image, write behind blocks
+*  kept when the card rejects them, and the USB interrupt served while the
+*  card transfers.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "main.h"
+#include "usbd_core.h"
+#include "usbd_desc.h"
+#include "usbd_msc.h"
+#include "usbd_msc_bot.h"
+#include "usbd_msc_scsi.h"
+#include "usbd_msc_storage.h"
+#include "usbd_composite_builder.h"
+#include "m1_sdcard.h"
+#include "host_port.h"
+#include "host_sd.h"
+#include "host_usb.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_CARD_BLOCKS			(32*1024) // 16 MB
+#define TEST_BLOCK_SIZE				512
+#define TEST_CACHE_BLOCKS			64 // MSC_CACHE_BLOCKS of usbd_msc_storage.c
+#define TEST_WRITE_RETRIES			3 // MSC_SD_WRITE_RETRIES
+#define TEST_SEQ_BLOCKS				(8*1024) // 4 MB
+#define TEST_SEQ_CMD_BLOCKS			128
+#define TEST_RANDOM_OPS				3000
+#define TEST_RANDOM_BLOCKS			(4*1024) // Area of the random commands
+#define TEST_TIMEOUT_MS				5000
+#define TEST_SLOW_COMMAND_US		20000 // Card time of a command in test_irq_latency()
+#define TEST_IRQ_LATENCY_MAX_US		5000
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+extern S_M1_SDCard_Hdl sdcard_ctl;
+
+uint8_t MSC_EpAdd_Inst[2] = {MSC_IN_EP, MSC_OUT_EP};
+
+static uint8_t test_ref[TEST_CARD_BLOCKS*TEST_BLOCK_SIZE]; // What the host wrote
+static uint8_t test_buf[TEST_SEQ_CMD_BLOCKS*TEST_BLOCK_SIZE];
+static uint32_t test_tag;
+static uint32_t test_rand_state = 0x1D872B41;
+static volatile bool test_writer_done;
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static uint32_t test_rand(void)
+{
+	test_rand_state ^= test_rand_state << 13;
+	test_rand_state ^= test_rand_state >> 17;
+	test_rand_state ^= test_rand_state << 5;
+	return test_rand_state;
+} // static uint32_t test_rand(void)
+
+
+
+static void test_fill(uint8_t *buf, uint32_t lba, uint32_t blocks)
+{
+	uint32_t i, seed;
+
+	seed = test_rand();
+	for (i=0; i<blocks*TEST_BLOCK_SIZE; i++)
+		buf[i] = (uint8_t)(seed + (lba + i/TEST_BLOCK_SIZE)*7 + i*13);
+} // static void test_fill(uint8_t *buf, uint32_t lba, uint32_t blocks)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Starts the device as MX_USB_PCD_Init() does with the MSC class
+  *         alone, and enumerates it
+  */
+/*============================================================================*/
+static void test_device_start(void)
+{
+	static const uint8_t set_address[8] = {0x00, 0x05, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00};
+	static const uint8_t set_config[8] = {0x00, 0x09, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00};
+	static const uint8_t get_max_lun[8] = {0xA1, BOT_GET_MAX_LUN, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00};
+	uint8_t max_lun = 0xFF;
+
+	host_usb_init();
+	STORAGE_TaskInit();
+	HOST_CHECK(USBD_Init(&hUsbDeviceFS, &Class_Desc, 0)==USBD_OK);
+	HOST_CHECK(USBD_RegisterClassComposite(&hUsbDeviceFS, USBD_MSC_CLASS, CLASS_TYPE_MSC, MSC_EpAdd_Inst)==USBD_OK);
+	HOST_CHECK(USBD_CMPSIT_SetClassID(&hUsbDeviceFS, CLASS_TYPE_MSC, 0)!=0xFF);
+	USBD_MSC_RegisterStorage(&hUsbDeviceFS, &USBD_MSC_Interface_fops);
+	HOST_CHECK(USBD_Start(&hUsbDeviceFS)==USBD_OK);
+	hpcd_USB_DRD_FS.pData = &hUsbDeviceFS;
+
+	host_usb_reset();
+	HOST_CHECK_EQ(host_usb_control(set_address, NULL, 0), 0);
+	HOST_CHECK_EQ(host_usb_control(set_config, NULL, 0), 0);
+	HOST_CHECK_EQ(host_usb_control(get_max_lun, &max_lun, 1), 1);
+	HOST_CHECK_EQ(max_lun, 0);
+} // static void test_device_start(void)
+
+
+
+// CLEAR_FEATURE(ENDPOINT_HALT), after which the device sends the CSW of a failed command
+static bool test_clear_halt(uint8_t ep_addr)
+{
+	uint8_t setup[8] = {0x02, 0x01, 0x00, 0x00, ep_addr, 0x00, 0x00, 0x00};
+
+	return host_usb_control(setup, NULL, 0)==0;
+} // static bool test_clear_halt(uint8_t ep_addr)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Runs one SCSI command: CBW, data stage, CSW. A stalled stage
+  *         is cleared as the host does before it reads the CSW.
+  * @retval CSW status, -1 on a transport error
+  */
+/*============================================================================*/
+static int test_scsi(const uint8_t *cb, uint8_t cb_len, bool in, uint8_t *data, uint32_t len)
+{
+	USBD_MSC_BOT_CBWTypeDef cbw;
+	USBD_MSC_BOT_CSWTypeDef csw;
+	int32_t n;
+
+	memset(&cbw, 0, sizeof(cbw));
+	cbw.dSignature = USBD_BOT_CBW_SIGNATURE;
+	cbw.dTag = ++test_tag;
+	cbw.dDataLength = len;
+	cbw.bmFlags = in ? 0x80:0x00;
+	cbw.bCBLength = cb_len;
+	memcpy(cbw.CB, cb, cb_len);
+	if ( host_usb_bulk_out(MSC_OUT_EP, (const uint8_t *)&cbw, USBD_BOT_CBW_LENGTH, TEST_TIMEOUT_MS)!=USBD_BOT_CBW_LENGTH )
+		return -1;
+
+	if ( len )
+	{
+		if ( in )
+			n = host_usb_bulk_in(MSC_IN_EP, data, len, TEST_TIMEOUT_MS);
+		else
+			n = host_usb_bulk_out(MSC_OUT_EP, data, len, TEST_TIMEOUT_MS);
+		if ( n==HOST_USB_STALL )
+		{
+			if ( !test_clear_halt(in ? MSC_IN_EP:MSC_OUT_EP) )
+				return -1;
+		}
+		else if ( n!=(int32_t)len )
+		{
+			return -1;
+		}
+	} // if ( len )
+
+	memset(&csw, 0, sizeof(csw));
+	n = host_usb_bulk_in(MSC_IN_EP, (uint8_t *)&csw, USBD_BOT_CSW_LENGTH, TEST_TIMEOUT_MS);
+	if ( n==HOST_USB_STALL )
+	{
+		if ( !test_clear_halt(MSC_IN_EP) )
+			return -1;
+		n = host_usb_bulk_in(MSC_IN_EP, (uint8_t *)&csw, USBD_BOT_CSW_LENGTH, TEST_TIMEOUT_MS);
+	}
+	if ( n!=USBD_BOT_CSW_LENGTH )
+		return -1;
+	if ( csw.dSignature!=USBD_BOT_CSW_SIGNATURE || csw.dTag!=cbw.dTag )
+		return -1;
+
+	return csw.bStatus;
+} // static int test_scsi(const uint8_t *cb, uint8_t cb_len, bool in, uint8_t *data, uint32_t len)
+
+
+
+static int test_rw10(uint8_t op, uint32_t lba, uint16_t blocks, uint8_t *data)
+{
+	uint8_t cb[10] = {op, 0, lba >> 24, lba >> 16, lba >> 8, lba, 0, blocks >> 8, blocks, 0};
+
+	return test_scsi(cb, sizeof(cb), op==SCSI_READ10, data, (uint32_t)blocks*TEST_BLOCK_SIZE);
+} // static int test_rw10(uint8_t op, uint32_t lba, uint16_t blocks, uint8_t *data)
+
+
+
+// Writes blocks and records them in the reference image once the device took them
+static int test_write(uint32_t lba, uint16_t blocks)
+{
+	int res;
+
+	test_fill(test_buf, lba, blocks);
+	res = test_rw10(SCSI_WRITE10, lba, blocks, test_buf);
+	memcpy(test_ref + (size_t)lba*TEST_BLOCK_SIZE, test_buf, (size_t)blocks*TEST_BLOCK_SIZE);
+
+	return res;
+} // static int test_write(uint32_t lba, uint16_t blocks)
+
+
+
+// Reads blocks and compares them with the reference image
+static bool test_read(uint32_t lba, uint16_t blocks)
+{
+	if ( test_rw10(SCSI_READ10, lba, blocks, test_buf)!=USBD_CSW_CMD_PASSED )
+		return false;
+	return !memcmp(test_buf, test_ref + (size_t)lba*TEST_BLOCK_SIZE, (size_t)blocks*TEST_BLOCK_SIZE);
+} // static bool test_read(uint32_t lba, uint16_t blocks)
+
+
+
+static int test_no_data(uint8_t op)
+{
+	uint8_t cb[10] = {op};
+
+	return test_scsi(cb, (op==SCSI_TEST_UNIT_READY) ? 6:10, false, NULL, 0);
+} // static int test_no_data(uint8_t op)
+
+
+
+// Sense key and additional sense code of the last error
+static uint32_t test_sense(void)
+{
+	uint8_t cb[6] = {SCSI_REQUEST_SENSE, 0, 0, 0, 18, 0};
+	uint8_t sense[18];
+
+	memset(sense, 0, sizeof(sense));
+	if ( test_scsi(cb, sizeof(cb), true, sense, sizeof(sense))!=USBD_CSW_CMD_PASSED )
+		return 0xFFFFFFFF;
+	return ((uint32_t)(sense[2] & 0x0F) << 8) | sense[12];
+} // static uint32_t test_sense(void)
+
+
+
+static void test_capacity(void)
+{
+	uint8_t cb[10] = {SCSI_READ_CAPACITY10};
+	uint8_t cap[8];
+
+	// Gives the block count and size the SCSI layer checks commands against
+	HOST_CHECK_EQ(test_scsi(cb, sizeof(cb), true, cap, sizeof(cap)), USBD_CSW_CMD_PASSED);
+	HOST_CHECK_EQ(((uint32_t)cap[0] << 24) | ((uint32_t)cap[1] << 16) | ((uint32_t)cap[2] << 8) | cap[3],
+			TEST_CARD_BLOCKS - 1);
+	HOST_CHECK_EQ(((uint32_t)cap[4] << 24) | ((uint32_t)cap[5] << 16) | ((uint32_t)cap[6] << 8) | cap[7],
+			TEST_BLOCK_SIZE);
+} // static void test_capacity(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Sequential writes and reads of 64 KB commands: the writes are
+  *         merged and the reads read ahead to the cache size
+  */
+/*============================================================================*/
+static void test_sequential(void)
+{
+	S_Host_SD_Stats_t stats;
+	uint64_t start, write_us, read_us;
+	uint32_t lba;
+	bool same;
+
+	host_sd_stats_reset();
+	start = host_time_us();
+	for (lba=0; lba<TEST_SEQ_BLOCKS; lba+=TEST_SEQ_CMD_BLOCKS)
+		HOST_CHECK_EQ(test_write(lba, TEST_SEQ_CMD_BLOCKS), USBD_CSW_CMD_PASSED);
+	HOST_CHECK_EQ(test_no_data(SCSI_SYNCHRONIZE_CACHE10), USBD_CSW_CMD_PASSED);
+	write_us = host_time_us() - start;
+	host_sd_stats_get(&stats);
+	printf("%u blocks written by %u SD commands in %lu ms\n", TEST_SEQ_BLOCKS, stats.write_commands,
+			(unsigned long)(write_us/1000));
+	HOST_CHECK_EQ(stats.write_commands, TEST_SEQ_BLOCKS/TEST_CACHE_BLOCKS);
+	HOST_CHECK_EQ(stats.blocks_written, TEST_SEQ_BLOCKS);
+	HOST_CHECK(!memcmp(host_sd_image(), test_ref, (size_t)TEST_SEQ_BLOCKS*TEST_BLOCK_SIZE));
+
+	host_sd_stats_reset();
+	start = host_time_us();
+	same = true;
+	for (lba=0; lba<TEST_SEQ_BLOCKS; lba+=TEST_SEQ_CMD_BLOCKS)
+		same = same && test_read(lba, TEST_SEQ_CMD_BLOCKS);
+	read_us = host_time_us() - start;
+	host_sd_stats_get(&stats);
+	printf("%u blocks read by %u SD commands in %lu ms\n", TEST_SEQ_BLOCKS, stats.read_commands,
+			(unsigned long)(read_us/1000));
+	HOST_CHECK(same);
+	// The first command is not known to be sequential
+	HOST_CHECK(stats.read_commands <= TEST_SEQ_BLOCKS/TEST_CACHE_BLOCKS + 1);
+} // static void test_sequential(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Random writes, reads and flushes, against the reference image
+  */
+/*============================================================================*/
+static void test_random(void)
+{
+	uint32_t i, op, lba, mismatches;
+	uint16_t blocks;
+
+	mismatches = 0;
+	for (i=0; i<TEST_RANDOM_OPS; i++)
+	{
+		op = test_rand() % 16;
+		blocks = 1 + test_rand() % ((test_rand() & 1) ? 16:TEST_SEQ_CMD_BLOCKS);
+		lba = test_rand() % (TEST_RANDOM_BLOCKS - blocks);
+		if ( op < 7 )
+			HOST_CHECK_EQ(test_write(lba, blocks), USBD_CSW_CMD_PASSED);
+		else if ( op < 14 )
+			mismatches += test_read(lba, blocks) ? 0:1;
+		else if ( op==14 )
+			HOST_CHECK_EQ(test_no_data(SCSI_TEST_UNIT_READY), USBD_CSW_CMD_PASSED);
+		else
+			HOST_CHECK_EQ(test_no_data(SCSI_SYNCHRONIZE_CACHE10), USBD_CSW_CMD_PASSED);
+	} // for (i=0; i<TEST_RANDOM_OPS; i++)
+	HOST_CHECK_EQ(test_no_data(SCSI_SYNCHRONIZE_CACHE10), USBD_CSW_CMD_PASSED);
+
+	printf("%u random commands, %u reads with other data than written\n", TEST_RANDOM_OPS, mismatches);
+	HOST_CHECK_EQ(mismatches, 0);
+	HOST_CHECK(!memcmp(host_sd_image(), test_ref, (size_t)TEST_RANDOM_BLOCKS*TEST_BLOCK_SIZE));
+} // static void test_random(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  The card rejects the write of the cached blocks: the command that
+  *         caused it fails, the next command writes them. Blocks dropped by
+  *         STORAGE_Sync() or by a card removal fail a command too.
+  */
+/*============================================================================*/
+static void test_write_fault(void)
+{
+	S_Host_SD_Stats_t stats;
+	uint32_t lba;
+
+	// Every try of the flush at the end of the command fails
+	lba = TEST_RANDOM_BLOCKS;
+	host_sd_stats_reset();
+	host_sd_fail_writes(TEST_WRITE_RETRIES + 2);
+	HOST_CHECK_EQ(test_write(lba, TEST_CACHE_BLOCKS), USBD_CSW_CMD_FAILED);
+	HOST_CHECK_EQ(test_sense(), (HARDWARE_ERROR << 8) | WRITE_FAULT);
+	HOST_CHECK_EQ(test_no_data(SCSI_TEST_UNIT_READY), USBD_CSW_CMD_PASSED);
+	host_sd_stats_get(&stats);
+	HOST_CHECK_EQ(stats.rejected_writes, TEST_WRITE_RETRIES + 2);
+	HOST_CHECK(!memcmp(host_sd_image() + (size_t)lba*TEST_BLOCK_SIZE, test_ref + (size_t)lba*TEST_BLOCK_SIZE,
+			(size_t)TEST_CACHE_BLOCKS*TEST_BLOCK_SIZE));
+	HOST_CHECK(test_read(lba, TEST_CACHE_BLOCKS));
+
+	// The firmware takes the card back and cannot write the cached blocks,
+	// the next command fails, without or with a data stage
+	lba += TEST_CACHE_BLOCKS;
+	HOST_CHECK_EQ(test_write(lba, 16), USBD_CSW_CMD_PASSED);
+	host_sd_fail_writes(TEST_WRITE_RETRIES);
+	HOST_CHECK(STORAGE_Sync()!=0);
+	HOST_CHECK_EQ(test_no_data(SCSI_TEST_UNIT_READY), USBD_CSW_CMD_FAILED);
+	HOST_CHECK_EQ(test_sense(), (HARDWARE_ERROR << 8) | WRITE_FAULT);
+	HOST_CHECK_EQ(test_no_data(SCSI_TEST_UNIT_READY), USBD_CSW_CMD_PASSED);
+	memcpy(test_ref + (size_t)lba*TEST_BLOCK_SIZE, host_sd_image() + (size_t)lba*TEST_BLOCK_SIZE, 16*TEST_BLOCK_SIZE);
+
+	HOST_CHECK_EQ(test_write(lba, 16), USBD_CSW_CMD_PASSED);
+	host_sd_fail_writes(TEST_WRITE_RETRIES);
+	HOST_CHECK(STORAGE_Sync()!=0);
+	HOST_CHECK_EQ(test_rw10(SCSI_READ10, lba, 16, test_buf), USBD_CSW_CMD_FAILED);
+	HOST_CHECK_EQ(test_sense(), (HARDWARE_ERROR << 8) | WRITE_FAULT);
+	memcpy(test_ref + (size_t)lba*TEST_BLOCK_SIZE, host_sd_image() + (size_t)lba*TEST_BLOCK_SIZE, 16*TEST_BLOCK_SIZE);
+	HOST_CHECK(test_read(lba, 16));
+
+	// Written when the firmware takes the card back
+	HOST_CHECK_EQ(test_write(lba, 16), USBD_CSW_CMD_PASSED);
+	HOST_CHECK_EQ(STORAGE_Sync(), 0);
+	HOST_CHECK(!memcmp(host_sd_image() + (size_t)lba*TEST_BLOCK_SIZE, test_ref + (size_t)lba*TEST_BLOCK_SIZE, 16*TEST_BLOCK_SIZE));
+
+	// The card is removed with blocks cached
+	lba += 16;
+	HOST_CHECK_EQ(test_write(lba, 16), USBD_CSW_CMD_PASSED);
+	host_sd_set_present(false);
+	HOST_CHECK_EQ(test_no_data(SCSI_TEST_UNIT_READY), USBD_CSW_CMD_FAILED);
+	host_sd_set_present(true);
+	HOST_CHECK_EQ(test_no_data(SCSI_TEST_UNIT_READY), USBD_CSW_CMD_PASSED);
+	memcpy(test_ref + (size_t)lba*TEST_BLOCK_SIZE, host_sd_image() + (size_t)lba*TEST_BLOCK_SIZE, 16*TEST_BLOCK_SIZE);
+	HOST_CHECK(test_read(lba, 16));
+} // static void test_write_fault(void)
+
+
+
+static void *test_writer_task(void *argument)
+{
+	uint32_t lba;
+
+	(void)argument;
+	for (lba=0; lba<16*TEST_SEQ_CMD_BLOCKS; lba+=TEST_SEQ_CMD_BLOCKS)
+		HOST_CHECK_EQ(test_write(lba, TEST_SEQ_CMD_BLOCKS), USBD_CSW_CMD_PASSED);
+	HOST_CHECK_EQ(test_no_data(SCSI_SYNCHRONIZE_CACHE10), USBD_CSW_CMD_PASSED);
+	test_writer_done = true;
+
+	return NULL;
+} // static void *test_writer_task(void *argument)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Control requests sent while writes wait for a slow card: the USB
+  *         interrupt serves them without waiting for the card
+  */
+/*============================================================================*/
+static void test_irq_latency(void)
+{
+	static const uint8_t get_max_lun[8] = {0xA1, BOT_GET_MAX_LUN, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00};
+	S_Host_USB_Stats_t stats;
+	pthread_t writer;
+	uint64_t start, duration, max_us;
+	uint32_t requests;
+	uint8_t max_lun;
+
+	host_sd_set_timing(TEST_SLOW_COMMAND_US, 0, 0);
+	host_usb_stats_reset();
+	test_writer_done = false;
+	pthread_create(&writer, NULL, test_writer_task, NULL);
+
+	requests = 0;
+	max_us = 0;
+	while ( !test_writer_done )
+	{
+		start = host_time_us();
+		HOST_CHECK_EQ(host_usb_control(get_max_lun, &max_lun, 1), 1);
+		duration = host_time_us() - start;
+		if ( duration > max_us )
+			max_us = duration;
+		requests++;
+		host_sleep_us(1000);
+	}
+	pthread_join(writer, NULL);
+	host_usb_stats_get(&stats);
+	host_sd_set_timing(0, 0, 0);
+
+	printf("%u control requests during writes of %u ms commands: longest %lu us, interrupt masked up to %lu us\n",
+			requests, TEST_SLOW_COMMAND_US/1000, (unsigned long)max_us, (unsigned long)stats.irq_wait_max_us);
+	HOST_CHECK(requests > 16);
+	HOST_CHECK(max_us < TEST_IRQ_LATENCY_MAX_US);
+} // static void test_irq_latency(void)
+
+
+
+int main(void)
+{
+	host_sd_init(TEST_CARD_BLOCKS);
+	test_device_start();
+	test_capacity();
+
+	test_sequential();
+	test_random();
+	test_write_fault();
+	test_irq_latency();
+
+	return host_test_result("msc_scsi_test");
+} // int main(void)
@@ -0,0 +1,257 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  nfc_ctx_stress.c
+*
+*  Snapshot publication of nfc_ctx.c with a writer thread and reader
+*  threads. The writer publishes cards as the poller does (header and source
+*  file, nfc_ctx_clear_dump(), workspace filled, nfc_ctx_set_dump()) and
+*  writes pages in place as the listener does. Every byte it writes derives
+*  from a generation number: g gives a UID of 4 + g % 4 bytes g, the file
+*  name of g and 16 + g % 32 pages {g, p, g, p}; pages written in place use
+*  g ^ 0x80. The readers take snapshots and pages without locking meanwhile
+*  and each of them must come from a single publication.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "nfc_ctx.h"
+#include "host_port.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_RUN_US					2000000 // A torn copy needs a preemption inside it
+#define TEST_READERS				3
+#define TEST_UNITS_MIN				16
+#define TEST_UNITS_RANGE			32
+#define TEST_PAGE_WRITES			4 // In place writes per card
+
+//************************** S T R U C T U R E S *******************************
+
+typedef struct
+{
+	uint32_t rng;
+	uint32_t snapshots;
+	uint32_t pages;
+	uint32_t errors; // Reads mixing two publications
+} S_Test_Reader_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+static volatile bool test_run;
+static uint32_t test_cards;
+static uint32_t test_page_writes;
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+static uint32_t test_rand(uint32_t *state);
+static void test_page(uint8_t gen, uint16_t page, uint8_t out[4]);
+static void test_path(uint8_t gen, char *out, size_t size);
+static void *test_writer(void *argument);
+static bool test_check_snapshot(const nfc_ctx_snapshot_t *psnap);
+static void *test_reader(void *argument);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static uint32_t test_rand(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+
+	return x;
+} // static uint32_t test_rand(uint32_t *state)
+
+
+
+static void test_page(uint8_t gen, uint16_t page, uint8_t out[4])
+{
+	out[0] = gen;
+	out[1] = (uint8_t)page;
+	out[2] = gen;
+	out[3] = (uint8_t)page;
+} // static void test_page(uint8_t gen, uint16_t page, uint8_t out[4])
+
+
+
+static void test_path(uint8_t gen, char *out, size_t size)
+{
+	snprintf(out, size, "/NFC/card_%03u.nfc", gen);
+} // static void test_path(uint8_t gen, char *out, size_t size)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Publishes cards until stopped
+  */
+/*============================================================================*/
+static void *test_writer(void *argument)
+{
+	nfc_run_ctx_t *c = nfc_ctx_get();
+	char path[NFC_PATH_MAX];
+	uint32_t rng = 1, i;
+	uint16_t units, page;
+	uint8_t gen = 0, buf[4];
+
+	(void)argument;
+	while ( test_run )
+	{
+		gen++;
+		units = (uint16_t)(TEST_UNITS_MIN + gen % TEST_UNITS_RANGE);
+
+		// Header as FillNfcContextFromDevice() leaves it, published with its file and without dump
+		memset(&c->head, 0, sizeof(c->head));
+		c->head.tech = M1NFC_TECH_A;
+		c->head.family = M1NFC_FAM_ULTRALIGHT;
+		c->head.uid_len = (uint8_t)(4 + gen % 4);
+		memset(c->head.uid, gen, c->head.uid_len);
+		test_path(gen, path, sizeof(path));
+		nfc_ctx_begin_file(path);
+		nfc_ctx_clear_dump();
+
+		// Workspace filled while no dump is published
+		for (page=0; page<units; page++)
+			test_page(gen, page, &g_nfc_dump_buf[page*4]);
+		memset(g_nfc_valid_bits, 0xFF, (units + 7)/8);
+		nfc_ctx_set_dump(4, units, 0, g_nfc_dump_buf, g_nfc_valid_bits, units - 1, true);
+		test_cards++;
+
+		for (i=0; i<TEST_PAGE_WRITES; i++)
+		{
+			page = (uint16_t)(test_rand(&rng) % units);
+			test_page((uint8_t)(gen ^ 0x80), page, buf);
+			nfc_ctx_set_t2t_page(page, buf);
+			test_page_writes++;
+		}
+	} // while ( test_run )
+
+	return NULL;
+} // static void *test_writer(void *argument)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Checks a snapshot comes from a single publication
+  */
+/*============================================================================*/
+static bool test_check_snapshot(const nfc_ctx_snapshot_t *psnap)
+{
+	char path[NFC_PATH_MAX];
+	uint8_t gen = psnap->head.uid[0], i;
+
+	if ( psnap->head.uid_len==0 )
+		return !psnap->dump.has_dump && psnap->file.path[0]=='\0'; // Empty context before the first card
+
+	if ( psnap->head.tech!=M1NFC_TECH_A || psnap->head.family!=M1NFC_FAM_ULTRALIGHT
+			|| psnap->head.uid_len!=4 + gen % 4 )
+		return false;
+	for (i=1; i<psnap->head.uid_len; i++)
+	{
+		if ( psnap->head.uid[i]!=gen )
+			return false;
+	}
+	test_path(gen, path, sizeof(path));
+	if ( psnap->file.source_kind!=LOAD_FILE || strcmp(psnap->file.path, path) )
+		return false;
+	if ( !psnap->dump.has_dump )
+		return true;
+
+	return psnap->dump.unit_count==TEST_UNITS_MIN + gen % TEST_UNITS_RANGE
+			&& psnap->dump.max_seen_unit==psnap->dump.unit_count - 1;
+} // static bool test_check_snapshot(const nfc_ctx_snapshot_t *psnap)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Reads snapshots and pages until stopped
+  */
+/*============================================================================*/
+static void *test_reader(void *argument)
+{
+	S_Test_Reader_t *preader = argument;
+	nfc_ctx_snapshot_t snap;
+	uint16_t count, page;
+	uint8_t buf[4];
+
+	while ( test_run )
+	{
+		nfc_ctx_get_snapshot(&snap);
+		preader->snapshots++;
+		if ( !test_check_snapshot(&snap) )
+			preader->errors++;
+
+		count = nfc_ctx_get_t2t_page_count();
+		if ( !count )
+			continue;
+		if ( count < TEST_UNITS_MIN || count >= TEST_UNITS_MIN + TEST_UNITS_RANGE )
+			preader->errors++;
+		page = (uint16_t)(test_rand(&preader->rng) % count);
+		// A smaller card may have been published since the count
+		if ( nfc_ctx_get_t2t_page(page, buf) )
+		{
+			preader->pages++;
+			if ( buf[0]!=buf[2] || buf[1]!=(uint8_t)page || buf[3]!=(uint8_t)page )
+				preader->errors++;
+		}
+	} // while ( test_run )
+
+	return NULL;
+} // static void *test_reader(void *argument)
+
+
+
+int main(void)
+{
+	S_Test_Reader_t readers[TEST_READERS];
+	pthread_t writer, reader_threads[TEST_READERS];
+	uint32_t retries, snapshots, pages, errors, i;
+
+	nfc_ctx_module_init();
+	retries = g_nfc_ctx_read_retries;
+	memset(readers, 0, sizeof(readers));
+	test_run = true;
+	for (i=0; i<TEST_READERS; i++)
+	{
+		readers[i].rng = i + 1;
+		pthread_create(&reader_threads[i], NULL, test_reader, &readers[i]);
+	}
+	pthread_create(&writer, NULL, test_writer, NULL);
+
+	host_sleep_us(TEST_RUN_US);
+	test_run = false;
+	pthread_join(writer, NULL);
+	snapshots = pages = errors = 0;
+	for (i=0; i<TEST_READERS; i++)
+	{
+		pthread_join(reader_threads[i], NULL);
+		snapshots += readers[i].snapshots;
+		pages += readers[i].pages;
+		errors += readers[i].errors;
+	}
+	retries = g_nfc_ctx_read_retries - retries;
+
+	printf("Writer: %u cards, %u page writes\n", test_cards, test_page_writes);
+	printf("Readers: %u snapshots, %u pages, %u inconsistent, %u retries\n", snapshots, pages, errors, retries);
+	HOST_CHECK(test_cards > 0);
+	HOST_CHECK(snapshots > 0 && pages > 0);
+	HOST_CHECK_EQ(errors, 0);
+
+	return host_test_result("nfc_ctx_stress");
+} // int main(void)
@@ -0,0 +1,257 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  nfc_file_test.c
+*
+*  NFC dump files on a FatFs RAM disk: Ultralight and Classic dumps saved
+*  by nfc_profile_save() and loaded back by nfc_storage_load_file(), the
+*  disk writes of a save, and a power cut at every sector written by a
+*  save over a previous one.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "ff.h"
+#include "m1_file_browser.h"
+#include "nfc_ctx.h"
+#include "nfc_file.h"
+#include "nfc_storage.h"
+#include "host_fatfs.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_DISK_SECTORS			(64*1024) // 32 MB
+#define TEST_DIR					"/NFC"
+#define TEST_NTAG_FILENAME			TEST_DIR "/ntag.nfc"
+#define TEST_CLASSIC_FILENAME		TEST_DIR "/classic.nfc"
+#define TEST_NTAG_PAGES				231 // NTAG215
+#define TEST_CLASSIC_BLOCKS			64 // Classic 1K
+#define TEST_VERSIONS				2
+#define TEST_SAVE_WRITES_MAX		16 // Disk writes of a save of TEST_NTAG_PAGES
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+static uint8_t test_dump[NFC_DUMP_BUF_SIZE];
+static uint8_t test_valid[NFC_VALID_BITS_SIZE];
+static uint8_t test_load_dump[NFC_DUMP_BUF_SIZE];
+static uint8_t test_load_valid[NFC_VALID_BITS_SIZE];
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static uint8_t test_byte(uint32_t offset, int version)
+{
+	return (uint8_t)(offset*31 + (offset >> 8) + version*0x5B);
+} // static uint8_t test_byte(uint32_t offset, int version)
+
+
+
+// Some pages of the Ultralight dump are left unread, as pages a card refuses
+static bool test_unit_read(uint16_t unit_size, uint32_t unit)
+{
+	return unit_size!=4 || unit%7!=3;
+} // static bool test_unit_read(uint16_t unit_size, uint32_t unit)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Fills a context with a dump of the given version, as after
+  *         reading a card
+  */
+/*============================================================================*/
+static void test_card(nfc_run_ctx_t *pctx, uint8_t family, uint32_t units, int version)
+{
+	static const uint8_t uid[7] = {0x04, 0xA1, 0x5E, 0x22, 0x7B, 0x6C, 0x80};
+	uint16_t unit_size;
+	uint32_t i;
+
+	unit_size = (family==M1NFC_FAM_CLASSIC) ? 16:4;
+	nfc_run_ctx_init(pctx);
+	pctx->head.tech = NFC_TX_A;
+	pctx->head.family = family;
+	memcpy(pctx->head.uid, uid, sizeof(uid));
+	pctx->head.uid_len = (family==M1NFC_FAM_CLASSIC) ? 4:sizeof(uid);
+	pctx->head.a.atqa[0] = (family==M1NFC_FAM_CLASSIC) ? 0x04:0x44;
+	pctx->head.a.has_atqa = true;
+	pctx->head.a.sak = (family==M1NFC_FAM_CLASSIC) ? 0x08:0x00;
+	pctx->head.a.has_sak = true;
+
+	memset(test_valid, 0, sizeof(test_valid));
+	for (i=0; i<units*unit_size; i++)
+		test_dump[i] = test_byte(i, version);
+	for (i=0; i<units; i++)
+	{
+		if ( test_unit_read(unit_size, i) )
+			test_valid[i/8] |= 1 << (i%8);
+	}
+	pctx->dump.unit_size = unit_size;
+	pctx->dump.unit_count = units;
+	pctx->dump.data = test_dump;
+	pctx->dump.valid_bits = test_valid;
+	pctx->dump.max_seen_unit = units - 1;
+	pctx->dump.has_dump = true;
+} // static void test_card(nfc_run_ctx_t *pctx, uint8_t family, uint32_t units, int version)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Loads a file and finds the version of its dump
+  * @retval Version of every unit read, -1 if the file does not load or its
+  *         units are not all of the same version
+  */
+/*============================================================================*/
+static int test_load(const char *filename, uint8_t family, uint32_t units)
+{
+	const nfc_run_ctx_t *pctx;
+	uint16_t unit_size;
+	uint32_t i, k;
+	int version;
+
+	if ( nfc_storage_load_file(filename, test_load_dump, sizeof(test_load_dump),
+			test_load_valid, sizeof(test_load_valid))!=NFC_STORAGE_OK )
+		return -1;
+
+	pctx = nfc_ctx_get();
+	unit_size = (family==M1NFC_FAM_CLASSIC) ? 16:4;
+	if ( pctx->head.family!=family || pctx->dump.unit_size!=unit_size || !pctx->dump.has_dump )
+		return -1;
+	if ( pctx->head.uid[0]!=0x04 || pctx->head.uid_len!=((family==M1NFC_FAM_CLASSIC) ? 4:7) )
+		return -1;
+
+	for (version=0; version<TEST_VERSIONS; version++)
+	{
+		if ( test_load_dump[0]==test_byte(0, version) )
+			break;
+	}
+	if ( version==TEST_VERSIONS )
+		return -1;
+	for (i=0; i<units; i++)
+	{
+		if ( !test_unit_read(unit_size, i) )
+		{
+			if ( test_load_valid[i/8] & (1 << (i%8)) )
+				return -1;
+			continue;
+		}
+		if ( !(test_load_valid[i/8] & (1 << (i%8))) )
+			return -1;
+		for (k=i*unit_size; k<(i + 1)*unit_size; k++)
+		{
+			if ( test_load_dump[k]!=test_byte(k, version) )
+				return -1;
+		}
+	} // for (i=0; i<units; i++)
+
+	return version;
+} // static int test_load(const char *filename, uint8_t family, uint32_t units)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Saves and loads back both dump types, and counts the disk writes
+  *         of a save
+  */
+/*============================================================================*/
+static void test_round_trip(void)
+{
+	static nfc_run_ctx_t ctx;
+	S_Host_Disk_Stats_t stats;
+	FILINFO fno;
+
+	test_card(&ctx, M1NFC_FAM_CLASSIC, TEST_CLASSIC_BLOCKS, 1);
+	HOST_CHECK(nfc_profile_save(TEST_CLASSIC_FILENAME, &ctx));
+	HOST_CHECK_EQ(test_load(TEST_CLASSIC_FILENAME, M1NFC_FAM_CLASSIC, TEST_CLASSIC_BLOCKS), 1);
+
+	test_card(&ctx, M1NFC_FAM_ULTRALIGHT, TEST_NTAG_PAGES, 0);
+	host_disk_stats_reset();
+	HOST_CHECK(nfc_profile_save(TEST_NTAG_FILENAME, &ctx));
+	host_disk_stats_get(&stats);
+	HOST_CHECK_EQ(test_load(TEST_NTAG_FILENAME, M1NFC_FAM_ULTRALIGHT, TEST_NTAG_PAGES), 0);
+
+	HOST_CHECK(f_stat(TEST_NTAG_FILENAME, &fno)==FR_OK);
+	printf("%u pages in %lu bytes: %u disk writes, %u sectors written\n", TEST_NTAG_PAGES,
+			(unsigned long)fno.fsize, stats.writes, stats.sectors_written);
+	HOST_CHECK(stats.writes <= TEST_SAVE_WRITES_MAX);
+
+	// Saved again over the first one
+	test_card(&ctx, M1NFC_FAM_ULTRALIGHT, TEST_NTAG_PAGES, 1);
+	HOST_CHECK(nfc_profile_save(TEST_NTAG_FILENAME, &ctx));
+	HOST_CHECK_EQ(test_load(TEST_NTAG_FILENAME, M1NFC_FAM_ULTRALIGHT, TEST_NTAG_PAGES), 1);
+	HOST_CHECK_EQ(f_stat(TEST_NTAG_FILENAME ".tmp", NULL), FR_NO_FILE);
+	HOST_CHECK_EQ(f_stat(TEST_NTAG_FILENAME M1_FB_BACKUP_SUFFIX, NULL), FR_NO_FILE);
+} // static void test_round_trip(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Cuts the power after every sector written by a save over a
+  *         previous one: after the next mount, the file loads with either
+  *         dump
+  */
+/*============================================================================*/
+static void test_power_cut(void)
+{
+	static nfc_run_ctx_t ctx;
+	S_Host_Disk_Stats_t stats;
+	uint32_t n, restored, saved;
+	int version;
+
+	test_card(&ctx, M1NFC_FAM_ULTRALIGHT, TEST_NTAG_PAGES, 1);
+	host_disk_stats_reset();
+	HOST_CHECK(nfc_profile_save(TEST_NTAG_FILENAME, &ctx));
+	host_disk_stats_get(&stats);
+
+	restored = 0;
+	saved = 0;
+	for (n=0; n<=stats.sectors_written; n++)
+	{
+		test_card(&ctx, M1NFC_FAM_ULTRALIGHT, TEST_NTAG_PAGES, 0);
+		HOST_CHECK(nfc_profile_save(TEST_NTAG_FILENAME, &ctx));
+		test_card(&ctx, M1NFC_FAM_ULTRALIGHT, TEST_NTAG_PAGES, 1);
+		host_disk_fail_writes_after(n);
+		if ( nfc_profile_save(TEST_NTAG_FILENAME, &ctx) )
+			saved++;
+		host_disk_fail_clear();
+		HOST_CHECK(host_fatfs_remount()!=NULL);
+
+		if ( f_stat(TEST_NTAG_FILENAME, NULL)==FR_NO_FILE )
+			restored++;
+		version = test_load(TEST_NTAG_FILENAME, M1NFC_FAM_ULTRALIGHT, TEST_NTAG_PAGES);
+		HOST_CHECK(version>=0);
+		if ( version<0 )
+			printf("  cut after %u sectors: dump lost\n", n);
+	} // for (n=0; n<=stats.sectors_written; n++)
+	printf("Power cut at %u points, %u with the file restored from its backup\n",
+			stats.sectors_written + 1, restored);
+	HOST_CHECK(restored > 0);
+	HOST_CHECK(saved > 0);
+} // static void test_power_cut(void)
+
+
+
+int main(void)
+{
+	HOST_CHECK(host_fatfs_mount(TEST_DISK_SECTORS)!=NULL);
+	HOST_CHECK(f_mkdir(TEST_DIR)==FR_OK);
+	nfc_ctx_module_init();
+
+	test_round_trip();
+	test_power_cut();
+
+	host_fatfs_unmount();
+
+	return host_test_result("nfc_file_test");
+} // int main(void)
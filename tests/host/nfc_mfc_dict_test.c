@@ -0,0 +1,443 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  nfc_mfc_dict_test.c
+*
+*  MIFARE Classic key dictionary on a FatFs RAM disk: the binary key file
+*  compiled from a text dictionary, its reuse until the text file changes
+*  and its replacement through a power cut. The key search runs on
+*  simulated cards of four key profiles, with and without the keys found
+*  on the card, and the authentications per card are reported.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "ff.h"
+#include "m1_file_browser.h"
+#include "nfc_mfc_dict.h"
+#include "host_fatfs.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_DISK_SECTORS			(64*1024) // 32 MB
+#define TEST_SEARCH_KEYS			2000 // Keys of the key search dictionary
+#define TEST_CARDS					20 // Per profile
+#define TEST_SECTORS_MAX			40 // 4K
+
+//************************** S T R U C T U R E S *******************************
+
+typedef enum
+{
+	TEST_CARD_DEFAULT = 0, // FFFFFFFFFFFF everywhere
+	TEST_CARD_SHARED, // One key A for sector 0, one key A and one key B for the others
+	TEST_CARD_MIXED, // Most sectors use one of three card keys, the others a key of their own
+	TEST_CARD_UNIQUE, // Keys A and B of their own in every sector
+	TEST_CARD_MAX
+} E_Test_Card_t;
+
+typedef struct
+{
+	uint8_t key_a[TEST_SECTORS_MAX][MFC_KEY_LEN];
+	uint8_t key_b[TEST_SECTORS_MAX][MFC_KEY_LEN];
+} S_Test_Card_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+static const char *const test_card_names[TEST_CARD_MAX] =
+{
+	"default", "shared", "mixed", "unique"
+};
+
+// Duplicates, comments, blank and malformed lines; 5 distinct keys
+static const char test_dict_text[] =
+	"# MIFARE Classic keys\r\n"
+	"FFFFFFFFFFFF\r\n"
+	"a0a1a2a3a4a5\r\n"
+	"\r\n"
+	"  D3F7D3F7D3F7   # NDEF\r\n"
+	"ffffffffffff\r\n"
+	"000000000000\n"
+	"A0A1A2A3A4\r\n"
+	"A0A1A2A3A4A5A6\r\n"
+	"B0B1B2B3B4B5\r\n"
+	"a0a1a2a3a4a5\r\n";
+
+static const uint8_t test_dict_keys[][MFC_KEY_LEN] =
+{
+	{0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+	{0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5},
+	{0xD3, 0xF7, 0xD3, 0xF7, 0xD3, 0xF7},
+	{0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+	{0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5},
+};
+
+static mfc_dict_t test_dict;
+static S_Test_Card_t test_card;
+static uint32_t test_auths;
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+static uint32_t test_rand(uint32_t *state);
+static bool test_write_file(const char *filename, const char *text, bool append);
+static void test_search_dict(void);
+static bool test_card_make(S_Test_Card_t *pcard, E_Test_Card_t type, uint8_t sectors, uint32_t *rng);
+static bool test_auth(void *ctx, uint16_t sector, mfc_key_type_t type, const uint8_t key[MFC_KEY_LEN]);
+static void test_compile(void);
+static void test_power_cut(void);
+static void test_promote(void);
+static void test_search(uint8_t sectors);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+// xorshift32
+static uint32_t test_rand(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+} // static uint32_t test_rand(uint32_t *state)
+
+
+
+static bool test_write_file(const char *filename, const char *text, bool append)
+{
+	FIL fh;
+	UINT written;
+	bool ok;
+
+	if ( f_open(&fh, filename, append ? (FA_OPEN_APPEND | FA_WRITE):(FA_CREATE_ALWAYS | FA_WRITE))!=FR_OK )
+		return false;
+	ok = (f_write(&fh, text, strlen(text), &written)==FR_OK && written==strlen(text));
+	if ( f_close(&fh)!=FR_OK )
+		ok = false;
+
+	return ok;
+} // static bool test_write_file(const char *filename, const char *text, bool append)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Writes the key search dictionary: FFFFFFFFFFFF first, as in the
+  *         real dictionaries, then random keys
+  */
+/*============================================================================*/
+static void test_search_dict(void)
+{
+	static char text[TEST_SEARCH_KEYS*14 + 1];
+	uint32_t rng = 0x5EED;
+	uint32_t i, len;
+
+	len = sprintf(text, "FFFFFFFFFFFF\r\n");
+	for (i=1; i<TEST_SEARCH_KEYS; i++)
+	{
+		len += sprintf(&text[len], "%04X%08X\r\n", (unsigned)(test_rand(&rng) & 0xFFFF), (unsigned)test_rand(&rng));
+	}
+	HOST_CHECK(test_write_file(MFC_DICT_PATH, text, false));
+} // static void test_search_dict(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Assigns the keys of a card, drawn from the dictionary
+  */
+/*============================================================================*/
+static bool test_card_make(S_Test_Card_t *pcard, E_Test_Card_t type, uint8_t sectors, uint32_t *rng)
+{
+	uint8_t card_keys[3][MFC_KEY_LEN];
+	uint8_t s, k;
+	bool ok = true;
+
+	for (k=0; k<3 && ok; k++)
+		ok = mfc_dict_get(&test_dict, test_rand(rng) % test_dict.count, card_keys[k]);
+
+	for (s=0; s<sectors && ok; s++)
+	{
+		switch ( type )
+		{
+			case TEST_CARD_DEFAULT:
+				memset(pcard->key_a[s], 0xFF, MFC_KEY_LEN);
+				memset(pcard->key_b[s], 0xFF, MFC_KEY_LEN);
+				break;
+
+			case TEST_CARD_SHARED:
+				memcpy(pcard->key_a[s], card_keys[s ? 1:0], MFC_KEY_LEN);
+				memcpy(pcard->key_b[s], card_keys[2], MFC_KEY_LEN);
+				break;
+
+			case TEST_CARD_MIXED:
+				if ( test_rand(rng) % 4 )
+				{
+					memcpy(pcard->key_a[s], card_keys[test_rand(rng) % 3], MFC_KEY_LEN);
+					memcpy(pcard->key_b[s], card_keys[test_rand(rng) % 3], MFC_KEY_LEN);
+					break;
+				}
+				/* fall through */
+			default:
+				ok = mfc_dict_get(&test_dict, test_rand(rng) % test_dict.count, pcard->key_a[s])
+						&& mfc_dict_get(&test_dict, test_rand(rng) % test_dict.count, pcard->key_b[s]);
+				break;
+		} // switch ( type )
+	} // for (s=0; s<sectors && ok; s++)
+
+	return ok;
+} // static bool test_card_make(S_Test_Card_t *pcard, E_Test_Card_t type, uint8_t sectors, uint32_t *rng)
+
+
+
+// mfc_auth_fn_t of the simulated card
+static bool test_auth(void *ctx, uint16_t sector, mfc_key_type_t type, const uint8_t key[MFC_KEY_LEN])
+{
+	const S_Test_Card_t *pcard = (const S_Test_Card_t *)ctx;
+
+	test_auths++;
+	if ( type==MFC_KEYTYPE_A )
+		return !memcmp(pcard->key_a[sector], key, MFC_KEY_LEN);
+	return !memcmp(pcard->key_b[sector], key, MFC_KEY_LEN);
+} // static bool test_auth(void *ctx, uint16_t sector, mfc_key_type_t type, const uint8_t key[MFC_KEY_LEN])
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Compiles the text dictionary: distinct keys in the order of their
+  *         first line. The binary file is reused until the text file
+  *         changes, and used as it is without a text file.
+  */
+/*============================================================================*/
+static void test_compile(void)
+{
+	uint8_t key[MFC_KEY_LEN], marker[MFC_KEY_LEN];
+	mfc_dict_hdr_t hdr;
+	FILINFO fno;
+	FIL fh;
+	UINT n;
+	uint32_t i;
+
+	HOST_CHECK(test_write_file(MFC_DICT_PATH, test_dict_text, false));
+	HOST_CHECK(mfc_dict_open(&test_dict));
+	HOST_CHECK_EQ(test_dict.count, sizeof(test_dict_keys)/MFC_KEY_LEN);
+	for (i=0; i<test_dict.count; i++)
+	{
+		HOST_CHECK(mfc_dict_next(&test_dict, key));
+		HOST_CHECK(!memcmp(key, test_dict_keys[i], MFC_KEY_LEN));
+	}
+	HOST_CHECK(!mfc_dict_next(&test_dict, key));
+	HOST_CHECK(mfc_dict_get(&test_dict, 2, key));
+	HOST_CHECK(!memcmp(key, test_dict_keys[2], MFC_KEY_LEN));
+	HOST_CHECK(mfc_dict_next(&test_dict, key));
+	HOST_CHECK(!memcmp(key, test_dict_keys[3], MFC_KEY_LEN));
+	HOST_CHECK(!mfc_dict_get(&test_dict, test_dict.count, key));
+	mfc_dict_close(&test_dict);
+
+	HOST_CHECK(f_stat(MFC_DICT_PATH, &fno)==FR_OK);
+	HOST_CHECK(f_open(&fh, MFC_DICT_BIN_PATH, FA_READ)==FR_OK);
+	HOST_CHECK(f_read(&fh, &hdr, sizeof(hdr), &n)==FR_OK && n==sizeof(hdr));
+	HOST_CHECK_EQ(f_size(&fh), sizeof(hdr) + hdr.count*MFC_KEY_LEN);
+	f_close(&fh);
+	HOST_CHECK_EQ(hdr.magic, MFC_DICT_MAGIC);
+	HOST_CHECK_EQ(hdr.key_size, MFC_KEY_LEN);
+	HOST_CHECK_EQ(hdr.src_size, fno.fsize);
+	HOST_CHECK_EQ(f_stat(MFC_DICT_BIN_PATH ".tmp", NULL), FR_NO_FILE);
+
+	// A mark in the binary file shows whether it was compiled again
+	memset(marker, 0x5A, sizeof(marker));
+	HOST_CHECK(f_open(&fh, MFC_DICT_BIN_PATH, FA_WRITE)==FR_OK);
+	HOST_CHECK(f_lseek(&fh, sizeof(hdr))==FR_OK);
+	HOST_CHECK(f_write(&fh, marker, sizeof(marker), &n)==FR_OK && n==sizeof(marker));
+	f_close(&fh);
+
+	HOST_CHECK(mfc_dict_open(&test_dict));
+	HOST_CHECK(mfc_dict_next(&test_dict, key));
+	HOST_CHECK(!memcmp(key, marker, MFC_KEY_LEN));
+	mfc_dict_close(&test_dict);
+
+	// A new key in the text file compiles it again, over the previous file
+	HOST_CHECK(test_write_file(MFC_DICT_PATH, "C0C1C2C3C4C5\r\n", true));
+	HOST_CHECK(mfc_dict_open(&test_dict));
+	HOST_CHECK_EQ(test_dict.count, sizeof(test_dict_keys)/MFC_KEY_LEN + 1);
+	HOST_CHECK(mfc_dict_next(&test_dict, key));
+	HOST_CHECK(!memcmp(key, test_dict_keys[0], MFC_KEY_LEN));
+	mfc_dict_close(&test_dict);
+	HOST_CHECK_EQ(f_stat(MFC_DICT_BIN_PATH ".tmp", NULL), FR_NO_FILE);
+	HOST_CHECK_EQ(f_stat(MFC_DICT_BIN_PATH M1_FB_BACKUP_SUFFIX, NULL), FR_NO_FILE);
+
+	// Without the text file, the binary file is used as it is
+	HOST_CHECK(f_unlink(MFC_DICT_PATH)==FR_OK);
+	HOST_CHECK(mfc_dict_open(&test_dict));
+	HOST_CHECK_EQ(test_dict.count, sizeof(test_dict_keys)/MFC_KEY_LEN + 1);
+	mfc_dict_close(&test_dict);
+
+	// A truncated binary file is refused
+	HOST_CHECK(f_open(&fh, MFC_DICT_BIN_PATH, FA_WRITE)==FR_OK);
+	HOST_CHECK(f_lseek(&fh, sizeof(hdr) + MFC_KEY_LEN)==FR_OK);
+	HOST_CHECK(f_truncate(&fh)==FR_OK);
+	f_close(&fh);
+	HOST_CHECK(!mfc_dict_open(&test_dict));
+} // static void test_compile(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Cuts the power after every sector written by a compile over a
+  *         previous binary file: after the next mount the dictionary opens
+  *         with the keys of the text file
+  */
+/*============================================================================*/
+static void test_power_cut(void)
+{
+	S_Host_Disk_Stats_t stats;
+	uint32_t n;
+
+	HOST_CHECK(test_write_file(MFC_DICT_PATH, test_dict_text, false));
+	host_disk_stats_reset();
+	HOST_CHECK(mfc_dict_compile(MFC_DICT_PATH, MFC_DICT_BIN_PATH));
+	host_disk_stats_get(&stats);
+
+	for (n=0; n<=stats.sectors_written; n++)
+	{
+		HOST_CHECK(mfc_dict_compile(MFC_DICT_PATH, MFC_DICT_BIN_PATH));
+		host_disk_fail_writes_after(n);
+		mfc_dict_compile(MFC_DICT_PATH, MFC_DICT_BIN_PATH);
+		host_disk_fail_clear();
+		HOST_CHECK(host_fatfs_remount()!=NULL);
+
+		HOST_CHECK(mfc_dict_open(&test_dict));
+		HOST_CHECK_EQ(test_dict.count, sizeof(test_dict_keys)/MFC_KEY_LEN);
+		mfc_dict_close(&test_dict);
+	} // for (n=0; n<=stats.sectors_written; n++)
+} // static void test_power_cut(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  The keys found on a card are kept most recent first, the least
+  *         recent one is dropped when they are full
+  */
+/*============================================================================*/
+static void test_promote(void)
+{
+	mfc_found_keys_t found;
+	uint8_t key[MFC_KEY_LEN];
+	uint8_t i;
+
+	found.count = 0;
+	for (i=0; i<MFC_FOUND_KEYS_MAX + 2; i++)
+	{
+		memset(key, i, sizeof(key));
+		mfc_found_keys_promote(&found, key);
+	}
+	HOST_CHECK_EQ(found.count, MFC_FOUND_KEYS_MAX);
+	HOST_CHECK_EQ(found.keys[0][0], MFC_FOUND_KEYS_MAX + 1);
+	HOST_CHECK_EQ(found.keys[MFC_FOUND_KEYS_MAX - 1][0], 2);
+
+	// A key found again moves to the front, without a copy
+	memset(key, 5, sizeof(key));
+	mfc_found_keys_promote(&found, key);
+	HOST_CHECK_EQ(found.count, MFC_FOUND_KEYS_MAX);
+	HOST_CHECK_EQ(found.keys[0][0], 5);
+	HOST_CHECK_EQ(found.keys[1][0], MFC_FOUND_KEYS_MAX + 1);
+	for (i=1; i<found.count; i++)
+		HOST_CHECK(found.keys[i][0]!=5);
+} // static void test_promote(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Searches the keys of every sector of simulated cards, first with
+  *         the dictionary only, then with the keys found on the card first.
+  *         Both searches find every sector, the second one with far fewer
+  *         authentications on cards sharing keys.
+  */
+/*============================================================================*/
+static void test_search(uint8_t sectors)
+{
+	mfc_found_keys_t found;
+	uint8_t key[MFC_KEY_LEN];
+	mfc_key_type_t type;
+	uint32_t rng = 1;
+	uint32_t attempts, dict_attempts, reuse_attempts;
+	uint16_t card;
+	uint8_t profile, s;
+
+	HOST_CHECK(mfc_dict_open(&test_dict));
+	HOST_CHECK_EQ(test_dict.count, TEST_SEARCH_KEYS);
+
+	for (profile=0; profile<TEST_CARD_MAX; profile++)
+	{
+		dict_attempts = 0;
+		reuse_attempts = 0;
+		for (card=0; card<TEST_CARDS; card++)
+		{
+			HOST_CHECK(test_card_make(&test_card, (E_Test_Card_t)profile, sectors, &rng));
+
+			attempts = 0;
+			for (s=0; s<sectors; s++)
+			{
+				HOST_CHECK(mfc_find_sector_key(&test_dict, NULL, s, test_auth, &test_card, key, &type, &attempts));
+			}
+			dict_attempts += attempts;
+
+			found.count = 0;
+			attempts = 0;
+			test_auths = 0;
+			for (s=0; s<sectors; s++)
+			{
+				HOST_CHECK(mfc_find_sector_key(&test_dict, &found, s, test_auth, &test_card, key, &type, &attempts));
+				HOST_CHECK(!memcmp(key, (type==MFC_KEYTYPE_A) ? test_card.key_a[s]:test_card.key_b[s], MFC_KEY_LEN));
+			}
+			HOST_CHECK_EQ(attempts, test_auths);
+			reuse_attempts += attempts;
+		} // for (card=0; card<TEST_CARDS; card++)
+
+		printf("%u sectors, %s keys: %u -> %u authentications per card\n", sectors, test_card_names[profile],
+				dict_attempts/TEST_CARDS, reuse_attempts/TEST_CARDS);
+		// On cards of unique keys the found keys are tried in vain, twice each
+		HOST_CHECK(reuse_attempts <= dict_attempts + 2*MFC_FOUND_KEYS_MAX*sectors*TEST_CARDS);
+		if ( profile==TEST_CARD_DEFAULT )
+			HOST_CHECK_EQ(reuse_attempts, sectors*TEST_CARDS);
+		if ( profile==TEST_CARD_SHARED )
+			HOST_CHECK(reuse_attempts*5 < dict_attempts);
+	} // for (profile=0; profile<TEST_CARD_MAX; profile++)
+
+	mfc_dict_close(&test_dict);
+} // static void test_search(uint8_t sectors)
+
+
+
+int main(void)
+{
+	HOST_CHECK(host_fatfs_mount(TEST_DISK_SECTORS)!=NULL);
+	HOST_CHECK(f_mkdir("NFC")==FR_OK);
+	HOST_CHECK(f_mkdir("NFC/system")==FR_OK);
+
+	test_compile();
+	test_power_cut();
+	test_promote();
+
+	test_search_dict();
+	test_search(16);
+	test_search(40);
+
+	host_fatfs_unmount();
+
+	return host_test_result("nfc_mfc_dict_test");
+} // int main(void)
@@ -0,0 +1,352 @@
+/* See COPYING.txt for license details. */
+
+/*
+ ******************************************************************************
+ * nfc_mfc_sim.c - MIFARE Classic card model
+ ******************************************************************************
+ *
+ * [Purpose]
+ * - Card side of the authentication and of the encrypted commands
+ * - Air time of the exchanges, see nfc_mfc_sim.h
+ *
+ * [Usage]
+ * mfc_sim_init(), mfc_sim_set_keys() for each sector, mfc_sim_link(), then
+ * mfc_reader_init() with the link. The reader starts with a selected card.
+ *
+ ******************************************************************************
+ */
+
+#include <string.h>
+
+#include "nfc_mfc_sim.h"
+
+#define MFC_SIM_ACCESS_BITS     "\xFF\x07\x80\x69"  /* Transport configuration */
+#define MFC_SIM_NAK             0x04
+
+/*============================================================================*/
+/**
+ * @brief Air time of a frame
+ */
+/*============================================================================*/
+static uint32_t mfc_sim_frame_ns(const mfc_frame_t *frame)
+{
+    if (frame->bits) return (uint32_t)(frame->bits + 2) * MFC_SIM_BIT_NS;
+    return ((uint32_t)frame->len * 9U + 2U) * MFC_SIM_BIT_NS;
+}
+
+/*============================================================================*/
+/**
+ * @brief Sector of a block
+ */
+/*============================================================================*/
+static uint16_t mfc_sim_block_sector(uint16_t block)
+{
+    if (block < 128) return (uint16_t)(block / 4);
+    return (uint16_t)(32 + (block - 128) / 16);
+}
+
+/*============================================================================*/
+/**
+ * @brief Trailer block of a sector
+ */
+/*============================================================================*/
+static uint16_t mfc_sim_sector_trailer(uint16_t sector)
+{
+    return (uint16_t)(mfc_sector_to_first_block(sector) + ((sector < 32) ? 3 : 15));
+}
+
+/*============================================================================*/
+/**
+ * @brief Big endian word of 4 bytes
+ */
+/*============================================================================*/
+static uint32_t mfc_sim_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/*============================================================================*/
+/**
+ * @brief Next card nonce, the PRNG runs freely between two authentications
+ */
+/*============================================================================*/
+static uint32_t mfc_sim_nonce(mfc_sim_t *sim)
+{
+    sim->nt_rng ^= sim->nt_rng << 13;
+    sim->nt_rng ^= sim->nt_rng >> 17;
+    sim->nt_rng ^= sim->nt_rng << 5;
+    sim->nt = crypto1_prng_successor(sim->nt, 64 + (sim->nt_rng & 0x3FFU));
+    return sim->nt;
+}
+
+/*============================================================================*/
+/**
+ * @brief Set a 4-bit answer
+ */
+/*============================================================================*/
+static void mfc_sim_short(mfc_frame_t *rx, uint8_t code)
+{
+    rx->data[0] = code;
+    rx->len = 0;
+    rx->bits = 4;
+    rx->par = 0;
+}
+
+/*============================================================================*/
+/**
+ * @brief Handle AUTH, READ and HALT, decrypted if a session is running
+ * @param sim Card
+ * @param cmd Command
+ * @param rx Answer, left empty for none
+ */
+/*============================================================================*/
+static void mfc_sim_command(mfc_sim_t *sim, const mfc_frame_t *cmd, mfc_frame_t *rx)
+{
+    uint8_t crc[2], i, b;
+    uint16_t block, trailer;
+    bool session = (sim->state == MFC_SIM_AUTHED);
+
+    mfc_crc_a(cmd->data, 2, crc);
+    if (cmd->len != 4 || cmd->bits || crc[0] != cmd->data[2] || crc[1] != cmd->data[3]) {
+        sim->state = MFC_SIM_IDLE;
+        return;
+    }
+    block = cmd->data[1];
+
+    switch (cmd->data[0]) {
+    case MFC_CMD_AUTH_A:
+    case MFC_CMD_AUTH_B:
+        if (block >= sim->blocks) {
+            sim->state = MFC_SIM_IDLE;
+            break;
+        }
+        sim->sector = mfc_sim_block_sector(block);
+        trailer = mfc_sim_sector_trailer(sim->sector);
+        mfc_sim_nonce(sim);
+        crypto1_init(&sim->cs, (cmd->data[0] == MFC_CMD_AUTH_A) ? &sim->data[trailer][0] : &sim->data[trailer][10]);
+
+        rx->len = 4;
+        rx->bits = 0;
+        rx->par = 0;
+        for (i = 0; i < 4; i++) {
+            b = (uint8_t)(sim->nt >> (24 - 8 * i));
+            if (session) {
+                /* Nested: the nonce is encrypted by the new session */
+                rx->data[i] = b ^ crypto1_byte(&sim->cs, (uint8_t)(b ^ (sim->cuid >> (24 - 8 * i))), false);
+                rx->par |= (uint32_t)(crypto1_parity8(b) ^ crypto1_peek(&sim->cs)) << i;
+            } else {
+                rx->data[i] = b;
+                crypto1_byte(&sim->cs, (uint8_t)(b ^ (sim->cuid >> (24 - 8 * i))), false);
+            }
+        }
+        if (!session) mfc_frame_parity(rx);
+        sim->state = MFC_SIM_AUTH;
+        break;
+
+    case MFC_CMD_READ:
+        if (!session || block >= sim->blocks || mfc_sim_block_sector(block) != sim->sector) {
+            mfc_sim_short(rx, MFC_SIM_NAK);
+            if (session) mfc_frame_encrypt(&sim->cs, rx);
+            sim->state = MFC_SIM_IDLE;
+            break;
+        }
+        memcpy(rx->data, sim->data[block], MFC_BLOCK_SIZE);
+        if (block == mfc_sim_sector_trailer(sim->sector))
+            memset(rx->data, 0x00, MFC_KEY_LEN);    /* Key A never reads back */
+        mfc_crc_a(rx->data, MFC_BLOCK_SIZE, &rx->data[MFC_BLOCK_SIZE]);
+        rx->len = MFC_BLOCK_SIZE + 2;
+        rx->bits = 0;
+        mfc_frame_encrypt(&sim->cs, rx);
+        break;
+
+    case MFC_CMD_HALT:
+        sim->state = MFC_SIM_HALT;
+        break;
+
+    default:
+        sim->state = MFC_SIM_IDLE;
+        break;
+    }
+}
+
+/*============================================================================*/
+/**
+ * @brief Check {nR}{aR} and answer {aT}
+ * @param sim Card
+ * @param tx Reader frame
+ * @param rx Answer, left empty if the reader failed
+ */
+/*============================================================================*/
+static void mfc_sim_auth_answer(mfc_sim_t *sim, const mfc_frame_t *tx, mfc_frame_t *rx)
+{
+    uint32_t ar, at;
+    uint8_t i, plain;
+
+    sim->state = MFC_SIM_IDLE;
+    if (tx->len != 8 || tx->bits) return;
+
+    ar = 0;
+    for (i = 0; i < 8; i++) {
+        if (i < 4) {
+            /* nR goes into the LFSR */
+            plain = tx->data[i] ^ crypto1_byte(&sim->cs, tx->data[i], true);
+        } else {
+            plain = tx->data[i] ^ crypto1_byte(&sim->cs, 0, false);
+            ar = (ar << 8) | plain;
+        }
+        if (((tx->par >> i) & 1U) != (crypto1_parity8(plain) ^ crypto1_peek(&sim->cs))) return;
+    }
+    if (ar != crypto1_prng_successor(sim->nt, 64)) return;
+
+    at = crypto1_prng_successor(sim->nt, 96);
+    for (i = 0; i < 4; i++)
+        rx->data[i] = (uint8_t)(at >> (24 - 8 * i));
+    rx->len = 4;
+    rx->bits = 0;
+    mfc_frame_encrypt(&sim->cs, rx);
+    sim->state = MFC_SIM_AUTHED;
+}
+
+/*============================================================================*/
+/**
+ * @brief xfer of the link
+ */
+/*============================================================================*/
+static bool mfc_sim_xfer(void *ctx, const mfc_frame_t *tx, mfc_frame_t *rx)
+{
+    mfc_sim_t *sim = (mfc_sim_t *)ctx;
+    mfc_frame_t cmd;
+
+    rx->len = 0;
+    rx->bits = 0;
+    rx->par = 0;
+    sim->frames++;
+    sim->air_ns += mfc_sim_frame_ns(tx);
+
+    switch (sim->state) {
+    case MFC_SIM_ACTIVE:
+        mfc_sim_command(sim, tx, rx);
+        break;
+
+    case MFC_SIM_AUTHED:
+        cmd = *tx;
+        if (!mfc_frame_decrypt(&sim->cs, &cmd)) {
+            sim->state = MFC_SIM_IDLE;
+            break;
+        }
+        mfc_sim_command(sim, &cmd, rx);
+        break;
+
+    case MFC_SIM_AUTH:
+        mfc_sim_auth_answer(sim, tx, rx);
+        break;
+
+    default:
+        break;
+    }
+
+    if (rx->len || rx->bits) {
+        sim->air_ns += MFC_SIM_FDT_NS + mfc_sim_frame_ns(rx);
+    } else {
+        sim->air_ns += (uint64_t)MFC_FWT_US * 1000U;
+        sim->timeouts++;
+    }
+    sim->air_ns += MFC_SIM_TURNAROUND_NS;
+    return true;
+}
+
+/*============================================================================*/
+/**
+ * @brief reselect of the link: HALT if needed, WUPA, SELECT of each cascade level
+ */
+/*============================================================================*/
+static bool mfc_sim_reselect(void *ctx)
+{
+    mfc_sim_t *sim = (mfc_sim_t *)ctx;
+    mfc_frame_t frame;
+    uint8_t cascades = (sim->uid_len > 4) ? 2 : 1;
+
+    sim->reselects++;
+    frame.bits = 0;
+
+    if (sim->state >= MFC_SIM_ACTIVE) {
+        /* A card in a session ignores WUPA, send it to HALT first */
+        frame.len = 4;
+        sim->air_ns += mfc_sim_frame_ns(&frame) + (uint64_t)MFC_FWT_US * 1000U;
+    }
+
+    /* WUPA (7 bits), ATQA */
+    sim->air_ns += 9U * MFC_SIM_BIT_NS + MFC_SIM_FDT_NS + 20U * MFC_SIM_BIT_NS + MFC_SIM_TURNAROUND_NS;
+    /* SELECT with the UID of the level, SAK */
+    while (cascades--) {
+        frame.len = 9;
+        sim->air_ns += mfc_sim_frame_ns(&frame) + MFC_SIM_FDT_NS;
+        frame.len = 3;
+        sim->air_ns += mfc_sim_frame_ns(&frame) + MFC_SIM_TURNAROUND_NS;
+    }
+
+    sim->state = MFC_SIM_ACTIVE;
+    return true;
+}
+
+/*============================================================================*/
+/**
+ * @brief Set up a selected card with zeroed blocks and default keys
+ * @param sim Card
+ * @param uid UID
+ * @param uid_len 4 or 7
+ * @param blocks 64 (1K) or 256 (4K)
+ * @param seed Seed of the card nonces
+ */
+/*============================================================================*/
+void mfc_sim_init(mfc_sim_t *sim, const uint8_t *uid, uint8_t uid_len, uint16_t blocks, uint32_t seed)
+{
+    static const uint8_t key_default[MFC_KEY_LEN] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    uint16_t sector, sectors;
+
+    memset(sim, 0, sizeof(*sim));
+    memcpy(sim->uid, uid, uid_len);
+    sim->uid_len = uid_len;
+    sim->blocks = (blocks > MFC_SIM_BLOCKS_MAX) ? MFC_SIM_BLOCKS_MAX : blocks;
+    sim->cuid = mfc_sim_be32(&uid[uid_len - 4]);
+    sim->nt = 0x01200145U;
+    sim->nt_rng = seed ? seed : 1;
+    sim->state = MFC_SIM_ACTIVE;
+
+    memcpy(sim->data[0], uid, uid_len);
+    sectors = (sim->blocks > 128) ? (uint16_t)(32 + (sim->blocks - 128) / 16) : (uint16_t)(sim->blocks / 4);
+    for (sector = 0; sector < sectors; sector++)
+        mfc_sim_set_keys(sim, sector, key_default, key_default);
+}
+
+/*============================================================================*/
+/**
+ * @brief Set the keys of a sector, transport access bits
+ * @param sim Card
+ * @param sector Sector number
+ * @param key_a Key A
+ * @param key_b Key B
+ */
+/*============================================================================*/
+void mfc_sim_set_keys(mfc_sim_t *sim, uint16_t sector, const uint8_t key_a[MFC_KEY_LEN], const uint8_t key_b[MFC_KEY_LEN])
+{
+    uint8_t *trailer = sim->data[mfc_sim_sector_trailer(sector)];
+
+    memcpy(&trailer[0], key_a, MFC_KEY_LEN);
+    memcpy(&trailer[6], MFC_SIM_ACCESS_BITS, 4);
+    memcpy(&trailer[10], key_b, MFC_KEY_LEN);
+}
+
+/*============================================================================*/
+/**
+ * @brief Link of the card for mfc_reader_init()
+ * @param sim Card
+ * @param link Link
+ */
+/*============================================================================*/
+void mfc_sim_link(mfc_sim_t *sim, mfc_link_t *link)
+{
+    link->xfer = mfc_sim_xfer;
+    link->reselect = mfc_sim_reselect;
+    link->ctx = sim;
+}
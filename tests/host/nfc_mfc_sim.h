@@ -0,0 +1,67 @@
+/* See COPYING.txt for license details. */
+
+#ifndef NFC_MFC_SIM_H_
+#define NFC_MFC_SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "nfc_mfc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * MIFARE Classic card model
+ *
+ * Answers the frames of mfc_reader_t through an mfc_link_t as a card would:
+ * plain and nested authentication, encrypted READ and HALT, no answer to a
+ * wrong key. The keys are those of the sector trailers.
+ *
+ * The air time of every exchange is added up at 106 kbit/s: 9 bits per byte
+ * plus start and end of frame, the frame delay of the card, the reader
+ * turnaround and MFC_FWT_US when the card does not answer.
+ */
+#define MFC_SIM_BLOCKS_MAX      256
+
+#define MFC_SIM_BIT_NS          9440    /* 128/fc */
+#define MFC_SIM_FDT_NS          86000   /* Card frame delay, 1172/fc */
+#define MFC_SIM_TURNAROUND_NS   50000   /* Reader processing between frames */
+
+typedef enum {
+    MFC_SIM_IDLE = 0,                   /* Waits for WUPA/REQA */
+    MFC_SIM_HALT,                       /* Waits for WUPA */
+    MFC_SIM_ACTIVE,                     /* Selected, no session */
+    MFC_SIM_AUTH,                       /* Nonce sent, waits for {nR}{aR} */
+    MFC_SIM_AUTHED                      /* Session running */
+} mfc_sim_state_t;
+
+typedef struct {
+    uint8_t  uid[7];
+    uint8_t  uid_len;
+    uint16_t blocks;
+    uint8_t  data[MFC_SIM_BLOCKS_MAX][MFC_BLOCK_SIZE];
+
+    mfc_sim_state_t state;
+    crypto1_t cs;
+    uint32_t  cuid;
+    uint32_t  nt;                       /* Last card nonce */
+    uint32_t  nt_rng;                   /* Delay of the card PRNG between nonces */
+    uint16_t  sector;                   /* Authenticated sector */
+
+    uint64_t  air_ns;
+    uint32_t  frames;
+    uint32_t  timeouts;
+    uint32_t  reselects;
+} mfc_sim_t;
+
+void mfc_sim_init(mfc_sim_t *sim, const uint8_t *uid, uint8_t uid_len, uint16_t blocks, uint32_t seed);
+void mfc_sim_set_keys(mfc_sim_t *sim, uint16_t sector, const uint8_t key_a[MFC_KEY_LEN], const uint8_t key_b[MFC_KEY_LEN]);
+void mfc_sim_link(mfc_sim_t *sim, mfc_link_t *link);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NFC_MFC_SIM_H_ */
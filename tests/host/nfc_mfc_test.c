@@ -0,0 +1,405 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  nfc_mfc_test.c
+*
+*  Crypto1 and the MIFARE Classic reader against the card model of
+*  nfc_mfc_sim.c. The keystream is checked against a bit-serial model of
+*  the 48-bit LFSR built from the published taps and filter functions.
+*  1K and 4K cards are read whole, with a selection for every
+*  authentication and with nested authentication, and the air time and the
+*  authentication rate are reported.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "main.h"
+#include "ff.h"
+#include "nfc_mfc.h"
+#include "nfc_mfc_sim.h"
+#include "host_fatfs.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_DISK_SECTORS			(16*1024) // 8 MB
+#define TEST_CRYPTO1_KEYS			256 // 32 words each
+#define TEST_AUTHS					10000 // Timed authentications
+#define TEST_DICT_KEYS				200
+#define TEST_CARD_KEYS				3 // Keys of the cards, from the dictionary
+
+//************************** S T R U C T U R E S *******************************
+
+typedef struct
+{
+	uint16_t blocks;
+	uint16_t sectors;
+	uint8_t sak;
+} S_Test_Layout_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+static const S_Test_Layout_t test_layouts[] =
+{
+	{64, 16, 0x08}, // 1K
+	{256, 40, 0x18}, // 4K
+};
+
+static const uint8_t test_key_default[MFC_KEY_LEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+static mfc_sim_t test_sim;
+static mfc_dict_t test_dict;
+static uint8_t test_card_keys[TEST_CARD_KEYS][MFC_KEY_LEN];
+static uint8_t test_dump[MFC_SIM_BLOCKS_MAX*MFC_BLOCK_SIZE];
+static uint8_t test_valid[MFC_SIM_BLOCKS_MAX/8];
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+static uint32_t test_rand(uint32_t *state);
+static uint8_t test_fa(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+static uint8_t test_fb(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+static uint8_t test_fc(uint8_t a, uint8_t b, uint8_t c, uint8_t d, uint8_t e);
+static uint8_t test_ref_bit(uint64_t *x, uint8_t in, bool in_encrypted);
+static void test_crypto1(void);
+static void test_crc(void);
+static void test_auth(void);
+static bool test_dict_make(void);
+static void test_read_card(const S_Test_Layout_t *playout, bool nested, bool shared_keys);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+// xorshift32
+static uint32_t test_rand(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+} // static uint32_t test_rand(uint32_t *state)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Filter functions of the reference model, as published
+  */
+/*============================================================================*/
+static uint8_t test_fa(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+{
+	return ((a | b) ^ (a & d)) ^ (c & ((a ^ b) | d));
+} // static uint8_t test_fa(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+
+
+
+static uint8_t test_fb(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+{
+	return ((a & b) | c) ^ ((a ^ b) & (c | d));
+} // static uint8_t test_fb(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+
+
+
+static uint8_t test_fc(uint8_t a, uint8_t b, uint8_t c, uint8_t d, uint8_t e)
+{
+	return (a | ((b | e) & (d ^ e))) ^ ((a ^ (b & d)) & ((c ^ d) | (b & e)));
+} // static uint8_t test_fc(uint8_t a, uint8_t b, uint8_t c, uint8_t d, uint8_t e)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Bit-serial reference of Crypto1: x0..x47 in bits 0..47, x0
+  *         shifted out
+  * @param  x LFSR
+  * @param  in input bit
+  * @param  in_encrypted true if in is encrypted
+  * @retval keystream bit
+  */
+/*============================================================================*/
+static uint8_t test_ref_bit(uint64_t *x, uint8_t in, bool in_encrypted)
+{
+	static const uint8_t taps[] = {0, 5, 9, 10, 12, 14, 15, 17, 19, 24, 25, 27, 29, 35, 39, 41, 42, 43};
+#define X(n) ((uint8_t)((*x >> (n)) & 1U))
+	uint8_t ks, fb, i;
+
+	ks = test_fc(test_fa(X(9), X(11), X(13), X(15)),
+			test_fb(X(17), X(19), X(21), X(23)),
+			test_fb(X(25), X(27), X(29), X(31)),
+			test_fa(X(33), X(35), X(37), X(39)),
+			test_fb(X(41), X(43), X(45), X(47)));
+	fb = (uint8_t)((in & 1U) ^ (in_encrypted ? ks:0U));
+	for (i=0; i<sizeof(taps); i++)
+		fb ^= X(taps[i]);
+#undef X
+	*x = (*x >> 1) | ((uint64_t)fb << 47);
+
+	return ks;
+} // static uint8_t test_ref_bit(uint64_t *x, uint8_t in, bool in_encrypted)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Keystream of crypto1_word() for random keys and inputs, plain
+  *         and encrypted, against the reference model
+  */
+/*============================================================================*/
+static void test_crypto1(void)
+{
+	uint8_t key[MFC_KEY_LEN];
+	crypto1_t cs;
+	uint64_t ref;
+	uint32_t rng = 1;
+	uint32_t in, ks, ks_ref, errors;
+	uint16_t k;
+	uint8_t i, w;
+	bool enc;
+
+	errors = 0;
+	for (k=0; k<TEST_CRYPTO1_KEYS; k++)
+	{
+		ref = 0;
+		for (i=0; i<MFC_KEY_LEN; i++)
+		{
+			key[i] = (uint8_t)test_rand(&rng);
+			ref |= (uint64_t)key[i] << (8*i);
+		}
+		crypto1_init(&cs, key);
+
+		for (w=0; w<32; w++)
+		{
+			in = (w < 16) ? test_rand(&rng):0;
+			enc = (w < 8);
+			ks = crypto1_word(&cs, in, enc);
+			ks_ref = 0;
+			for (i=0; i<32; i++)
+				ks_ref |= (uint32_t)test_ref_bit(&ref, (uint8_t)(in >> (i ^ 24)), enc) << (i ^ 24);
+			if ( ks!=ks_ref )
+				errors++;
+		} // for (w=0; w<32; w++)
+	} // for (k=0; k<TEST_CRYPTO1_KEYS; k++)
+	HOST_CHECK_EQ(errors, 0);
+
+	// The nonce PRNG has a period of 2^16
+	HOST_CHECK_EQ(crypto1_prng_successor(0x01200145U, 65535), 0x01200145U);
+	HOST_CHECK(crypto1_prng_successor(0x01200145U, 64)!=0x01200145U);
+} // static void test_crypto1(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  CRC_A of ISO/IEC 14443-3 and the odd parity of the frames
+  */
+/*============================================================================*/
+static void test_crc(void)
+{
+	static const uint8_t halt[2] = {MFC_CMD_HALT, 0x00};
+	static const uint8_t zero[2] = {0x00, 0x00};
+	mfc_frame_t frame;
+	uint8_t crc[2];
+
+	mfc_crc_a(halt, sizeof(halt), crc);
+	HOST_CHECK_EQ(crc[0], 0x57);
+	HOST_CHECK_EQ(crc[1], 0xCD);
+	mfc_crc_a(zero, sizeof(zero), crc);
+	HOST_CHECK_EQ(crc[0], 0xA0);
+	HOST_CHECK_EQ(crc[1], 0x1E);
+
+	memset(&frame, 0, sizeof(frame));
+	frame.data[0] = 0x00;
+	frame.data[1] = 0x01;
+	frame.data[2] = 0x03;
+	frame.len = 3;
+	mfc_frame_parity(&frame);
+	HOST_CHECK_EQ(frame.par, 0x05); // Odd parity
+	HOST_CHECK(mfc_frame_check_parity(&frame));
+	frame.par ^= 0x04;
+	HOST_CHECK(!mfc_frame_check_parity(&frame));
+} // static void test_crc(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Authentications in a running session, then with a wrong key: the
+  *         card does not answer, and the next authentication selects it
+  *         again
+  */
+/*============================================================================*/
+static void test_auth(void)
+{
+	static const uint8_t uid[4] = {0xDE, 0xAD, 0xBE, 0xEF};
+	static const uint8_t key_wrong[MFC_KEY_LEN] = {0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5};
+	struct timespec t0, t1;
+	mfc_link_t link;
+	mfc_reader_t rd;
+	uint8_t block[MFC_BLOCK_SIZE];
+	uint32_t i, auths;
+	double ns;
+
+	mfc_sim_init(&test_sim, uid, sizeof(uid), 64, 7);
+	mfc_sim_link(&test_sim, &link);
+	mfc_reader_init(&rd, &link, uid, sizeof(uid), 7);
+
+	auths = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i=0; i<TEST_AUTHS; i++)
+	{
+		if ( mfc_reader_auth(&rd, (uint8_t)(4*(i & 0x0F)), MFC_KEYTYPE_A, test_key_default) )
+			auths++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	HOST_CHECK_EQ(auths, TEST_AUTHS);
+	HOST_CHECK_EQ(rd.reselects, 0);
+	ns = (t1.tv_sec - t0.tv_sec)*1e9 + (t1.tv_nsec - t0.tv_nsec);
+	printf("Nested authentication: %.0f ns, reader and card model\n", ns/TEST_AUTHS);
+
+	// Block 0 holds the UID
+	HOST_CHECK(mfc_reader_auth(&rd, 0, MFC_KEYTYPE_B, test_key_default));
+	HOST_CHECK(mfc_reader_read(&rd, 0, block));
+	HOST_CHECK(!memcmp(block, uid, sizeof(uid)));
+
+	HOST_CHECK(!mfc_reader_auth(&rd, 4, MFC_KEYTYPE_A, key_wrong));
+	HOST_CHECK(!rd.authed);
+	HOST_CHECK(!mfc_reader_read(&rd, 4, block));
+	HOST_CHECK(mfc_reader_auth(&rd, 4, MFC_KEYTYPE_A, test_key_default));
+	HOST_CHECK_EQ(rd.reselects, 1);
+	HOST_CHECK(mfc_reader_read(&rd, 5, block));
+} // static void test_auth(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Writes a key dictionary of random keys, FFFFFFFFFFFF first, and
+  *         takes the keys of the cards from its end
+  */
+/*============================================================================*/
+static bool test_dict_make(void)
+{
+	static char text[TEST_DICT_KEYS*14 + 1];
+	uint32_t rng = 0xC1A55;
+	uint32_t i, len;
+	UINT written;
+	FIL fh;
+
+	len = sprintf(text, "FFFFFFFFFFFF\r\n");
+	for (i=1; i<TEST_DICT_KEYS; i++)
+		len += sprintf(&text[len], "%04X%08X\r\n", (unsigned)(test_rand(&rng) & 0xFFFF), (unsigned)test_rand(&rng));
+
+	if ( f_mkdir("NFC")!=FR_OK || f_mkdir("NFC/system")!=FR_OK )
+		return false;
+	if ( f_open(&fh, MFC_DICT_PATH, FA_CREATE_ALWAYS | FA_WRITE)!=FR_OK )
+		return false;
+	if ( f_write(&fh, text, len, &written)!=FR_OK || written!=len || f_close(&fh)!=FR_OK )
+		return false;
+	if ( !mfc_dict_open(&test_dict) )
+		return false;
+
+	for (i=0; i<TEST_CARD_KEYS; i++)
+	{
+		if ( !mfc_dict_get(&test_dict, TEST_DICT_KEYS - 1 - i, test_card_keys[i]) )
+			return false;
+	}
+
+	return true;
+} // static bool test_dict_make(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Reads a whole card of the model: every block must read back as
+  *         the card holds it, with key A of the trailers masked
+  * @param  nested authenticate within the running session
+  * @param  shared_keys keys of the end of the dictionary, else default keys
+  */
+/*============================================================================*/
+static void test_read_card(const S_Test_Layout_t *playout, bool nested, bool shared_keys)
+{
+	static const uint8_t uid[4] = {0x5A, 0x1C, 0x0F, 0x93};
+	uint8_t expect[MFC_BLOCK_SIZE];
+	mfc_link_t link;
+	mfc_reader_t rd;
+	uint32_t attempts, errors;
+	uint16_t s, block, sectors, blocks, first, count;
+
+	mfc_get_layout_from_sak(playout->sak, &sectors, &blocks);
+	HOST_CHECK_EQ(sectors, playout->sectors);
+	HOST_CHECK_EQ(blocks, playout->blocks);
+
+	mfc_sim_init(&test_sim, uid, sizeof(uid), playout->blocks, 3);
+	for (s=0; s<playout->sectors; s++)
+	{
+		first = mfc_sector_to_first_block(s);
+		count = (s < 32) ? 4:16;
+		if ( shared_keys )
+			mfc_sim_set_keys(&test_sim, s, test_card_keys[s ? 1:0], test_card_keys[2]);
+		for (block=(s ? first:1); block<first + count - 1; block++)
+			memset(test_sim.data[block], (uint8_t)(block*7 + 1), MFC_BLOCK_SIZE);
+	} // for (s=0; s<playout->sectors; s++)
+	mfc_sim_link(&test_sim, &link);
+	mfc_reader_init(&rd, &link, uid, sizeof(uid), 3);
+	rd.nested = nested;
+
+	memset(test_dump, 0, sizeof(test_dump));
+	memset(test_valid, 0, sizeof(test_valid));
+	attempts = 0;
+	HOST_CHECK_EQ(mfc_read_card(&rd, &test_dict, sectors, blocks, test_dump, test_valid, &attempts), blocks);
+
+	errors = 0;
+	for (block=0; block<blocks; block++)
+	{
+		memcpy(expect, test_sim.data[block], MFC_BLOCK_SIZE);
+		first = (block < 128) ? (block & ~3U):(block & ~15U);
+		if ( block==first + ((block < 128) ? 3:15) )
+			memset(expect, 0x00, MFC_KEY_LEN);
+		if ( !(test_valid[block >> 3] & (1U << (block & 7)))
+				|| memcmp(expect, &test_dump[block*MFC_BLOCK_SIZE], MFC_BLOCK_SIZE) )
+			errors++;
+	} // for (block=0; block<blocks; block++)
+	HOST_CHECK_EQ(errors, 0);
+	if ( nested )
+		HOST_CHECK_EQ(test_sim.reselects, shared_keys ? test_sim.timeouts:0);
+
+	printf("%u blocks, %s keys, %s: %u auths, %u selections, %u timeouts, air %u ms\n", blocks,
+			shared_keys ? "shared":"default", nested ? "nested auth":"select per auth", rd.auths,
+			test_sim.reselects, test_sim.timeouts, (unsigned)(test_sim.air_ns/1000000U));
+} // static void test_read_card(const S_Test_Layout_t *playout, bool nested, bool shared_keys)
+
+
+
+int main(void)
+{
+	uint8_t i;
+
+	test_crypto1();
+	test_crc();
+	test_auth();
+
+	HOST_CHECK(host_fatfs_mount(TEST_DISK_SECTORS)!=NULL);
+	HOST_CHECK(test_dict_make());
+	for (i=0; i<sizeof(test_layouts)/sizeof(test_layouts[0]); i++)
+	{
+		test_read_card(&test_layouts[i], false, false);
+		test_read_card(&test_layouts[i], true, false);
+		test_read_card(&test_layouts[i], false, true);
+		test_read_card(&test_layouts[i], true, true);
+	}
+	mfc_dict_close(&test_dict);
+	host_fatfs_unmount();
+
+	return host_test_result("nfc_mfc_test");
+} // int main(void)
@@ -0,0 +1,493 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  nfc_storage_test.c
+*
+*  Body parser of the NFC dump files on a FatFs RAM disk, against a model
+*  of the line parser it replaced (str_trim(), sscanf("Page %lu") and
+*  isxdigit() over lines copied by nfcfio_getline(), with the unsigned long
+*  of the 32-bit target): a few lines with known results, then mutated
+*  dumps with long lines, nulls, high bytes, signs and stray labels.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "ff.h"
+#include "nfc_ctx.h"
+#include "nfc_fileio.h"
+#include "nfc_storage.h"
+#include "host_fatfs.h"
+#include "host_port.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_DISK_SECTORS			(16*1024) // 8 MB
+#define TEST_FILENAME				"/fuzz.nfc"
+#define TEST_FILE_MAX				(32*1024)
+#define TEST_FUZZ_FILES				20000
+#define TEST_MUTATIONS_MAX			8
+#define TEST_UNIT_BYTES_MAX			32 // Longest unit data accepted on a line
+
+typedef struct
+{
+	nfc_storage_result_t result;
+	uint8_t dump[NFC_DUMP_BUF_SIZE];
+	uint8_t valid[NFC_VALID_BITS_SIZE];
+	uint32_t max_seen;
+} S_Test_Parse_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+static char test_file[TEST_FILE_MAX];
+static uint32_t test_file_len;
+static uint32_t test_body_start;
+static uint32_t test_seed = 0x2545F491;
+static nfcfio_t test_io;
+static S_Test_Parse_t test_expected, test_parsed;
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static uint32_t test_rand(void)
+{
+	test_seed ^= test_seed << 13;
+	test_seed ^= test_seed >> 17;
+	test_seed ^= test_seed << 5;
+	return test_seed;
+} // static uint32_t test_rand(void)
+
+
+
+static void test_append(const char *text)
+{
+	uint32_t len;
+
+	len = strlen(text);
+	if ( test_file_len + len <= TEST_FILE_MAX )
+	{
+		memcpy(test_file + test_file_len, text, len);
+		test_file_len += len;
+	}
+} // static void test_append(const char *text)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Starts a file with the header of an Ultralight or a Classic dump
+  */
+/*============================================================================*/
+static void test_header(bool classic)
+{
+	test_file_len = 0;
+	test_append("Filetype: M1 NFC device\r\nVersion: 4\r\n");
+	test_append(classic ? "Device type: Classic\r\nUID: 4A 11 22 33\r\nATQA: 04 00\r\nSAK: 08\r\n":
+			"Device type: Ultralight/NTAG\r\nUID: 04 A1 5E 22 7B 6C 80\r\nATQA: 44 00\r\nSAK: 00\r\n");
+	test_body_start = test_file_len;
+} // static void test_header(bool classic)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Writes the file to the RAM disk
+  */
+/*============================================================================*/
+static void test_write_file(void)
+{
+	FIL file;
+	UINT count;
+
+	HOST_CHECK(f_open(&file, TEST_FILENAME, FA_CREATE_ALWAYS | FA_WRITE)==FR_OK);
+	HOST_CHECK(f_write(&file, test_file, test_file_len, &count)==FR_OK && count==test_file_len);
+	HOST_CHECK(f_close(&file)==FR_OK);
+} // static void test_write_file(void)
+
+
+
+static char *test_model_trim(char *s)
+{
+	size_t len;
+
+	while ( *s==' ' || *s=='\t' || *s=='\r' || *s=='\n' )
+		s++;
+	len = strlen(s);
+	while ( len && (s[len - 1]==' ' || s[len - 1]=='\t' || s[len - 1]=='\r' || s[len - 1]=='\n') )
+		s[--len] = '\0';
+
+	return s;
+} // static char *test_model_trim(char *s)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  sscanf("%lu") of the 32-bit target: strtoul() with its sign and
+  *         its saturation
+  */
+/*============================================================================*/
+static bool test_model_index(const char *s, uint32_t *pidx)
+{
+	unsigned long long v;
+	bool neg;
+
+	while ( isspace((unsigned char)*s) )
+		s++;
+	neg = (*s=='-');
+	if ( *s=='+' || *s=='-' )
+		s++;
+	if ( !isdigit((unsigned char)*s) )
+		return false;
+
+	errno = 0;
+	v = strtoull(s, NULL, 10);
+	if ( errno==ERANGE || v > UINT32_MAX )
+		*pidx = UINT32_MAX;
+	else
+		*pidx = neg ? (uint32_t)0 - (uint32_t)v:(uint32_t)v;
+
+	return true;
+} // static bool test_model_index(const char *s, uint32_t *pidx)
+
+
+
+static bool test_model_hex(const char *s, uint8_t *pbytes, uint32_t *plen)
+{
+	uint32_t n;
+	int hi, v;
+
+	n = 0;
+	hi = -1;
+	for (; *s; s++)
+	{
+		if ( *s==' ' || *s=='\t' || *s=='\r' || *s=='\n' )
+			continue;
+		if ( !isxdigit((unsigned char)*s) )
+			return false;
+		v = isdigit((unsigned char)*s) ? *s - '0':(tolower((unsigned char)*s) - 'a' + 10);
+		if ( hi < 0 )
+		{
+			hi = v;
+			continue;
+		}
+		if ( n >= TEST_UNIT_BYTES_MAX )
+			return false;
+		pbytes[n++] = (uint8_t)((hi << 4) | v);
+		hi = -1;
+	} // for (; *s; s++)
+	*plen = n;
+
+	return hi < 0;
+} // static bool test_model_hex(const char *s, uint8_t *pbytes, uint32_t *plen)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Parses the body of the file as the replaced parser did
+  */
+/*============================================================================*/
+static void test_model(uint16_t unit_size, S_Test_Parse_t *pout)
+{
+	char buffer[NFC_LINE_MAX], *line, *colon;
+	uint8_t bytes[TEST_UNIT_BYTES_MAX];
+	uint32_t idx, len, unit_count;
+	int n;
+
+	memset(pout, 0, sizeof(*pout));
+	pout->result = NFC_STORAGE_OK;
+	unit_count = sizeof(pout->dump)/unit_size;
+	HOST_CHECK(nfcfio_open_read(&test_io, TEST_FILENAME));
+	while ( (n = nfcfio_getline(&test_io, buffer, sizeof(buffer)))!=-1 )
+	{
+		if ( n < 0 )
+		{
+			pout->result = NFC_STORAGE_ERR_IO;
+			break;
+		}
+		line = test_model_trim(buffer);
+		if ( strncmp(line, "Block ", 6) && strncmp(line, "Page ", 5) )
+			continue;
+		colon = strchr(line, ':');
+		if ( colon==NULL )
+			continue;
+		*colon = '\0';
+		if ( !test_model_index(line + (line[0]=='B' ? 6:5), &idx) )
+			continue;
+		if ( !test_model_hex(test_model_trim(colon + 1), bytes, &len) )
+		{
+			pout->result = NFC_STORAGE_ERR_FORMAT;
+			break;
+		}
+		if ( idx >= unit_count )
+			continue;
+		memset(bytes + len, 0, sizeof(bytes) - len);
+		memcpy(pout->dump + idx*unit_size, bytes, unit_size);
+		pout->valid[idx/8] |= 1 << (idx%8);
+		if ( idx > pout->max_seen )
+			pout->max_seen = idx;
+	} // while ( (n = nfcfio_getline(&test_io, buffer, sizeof(buffer)))!=-1 )
+	nfcfio_close(&test_io);
+} // static void test_model(uint16_t unit_size, S_Test_Parse_t *pout)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Loads the file with the parser under test
+  */
+/*============================================================================*/
+static void test_parse(S_Test_Parse_t *pout)
+{
+	memset(pout, 0, sizeof(*pout));
+	pout->result = nfc_storage_load_file(TEST_FILENAME, pout->dump, sizeof(pout->dump),
+			pout->valid, sizeof(pout->valid));
+	pout->max_seen = nfc_ctx_get()->dump.max_seen_unit;
+} // static void test_parse(S_Test_Parse_t *pout)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Parses the file with both parsers
+  * @retval true if they agree
+  */
+/*============================================================================*/
+static bool test_compare(bool classic)
+{
+	test_write_file();
+	test_model(classic ? 16:4, &test_expected);
+	test_parse(&test_parsed);
+	if ( test_parsed.result!=test_expected.result )
+		return false;
+	if ( test_parsed.result!=NFC_STORAGE_OK )
+		return true;
+
+	return !memcmp(test_parsed.dump, test_expected.dump, sizeof(test_parsed.dump)) &&
+			!memcmp(test_parsed.valid, test_expected.valid, sizeof(test_parsed.valid)) &&
+			test_parsed.max_seen==test_expected.max_seen;
+} // static bool test_compare(bool classic)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Single lines with known results, after an Ultralight header
+  */
+/*============================================================================*/
+static void test_lines(void)
+{
+	static const struct
+	{
+		const char *line;
+		nfc_storage_result_t result;
+		int32_t page; // Page stored, -1 if none
+		uint8_t data[4];
+	} cases[] =
+	{
+		{"Page 3: 01 02 03 04\r\n", NFC_STORAGE_OK, 3, {0x01, 0x02, 0x03, 0x04}},
+		{"  Page 5:a0B1c2D3  \n", NFC_STORAGE_OK, 5, {0xA0, 0xB1, 0xC2, 0xD3}},
+		{"Page +7 : 11\r\n", NFC_STORAGE_OK, 7, {0x11, 0x00, 0x00, 0x00}},
+		{"Block 9: 00112233 44556677\r\n", NFC_STORAGE_OK, 9, {0x00, 0x11, 0x22, 0x33}},
+		{"Page 2:\r\n", NFC_STORAGE_OK, 2, {0x00, 0x00, 0x00, 0x00}},
+		{"Page -1: 01\r\n", NFC_STORAGE_OK, -1, {0}}, // Wraps past the buffer
+		{"Page 4294967297: 01\r\n", NFC_STORAGE_OK, -1, {0}}, // Saturates
+		{"Page x: 01\r\n", NFC_STORAGE_OK, -1, {0}},
+		{"Page 4 01 02\r\n", NFC_STORAGE_OK, -1, {0}},
+		{"# Page 4: 01\r\n", NFC_STORAGE_OK, -1, {0}},
+		{"Pages 4: 01\r\n", NFC_STORAGE_OK, -1, {0}},
+		{"Page 4: 0\r\n", NFC_STORAGE_ERR_FORMAT, -1, {0}},
+		{"Page 4: 0G\r\n", NFC_STORAGE_ERR_FORMAT, -1, {0}},
+		{"Page 4: 01\xA0\r\n", NFC_STORAGE_ERR_FORMAT, -1, {0}},
+		{"Page 4: 00112233445566778899AABBCCDDEEFF00112233445566778899AABBCCDDEEFF 11\r\n", NFC_STORAGE_ERR_FORMAT, -1, {0}},
+		{"Page 4: 00112233445566778899AABBCCDDEEFF00112233445566778899AABBCCDDEEFF\r\n", NFC_STORAGE_OK, 4, {0x00, 0x11, 0x22, 0x33}},
+	};
+	uint32_t i;
+
+	for (i=0; i<sizeof(cases)/sizeof(cases[0]); i++)
+	{
+		test_header(false);
+		test_append(cases[i].line);
+		test_write_file();
+		test_parse(&test_parsed);
+		HOST_CHECK_EQ(test_parsed.result, cases[i].result);
+		if ( cases[i].page >= 0 )
+		{
+			HOST_CHECK(test_parsed.valid[cases[i].page/8] & (1 << (cases[i].page%8)));
+			HOST_CHECK(!memcmp(test_parsed.dump + cases[i].page*4, cases[i].data, 4));
+			HOST_CHECK_EQ(test_parsed.max_seen, cases[i].page);
+		}
+		else if ( test_parsed.result==NFC_STORAGE_OK )
+		{
+			HOST_CHECK_EQ(test_parsed.valid[0] | test_parsed.valid[1], 0);
+		}
+		HOST_CHECK(test_compare(false));
+	} // for (i=0; i<sizeof(cases)/sizeof(cases[0]); i++)
+} // static void test_lines(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Appends the body of a dump as nfc_profile_save() writes it
+  */
+/*============================================================================*/
+static void test_body(bool classic)
+{
+	char line[80];
+	uint32_t units, unit_size, i, k;
+	int len;
+
+	units = classic ? (test_rand() & 1 ? 256:64):(test_rand()%1024 + 1);
+	unit_size = classic ? 16:4;
+	if ( !classic )
+	{
+		sprintf(line, "Pages: %u\r\n", units);
+		test_append(line);
+	}
+	for (i=0; i<units; i++)
+	{
+		len = sprintf(line, "%s %u:", classic ? "Block":"Page", i);
+		for (k=0; k<unit_size; k++)
+			len += sprintf(line + len, " %02X", test_rand() & 0xFF);
+		strcpy(line + len, "\r\n");
+		test_append(line);
+	}
+} // static void test_body(bool classic)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Mutates the body of the file
+  */
+/*============================================================================*/
+static void test_mutate(void)
+{
+	static const char chars[] = " \t\r\n\v#:+-0123456789abcdefABCDEFxPB\x80\xff";
+	static const char *tokens[] =
+	{
+		"Page ", "Block ", "Page  -", ":", "\r\n", "#", "4294967295", "4294967296",
+		"99999999999999999999", "-4294967295", "+0", "\n\n\n",
+	};
+	uint32_t mutations, pos, len;
+	char token[400];
+
+	mutations = test_rand()%TEST_MUTATIONS_MAX + 1;
+	while ( mutations-- )
+	{
+		if ( test_file_len==test_body_start )
+			return;
+		pos = test_body_start + test_rand()%(test_file_len - test_body_start);
+		switch ( test_rand()%6 )
+		{
+			case 0: // Character changed
+				test_file[pos] = chars[test_rand()%(sizeof(chars) - 1)];
+				continue;
+
+			case 1: // Null byte
+				test_file[pos] = '\0';
+				continue;
+
+			case 2: // Characters deleted
+				len = test_rand()%8 + 1;
+				if ( pos + len > test_file_len )
+					len = test_file_len - pos;
+				memmove(test_file + pos, test_file + pos + len, test_file_len - pos - len);
+				test_file_len -= len;
+				continue;
+
+			case 3: // Label or number
+				strcpy(token, tokens[test_rand()%(sizeof(tokens)/sizeof(tokens[0]))]);
+				break;
+
+			case 4: // Run of spaces or hex digits, past the line buffer
+				len = test_rand()%(sizeof(token) - 1) + 1;
+				memset(token, (test_rand() & 1) ? ' ':'A', len);
+				token[len] = '\0';
+				break;
+
+			default: // Short hex data
+				len = test_rand()%8;
+				token[len] = '\0';
+				while ( len-- )
+					token[len] = "0123456789ABCDEF"[test_rand() & 0x0F];
+				break;
+		} // switch ( test_rand()%6 )
+
+		len = strlen(token);
+		if ( test_file_len + len > TEST_FILE_MAX )
+			continue;
+		memmove(test_file + pos + len, test_file + pos, test_file_len - pos);
+		memcpy(test_file + pos, token, len);
+		test_file_len += len;
+	} // while ( mutations-- )
+} // static void test_mutate(void)
+
+
+
+int main(void)
+{
+	uint32_t i, mismatches, loaded;
+	uint64_t start_us, model_us, parse_us;
+	bool classic;
+
+	HOST_CHECK(host_fatfs_mount(TEST_DISK_SECTORS)!=NULL);
+	nfc_ctx_module_init();
+
+	test_lines();
+
+	mismatches = 0;
+	loaded = 0;
+	for (i=0; i<TEST_FUZZ_FILES; i++)
+	{
+		classic = test_rand() & 1;
+		test_header(classic);
+		test_body(classic);
+		if ( i%8 ) // Some files are left as saved
+			test_mutate();
+		if ( !test_compare(classic) )
+		{
+			if ( mismatches++ < 4 )
+				printf("  file %u: result %d, expected %d\n", i, test_parsed.result, test_expected.result);
+		}
+		if ( test_parsed.result==NFC_STORAGE_OK )
+			loaded++;
+	} // for (i=0; i<TEST_FUZZ_FILES; i++)
+	printf("%u files, %u loaded, %u different from the model\n", TEST_FUZZ_FILES, loaded, mismatches);
+	HOST_CHECK_EQ(mismatches, 0);
+	// Both outcomes are exercised
+	HOST_CHECK(loaded > TEST_FUZZ_FILES/8 && loaded < TEST_FUZZ_FILES - TEST_FUZZ_FILES/8);
+
+	// A full NTAG dump, parsed by both
+	test_header(false);
+	test_body(false);
+	test_write_file();
+	start_us = host_time_us();
+	for (i=0; i<100; i++)
+		test_model(4, &test_expected);
+	model_us = (host_time_us() - start_us)/100;
+	start_us = host_time_us();
+	for (i=0; i<100; i++)
+		test_parse(&test_parsed);
+	parse_us = (host_time_us() - start_us)/100;
+	printf("Dump of %u bytes: %llu us with the model, %llu us to load\n", test_file_len,
+			(unsigned long long)model_us, (unsigned long long)parse_us);
+	HOST_CHECK(test_compare(false));
+
+	host_fatfs_unmount();
+
+	return host_test_result("nfc_storage_test");
+} // int main(void)
@@ -0,0 +1,474 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  nfc_t2t_cache_test.c
+*
+*  Type 2 Tag emulation response cache of nfc_t2t_cache.c against a page by
+*  page reference, which serves READ, FAST_READ, GET_VERSION and WRITE the
+*  way the listener did before the cache. A reader script runs on random
+*  tags whose dump buffer is larger than the dump, with writes past the
+*  dump. The cache built from the NFC context must take the writes the
+*  context takes, and the service time of both paths is reported.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "main.h"
+#include "nfc_ctx.h"
+#include "nfc_mfc.h"
+#include "nfc_t2t_cache.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_ROUNDS					20 // Runs of the reader script per tag
+#define TEST_WRITES					8 // WRITE commands per run
+#define TEST_TX_LEN					192 // TX buffer of the listener
+#define TEST_FAST_READ_PAGES		(T2T_CACHE_FAST_READ_MAX/T2T_CACHE_PAGE_SIZE)
+
+//************************** S T R U C T U R E S *******************************
+
+typedef enum
+{
+	TEST_CMD_READ = 0,
+	TEST_CMD_FAST_READ,
+	TEST_CMD_GET_VERSION,
+	TEST_CMD_WRITE,
+	TEST_CMD_MAX
+} S_Test_Cmd_t;
+
+typedef struct
+{
+	uint16_t unit_count; // Pages of the dump buffer
+	uint16_t max_seen_unit;
+	uint8_t data[T2T_CACHE_PAGES_MAX*T2T_CACHE_PAGE_SIZE];
+	uint8_t version[T2T_CACHE_VERSION_LEN];
+} S_Test_Tag_t;
+
+typedef struct
+{
+	uint16_t pages; // Pages of the dump
+	uint16_t capacity; // Pages of the dump buffer
+} S_Test_Layout_t;
+
+typedef struct
+{
+	uint32_t errors; // Responses which differ
+	uint32_t cmds[TEST_CMD_MAX];
+	uint64_t ns[2][TEST_CMD_MAX]; // Page by page, cache
+} S_Test_Stats_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+static const S_Test_Layout_t test_layouts[] =
+{
+	{45, 45}, // NTAG213
+	{45, 64}, // NTAG213, dump buffer of a longer tag
+	{135, 231},
+	{231, 231}, // NTAG216
+	{231, 256},
+	{256, 256},
+};
+
+static const char *const test_cmd_names[TEST_CMD_MAX] =
+{
+	"READ", "FAST_READ", "GET_VERSION", "WRITE"
+};
+
+static const uint8_t test_version[T2T_CACHE_VERSION_LEN] = {0x00, 0x04, 0x04, 0x02, 0x01, 0x00, 0x13, 0x03};
+
+static S_Test_Tag_t test_tag;
+static t2t_cache_t test_cache;
+static S_Test_Stats_t test_stats;
+static uint8_t test_tx[TEST_TX_LEN + T2T_CACHE_CRC_LEN];
+static uint8_t test_dump[T2T_CACHE_PAGES_MAX*T2T_CACHE_PAGE_SIZE];
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+static uint32_t test_rand(uint32_t *state);
+static uint64_t test_ns(void);
+static uint16_t test_tag_pages(void);
+static bool test_get_page(uint16_t page, uint8_t out[T2T_CACHE_PAGE_SIZE]);
+static uint16_t test_serve_page(const uint8_t *rx);
+static const uint8_t *test_serve_cache(const uint8_t *rx, uint16_t *len);
+static void test_command(S_Test_Cmd_t cmd, const uint8_t *rx);
+static void test_script(const S_Test_Layout_t *playout, uint32_t seed);
+static void test_ctx(void);
+static void test_limits(void);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+// xorshift32
+static uint32_t test_rand(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+} // static uint32_t test_rand(uint32_t *state)
+
+
+
+static uint64_t test_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000U + (uint64_t)ts.tv_nsec;
+} // static uint64_t test_ns(void)
+
+
+
+// Pages of the reference dump, as nfc_ctx_get_t2t_page_count() gives them
+static uint16_t test_tag_pages(void)
+{
+	uint32_t pages = test_tag.max_seen_unit + 1U;
+
+	return (uint16_t)((pages > test_tag.unit_count) ? test_tag.unit_count:pages);
+} // static uint16_t test_tag_pages(void)
+
+
+
+// Page of the reference dump, as nfc_ctx_get_t2t_page() reads it
+static bool test_get_page(uint16_t page, uint8_t out[T2T_CACHE_PAGE_SIZE])
+{
+	if ( page >= test_tag_pages() )
+		return false;
+
+	memcpy(out, &test_tag.data[(uint32_t)page*T2T_CACHE_PAGE_SIZE], T2T_CACHE_PAGE_SIZE);
+	return true;
+} // static bool test_get_page(uint16_t page, uint8_t out[T2T_CACHE_PAGE_SIZE])
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Serves a command page by page into the TX buffer, as the
+  *         listener did, with nfc_ctx_set_t2t_page() for WRITE
+  * @retval Response length, 0 if not answered
+  */
+/*============================================================================*/
+static uint16_t test_serve_page(const uint8_t *rx)
+{
+	uint16_t len, page, pages, end, i;
+
+	len = 0;
+	pages = test_tag_pages();
+	switch ( rx[0] )
+	{
+		case 0x30:
+			for (i=0; i<T2T_CACHE_READ_PAGES; i++)
+			{
+				if ( !test_get_page((uint16_t)(rx[1] + i), &test_tx[len]) )
+					memset(&test_tx[len], 0x00, T2T_CACHE_PAGE_SIZE);
+				len += T2T_CACHE_PAGE_SIZE;
+			}
+			break;
+
+		case 0x3A:
+			if ( rx[2] < rx[1] || rx[1] >= pages )
+				return 0;
+			end = (rx[2] >= pages) ? (uint16_t)(pages - 1U):rx[2];
+			for (page=rx[1]; page<=end && len + T2T_CACHE_PAGE_SIZE <= TEST_TX_LEN; page++)
+			{
+				test_get_page(page, &test_tx[len]);
+				len += T2T_CACHE_PAGE_SIZE;
+			}
+			break;
+
+		case 0x60:
+			memcpy(test_tx, test_tag.version, T2T_CACHE_VERSION_LEN);
+			len = T2T_CACHE_VERSION_LEN;
+			break;
+
+		case 0xA2:
+			if ( rx[1] >= test_tag.unit_count )
+				return 0;
+			memcpy(&test_tag.data[rx[1]*T2T_CACHE_PAGE_SIZE], &rx[2], T2T_CACHE_PAGE_SIZE);
+			if ( rx[1] > test_tag.max_seen_unit )
+				test_tag.max_seen_unit = rx[1];
+			test_tx[0] = 0x0A;
+			len = 1;
+			break;
+
+		default:
+			break;
+	} // switch ( rx[0] )
+
+	return len;
+} // static uint16_t test_serve_page(const uint8_t *rx)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Serves a command from the cache, as the listener does
+  * @retval Response, NULL if not answered
+  */
+/*============================================================================*/
+static const uint8_t *test_serve_cache(const uint8_t *rx, uint16_t *len)
+{
+	static const uint8_t ack = 0x0A;
+
+	switch ( rx[0] )
+	{
+		case 0x30:
+			*len = T2T_CACHE_READ_LEN + T2T_CACHE_CRC_LEN;
+			return t2t_cache_read(&test_cache, rx[1]);
+
+		case 0x3A:
+			return t2t_cache_fast_read(&test_cache, rx[1], rx[2], len);
+
+		case 0x60:
+			return t2t_cache_version(&test_cache, len);
+
+		case 0xA2:
+			if ( !t2t_cache_write(&test_cache, rx[1], &rx[2]) )
+				return NULL;
+			*len = 1;
+			return &ack;
+
+		default:
+			return NULL;
+	} // switch ( rx[0] )
+} // static const uint8_t *test_serve_cache(const uint8_t *rx, uint16_t *len)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Serves a command on both paths and compares the responses. The
+  *         transmitter adds the CRC_A to the page by page READ and
+  *         GET_VERSION responses.
+  */
+/*============================================================================*/
+static void test_command(S_Test_Cmd_t cmd, const uint8_t *rx)
+{
+	const uint8_t *resp;
+	uint64_t t0, t1, t2;
+	uint16_t len_page, len_cache;
+
+	len_cache = 0;
+	t0 = test_ns();
+	len_page = test_serve_page(rx);
+	t1 = test_ns();
+	resp = test_serve_cache(rx, &len_cache);
+	t2 = test_ns();
+
+	test_stats.cmds[cmd]++;
+	test_stats.ns[0][cmd] += t1 - t0;
+	test_stats.ns[1][cmd] += t2 - t1;
+
+	if ( cmd==TEST_CMD_READ || cmd==TEST_CMD_GET_VERSION )
+	{
+		mfc_crc_a(test_tx, len_page, &test_tx[len_page]);
+		len_page += T2T_CACHE_CRC_LEN;
+	}
+	if ( !len_page )
+	{
+		if ( resp )
+			test_stats.errors++;
+	}
+	else if ( !resp || len_cache!=len_page || memcmp(resp, test_tx, len_page) )
+	{
+		test_stats.errors++;
+	}
+} // static void test_command(S_Test_Cmd_t cmd, const uint8_t *rx)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Reader script on a random tag: GET_VERSION, READ of the whole
+  *         buffer, FAST_READ in the longest ranges and past the end, WRITE
+  *         anywhere in the buffer and past it, each followed by a READ
+  */
+/*============================================================================*/
+static void test_script(const S_Test_Layout_t *playout, uint32_t seed)
+{
+	uint32_t rng = seed;
+	uint32_t i;
+	uint16_t round, page;
+	uint8_t rx[6];
+
+	memset(&test_tag, 0, sizeof(test_tag));
+	test_tag.unit_count = playout->capacity;
+	test_tag.max_seen_unit = (uint16_t)(playout->pages - 1U);
+	for (i=0; i<(uint32_t)playout->pages*T2T_CACHE_PAGE_SIZE; i++)
+		test_tag.data[i] = (uint8_t)test_rand(&rng);
+	memcpy(test_tag.version, test_version, sizeof(test_version));
+
+	t2t_cache_build(&test_cache, test_tag_pages(), test_tag.unit_count, test_get_page, test_tag.version,
+			sizeof(test_tag.version));
+	HOST_CHECK_EQ(test_cache.pages, playout->pages);
+	HOST_CHECK_EQ(test_cache.capacity, playout->capacity);
+
+	for (round=0; round<TEST_ROUNDS; round++)
+	{
+		rx[0] = 0x60;
+		test_command(TEST_CMD_GET_VERSION, rx);
+
+		for (page=0; page<T2T_CACHE_PAGES_MAX; page+=T2T_CACHE_READ_PAGES)
+		{
+			rx[0] = 0x30;
+			rx[1] = (uint8_t)page;
+			test_command(TEST_CMD_READ, rx);
+		}
+
+		for (page=0; page<test_tag.unit_count + TEST_FAST_READ_PAGES && page<T2T_CACHE_PAGES_MAX; page+=TEST_FAST_READ_PAGES/2)
+		{
+			rx[0] = 0x3A;
+			rx[1] = (uint8_t)page;
+			rx[2] = (uint8_t)((page + TEST_FAST_READ_PAGES < T2T_CACHE_PAGES_MAX) ? page + TEST_FAST_READ_PAGES:T2T_CACHE_PAGES_MAX - 1);
+			test_command(TEST_CMD_FAST_READ, rx);
+		}
+		rx[1] = 9;
+		rx[2] = 8;
+		test_command(TEST_CMD_FAST_READ, rx);
+
+		// User memory starts at page 4, some writes go past the buffer
+		for (i=0; i<TEST_WRITES; i++)
+		{
+			rx[0] = 0xA2;
+			rx[1] = (uint8_t)(4U + test_rand(&rng) % (T2T_CACHE_PAGES_MAX - 4U));
+			if ( i & 1 )
+				rx[1] = (uint8_t)(4U + test_rand(&rng) % (test_tag.unit_count - 4U));
+			rx[2] = (uint8_t)test_rand(&rng);
+			rx[3] = (uint8_t)test_rand(&rng);
+			rx[4] = (uint8_t)test_rand(&rng);
+			rx[5] = (uint8_t)test_rand(&rng);
+			test_command(TEST_CMD_WRITE, rx);
+
+			rx[0] = 0x30;
+			rx[1] = (uint8_t)(rx[1] - 1U);
+			test_command(TEST_CMD_READ, rx);
+		} // for (i=0; i<TEST_WRITES; i++)
+	} // for (round=0; round<TEST_ROUNDS; round++)
+
+	HOST_CHECK_EQ(test_cache.pages, test_tag_pages());
+} // static void test_script(const S_Test_Layout_t *playout, uint32_t seed)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Cache built from the NFC context as the listener builds it: a
+  *         WRITE past the pages read but inside the dump buffer is kept by
+  *         both and read back, a WRITE past the buffer by neither
+  */
+/*============================================================================*/
+static void test_ctx(void)
+{
+	static const uint8_t data[T2T_CACHE_PAGE_SIZE] = {0xDE, 0xAD, 0xBE, 0xEF};
+	nfc_run_ctx_t *pctx;
+	uint8_t page_data[T2T_CACHE_PAGE_SIZE];
+	uint8_t ver[T2T_CACHE_VERSION_LEN];
+	const uint8_t *resp;
+	uint16_t i;
+
+	nfc_ctx_module_init();
+	pctx = nfc_ctx_get();
+	pctx->head.tech = M1NFC_TECH_A;
+	pctx->head.family = M1NFC_FAM_ULTRALIGHT;
+	for (i=0; i<sizeof(test_dump); i++)
+		test_dump[i] = (i < 45*T2T_CACHE_PAGE_SIZE) ? (uint8_t)(i*13 + 1):0x00;
+	nfc_ctx_set_dump(4, 64, 0, test_dump, NULL, 44, true);
+	nfc_ctx_set_t2t_version(test_version, sizeof(test_version));
+	nfc_ctx_publish();
+	HOST_CHECK_EQ(nfc_ctx_get_t2t_page_count(), 45);
+	HOST_CHECK_EQ(nfc_ctx_get_t2t_page_capacity(), 64);
+
+	t2t_cache_build(&test_cache, nfc_ctx_get_t2t_page_count(), nfc_ctx_get_t2t_page_capacity(),
+			nfc_ctx_get_t2t_page, ver, nfc_ctx_get_t2t_version(ver));
+	HOST_CHECK_EQ(test_cache.pages, 45);
+
+	// As the listener serves a WRITE
+	nfc_ctx_set_t2t_page(50, data);
+	HOST_CHECK(t2t_cache_write(&test_cache, 50, data));
+	HOST_CHECK_EQ(nfc_ctx_get_t2t_page_count(), 51);
+	HOST_CHECK_EQ(test_cache.pages, 51);
+	for (i=44; i<52; i++)
+	{
+		resp = t2t_cache_read(&test_cache, (uint8_t)i);
+		if ( nfc_ctx_get_t2t_page(i, page_data) )
+			HOST_CHECK(!memcmp(resp, page_data, T2T_CACHE_PAGE_SIZE));
+		else
+			HOST_CHECK(i >= 51 && resp[0]==0 && resp[1]==0 && resp[2]==0 && resp[3]==0);
+	}
+	resp = t2t_cache_read(&test_cache, 48);
+	HOST_CHECK(!memcmp(&resp[2*T2T_CACHE_PAGE_SIZE], data, T2T_CACHE_PAGE_SIZE));
+	mfc_crc_a(resp, T2T_CACHE_READ_LEN, page_data);
+	HOST_CHECK(!memcmp(&resp[T2T_CACHE_READ_LEN], page_data, T2T_CACHE_CRC_LEN));
+
+	nfc_ctx_set_t2t_page(64, data);
+	HOST_CHECK(!t2t_cache_write(&test_cache, 64, data));
+	HOST_CHECK_EQ(nfc_ctx_get_t2t_page_count(), 51);
+	HOST_CHECK_EQ(test_cache.pages, 51);
+} // static void test_ctx(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  No dump, no version, a buffer smaller than the dump
+  */
+/*============================================================================*/
+static void test_limits(void)
+{
+	static const uint8_t data[T2T_CACHE_PAGE_SIZE] = {1, 2, 3, 4};
+	const uint8_t *resp;
+	uint16_t len;
+	uint8_t crc[T2T_CACHE_CRC_LEN];
+
+	t2t_cache_build(&test_cache, 0, 0, NULL, NULL, 0);
+	HOST_CHECK(t2t_cache_version(&test_cache, &len)==NULL);
+	HOST_CHECK(t2t_cache_fast_read(&test_cache, 0, 3, &len)==NULL);
+	HOST_CHECK(!t2t_cache_write(&test_cache, 4, data));
+	resp = t2t_cache_read(&test_cache, 0);
+	mfc_crc_a(resp, T2T_CACHE_READ_LEN, crc);
+	HOST_CHECK(resp[0]==0 && !memcmp(&resp[T2T_CACHE_READ_LEN], crc, T2T_CACHE_CRC_LEN));
+
+	// The buffer holds the dump at least
+	test_tag.unit_count = 16;
+	test_tag.max_seen_unit = 15;
+	t2t_cache_build(&test_cache, 16, 8, test_get_page, test_version, sizeof(test_version));
+	HOST_CHECK_EQ(test_cache.capacity, 16);
+	HOST_CHECK(t2t_cache_write(&test_cache, 15, data));
+	HOST_CHECK(!t2t_cache_write(&test_cache, 16, data));
+	HOST_CHECK(t2t_cache_version(&test_cache, &len)!=NULL);
+	HOST_CHECK_EQ(len, T2T_CACHE_VERSION_LEN + T2T_CACHE_CRC_LEN);
+} // static void test_limits(void)
+
+
+
+int main(void)
+{
+	uint8_t i, cmd;
+
+	memset(&test_stats, 0, sizeof(test_stats));
+	for (i=0; i<sizeof(test_layouts)/sizeof(test_layouts[0]); i++)
+		test_script(&test_layouts[i], 1U + i);
+	HOST_CHECK_EQ(test_stats.errors, 0);
+	for (cmd=0; cmd<TEST_CMD_MAX; cmd++)
+	{
+		printf("%s: %u cmds, page by page %u ns, cache %u ns\n", test_cmd_names[cmd], test_stats.cmds[cmd],
+				(unsigned)(test_stats.ns[0][cmd]/test_stats.cmds[cmd]), (unsigned)(test_stats.ns[1][cmd]/test_stats.cmds[cmd]));
+	}
+
+	test_ctx();
+	test_limits();
+
+	return host_test_result("nfc_t2t_cache_test");
+} // int main(void)
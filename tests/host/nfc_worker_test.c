@@ -0,0 +1,341 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  nfc_worker_test.c
+*
+*  NFC worker task of the legacy driver against a model of RFAL and of the
+*  ST25R IRQ line. The process function of the model steps through a poll
+*  cycle: RFAL software timers (guard time, discovery period) and
+*  transceives which end with an IRQ raised by a mock chip thread through
+*  nfc_worker_irq_handler(). The worker must run the process function right
+*  after each IRQ and each timer expiry, without waking up in between, and
+*  must still pick up an IRQ whose edge was lost.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <pthread.h>
+#include <stdio.h>
+#include "main.h"
+#include "m1_tasks.h"
+#include "legacy/nfc_driver.h"
+#include "rfal_nfc.h"
+#include "rfal_rf.h"
+#include "timer.h"
+#include "host_port.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_LOOPS					10 // Poll cycles
+#define TEST_LATE_MAX_US			3000 // IRQ or timer expiry to process call
+#define TEST_LOST_LATE_MAX_US		((NFC_WORKER_WAIT_MAX_MS + 20)*1000U)
+#define TEST_RUN_MAX_US				5000000 // The whole script
+
+//************************** S T R U C T U R E S *******************************
+
+typedef enum
+{
+	TEST_STEP_TIMER = 0, // RFAL software timer, time in ms
+	TEST_STEP_IRQ, // Transceive ended by an IRQ, time in us
+	TEST_STEP_IRQ_LOST // IRQ status set without an edge on the line, time in us
+} S_Test_Step_Type_t;
+
+typedef struct
+{
+	S_Test_Step_Type_t type;
+	uint32_t time;
+} S_Test_Step_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+// One poll cycle: guard time, REQA without answer, REQB, guard time, then the discovery period
+static const S_Test_Step_t test_cycle[] =
+{
+	{TEST_STEP_TIMER, 5},
+	{TEST_STEP_IRQ, 400},
+	{TEST_STEP_IRQ, 1200},
+	{TEST_STEP_TIMER, 1},
+	{TEST_STEP_IRQ, 300},
+	{TEST_STEP_TIMER, 60},
+};
+
+#define TEST_CYCLE_STEPS			(sizeof(test_cycle)/sizeof(test_cycle[0]))
+#define TEST_STEPS					(TEST_LOOPS*TEST_CYCLE_STEPS + 1) // And the lost IRQ
+
+static const S_Test_Step_t test_step_lost = {TEST_STEP_IRQ_LOST, 500};
+
+static volatile uint32_t test_step; // Step the process function waits for
+static volatile bool test_deinit;
+static volatile bool test_chip_run;
+static volatile bool test_irq_status; // IRQ status of the chip, read by st25r3916Isr()
+static volatile uint64_t test_irq_at_us; // Pending IRQ of the chip, 0 if none
+static volatile uint64_t test_irq_us; // Last IRQ status set
+static volatile bool test_irq_edge; // The pending IRQ raises the line
+static bool test_irq_seen;
+static uint32_t test_timer;
+static uint64_t test_due_us;
+
+static uint32_t test_calls; // Process calls
+static uint32_t test_timer_steps;
+static uint32_t test_irq_steps;
+static uint64_t test_late_max_us[3];
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+static const S_Test_Step_t *test_step_get(uint32_t step);
+static void test_step_start(void);
+static void *test_chip_task(void *argument);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static const S_Test_Step_t *test_step_get(uint32_t step)
+{
+	if ( step < TEST_LOOPS*TEST_CYCLE_STEPS )
+		return &test_cycle[step % TEST_CYCLE_STEPS];
+
+	return &test_step_lost;
+} // static const S_Test_Step_t *test_step_get(uint32_t step)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Starts the RFAL timer or arms the IRQ of the mock chip
+  */
+/*============================================================================*/
+static void test_step_start(void)
+{
+	const S_Test_Step_t *pstep;
+
+	if ( test_step >= TEST_STEPS )
+		return;
+
+	pstep = test_step_get(test_step);
+	if ( pstep->type==TEST_STEP_TIMER )
+	{
+		// timerIsExpired() turns true in the tick after the expiry
+		test_timer = platformTimerCreate((uint16_t)pstep->time);
+		test_due_us = ((uint64_t)test_timer + 1)*1000U;
+		test_timer_steps++;
+	}
+	else
+	{
+		test_irq_seen = false;
+		test_irq_edge = (pstep->type==TEST_STEP_IRQ);
+		test_irq_at_us = host_time_us() + pstep->time;
+		test_irq_steps++;
+	}
+} // static void test_step_start(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Mock chip: sets the IRQ status when the transceive ends and, but
+  *         for a lost edge, raises the IRQ line
+  */
+/*============================================================================*/
+static void *test_chip_task(void *argument)
+{
+	uint64_t now;
+
+	(void)argument;
+	while ( test_chip_run )
+	{
+		now = host_time_us();
+		if ( test_irq_at_us && now >= test_irq_at_us )
+		{
+			test_irq_at_us = 0;
+			test_irq_us = now;
+			if ( test_irq_edge )
+			{
+				host_isr_enter();
+				nfc_worker_irq_handler();
+				host_isr_exit();
+			}
+			else
+			{
+				test_irq_status = true;
+			}
+		} // if ( test_irq_at_us && now >= test_irq_at_us )
+		host_sleep_us(20);
+	} // while ( test_chip_run )
+
+	return NULL;
+} // static void *test_chip_task(void *argument)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  RFAL and the ST25R as the worker sees them
+  */
+/*============================================================================*/
+void st25r3916Isr(void)
+{
+	test_irq_status = true;
+} // void st25r3916Isr(void)
+
+
+
+rfalNfcState rfalNfcGetState(void)
+{
+	// Every step taken is a change of state
+	return (test_step & 1) ? RFAL_NFC_STATE_POLL_COLAVOIDANCE:RFAL_NFC_STATE_POLL_TECHDETECT;
+} // rfalNfcState rfalNfcGetState(void)
+
+
+
+rfalTransceiveState rfalGetTransceiveState(void)
+{
+	if ( test_step < TEST_STEPS && test_step_get(test_step)->type!=TEST_STEP_TIMER )
+		return RFAL_TXRX_STATE_RX_WAIT_RXS;
+
+	return RFAL_TXRX_STATE_IDLE;
+} // rfalTransceiveState rfalGetTransceiveState(void)
+
+
+
+void NFC_Polling_Init(void)
+{
+	test_step = 0;
+	test_step_start();
+} // void NFC_Polling_Init(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Takes the step waited for if it is due and starts the next one,
+  *         as rfalNfcWorker() would
+  */
+/*============================================================================*/
+void NFC_Polling_Process(void)
+{
+	const S_Test_Step_t *pstep;
+	uint64_t late_us;
+
+	test_calls++;
+	if ( test_step >= TEST_STEPS )
+		return;
+
+	pstep = test_step_get(test_step);
+	if ( pstep->type==TEST_STEP_TIMER )
+	{
+		if ( !platformTimerIsExpired(test_timer) )
+			return;
+		late_us = host_time_us() - test_due_us;
+	}
+	else
+	{
+		if ( !test_irq_status )
+			return;
+		test_irq_status = false;
+		late_us = host_time_us() - test_irq_us;
+	}
+	if ( late_us < (1ULL << 63) && late_us > test_late_max_us[pstep->type] )
+		test_late_max_us[pstep->type] = late_us;
+
+	test_step++;
+	test_step_start();
+} // void NFC_Polling_Process(void)
+
+
+
+void NFC_Polling_DeInit(void)
+{
+	test_deinit = true;
+} // void NFC_Polling_DeInit(void)
+
+
+
+void NFC_Listening_Init(void)
+{
+} // void NFC_Listening_Init(void)
+
+
+
+void NFC_Listening_Process(void)
+{
+} // void NFC_Listening_Process(void)
+
+
+
+void NFC_Listening_DeInit(void)
+{
+} // void NFC_Listening_DeInit(void)
+
+
+
+void m1_wdt_reset(void)
+{
+} // void m1_wdt_reset(void)
+
+
+
+void m1_led_fast_blink(uint8_t r_g_b, uint8_t pwm_rgb, uint8_t on_off_ms)
+{
+	(void)r_g_b;
+	(void)pwm_rgb;
+	(void)on_off_ms;
+} // void m1_led_fast_blink(uint8_t r_g_b, uint8_t pwm_rgb, uint8_t on_off_ms)
+
+
+
+int main(void)
+{
+	S_M1_Main_Q_t q_item;
+	pthread_t chip;
+	uint64_t t_start;
+	nfc_worker_stats_t stats;
+
+	host_periph_map();
+	nfc_worker_q_hdl = xQueueCreate(10, sizeof(S_M1_Main_Q_t));
+	HOST_CHECK(nfc_worker_q_hdl!=NULL);
+	HOST_CHECK(xTaskCreate(nfc_worker_task, "nfc_worker", 1024, NULL, 2, &nfc_worker_task_hdl)==pdPASS);
+
+	test_chip_run = true;
+	pthread_create(&chip, NULL, test_chip_task, NULL);
+
+	t_start = host_time_us();
+	q_item.q_evt_type = Q_EVENT_NFC_START_READ;
+	xQueueSend(nfc_worker_q_hdl, &q_item, 0);
+	while ( test_step < TEST_STEPS && host_time_us() - t_start < TEST_RUN_MAX_US )
+		host_sleep_us(1000);
+	HOST_CHECK_EQ(test_step, TEST_STEPS);
+
+	q_item.q_evt_type = Q_EVENT_NFC_READ_COMPLETE;
+	xQueueSend(nfc_worker_q_hdl, &q_item, 0);
+	while ( !test_deinit && host_time_us() - t_start < TEST_RUN_MAX_US )
+		host_sleep_us(1000);
+	HOST_CHECK(test_deinit);
+	test_chip_run = false;
+	pthread_join(chip, NULL);
+
+	stats = nfc_worker_stats;
+	printf("%u steps in %u ms: %u process calls, %u IRQs, wakeups %u IRQ / %u timeout, %u reruns\n",
+			(unsigned)TEST_STEPS, (unsigned)((host_time_us() - t_start)/1000), test_calls, stats.irqs,
+			stats.wakeups_irq, stats.wakeups_timer, stats.reruns);
+	printf("Late: timer %u us, IRQ %u us, lost IRQ %u us\n", (unsigned)test_late_max_us[TEST_STEP_TIMER],
+			(unsigned)test_late_max_us[TEST_STEP_IRQ], (unsigned)test_late_max_us[TEST_STEP_IRQ_LOST]);
+
+	HOST_CHECK(test_late_max_us[TEST_STEP_TIMER] <= TEST_LATE_MAX_US);
+	HOST_CHECK(test_late_max_us[TEST_STEP_IRQ] <= TEST_LATE_MAX_US);
+	HOST_CHECK(test_late_max_us[TEST_STEP_IRQ_LOST] <= TEST_LOST_LATE_MAX_US);
+	HOST_CHECK_EQ(stats.irqs, TEST_LOOPS*3);
+	// One wakeup per timer, another one if it came before the tick, one for the lost IRQ
+	HOST_CHECK(stats.wakeups_timer <= 2*test_timer_steps + 1);
+	HOST_CHECK(stats.wakeups_irq <= stats.irqs);
+	// A call to take each step, a rerun to find the next one not due, a few early wakeups
+	HOST_CHECK(test_calls <= 2*TEST_STEPS + test_timer_steps + 2);
+	HOST_CHECK_EQ(test_irq_steps + test_timer_steps, TEST_STEPS);
+
+	return host_test_result("nfc_worker_test");
+} // int main(void)
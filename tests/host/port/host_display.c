@@ -0,0 +1,106 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_display.c
+*
+*  Display of the host build: the u8g2 frame buffer of m1_lcd.c without
+*  the LCD, the file browser icons of m1_display.c, and the dialogs that
+*  wait for the user
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include "u8g2.h"
+#include "m1_display.h"
+#include "m1_virtual_kb.h"
+
+//************************** C O N S T A N T **********************************/
+
+const S_M1_menu_icon_data menu_fb_icon_prev = {fb_m1_icon_folder, 10, 8};
+const S_M1_menu_icon_data menu_fb_icon_dir = {fb_m1_icon_folder, 10, 8};
+const S_M1_menu_icon_data menu_fb_icon_text = {fb_m1_icon_file, 10, 8};
+const S_M1_menu_icon_data menu_fb_icon_data = {fb_m1_icon_file, 10, 8};
+const S_M1_menu_icon_data menu_fb_icon_other = {fb_m1_icon_file, 10, 8};
+
+/*
+ * Font without glyphs: a 23 byte u8g2 font header and an empty glyph table.
+ * The font tables of u8g2 are not part of the tree, and text drawn on the
+ * host is never looked at.
+ */
+const uint8_t host_u8g2_font_blank[] =
+{
+	0, 0, 2, 2, 4, 4, 4, 4, 5, 8, 8, 0, 0, 7, 0, 7, 0, // Glyph count, bits per field, bounding box
+	0, 0, 0, 0, 0, 0, // Start of A, a and of the unicode table
+	0, 0, // End of the glyph table
+	0, 0, 0, 0 // Empty unicode lookup table
+};
+
+/***************************** V A R I A B L E S ******************************/
+
+u8g2_t m1_u8g2;
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static uint8_t host_u8x8_byte(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr)
+{
+	(void)u8x8;
+	(void)msg;
+	(void)arg_int;
+	(void)arg_ptr;
+	return 1;
+} // static uint8_t host_u8x8_byte(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr)
+
+
+
+void m1_u8g2_firstpage(void)
+{
+	static uint8_t setup_done;
+
+	if ( !setup_done )
+	{
+		u8g2_Setup_st7567_enh_dg128064i_f(&m1_u8g2, U8G2_R2, host_u8x8_byte, host_u8x8_byte);
+		setup_done = 1;
+	}
+	u8g2_ClearBuffer(&m1_u8g2);
+	u8g2_SetBufferCurrTileRow(&m1_u8g2, 0);
+} // void m1_u8g2_firstpage(void)
+
+
+
+uint8_t m1_u8g2_nextpage(void)
+{
+	return 0;
+} // uint8_t m1_u8g2_nextpage(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Message boxes and the virtual keyboard wait for a key that never
+  *         comes on the host: the box is closed with the first button, and
+  *         the keyboard is left without a name.
+  */
+/*============================================================================*/
+uint8_t m1_message_box(u8g2_t *u8g2, const char *title1, const char *title2, const char *title3, const char *buttons)
+{
+	(void)u8g2;
+	(void)title1;
+	(void)title2;
+	(void)title3;
+	(void)buttons;
+	return 0;
+} // uint8_t m1_message_box(u8g2_t *u8g2, const char *title1, const char *title2, const char *title3, const char *buttons)
+
+
+
+uint8_t m1_vkb_get_filename(char *description, char *default_name, char *new_name)
+{
+	(void)description;
+	(void)default_name;
+	new_name[0] = '\0';
+	return 0;
+} // uint8_t m1_vkb_get_filename(char *description, char *default_name, char *new_name)
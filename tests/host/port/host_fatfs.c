@@ -0,0 +1,277 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_fatfs.c
+*
+*  RAM disk driver linked to FatFs with FATFS_LinkDriver(), as the SD card
+*  driver of m1_sdcard.c is on the target
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "ff_gen_drv.h"
+#include "host_port.h"
+#include "host_fatfs.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define HOST_DISK_SECTOR_SIZE		512
+#define HOST_DISK_BLOCK_SIZE		64 // Erase block, sectors
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+static DSTATUS host_disk_initialize(BYTE lun);
+static DSTATUS host_disk_status(BYTE lun);
+static DRESULT host_disk_read(BYTE lun, BYTE *buff, DWORD sector, UINT count);
+static DRESULT host_disk_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count);
+static DRESULT host_disk_ioctl(BYTE lun, BYTE cmd, void *buff);
+static uint32_t host_disk_fat_sectors(DWORD sector, UINT count);
+
+//************************** C O N S T A N T **********************************/
+
+static const Diskio_drvTypeDef host_disk_driver =
+{
+	host_disk_initialize,
+	host_disk_status,
+	host_disk_read,
+	host_disk_write,
+	host_disk_ioctl
+};
+
+/***************************** V A R I A B L E S ******************************/
+
+static uint8_t *host_disk;
+static uint32_t host_disk_sectors;
+static char host_disk_path[4];
+static FATFS host_fatfs;
+static S_Host_Disk_Stats_t host_disk_stats;
+static uint32_t host_disk_command_us, host_disk_sector_us;
+static uint32_t host_disk_writes_left = UINT32_MAX;
+static uint32_t host_fatfs_mounts;
+static pthread_mutex_t host_disk_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+/*============================================================================*/
+/**
+  * @brief  Returns how many sectors of a transfer are in the FATs of the
+  *         mounted volume
+  */
+/*============================================================================*/
+static uint32_t host_disk_fat_sectors(DWORD sector, UINT count)
+{
+	LBA_t first, end;
+
+	if ( !host_fatfs.fs_type )
+		return 0; // Not mounted yet, or f_mkfs
+	first = (sector > host_fatfs.fatbase) ? sector:host_fatfs.fatbase;
+	end = host_fatfs.fatbase + (LBA_t)host_fatfs.fsize*host_fatfs.n_fats;
+	if ( (LBA_t)sector + count < end )
+		end = (LBA_t)sector + count;
+
+	return (end > first) ? (end - first):0;
+} // static uint32_t host_disk_fat_sectors(DWORD sector, UINT count)
+
+
+
+
+static DSTATUS host_disk_initialize(BYTE lun)
+{
+	(void)lun;
+	return host_disk ? 0:STA_NOINIT;
+} // static DSTATUS host_disk_initialize(BYTE lun)
+
+
+
+static DSTATUS host_disk_status(BYTE lun)
+{
+	(void)lun;
+	return host_disk ? 0:STA_NODISK;
+} // static DSTATUS host_disk_status(BYTE lun)
+
+
+
+static DRESULT host_disk_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+	uint32_t busy_us;
+
+	(void)lun;
+	if ( sector + count > host_disk_sectors )
+		return RES_PARERR;
+
+	pthread_mutex_lock(&host_disk_lock);
+	memcpy(buff, &host_disk[sector*HOST_DISK_SECTOR_SIZE], count*HOST_DISK_SECTOR_SIZE);
+	host_disk_stats.reads++;
+	host_disk_stats.sectors_read += count;
+	host_disk_stats.fat_sectors_read += host_disk_fat_sectors(sector, count);
+	busy_us = host_disk_command_us + count*host_disk_sector_us;
+	host_disk_stats.busy_us += busy_us;
+	pthread_mutex_unlock(&host_disk_lock);
+	if ( busy_us )
+		host_sleep_us(busy_us);
+
+	return RES_OK;
+} // static DRESULT host_disk_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+
+
+
+static DRESULT host_disk_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+	DRESULT res;
+	UINT n;
+	uint32_t busy_us;
+
+	(void)lun;
+	if ( sector + count > host_disk_sectors )
+		return RES_PARERR;
+
+	pthread_mutex_lock(&host_disk_lock);
+	n = (count > host_disk_writes_left) ? host_disk_writes_left:count;
+	memcpy(&host_disk[sector*HOST_DISK_SECTOR_SIZE], buff, n*HOST_DISK_SECTOR_SIZE);
+	if ( host_disk_writes_left!=UINT32_MAX )
+		host_disk_writes_left -= n;
+	res = (n==count) ? RES_OK:RES_ERROR;
+	host_disk_stats.writes++;
+	host_disk_stats.sectors_written += n;
+	host_disk_stats.fat_sectors_written += host_disk_fat_sectors(sector, n);
+	busy_us = host_disk_command_us + count*host_disk_sector_us;
+	host_disk_stats.busy_us += busy_us;
+	pthread_mutex_unlock(&host_disk_lock);
+	if ( busy_us )
+		host_sleep_us(busy_us);
+
+	return res;
+} // static DRESULT host_disk_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+
+
+
+static DRESULT host_disk_ioctl(BYTE lun, BYTE cmd, void *buff)
+{
+	(void)lun;
+	switch ( cmd )
+	{
+		case CTRL_SYNC:
+			host_disk_stats.syncs++;
+			return RES_OK;
+
+		case GET_SECTOR_COUNT:
+			*(DWORD *)buff = host_disk_sectors;
+			return RES_OK;
+
+		case GET_SECTOR_SIZE:
+			*(WORD *)buff = HOST_DISK_SECTOR_SIZE;
+			return RES_OK;
+
+		case GET_BLOCK_SIZE:
+			*(DWORD *)buff = HOST_DISK_BLOCK_SIZE;
+			return RES_OK;
+
+		default:
+			return RES_PARERR;
+	} // switch ( cmd )
+} // static DRESULT host_disk_ioctl(BYTE lun, BYTE cmd, void *buff)
+
+
+
+FATFS *host_fatfs_mount(uint32_t sectors)
+{
+	static const MKFS_PARM mkfs_opt = {FM_ANY | FM_SFD, 0, 0, 0, 0};
+	BYTE *pwork;
+	FRESULT res;
+
+	host_fatfs_unmount();
+	free(host_disk);
+	host_disk = calloc(sectors, HOST_DISK_SECTOR_SIZE);
+	if ( host_disk==NULL )
+		return NULL;
+	host_disk_sectors = sectors;
+	if ( !host_disk_path[0] && FATFS_LinkDriver(&host_disk_driver, host_disk_path) )
+		return NULL;
+
+	host_disk_fail_clear();
+	pwork = malloc(FF_MAX_SS*8);
+	res = f_mkfs(host_disk_path, &mkfs_opt, pwork, FF_MAX_SS*8);
+	free(pwork);
+	if ( res!=FR_OK )
+		return NULL;
+
+	return host_fatfs_remount();
+} // FATFS *host_fatfs_mount(uint32_t sectors)
+
+
+
+FATFS *host_fatfs_remount(void)
+{
+	host_disk_fail_clear();
+	f_mount(NULL, host_disk_path, 0);
+	host_fatfs_mounts++;
+	if ( f_mount(&host_fatfs, host_disk_path, 1)!=FR_OK )
+		return NULL;
+
+	return &host_fatfs;
+} // FATFS *host_fatfs_remount(void)
+
+
+
+void host_fatfs_unmount(void)
+{
+	if ( host_disk_path[0] )
+		f_mount(NULL, host_disk_path, 0);
+	host_fatfs_mounts++;
+} // void host_fatfs_unmount(void)
+
+
+
+uint32_t host_fatfs_get_mount_count(void)
+{
+	return host_fatfs_mounts;
+} // uint32_t host_fatfs_get_mount_count(void)
+
+
+
+void host_disk_set_timing(uint32_t command_us, uint32_t sector_us)
+{
+	host_disk_command_us = command_us;
+	host_disk_sector_us = sector_us;
+} // void host_disk_set_timing(uint32_t command_us, uint32_t sector_us)
+
+
+
+void host_disk_stats_reset(void)
+{
+	pthread_mutex_lock(&host_disk_lock);
+	memset(&host_disk_stats, 0, sizeof(host_disk_stats));
+	pthread_mutex_unlock(&host_disk_lock);
+} // void host_disk_stats_reset(void)
+
+
+
+void host_disk_stats_get(S_Host_Disk_Stats_t *pstats)
+{
+	pthread_mutex_lock(&host_disk_lock);
+	*pstats = host_disk_stats;
+	pthread_mutex_unlock(&host_disk_lock);
+} // void host_disk_stats_get(S_Host_Disk_Stats_t *pstats)
+
+
+
+void host_disk_fail_writes_after(uint32_t n)
+{
+	pthread_mutex_lock(&host_disk_lock);
+	host_disk_writes_left = n;
+	pthread_mutex_unlock(&host_disk_lock);
+} // void host_disk_fail_writes_after(uint32_t n)
+
+
+
+void host_disk_fail_clear(void)
+{
+	host_disk_fail_writes_after(UINT32_MAX);
+} // void host_disk_fail_clear(void)
@@ -0,0 +1,313 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_hal.c
+*
+*  HAL services of the host build: time base, GPIO model, peripheral
+*  register pages, and interrupt controller calls
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "stm32h5xx_hal.h"
+#include "host_port.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define HOST_GPIO_PORTS		16
+#define HOST_PERIPH_PAGE	0x1000UL
+
+//************************** S T R U C T U R E S *******************************
+
+typedef struct
+{
+	GPIO_TypeDef *port;
+	uint16_t level; // One bit per pin
+} S_Host_Gpio_Port_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+uint32_t SystemCoreClock = 250000000;
+
+static S_Host_Gpio_Port_t host_gpio_ports[HOST_GPIO_PORTS];
+static pthread_mutex_t host_gpio_lock = PTHREAD_MUTEX_INITIALIZER;
+static host_gpio_hook_t host_gpio_hook;
+static host_gpio_read_hook_t host_gpio_read_hook;
+static pthread_once_t host_periph_once = PTHREAD_ONCE_INIT;
+static volatile bool host_periph_mapped = false;
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+static S_Host_Gpio_Port_t *host_gpio_port(GPIO_TypeDef *port);
+static void host_periph_map_page(uintptr_t address);
+static void host_periph_map_once(void);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+uint32_t HAL_GetTick(void)
+{
+	return (uint32_t)(host_time_us()/1000);
+} // uint32_t HAL_GetTick(void)
+
+
+
+void HAL_Delay(uint32_t Delay)
+{
+	host_sleep_us(Delay*1000);
+} // void HAL_Delay(uint32_t Delay)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Finds or adds the state of a GPIO port, with host_gpio_lock held
+  */
+/*============================================================================*/
+static S_Host_Gpio_Port_t *host_gpio_port(GPIO_TypeDef *port)
+{
+	uint8_t i;
+
+	for (i=0; i<HOST_GPIO_PORTS; i++)
+	{
+		if ( host_gpio_ports[i].port==port )
+			return &host_gpio_ports[i];
+		if ( host_gpio_ports[i].port==NULL )
+		{
+			host_gpio_ports[i].port = port;
+			return &host_gpio_ports[i];
+		}
+	} // for (i=0; i<HOST_GPIO_PORTS; i++)
+
+	return &host_gpio_ports[HOST_GPIO_PORTS - 1];
+} // static S_Host_Gpio_Port_t *host_gpio_port(GPIO_TypeDef *port)
+
+
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	S_Host_Gpio_Port_t *pport;
+	host_gpio_hook_t hook;
+
+	pthread_mutex_lock(&host_gpio_lock);
+	pport = host_gpio_port(GPIOx);
+	if ( PinState==GPIO_PIN_SET )
+		pport->level |= GPIO_Pin;
+	else
+		pport->level &= ~GPIO_Pin;
+	hook = host_gpio_hook;
+	pthread_mutex_unlock(&host_gpio_lock);
+
+	if ( hook )
+		hook(GPIOx, GPIO_Pin, PinState);
+} // void HAL_GPIO_WritePin(...)
+
+
+
+GPIO_PinState HAL_GPIO_ReadPin(const GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	GPIO_PinState state;
+	host_gpio_read_hook_t hook;
+
+	pthread_mutex_lock(&host_gpio_lock);
+	state = (host_gpio_port((GPIO_TypeDef *)GPIOx)->level & GPIO_Pin) ? GPIO_PIN_SET:GPIO_PIN_RESET;
+	hook = host_gpio_read_hook;
+	pthread_mutex_unlock(&host_gpio_lock);
+
+	if ( hook )
+		state = hook((void *)GPIOx, GPIO_Pin, state) ? GPIO_PIN_SET:GPIO_PIN_RESET;
+
+	return state;
+} // GPIO_PinState HAL_GPIO_ReadPin(const GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+
+
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	HAL_GPIO_WritePin(GPIOx, GPIO_Pin, HAL_GPIO_ReadPin(GPIOx, GPIO_Pin) ? GPIO_PIN_RESET:GPIO_PIN_SET);
+} // void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+
+
+
+void host_gpio_set_input(void *port, uint16_t pin, uint8_t state)
+{
+	S_Host_Gpio_Port_t *pport;
+
+	pthread_mutex_lock(&host_gpio_lock);
+	pport = host_gpio_port(port);
+	if ( state )
+		pport->level |= pin;
+	else
+		pport->level &= ~pin;
+	pthread_mutex_unlock(&host_gpio_lock);
+} // void host_gpio_set_input(void *port, uint16_t pin, uint8_t state)
+
+
+
+void host_gpio_set_hook(host_gpio_hook_t hook)
+{
+	pthread_mutex_lock(&host_gpio_lock);
+	host_gpio_hook = hook;
+	pthread_mutex_unlock(&host_gpio_lock);
+} // void host_gpio_set_hook(host_gpio_hook_t hook)
+
+
+
+void host_gpio_set_read_hook(host_gpio_read_hook_t hook)
+{
+	pthread_mutex_lock(&host_gpio_lock);
+	host_gpio_read_hook = hook;
+	pthread_mutex_unlock(&host_gpio_lock);
+} // void host_gpio_set_read_hook(host_gpio_read_hook_t hook)
+
+
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, const GPIO_InitTypeDef *pGPIO_Init)
+{
+	(void)GPIOx;
+	(void)pGPIO_Init;
+} // void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, const GPIO_InitTypeDef *pGPIO_Init)
+
+
+
+void HAL_GPIO_DeInit(GPIO_TypeDef *GPIOx, uint32_t GPIO_Pin)
+{
+	(void)GPIOx;
+	(void)GPIO_Pin;
+} // void HAL_GPIO_DeInit(GPIO_TypeDef *GPIOx, uint32_t GPIO_Pin)
+
+
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+	(void)IRQn;
+	(void)PreemptPriority;
+	(void)SubPriority;
+} // void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Maps one page of RAM at the address of a peripheral
+  */
+/*============================================================================*/
+static void host_periph_map_page(uintptr_t address)
+{
+	void *page;
+
+	address &= ~(HOST_PERIPH_PAGE - 1);
+	page = mmap((void *)address, HOST_PERIPH_PAGE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if ( page!=(void *)address )
+	{
+		fprintf(stderr, "host_periph_map(): no page at 0x%lx\n", (unsigned long)address);
+		abort();
+	}
+} // static void host_periph_map_page(uintptr_t address)
+
+
+
+static void host_periph_map_once(void)
+{
+	host_periph_map_page(EXTI_BASE);
+	host_periph_map_page(SCS_BASE);
+	host_periph_map_page(DWT_BASE);
+	host_periph_mapped = true;
+} // static void host_periph_map_once(void)
+
+
+
+void host_periph_map(void)
+{
+	pthread_once(&host_periph_once, host_periph_map_once);
+} // void host_periph_map(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  The enable bits are only kept once the system control space is
+  *         mapped. ISER is set-only on the target, so the bit is set and
+  *         cleared here rather than written.
+  */
+/*============================================================================*/
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+	if ( host_periph_mapped && (IRQn >= 0) )
+		__atomic_fetch_or(&NVIC->ISER[IRQn >> 5], 1UL << (IRQn & 0x1F), __ATOMIC_SEQ_CST);
+} // void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  On the target, the interrupt is not running once a task disables
+  *         it. The bit is cleared with the interrupts masked, after the end
+  *         of a handler that runs on another thread.
+  */
+/*============================================================================*/
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+	uint32_t primask;
+
+	if ( host_periph_mapped && (IRQn >= 0) )
+	{
+		primask = __get_PRIMASK();
+		__disable_irq();
+		__atomic_fetch_and(&NVIC->ISER[IRQn >> 5], ~(1UL << (IRQn & 0x1F)), __ATOMIC_SEQ_CST);
+		__set_PRIMASK(primask);
+	}
+} // void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  m1_core_config.c reads the SCB to tell an ISR from a task, the C
+  *         library of the host is thread safe anyway
+  */
+/*============================================================================*/
+void *malloc_critical(size_t size)
+{
+	return malloc(size);
+} // void *malloc_critical(size_t size)
+
+
+
+void *calloc_critical(size_t num, size_t size)
+{
+	return calloc(num, size);
+} // void *calloc_critical(size_t num, size_t size)
+
+
+
+void free_critical(void *mem)
+{
+	free(mem);
+} // void free_critical(void *mem)
+
+
+
+void assert_failed(uint8_t *file, uint32_t line)
+{
+	fprintf(stderr, "assert_param() failed: %s:%u\n", (char *)file, line);
+	abort();
+} // void assert_failed(uint8_t *file, uint32_t line)
+
+
+
+void Error_Handler(void)
+{
+	fprintf(stderr, "Error_Handler()\n");
+	abort();
+} // void Error_Handler(void)
@@ -0,0 +1,247 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_lfrfid.c
+*
+*  Timer, DMA and clock calls of the LF RFID read, write and emulation
+*  paths, and the application queue they post to. The timers and DMA
+*  channels do nothing: the host tests feed the capture events and read the
+*  emulation tables themselves.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include "stm32h5xx_hal.h"
+#include "m1_tasks.h"
+#include "m1_lib.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define HOST_LFRFID_PCLK1_HZ		250000000 // APB1 is not divided
+
+/***************************** V A R I A B L E S ******************************/
+
+QueueHandle_t main_q_hdl = NULL;
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+void m1_app_send_q_message(QueueHandle_t Handle, S_M1_Q_Event_Type_t cmd)
+{
+	S_M1_Main_Q_t q_item;
+
+	if ( Handle==NULL ) // No application task in the test
+		return;
+	q_item.q_evt_type = cmd;
+	xQueueSend(Handle, &q_item, portMAX_DELAY);
+} // void m1_app_send_q_message(QueueHandle_t Handle, S_M1_Q_Event_Type_t cmd)
+
+
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+	return HOST_LFRFID_PCLK1_HZ;
+} // uint32_t HAL_RCC_GetPCLK1Freq(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Timers
+  */
+/*============================================================================*/
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim)
+{
+	htim->State = HAL_TIM_STATE_READY;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim)
+
+
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim)
+{
+	htim->State = HAL_TIM_STATE_BUSY;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim)
+
+
+
+HAL_StatusTypeDef HAL_TIM_IC_Init(TIM_HandleTypeDef *htim)
+{
+	htim->State = HAL_TIM_STATE_READY;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_TIM_IC_Init(TIM_HandleTypeDef *htim)
+
+
+
+HAL_StatusTypeDef HAL_TIM_IC_ConfigChannel(TIM_HandleTypeDef *htim, const TIM_IC_InitTypeDef *sConfig, uint32_t Channel)
+{
+	(void)htim;
+	(void)sConfig;
+	(void)Channel;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_TIM_IC_ConfigChannel(...)
+
+
+
+HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+	(void)htim;
+	(void)Channel;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef *htim, uint32_t Channel)
+
+
+
+HAL_StatusTypeDef HAL_TIM_IC_Stop_IT(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+	(void)htim;
+	(void)Channel;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_TIM_IC_Stop_IT(TIM_HandleTypeDef *htim, uint32_t Channel)
+
+
+
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef *htim)
+{
+	htim->State = HAL_TIM_STATE_READY;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef *htim)
+
+
+
+HAL_StatusTypeDef HAL_TIM_PWM_DeInit(TIM_HandleTypeDef *htim)
+{
+	htim->State = HAL_TIM_STATE_RESET;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_TIM_PWM_DeInit(TIM_HandleTypeDef *htim)
+
+
+
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef *htim, const TIM_OC_InitTypeDef *sConfig, uint32_t Channel)
+{
+	(void)htim;
+	(void)sConfig;
+	(void)Channel;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(...)
+
+
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+	(void)htim;
+	(void)Channel;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel)
+
+
+
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+	(void)htim;
+	(void)Channel;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef *htim, uint32_t Channel)
+
+
+
+HAL_StatusTypeDef HAL_TIM_ConfigClockSource(TIM_HandleTypeDef *htim, const TIM_ClockConfigTypeDef *sClockSourceConfig)
+{
+	(void)htim;
+	(void)sClockSourceConfig;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_TIM_ConfigClockSource(...)
+
+
+
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef *htim, const TIM_MasterConfigTypeDef *sMasterConfig)
+{
+	(void)htim;
+	(void)sMasterConfig;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(...)
+
+
+
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef *htim)
+{
+	(void)htim;
+} // void HAL_TIM_IRQHandler(TIM_HandleTypeDef *htim)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Linked-list DMA of the emulation
+  */
+/*============================================================================*/
+HAL_StatusTypeDef HAL_DMAEx_List_Init(DMA_HandleTypeDef *const hdma)
+{
+	hdma->State = HAL_DMA_STATE_READY;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_DMAEx_List_Init(DMA_HandleTypeDef *const hdma)
+
+
+
+HAL_StatusTypeDef HAL_DMAEx_List_DeInit(DMA_HandleTypeDef *const hdma)
+{
+	hdma->State = HAL_DMA_STATE_RESET;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_DMAEx_List_DeInit(DMA_HandleTypeDef *const hdma)
+
+
+
+HAL_StatusTypeDef HAL_DMAEx_List_BuildNode(DMA_NodeConfTypeDef const *const pNodeConfig, DMA_NodeTypeDef *const pNode)
+{
+	(void)pNodeConfig;
+	(void)pNode;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_DMAEx_List_BuildNode(...)
+
+
+
+HAL_StatusTypeDef HAL_DMAEx_List_InsertNode(DMA_QListTypeDef *const pQList, DMA_NodeTypeDef *const pPrevNode,
+		DMA_NodeTypeDef *const pNewNode)
+{
+	(void)pQList;
+	(void)pPrevNode;
+	(void)pNewNode;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_DMAEx_List_InsertNode(...)
+
+
+
+HAL_StatusTypeDef HAL_DMAEx_List_SetCircularMode(DMA_QListTypeDef *const pQList)
+{
+	(void)pQList;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_DMAEx_List_SetCircularMode(DMA_QListTypeDef *const pQList)
+
+
+
+HAL_StatusTypeDef HAL_DMAEx_List_LinkQ(DMA_HandleTypeDef *const hdma, DMA_QListTypeDef *const pQList)
+{
+	hdma->LinkedListQueue = pQList;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_DMAEx_List_LinkQ(...)
+
+
+
+HAL_StatusTypeDef HAL_DMAEx_List_Start(DMA_HandleTypeDef *const hdma)
+{
+	hdma->State = HAL_DMA_STATE_BUSY;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_DMAEx_List_Start(DMA_HandleTypeDef *const hdma)
+
+
+
+HAL_StatusTypeDef HAL_DMA_ConfigChannelAttributes(DMA_HandleTypeDef *const hdma, uint32_t ChannelAttributes)
+{
+	(void)hdma;
+	(void)ChannelAttributes;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_DMA_ConfigChannelAttributes(...)
@@ -0,0 +1,51 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_log.c
+*
+*  Log output of the firmware modules in the host build, to stderr
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "m1_log_debug.h"
+#include "host_port.h"
+
+/***************************** V A R I A B L E S ******************************/
+
+static int host_log_level = -1; // Not set yet
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+void host_log_set_level(uint8_t level)
+{
+	host_log_level = level;
+} // void host_log_set_level(uint8_t level)
+
+
+
+void m1_logdb_printf(S_M1_LogDebugLevel_t level, const char* tag, const char* format, ...)
+{
+	const char *penv;
+	va_list args;
+
+	if ( host_log_level < 0 )
+	{
+		penv = getenv("M1_HOST_LOG");
+		host_log_level = penv ? atoi(penv):LOG_DEBUG_LEVEL_ERROR;
+	}
+	if ( (int)level > host_log_level )
+		return;
+
+	fprintf(stderr, "[%s] ", tag);
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+} // void m1_logdb_printf(S_M1_LogDebugLevel_t level, const char* tag, const char* format, ...)
@@ -0,0 +1,55 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_nfc.c
+*
+*  Emulation data of the legacy NFC driver, kept for the tests: the NFC
+*  context hands it the identity of the card it loads
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <string.h>
+#include "legacy/nfc_driver.h"
+
+/***************************** V A R I A B L E S ******************************/
+
+static EmuNfcA_t host_emu_nfca;
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+void Emu_SetNfcA(const uint8_t* uid, uint8_t uid_len, uint8_t atqa0, uint8_t atqa1, uint8_t sak)
+{
+	memset(&host_emu_nfca, 0, sizeof(host_emu_nfca));
+	if ( uid_len > sizeof(host_emu_nfca.uid) )
+		uid_len = sizeof(host_emu_nfca.uid);
+	memcpy(host_emu_nfca.uid, uid, uid_len);
+	host_emu_nfca.uid_len = uid_len;
+	host_emu_nfca.atqa[0] = atqa0;
+	host_emu_nfca.atqa[1] = atqa1;
+	host_emu_nfca.sak = sak;
+	host_emu_nfca.valid = true;
+} // void Emu_SetNfcA(const uint8_t* uid, uint8_t uid_len, uint8_t atqa0, uint8_t atqa1, uint8_t sak)
+
+
+
+bool Emu_GetNfcA(EmuNfcA_t* out)
+{
+	if ( !host_emu_nfca.valid )
+		return false;
+	if ( out )
+		*out = host_emu_nfca;
+
+	return true;
+} // bool Emu_GetNfcA(EmuNfcA_t* out)
+
+
+
+void Emu_Clear(void)
+{
+	host_emu_nfca.valid = false;
+} // void Emu_Clear(void)
@@ -0,0 +1,701 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_rf_spi.c
+*
+*  Radio SPI driver of the host build, m1_rf_spi.h, with a model of the
+*  SI4463 behind it, so m1_sub_ghz_api.c runs unchanged on the host.
+*  The model keeps the properties and the GPIO configuration written to
+*  it, answers READ_CMD_BUFF and the Fast Response Registers, drives the
+*  CTS pin (GPIO1) and the nIRQ pin, tunes to the frequency given by its
+*  properties and reports the RSSI of the signals a test places there.
+*
+*  Time is virtual: every SPI transfer and every command moves a radio
+*  clock, and the time the calling task spends blocked on the bus or on
+*  CTS is added up apart from the time the DMA and the radio take in the
+*  background. DMA transfers and the CTS edges are delivered by a thread
+*  that stands for the SPI and EXTI interrupt handlers.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stm32h5xx_hal.h"
+#include "main.h"
+#include "m1_sub_ghz_api.h"
+#include "m1_rf_spi.h"
+#include "host_si446x.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define HOST_RF_BYTE_NS				800 // SPI clock of 10 MHz
+#define HOST_RF_TRANS_NS			3000 // CPU time of a blocking HAL SPI transfer, setup and NSS
+#define HOST_RF_DMA_SETUP_NS		1500 // CPU time to start a DMA transfer
+#define HOST_RF_ISR_NS				1500 // CPU time of one interrupt
+#define HOST_RF_CTS_NS				20000 // "The typical time for a valid FFh CTS reading is 20 us"
+#define HOST_RF_POR_NS				6000000 // Power on reset, to CTS
+#define HOST_RF_RX_SETTLE_NS		80000 // START_RX to the RX state, synthesizer settling
+#define HOST_RF_RSSI_LATCH_NS		40000 // RX state to the first RSSI update
+
+#define HOST_RF_XO_HZ				32000000.0 // RADIO_xxx_CONFIGURATION_DATA_RADIO_XO_FREQ
+#define HOST_RF_NOISE_DBM			-105
+#define HOST_RF_SIGNAL_BW_HZ		100000 // A signal is seen on a channel closer than this
+#define HOST_RF_SIGNALS_MAX			8
+
+#define HOST_RF_CTS_NEVER			UINT64_MAX
+
+#define HOST_RF_STATE_SPI_ACTIVE	2
+#define HOST_RF_STATE_READY			3
+#define HOST_RF_STATE_RX_TUNE		6
+#define HOST_RF_STATE_RX			8
+
+#define HOST_RF_GPIO_MODE_MASK		0x3F
+#define HOST_RF_GPIO_MODE_CTS		8
+#define HOST_RF_GPIO1				1
+#define HOST_RF_NIRQ				4
+
+#define HOST_RF_FRR_COUNT			4
+#define HOST_RF_GROUP_FRR			0x02
+#define HOST_RF_GROUP_MODEM			0x20
+#define HOST_RF_MODEM_RSSI_CONTROL	0x4C
+#define HOST_RF_MODEM_CLKGEN_BAND	0x51
+#define HOST_RF_GROUP_FREQ_CONTROL	0x40
+
+#define HOST_RF_REPLY_MAX			16
+
+//************************** S T R U C T U R E S *******************************
+
+typedef struct
+{
+	uint32_t freq_hz;
+	int16_t dbm;
+} S_Host_RF_Signal_t;
+
+typedef struct
+{
+	bool powered;
+	uint64_t now; // ns, radio clock
+	uint64_t cts_time; // CTS rises at this time
+	uint8_t props[HOST_SI446X_GROUPS][HOST_SI446X_PROPS];
+	uint8_t gpio[HOST_SI446X_GPIO_CFG];
+	uint8_t reply[HOST_RF_REPLY_MAX];
+	uint8_t state;
+	uint8_t channel;
+	uint64_t rx_time; // Time the RX state is reached
+	uint64_t latch_time; // Time the RSSI is latched
+	S_Host_RF_Signal_t signals[HOST_RF_SIGNALS_MAX];
+	uint8_t n_signals;
+	// DMA transfer started and not completed yet
+	bool dma_pending;
+	uint8_t dma_data[HOST_RF_REPLY_MAX*2];
+	uint16_t dma_len;
+	void (*dma_callback)(HAL_StatusTypeDef stat);
+	S_Host_SI446x_Stats_t stats;
+} S_Host_RF_Model_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+DMA_HandleTypeDef hdma_rf_spi_tx;
+
+static S_Host_RF_Model_t host_rf;
+static pthread_mutex_t host_rf_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_rf_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t host_rf_once = PTHREAD_ONCE_INIT;
+static pthread_t host_rf_isr_thread;
+static DMA_Channel_TypeDef host_rf_dma_channel; // Never accessed, marks the DMA as configured
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+static void host_rf_por(void);
+static uint32_t host_rf_frequency(void);
+static bool host_rf_cts(void);
+static uint8_t host_rf_rssi_raw(void);
+static uint8_t host_rf_frr(uint8_t index);
+static void host_rf_command(const uint8_t *pdata, uint16_t len);
+static void host_rf_gpio_write(void *port, uint16_t pin, uint8_t state);
+static uint8_t host_rf_gpio_read(void *port, uint16_t pin, uint8_t state);
+static void *host_rf_isr_task(void *argument);
+static void host_rf_init(void);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+/*============================================================================*/
+/**
+  * @brief  Power on reset of the radio, with host_rf_lock held
+  */
+/*============================================================================*/
+static void host_rf_por(void)
+{
+	memset(host_rf.props, 0, sizeof(host_rf.props));
+	memset(host_rf.gpio, 0, sizeof(host_rf.gpio));
+	host_rf.props[HOST_RF_GROUP_MODEM][HOST_RF_MODEM_CLKGEN_BAND] = 0x08;
+	host_rf.gpio[0] = 0x01; // POR
+	host_rf.gpio[HOST_RF_GPIO1] = HOST_RF_GPIO_MODE_CTS;
+	host_rf.gpio[2] = 0x02; // DRIVE0
+	host_rf.gpio[3] = 0x02;
+	host_rf.gpio[HOST_RF_NIRQ] = SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_NIRQ_MODE_ENUM_NIRQ;
+	host_rf.gpio[5] = 0x0B; // SDO
+	host_rf.state = HOST_RF_STATE_SPI_ACTIVE;
+	host_rf.channel = 0;
+	host_rf.rx_time = HOST_RF_CTS_NEVER;
+	host_rf.latch_time = HOST_RF_CTS_NEVER;
+	host_rf.cts_time = host_rf.now + HOST_RF_POR_NS;
+	host_rf.stats.resets++;
+} // static void host_rf_por(void)
+
+
+
+static bool host_rf_cts(void)
+{
+	return host_rf.powered && (host_rf.now >= host_rf.cts_time);
+} // static bool host_rf_cts(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Tuned frequency of the radio, from its FREQ_CONTROL properties,
+  *         with host_rf_lock held:
+  *         (INTE + FRAC/2^19)*(N_PRESC*XO/OUTDIV) + channel*STEP_SIZE*(N_PRESC*XO/OUTDIV)/2^19
+  */
+/*============================================================================*/
+static uint32_t host_rf_frequency(void)
+{
+	static const uint8_t outdiv[8] = {4, 6, 8, 12, 16, 24, 24, 24};
+	const uint8_t *pfreq;
+	uint8_t clkgen;
+	double pfd, freq;
+
+	pfreq = host_rf.props[HOST_RF_GROUP_FREQ_CONTROL];
+	clkgen = host_rf.props[HOST_RF_GROUP_MODEM][HOST_RF_MODEM_CLKGEN_BAND];
+	pfd = ((clkgen & 0x08) ? 2:4)*HOST_RF_XO_HZ/outdiv[clkgen & 0x07];
+	freq = (pfreq[0] + ((pfreq[1] << 16) | (pfreq[2] << 8) | pfreq[3])/524288.0)*pfd;
+	freq += host_rf.channel*((pfreq[4] << 8) | pfreq[5])*pfd/524288.0;
+
+	return (uint32_t)(freq + 0.5);
+} // static uint32_t host_rf_frequency(void)
+
+
+
+uint32_t host_si446x_frequency(void)
+{
+	uint32_t freq;
+
+	pthread_mutex_lock(&host_rf_lock);
+	freq = host_rf_frequency();
+	pthread_mutex_unlock(&host_rf_lock);
+
+	return freq;
+} // uint32_t host_si446x_frequency(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  RSSI of the tuned channel, as reported by the radio, with
+  *         host_rf_lock held
+  */
+/*============================================================================*/
+static uint8_t host_rf_rssi_raw(void)
+{
+	uint32_t freq;
+	int32_t dbm, raw;
+	uint8_t i;
+
+	freq = host_rf_frequency();
+	dbm = HOST_RF_NOISE_DBM;
+	for (i=0; i<host_rf.n_signals; i++)
+	{
+		if ( (abs((int32_t)(freq - host_rf.signals[i].freq_hz)) < HOST_RF_SIGNAL_BW_HZ) && (host_rf.signals[i].dbm > dbm) )
+			dbm = host_rf.signals[i].dbm;
+	}
+	// RF_Input_Level_dBm = (RSSI_value / 2) – MODEM_RSSI_COMP – 70
+	raw = (dbm + MODEM_RSSI_COMP + 70)*2;
+	if ( raw < 1 )
+		raw = 1;
+	if ( raw > 255 )
+		raw = 255;
+
+	return (uint8_t)raw;
+} // static uint8_t host_rf_rssi_raw(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Value of a Fast Response Register, with host_rf_lock held
+  */
+/*============================================================================*/
+static uint8_t host_rf_frr(uint8_t index)
+{
+	switch ( host_rf.props[HOST_RF_GROUP_FRR][index] )
+	{
+		case SI446X_FRR_MODE_CURRENT_STATE:
+			if ( host_rf.state==HOST_RF_STATE_RX )
+				return (host_rf.now >= host_rf.rx_time) ? HOST_RF_STATE_RX:HOST_RF_STATE_RX_TUNE;
+			return host_rf.state;
+
+		case SI446X_FRR_MODE_LATCHED_RSSI:
+			// Cleared by START_RX, latched once the RSSI_CONTROL condition is met
+			if ( !(host_rf.props[HOST_RF_GROUP_MODEM][HOST_RF_MODEM_RSSI_CONTROL] & SI446X_RSSI_CONTROL_LATCH_MASK) )
+				return 0;
+			if ( (host_rf.state!=HOST_RF_STATE_RX) || (host_rf.now < host_rf.latch_time) )
+				return 0;
+			return host_rf_rssi_raw();
+
+		default:
+			return 0;
+	} // switch ( host_rf.props[HOST_RF_GROUP_FRR][index] )
+} // static uint8_t host_rf_frr(uint8_t index)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Executes a command received at the current radio time, with
+  *         host_rf_lock held
+  */
+/*============================================================================*/
+static void host_rf_command(const uint8_t *pdata, uint16_t len)
+{
+	uint16_t i;
+
+	if ( !host_rf.powered || !len )
+		return;
+	if ( !host_rf_cts() )
+	{
+		host_rf.stats.overruns++; // The radio drops a command sent before CTS
+		return;
+	}
+
+	host_rf.stats.cmds++;
+	host_rf.cts_time = host_rf.now + HOST_RF_CTS_NS;
+	memset(host_rf.reply, 0, sizeof(host_rf.reply));
+	switch ( pdata[0] )
+	{
+		case SI446X_CMD_ID_POWER_UP:
+			host_rf.state = HOST_RF_STATE_READY;
+			break;
+
+		case SI446X_CMD_ID_PART_INFO:
+			host_rf.reply[0] = 0x11; // CHIPREV
+			host_rf.reply[1] = 0x44;
+			host_rf.reply[2] = 0x63;
+			break;
+
+		case SI446X_CMD_ID_SET_PROPERTY:
+			// SET_PROPERTY | group | count | start | values
+			if ( (len < 5) || (pdata[2]==0) || (pdata[2] > 12) || (len != pdata[2] + 4) || (pdata[3] + pdata[2] > HOST_SI446X_PROPS) )
+			{
+				host_rf.stats.bad_cmds++;
+				break;
+			}
+			memcpy(&host_rf.props[pdata[1]][pdata[3]], &pdata[4], pdata[2]);
+			host_rf.stats.props_set += pdata[2];
+			break;
+
+		case SI446X_CMD_ID_GPIO_PIN_CFG:
+			for (i=1; (i < len) && (i <= HOST_SI446X_GPIO_CFG); i++)
+			{
+				if ( pdata[i] & HOST_RF_GPIO_MODE_MASK ) // DONOTHING otherwise
+					host_rf.gpio[i - 1] = pdata[i];
+			}
+			memcpy(host_rf.reply, host_rf.gpio, HOST_SI446X_GPIO_CFG);
+			break;
+
+		case SI446X_CMD_ID_START_RX:
+			host_rf.channel = (len > 1) ? pdata[1]:0;
+			host_rf.state = HOST_RF_STATE_RX;
+			host_rf.rx_time = host_rf.cts_time + HOST_RF_RX_SETTLE_NS;
+			host_rf.latch_time = host_rf.rx_time + HOST_RF_RSSI_LATCH_NS;
+			break;
+
+		case SI446X_CMD_ID_CHANGE_STATE:
+			if ( len > 1 )
+				host_rf.state = pdata[1];
+			break;
+
+		case SI446X_CMD_ID_GET_MODEM_STATUS:
+			if ( (host_rf.state==HOST_RF_STATE_RX) && (host_rf.now >= host_rf.rx_time) )
+				host_rf.reply[2] = host_rf_rssi_raw(); // CURR_RSSI
+			if ( (host_rf.state==HOST_RF_STATE_RX) && (host_rf.now >= host_rf.latch_time) )
+				host_rf.reply[3] = host_rf.reply[2]; // LATCH_RSSI
+			break;
+
+		case SI446X_CMD_ID_REQUEST_DEVICE_STATE:
+			host_rf.reply[0] = host_rf.state;
+			host_rf.reply[1] = host_rf.channel;
+			break;
+
+		default: // GET_INT_STATUS and the others reply zeros
+			break;
+	} // switch ( pdata[0] )
+} // static void host_rf_command(const uint8_t *pdata, uint16_t len)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Blocking transfer. READ_CMD_BUFF and the FRR reads are answered,
+  *         anything else is a command.
+  */
+/*============================================================================*/
+HAL_StatusTypeDef m1_spi_hal_trans_req(S_M1_SPI_Trans_Inf *trans_inf)
+{
+	uint64_t cost;
+	uint16_t i;
+	bool cts;
+
+	if ( trans_inf->dev_id!=SPI_DEVICE_SUBGHZ )
+		return HAL_OK;
+
+	pthread_mutex_lock(&host_rf_lock);
+	if ( host_rf.dma_pending )
+		host_rf.stats.bus_conflicts++;
+	cost = HOST_RF_TRANS_NS + (uint64_t)trans_inf->data_len*HOST_RF_BYTE_NS;
+	host_rf.stats.frames++;
+	host_rf.stats.bytes += trans_inf->data_len;
+	switch ( trans_inf->trans_type )
+	{
+		case SPI_TRANS_WRITE_DATA:
+			host_rf.now += cost;
+			host_rf_command(trans_inf->pdata_tx, trans_inf->data_len);
+			break;
+
+		case SPI_TRANS_WRITEREAD_DATA:
+			memset(trans_inf->pdata_rx, 0, trans_inf->data_len);
+			if ( trans_inf->pdata_tx[0]==SI446X_CMD_ID_READ_CMD_BUFF )
+			{
+				// CTS is sampled once the command byte is in
+				cts = host_rf_cts();
+				host_rf.now += cost;
+				if ( (trans_inf->data_len > 1) && cts )
+				{
+					trans_inf->pdata_rx[1] = 0xFF;
+					for (i=2; (i < trans_inf->data_len) && (i - 2 < HOST_RF_REPLY_MAX); i++)
+						trans_inf->pdata_rx[i] = host_rf.reply[i - 2];
+				}
+			}
+			else if ( trans_inf->pdata_tx[0]==SI446X_CMD_ID_FRR_A_READ )
+			{
+				host_rf.now += cost;
+				host_rf.stats.frr_reads++;
+				for (i=1; (i < trans_inf->data_len) && (i <= HOST_RF_FRR_COUNT); i++)
+					trans_inf->pdata_rx[i] = host_rf_frr(i - 1);
+			}
+			else
+			{
+				host_rf.now += cost;
+				host_rf_command(trans_inf->pdata_tx, trans_inf->data_len);
+			}
+			break;
+
+		default: // NSS handling and the other reads are not used with CTS on GPIO1
+			host_rf.now += cost;
+			break;
+	} // switch ( trans_inf->trans_type )
+	host_rf.stats.cpu_ns += cost;
+	pthread_mutex_unlock(&host_rf_lock);
+
+	return HAL_OK;
+} // HAL_StatusTypeDef m1_spi_hal_trans_req(S_M1_SPI_Trans_Inf *trans_inf)
+
+
+
+void m1_spi_hal_lock(void)
+{
+} // void m1_spi_hal_lock(void)
+
+
+
+void m1_spi_hal_unlock(void)
+{
+} // void m1_spi_hal_unlock(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Starts a DMA transfer, completed by the interrupt thread
+  */
+/*============================================================================*/
+HAL_StatusTypeDef m1_spi_hal_write_dma(S_M1_SPI_DeviceId dev_id, uint8_t *pdata, uint16_t len, void (*pcallback)(HAL_StatusTypeDef stat))
+{
+	pthread_mutex_lock(&host_rf_lock);
+	if ( (dev_id!=SPI_DEVICE_SUBGHZ) || host_rf.dma_pending || (len > sizeof(host_rf.dma_data)) )
+	{
+		pthread_mutex_unlock(&host_rf_lock);
+		return HAL_ERROR;
+	}
+	memcpy(host_rf.dma_data, pdata, len);
+	host_rf.dma_len = len;
+	host_rf.dma_callback = pcallback;
+	host_rf.dma_pending = true;
+	host_rf.stats.cpu_ns += HOST_RF_DMA_SETUP_NS;
+	pthread_cond_signal(&host_rf_cond);
+	pthread_mutex_unlock(&host_rf_lock);
+
+	return HAL_OK;
+} // HAL_StatusTypeDef m1_spi_hal_write_dma(...)
+
+
+
+void m1_spi_hal_abort_dma(void)
+{
+	pthread_mutex_lock(&host_rf_lock);
+	if ( host_rf.dma_pending )
+		host_rf.stats.dma_aborts++;
+	host_rf.dma_pending = false;
+	pthread_mutex_unlock(&host_rf_lock);
+} // void m1_spi_hal_abort_dma(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  The ENA pin holds the radio in shutdown while high
+  */
+/*============================================================================*/
+static void host_rf_gpio_write(void *port, uint16_t pin, uint8_t state)
+{
+	if ( (port!=SI4463_ENA_GPIO_Port) || (pin!=SI4463_ENA_Pin) )
+		return;
+
+	pthread_mutex_lock(&host_rf_lock);
+	if ( state )
+	{
+		host_rf.powered = false;
+	}
+	else if ( !host_rf.powered )
+	{
+		host_rf.powered = true;
+		host_rf_por();
+	}
+	pthread_mutex_unlock(&host_rf_lock);
+} // static void host_rf_gpio_write(void *port, uint16_t pin, uint8_t state)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  GPIO1 and nIRQ follow the radio. A task polling CTS on GPIO1 is
+  *         blocked until CTS rises, so the radio clock moves to that time.
+  */
+/*============================================================================*/
+static uint8_t host_rf_gpio_read(void *port, uint16_t pin, uint8_t state)
+{
+	pthread_mutex_lock(&host_rf_lock);
+	if ( (port==SI4463_GPIO1_GPIO_Port) && (pin==SI4463_GPIO1_Pin) )
+	{
+		if ( (host_rf.gpio[HOST_RF_GPIO1] & HOST_RF_GPIO_MODE_MASK)!=HOST_RF_GPIO_MODE_CTS )
+			state = 0;
+		else if ( host_rf.powered && (host_rf.cts_time!=HOST_RF_CTS_NEVER) )
+		{
+			if ( host_rf.now < host_rf.cts_time )
+			{
+				host_rf.stats.cpu_ns += host_rf.cts_time - host_rf.now;
+				host_rf.now = host_rf.cts_time;
+			}
+			state = 1;
+		}
+		else
+			state = 0;
+	}
+	else if ( (port==SI4463_nINT_GPIO_Port) && (pin==SI4463_nINT_Pin) )
+	{
+		// Active low interrupt, none is ever pending
+		if ( (host_rf.gpio[HOST_RF_NIRQ] & HOST_RF_GPIO_MODE_MASK)==HOST_RF_GPIO_MODE_CTS )
+			state = host_rf_cts();
+		else
+			state = 1;
+	}
+	pthread_mutex_unlock(&host_rf_lock);
+
+	return state;
+} // static uint8_t host_rf_gpio_read(void *port, uint16_t pin, uint8_t state)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  SPI DMA and EXTI12 interrupts. A transfer ends, the radio then
+  *         raises CTS, which is a rising edge of nIRQ while it reports CTS.
+  *         The edge is only handled if the EXTI and the NVIC are set for it,
+  *         as EXTI12_IRQHandler() in m1_int_hdl.c does.
+  */
+/*============================================================================*/
+static void *host_rf_isr_task(void *argument)
+{
+	void (*callback)(HAL_StatusTypeDef stat);
+	uint8_t data[sizeof(host_rf.dma_data)];
+	uint16_t len;
+	bool edge;
+
+	(void)argument;
+	while ( true )
+	{
+		pthread_mutex_lock(&host_rf_lock);
+		while ( !host_rf.dma_pending )
+			pthread_cond_wait(&host_rf_cond, &host_rf_lock);
+		pthread_mutex_unlock(&host_rf_lock);
+
+		// Waits for the task to leave its critical section
+		host_isr_enter();
+		pthread_mutex_lock(&host_rf_lock);
+		if ( !host_rf.dma_pending ) // Aborted
+		{
+			pthread_mutex_unlock(&host_rf_lock);
+			host_isr_exit();
+			continue;
+		}
+		len = host_rf.dma_len;
+		memcpy(data, host_rf.dma_data, len);
+		callback = host_rf.dma_callback;
+		host_rf.now += (uint64_t)len*HOST_RF_BYTE_NS;
+		host_rf.stats.frames++;
+		host_rf.stats.dma_frames++;
+		host_rf.stats.bytes += len;
+		host_rf.stats.cpu_ns += HOST_RF_ISR_NS;
+		host_rf_command(data, len);
+		host_rf.dma_pending = false;
+		pthread_mutex_unlock(&host_rf_lock);
+		callback(HAL_OK);
+
+		pthread_mutex_lock(&host_rf_lock);
+		if ( host_rf.powered && (host_rf.now < host_rf.cts_time) )
+			host_rf.now = host_rf.cts_time;
+		edge = ((host_rf.gpio[HOST_RF_NIRQ] & HOST_RF_GPIO_MODE_MASK)==HOST_RF_GPIO_MODE_CTS)
+				&& (READ_BIT(EXTI->RTSR1, SI4463_nINT_Pin)!=0) && NVIC_GetEnableIRQ(EXTI12_IRQn);
+		if ( edge )
+		{
+			host_rf.stats.cts_edges++;
+			host_rf.stats.cpu_ns += HOST_RF_ISR_NS;
+		}
+		pthread_mutex_unlock(&host_rf_lock);
+
+		if ( edge )
+		{
+			SET_BIT(EXTI->RPR1, SI4463_nINT_Pin);
+			if ( SI446x_Queue_Busy() )
+			{
+				__HAL_GPIO_EXTI_CLEAR_RISING_IT(SI4463_nINT_Pin);
+				__HAL_GPIO_EXTI_CLEAR_FALLING_IT(SI4463_nINT_Pin);
+				SI446x_Queue_CTS_Callback();
+			}
+		} // if ( edge )
+		host_isr_exit();
+	} // while ( true )
+
+	return NULL;
+} // static void *host_rf_isr_task(void *argument)
+
+
+
+static void host_rf_init(void)
+{
+	host_periph_map();
+	pthread_mutex_lock(&host_rf_lock);
+	host_rf.powered = true;
+	host_rf_por();
+	host_rf.stats.resets = 0;
+	pthread_mutex_unlock(&host_rf_lock);
+	host_gpio_set_hook(host_rf_gpio_write);
+	host_gpio_set_read_hook(host_rf_gpio_read);
+	pthread_create(&host_rf_isr_thread, NULL, host_rf_isr_task, NULL);
+} // static void host_rf_init(void)
+
+
+
+void host_si446x_model_init(bool dma)
+{
+	pthread_once(&host_rf_once, host_rf_init);
+	hdma_rf_spi_tx.Instance = dma ? &host_rf_dma_channel:NULL;
+} // void host_si446x_model_init(bool dma)
+
+
+
+void host_si446x_add_signal(uint32_t freq_hz, int16_t dbm)
+{
+	pthread_mutex_lock(&host_rf_lock);
+	if ( host_rf.n_signals < HOST_RF_SIGNALS_MAX )
+	{
+		host_rf.signals[host_rf.n_signals].freq_hz = freq_hz;
+		host_rf.signals[host_rf.n_signals].dbm = dbm;
+		host_rf.n_signals++;
+	}
+	pthread_mutex_unlock(&host_rf_lock);
+} // void host_si446x_add_signal(uint32_t freq_hz, int16_t dbm)
+
+
+
+void host_si446x_clear_signals(void)
+{
+	pthread_mutex_lock(&host_rf_lock);
+	host_rf.n_signals = 0;
+	pthread_mutex_unlock(&host_rf_lock);
+} // void host_si446x_clear_signals(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  A task sleeps, the radio clock moves without CPU time
+  */
+/*============================================================================*/
+void host_si446x_wait(uint64_t ns)
+{
+	pthread_mutex_lock(&host_rf_lock);
+	host_rf.now += ns;
+	pthread_mutex_unlock(&host_rf_lock);
+} // void host_si446x_wait(uint64_t ns)
+
+
+
+void host_si446x_get_config(S_Host_SI446x_Config_t *pconfig)
+{
+	pthread_mutex_lock(&host_rf_lock);
+	memcpy(pconfig->props, host_rf.props, sizeof(pconfig->props));
+	memcpy(pconfig->gpio, host_rf.gpio, sizeof(pconfig->gpio));
+	pthread_mutex_unlock(&host_rf_lock);
+} // void host_si446x_get_config(S_Host_SI446x_Config_t *pconfig)
+
+
+
+void host_si446x_get_stats(S_Host_SI446x_Stats_t *pstats)
+{
+	pthread_mutex_lock(&host_rf_lock);
+	*pstats = host_rf.stats;
+	pstats->radio_ns = host_rf.now;
+	pthread_mutex_unlock(&host_rf_lock);
+} // void host_si446x_get_stats(S_Host_SI446x_Stats_t *pstats)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Counters from a start point to an end point of a test
+  */
+/*============================================================================*/
+void host_si446x_stats_diff(const S_Host_SI446x_Stats_t *pstart, S_Host_SI446x_Stats_t *pend)
+{
+	pend->frames -= pstart->frames;
+	pend->dma_frames -= pstart->dma_frames;
+	pend->bytes -= pstart->bytes;
+	pend->cmds -= pstart->cmds;
+	pend->props_set -= pstart->props_set;
+	pend->frr_reads -= pstart->frr_reads;
+	pend->cts_edges -= pstart->cts_edges;
+	pend->overruns -= pstart->overruns;
+	pend->bad_cmds -= pstart->bad_cmds;
+	pend->bus_conflicts -= pstart->bus_conflicts;
+	pend->dma_aborts -= pstart->dma_aborts;
+	pend->resets -= pstart->resets;
+	pend->radio_ns -= pstart->radio_ns;
+	pend->cpu_ns -= pstart->cpu_ns;
+} // void host_si446x_stats_diff(const S_Host_SI446x_Stats_t *pstart, S_Host_SI446x_Stats_t *pend)
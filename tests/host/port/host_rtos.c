@@ -0,0 +1,1187 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_rtos.c
+*
+*  FreeRTOS API of the host build, on POSIX threads.
+*  Every task is a thread. Queues, semaphores, mutexes, stream buffers and
+*  task notifications share one lock and one condition variable, which is
+*  slow but simple, and enough to run the firmware modules under test.
+*  Interrupt masking is a separate process wide lock, see cmsis_host.h.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "stream_buffer.h"
+#include "cmsis_os2.h"
+#include "host_port.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define HOST_NOTIFY_NOT_WAITING		0
+#define HOST_NOTIFY_WAITING			1
+#define HOST_NOTIFY_RECEIVED		2
+
+//************************** S T R U C T U R E S *******************************
+
+struct tskTaskControlBlock
+{
+	pthread_t thread;
+	TaskFunction_t pxTaskCode;
+	void *pvParameters;
+	char name[configMAX_TASK_NAME_LEN];
+	UBaseType_t priority;
+	uint32_t notify_value[configTASK_NOTIFICATION_ARRAY_ENTRIES];
+	uint8_t notify_state[configTASK_NOTIFICATION_ARRAY_ENTRIES];
+	bool own_thread; // Created by xTaskCreate(), as opposed to the main thread of the test
+	bool suspended;
+};
+
+typedef struct
+{
+	uint8_t type; // queueQUEUE_TYPE_xxx
+	UBaseType_t length;
+	UBaseType_t item_size;
+	UBaseType_t count;
+	UBaseType_t head; // Next item to receive
+	uint8_t *items;
+	TaskHandle_t holder; // Mutexes only
+	UBaseType_t recursion;
+} S_Host_Queue_t;
+
+typedef struct
+{
+	uint8_t *data;
+	size_t size;
+	size_t trigger;
+	size_t head; // Next byte to receive
+	size_t count;
+	bool static_data; // Storage area of the caller
+} S_Host_StreamBuffer_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+static pthread_mutex_t host_rtos_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_rtos_cond;
+static pthread_once_t host_rtos_once = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t host_irq_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread uint32_t host_irq_mask; // PRIMASK of this thread
+static __thread UBaseType_t host_critical_nesting;
+static __thread bool host_in_isr;
+
+static __thread TaskHandle_t host_current_task;
+static struct timespec host_start_time;
+static uint32_t host_task_count;
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+static void host_rtos_init(void);
+static void host_deadline(TickType_t ticks, struct timespec *pdeadline);
+static bool host_wait(TickType_t ticks, const struct timespec *pdeadline);
+static void *host_task_entry(void *argument);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+/*============================================================================*/
+/**
+  * @brief  One-time setup of the condition variable on the monotonic clock
+  */
+/*============================================================================*/
+static void host_rtos_init(void)
+{
+	pthread_condattr_t attr;
+
+	clock_gettime(CLOCK_MONOTONIC, &host_start_time);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&host_rtos_cond, &attr);
+	pthread_condattr_destroy(&attr);
+} // static void host_rtos_init(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Time since the start of the test
+  * @retval elapsed time in us
+  */
+/*============================================================================*/
+uint64_t host_time_us(void)
+{
+	struct timespec now;
+
+	pthread_once(&host_rtos_once, host_rtos_init);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)(now.tv_sec - host_start_time.tv_sec)*1000000 + now.tv_nsec/1000 - host_start_time.tv_nsec/1000;
+} // uint64_t host_time_us(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Sleeps the calling thread
+  * @param  us sleep time in us
+  */
+/*============================================================================*/
+void host_sleep_us(uint32_t us)
+{
+	struct timespec ts;
+
+	ts.tv_sec = us/1000000;
+	ts.tv_nsec = (us % 1000000)*1000;
+	while ( nanosleep(&ts, &ts) && errno==EINTR )
+		;
+} // void host_sleep_us(uint32_t us)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Interrupt masking, PRIMASK semantics: it does not nest
+  */
+/*============================================================================*/
+void host_irq_disable(void)
+{
+	if ( host_irq_mask )
+		return;
+	pthread_mutex_lock(&host_irq_lock);
+	host_irq_mask = 1;
+} // void host_irq_disable(void)
+
+
+
+void host_irq_enable(void)
+{
+	if ( !host_irq_mask )
+		return;
+	host_irq_mask = 0;
+	pthread_mutex_unlock(&host_irq_lock);
+} // void host_irq_enable(void)
+
+
+
+uint32_t host_irq_masked(void)
+{
+	return host_irq_mask;
+} // uint32_t host_irq_masked(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Marks the calling thread as an interrupt handler. The handler runs
+  *         with the other "interrupts" and the critical sections locked out.
+  */
+/*============================================================================*/
+void host_isr_enter(void)
+{
+	host_irq_disable();
+	host_in_isr = true;
+} // void host_isr_enter(void)
+
+
+
+void host_isr_exit(void)
+{
+	host_in_isr = false;
+	host_irq_enable();
+} // void host_isr_exit(void)
+
+
+
+BaseType_t xPortIsInsideInterrupt(void)
+{
+	return host_in_isr ? pdTRUE:pdFALSE;
+} // BaseType_t xPortIsInsideInterrupt(void)
+
+
+
+void vPortEnterCritical(void)
+{
+	if ( !host_critical_nesting++ )
+		host_irq_disable();
+} // void vPortEnterCritical(void)
+
+
+
+void vPortExitCritical(void)
+{
+	if ( host_critical_nesting && !--host_critical_nesting )
+		host_irq_enable();
+} // void vPortExitCritical(void)
+
+
+
+uint32_t ulSetInterruptMask(void)
+{
+	uint32_t mask;
+
+	mask = host_irq_mask;
+	host_irq_disable();
+	return mask;
+} // uint32_t ulSetInterruptMask(void)
+
+
+
+void vClearInterruptMask(uint32_t ulMask)
+{
+	if ( !ulMask )
+		host_irq_enable();
+} // void vClearInterruptMask(uint32_t ulMask)
+
+
+
+void vPortYield(void)
+{
+	sched_yield();
+} // void vPortYield(void)
+
+
+
+void *pvPortMalloc(size_t xSize)
+{
+	return malloc(xSize);
+} // void *pvPortMalloc(size_t xSize)
+
+
+
+void vPortFree(void *pv)
+{
+	free(pv);
+} // void vPortFree(void *pv)
+
+
+
+size_t xPortGetFreeHeapSize(void)
+{
+	return configTOTAL_HEAP_SIZE; // The C library heap has no FreeRTOS budget
+} // size_t xPortGetFreeHeapSize(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Absolute time at which a wait of the given ticks ends
+  */
+/*============================================================================*/
+static void host_deadline(TickType_t ticks, struct timespec *pdeadline)
+{
+	clock_gettime(CLOCK_MONOTONIC, pdeadline);
+	if ( ticks==portMAX_DELAY )
+		return;
+	pdeadline->tv_sec += ticks/configTICK_RATE_HZ;
+	pdeadline->tv_nsec += (long)(ticks % configTICK_RATE_HZ)*(1000000000L/configTICK_RATE_HZ);
+	if ( pdeadline->tv_nsec >= 1000000000L )
+	{
+		pdeadline->tv_sec++;
+		pdeadline->tv_nsec -= 1000000000L;
+	}
+} // static void host_deadline(TickType_t ticks, struct timespec *pdeadline)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Waits for a change of any kernel object, with host_rtos_lock held
+  * @retval false if the deadline has passed
+  */
+/*============================================================================*/
+static bool host_wait(TickType_t ticks, const struct timespec *pdeadline)
+{
+	int ret;
+
+	if ( !ticks )
+		return false;
+	pthread_cleanup_push((void (*)(void *))pthread_mutex_unlock, &host_rtos_lock);
+	if ( ticks==portMAX_DELAY )
+		ret = pthread_cond_wait(&host_rtos_cond, &host_rtos_lock);
+	else
+		ret = pthread_cond_timedwait(&host_rtos_cond, &host_rtos_lock, pdeadline);
+	pthread_cleanup_pop(0);
+
+	return ret!=ETIMEDOUT;
+} // static bool host_wait(TickType_t ticks, const struct timespec *pdeadline)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Tasks
+  */
+/*============================================================================*/
+static void *host_task_entry(void *argument)
+{
+	TaskHandle_t task = argument;
+
+	host_current_task = task;
+	task->pxTaskCode(task->pvParameters);
+	return NULL;
+} // static void *host_task_entry(void *argument)
+
+
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char * const pcName, const configSTACK_DEPTH_TYPE usStackDepth,
+		void * const pvParameters, UBaseType_t uxPriority, TaskHandle_t * const pxCreatedTask)
+{
+	TaskHandle_t task;
+
+	(void)usStackDepth;
+	pthread_once(&host_rtos_once, host_rtos_init);
+	task = calloc(1, sizeof(struct tskTaskControlBlock));
+	if ( task==NULL )
+		return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+	task->pxTaskCode = pxTaskCode;
+	task->pvParameters = pvParameters;
+	task->priority = uxPriority;
+	task->own_thread = true;
+	strncpy(task->name, pcName, sizeof(task->name) - 1);
+	if ( pxCreatedTask )
+		*pxCreatedTask = task;
+	if ( pthread_create(&task->thread, NULL, host_task_entry, task) )
+	{
+		free(task);
+		return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+	}
+	__atomic_fetch_add(&host_task_count, 1, __ATOMIC_RELAXED);
+
+	return pdPASS;
+} // BaseType_t xTaskCreate(...)
+
+
+
+uint32_t host_tasks_created(void)
+{
+	return __atomic_load_n(&host_task_count, __ATOMIC_RELAXED);
+} // uint32_t host_tasks_created(void)
+
+
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+	if ( xTaskToDelete==NULL || xTaskToDelete==xTaskGetCurrentTaskHandle() )
+	{
+		pthread_detach(pthread_self());
+		pthread_exit(NULL);
+	}
+	pthread_cancel(xTaskToDelete->thread);
+	pthread_join(xTaskToDelete->thread, NULL);
+	free(xTaskToDelete);
+} // void vTaskDelete(TaskHandle_t xTaskToDelete)
+
+
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	if ( host_current_task==NULL ) // Main thread of the test
+	{
+		host_current_task = calloc(1, sizeof(struct tskTaskControlBlock));
+		host_current_task->thread = pthread_self();
+		strcpy(host_current_task->name, "main");
+	}
+	return host_current_task;
+} // TaskHandle_t xTaskGetCurrentTaskHandle(void)
+
+
+
+char *pcTaskGetName(TaskHandle_t xTaskToQuery)
+{
+	if ( xTaskToQuery==NULL )
+		xTaskToQuery = xTaskGetCurrentTaskHandle();
+	return xTaskToQuery->name;
+} // char *pcTaskGetName(TaskHandle_t xTaskToQuery)
+
+
+
+UBaseType_t uxTaskPriorityGet(const TaskHandle_t xTask)
+{
+	return (xTask ? xTask:xTaskGetCurrentTaskHandle())->priority;
+} // UBaseType_t uxTaskPriorityGet(const TaskHandle_t xTask)
+
+
+
+void vTaskPrioritySet(TaskHandle_t xTask, UBaseType_t uxNewPriority)
+{
+	(xTask ? xTask:xTaskGetCurrentTaskHandle())->priority = uxNewPriority;
+} // void vTaskPrioritySet(TaskHandle_t xTask, UBaseType_t uxNewPriority)
+
+
+
+void vTaskDelay(const TickType_t xTicksToDelay)
+{
+	if ( !xTicksToDelay )
+	{
+		sched_yield();
+		return;
+	}
+	host_sleep_us(xTicksToDelay*(1000000/configTICK_RATE_HZ));
+} // void vTaskDelay(const TickType_t xTicksToDelay)
+
+
+
+TickType_t xTaskGetTickCount(void)
+{
+	return (TickType_t)(host_time_us()/(1000000/configTICK_RATE_HZ));
+} // TickType_t xTaskGetTickCount(void)
+
+
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+	return xTaskGetTickCount();
+} // TickType_t xTaskGetTickCountFromISR(void)
+
+
+
+BaseType_t xTaskGetSchedulerState(void)
+{
+	return taskSCHEDULER_RUNNING;
+} // BaseType_t xTaskGetSchedulerState(void)
+
+
+
+void vTaskSuspendAll(void)
+{
+	vPortEnterCritical();
+} // void vTaskSuspendAll(void)
+
+
+
+BaseType_t xTaskResumeAll(void)
+{
+	vPortExitCritical();
+	return pdFALSE;
+} // BaseType_t xTaskResumeAll(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Suspends a task. A thread cannot be stopped from another one: a task
+  *         suspended by another task is only reported as suspended and keeps
+  *         running, a task suspending itself waits for vTaskResume().
+  */
+/*============================================================================*/
+void vTaskSuspend(TaskHandle_t xTaskToSuspend)
+{
+	TaskHandle_t task = xTaskToSuspend ? xTaskToSuspend:xTaskGetCurrentTaskHandle();
+
+	pthread_once(&host_rtos_once, host_rtos_init);
+	pthread_mutex_lock(&host_rtos_lock);
+	task->suspended = true;
+	if ( task==xTaskGetCurrentTaskHandle() )
+	{
+		while ( task->suspended )
+			host_wait(portMAX_DELAY, NULL);
+	}
+	pthread_mutex_unlock(&host_rtos_lock);
+} // void vTaskSuspend(TaskHandle_t xTaskToSuspend)
+
+
+
+void vTaskResume(TaskHandle_t xTaskToResume)
+{
+	pthread_mutex_lock(&host_rtos_lock);
+	xTaskToResume->suspended = false;
+	pthread_cond_broadcast(&host_rtos_cond);
+	pthread_mutex_unlock(&host_rtos_lock);
+} // void vTaskResume(TaskHandle_t xTaskToResume)
+
+
+
+void vTaskGetInfo(TaskHandle_t xTask, TaskStatus_t *pxTaskStatus, BaseType_t xGetFreeStackSpace, eTaskState eState)
+{
+	(void)xGetFreeStackSpace;
+	(void)eState;
+	if ( xTask==NULL )
+		xTask = xTaskGetCurrentTaskHandle();
+	memset(pxTaskStatus, 0, sizeof(TaskStatus_t));
+	pxTaskStatus->xHandle = xTask;
+	pxTaskStatus->pcTaskName = xTask->name;
+	pthread_mutex_lock(&host_rtos_lock);
+	pxTaskStatus->eCurrentState = xTask->suspended ? eSuspended:eRunning;
+	pthread_mutex_unlock(&host_rtos_lock);
+	pxTaskStatus->uxCurrentPriority = xTask->priority;
+	pxTaskStatus->uxBasePriority = xTask->priority;
+	pxTaskStatus->usStackHighWaterMark = configMINIMAL_STACK_SIZE;
+} // void vTaskGetInfo(...)
+
+
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask)
+{
+	(void)xTask;
+	return configMINIMAL_STACK_SIZE;
+} // UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Task notifications
+  */
+/*============================================================================*/
+BaseType_t xTaskGenericNotify(TaskHandle_t xTaskToNotify, UBaseType_t uxIndexToNotify, uint32_t ulValue,
+		eNotifyAction eAction, uint32_t *pulPreviousNotificationValue)
+{
+	BaseType_t ret = pdPASS;
+
+	pthread_once(&host_rtos_once, host_rtos_init);
+	pthread_mutex_lock(&host_rtos_lock);
+	if ( pulPreviousNotificationValue )
+		*pulPreviousNotificationValue = xTaskToNotify->notify_value[uxIndexToNotify];
+	switch ( eAction )
+	{
+		case eSetBits:
+			xTaskToNotify->notify_value[uxIndexToNotify] |= ulValue;
+			break;
+		case eIncrement:
+			xTaskToNotify->notify_value[uxIndexToNotify]++;
+			break;
+		case eSetValueWithOverwrite:
+			xTaskToNotify->notify_value[uxIndexToNotify] = ulValue;
+			break;
+		case eSetValueWithoutOverwrite:
+			if ( xTaskToNotify->notify_state[uxIndexToNotify]==HOST_NOTIFY_RECEIVED )
+				ret = pdFAIL;
+			else
+				xTaskToNotify->notify_value[uxIndexToNotify] = ulValue;
+			break;
+		default:
+			break;
+	} // switch ( eAction )
+	if ( ret==pdPASS )
+		xTaskToNotify->notify_state[uxIndexToNotify] = HOST_NOTIFY_RECEIVED;
+	pthread_cond_broadcast(&host_rtos_cond);
+	pthread_mutex_unlock(&host_rtos_lock);
+
+	return ret;
+} // BaseType_t xTaskGenericNotify(...)
+
+
+
+BaseType_t xTaskGenericNotifyFromISR(TaskHandle_t xTaskToNotify, UBaseType_t uxIndexToNotify, uint32_t ulValue,
+		eNotifyAction eAction, uint32_t *pulPreviousNotificationValue, BaseType_t *pxHigherPriorityTaskWoken)
+{
+	if ( pxHigherPriorityTaskWoken )
+		*pxHigherPriorityTaskWoken = pdTRUE;
+	return xTaskGenericNotify(xTaskToNotify, uxIndexToNotify, ulValue, eAction, pulPreviousNotificationValue);
+} // BaseType_t xTaskGenericNotifyFromISR(...)
+
+
+
+void vTaskGenericNotifyGiveFromISR(TaskHandle_t xTaskToNotify, UBaseType_t uxIndexToNotify, BaseType_t *pxHigherPriorityTaskWoken)
+{
+	xTaskGenericNotifyFromISR(xTaskToNotify, uxIndexToNotify, 0, eIncrement, NULL, pxHigherPriorityTaskWoken);
+} // void vTaskGenericNotifyGiveFromISR(...)
+
+
+
+uint32_t ulTaskGenericNotifyTake(UBaseType_t uxIndexToWaitOn, BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+	TaskHandle_t task;
+	struct timespec deadline;
+	uint32_t value;
+
+	task = xTaskGetCurrentTaskHandle();
+	pthread_once(&host_rtos_once, host_rtos_init);
+	host_deadline(xTicksToWait, &deadline);
+	pthread_mutex_lock(&host_rtos_lock);
+	while ( !task->notify_value[uxIndexToWaitOn] && host_wait(xTicksToWait, &deadline) )
+		;
+	value = task->notify_value[uxIndexToWaitOn];
+	if ( value )
+	{
+		if ( xClearCountOnExit )
+			task->notify_value[uxIndexToWaitOn] = 0;
+		else
+			task->notify_value[uxIndexToWaitOn]--;
+	}
+	task->notify_state[uxIndexToWaitOn] = HOST_NOTIFY_NOT_WAITING;
+	pthread_mutex_unlock(&host_rtos_lock);
+
+	return value;
+} // uint32_t ulTaskGenericNotifyTake(...)
+
+
+
+BaseType_t xTaskGenericNotifyWait(UBaseType_t uxIndexToWaitOn, uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit,
+		uint32_t *pulNotificationValue, TickType_t xTicksToWait)
+{
+	TaskHandle_t task;
+	struct timespec deadline;
+	BaseType_t ret;
+
+	task = xTaskGetCurrentTaskHandle();
+	pthread_once(&host_rtos_once, host_rtos_init);
+	host_deadline(xTicksToWait, &deadline);
+	pthread_mutex_lock(&host_rtos_lock);
+	if ( task->notify_state[uxIndexToWaitOn]!=HOST_NOTIFY_RECEIVED )
+	{
+		task->notify_value[uxIndexToWaitOn] &= ~ulBitsToClearOnEntry;
+		task->notify_state[uxIndexToWaitOn] = HOST_NOTIFY_WAITING;
+		while ( task->notify_state[uxIndexToWaitOn]!=HOST_NOTIFY_RECEIVED && host_wait(xTicksToWait, &deadline) )
+			;
+	}
+	if ( pulNotificationValue )
+		*pulNotificationValue = task->notify_value[uxIndexToWaitOn];
+	ret = pdFALSE;
+	if ( task->notify_state[uxIndexToWaitOn]==HOST_NOTIFY_RECEIVED )
+	{
+		task->notify_value[uxIndexToWaitOn] &= ~ulBitsToClearOnExit;
+		ret = pdTRUE;
+	}
+	task->notify_state[uxIndexToWaitOn] = HOST_NOTIFY_NOT_WAITING;
+	pthread_mutex_unlock(&host_rtos_lock);
+
+	return ret;
+} // BaseType_t xTaskGenericNotifyWait(...)
+
+
+
+BaseType_t xTaskGenericNotifyStateClear(TaskHandle_t xTask, UBaseType_t uxIndexToClear)
+{
+	BaseType_t ret;
+
+	if ( xTask==NULL )
+		xTask = xTaskGetCurrentTaskHandle();
+	pthread_mutex_lock(&host_rtos_lock);
+	ret = (xTask->notify_state[uxIndexToClear]==HOST_NOTIFY_RECEIVED) ? pdPASS:pdFAIL;
+	if ( ret==pdPASS )
+		xTask->notify_state[uxIndexToClear] = HOST_NOTIFY_NOT_WAITING;
+	pthread_mutex_unlock(&host_rtos_lock);
+
+	return ret;
+} // BaseType_t xTaskGenericNotifyStateClear(TaskHandle_t xTask, UBaseType_t uxIndexToClear)
+
+
+
+uint32_t ulTaskGenericNotifyValueClear(TaskHandle_t xTask, UBaseType_t uxIndexToClear, uint32_t ulBitsToClear)
+{
+	uint32_t value;
+
+	if ( xTask==NULL )
+		xTask = xTaskGetCurrentTaskHandle();
+	pthread_mutex_lock(&host_rtos_lock);
+	value = xTask->notify_value[uxIndexToClear];
+	xTask->notify_value[uxIndexToClear] &= ~ulBitsToClear;
+	pthread_mutex_unlock(&host_rtos_lock);
+
+	return value;
+} // uint32_t ulTaskGenericNotifyValueClear(...)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Queues, semaphores and mutexes. A semaphore is a queue of items
+  *         of size 0, a mutex is a binary semaphore with a holder.
+  */
+/*============================================================================*/
+QueueHandle_t xQueueGenericCreate(const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize, const uint8_t ucQueueType)
+{
+	S_Host_Queue_t *pqueue;
+
+	pthread_once(&host_rtos_once, host_rtos_init);
+	pqueue = calloc(1, sizeof(S_Host_Queue_t));
+	if ( pqueue==NULL )
+		return NULL;
+	pqueue->type = ucQueueType;
+	pqueue->length = uxQueueLength;
+	pqueue->item_size = uxItemSize;
+	if ( uxItemSize )
+	{
+		pqueue->items = malloc(uxQueueLength*uxItemSize);
+		if ( pqueue->items==NULL )
+		{
+			free(pqueue);
+			return NULL;
+		}
+	}
+
+	return (QueueHandle_t)pqueue;
+} // QueueHandle_t xQueueGenericCreate(...)
+
+
+
+QueueHandle_t xQueueCreateMutex(const uint8_t ucQueueType)
+{
+	S_Host_Queue_t *pqueue;
+
+	pqueue = (S_Host_Queue_t *)xQueueGenericCreate(1, 0, ucQueueType);
+	if ( pqueue )
+		pqueue->count = 1; // Mutexes are created available
+	return (QueueHandle_t)pqueue;
+} // QueueHandle_t xQueueCreateMutex(const uint8_t ucQueueType)
+
+
+
+QueueHandle_t xQueueCreateCountingSemaphore(const UBaseType_t uxMaxCount, const UBaseType_t uxInitialCount)
+{
+	S_Host_Queue_t *pqueue;
+
+	pqueue = (S_Host_Queue_t *)xQueueGenericCreate(uxMaxCount, 0, queueQUEUE_TYPE_COUNTING_SEMAPHORE);
+	if ( pqueue )
+		pqueue->count = uxInitialCount;
+	return (QueueHandle_t)pqueue;
+} // QueueHandle_t xQueueCreateCountingSemaphore(...)
+
+
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+	S_Host_Queue_t *pqueue = (S_Host_Queue_t *)xQueue;
+
+	if ( pqueue==NULL )
+		return;
+	free(pqueue->items);
+	free(pqueue);
+} // void vQueueDelete(QueueHandle_t xQueue)
+
+
+
+BaseType_t xQueueGenericReset(QueueHandle_t xQueue, BaseType_t xNewQueue)
+{
+	S_Host_Queue_t *pqueue = (S_Host_Queue_t *)xQueue;
+
+	(void)xNewQueue;
+	pthread_mutex_lock(&host_rtos_lock);
+	pqueue->count = 0;
+	pqueue->head = 0;
+	pthread_cond_broadcast(&host_rtos_cond);
+	pthread_mutex_unlock(&host_rtos_lock);
+
+	return pdPASS;
+} // BaseType_t xQueueGenericReset(QueueHandle_t xQueue, BaseType_t xNewQueue)
+
+
+
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue, const void * const pvItemToQueue, TickType_t xTicksToWait, const BaseType_t xCopyPosition)
+{
+	S_Host_Queue_t *pqueue = (S_Host_Queue_t *)xQueue;
+	struct timespec deadline;
+	UBaseType_t slot;
+	BaseType_t ret;
+
+	host_deadline(xTicksToWait, &deadline);
+	pthread_mutex_lock(&host_rtos_lock);
+	while ( pqueue->count >= pqueue->length && host_wait(xTicksToWait, &deadline) )
+		;
+	ret = errQUEUE_FULL;
+	if ( pqueue->count < pqueue->length )
+	{
+		if ( pqueue->item_size )
+		{
+			if ( xCopyPosition==queueSEND_TO_FRONT )
+			{
+				pqueue->head = (pqueue->head + pqueue->length - 1) % pqueue->length;
+				slot = pqueue->head;
+			}
+			else if ( xCopyPosition==queueOVERWRITE && pqueue->count )
+			{
+				pqueue->count--;
+				slot = (pqueue->head + pqueue->count) % pqueue->length;
+			}
+			else
+			{
+				slot = (pqueue->head + pqueue->count) % pqueue->length;
+			}
+			memcpy(&pqueue->items[slot*pqueue->item_size], pvItemToQueue, pqueue->item_size);
+		} // if ( pqueue->item_size )
+		pqueue->count++;
+		pqueue->holder = NULL;
+		pthread_cond_broadcast(&host_rtos_cond);
+		ret = pdPASS;
+	} // if ( pqueue->count < pqueue->length )
+	pthread_mutex_unlock(&host_rtos_lock);
+
+	return ret;
+} // BaseType_t xQueueGenericSend(...)
+
+
+
+BaseType_t xQueueGenericSendFromISR(QueueHandle_t xQueue, const void * const pvItemToQueue,
+		BaseType_t * const pxHigherPriorityTaskWoken, const BaseType_t xCopyPosition)
+{
+	if ( pxHigherPriorityTaskWoken )
+		*pxHigherPriorityTaskWoken = pdTRUE;
+	return xQueueGenericSend(xQueue, pvItemToQueue, 0, xCopyPosition);
+} // BaseType_t xQueueGenericSendFromISR(...)
+
+
+
+BaseType_t xQueueGiveFromISR(QueueHandle_t xQueue, BaseType_t * const pxHigherPriorityTaskWoken)
+{
+	return xQueueGenericSendFromISR(xQueue, NULL, pxHigherPriorityTaskWoken, queueSEND_TO_BACK);
+} // BaseType_t xQueueGiveFromISR(QueueHandle_t xQueue, BaseType_t * const pxHigherPriorityTaskWoken)
+
+
+
+static BaseType_t host_queue_receive(QueueHandle_t xQueue, void * const pvBuffer, TickType_t xTicksToWait, bool peek)
+{
+	S_Host_Queue_t *pqueue = (S_Host_Queue_t *)xQueue;
+	struct timespec deadline;
+	BaseType_t ret;
+
+	host_deadline(xTicksToWait, &deadline);
+	pthread_mutex_lock(&host_rtos_lock);
+	while ( !pqueue->count && host_wait(xTicksToWait, &deadline) )
+		;
+	ret = errQUEUE_EMPTY;
+	if ( pqueue->count )
+	{
+		if ( pqueue->item_size && pvBuffer )
+			memcpy(pvBuffer, &pqueue->items[pqueue->head*pqueue->item_size], pqueue->item_size);
+		if ( !peek )
+		{
+			if ( pqueue->item_size )
+				pqueue->head = (pqueue->head + 1) % pqueue->length;
+			pqueue->count--;
+			if ( pqueue->type==queueQUEUE_TYPE_MUTEX || pqueue->type==queueQUEUE_TYPE_RECURSIVE_MUTEX )
+				pqueue->holder = xTaskGetCurrentTaskHandle();
+			pthread_cond_broadcast(&host_rtos_cond);
+		}
+		ret = pdPASS;
+	} // if ( pqueue->count )
+	pthread_mutex_unlock(&host_rtos_lock);
+
+	return ret;
+} // static BaseType_t host_queue_receive(...)
+
+
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void * const pvBuffer, TickType_t xTicksToWait)
+{
+	return host_queue_receive(xQueue, pvBuffer, xTicksToWait, false);
+} // BaseType_t xQueueReceive(QueueHandle_t xQueue, void * const pvBuffer, TickType_t xTicksToWait)
+
+
+
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void * const pvBuffer, TickType_t xTicksToWait)
+{
+	return host_queue_receive(xQueue, pvBuffer, xTicksToWait, true);
+} // BaseType_t xQueuePeek(QueueHandle_t xQueue, void * const pvBuffer, TickType_t xTicksToWait)
+
+
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t xQueue, void * const pvBuffer, BaseType_t * const pxHigherPriorityTaskWoken)
+{
+	if ( pxHigherPriorityTaskWoken )
+		*pxHigherPriorityTaskWoken = pdFALSE;
+	return host_queue_receive(xQueue, pvBuffer, 0, false);
+} // BaseType_t xQueueReceiveFromISR(...)
+
+
+
+BaseType_t xQueueSemaphoreTake(QueueHandle_t xQueue, TickType_t xTicksToWait)
+{
+	return host_queue_receive(xQueue, NULL, xTicksToWait, false);
+} // BaseType_t xQueueSemaphoreTake(QueueHandle_t xQueue, TickType_t xTicksToWait)
+
+
+
+BaseType_t xQueueTakeMutexRecursive(QueueHandle_t xMutex, TickType_t xTicksToWait)
+{
+	S_Host_Queue_t *pqueue = (S_Host_Queue_t *)xMutex;
+	BaseType_t ret;
+
+	pthread_mutex_lock(&host_rtos_lock);
+	ret = (pqueue->holder==xTaskGetCurrentTaskHandle() && !pqueue->count);
+	if ( ret )
+		pqueue->recursion++;
+	pthread_mutex_unlock(&host_rtos_lock);
+	if ( ret )
+		return pdPASS;
+
+	ret = host_queue_receive(xMutex, NULL, xTicksToWait, false);
+	if ( ret==pdPASS )
+		pqueue->recursion = 1;
+	return ret;
+} // BaseType_t xQueueTakeMutexRecursive(QueueHandle_t xMutex, TickType_t xTicksToWait)
+
+
+
+BaseType_t xQueueGiveMutexRecursive(QueueHandle_t xMutex)
+{
+	S_Host_Queue_t *pqueue = (S_Host_Queue_t *)xMutex;
+	bool release;
+
+	pthread_mutex_lock(&host_rtos_lock);
+	if ( pqueue->holder!=xTaskGetCurrentTaskHandle() || pqueue->count )
+	{
+		pthread_mutex_unlock(&host_rtos_lock);
+		return pdFAIL;
+	}
+	release = !--pqueue->recursion;
+	pthread_mutex_unlock(&host_rtos_lock);
+	if ( release )
+		return xQueueGenericSend(xMutex, NULL, 0, queueSEND_TO_BACK);
+	return pdPASS;
+} // BaseType_t xQueueGiveMutexRecursive(QueueHandle_t xMutex)
+
+
+
+TaskHandle_t xQueueGetMutexHolder(QueueHandle_t xSemaphore)
+{
+	S_Host_Queue_t *pqueue = (S_Host_Queue_t *)xSemaphore;
+	TaskHandle_t holder;
+
+	pthread_mutex_lock(&host_rtos_lock);
+	holder = pqueue->count ? NULL:pqueue->holder;
+	pthread_mutex_unlock(&host_rtos_lock);
+
+	return holder;
+} // TaskHandle_t xQueueGetMutexHolder(QueueHandle_t xSemaphore)
+
+
+
+UBaseType_t uxQueueMessagesWaiting(const QueueHandle_t xQueue)
+{
+	S_Host_Queue_t *pqueue = (S_Host_Queue_t *)xQueue;
+	UBaseType_t count;
+
+	pthread_mutex_lock(&host_rtos_lock);
+	count = pqueue->count;
+	pthread_mutex_unlock(&host_rtos_lock);
+
+	return count;
+} // UBaseType_t uxQueueMessagesWaiting(const QueueHandle_t xQueue)
+
+
+
+UBaseType_t uxQueueMessagesWaitingFromISR(const QueueHandle_t xQueue)
+{
+	return uxQueueMessagesWaiting(xQueue);
+} // UBaseType_t uxQueueMessagesWaitingFromISR(const QueueHandle_t xQueue)
+
+
+
+UBaseType_t uxQueueSpacesAvailable(const QueueHandle_t xQueue)
+{
+	S_Host_Queue_t *pqueue = (S_Host_Queue_t *)xQueue;
+
+	return pqueue->length - uxQueueMessagesWaiting(xQueue);
+} // UBaseType_t uxQueueSpacesAvailable(const QueueHandle_t xQueue)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Stream buffers
+  */
+/*============================================================================*/
+StreamBufferHandle_t xStreamBufferGenericCreate(size_t xBufferSizeBytes, size_t xTriggerLevelBytes, BaseType_t xIsMessageBuffer,
+		StreamBufferCallbackFunction_t pxSendCompletedCallback, StreamBufferCallbackFunction_t pxReceiveCompletedCallback)
+{
+	S_Host_StreamBuffer_t *psb;
+
+	(void)pxSendCompletedCallback;
+	(void)pxReceiveCompletedCallback;
+	configASSERT(!xIsMessageBuffer);
+	pthread_once(&host_rtos_once, host_rtos_init);
+	psb = calloc(1, sizeof(S_Host_StreamBuffer_t));
+	if ( psb==NULL )
+		return NULL;
+	psb->data = malloc(xBufferSizeBytes);
+	if ( psb->data==NULL )
+	{
+		free(psb);
+		return NULL;
+	}
+	psb->size = xBufferSizeBytes;
+	psb->trigger = xTriggerLevelBytes ? xTriggerLevelBytes:1;
+
+	return (StreamBufferHandle_t)psb;
+} // StreamBufferHandle_t xStreamBufferGenericCreate(...)
+
+
+
+StreamBufferHandle_t xStreamBufferGenericCreateStatic(size_t xBufferSizeBytes, size_t xTriggerLevelBytes, BaseType_t xIsMessageBuffer,
+		uint8_t * const pucStreamBufferStorageArea, StaticStreamBuffer_t * const pxStaticStreamBuffer,
+		StreamBufferCallbackFunction_t pxSendCompletedCallback, StreamBufferCallbackFunction_t pxReceiveCompletedCallback)
+{
+	S_Host_StreamBuffer_t *psb;
+
+	(void)pxStaticStreamBuffer; // Smaller than the host control block
+	(void)pxSendCompletedCallback;
+	(void)pxReceiveCompletedCallback;
+	configASSERT(!xIsMessageBuffer);
+	pthread_once(&host_rtos_once, host_rtos_init);
+	psb = calloc(1, sizeof(S_Host_StreamBuffer_t));
+	if ( psb==NULL )
+		return NULL;
+	psb->data = pucStreamBufferStorageArea;
+	psb->static_data = true;
+	psb->size = xBufferSizeBytes;
+	psb->trigger = xTriggerLevelBytes ? xTriggerLevelBytes:1;
+
+	return (StreamBufferHandle_t)psb;
+} // StreamBufferHandle_t xStreamBufferGenericCreateStatic(...)
+
+
+
+void vStreamBufferDelete(StreamBufferHandle_t xStreamBuffer)
+{
+	S_Host_StreamBuffer_t *psb = (S_Host_StreamBuffer_t *)xStreamBuffer;
+
+	if ( psb==NULL )
+		return;
+	if ( !psb->static_data )
+		free(psb->data);
+	free(psb);
+} // void vStreamBufferDelete(StreamBufferHandle_t xStreamBuffer)
+
+
+
+size_t xStreamBufferSend(StreamBufferHandle_t xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes, TickType_t xTicksToWait)
+{
+	S_Host_StreamBuffer_t *psb = (S_Host_StreamBuffer_t *)xStreamBuffer;
+	struct timespec deadline;
+	const uint8_t *psrc = pvTxData;
+	size_t n, sent;
+
+	host_deadline(xTicksToWait, &deadline);
+	pthread_mutex_lock(&host_rtos_lock);
+	while ( psb->count==psb->size && host_wait(xTicksToWait, &deadline) )
+		;
+	sent = 0;
+	while ( sent < xDataLengthBytes && psb->count < psb->size )
+	{
+		psb->data[(psb->head + psb->count) % psb->size] = psrc[sent++];
+		psb->count++;
+	}
+	if ( sent )
+		pthread_cond_broadcast(&host_rtos_cond);
+	n = sent;
+	pthread_mutex_unlock(&host_rtos_lock);
+
+	return n;
+} // size_t xStreamBufferSend(...)
+
+
+
+size_t xStreamBufferSendFromISR(StreamBufferHandle_t xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes,
+		BaseType_t * const pxHigherPriorityTaskWoken)
+{
+	if ( pxHigherPriorityTaskWoken )
+		*pxHigherPriorityTaskWoken = pdTRUE;
+	return xStreamBufferSend(xStreamBuffer, pvTxData, xDataLengthBytes, 0);
+} // size_t xStreamBufferSendFromISR(...)
+
+
+
+size_t xStreamBufferReceive(StreamBufferHandle_t xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes, TickType_t xTicksToWait)
+{
+	S_Host_StreamBuffer_t *psb = (S_Host_StreamBuffer_t *)xStreamBuffer;
+	struct timespec deadline;
+	uint8_t *pdst = pvRxData;
+	size_t received;
+
+	host_deadline(xTicksToWait, &deadline);
+	pthread_mutex_lock(&host_rtos_lock);
+	while ( psb->count < psb->trigger && host_wait(xTicksToWait, &deadline) )
+		;
+	received = 0;
+	while ( received < xBufferLengthBytes && psb->count )
+	{
+		pdst[received++] = psb->data[psb->head];
+		psb->head = (psb->head + 1) % psb->size;
+		psb->count--;
+	}
+	if ( received )
+		pthread_cond_broadcast(&host_rtos_cond);
+	pthread_mutex_unlock(&host_rtos_lock);
+
+	return received;
+} // size_t xStreamBufferReceive(...)
+
+
+
+size_t xStreamBufferReceiveFromISR(StreamBufferHandle_t xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes,
+		BaseType_t * const pxHigherPriorityTaskWoken)
+{
+	if ( pxHigherPriorityTaskWoken )
+		*pxHigherPriorityTaskWoken = pdFALSE;
+	return xStreamBufferReceive(xStreamBuffer, pvRxData, xBufferLengthBytes, 0);
+} // size_t xStreamBufferReceiveFromISR(...)
+
+
+
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t xStreamBuffer)
+{
+	S_Host_StreamBuffer_t *psb = (S_Host_StreamBuffer_t *)xStreamBuffer;
+	size_t count;
+
+	pthread_mutex_lock(&host_rtos_lock);
+	count = psb->count;
+	pthread_mutex_unlock(&host_rtos_lock);
+
+	return count;
+} // size_t xStreamBufferBytesAvailable(StreamBufferHandle_t xStreamBuffer)
+
+
+
+size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t xStreamBuffer)
+{
+	S_Host_StreamBuffer_t *psb = (S_Host_StreamBuffer_t *)xStreamBuffer;
+
+	return psb->size - xStreamBufferBytesAvailable(xStreamBuffer);
+} // size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t xStreamBuffer)
+
+
+
+BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t xStreamBuffer)
+{
+	return xStreamBufferBytesAvailable(xStreamBuffer) ? pdFALSE:pdTRUE;
+} // BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t xStreamBuffer)
+
+
+
+BaseType_t xStreamBufferReset(StreamBufferHandle_t xStreamBuffer)
+{
+	S_Host_StreamBuffer_t *psb = (S_Host_StreamBuffer_t *)xStreamBuffer;
+
+	pthread_mutex_lock(&host_rtos_lock);
+	psb->head = 0;
+	psb->count = 0;
+	pthread_cond_broadcast(&host_rtos_cond);
+	pthread_mutex_unlock(&host_rtos_lock);
+
+	return pdPASS;
+} // BaseType_t xStreamBufferReset(StreamBufferHandle_t xStreamBuffer)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  CMSIS-RTOS2 calls of the modules under test, over the FreeRTOS API
+  *         as in cmsis_os2.c
+  */
+/*============================================================================*/
+osStatus_t osDelay(uint32_t ticks)
+{
+	vTaskDelay(ticks);
+	return osOK;
+} // osStatus_t osDelay(uint32_t ticks)
+
+
+
+uint32_t osKernelGetTickCount(void)
+{
+	return xTaskGetTickCount();
+} // uint32_t osKernelGetTickCount(void)
@@ -0,0 +1,268 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_sd.c
+*
+*  SD card model under the HAL_SD DMA functions, with the variables of
+*  m1_sdcard.c the USB MSC storage uses. A transfer is done by a thread that
+*  stands for the SDMMC DMA: it takes the card time, then raises the
+*  completion callback of m1_sdcard.c as an interrupt handler.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "m1_sdcard.h"
+#include "host_port.h"
+#include "host_sd.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define HOST_SD_BLOCK_SIZE			512
+#define HOST_SD_CB_READ_CPLT_MSG	1 // As m1_sdcard.c
+#define HOST_SD_CB_WRITE_CPLT_MSG	2
+#define HOST_SD_CB_Q_ITEMS			2
+
+typedef struct
+{
+	bool pending;
+	bool write;
+	uint8_t *buf;
+	uint32_t blk_addr;
+	uint32_t blk_len;
+} S_Host_SD_DMA_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+static SD_HandleTypeDef host_hsd;
+SD_HandleTypeDef *phsd = &host_hsd;
+S_M1_SDCard_Hdl sdcard_ctl;
+S_M1_SDCard_Info sdcard_info;
+QueueHandle_t sdcard_cb_q_hdl = NULL;
+
+static uint8_t *host_sd;
+static uint32_t host_sd_blocks;
+static bool host_sd_present;
+static uint32_t host_sd_command_us, host_sd_block_us, host_sd_program_us;
+static uint64_t host_sd_busy_until; // End of the programming state, us
+static uint32_t host_sd_writes_to_fail;
+static S_Host_SD_Stats_t host_sd_stats;
+static S_Host_SD_DMA_t host_sd_dma;
+static pthread_mutex_t host_sd_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_sd_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t host_sd_thread;
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+/*============================================================================*/
+/**
+  * @brief  SDMMC DMA: does the pending transfer after its card time, then
+  *         posts its completion as HAL_SD_TxCpltCallback() and
+  *         HAL_SD_RxCpltCallback() do
+  */
+/*============================================================================*/
+static void *host_sd_dma_task(void *argument)
+{
+	S_Host_SD_DMA_t dma;
+	uint16_t msg;
+
+	(void)argument;
+	while ( true )
+	{
+		pthread_mutex_lock(&host_sd_lock);
+		while ( !host_sd_dma.pending )
+			pthread_cond_wait(&host_sd_cond, &host_sd_lock);
+		dma = host_sd_dma;
+		pthread_mutex_unlock(&host_sd_lock);
+
+		host_sleep_us(host_sd_command_us + dma.blk_len*host_sd_block_us);
+
+		pthread_mutex_lock(&host_sd_lock);
+		if ( dma.write )
+		{
+			memcpy(host_sd + (size_t)dma.blk_addr*HOST_SD_BLOCK_SIZE, dma.buf, (size_t)dma.blk_len*HOST_SD_BLOCK_SIZE);
+			host_sd_busy_until = host_time_us() + host_sd_program_us;
+		}
+		else
+		{
+			memcpy(dma.buf, host_sd + (size_t)dma.blk_addr*HOST_SD_BLOCK_SIZE, (size_t)dma.blk_len*HOST_SD_BLOCK_SIZE);
+		}
+		host_sd_dma.pending = false;
+		pthread_mutex_unlock(&host_sd_lock);
+
+		msg = dma.write ? HOST_SD_CB_WRITE_CPLT_MSG:HOST_SD_CB_READ_CPLT_MSG;
+		host_isr_enter();
+		xQueueSendFromISR(sdcard_cb_q_hdl, (const void *)&msg, 0);
+		host_isr_exit();
+	} // while ( true )
+
+	return NULL;
+} // static void *host_sd_dma_task(void *argument)
+
+
+
+void host_sd_init(uint32_t blocks)
+{
+	host_sd = calloc(blocks, HOST_SD_BLOCK_SIZE);
+	if ( host_sd==NULL )
+		abort();
+	host_sd_blocks = blocks;
+	host_sd_present = true;
+	sdcard_ctl.status = SD_access_UnMounted;
+	sdcard_cb_q_hdl = xQueueCreate(HOST_SD_CB_Q_ITEMS, sizeof(uint16_t));
+	pthread_create(&host_sd_thread, NULL, host_sd_dma_task, NULL);
+} // void host_sd_init(uint32_t blocks)
+
+
+
+uint8_t *host_sd_image(void)
+{
+	return host_sd;
+} // uint8_t *host_sd_image(void)
+
+
+
+void host_sd_set_present(bool present)
+{
+	host_sd_present = present;
+} // void host_sd_set_present(bool present)
+
+
+
+void host_sd_set_timing(uint32_t command_us, uint32_t block_us, uint32_t program_us)
+{
+	host_sd_command_us = command_us;
+	host_sd_block_us = block_us;
+	host_sd_program_us = program_us;
+} // void host_sd_set_timing(uint32_t command_us, uint32_t block_us, uint32_t program_us)
+
+
+
+void host_sd_stats_reset(void)
+{
+	pthread_mutex_lock(&host_sd_lock);
+	memset(&host_sd_stats, 0, sizeof(host_sd_stats));
+	pthread_mutex_unlock(&host_sd_lock);
+} // void host_sd_stats_reset(void)
+
+
+
+void host_sd_stats_get(S_Host_SD_Stats_t *pstats)
+{
+	pthread_mutex_lock(&host_sd_lock);
+	*pstats = host_sd_stats;
+	pthread_mutex_unlock(&host_sd_lock);
+} // void host_sd_stats_get(S_Host_SD_Stats_t *pstats)
+
+
+
+void host_sd_fail_writes(uint32_t n)
+{
+	pthread_mutex_lock(&host_sd_lock);
+	host_sd_writes_to_fail = n;
+	pthread_mutex_unlock(&host_sd_lock);
+} // void host_sd_fail_writes(uint32_t n)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Starts a transfer, HAL_ERROR if the card is missing, busy or
+  *         rejects the command
+  */
+/*============================================================================*/
+static HAL_StatusTypeDef host_sd_start(bool write, uint8_t *buf, uint32_t blk_addr, uint32_t blk_len)
+{
+	HAL_StatusTypeDef res = HAL_ERROR;
+
+	pthread_mutex_lock(&host_sd_lock);
+	if ( host_sd_present && !host_sd_dma.pending && (host_time_us() >= host_sd_busy_until)
+			&& blk_len && (blk_addr + blk_len <= host_sd_blocks) )
+	{
+		if ( write && host_sd_writes_to_fail )
+		{
+			host_sd_writes_to_fail--;
+			host_sd_stats.rejected_writes++;
+		}
+		else
+		{
+			if ( write )
+			{
+				host_sd_stats.write_commands++;
+				host_sd_stats.blocks_written += blk_len;
+			}
+			else
+			{
+				host_sd_stats.read_commands++;
+				host_sd_stats.blocks_read += blk_len;
+			}
+			host_sd_dma.write = write;
+			host_sd_dma.buf = buf;
+			host_sd_dma.blk_addr = blk_addr;
+			host_sd_dma.blk_len = blk_len;
+			host_sd_dma.pending = true;
+			pthread_cond_signal(&host_sd_cond);
+			res = HAL_OK;
+		}
+	}
+	pthread_mutex_unlock(&host_sd_lock);
+
+	return res;
+} // static HAL_StatusTypeDef host_sd_start(bool write, uint8_t *buf, uint32_t blk_addr, uint32_t blk_len)
+
+
+
+HAL_StatusTypeDef HAL_SD_ReadBlocks_DMA(SD_HandleTypeDef *hsd, uint8_t *pData, uint32_t BlockAdd, uint32_t NumberOfBlocks)
+{
+	(void)hsd;
+	return host_sd_start(false, pData, BlockAdd, NumberOfBlocks);
+} // HAL_StatusTypeDef HAL_SD_ReadBlocks_DMA(...)
+
+
+
+HAL_StatusTypeDef HAL_SD_WriteBlocks_DMA(SD_HandleTypeDef *hsd, const uint8_t *pData, uint32_t BlockAdd, uint32_t NumberOfBlocks)
+{
+	(void)hsd;
+	return host_sd_start(true, (uint8_t *)pData, BlockAdd, NumberOfBlocks);
+} // HAL_StatusTypeDef HAL_SD_WriteBlocks_DMA(...)
+
+
+
+HAL_SD_CardStateTypeDef HAL_SD_GetCardState(SD_HandleTypeDef *hsd)
+{
+	HAL_SD_CardStateTypeDef state;
+
+	(void)hsd;
+	pthread_mutex_lock(&host_sd_lock);
+	state = (host_time_us() < host_sd_busy_until) ? HAL_SD_CARD_PROGRAMMING:HAL_SD_CARD_TRANSFER;
+	pthread_mutex_unlock(&host_sd_lock);
+
+	return state;
+} // HAL_SD_CardStateTypeDef HAL_SD_GetCardState(SD_HandleTypeDef *hsd)
+
+
+
+HAL_StatusTypeDef HAL_SD_GetCardInfo(SD_HandleTypeDef *hsd, HAL_SD_CardInfoTypeDef *pCardInfo)
+{
+	(void)hsd;
+	memset(pCardInfo, 0, sizeof(*pCardInfo));
+	pCardInfo->BlockNbr = host_sd_blocks;
+	pCardInfo->BlockSize = HOST_SD_BLOCK_SIZE;
+	pCardInfo->LogBlockNbr = host_sd_blocks;
+	pCardInfo->LogBlockSize = HOST_SD_BLOCK_SIZE;
+
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_SD_GetCardInfo(...)
+
+
+
+uint8_t m1_sd_detected(void)
+{
+	return host_sd_present;
+} // uint8_t m1_sd_detected(void)
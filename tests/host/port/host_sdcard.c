@@ -0,0 +1,123 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_sdcard.c
+*
+*  SD card services of m1_sdcard.c for the host build, on the FatFs RAM
+*  disk of host_fatfs.c. The card is always present and mounted.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <string.h>
+#include "m1_sdcard.h"
+#include "host_fatfs.h"
+
+/***************************** V A R I A B L E S ******************************/
+
+static S_M1_SDCard_Info host_sdcard_info;
+static S_M1_SDCard_Access_Status host_sdcard_status = SD_access_OK;
+static FRESULT host_sdcard_error;
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+S_M1_SDCard_Init_Status m1_sdcard_init_ex(void)
+{
+	return SD_RET_OK;
+} // S_M1_SDCard_Init_Status m1_sdcard_init_ex(void)
+
+
+
+S_M1_SDCard_Init_Status m1_sdcard_init_retry(void)
+{
+	return SD_RET_OK;
+} // S_M1_SDCard_Init_Status m1_sdcard_init_retry(void)
+
+
+
+void m1_sdcard_mount(void)
+{
+	host_sdcard_status = host_fatfs_remount() ? SD_access_OK:SD_access_NoFS;
+	if ( host_sdcard_status==SD_access_OK )
+		m1_fb_trim_expanded_file();
+} // void m1_sdcard_mount(void)
+
+
+
+void m1_sdcard_unmount(void)
+{
+	host_fatfs_unmount();
+	host_sdcard_status = SD_access_UnMounted;
+} // void m1_sdcard_unmount(void)
+
+
+
+void m1_sdcard_set_status(S_M1_SDCard_Access_Status stat)
+{
+	host_sdcard_status = stat;
+} // void m1_sdcard_set_status(S_M1_SDCard_Access_Status stat)
+
+
+
+S_M1_SDCard_Access_Status m1_sdcard_get_status(void)
+{
+	return host_sdcard_status;
+} // S_M1_SDCard_Access_Status m1_sdcard_get_status(void)
+
+
+
+uint8_t m1_sd_detected(void)
+{
+	return 1;
+} // uint8_t m1_sd_detected(void)
+
+
+
+S_M1_SDCard_Info *m1_sdcard_get_info(void)
+{
+	FATFS *pfs;
+	DWORD free_clusters;
+
+	host_sdcard_error = f_getfree("", &free_clusters, &pfs);
+	if ( host_sdcard_error!=FR_OK )
+		return NULL;
+
+	host_sdcard_info.sector_size = 512;
+	host_sdcard_info.cluster_size = pfs->csize;
+	host_sdcard_info.total_cap_kb = (pfs->n_fatent - 2)*pfs->csize/2;
+	host_sdcard_info.free_cap_kb = free_clusters*pfs->csize/2;
+
+	return &host_sdcard_info;
+} // S_M1_SDCard_Info *m1_sdcard_get_info(void)
+
+
+
+uint32_t m1_sdcard_get_total_capacity(void)
+{
+	return host_sdcard_info.total_cap_kb;
+} // uint32_t m1_sdcard_get_total_capacity(void)
+
+
+
+uint32_t m1_sdcard_get_free_capacity(void)
+{
+	return host_sdcard_info.free_cap_kb;
+} // uint32_t m1_sdcard_get_free_capacity(void)
+
+
+
+FRESULT m1_sdcard_get_error_code(void)
+{
+	return host_sdcard_error;
+} // FRESULT m1_sdcard_get_error_code(void)
+
+
+
+uint32_t m1_sdcard_get_mount_generation(void)
+{
+	return host_fatfs_get_mount_count();
+} // uint32_t m1_sdcard_get_mount_generation(void)
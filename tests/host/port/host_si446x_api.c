@@ -0,0 +1,137 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_si446x_api.c
+*
+*  SI446x radio API stub for the tests that run the Sub-GHz decoders
+*  without m1_sub_ghz_api.c. The modem status reports a fixed RSSI, and
+*  the radio lock is a plain recursive mutex.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <pthread.h>
+#include <time.h>
+#include "m1_sub_ghz_api.h"
+#include "host_si446x.h"
+
+/*************************** D E F I N E S ************************************/
+
+#ifndef MODEM_RSSI_COMP
+#define MODEM_RSSI_COMP				0x40 // m1_sub_ghz.h
+#endif
+#define HOST_SI446X_MODEM_STATUS_US		100 // Time of a GET_MODEM_STATUS transaction on the radio SPI bus
+
+/***************************** V A R I A B L E S ******************************/
+
+static pthread_mutex_t host_si446x_lock;
+static pthread_once_t host_si446x_once = PTHREAD_ONCE_INIT;
+static struct si446x_reply_GET_MODEM_STATUS_map host_modem_status;
+static volatile uint32_t host_modem_status_reads;
+static volatile uint32_t host_unlocked_reads;
+static pthread_t host_si446x_owner;
+static uint32_t host_si446x_depth; // Nested locks of the owner
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static void host_si446x_init(void)
+{
+	pthread_mutexattr_t attr;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&host_si446x_lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+} // static void host_si446x_init(void)
+
+
+
+void SI446x_Lock_Init(void)
+{
+	pthread_once(&host_si446x_once, host_si446x_init);
+} // void SI446x_Lock_Init(void)
+
+
+
+void SI446x_Lock(void)
+{
+	pthread_once(&host_si446x_once, host_si446x_init);
+	pthread_mutex_lock(&host_si446x_lock);
+	if ( !host_si446x_depth++ )
+		host_si446x_owner = pthread_self();
+} // void SI446x_Lock(void)
+
+
+
+uint8_t SI446x_Try_Lock(uint32_t timeout)
+{
+	struct timespec deadline;
+
+	pthread_once(&host_si446x_once, host_si446x_init);
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += timeout/1000;
+	deadline.tv_nsec += (long)(timeout % 1000)*1000000L;
+	if ( deadline.tv_nsec >= 1000000000L )
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	if ( pthread_mutex_timedlock(&host_si446x_lock, &deadline) )
+		return 0;
+	if ( !host_si446x_depth++ )
+		host_si446x_owner = pthread_self();
+
+	return 1;
+} // uint8_t SI446x_Try_Lock(uint32_t timeout)
+
+
+
+void SI446x_Unlock(void)
+{
+	host_si446x_depth--;
+	pthread_mutex_unlock(&host_si446x_lock);
+} // void SI446x_Unlock(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Takes as long as the SPI transaction of the radio, and counts the
+  *         calls made without the radio taken
+  */
+/*============================================================================*/
+struct si446x_reply_GET_MODEM_STATUS_map *SI446x_Get_ModemStatus(uint8_t MODEM_CLR_PEND)
+{
+	(void)MODEM_CLR_PEND;
+	if ( !host_si446x_depth || !pthread_equal(host_si446x_owner, pthread_self()) )
+		host_unlocked_reads++;
+	host_sleep_us(HOST_SI446X_MODEM_STATUS_US);
+	host_modem_status_reads++;
+	return &host_modem_status;
+} // struct si446x_reply_GET_MODEM_STATUS_map *SI446x_Get_ModemStatus(uint8_t MODEM_CLR_PEND)
+
+
+
+void host_si446x_set_rssi(int16_t rssi)
+{
+	// RF_Input_Level_dBm = (RSSI_value / 2) – MODEM_RSSI_COMP – 70
+	host_modem_status.CURR_RSSI = (rssi + MODEM_RSSI_COMP + 70)*2;
+} // void host_si446x_set_rssi(int16_t rssi)
+
+
+
+uint32_t host_si446x_modem_status_reads(void)
+{
+	return host_modem_status_reads;
+} // uint32_t host_si446x_modem_status_reads(void)
+
+
+
+uint32_t host_si446x_unlocked_reads(void)
+{
+	return host_unlocked_reads;
+} // uint32_t host_si446x_unlocked_reads(void)
@@ -0,0 +1,247 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_timers.c
+*
+*  FreeRTOS software timers of the host build. One service thread runs the
+*  callbacks, as the timer task does on the target.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "host_port.h"
+
+//************************** S T R U C T U R E S *******************************
+
+struct tmrTimerControl
+{
+	const char *name;
+	TickType_t period;
+	bool auto_reload;
+	bool active;
+	bool deleted;
+	void *id;
+	TimerCallbackFunction_t callback;
+	uint64_t expiry_us;
+	struct tmrTimerControl *next;
+};
+
+/***************************** V A R I A B L E S ******************************/
+
+static pthread_mutex_t host_timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_timer_cond;
+static pthread_once_t host_timer_once = PTHREAD_ONCE_INIT;
+static struct tmrTimerControl *host_timer_list;
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+static void host_timer_init(void);
+static void *host_timer_service(void *argument);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static void host_timer_init(void)
+{
+	pthread_condattr_t attr;
+	pthread_t thread;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&host_timer_cond, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_create(&thread, NULL, host_timer_service, NULL);
+	pthread_detach(thread);
+} // static void host_timer_init(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Calls the callback of every expired timer, without the lock held
+  *         so that a callback can use the timer API
+  */
+/*============================================================================*/
+static void *host_timer_service(void *argument)
+{
+	struct tmrTimerControl **pp, *pnext;
+	struct timespec deadline;
+	uint64_t now, wake;
+
+	(void)argument;
+	pthread_mutex_lock(&host_timer_lock);
+	for (;;)
+	{
+		now = host_time_us();
+		wake = UINT64_MAX;
+		pnext = NULL;
+		for (pp=&host_timer_list; *pp; )
+		{
+			if ( (*pp)->deleted )
+			{
+				pnext = *pp;
+				*pp = pnext->next;
+				free(pnext);
+				pnext = NULL;
+				continue;
+			}
+			if ( (*pp)->active && (*pp)->expiry_us <= now && pnext==NULL )
+				pnext = *pp;
+			else if ( (*pp)->active && (*pp)->expiry_us < wake )
+				wake = (*pp)->expiry_us;
+			pp = &(*pp)->next;
+		} // for (pp=&host_timer_list; *pp; )
+
+		if ( pnext )
+		{
+			if ( pnext->auto_reload )
+				pnext->expiry_us += (uint64_t)pnext->period*(1000000/configTICK_RATE_HZ);
+			else
+				pnext->active = false;
+			pthread_mutex_unlock(&host_timer_lock);
+			pnext->callback(pnext);
+			pthread_mutex_lock(&host_timer_lock);
+			continue;
+		} // if ( pnext )
+
+		if ( wake==UINT64_MAX )
+		{
+			pthread_cond_wait(&host_timer_cond, &host_timer_lock);
+			continue;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		wake -= now;
+		deadline.tv_sec += wake/1000000;
+		deadline.tv_nsec += (long)(wake % 1000000)*1000;
+		if ( deadline.tv_nsec >= 1000000000L )
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&host_timer_cond, &host_timer_lock, &deadline);
+	} // for (;;)
+
+	return NULL;
+} // static void *host_timer_service(void *argument)
+
+
+
+TimerHandle_t xTimerCreate(const char * const pcTimerName, const TickType_t xTimerPeriodInTicks, const BaseType_t xAutoReload,
+		void * const pvTimerID, TimerCallbackFunction_t pxCallbackFunction)
+{
+	struct tmrTimerControl *ptimer;
+
+	pthread_once(&host_timer_once, host_timer_init);
+	ptimer = calloc(1, sizeof(struct tmrTimerControl));
+	if ( ptimer==NULL )
+		return NULL;
+	ptimer->name = pcTimerName;
+	ptimer->period = xTimerPeriodInTicks;
+	ptimer->auto_reload = xAutoReload;
+	ptimer->id = pvTimerID;
+	ptimer->callback = pxCallbackFunction;
+
+	pthread_mutex_lock(&host_timer_lock);
+	ptimer->next = host_timer_list;
+	host_timer_list = ptimer;
+	pthread_mutex_unlock(&host_timer_lock);
+
+	return ptimer;
+} // TimerHandle_t xTimerCreate(...)
+
+
+
+BaseType_t xTimerGenericCommand(TimerHandle_t xTimer, const BaseType_t xCommandID, const TickType_t xOptionalValue,
+		BaseType_t * const pxHigherPriorityTaskWoken, const TickType_t xTicksToWait)
+{
+	(void)xTicksToWait;
+	if ( pxHigherPriorityTaskWoken )
+		*pxHigherPriorityTaskWoken = pdFALSE;
+
+	pthread_mutex_lock(&host_timer_lock);
+	switch ( xCommandID )
+	{
+		case tmrCOMMAND_START:
+		case tmrCOMMAND_RESET:
+		case tmrCOMMAND_START_FROM_ISR:
+		case tmrCOMMAND_RESET_FROM_ISR:
+			xTimer->active = true;
+			xTimer->expiry_us = host_time_us() + (uint64_t)xTimer->period*(1000000/configTICK_RATE_HZ);
+			break;
+
+		case tmrCOMMAND_STOP:
+		case tmrCOMMAND_STOP_FROM_ISR:
+			xTimer->active = false;
+			break;
+
+		case tmrCOMMAND_CHANGE_PERIOD:
+		case tmrCOMMAND_CHANGE_PERIOD_FROM_ISR:
+			xTimer->period = xOptionalValue;
+			xTimer->active = true;
+			xTimer->expiry_us = host_time_us() + (uint64_t)xTimer->period*(1000000/configTICK_RATE_HZ);
+			break;
+
+		case tmrCOMMAND_DELETE:
+			xTimer->active = false;
+			xTimer->deleted = true;
+			break;
+
+		default:
+			break;
+	} // switch ( xCommandID )
+	pthread_cond_broadcast(&host_timer_cond);
+	pthread_mutex_unlock(&host_timer_lock);
+
+	return pdPASS;
+} // BaseType_t xTimerGenericCommand(...)
+
+
+
+void *pvTimerGetTimerID(const TimerHandle_t xTimer)
+{
+	return xTimer->id;
+} // void *pvTimerGetTimerID(const TimerHandle_t xTimer)
+
+
+
+void vTimerSetTimerID(TimerHandle_t xTimer, void *pvNewID)
+{
+	xTimer->id = pvNewID;
+} // void vTimerSetTimerID(TimerHandle_t xTimer, void *pvNewID)
+
+
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t xTimer)
+{
+	BaseType_t active;
+
+	pthread_mutex_lock(&host_timer_lock);
+	active = xTimer->active;
+	pthread_mutex_unlock(&host_timer_lock);
+
+	return active;
+} // BaseType_t xTimerIsTimerActive(TimerHandle_t xTimer)
+
+
+
+const char *pcTimerGetName(TimerHandle_t xTimer)
+{
+	return xTimer->name;
+} // const char *pcTimerGetName(TimerHandle_t xTimer)
+
+
+
+TickType_t xTimerGetPeriod(TimerHandle_t xTimer)
+{
+	return xTimer->period;
+} // TickType_t xTimerGetPeriod(TimerHandle_t xTimer)
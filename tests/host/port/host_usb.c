@@ -0,0 +1,515 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_usb.c
+*
+*  USB device controller model under the HAL_PCD functions usbd_conf.c
+*  calls, with the variables of m1_usb_cdc_msc.c it uses. An endpoint
+*  transfer started by the device waits for the test, which plays the USB
+*  host; the end of each transfer raises the callback of usbd_conf.c as the
+*  USB interrupt, once it is enabled in the NVIC.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "main.h"
+#include "usbd_def.h"
+#include "host_port.h"
+#include "host_usb.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define HOST_USB_EP_NUM				8
+#define HOST_USB_PACKET_SIZE		64
+#define HOST_USB_EP0_TIMEOUT_MS		1000
+
+typedef struct
+{
+	bool armed; // Transfer started by the device
+	uint8_t *buf;
+	uint32_t len;
+	uint32_t count; // OUT, length received
+} S_Host_USB_EP_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+PCD_HandleTypeDef hpcd_USB_DRD_FS;
+USBD_HandleTypeDef hUsbDeviceFS;
+volatile int8_t m1_USB_CDC_ready = -1;
+volatile int8_t m1_USB_MSC_ready = -1;
+
+static S_Host_USB_EP_t host_usb_in[HOST_USB_EP_NUM];
+static S_Host_USB_EP_t host_usb_out[HOST_USB_EP_NUM];
+static S_Host_USB_Stats_t host_usb_stats;
+static pthread_mutex_t host_usb_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_usb_cond;
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+void host_usb_init(void)
+{
+	pthread_condattr_t attr;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&host_usb_cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	hpcd_USB_DRD_FS.Instance = USB_DRD_FS;
+	hpcd_USB_DRD_FS.Init.dev_endpoints = HOST_USB_EP_NUM;
+	hpcd_USB_DRD_FS.Init.speed = PCD_SPEED_FULL;
+	host_periph_map();
+	HAL_NVIC_EnableIRQ(USB_DRD_FS_IRQn);
+} // void host_usb_init(void)
+
+
+
+void host_usb_stats_reset(void)
+{
+	pthread_mutex_lock(&host_usb_lock);
+	memset(&host_usb_stats, 0, sizeof(host_usb_stats));
+	pthread_mutex_unlock(&host_usb_lock);
+} // void host_usb_stats_reset(void)
+
+
+
+void host_usb_stats_get(S_Host_USB_Stats_t *pstats)
+{
+	pthread_mutex_lock(&host_usb_lock);
+	*pstats = host_usb_stats;
+	pthread_mutex_unlock(&host_usb_lock);
+} // void host_usb_stats_get(S_Host_USB_Stats_t *pstats)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Raises the USB interrupt for an event: waits until the interrupt
+  *         is enabled and no other handler runs, then runs the callback as
+  *         the handler
+  */
+/*============================================================================*/
+static void host_usb_irq(void (*callback)(PCD_HandleTypeDef *hpcd, uint8_t epnum), uint8_t epnum)
+{
+	uint64_t start, wait;
+
+	start = host_time_us();
+	while ( true )
+	{
+		host_isr_enter();
+		if ( NVIC_GetEnableIRQ(USB_DRD_FS_IRQn) )
+			break;
+		host_isr_exit();
+		host_sleep_us(10);
+	}
+	wait = host_time_us() - start;
+
+	pthread_mutex_lock(&host_usb_lock);
+	host_usb_stats.interrupts++;
+	host_usb_stats.irq_wait_total_us += wait;
+	if ( wait > host_usb_stats.irq_wait_max_us )
+		host_usb_stats.irq_wait_max_us = wait;
+	pthread_mutex_unlock(&host_usb_lock);
+
+	callback(&hpcd_USB_DRD_FS, epnum);
+	host_isr_exit();
+} // static void host_usb_irq(void (*callback)(PCD_HandleTypeDef *hpcd, uint8_t epnum), uint8_t epnum)
+
+
+
+static void host_usb_setup_callback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+{
+	(void)epnum;
+	HAL_PCD_SetupStageCallback(hpcd);
+} // static void host_usb_setup_callback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+
+
+
+static void host_usb_reset_callback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+{
+	(void)epnum;
+	HAL_PCD_ResetCallback(hpcd);
+} // static void host_usb_reset_callback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+
+
+
+void host_usb_reset(void)
+{
+	pthread_mutex_lock(&host_usb_lock);
+	memset(host_usb_in, 0, sizeof(host_usb_in));
+	memset(host_usb_out, 0, sizeof(host_usb_out));
+	pthread_mutex_unlock(&host_usb_lock);
+	host_usb_irq(host_usb_reset_callback, 0);
+} // void host_usb_reset(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Waits for the device to start a transfer on an endpoint
+  * @retval Endpoint, NULL on a stall or a timeout, see pres
+  */
+/*============================================================================*/
+static S_Host_USB_EP_t *host_usb_wait(uint8_t ep_addr, uint32_t timeout_ms, int32_t *pres)
+{
+	S_Host_USB_EP_t *pep;
+	PCD_EPTypeDef *ppcd_ep;
+	struct timespec deadline;
+
+	if ( ep_addr & 0x80 )
+	{
+		pep = &host_usb_in[ep_addr & 0x7F];
+		ppcd_ep = &hpcd_USB_DRD_FS.IN_ep[ep_addr & 0x7F];
+	}
+	else
+	{
+		pep = &host_usb_out[ep_addr];
+		ppcd_ep = &hpcd_USB_DRD_FS.OUT_ep[ep_addr];
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeout_ms/1000;
+	deadline.tv_nsec += (long)(timeout_ms % 1000)*1000000;
+	if ( deadline.tv_nsec >= 1000000000 )
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&host_usb_lock);
+	while ( !pep->armed && !ppcd_ep->is_stall )
+	{
+		if ( pthread_cond_timedwait(&host_usb_cond, &host_usb_lock, &deadline) )
+			break;
+	}
+	if ( ppcd_ep->is_stall )
+	{
+		*pres = HOST_USB_STALL;
+		pep = NULL;
+	}
+	else if ( !pep->armed )
+	{
+		*pres = HOST_USB_TIMEOUT;
+		pep = NULL;
+	}
+	pthread_mutex_unlock(&host_usb_lock);
+
+	return pep;
+} // static S_Host_USB_EP_t *host_usb_wait(uint8_t ep_addr, uint32_t timeout_ms, int32_t *pres)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Completes the IN transfer started on an endpoint
+  * @retval Length received, HOST_USB_STALL or HOST_USB_TIMEOUT
+  */
+/*============================================================================*/
+static int32_t host_usb_in_transfer(uint8_t ep_addr, uint8_t *data, uint32_t len, uint32_t timeout_ms)
+{
+	S_Host_USB_EP_t *pep;
+	int32_t res;
+
+	pep = host_usb_wait(ep_addr | 0x80, timeout_ms, &res);
+	if ( pep==NULL )
+		return res;
+
+	pthread_mutex_lock(&host_usb_lock);
+	res = (pep->len < len) ? pep->len:len;
+	if ( res && (data!=NULL) )
+		memcpy(data, pep->buf, res);
+	pep->armed = false;
+	pthread_mutex_unlock(&host_usb_lock);
+	host_usb_irq(HAL_PCD_DataInStageCallback, ep_addr & 0x7F);
+
+	return res;
+} // static int32_t host_usb_in_transfer(uint8_t ep_addr, uint8_t *data, uint32_t len, uint32_t timeout_ms)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Completes the OUT transfer prepared on an endpoint
+  * @retval Length sent, HOST_USB_STALL or HOST_USB_TIMEOUT
+  */
+/*============================================================================*/
+static int32_t host_usb_out_transfer(uint8_t ep_addr, const uint8_t *data, uint32_t len, uint32_t timeout_ms)
+{
+	S_Host_USB_EP_t *pep;
+	int32_t res;
+
+	pep = host_usb_wait(ep_addr & 0x7F, timeout_ms, &res);
+	if ( pep==NULL )
+		return res;
+
+	pthread_mutex_lock(&host_usb_lock);
+	res = (pep->len < len) ? pep->len:len;
+	if ( res )
+		memcpy(pep->buf, data, res);
+	pep->count = res;
+	pep->armed = false;
+	pthread_mutex_unlock(&host_usb_lock);
+	host_usb_irq(HAL_PCD_DataOutStageCallback, ep_addr & 0x7F);
+
+	return res;
+} // static int32_t host_usb_out_transfer(uint8_t ep_addr, const uint8_t *data, uint32_t len, uint32_t timeout_ms)
+
+
+
+int32_t host_usb_control(const uint8_t setup[8], uint8_t *data, uint16_t len)
+{
+	int32_t res, n;
+
+	pthread_mutex_lock(&host_usb_lock);
+	hpcd_USB_DRD_FS.IN_ep[0].is_stall = 0;
+	hpcd_USB_DRD_FS.OUT_ep[0].is_stall = 0;
+	host_usb_in[0].armed = false;
+	host_usb_out[0].armed = false;
+	memcpy(hpcd_USB_DRD_FS.Setup, setup, 8);
+	pthread_mutex_unlock(&host_usb_lock);
+	host_usb_irq(host_usb_setup_callback, 0);
+
+	res = 0;
+	if ( (setup[0] & 0x80) && len )
+	{
+		// IN data stage, then the status stage from the host
+		res = host_usb_in_transfer(0x80, data, len, HOST_USB_EP0_TIMEOUT_MS);
+		if ( res < 0 )
+			return res;
+		n = host_usb_out_transfer(0x00, NULL, 0, HOST_USB_EP0_TIMEOUT_MS);
+	}
+	else
+	{
+		// Status stage from the device
+		n = host_usb_in_transfer(0x80, NULL, 0, HOST_USB_EP0_TIMEOUT_MS);
+	}
+
+	return (n < 0) ? n:res;
+} // int32_t host_usb_control(const uint8_t setup[8], uint8_t *data, uint16_t len)
+
+
+
+int32_t host_usb_bulk_out(uint8_t ep_addr, const uint8_t *data, uint32_t len, uint32_t timeout_ms)
+{
+	uint32_t sent;
+	int32_t n;
+
+	sent = 0;
+	do
+	{
+		n = host_usb_out_transfer(ep_addr, data + sent, len - sent, timeout_ms);
+		if ( n < 0 )
+			return n;
+		sent += n;
+	} while ( sent < len );
+
+	return sent;
+} // int32_t host_usb_bulk_out(uint8_t ep_addr, const uint8_t *data, uint32_t len, uint32_t timeout_ms)
+
+
+
+int32_t host_usb_bulk_in(uint8_t ep_addr, uint8_t *data, uint32_t len, uint32_t timeout_ms)
+{
+	uint32_t received;
+	int32_t n;
+
+	received = 0;
+	do
+	{
+		n = host_usb_in_transfer(ep_addr, data + received, len - received, timeout_ms);
+		if ( n < 0 )
+			return n;
+		received += n;
+	} while ( (received < len) && n && !(n % HOST_USB_PACKET_SIZE) );
+
+	return received;
+} // int32_t host_usb_bulk_in(uint8_t ep_addr, uint8_t *data, uint32_t len, uint32_t timeout_ms)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  PCD functions called by usbd_conf.c
+  */
+/*============================================================================*/
+HAL_StatusTypeDef HAL_PCDEx_PMAConfig(PCD_HandleTypeDef *hpcd, uint16_t ep_addr, uint16_t ep_kind, uint32_t pmaadress)
+{
+	(void)hpcd;
+	(void)ep_addr;
+	(void)ep_kind;
+	(void)pmaadress;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_PCDEx_PMAConfig(...)
+
+
+
+HAL_StatusTypeDef HAL_PCD_DeInit(PCD_HandleTypeDef *hpcd)
+{
+	(void)hpcd;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_PCD_DeInit(PCD_HandleTypeDef *hpcd)
+
+
+
+HAL_StatusTypeDef HAL_PCD_Start(PCD_HandleTypeDef *hpcd)
+{
+	(void)hpcd;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_PCD_Start(PCD_HandleTypeDef *hpcd)
+
+
+
+HAL_StatusTypeDef HAL_PCD_Stop(PCD_HandleTypeDef *hpcd)
+{
+	(void)hpcd;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_PCD_Stop(PCD_HandleTypeDef *hpcd)
+
+
+
+HAL_StatusTypeDef HAL_PCD_SetAddress(PCD_HandleTypeDef *hpcd, uint8_t address)
+{
+	hpcd->USB_Address = address;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_PCD_SetAddress(PCD_HandleTypeDef *hpcd, uint8_t address)
+
+
+
+static PCD_EPTypeDef *host_usb_pcd_ep(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+{
+	return (ep_addr & 0x80) ? &hpcd->IN_ep[ep_addr & 0x7F]:&hpcd->OUT_ep[ep_addr & 0x7F];
+} // static PCD_EPTypeDef *host_usb_pcd_ep(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+
+
+
+static S_Host_USB_EP_t *host_usb_ep(uint8_t ep_addr)
+{
+	return (ep_addr & 0x80) ? &host_usb_in[ep_addr & 0x7F]:&host_usb_out[ep_addr & 0x7F];
+} // static S_Host_USB_EP_t *host_usb_ep(uint8_t ep_addr)
+
+
+
+HAL_StatusTypeDef HAL_PCD_EP_Open(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint16_t ep_mps, uint8_t ep_type)
+{
+	PCD_EPTypeDef *ep;
+
+	pthread_mutex_lock(&host_usb_lock);
+	ep = host_usb_pcd_ep(hpcd, ep_addr);
+	ep->num = ep_addr & 0x7F;
+	ep->is_in = (ep_addr & 0x80) ? 1:0;
+	ep->maxpacket = ep_mps;
+	ep->type = ep_type;
+	ep->is_stall = 0;
+	host_usb_ep(ep_addr)->armed = false;
+	pthread_mutex_unlock(&host_usb_lock);
+
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_PCD_EP_Open(...)
+
+
+
+HAL_StatusTypeDef HAL_PCD_EP_Close(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+{
+	(void)hpcd;
+	pthread_mutex_lock(&host_usb_lock);
+	host_usb_ep(ep_addr)->armed = false;
+	pthread_mutex_unlock(&host_usb_lock);
+
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_PCD_EP_Close(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+
+
+
+HAL_StatusTypeDef HAL_PCD_EP_Flush(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+{
+	(void)hpcd;
+	(void)ep_addr;
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_PCD_EP_Flush(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+
+
+
+HAL_StatusTypeDef HAL_PCD_EP_SetStall(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+{
+	pthread_mutex_lock(&host_usb_lock);
+	host_usb_pcd_ep(hpcd, ep_addr)->is_stall = 1;
+	pthread_cond_broadcast(&host_usb_cond);
+	pthread_mutex_unlock(&host_usb_lock);
+
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_PCD_EP_SetStall(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+
+
+
+HAL_StatusTypeDef HAL_PCD_EP_ClrStall(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+{
+	pthread_mutex_lock(&host_usb_lock);
+	host_usb_pcd_ep(hpcd, ep_addr)->is_stall = 0;
+	pthread_mutex_unlock(&host_usb_lock);
+
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_PCD_EP_ClrStall(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+
+
+
+HAL_StatusTypeDef HAL_PCD_EP_Transmit(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint8_t *pBuf, uint32_t len)
+{
+	PCD_EPTypeDef *ep;
+	S_Host_USB_EP_t *pep;
+
+	pthread_mutex_lock(&host_usb_lock);
+	ep = host_usb_pcd_ep(hpcd, ep_addr | 0x80);
+	ep->xfer_buff = pBuf;
+	ep->xfer_len = len;
+	pep = host_usb_ep(ep_addr | 0x80);
+	pep->buf = pBuf;
+	pep->len = len;
+	pep->armed = true;
+	pthread_cond_broadcast(&host_usb_cond);
+	pthread_mutex_unlock(&host_usb_lock);
+
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_PCD_EP_Transmit(...)
+
+
+
+HAL_StatusTypeDef HAL_PCD_EP_Receive(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint8_t *pBuf, uint32_t len)
+{
+	PCD_EPTypeDef *ep;
+	S_Host_USB_EP_t *pep;
+
+	pthread_mutex_lock(&host_usb_lock);
+	ep = host_usb_pcd_ep(hpcd, ep_addr & 0x7F);
+	ep->xfer_buff = pBuf;
+	ep->xfer_len = len;
+	pep = host_usb_ep(ep_addr & 0x7F);
+	pep->buf = pBuf;
+	pep->len = len;
+	pep->count = 0;
+	pep->armed = true;
+	pthread_cond_broadcast(&host_usb_cond);
+	pthread_mutex_unlock(&host_usb_lock);
+
+	return HAL_OK;
+} // HAL_StatusTypeDef HAL_PCD_EP_Receive(...)
+
+
+
+uint32_t HAL_PCD_EP_GetRxCount(PCD_HandleTypeDef const *hpcd, uint8_t ep_addr)
+{
+	uint32_t count;
+
+	(void)hpcd;
+	pthread_mutex_lock(&host_usb_lock);
+	count = host_usb_out[ep_addr & 0x7F].count;
+	pthread_mutex_unlock(&host_usb_lock);
+
+	return count;
+} // uint32_t HAL_PCD_EP_GetRxCount(PCD_HandleTypeDef const *hpcd, uint8_t ep_addr)
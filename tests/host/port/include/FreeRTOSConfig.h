@@ -0,0 +1,79 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  FreeRTOSConfig.h
+*
+*  FreeRTOS configuration of the host build. Kernel settings that the
+*  firmware relies on match Core/Inc/FreeRTOSConfig.h.
+*
+* M1 Project
+*
+*/
+
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#include <stdint.h>
+#include <assert.h>
+
+extern uint32_t SystemCoreClock;
+
+// newlib macro used by the firmware headers, this header is included first
+#ifndef _ATTRIBUTE
+#define _ATTRIBUTE(attrs)						__attribute__(attrs)
+#endif
+
+#define configUSE_PREEMPTION					1
+#define configSUPPORT_STATIC_ALLOCATION			0
+#define configSUPPORT_DYNAMIC_ALLOCATION		1
+#define configUSE_IDLE_HOOK						0
+#define configUSE_TICK_HOOK						0
+#define configCPU_CLOCK_HZ						(SystemCoreClock)
+#define configTICK_RATE_HZ						((TickType_t)1000)
+#define configMAX_PRIORITIES					(56)
+#define configMINIMAL_STACK_SIZE				((uint16_t)256)
+#define configTOTAL_HEAP_SIZE					((size_t)122880)
+#define configMAX_TASK_NAME_LEN					(32)
+#define configUSE_TRACE_FACILITY				1
+#define configUSE_16_BIT_TICKS					0
+#define configUSE_MUTEXES						1
+#define configQUEUE_REGISTRY_SIZE				8
+#define configUSE_RECURSIVE_MUTEXES				1
+#define configUSE_COUNTING_SEMAPHORES			1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION	0
+#define configUSE_TICKLESS_IDLE					0
+#define configUSE_TASK_NOTIFICATIONS			1
+#define configUSE_SB_COMPLETED_CALLBACK			0
+#define configMESSAGE_BUFFER_LENGTH_TYPE		size_t
+#define configRUN_TIME_COUNTER_TYPE				size_t
+#define configUSE_CO_ROUTINES					0
+#define configUSE_TIMERS						1
+#define configTIMER_TASK_PRIORITY				(2)
+#define configTIMER_QUEUE_LENGTH				10
+#define configTIMER_TASK_STACK_DEPTH			256
+#define configUSE_NEWLIB_REENTRANT				0
+
+#define INCLUDE_vTaskPrioritySet				1
+#define INCLUDE_uxTaskPriorityGet				1
+#define INCLUDE_vTaskDelete						1
+#define INCLUDE_vTaskSuspend					1
+#define INCLUDE_xTaskDelayUntil					1
+#define INCLUDE_vTaskDelay						1
+#define INCLUDE_xTaskGetSchedulerState			1
+#define INCLUDE_xQueueGetMutexHolder			1
+#define INCLUDE_xSemaphoreGetMutexHolder		1
+#define INCLUDE_uxTaskGetStackHighWaterMark		1
+#define INCLUDE_xTaskGetCurrentTaskHandle		1
+#define INCLUDE_eTaskGetState					1
+
+#define configPRIO_BITS							4
+#define configLIBRARY_LOWEST_INTERRUPT_PRIORITY			15
+#define configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY	5
+#define configKERNEL_INTERRUPT_PRIORITY			(configLIBRARY_LOWEST_INTERRUPT_PRIORITY << (8 - configPRIO_BITS))
+#define configMAX_SYSCALL_INTERRUPT_PRIORITY	(configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY << (8 - configPRIO_BITS))
+
+#define configASSERT(x)							assert(x)
+#define configCOMMAND_INT_MAX_OUTPUT_SIZE		200
+
+#endif /* FREERTOS_CONFIG_H */
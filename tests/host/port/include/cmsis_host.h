@@ -0,0 +1,92 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  cmsis_host.h
+*
+*  CMSIS compiler layer for the host build. It takes the place of cmsis_gcc.h,
+*  whose intrinsics are Arm instructions, so the device headers can be used
+*  unchanged on the host.
+*
+* M1 Project
+*
+*/
+
+#ifndef __CMSIS_GCC_H
+#define __CMSIS_GCC_H
+
+#include <stdint.h>
+
+#define __ASM						__asm
+#define __INLINE					inline
+#define __STATIC_INLINE				static inline
+#define __STATIC_FORCEINLINE		__attribute__((always_inline)) static inline
+#define __NO_RETURN					__attribute__((__noreturn__))
+#define __USED						__attribute__((used))
+#define __WEAK						__attribute__((weak))
+#define __PACKED					__attribute__((packed, aligned(1)))
+#define __PACKED_STRUCT				struct __attribute__((packed, aligned(1)))
+#define __PACKED_UNION				union __attribute__((packed, aligned(1)))
+#define __ALIGNED(x)				__attribute__((aligned(x)))
+#define __RESTRICT					__restrict
+#define __COMPILER_BARRIER()		__asm volatile("":::"memory")
+
+#define __UNALIGNED_UINT16_READ(addr)			(*(const uint16_t *)(const void *)(addr))
+#define __UNALIGNED_UINT16_WRITE(addr, val)		(void)(*(uint16_t *)(void *)(addr) = (val))
+#define __UNALIGNED_UINT32_READ(addr)			(*(const uint32_t *)(const void *)(addr))
+#define __UNALIGNED_UINT32_WRITE(addr, val)		(void)(*(uint32_t *)(void *)(addr) = (val))
+
+/*
+ * Interrupt masking is a process wide lock. A test thread that stands for an
+ * interrupt handler holds the same lock, see host_isr_enter().
+ */
+void host_irq_disable(void);
+void host_irq_enable(void);
+uint32_t host_irq_masked(void);
+
+#define __NOP()						do { } while (0)
+#define __WFI()						do { } while (0)
+#define __WFE()						do { } while (0)
+#define __SEV()						do { } while (0)
+#define __BKPT(value)				__builtin_trap()
+
+/*
+ * The firmware uses DMB to order the accesses to shared data around the
+ * index that publishes it, which an acquire-release fence guarantees. It is
+ * free on x86, as DMB costs a few cycles on the Cortex-M33, so the timings
+ * of lock-free code are not inflated by a full fence.
+ */
+__STATIC_FORCEINLINE void __DMB(void) { __atomic_thread_fence(__ATOMIC_ACQ_REL); }
+__STATIC_FORCEINLINE void __DSB(void) { __sync_synchronize(); }
+__STATIC_FORCEINLINE void __ISB(void) { __sync_synchronize(); }
+
+__STATIC_FORCEINLINE void __disable_irq(void) { host_irq_disable(); }
+__STATIC_FORCEINLINE void __enable_irq(void) { host_irq_enable(); }
+__STATIC_FORCEINLINE uint32_t __get_PRIMASK(void) { return host_irq_masked(); }
+
+__STATIC_FORCEINLINE void __set_PRIMASK(uint32_t primask)
+{
+	if ( primask )
+		host_irq_disable();
+	else
+		host_irq_enable();
+}
+
+__STATIC_FORCEINLINE uint32_t __get_IPSR(void) { return 0; }
+__STATIC_FORCEINLINE uint32_t __get_BASEPRI(void) { return 0; }
+__STATIC_FORCEINLINE void __set_BASEPRI(uint32_t basepri) { (void)basepri; }
+__STATIC_FORCEINLINE uint8_t __CLZ(uint32_t value) { return value ? __builtin_clz(value):32; }
+__STATIC_FORCEINLINE uint32_t __REV(uint32_t value) { return __builtin_bswap32(value); }
+__STATIC_FORCEINLINE uint32_t __REV16(uint32_t value) { return ((value & 0x00FF00FFUL) << 8) | ((value >> 8) & 0x00FF00FFUL); }
+
+__STATIC_FORCEINLINE uint32_t __RBIT(uint32_t value)
+{
+	uint32_t result = 0;
+	uint8_t i;
+
+	for (i=0; i<32; i++, value >>= 1)
+		result = (result << 1) | (value & 0x01);
+	return result;
+}
+
+#endif /* __CMSIS_GCC_H */
@@ -0,0 +1,20 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  core_cm33.h
+*
+*  Host build: loads the host compiler layer before the CMSIS core header,
+*  which then skips cmsis_gcc.h.
+*
+* M1 Project
+*
+*/
+
+#ifndef HOST_CORE_CM33_H
+#define HOST_CORE_CM33_H
+
+#include "cmsis_host.h"
+#include_next <core_cm33.h>
+
+#endif /* HOST_CORE_CM33_H */
@@ -0,0 +1,58 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_fatfs.h
+*
+*  RAM disk under the FatFs R015 module of the host build
+*
+* M1 Project
+*
+*/
+
+#ifndef HOST_FATFS_H_
+#define HOST_FATFS_H_
+
+#include <stdint.h>
+#include "ff.h"
+
+typedef struct
+{
+	uint32_t reads; // disk_read() calls
+	uint32_t writes; // disk_write() calls
+	uint32_t syncs;
+	uint32_t sectors_read;
+	uint32_t sectors_written;
+	uint32_t fat_sectors_read; // Sectors of the FATs, both copies
+	uint32_t fat_sectors_written;
+	uint64_t busy_us; // Card time, see host_disk_set_timing()
+} S_Host_Disk_Stats_t;
+
+/*
+ * Creates a blank RAM disk of the given size, formats it and mounts it as
+ * the default drive. Returns NULL on error.
+ */
+FATFS *host_fatfs_mount(uint32_t sectors);
+// Mounts the drive again, as after a reset, keeping the disk content
+FATFS *host_fatfs_remount(void);
+void host_fatfs_unmount(void);
+// Changed by every mount and unmount, as m1_sdcard_get_mount_generation()
+uint32_t host_fatfs_get_mount_count(void);
+
+/*
+ * Card time of a read or write command and of every sector it transfers.
+ * The calling thread sleeps for that time, as the SD card driver blocks on
+ * the transfer, and the time is added to S_Host_Disk_Stats_t.busy_us.
+ */
+void host_disk_set_timing(uint32_t command_us, uint32_t sector_us);
+void host_disk_stats_reset(void);
+void host_disk_stats_get(S_Host_Disk_Stats_t *pstats);
+
+/*
+ * Power cut: the next n sectors are written, all the following writes fail
+ * until host_disk_fail_clear() or the next mount.
+ */
+void host_disk_fail_writes_after(uint32_t n);
+void host_disk_fail_clear(void);
+
+#endif /* HOST_FATFS_H_ */
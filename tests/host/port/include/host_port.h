@@ -0,0 +1,54 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_port.h
+*
+*  Services of the host port layer to the tests
+*
+* M1 Project
+*
+*/
+
+#ifndef HOST_PORT_H_
+#define HOST_PORT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+uint64_t host_time_us(void);
+void host_sleep_us(uint32_t us);
+void host_isr_enter(void);
+void host_isr_exit(void);
+// Tasks created with xTaskCreate() since the start
+uint32_t host_tasks_created(void);
+
+/*
+ * Log output of the firmware modules, M1_LOG_x(). Messages above the level
+ * are dropped, the default level is set by the M1_HOST_LOG environment
+ * variable (0-5, S_M1_LogDebugLevel_t) or is LOG_DEBUG_LEVEL_ERROR.
+ */
+void host_log_set_level(uint8_t level);
+
+/*
+ * GPIO model: output levels are kept per port and pin, inputs read back the
+ * last written level unless a test sets them. The hook, if any, is called
+ * for every write. The read hook, if any, returns the level of every read,
+ * so a device model can drive an input from its own state.
+ */
+typedef void (*host_gpio_hook_t)(void *port, uint16_t pin, uint8_t state);
+typedef uint8_t (*host_gpio_read_hook_t)(void *port, uint16_t pin, uint8_t state);
+
+void host_gpio_set_input(void *port, uint16_t pin, uint8_t state);
+void host_gpio_set_hook(host_gpio_hook_t hook);
+void host_gpio_set_read_hook(host_gpio_read_hook_t hook);
+
+/*
+ * Maps RAM at the addresses of the EXTI, of the Cortex-M system control
+ * space and of the DWT, for the modules which access these registers
+ * directly. Writes are plain memory writes, except that HAL_NVIC_EnableIRQ()
+ * and HAL_NVIC_DisableIRQ() then keep the NVIC enable bits.
+ */
+void host_periph_map(void);
+
+#endif /* HOST_PORT_H_ */
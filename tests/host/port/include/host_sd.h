@@ -0,0 +1,49 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_sd.h
+*
+*  SD card model under the HAL_SD DMA functions of the host build: a RAM
+*  image accessed by the USB MSC storage, not by FatFs
+*
+* M1 Project
+*
+*/
+
+#ifndef HOST_SD_H_
+#define HOST_SD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+	uint32_t read_commands;
+	uint32_t write_commands;
+	uint32_t blocks_read;
+	uint32_t blocks_written;
+	uint32_t rejected_writes; // See host_sd_fail_writes()
+} S_Host_SD_Stats_t;
+
+/*
+ * Creates a blank card of the given size, present and not mounted by the
+ * firmware, and the completion queue of m1_sdcard.c
+ */
+void host_sd_init(uint32_t blocks);
+uint8_t *host_sd_image(void);
+void host_sd_set_present(bool present);
+
+/*
+ * Card time of a read or write command and of every block it transfers,
+ * after which the DMA completion interrupt is raised, and time the card
+ * stays in the programming state after a write
+ */
+void host_sd_set_timing(uint32_t command_us, uint32_t block_us, uint32_t program_us);
+void host_sd_stats_reset(void);
+void host_sd_stats_get(S_Host_SD_Stats_t *pstats);
+
+// The next n write commands are rejected by the card
+void host_sd_fail_writes(uint32_t n);
+
+#endif /* HOST_SD_H_ */
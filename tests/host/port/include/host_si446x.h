@@ -0,0 +1,72 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_si446x.h
+*
+*  SI446x radio models of the host build
+*
+* M1 Project
+*
+*/
+
+#ifndef HOST_SI446X_H_
+#define HOST_SI446X_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "host_port.h"
+
+/*
+ * API stub, host_si446x_api.c
+ */
+void host_si446x_set_rssi(int16_t rssi);
+uint32_t host_si446x_modem_status_reads(void);
+// SI446x_Get_ModemStatus() calls made without SI446x_Lock() or SI446x_Try_Lock()
+uint32_t host_si446x_unlocked_reads(void);
+
+/*
+ * SPI model, host_rf_spi.c, under the radio API of m1_sub_ghz_api.c.
+ * Times are ns of the virtual radio clock. cpu_ns is the time the tasks
+ * and the interrupts spend on the radio: blocking transfers, CTS polling,
+ * DMA setup and interrupt handlers.
+ */
+#define HOST_SI446X_GROUPS			256
+#define HOST_SI446X_PROPS			256
+#define HOST_SI446X_GPIO_CFG		7 // GPIO0-3, NIRQ, SDO, GEN_CONFIG
+
+typedef struct
+{
+	uint8_t props[HOST_SI446X_GROUPS][HOST_SI446X_PROPS];
+	uint8_t gpio[HOST_SI446X_GPIO_CFG];
+} S_Host_SI446x_Config_t;
+
+typedef struct
+{
+	uint32_t frames; // SPI transfers, blocking or DMA
+	uint32_t dma_frames;
+	uint32_t bytes;
+	uint32_t cmds; // Commands executed by the radio
+	uint32_t props_set;
+	uint32_t frr_reads;
+	uint32_t cts_edges; // Rising edges of nIRQ handled by the EXTI interrupt
+	uint32_t overruns; // Commands sent before CTS, dropped by the radio
+	uint32_t bad_cmds;
+	uint32_t bus_conflicts; // Blocking transfers during a DMA transfer
+	uint32_t dma_aborts;
+	uint32_t resets;
+	uint64_t radio_ns;
+	uint64_t cpu_ns;
+} S_Host_SI446x_Stats_t;
+
+// Without DMA, the command queue is sent by blocking transfers
+void host_si446x_model_init(bool dma);
+void host_si446x_add_signal(uint32_t freq_hz, int16_t dbm);
+void host_si446x_clear_signals(void);
+uint32_t host_si446x_frequency(void);
+void host_si446x_wait(uint64_t ns);
+void host_si446x_get_config(S_Host_SI446x_Config_t *pconfig);
+void host_si446x_get_stats(S_Host_SI446x_Stats_t *pstats);
+void host_si446x_stats_diff(const S_Host_SI446x_Stats_t *pstart, S_Host_SI446x_Stats_t *pend);
+
+#endif /* HOST_SI446X_H_ */
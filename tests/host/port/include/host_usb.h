@@ -0,0 +1,53 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  host_usb.h
+*
+*  USB device controller model under the HAL_PCD functions of the host
+*  build. The test plays the USB host: its transfers raise the interrupt
+*  callbacks of usbd_conf.c, once the USB interrupt is unmasked in the NVIC.
+*
+* M1 Project
+*
+*/
+
+#ifndef HOST_USB_H_
+#define HOST_USB_H_
+
+#include <stdint.h>
+
+#define HOST_USB_STALL				(-1)
+#define HOST_USB_TIMEOUT			(-2)
+
+typedef struct
+{
+	uint32_t interrupts;
+	uint64_t irq_wait_max_us; // Longest time an event waited for the USB interrupt to be unmasked
+	uint64_t irq_wait_total_us;
+} S_Host_USB_Stats_t;
+
+// Maps the NVIC and enables the USB interrupt, as HAL_PCD_MspInit() does
+void host_usb_init(void);
+// Bus reset
+void host_usb_reset(void);
+
+/*
+ * Control transfer on endpoint 0, without an OUT data stage. Returns the
+ * length of the IN data stage, HOST_USB_STALL or HOST_USB_TIMEOUT.
+ */
+int32_t host_usb_control(const uint8_t setup[8], uint8_t *data, uint16_t len);
+
+/*
+ * Bulk transfers. The OUT data is cut into the transfers the device
+ * prepares, the IN data is gathered from the transfers it starts until len
+ * bytes or a short transfer. Both return the length transferred,
+ * HOST_USB_STALL or HOST_USB_TIMEOUT.
+ */
+int32_t host_usb_bulk_out(uint8_t ep_addr, const uint8_t *data, uint32_t len, uint32_t timeout_ms);
+int32_t host_usb_bulk_in(uint8_t ep_addr, uint8_t *data, uint32_t len, uint32_t timeout_ms);
+
+void host_usb_stats_reset(void);
+void host_usb_stats_get(S_Host_USB_Stats_t *pstats);
+
+#endif /* HOST_USB_H_ */
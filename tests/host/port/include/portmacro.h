@@ -0,0 +1,64 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  portmacro.h
+*
+*  FreeRTOS port definitions for the host build. Tasks run as POSIX threads,
+*  see host_rtos.c.
+*
+* M1 Project
+*
+*/
+
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#include <stdint.h>
+
+#define portCHAR					char
+#define portFLOAT					float
+#define portDOUBLE					double
+#define portLONG					long
+#define portSHORT					short
+#define portSTACK_TYPE				uint32_t
+#define portBASE_TYPE				long
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define portMAX_DELAY				(TickType_t)0xffffffffUL
+#define portTICK_TYPE_IS_ATOMIC		1
+#define portSTACK_GROWTH			(-1)
+#define portTICK_PERIOD_MS			((TickType_t)1000/configTICK_RATE_HZ)
+#define portBYTE_ALIGNMENT			8
+#define portNOP()
+#define portINLINE					__inline
+#define portFORCE_INLINE			inline __attribute__((always_inline))
+#define portARCH_NAME				"Host"
+#define portDONT_DISCARD			__attribute__((used))
+#define portMEMORY_BARRIER()		__sync_synchronize()
+
+void vPortYield(void);
+void vPortEnterCritical(void);
+void vPortExitCritical(void);
+uint32_t ulSetInterruptMask(void);
+void vClearInterruptMask(uint32_t ulMask);
+BaseType_t xPortIsInsideInterrupt(void);
+
+#define portYIELD()								vPortYield()
+#define portEND_SWITCHING_ISR(xSwitchRequired)	do { (void)(xSwitchRequired); } while (0)
+#define portYIELD_FROM_ISR(x)					portEND_SWITCHING_ISR(x)
+#define portSET_INTERRUPT_MASK_FROM_ISR()		ulSetInterruptMask()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x)	vClearInterruptMask(x)
+#define portDISABLE_INTERRUPTS()				ulSetInterruptMask()
+#define portENABLE_INTERRUPTS()					vClearInterruptMask(0)
+#define portENTER_CRITICAL()					vPortEnterCritical()
+#define portEXIT_CRITICAL()						vPortExitCritical()
+
+#define portTASK_FUNCTION_PROTO(vFunction, pvParameters)	void vFunction(void *pvParameters)
+#define portTASK_FUNCTION(vFunction, pvParameters)			void vFunction(void *pvParameters)
+
+#endif /* PORTMACRO_H */
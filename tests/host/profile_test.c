@@ -0,0 +1,234 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  profile_test.c
+*
+*  Profile sessions on a FatFs RAM disk: values read back after a commit,
+*  disk writes of one commit against one write_private_profile_string() per
+*  entry, and a power cut at every sector written by a commit.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "ff.h"
+#include "m1_file_browser.h"
+#include "privateprofilestring.h"
+#include "host_fatfs.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_DISK_SECTORS			(64*1024) // 32 MB
+#define TEST_FILENAME				"/test.nfc"
+#define TEST_ENTRIES				24
+#define TEST_VALUE_SIZE				64
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static void test_key(char *key, int i)
+{
+	sprintf(key, "Page %d", i);
+} // static void test_key(char *key, int i)
+
+
+
+static void test_value(char *value, int i, const char *version)
+{
+	sprintf(value, "%02X %02X %02X %02X %s", i, i ^ 0x5A, i*7 & 0xFF, i*13 & 0xFF, version);
+} // static void test_value(char *value, int i, const char *version)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Writes every entry with the given version in one session
+  * @retval profile_commit() result
+  */
+/*============================================================================*/
+static int test_write_all(const char *version)
+{
+	ProfileSession ps;
+	char key[16], value[TEST_VALUE_SIZE];
+	int i, ret;
+
+	if ( !profile_open(&ps, TEST_FILENAME) )
+		return 0;
+	for (i=0; i<TEST_ENTRIES; i++)
+	{
+		test_key(key, i);
+		test_value(value, i, version);
+		HOST_CHECK(profile_set(&ps, key, value));
+	}
+	ret = profile_commit(&ps);
+	profile_close(&ps);
+
+	return ret;
+} // static int test_write_all(const char *version)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Reads every entry back
+  * @retval Version found in all the entries, NULL if they are missing or
+  *         do not all have the same one
+  */
+/*============================================================================*/
+static const char *test_read_all(void)
+{
+	static const char *versions[] = {"old", "new"};
+	ProfileSession ps;
+	ParsedValue val;
+	char key[16], value[TEST_VALUE_SIZE], expected[TEST_VALUE_SIZE];
+	const char *found;
+	int i, v;
+
+	if ( !profile_open(&ps, TEST_FILENAME) )
+		return NULL;
+	found = NULL;
+	for (i=0; i<TEST_ENTRIES; i++)
+	{
+		test_key(key, i);
+		memset(&val, 0, sizeof(val));
+		val.buf = value;
+		val.max_len = sizeof(value);
+		if ( !profile_get_string(&ps, &val, key) )
+		{
+			found = NULL;
+			break;
+		}
+		for (v=0; v<2; v++)
+		{
+			test_value(expected, i, versions[v]);
+			if ( !strcmp(value, expected) )
+				break;
+		}
+		if ( v==2 || (found!=NULL && found!=versions[v]) )
+		{
+			found = NULL;
+			break;
+		}
+		found = versions[v];
+	} // for (i=0; i<TEST_ENTRIES; i++)
+	profile_close(&ps);
+
+	return found;
+} // static const char *test_read_all(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Sectors written to update every entry, with a session and with
+  *         one call per entry
+  */
+/*============================================================================*/
+static void test_writes(void)
+{
+	S_Host_Disk_Stats_t session, per_entry;
+	char key[16], value[TEST_VALUE_SIZE];
+	int i;
+
+	HOST_CHECK(test_write_all("old"));
+	HOST_CHECK(test_read_all()!=NULL && !strcmp(test_read_all(), "old"));
+
+	host_disk_stats_reset();
+	HOST_CHECK(test_write_all("new"));
+	host_disk_stats_get(&session);
+	HOST_CHECK(test_read_all()!=NULL && !strcmp(test_read_all(), "new"));
+
+	host_disk_stats_reset();
+	for (i=0; i<TEST_ENTRIES; i++)
+	{
+		test_key(key, i);
+		test_value(value, i, "old");
+		HOST_CHECK(write_private_profile_string(key, value, TEST_FILENAME));
+	}
+	host_disk_stats_get(&per_entry);
+	HOST_CHECK(test_read_all()!=NULL && !strcmp(test_read_all(), "old"));
+
+	printf("%d entries:            sectors written  sectors read\n", TEST_ENTRIES);
+	printf("  one session            %15u %13u\n", session.sectors_written, session.sectors_read);
+	printf("  one call per entry     %15u %13u\n", per_entry.sectors_written, per_entry.sectors_read);
+	// Every call rewrites the whole file, the session does it once
+	HOST_CHECK(session.sectors_written*TEST_ENTRIES/2 <= per_entry.sectors_written);
+
+	// Nothing left behind by the replaces
+	HOST_CHECK_EQ(f_stat(TEST_FILENAME M1_FB_BACKUP_SUFFIX, NULL), FR_NO_FILE);
+	HOST_CHECK_EQ(f_stat(TEST_FILENAME PROFILE_TMP_SUFFIX, NULL), FR_NO_FILE);
+} // static void test_writes(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Cuts the power after every sector written by a commit: after the
+  *         next mount, the file has either all the old entries or all the
+  *         new ones
+  */
+/*============================================================================*/
+static void test_power_cut(void)
+{
+	S_Host_Disk_Stats_t stats;
+	const char *found;
+	uint32_t n, restored, committed;
+
+	HOST_CHECK(test_write_all("old"));
+	host_disk_stats_reset();
+	HOST_CHECK(test_write_all("new"));
+	host_disk_stats_get(&stats);
+
+	restored = 0;
+	committed = 0;
+	for (n=0; n<=stats.sectors_written; n++)
+	{
+		HOST_CHECK(test_write_all("old"));
+		host_disk_fail_writes_after(n);
+		if ( test_write_all("new") )
+			committed++;
+		host_disk_fail_clear();
+		HOST_CHECK(host_fatfs_remount()!=NULL);
+
+		if ( f_stat(TEST_FILENAME, NULL)==FR_NO_FILE )
+			restored++;
+		found = test_read_all();
+		HOST_CHECK(found!=NULL);
+		if ( found==NULL )
+			printf("  cut after %u sectors: entries lost\n", n);
+	} // for (n=0; n<=stats.sectors_written; n++)
+	printf("Power cut at %u points, %u with the file restored from its backup\n",
+			stats.sectors_written + 1, restored);
+	// The cut falls at least once between the two renames of the replace
+	HOST_CHECK(restored > 0);
+	HOST_CHECK(committed > 0);
+
+	// The next commit clears what the cut left
+	HOST_CHECK(test_write_all("new"));
+	HOST_CHECK(test_read_all()!=NULL && !strcmp(test_read_all(), "new"));
+	HOST_CHECK_EQ(f_stat(TEST_FILENAME M1_FB_BACKUP_SUFFIX, NULL), FR_NO_FILE);
+} // static void test_power_cut(void)
+
+
+
+int main(void)
+{
+	HOST_CHECK(host_fatfs_mount(TEST_DISK_SECTORS)!=NULL);
+
+	test_writes();
+	test_power_cut();
+
+	host_fatfs_unmount();
+
+	return host_test_result("profile_test");
+} // int main(void)
@@ -0,0 +1,126 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  rssi_worker_test.c
+*
+*  RSSI worker of the Sub-GHz decoder against the SI446x API stub: the task
+*  is created once for any number of receiver starts, does not touch the
+*  radio once subghz_rssi_worker_stop() has returned, shares the radio with
+*  another task, and the decoded packet gets the RSSI sampled during it.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include "main.h"
+#include "m1_sub_ghz_decenc.h"
+#include "m1_sub_ghz_api.h"
+#include "host_si446x.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_CYCLES					300 // Receiver starts and stops
+#define TEST_IDLE_CHECK				25 // One stop out of this many waits for a stray radio access
+#define TEST_RSSI					-63 // dBm
+#define TEST_OTHER_TASK_US			300 // Radio time of each command of the other task
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+static volatile bool test_other_run;
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+/*============================================================================*/
+/**
+  * @brief  Another task sending commands to the radio, as the CLI would
+  */
+/*============================================================================*/
+static void *test_other_task(void *argument)
+{
+	(void)argument;
+	while ( test_other_run )
+	{
+		SI446x_Lock();
+		SI446x_Get_ModemStatus(0x00);
+		host_sleep_us(TEST_OTHER_TASK_US);
+		SI446x_Unlock();
+		host_sleep_us(TEST_OTHER_TASK_US);
+	}
+
+	return NULL;
+} // static void *test_other_task(void *argument)
+
+
+
+int main(void)
+{
+	pthread_t other;
+	uint64_t t_start, stop_us, stop_us_max, stop_us_total;
+	uint32_t i, tasks, reads, idle_reads;
+	int16_t rssi;
+
+	subghz_decenc_init();
+	SI446x_Lock_Init();
+	host_si446x_set_rssi(TEST_RSSI);
+	tasks = host_tasks_created();
+
+	test_other_run = true;
+	pthread_create(&other, NULL, test_other_task, NULL);
+	srand(1);
+	stop_us_max = 0;
+	stop_us_total = 0;
+	idle_reads = 0;
+	for (i=0; i<TEST_CYCLES; i++)
+	{
+		subghz_rssi_worker_start();
+		host_sleep_us(rand() % (3*SUBGHZ_RSSI_SAMPLE_PERIOD*1000));
+		t_start = host_time_us();
+		subghz_rssi_worker_stop();
+		stop_us = host_time_us() - t_start;
+		stop_us_total += stop_us;
+		if ( stop_us > stop_us_max )
+			stop_us_max = stop_us;
+		if ( !(i % TEST_IDLE_CHECK) )
+		{
+			test_other_run = false; // Only the worker could read the modem status now
+			pthread_join(other, NULL);
+			reads = host_si446x_modem_status_reads();
+			host_sleep_us(3*SUBGHZ_RSSI_SAMPLE_PERIOD*1000);
+			idle_reads += host_si446x_modem_status_reads() - reads;
+			test_other_run = true;
+			pthread_create(&other, NULL, test_other_task, NULL);
+		} // if ( !(i % TEST_IDLE_CHECK) )
+	} // for (i=0; i<TEST_CYCLES; i++)
+	test_other_run = false;
+	pthread_join(other, NULL);
+
+	printf("%u starts: %u task(s) created, stop took %llu us on average and %llu us at most, %u radio reads while stopped, "
+			"%u without the lock\n", TEST_CYCLES, host_tasks_created() - tasks, (unsigned long long)stop_us_total/TEST_CYCLES,
+			(unsigned long long)stop_us_max, idle_reads, host_si446x_unlocked_reads());
+	HOST_CHECK_EQ(host_tasks_created() - tasks, 1);
+	HOST_CHECK_EQ(idle_reads, 0);
+	HOST_CHECK_EQ(host_si446x_unlocked_reads(), 0);
+	// Stop waits for the radio, which the other task keeps for TEST_OTHER_TASK_US at most.
+	// The maximum is left unchecked, it depends on the load of the host.
+	HOST_CHECK(stop_us_total/TEST_CYCLES < TEST_OTHER_TASK_US*2);
+
+	// A packet received during the last samples gets their RSSI
+	subghz_rssi_worker_start();
+	host_sleep_us(10*SUBGHZ_RSSI_SAMPLE_PERIOD*1000);
+	subghz_decenc_ctl.ndecodedendtick = HAL_GetTick();
+	subghz_decenc_ctl.ndecodedstarttick = subghz_decenc_ctl.ndecodedendtick - 5*SUBGHZ_RSSI_SAMPLE_PERIOD;
+	subghz_rssi_worker_stop();
+	rssi = subghz_decenc_ctl.subghz_get_decoded_rssi();
+	printf("Packet RSSI %d dBm\n", rssi);
+	HOST_CHECK_EQ(rssi, TEST_RSSI);
+
+	return host_test_result("rssi_worker_test");
+} // int main(void)
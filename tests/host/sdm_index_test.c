@@ -0,0 +1,188 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  sdm_index_test.c
+*
+*  File index of the SD card manager in a directory of 10000 data files:
+*  the number of a new file comes from the index in a few sector reads
+*  instead of a scan, survives a remount, and the directory is scanned
+*  again when the index is corrupted, when its entry has been dropped, or
+*  when files were added behind its back.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "ff.h"
+#include "m1_sdcard.h"
+#include "m1_sdcard_man.h"
+#include "host_port.h"
+#include "host_fatfs.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_DISK_SECTORS			(128*1024) // 64 MB
+#define TEST_FILES					10000
+#define TEST_PREFIX					DATA_FILE_PREFIX "_" // As m1_sdm_file_init() makes it, without infix and suffix
+#define TEST_LOOKUP_READS_MAX		4 // Sector reads of an indexed lookup
+#define TEST_COPIED_FILES			5 // Added by another device
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static void test_create(uint32_t number)
+{
+	char filename[64];
+	FIL file;
+
+	sprintf(filename, "%s/%s%u%s", DATA_FILEPATH, TEST_PREFIX, number, DATA_FILE_EXTENSION);
+	HOST_CHECK(f_open(&file, filename, FA_CREATE_NEW | FA_WRITE)==FR_OK);
+	f_close(&file);
+} // static void test_create(uint32_t number)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Number of the next file, and the sector reads it took
+  */
+/*============================================================================*/
+static uint32_t test_get_next(bool rescan, uint32_t *preads)
+{
+	S_Host_Disk_Stats_t disk;
+	uint32_t file_n;
+
+	host_disk_stats_reset();
+	file_n = m1_sdm_index_get_next(DATA_FILEPATH, TEST_PREFIX, DATA_FILE_EXTENSION, rescan);
+	host_disk_stats_get(&disk);
+	*preads = disk.sectors_read;
+
+	return file_n;
+} // static uint32_t test_get_next(bool rescan, uint32_t *preads)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Creates the next data file through m1_sdm_file_init() and closes it
+  */
+/*============================================================================*/
+static void test_file_init(char *filename, uint32_t *preads)
+{
+	S_M1_SDM_DatFileInfo_t datfile;
+	S_Host_Disk_Stats_t disk;
+
+	memset(&datfile, 0, sizeof(datfile));
+	datfile.dir_name = DATA_FILEPATH;
+	datfile.file_prefix = DATA_FILE_PREFIX;
+	datfile.file_infix = "";
+	datfile.file_suffix = "";
+	datfile.file_ext = DATA_FILE_EXTENSION;
+	host_disk_stats_reset();
+	HOST_CHECK_EQ(m1_sdm_file_init(&datfile), 0);
+	host_disk_stats_get(&disk);
+	*preads = disk.sectors_read;
+	strcpy(filename, (char *)datfile.dat_filename);
+
+	m1_sdm_task_init();
+	m1_sdm_task_start();
+	m1_sdm_task_stop(); // Closes the file
+	m1_sdm_task_deinit();
+} // static void test_file_init(char *filename, uint32_t *preads)
+
+
+
+static void test_corrupt_index(void)
+{
+	FIL file;
+	UINT count;
+	uint8_t byte;
+
+	HOST_CHECK(f_open(&file, M1_SDM_INDEX_FILENAME, FA_READ | FA_WRITE)==FR_OK);
+	f_lseek(&file, offsetof(S_M1_SDM_Index_t, entry[0].last_number));
+	f_read(&file, &byte, 1, &count);
+	byte ^= 0x40;
+	f_lseek(&file, offsetof(S_M1_SDM_Index_t, entry[0].last_number));
+	f_write(&file, &byte, 1, &count);
+	f_close(&file);
+} // static void test_corrupt_index(void)
+
+
+
+int main(void)
+{
+	char filename[64], expected[64], dirname[16];
+	FILINFO fno;
+	uint32_t i, reads, scan_reads, file_reads, file_n;
+
+	HOST_CHECK(host_fatfs_mount(TEST_DISK_SECTORS)!=NULL);
+	HOST_CHECK(f_mkdir(DATA_FILEPATH)==FR_OK);
+	for (i=1; i<=TEST_FILES; i++)
+		test_create(i);
+
+	// No index yet: the directory is scanned
+	file_n = test_get_next(false, &scan_reads);
+	HOST_CHECK_EQ(file_n, TEST_FILES + 1);
+	HOST_CHECK_EQ(test_get_next(true, &reads), TEST_FILES + 1);
+
+	// The first file creates the index, hidden from the file browser
+	test_file_init(filename, &reads);
+	sprintf(expected, "%s/%s%u%s", DATA_FILEPATH, TEST_PREFIX, TEST_FILES + 1, DATA_FILE_EXTENSION);
+	HOST_CHECK(!strcmp(filename, expected));
+	HOST_CHECK(f_stat(M1_SDM_INDEX_FILENAME, &fno)==FR_OK);
+	HOST_CHECK(fno.fattrib & AM_HID);
+	HOST_CHECK_EQ(fno.fsize, sizeof(S_M1_SDM_Index_t));
+
+	// Indexed, also after a remount
+	HOST_CHECK(host_fatfs_remount()!=NULL);
+	file_n = test_get_next(false, &reads);
+	HOST_CHECK_EQ(file_n, TEST_FILES + 2);
+	HOST_CHECK(reads <= TEST_LOOKUP_READS_MAX);
+	test_file_init(filename, &file_reads);
+	sprintf(expected, "%s/%s%u%s", DATA_FILEPATH, TEST_PREFIX, TEST_FILES + 2, DATA_FILE_EXTENSION);
+	HOST_CHECK(!strcmp(filename, expected));
+	printf("%u files: next number in %u sector reads by a scan, %u from the index; new file %u sector reads\n",
+			TEST_FILES, scan_reads, reads, file_reads);
+
+	// Files copied in over USB: existing numbers are skipped, then the directory is scanned again
+	for (i=1; i<=TEST_COPIED_FILES; i++)
+		test_create(TEST_FILES + 2 + i);
+	test_file_init(filename, &reads);
+	sprintf(expected, "%s/%s%u%s", DATA_FILEPATH, TEST_PREFIX, TEST_FILES + 3 + TEST_COPIED_FILES, DATA_FILE_EXTENSION);
+	HOST_CHECK(!strcmp(filename, expected));
+	HOST_CHECK_EQ(test_get_next(false, &reads), TEST_FILES + 4 + TEST_COPIED_FILES);
+
+	// Corrupted index: scanned again, then rewritten
+	test_corrupt_index();
+	HOST_CHECK_EQ(test_get_next(false, &reads), TEST_FILES + 4 + TEST_COPIED_FILES);
+	HOST_CHECK(reads > TEST_LOOKUP_READS_MAX);
+	test_file_init(filename, &reads);
+	HOST_CHECK_EQ(test_get_next(false, &reads), TEST_FILES + 5 + TEST_COPIED_FILES);
+	HOST_CHECK(reads <= TEST_LOOKUP_READS_MAX);
+
+	// More directories than entries: the oldest entry is dropped, its directory is scanned
+	for (i=0; i<M1_SDM_INDEX_ENTRIES; i++)
+	{
+		sprintf(dirname, "/D%u", i);
+		HOST_CHECK_EQ(m1_sdm_index_update(dirname, TEST_PREFIX, DATA_FILE_EXTENSION, i + 1), 0);
+	}
+	for (i=0; i<M1_SDM_INDEX_ENTRIES; i++)
+	{
+		sprintf(dirname, "/D%u", i);
+		HOST_CHECK_EQ(m1_sdm_index_get_next(dirname, TEST_PREFIX, DATA_FILE_EXTENSION, false), i + 2);
+	}
+	HOST_CHECK_EQ(test_get_next(false, &reads), TEST_FILES + 5 + TEST_COPIED_FILES);
+	HOST_CHECK(reads > TEST_LOOKUP_READS_MAX);
+
+	return host_test_result("sdm_index_test");
+} // int main(void)
@@ -0,0 +1,166 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  sdm_test.c
+*
+*  Streams data through the SD card manager to a RAM disk that takes as long
+*  as an SD card, checks the file content and the write-behind counters, and
+*  reports the throughput.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "ff.h"
+#include "m1_sdcard.h"
+#include "m1_sdcard_man.h"
+#include "host_port.h"
+#include "host_fatfs.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_DISK_SECTORS			(128*1024) // 64 MB
+#define TEST_CARD_COMMAND_US		500 // Class 10 card, about 20 MB/s for long writes
+#define TEST_CARD_SECTOR_US			25
+#define TEST_CHUNK_SIZE				512 // Bytes per m1_sdm_fill_buffer() call, as the Sub-GHz recorder
+#define TEST_STREAM_SIZE			(8*1024*1024)
+#define TEST_PACED_SIZE				(256*1024)
+#define TEST_PACED_RATE				(256*1024) // Bytes per second
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static void test_pattern(uint8_t *pbuffer, uint32_t offset, uint32_t size)
+{
+	while ( size-- )
+	{
+		*pbuffer++ = (uint8_t)(offset ^ (offset >> 8) ^ (offset >> 16));
+		offset++;
+	}
+} // static void test_pattern(uint8_t *pbuffer, uint32_t offset, uint32_t size)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Checks that the file holds the pattern and nothing else
+  */
+/*============================================================================*/
+static void test_check_file(const char *filename, uint32_t size)
+{
+	static uint8_t rd[32*1024], expected[sizeof(rd)];
+	FIL file;
+	UINT n;
+	uint32_t offset, mismatch;
+
+	HOST_CHECK(f_open(&file, filename, FA_READ)==FR_OK);
+	HOST_CHECK_EQ(f_size(&file), size);
+	mismatch = 0;
+	for (offset=0; offset<size; offset+=n)
+	{
+		if ( f_read(&file, rd, sizeof(rd), &n)!=FR_OK || !n )
+			break;
+		test_pattern(expected, offset, n);
+		if ( memcmp(rd, expected, n) )
+			mismatch++;
+	}
+	f_close(&file);
+	HOST_CHECK_EQ(offset, size);
+	HOST_CHECK_EQ(mismatch, 0);
+} // static void test_check_file(const char *filename, uint32_t size)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Writes size bytes through the SD card manager, at most rate bytes
+  *         per second if rate is not 0, into the file named in datfile
+  */
+/*============================================================================*/
+static void test_stream(uint32_t size, uint32_t rate, S_M1_SDM_DatFileInfo_t *pdatfile, S_M1_SDM_Stats_t *pstats,
+		uint64_t *pelapsed_us)
+{
+	uint8_t chunk[TEST_CHUNK_SIZE];
+	uint64_t t_start, t_due;
+	uint32_t offset;
+	uint8_t ret;
+
+	memset(pdatfile, 0, sizeof(S_M1_SDM_DatFileInfo_t));
+	pdatfile->dir_name = DATA_FILEPATH;
+	pdatfile->file_prefix = DATA_FILE_PREFIX;
+	pdatfile->file_infix = "";
+	pdatfile->file_suffix = "";
+	pdatfile->file_ext = DATA_FILE_EXTENSION;
+	HOST_CHECK(m1_sdm_file_init(pdatfile)==0);
+
+	m1_sdm_task_init();
+	m1_sdm_task_start();
+	t_start = host_time_us();
+	ret = 0;
+	for (offset=0; offset<size && !ret; offset+=sizeof(chunk))
+	{
+		if ( rate )
+		{
+			t_due = t_start + (uint64_t)offset*1000000/rate;
+			if ( t_due > host_time_us() )
+				host_sleep_us(t_due - host_time_us());
+		}
+		test_pattern(chunk, offset, sizeof(chunk));
+		ret = m1_sdm_fill_buffer(chunk, sizeof(chunk));
+	} // for (offset=0; offset<size && !ret; offset+=sizeof(chunk))
+	HOST_CHECK_EQ(ret, 0);
+	m1_sdm_task_stop(); // Flushes and closes the file
+	*pelapsed_us = host_time_us() - t_start;
+	m1_sdm_get_stats(pstats);
+	m1_sdm_task_deinit();
+} // static void test_stream(...)
+
+
+
+int main(void)
+{
+	S_M1_SDM_DatFileInfo_t datfile;
+	S_M1_SDM_Stats_t stats;
+	S_Host_Disk_Stats_t disk;
+	uint64_t elapsed_us;
+
+	HOST_CHECK(host_fatfs_mount(TEST_DISK_SECTORS)!=NULL);
+	host_disk_set_timing(TEST_CARD_COMMAND_US, TEST_CARD_SECTOR_US);
+
+	// As fast as the producer can go: the card is the bottleneck
+	host_disk_stats_reset();
+	test_stream(TEST_STREAM_SIZE, 0, &datfile, &stats, &elapsed_us);
+	host_disk_stats_get(&disk);
+	test_check_file((char *)datfile.dat_filename, TEST_STREAM_SIZE);
+	printf("Stream: %u KB in %llu ms, %llu KB/s, card busy %llu%%\n", TEST_STREAM_SIZE/1024, (unsigned long long)elapsed_us/1000,
+			(unsigned long long)TEST_STREAM_SIZE*1000000/1024/elapsed_us, (unsigned long long)disk.busy_us*100/elapsed_us);
+	printf("        %u buffers in %u f_write, %u disk writes (%u sectors), high water %u/%u, stalls %u (max %u ticks)\n",
+			stats.buffers_written, stats.write_calls, disk.writes, disk.sectors_written, stats.buffers_high_water,
+			M1_SDM_BUFFER_ARRAY_SIZE - 1, stats.producer_stalls, stats.stall_ticks_max);
+	HOST_CHECK_EQ(stats.dropped_bytes, 0);
+	HOST_CHECK_EQ(stats.write_errors, 0);
+	// Buffers queued back to back go out in one f_write
+	HOST_CHECK(stats.write_calls < stats.buffers_written);
+	// Multi-sector transfers: far fewer disk writes than sectors
+	HOST_CHECK(disk.writes*4 < disk.sectors_written);
+
+	// Slower than the card: the producer never waits
+	test_stream(TEST_PACED_SIZE, TEST_PACED_RATE, &datfile, &stats, &elapsed_us);
+	test_check_file((char *)datfile.dat_filename, TEST_PACED_SIZE);
+	printf("Paced:  %u KB at %u KB/s, high water %u/%u, stalls %u\n", TEST_PACED_SIZE/1024, TEST_PACED_RATE/1024,
+			stats.buffers_high_water, M1_SDM_BUFFER_ARRAY_SIZE - 1, stats.producer_stalls);
+	HOST_CHECK_EQ(stats.dropped_bytes, 0);
+	HOST_CHECK_EQ(stats.producer_stalls, 0);
+
+	return host_test_result("sdm_test");
+} // int main(void)
@@ -0,0 +1,223 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  si446x_queue_test.c
+*
+*  SI446x command queue on the SPI model of the SI4463. Each band
+*  configuration, for RX and for TX direct mode, is loaded by
+*  radio_init_rx_tx() and by the blocking SI446x_ConfigInit() it replaced,
+*  and both must leave the same properties and GPIO configuration, with
+*  the nIRQ pin back in its interrupt mode. The queue is sent by the DMA
+*  and the CTS edges, without it by blocking transfers, and while another
+*  task polls the modem status.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <pthread.h>
+#include <string.h>
+#include "main.h"
+#include "m1_sub_ghz_api.h"
+#include "host_si446x.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_TX_DIRECT_MODE			0xC8 // TX direct mode on GPIO2, as sub_ghz_set_opmode() sets it
+#define TEST_NIRQ_INDEX				4 // In S_Host_SI446x_Config_t.gpio
+#define TEST_CPU_GAIN_MIN			3 // CPU time of the blocking load over the queue sent by the DMA
+#define TEST_SHARED_LOADS			40 // Loads while another task uses the radio
+#define TEST_OTHER_TASK_US			200
+
+//************************** S T R U C T U R E S *******************************
+
+typedef struct
+{
+	uint32_t loads;
+	uint32_t mismatches;
+	uint32_t frames[2]; // Blocking load, queue
+	uint64_t cpu_ns[2];
+	uint32_t dma_frames;
+	uint32_t cts_edges;
+	uint32_t overruns;
+	uint32_t bus_conflicts;
+} S_Test_Totals_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+static S_Host_SI446x_Config_t test_blocking_config, test_queue_config;
+static volatile bool test_other_run;
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+uint8_t SI446x_ConfigInit(const uint8_t* pSetPropCmd);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static uint8_t test_mod_type(uint8_t band, bool tx)
+{
+	uint8_t mod_type;
+
+	mod_type = (band==SUB_GHZ_BAND_915) ? MODEM_MOD_TYPE_FSK:MODEM_MOD_TYPE_OOK;
+
+	return tx ? (mod_type | TEST_TX_DIRECT_MODE):mod_type;
+} // static uint8_t test_mod_type(uint8_t band, bool tx)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Loads a band after a power on reset as the driver did before the
+  *         queue: one command at a time, each one waiting for its CTS
+  */
+/*============================================================================*/
+static void test_blocking_load(uint8_t band, bool tx, S_Host_SI446x_Stats_t *pstats)
+{
+	S_Host_SI446x_Stats_t start;
+
+	SI446x_PowerUp();
+	host_si446x_get_stats(&start);
+	SI446x_ConfigInit(RadioConfigList[band]->Radio_ConfigurationArray);
+	SI446x_Get_IntStatus(0, 0, 0);
+	if ( tx )
+		SI446x_Change_ModType(test_mod_type(band, tx));
+	host_si446x_get_stats(pstats);
+	host_si446x_stats_diff(&start, pstats);
+	host_si446x_get_config(&test_blocking_config);
+} // static void test_blocking_load(uint8_t band, bool tx, S_Host_SI446x_Stats_t *pstats)
+
+
+
+static void test_queue_load(uint8_t band, bool tx, S_Host_SI446x_Stats_t *pstats)
+{
+	S_Host_SI446x_Stats_t start;
+
+	SI446x_PowerUp();
+	host_si446x_get_stats(&start);
+	radio_init_rx_tx(band, test_mod_type(band, tx), false);
+	host_si446x_get_stats(pstats);
+	host_si446x_stats_diff(&start, pstats);
+	host_si446x_get_config(&test_queue_config);
+} // static void test_queue_load(uint8_t band, bool tx, S_Host_SI446x_Stats_t *pstats)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Loads all bands for RX and TX both ways and adds up the counters
+  */
+/*============================================================================*/
+static void test_all_bands(S_Test_Totals_t *ptotals)
+{
+	S_Host_SI446x_Stats_t blocking, queue;
+	uint8_t band, tx;
+
+	memset(ptotals, 0, sizeof(S_Test_Totals_t));
+	for (band=0; band<SUB_GHZ_BAND_EOL; band++)
+	{
+		for (tx=0; tx<2; tx++)
+		{
+			test_blocking_load(band, tx, &blocking);
+			test_queue_load(band, tx, &queue);
+			ptotals->loads++;
+			if ( memcmp(&test_blocking_config, &test_queue_config, sizeof(test_queue_config)) )
+			{
+				printf("  band %u %s: configuration differs\n", band, tx ? "TX":"RX");
+				ptotals->mismatches++;
+			}
+			HOST_CHECK_EQ(test_queue_config.gpio[TEST_NIRQ_INDEX], SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_NIRQ_MODE_ENUM_NIRQ);
+			ptotals->frames[0] += blocking.frames;
+			ptotals->frames[1] += queue.frames;
+			ptotals->cpu_ns[0] += blocking.cpu_ns;
+			ptotals->cpu_ns[1] += queue.cpu_ns;
+			ptotals->dma_frames += queue.dma_frames;
+			ptotals->cts_edges += queue.cts_edges;
+			ptotals->overruns += blocking.overruns + queue.overruns;
+			ptotals->bus_conflicts += blocking.bus_conflicts + queue.bus_conflicts;
+		} // for (tx=0; tx<2; tx++)
+	} // for (band=0; band<SUB_GHZ_BAND_EOL; band++)
+} // static void test_all_bands(S_Test_Totals_t *ptotals)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Another task reading the modem status, as the RSSI worker does
+  */
+/*============================================================================*/
+static void *test_other_task(void *argument)
+{
+	(void)argument;
+	while ( test_other_run )
+	{
+		SI446x_Get_ModemStatus(0x00);
+		host_sleep_us(TEST_OTHER_TASK_US);
+	}
+
+	return NULL;
+} // static void *test_other_task(void *argument)
+
+
+
+int main(void)
+{
+	S_Test_Totals_t totals;
+	S_Host_SI446x_Stats_t start, end;
+	S_SI446x_Queue_Stats_t queue_stats;
+	pthread_t other;
+	uint32_t i;
+
+	SI446x_Lock_Init();
+
+	// Queue sent by the DMA, the next command from the CTS edge
+	host_si446x_model_init(true);
+	test_all_bands(&totals);
+	printf("%u loads, per load: %u -> %u SPI transfers, CPU %.0f -> %.0f us, %u CTS edges\n", totals.loads,
+			totals.frames[0]/totals.loads, totals.frames[1]/totals.loads, totals.cpu_ns[0]/1e3/totals.loads,
+			totals.cpu_ns[1]/1e3/totals.loads, totals.cts_edges/totals.loads);
+	HOST_CHECK_EQ(totals.mismatches, 0);
+	HOST_CHECK(totals.frames[1] < totals.frames[0]);
+	HOST_CHECK(totals.cpu_ns[0] >= TEST_CPU_GAIN_MIN*totals.cpu_ns[1]);
+	HOST_CHECK(totals.dma_frames > 0);
+	HOST_CHECK(totals.cts_edges > 0);
+	HOST_CHECK_EQ(totals.overruns, 0);
+	HOST_CHECK_EQ(totals.bus_conflicts, 0);
+
+	// Without the DMA channel, the queue is sent by blocking transfers
+	host_si446x_model_init(false);
+	test_all_bands(&totals);
+	printf("Without DMA: %u SPI transfers per load\n", totals.frames[1]/totals.loads);
+	HOST_CHECK_EQ(totals.mismatches, 0);
+	HOST_CHECK_EQ(totals.dma_frames, 0);
+	HOST_CHECK_EQ(totals.overruns, 0);
+
+	// The queue keeps the radio until it has been sent
+	host_si446x_model_init(true);
+	test_other_run = true;
+	pthread_create(&other, NULL, test_other_task, NULL);
+	host_si446x_get_stats(&start);
+	for (i=0; i<TEST_SHARED_LOADS; i++)
+	{
+		radio_init_rx_tx(i % SUB_GHZ_BAND_EOL, test_mod_type(i % SUB_GHZ_BAND_EOL, false), false);
+		host_si446x_get_config(&test_queue_config);
+		HOST_CHECK_EQ(test_queue_config.gpio[TEST_NIRQ_INDEX], SI446X_CMD_GPIO_PIN_CFG_ARG_NIRQ_NIRQ_MODE_ENUM_NIRQ);
+	}
+	test_other_run = false;
+	pthread_join(other, NULL);
+	host_si446x_get_stats(&end);
+	host_si446x_stats_diff(&start, &end);
+	HOST_CHECK_EQ(end.overruns, 0);
+	HOST_CHECK_EQ(end.bus_conflicts, 0);
+	HOST_CHECK_EQ(end.dma_aborts, 0);
+
+	SI446x_Queue_Get_Stats(&queue_stats);
+	HOST_CHECK_EQ(queue_stats.timeouts, 0);
+
+	return host_test_result("si446x_queue_test");
+} // int main(void)
@@ -0,0 +1,237 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  spsc_stress.c
+*
+*  SPSC ring buffer of m1_ring_buffer.c with a producer thread and a consumer
+*  thread: every item arrives once and in order, through spans of any length
+*  and across the wrap of the indices. Then the cost per item of the SPSC
+*  ring used in place and of the copying ring buffer it replaced for the
+*  Sub-GHz capture.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "main.h"
+#include "m1_ring_buffer.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_RING_ELEMENTS			1024 // Small, so that the indices wrap often
+#define TEST_ITEMS					(8*1000*1000)
+#define TEST_LOSSY_ITEMS			(2*1000*1000)
+#define TEST_BENCH_ITEMS			(16*1000*1000)
+#define TEST_BENCH_BURST			256 // Items put between two reads, as the capture ISR between two task wakeups
+#define TEST_BENCH_ELEMENTS			32768
+
+//************************** S T R U C T U R E S *******************************
+
+typedef struct
+{
+	S_M1_SpscRingBuffer rb;
+	uint32_t items;
+	bool retry; // The producer waits when the ring is full, else it drops the item
+	volatile bool done; // Set by the producer after its last item
+	uint32_t received;
+	uint32_t out_of_order;
+	uint32_t max_span;
+} S_Test_Stress_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+static uint32_t test_ring[TEST_RING_ELEMENTS];
+static uint16_t test_bench_ring[TEST_BENCH_ELEMENTS];
+static uint16_t test_bench_copy[TEST_BENCH_ELEMENTS];
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static uint64_t test_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+} // static uint64_t test_now_ns(void)
+
+
+
+static void *test_producer(void *argument)
+{
+	S_Test_Stress_t *ptest = argument;
+	uint32_t i;
+
+	for (i=0; i<ptest->items; i++)
+	{
+		while ( !m1_spsc_rb_put(&ptest->rb, &i) && ptest->retry )
+			sched_yield();
+		if ( !ptest->retry && !(i % 4096) )
+			sched_yield(); // Bursts, as edges come in packets
+	}
+	__sync_synchronize();
+	ptest->done = true;
+
+	return NULL;
+} // static void *test_producer(void *argument)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Takes the items in place, committing a random part of each span
+  */
+/*============================================================================*/
+static void *test_consumer(void *argument)
+{
+	S_Test_Stress_t *ptest = argument;
+	const uint32_t *pspan;
+	uint32_t n, i, next, seed;
+	bool done;
+
+	seed = 1;
+	next = 0;
+	while ( true )
+	{
+		done = ptest->done; // Read before the span: no item follows it
+		__sync_synchronize();
+		pspan = m1_spsc_rb_acquire_read_span(&ptest->rb, &n);
+		if ( !n )
+		{
+			if ( done )
+				break;
+			sched_yield();
+			continue;
+		}
+		if ( n > ptest->max_span )
+			ptest->max_span = n;
+		seed = seed*1103515245 + 12345;
+		n = 1 + (seed >> 16) % n;
+		for (i=0; i<n; i++)
+		{
+			// Without retry, dropped items leave gaps but never reorder
+			if ( ptest->retry ? (pspan[i]!=next):(pspan[i] < next) )
+				ptest->out_of_order++;
+			next = pspan[i] + 1;
+		}
+		ptest->received += n;
+		m1_spsc_rb_commit_read(&ptest->rb, n);
+		if ( !ptest->retry )
+			sched_yield(); // Slower than the producer, so that it fills the ring
+	} // while ( true )
+
+	return NULL;
+} // static void *test_consumer(void *argument)
+
+
+
+static void test_stress(uint32_t items, bool retry)
+{
+	S_Test_Stress_t test;
+	pthread_t producer, consumer;
+	uint64_t t_start;
+
+	memset(&test, 0, sizeof(test));
+	HOST_CHECK(m1_spsc_rb_init(&test.rb, (uint8_t *)test_ring, TEST_RING_ELEMENTS, sizeof(uint32_t))==0);
+	// The indices start just below the wrap of 32 bits
+	test.rb.head = test.rb.tail = UINT32_MAX - TEST_RING_ELEMENTS/2;
+	test.items = items;
+	test.retry = retry;
+
+	t_start = test_now_ns();
+	pthread_create(&consumer, NULL, test_consumer, &test);
+	pthread_create(&producer, NULL, test_producer, &test);
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+
+	printf("%s: %u items in %llu ms, received %u, ring full %u times, longest span %u\n", retry ? "Lossless":"Lossy",
+			items, (unsigned long long)(test_now_ns() - t_start)/1000000, test.received, test.rb.overruns, test.max_span);
+	HOST_CHECK_EQ(test.out_of_order, 0);
+	// With retry, overruns counts the times the producer found the ring full
+	HOST_CHECK_EQ(retry ? test.received:(test.received + test.rb.overruns), items);
+	if ( !retry )
+		HOST_CHECK(test.rb.overruns > 0 && test.received > TEST_RING_ELEMENTS);
+	HOST_CHECK_EQ(m1_spsc_rb_get_data_slots(&test.rb), 0);
+} // static void test_stress(uint32_t items, bool retry)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Cost per item of a capture: bursts put one at a time, then read.
+  *         The copying ring buffer reads into a second buffer, the SPSC ring
+  *         is used in place. A checksum of the items read keeps the
+  *         compiler from dropping the work.
+  */
+/*============================================================================*/
+static void test_bench(void)
+{
+	S_M1_RingBuffer rb;
+	S_M1_SpscRingBuffer spsc;
+	const uint16_t *pspan;
+	uint64_t t_start, ns_copy, ns_spsc;
+	uint32_t i, j, n, sum_copy, sum_spsc;
+	uint16_t item;
+
+	m1_ringbuffer_init(&rb, (uint8_t *)test_bench_ring, TEST_BENCH_ELEMENTS, sizeof(uint16_t));
+	sum_copy = 0;
+	t_start = test_now_ns();
+	for (i=0; i<TEST_BENCH_ITEMS; i+=TEST_BENCH_BURST)
+	{
+		for (j=0; j<TEST_BENCH_BURST; j++)
+		{
+			item = i + j;
+			m1_ringbuffer_insert(&rb, (uint8_t *)&item);
+		}
+		n = m1_ringbuffer_read(&rb, (uint8_t *)test_bench_copy, TEST_BENCH_BURST);
+		for (j=0; j<n; j++)
+			sum_copy += test_bench_copy[j];
+	} // for (i=0; i<TEST_BENCH_ITEMS; i+=TEST_BENCH_BURST)
+	ns_copy = test_now_ns() - t_start;
+
+	m1_spsc_rb_init(&spsc, (uint8_t *)test_bench_ring, TEST_BENCH_ELEMENTS, sizeof(uint16_t));
+	sum_spsc = 0;
+	t_start = test_now_ns();
+	for (i=0; i<TEST_BENCH_ITEMS; i+=TEST_BENCH_BURST)
+	{
+		for (j=0; j<TEST_BENCH_BURST; j++)
+		{
+			item = i + j;
+			m1_spsc_rb_put(&spsc, &item);
+		}
+		while ( (pspan = m1_spsc_rb_acquire_read_span(&spsc, &n)), n )
+		{
+			for (j=0; j<n; j++)
+				sum_spsc += pspan[j];
+			m1_spsc_rb_commit_read(&spsc, n);
+		}
+	} // for (i=0; i<TEST_BENCH_ITEMS; i+=TEST_BENCH_BURST)
+	ns_spsc = test_now_ns() - t_start;
+
+	printf("Per item: copying ring buffer %.2f ns, SPSC ring in place %.2f ns\n", (double)ns_copy/TEST_BENCH_ITEMS,
+			(double)ns_spsc/TEST_BENCH_ITEMS);
+	HOST_CHECK_EQ(sum_spsc, sum_copy);
+} // static void test_bench(void)
+
+
+
+int main(void)
+{
+	S_M1_SpscRingBuffer rb;
+
+	HOST_CHECK(m1_spsc_rb_init(&rb, (uint8_t *)test_ring, 1000, sizeof(uint32_t))!=0); // Not a power of two
+	test_stress(TEST_ITEMS, true);
+	test_stress(TEST_LOSSY_ITEMS, false);
+	test_bench();
+
+	return host_test_result("spsc_stress");
+} // int main(void)
@@ -0,0 +1,214 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  subghz_jitter_test.c
+*
+*  Single-packet decode rate of Princeton codes with Gaussian jitter on
+*  every pulse, through subghz_pulse_handler(). The same packets are also
+*  decoded with the timing taken from the 3rd and 4th pulse, as Princeton
+*  did before the shared estimator, for the gain.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "m1_sub_ghz_decenc.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_PACKETS				20000 // Per symbol width and jitter
+#define TEST_BITS					24
+#define TEST_PULSES					(2*TEST_BITS)
+#define TEST_GAP_TE					31 // Gap after a packet, in symbol widths
+
+//************************** S T R U C T U R E S *******************************
+
+typedef struct
+{
+	uint16_t jitter; // Standard deviation, % of te
+	uint16_t min_rate; // Decoded packets, 0.1 %
+} S_Test_Jitter_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+// Long pulses of 3*te stay below INTERPACKET_GAP_MIN, else the packet is cut
+static const uint16_t test_te[] = {270, 320, 370};
+
+static const S_Test_Jitter_t test_jitter[] =
+{
+	{5, 990},
+	{8, 400},
+	{10, 50},
+};
+
+static uint32_t test_seed = 1;
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+uint8_t subghz_pulse_handler(uint16_t duration);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static uint32_t test_rand(void)
+{
+	test_seed = test_seed*1103515245 + 12345;
+	return test_seed >> 1;
+} // static uint32_t test_rand(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Normal deviate, Box-Muller
+  */
+/*============================================================================*/
+static double test_gauss(void)
+{
+	double u1, u2;
+
+	u1 = (test_rand() + 1.0)/2147483649.0;
+	u2 = (test_rand() + 1.0)/2147483649.0;
+	return sqrt(-2.0*log(u1))*cos(2.0*M_PI*u2);
+} // static double test_gauss(void)
+
+
+
+static uint16_t test_pulse(uint16_t width, uint16_t jitter)
+{
+	double d;
+
+	d = width + test_gauss()*width*jitter/100.0;
+	return (d < 1.0) ? 1:(uint16_t)d;
+} // static uint16_t test_pulse(uint16_t width, uint16_t jitter)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Decodes a packet with the timing taken from its 3rd and 4th pulse
+  *         and the tolerance of the protocol around it
+  */
+/*============================================================================*/
+static bool test_legacy_decode(const uint16_t *pulses, uint32_t *pcode)
+{
+	uint16_t te_short, te_long, tol_short, tol_long, swap;
+	uint32_t code;
+	uint8_t i, tolerance;
+	bool one;
+
+	tolerance = subghz_protocols_list[PRINCETON].te_tolerance;
+	te_short = pulses[2];
+	te_long = pulses[3];
+	if ( te_long < te_short )
+	{
+		swap = te_short;
+		te_short = te_long;
+		te_long = swap;
+	}
+	if ( abs(te_long - te_short*3) > te_short*3*tolerance/100 )
+		return false;
+	tol_short = te_short*tolerance/100;
+	tol_long = te_long*tolerance/100;
+
+	code = 0;
+	for (i=0; i<TEST_PULSES; i+=2)
+	{
+		if ( abs(pulses[i] - te_short) < tol_short )
+			one = false;
+		else if ( abs(pulses[i] - te_long) < tol_long )
+			one = true;
+		else
+			return false;
+		if ( abs(pulses[i + 1] - (one ? te_short:te_long)) >= (one ? tol_short:tol_long) )
+			return false;
+		code = (code << 1) | one;
+	} // for (i=0; i<TEST_PULSES; i+=2)
+	*pcode = code;
+
+	return true;
+} // static bool test_legacy_decode(const uint16_t *pulses, uint32_t *pcode)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Sends each packet once, behind a gap, and counts the packets
+  *         decoded with their code by both decoders
+  */
+/*============================================================================*/
+static void test_rates(uint16_t te, uint16_t jitter, uint32_t *pdecoded, uint32_t *plegacy, uint32_t *pwrong)
+{
+	SubGHz_Dec_Info_t info;
+	uint16_t pulses[TEST_PULSES];
+	uint32_t n, code, legacy_code;
+	uint8_t i;
+	bool one;
+
+	subghz_decenc_init();
+	*pdecoded = *plegacy = *pwrong = 0;
+	for (n=0; n<TEST_PACKETS; n++)
+	{
+		code = (test_rand() & ((1UL << TEST_BITS) - 1)) | 1; // The decoder takes 0 for no key
+		for (i=0; i<TEST_BITS; i++)
+		{
+			one = (code >> (TEST_BITS - 1 - i)) & 1;
+			pulses[2*i] = test_pulse(one ? 3*te:te, jitter);
+			pulses[2*i + 1] = test_pulse(one ? te:3*te, jitter);
+		}
+		if ( test_legacy_decode(pulses, &legacy_code) && legacy_code==code )
+			(*plegacy)++;
+
+		subghz_decenc_ctl.subghz_reset_data();
+		subghz_pulse_handler(TEST_GAP_TE*te);
+		for (i=0; i<TEST_PULSES; i++)
+			subghz_pulse_handler(pulses[i]);
+		subghz_pulse_handler(TEST_GAP_TE*te);
+		memset(&info, 0, sizeof(info));
+		if ( subghz_decenc_read(&info, false) )
+		{
+			if ( info.key==code && info.protocol==PRINCETON )
+				(*pdecoded)++;
+			else
+				(*pwrong)++;
+		}
+	} // for (n=0; n<TEST_PACKETS; n++)
+} // static void test_rates(uint16_t te, uint16_t jitter, uint32_t *pdecoded, uint32_t *plegacy, uint32_t *pwrong)
+
+
+
+int main(void)
+{
+	uint32_t decoded, legacy, wrong, total_decoded, total_legacy;
+	uint8_t t, j;
+
+	printf("Single-packet decode rate, %u codes per width: 3rd/4th pulse -> estimator\n", TEST_PACKETS);
+	for (j=0; j<sizeof(test_jitter)/sizeof(test_jitter[0]); j++)
+	{
+		total_decoded = total_legacy = 0;
+		for (t=0; t<sizeof(test_te)/sizeof(test_te[0]); t++)
+		{
+			test_rates(test_te[t], test_jitter[j].jitter, &decoded, &legacy, &wrong);
+			printf("  te %u us, jitter %2u%%: %5.1f%% -> %5.1f%%, %u wrong key(s)\n", test_te[t], test_jitter[j].jitter,
+					100.0*legacy/TEST_PACKETS, 100.0*decoded/TEST_PACKETS, wrong);
+			HOST_CHECK(decoded*1000 >= test_jitter[j].min_rate*TEST_PACKETS);
+			// With little jitter, a packet is decoded with its code or not at all
+			if ( test_jitter[j].jitter <= 5 )
+				HOST_CHECK_EQ(wrong, 0);
+			total_decoded += decoded;
+			total_legacy += legacy;
+		} // for (t=0; t<sizeof(test_te)/sizeof(test_te[0]); t++)
+		HOST_CHECK(total_decoded > total_legacy);
+	} // for (j=0; j<sizeof(test_jitter)/sizeof(test_jitter[0]); j++)
+
+	return host_test_result("subghz_jitter_test");
+} // int main(void)
@@ -0,0 +1,326 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  subghz_replay.c
+*
+*  Replays recorded Sub-GHz raw data files, text or binary format, through
+*  subghz_pulse_handler() as the capture interrupt would, and reports the
+*  decode hit rate and the time spent per edge.
+*
+*  subghz_replay [--expect key] [--min-rate %] [--max-decoded n] [--repeat n] file...
+*
+*  --expect       every decoded key must be this value
+*  --min-rate     fails if fewer packets than this percentage are decoded
+*  --max-decoded  fails if more packets than this are decoded, for noise files
+*  --repeat       replays of the samples timed for the average ns per edge
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include "m1_sub_ghz_decenc.h"
+#include "m1_sub_ghz_rawfile.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define REPLAY_DATA_KEYWORD			"Data:"
+#define REPLAY_REPEAT_DEFAULT		20
+
+//************************** S T R U C T U R E S *******************************
+
+typedef struct
+{
+	uint16_t *samples;
+	uint32_t count;
+	uint32_t size;
+} S_Replay_Samples_t;
+
+typedef struct
+{
+	uint32_t edges;
+	uint32_t packets;
+	uint32_t decoded;
+	uint32_t wrong_key;
+	uint64_t ns_total; // Timed replays only
+	uint32_t ns_max;
+} S_Replay_Result_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+static bool replay_expect_set;
+static uint64_t replay_expect;
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+uint8_t subghz_pulse_handler(uint16_t duration);
+
+static uint64_t replay_now_ns(void);
+static uint8_t replay_samples_add(S_Replay_Samples_t *psamples, uint32_t duration);
+static uint8_t replay_load_text(const char *pbuffer, size_t size, S_Replay_Samples_t *psamples);
+static uint8_t replay_load_binary(const uint8_t *pbuffer, size_t size, S_Replay_Samples_t *psamples);
+static uint8_t replay_load(const char *filename, S_Replay_Samples_t *psamples);
+static void replay_decode(const S_Replay_Samples_t *psamples, S_Replay_Result_t *presult);
+static void replay_time(const S_Replay_Samples_t *psamples, uint32_t repeat, S_Replay_Result_t *presult);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+static uint64_t replay_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+} // static uint64_t replay_now_ns(void)
+
+
+
+static uint8_t replay_samples_add(S_Replay_Samples_t *psamples, uint32_t duration)
+{
+	uint16_t *pnew;
+
+	if ( psamples->count==psamples->size )
+	{
+		psamples->size = psamples->size ? psamples->size*2:4096;
+		pnew = realloc(psamples->samples, psamples->size*sizeof(uint16_t));
+		if ( pnew==NULL )
+			return 1;
+		psamples->samples = pnew;
+	}
+	psamples->samples[psamples->count++] = (duration > UINT16_MAX)?UINT16_MAX:duration;
+
+	return 0;
+} // static uint8_t replay_samples_add(S_Replay_Samples_t *psamples, uint32_t duration)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Reads the samples of the "Data:" lines. The sign of a sample only
+  *         tells the level, mark and space alternate anyway.
+  */
+/*============================================================================*/
+static uint8_t replay_load_text(const char *pbuffer, size_t size, S_Replay_Samples_t *psamples)
+{
+	const char *pline, *pend, *peol;
+	char *pnum;
+	long value;
+
+	pline = pbuffer;
+	pend = pbuffer + size;
+	while ( pline < pend )
+	{
+		peol = memchr(pline, '\n', pend - pline);
+		if ( peol==NULL )
+			peol = pend;
+		if ( !strncmp(pline, REPLAY_DATA_KEYWORD, strlen(REPLAY_DATA_KEYWORD)) )
+		{
+			pline += strlen(REPLAY_DATA_KEYWORD);
+			while ( pline < peol )
+			{
+				value = strtol(pline, &pnum, 10);
+				if ( pnum==pline ) // Not a number
+				{
+					pline++;
+					continue;
+				}
+				if ( replay_samples_add(psamples, labs(value)) )
+					return 1;
+				pline = pnum;
+			} // while ( pline < peol )
+		} // if ( !strncmp(pline, REPLAY_DATA_KEYWORD, strlen(REPLAY_DATA_KEYWORD)) )
+		pline = peol + 1;
+	} // while ( pline < pend )
+
+	return 0;
+} // static uint8_t replay_load_text(const char *pbuffer, size_t size, S_Replay_Samples_t *psamples)
+
+
+
+static uint8_t replay_load_binary(const uint8_t *pbuffer, size_t size, S_Replay_Samples_t *psamples)
+{
+	S_SubGHz_RawFile_Header_t hdr;
+	const uint8_t *psrc, *pend;
+	uint16_t block[256];
+	uint16_t n, i;
+
+	if ( subghz_rawfile_header_check(pbuffer, size > UINT16_MAX ? UINT16_MAX:size, &hdr) )
+		return 1;
+
+	psrc = pbuffer + hdr.header_size;
+	pend = pbuffer + size;
+	do
+	{
+		if ( subghz_rawfile_decode(&psrc, pend, block, sizeof(block)/sizeof(block[0]), &n) )
+			return 1;
+		for (i=0; i<n; i++)
+		{
+			if ( replay_samples_add(psamples, block[i]) )
+				return 1;
+		}
+	} while ( n );
+
+	return (psrc!=pend); // Truncated sample
+} // static uint8_t replay_load_binary(const uint8_t *pbuffer, size_t size, S_Replay_Samples_t *psamples)
+
+
+
+static uint8_t replay_load(const char *filename, S_Replay_Samples_t *psamples)
+{
+	FILE *pfile;
+	uint8_t *pbuffer;
+	long size;
+	uint8_t error;
+
+	pfile = fopen(filename, "rb");
+	if ( pfile==NULL )
+		return 1;
+	fseek(pfile, 0, SEEK_END);
+	size = ftell(pfile);
+	fseek(pfile, 0, SEEK_SET);
+	pbuffer = malloc(size + 1);
+	error = 1;
+	if ( pbuffer && fread(pbuffer, 1, size, pfile)==(size_t)size )
+	{
+		if ( subghz_rawfile_is_binary(pbuffer, size > UINT16_MAX ? UINT16_MAX:size) )
+			error = replay_load_binary(pbuffer, size, psamples);
+		else
+			error = replay_load_text((char *)pbuffer, size, psamples);
+	}
+	free(pbuffer);
+	fclose(pfile);
+
+	return error;
+} // static uint8_t replay_load(const char *filename, S_Replay_Samples_t *psamples)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Replays the samples once and collects the decoded keys, as the
+  *         Sub-GHz task would between two pulses. Each edge is timed here,
+  *         for the worst case.
+  */
+/*============================================================================*/
+static void replay_decode(const S_Replay_Samples_t *psamples, S_Replay_Result_t *presult)
+{
+	SubGHz_Dec_Info_t info;
+	uint64_t t_start;
+	uint32_t i, ns;
+
+	subghz_decenc_init();
+	memset(&subghz_dec_stats, 0, sizeof(subghz_dec_stats));
+	for (i=0; i<psamples->count; i++)
+	{
+		t_start = replay_now_ns();
+		subghz_pulse_handler(psamples->samples[i]);
+		ns = replay_now_ns() - t_start;
+		if ( ns > presult->ns_max )
+			presult->ns_max = ns;
+
+		memset(&info, 0, sizeof(info));
+		if ( subghz_decenc_read(&info, false) && info.key )
+		{
+			if ( replay_expect_set && info.key!=replay_expect )
+			{
+				presult->wrong_key++;
+				fprintf(stderr, "Unexpected key 0x%" PRIx64 " (%s, %u bits) at sample %u\n", info.key,
+						protocol_text[info.protocol], info.bit_len, i);
+			}
+		} // if ( subghz_decenc_read(&info, false) && info.key )
+	} // for (i=0; i<psamples->count; i++)
+
+	presult->edges += psamples->count;
+	presult->packets += subghz_dec_stats.packets;
+	presult->decoded += subghz_dec_stats.decoded;
+} // static void replay_decode(const S_Replay_Samples_t *psamples, S_Replay_Result_t *presult)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Replays the samples back to back for the average time per edge,
+  *         without the clock reads of replay_decode() in the measurement.
+  */
+/*============================================================================*/
+static void replay_time(const S_Replay_Samples_t *psamples, uint32_t repeat, S_Replay_Result_t *presult)
+{
+	uint64_t t_start;
+	uint32_t i;
+
+	subghz_decenc_init();
+	t_start = replay_now_ns();
+	while ( repeat-- )
+	{
+		for (i=0; i<psamples->count; i++)
+			subghz_pulse_handler(psamples->samples[i]);
+		subghz_decenc_ctl.n64_decodedvalue = 0;
+	}
+	presult->ns_total += replay_now_ns() - t_start;
+} // static void replay_time(const S_Replay_Samples_t *psamples, uint32_t repeat, S_Replay_Result_t *presult)
+
+
+
+int main(int argc, char *argv[])
+{
+	S_Replay_Samples_t samples;
+	S_Replay_Result_t result;
+	uint32_t repeat, rate, min_rate, max_decoded;
+	uint64_t timed_edges;
+	int i;
+
+	repeat = REPLAY_REPEAT_DEFAULT;
+	min_rate = 0;
+	max_decoded = UINT32_MAX;
+	memset(&result, 0, sizeof(result));
+	timed_edges = 0;
+	for (i=1; i<argc; i++)
+	{
+		if ( !strcmp(argv[i], "--expect") && (i + 1) < argc )
+		{
+			replay_expect = strtoull(argv[++i], NULL, 0);
+			replay_expect_set = true;
+		}
+		else if ( !strcmp(argv[i], "--min-rate") && (i + 1) < argc )
+			min_rate = strtoul(argv[++i], NULL, 0);
+		else if ( !strcmp(argv[i], "--max-decoded") && (i + 1) < argc )
+			max_decoded = strtoul(argv[++i], NULL, 0);
+		else if ( !strcmp(argv[i], "--repeat") && (i + 1) < argc )
+			repeat = strtoul(argv[++i], NULL, 0);
+		else
+		{
+			memset(&samples, 0, sizeof(samples));
+			if ( replay_load(argv[i], &samples) )
+			{
+				fprintf(stderr, "%s: cannot read the raw data\n", argv[i]);
+				return 2;
+			}
+			replay_decode(&samples, &result);
+			replay_time(&samples, repeat, &result);
+			timed_edges += (uint64_t)samples.count*repeat;
+			free(samples.samples);
+		}
+	} // for (i=1; i<argc; i++)
+
+	if ( !result.edges )
+	{
+		fprintf(stderr, "No samples\n");
+		return 2;
+	}
+
+	rate = result.packets ? (result.decoded*100/result.packets):0;
+	printf("Edges: %u Packets: %u Decoded: %u (%u%%)\n", result.edges, result.packets, result.decoded, rate);
+	printf("Time per edge: %" PRIu64 "ns avg, %uns max\n", timed_edges ? result.ns_total/timed_edges:0, result.ns_max);
+
+	if ( result.wrong_key || rate < min_rate || result.decoded > max_decoded )
+		return 1;
+
+	return 0;
+} // int main(int argc, char *argv[])
@@ -0,0 +1,273 @@
+/* See COPYING.txt for license details. */
+
+/*
+*
+*  subghz_sweep_test.c
+*
+*  RSSI sweep of the frequency reader on the SPI model of the SI4463:
+*  a band change that only sends the properties which differ leaves the
+*  radio as loading the whole configuration does, for every pair of bands,
+*  and a frame of the frequency reader plan reports the signals placed in
+*  it. The frame is timed against the channel by channel loop the reader
+*  used before the sweep.
+*
+* M1 Project
+*
+*/
+
+/*************************** I N C L U D E S **********************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "m1_sub_ghz_api.h"
+#include "m1_sub_ghz_sweep.h"
+#include "host_si446x.h"
+#include "host_test.h"
+
+/*************************** D E F I N E S ************************************/
+
+#define TEST_FRAMES					5
+#define TEST_SIGNAL_DBM				-40
+#define TEST_NOISE_DBM				-105 // Noise floor of the model
+#define TEST_SIGNAL_BW_HZ			100000 // A signal is seen on a channel closer than this
+#define TEST_LEGACY_WAIT_NS			1000000 // vTaskDelay(1) after each GET_MODEM_STATUS
+#define TEST_RADIO_GAIN_MIN			4 // Radio time of a legacy frame over a sweep frame
+
+//************************** S T R U C T U R E S *******************************
+
+typedef struct
+{
+	uint8_t band;
+	uint8_t channels; // Steps + 1 in subghz_band_steps of m1_sub_ghz.c, 0 if disabled
+	uint32_t base_hz;
+	uint32_t step_hz; // FREQ_CONTROL_CHANNEL_STEP_SIZE of the configuration
+} S_Test_Plan_Band_t;
+
+/***************************** V A R I A B L E S ******************************/
+
+HOST_TEST_DEFINE;
+
+static const S_Test_Plan_Band_t test_plan[SUB_GHZ_BAND_EOL] =
+{
+	{SUB_GHZ_BAND_300, 5, 300000000, 250000},
+	{SUB_GHZ_BAND_310, 41, 310000000, 250000},
+	{SUB_GHZ_BAND_315, 0, 315000000, 250000},
+	{SUB_GHZ_BAND_345, 5, 345000000, 250000},
+	{SUB_GHZ_BAND_372, 5, 372000000, 250000},
+	{SUB_GHZ_BAND_390, 5, 390000000, 250000},
+	{SUB_GHZ_BAND_433, 4, 433000000, 250000},
+	{SUB_GHZ_BAND_433_92, 3, 433920000, 250000},
+	{SUB_GHZ_BAND_915, 5, 915000000, 25000},
+};
+
+static const uint32_t test_signals[] = {315250000, 433920000, 915140000};
+
+static S_Host_SI446x_Config_t test_delta_config, test_full_config;
+static S_SubGHz_Sweep_Frame_t test_frame;
+
+/********************* F U N C T I O N   P R O T O T Y P E S ******************/
+
+uint8_t SI446x_ConfigInit(const uint8_t* pSetPropCmd);
+
+/*************** F U N C T I O N   I M P L E M E N T A T I O N ****************/
+
+/*============================================================================*/
+/**
+  * @brief  Power on reset of the radio, then a full load of the first band
+  */
+/*============================================================================*/
+static void test_reset(void)
+{
+	radio_init_rx_tx(SUB_GHZ_BAND_300, MODEM_MOD_TYPE_OOK, true);
+} // static void test_reset(void)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  Loads band b after band a, by the sweep and by two full loads,
+  *         and compares the properties and the GPIO configuration
+  */
+/*============================================================================*/
+static bool test_delta_load(uint8_t a, uint8_t b)
+{
+	S_SubGHz_Sweep_Band_t bands[2];
+	S_SubGHz_Sweep_Stats_t stats;
+	uint16_t group, prop;
+
+	bands[0].band = a;
+	bands[0].channels = 1;
+	bands[1].band = b;
+	bands[1].channels = 1;
+	test_reset();
+	HOST_CHECK_EQ(subghz_sweep_init(bands, 2), 0);
+	HOST_CHECK_EQ(subghz_sweep_run(&test_frame), 0);
+	subghz_sweep_get_stats(&stats);
+	HOST_CHECK_EQ(stats.full_reloads, 1);
+	HOST_CHECK_EQ(stats.band_changes, 2);
+	host_si446x_get_config(&test_delta_config);
+
+	test_reset();
+	HOST_CHECK_EQ(subghz_sweep_init(&bands[0], 1), 0);
+	HOST_CHECK_EQ(subghz_sweep_init(&bands[1], 1), 0);
+	host_si446x_get_config(&test_full_config);
+
+	if ( !memcmp(&test_delta_config, &test_full_config, sizeof(test_full_config)) )
+		return true;
+
+	for (group=0; group<HOST_SI446X_GROUPS; group++)
+	{
+		for (prop=0; prop<HOST_SI446X_PROPS; prop++)
+		{
+			if ( test_delta_config.props[group][prop]!=test_full_config.props[group][prop] )
+			{
+				printf("  band %u -> %u: property 0x%02X/0x%02X is 0x%02X, 0x%02X after a full load\n", a, b, group, prop,
+						test_delta_config.props[group][prop], test_full_config.props[group][prop]);
+				return false;
+			}
+		}
+	} // for (group=0; group<HOST_SI446X_GROUPS; group++)
+	printf("  band %u -> %u: GPIO configuration differs\n", a, b);
+
+	return false;
+} // static bool test_delta_load(uint8_t a, uint8_t b)
+
+
+
+/*============================================================================*/
+/**
+  * @brief  One frame of the loop the frequency reader had before the sweep:
+  *         a full load per band, then per channel START_RX, GET_INT_STATUS
+  *         and two GET_MODEM_STATUS, each one followed by a tick of sleep
+  */
+/*============================================================================*/
+static void test_legacy_frame(void)
+{
+	uint8_t b, ch, i;
+
+	for (b=0; b<SUB_GHZ_BAND_EOL; b++)
+	{
+		if ( !test_plan[b].channels )
+			continue;
+		SI446x_ConfigInit(RadioConfigList[test_plan[b].band]->Radio_ConfigurationArray);
+		SI446x_Get_IntStatus(0, 0, 0);
+		SI446x_Select_Frontend(test_plan[b].band);
+		SI446x_Start_Rx(0);
+		for (ch=0; ch<test_plan[b].channels; ch++)
+		{
+			if ( ch )
+				SI446x_Start_Rx(ch);
+			SI446x_Get_IntStatus(0, 0, 0);
+			for (i=0; i<2; i++)
+			{
+				SI446x_Get_ModemStatus(0x00);
+				host_si446x_wait(TEST_LEGACY_WAIT_NS);
+			}
+		} // for (ch=0; ch<test_plan[b].channels; ch++)
+	} // for (b=0; b<SUB_GHZ_BAND_EOL; b++)
+} // static void test_legacy_frame(void)
+
+
+
+static int16_t test_expected_dbm(uint8_t b, uint8_t ch)
+{
+	uint32_t freq;
+	uint8_t i;
+
+	freq = test_plan[b].base_hz + ch*test_plan[b].step_hz;
+	for (i=0; i<sizeof(test_signals)/sizeof(test_signals[0]); i++)
+	{
+		if ( abs((int32_t)(freq - test_signals[i])) < TEST_SIGNAL_BW_HZ )
+			return TEST_SIGNAL_DBM;
+	}
+
+	return TEST_NOISE_DBM;
+} // static int16_t test_expected_dbm(uint8_t b, uint8_t ch)
+
+
+
+int main(void)
+{
+	S_SubGHz_Sweep_Band_t bands[SUB_GHZ_BAND_EOL];
+	S_SubGHz_Sweep_Stats_t stats;
+	S_Host_SI446x_Stats_t start, sweep, legacy;
+	uint32_t mismatches, pairs;
+	uint16_t n;
+	uint8_t a, b, ch, i, f;
+
+	SI446x_Lock_Init();
+	host_si446x_model_init(true);
+
+	// Delta loads between all bands of the frequency reader
+	mismatches = pairs = 0;
+	for (a=0; a<SUB_GHZ_BAND_EOL; a++)
+	{
+		for (b=0; b<SUB_GHZ_BAND_EOL; b++)
+		{
+			if ( (a==b) || !test_plan[a].channels || !test_plan[b].channels )
+				continue;
+			pairs++;
+			if ( !test_delta_load(a, b) )
+				mismatches++;
+		} // for (b=0; b<SUB_GHZ_BAND_EOL; b++)
+	} // for (a=0; a<SUB_GHZ_BAND_EOL; a++)
+	printf("Delta band loads: %u pairs, %u mismatch(es)\n", pairs, mismatches);
+	HOST_CHECK_EQ(mismatches, 0);
+
+	// Frequency reader plan
+	for (i=0; i<sizeof(test_signals)/sizeof(test_signals[0]); i++)
+		host_si446x_add_signal(test_signals[i], TEST_SIGNAL_DBM);
+	for (b=0; b<SUB_GHZ_BAND_EOL; b++)
+	{
+		bands[b].band = test_plan[b].band;
+		bands[b].channels = test_plan[b].channels;
+	}
+	test_reset();
+	HOST_CHECK_EQ(subghz_sweep_init(bands, SUB_GHZ_BAND_EOL), 0);
+	subghz_sweep_run(&test_frame); // The first frame finds the first band loaded
+	host_si446x_get_stats(&start);
+	for (f=0; f<TEST_FRAMES; f++)
+	{
+		HOST_CHECK_EQ(subghz_sweep_run(&test_frame), 0);
+		HOST_CHECK_EQ(test_frame.channels, 73);
+		n = 0;
+		for (b=0; b<SUB_GHZ_BAND_EOL; b++)
+		{
+			for (ch=0; ch<test_plan[b].channels; ch++)
+			{
+				if ( test_frame.rssi[n]!=test_expected_dbm(b, ch) )
+				{
+					printf("  band %u channel %u: %d dBm, %d expected\n", b, ch, test_frame.rssi[n], test_expected_dbm(b, ch));
+					HOST_CHECK(false);
+				}
+				n++;
+			} // for (ch=0; ch<test_plan[b].channels; ch++)
+		} // for (b=0; b<SUB_GHZ_BAND_EOL; b++)
+	} // for (f=0; f<TEST_FRAMES; f++)
+	host_si446x_get_stats(&sweep);
+	host_si446x_stats_diff(&start, &sweep);
+	subghz_sweep_get_stats(&stats);
+	HOST_CHECK_EQ(stats.latch_timeouts, 0);
+	HOST_CHECK_EQ(stats.full_reloads, 1);
+	HOST_CHECK_EQ(sweep.overruns, 0);
+	HOST_CHECK_EQ(sweep.bus_conflicts, 0);
+	HOST_CHECK_EQ(sweep.bad_cmds, 0);
+	HOST_CHECK_EQ(sweep.resets, 0);
+	HOST_CHECK(sweep.dma_frames > 0);
+
+	host_si446x_get_stats(&start);
+	test_legacy_frame();
+	host_si446x_get_stats(&legacy);
+	host_si446x_stats_diff(&start, &legacy);
+	HOST_CHECK_EQ(legacy.overruns, 0);
+
+	printf("Frame of %u channels in %u bands:\n", test_frame.channels, 8);
+	printf("  sweep:  radio %6.2f ms, CPU %6.2f ms, %5u SPI transfers (%u DMA)\n", sweep.radio_ns/1e6/TEST_FRAMES,
+			sweep.cpu_ns/1e6/TEST_FRAMES, sweep.frames/TEST_FRAMES, sweep.dma_frames/TEST_FRAMES);
+	printf("  legacy: radio %6.2f ms, CPU %6.2f ms, %5u SPI transfers\n", legacy.radio_ns/1e6, legacy.cpu_ns/1e6, legacy.frames);
+	HOST_CHECK(legacy.radio_ns >= TEST_RADIO_GAIN_MIN*sweep.radio_ns/TEST_FRAMES);
+	HOST_CHECK(legacy.cpu_ns > sweep.cpu_ns/TEST_FRAMES);
+
+	return host_test_result("subghz_sweep_test");
+} // int main(void)